@@ -578,6 +578,29 @@ draw_enable_point_sprites(struct draw_context *draw, boolean enable)
 }
 
 
+/**
+ * Let the draw module shade the vertices of large draws on the threads of
+ * queue, which has num_threads of them, besides the calling thread.  The
+ * queue belongs to the driver, which may share it between draw contexts
+ * and must keep it alive as long as they use it.  Only the LLVM vertex
+ * shading path makes use of it.  A NULL queue disables the threads.
+ */
+void
+draw_set_vs_queue(struct draw_context *draw, struct util_queue *queue,
+                  unsigned num_threads)
+{
+   draw_do_flush( draw, DRAW_FLUSH_STATE_CHANGE );
+
+   if (queue && num_threads && draw->llvm) {
+      draw->vs.queue = queue;
+      draw->vs.num_threads = MIN2(num_threads, DRAW_MAX_VS_THREADS);
+   } else {
+      draw->vs.queue = NULL;
+      draw->vs.num_threads = 0;
+   }
+}
+
+
 void
 draw_set_force_passthrough( struct draw_context *draw, boolean enable )
 {
@@ -51,6 +51,13 @@ struct draw_fragment_shader;
 struct tgsi_sampler;
 struct tgsi_image;
 struct tgsi_buffer;
+struct util_queue;
+
+/**
+ * Maximum number of threads shading vertices in addition to the thread
+ * calling into the draw module.
+ */
+#define DRAW_MAX_VS_THREADS 15
 
 /*
  * structure to contain driver internal information 
@@ -122,6 +129,9 @@ void draw_enable_point_sprites(struct draw_context *draw, boolean enable);
 
 void draw_set_zs_format(struct draw_context *draw, enum pipe_format format);
 
+void draw_set_vs_queue(struct draw_context *draw, struct util_queue *queue,
+                       unsigned num_threads);
+
 boolean
 draw_install_aaline_stage(struct draw_context *draw, struct pipe_context *pipe);
 
@@ -3321,6 +3321,7 @@ draw_tcs_llvm_generate(struct draw_llvm *llvm,
    LLVMSetFunctionCallConv(variant_func, LLVMCCallConv);
 
    LLVMSetFunctionCallConv(variant_coro, LLVMCCallConv);
+   lp_build_coro_add_presplit(variant_coro);
 
    for (i = 0; i < ARRAY_SIZE(arg_types); ++i) {
       if (LLVMGetTypeKind(arg_types[i]) == LLVMPointerTypeKind) {
@@ -3451,7 +3452,7 @@ draw_tcs_llvm_generate(struct draw_llvm *llvm,
 
    {
       LLVMValueRef coro_id = lp_build_coro_id(gallivm);
-      LLVMValueRef coro_hdl = lp_build_coro_begin_alloc_mem(gallivm, coro_id);
+      LLVMValueRef coro_hdl = lp_build_coro_begin_alloc_mem(gallivm, coro_id, NULL);
 
       mask_val = generate_tcs_mask_value(variant, tcs_type, count, LLVMBuildMul(builder, counter, step, ""));
       lp_build_mask_begin(&mask, gallivm, tcs_type, mask_val);
@@ -3490,7 +3491,7 @@ draw_tcs_llvm_generate(struct draw_llvm *llvm,
       lp_build_coro_suspend_switch(gallivm, &coro_info, NULL, true);
       LLVMPositionBuilderAtEnd(builder, clean_block);
 
-      lp_build_coro_free_mem(gallivm, coro_id, coro_hdl);
+      lp_build_coro_free_mem(gallivm, coro_id, coro_hdl, NULL);
 
       LLVMBuildBr(builder, sus_block);
       LLVMPositionBuilderAtEnd(builder, sus_block);
@@ -3556,9 +3557,10 @@ draw_tcs_llvm_create_variant(struct draw_llvm *llvm,
    lp_build_coro_declare_malloc_hooks(variant->gallivm);
    draw_tcs_llvm_generate(llvm, variant);
 
+   lp_build_coro_add_malloc_hooks(variant->gallivm);
+
    gallivm_compile_module(variant->gallivm);
 
-   lp_build_coro_add_malloc_hooks(variant->gallivm);
    variant->jit_func = (draw_tcs_jit_func)
       gallivm_jit_function(variant->gallivm, variant->function);
 
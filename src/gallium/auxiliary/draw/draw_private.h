@@ -46,6 +46,7 @@
 
 #include "tgsi/tgsi_scan.h"
 
+
 #ifdef LLVM_AVAILABLE
 struct gallivm_state;
 #endif
@@ -65,6 +66,7 @@ struct draw_context;
 struct draw_stage;
 struct vbuf_render;
 struct tgsi_exec_machine;
+struct util_queue;
 struct tgsi_sampler;
 struct tgsi_image;
 struct tgsi_buffer;
@@ -228,6 +230,12 @@ struct draw_context
 
       boolean test_fse;         /* enable FSE even though its not correct (eg for softpipe) */
       boolean no_fse;           /* disable FSE even when it is correct */
+      boolean no_vcache;        /* disable the post-transform vertex cache */
+
+      /* Shaded vertices can only be reused while this is unchanged, it
+       * is bumped for every instance drawn and on any state change.
+       */
+      unsigned vertex_serial;
    } pt;
 
    struct {
@@ -293,6 +301,10 @@ struct draw_context
       struct translate_cache *fetch_cache;
       struct translate *emit;
       struct translate_cache *emit_cache;
+
+      /** Driver's worker threads shading the vertices of large draws */
+      struct util_queue *queue;
+      unsigned num_threads;
    } vs;
 
    /** Geometry shader state */
@@ -46,6 +46,7 @@
 
 DEBUG_GET_ONCE_BOOL_OPTION(draw_fse, "DRAW_FSE", FALSE)
 DEBUG_GET_ONCE_BOOL_OPTION(draw_no_fse, "DRAW_NO_FSE", FALSE)
+DEBUG_GET_ONCE_BOOL_OPTION(draw_no_vcache, "DRAW_NO_VCACHE", FALSE)
 
 /* Overall we split things into:
  *     - frontend -- prepare fetch_elts, draw_elts - eg vsplit
@@ -160,6 +161,18 @@ draw_pt_arrays(struct draw_context *draw,
    return TRUE;
 }
 
+/**
+ * Stop the middle ends from reusing any vertex shaded so far.
+ */
+static inline void
+invalidate_vertices(struct draw_context *draw)
+{
+   /* zero marks the empty vertex cache entries */
+   if (++draw->pt.vertex_serial == 0)
+      draw->pt.vertex_serial = 1;
+}
+
+
 void draw_pt_flush( struct draw_context *draw, unsigned flags )
 {
    assert(flags);
@@ -175,6 +188,9 @@ void draw_pt_flush( struct draw_context *draw, unsigned flags )
    if (flags & DRAW_FLUSH_PARAMETER_CHANGE) {
       draw->pt.rebind_parameters = TRUE;
    }
+
+   if (flags & (DRAW_FLUSH_STATE_CHANGE | DRAW_FLUSH_PARAMETER_CHANGE))
+      invalidate_vertices(draw);
 }
 
 
@@ -183,6 +199,8 @@ boolean draw_pt_init( struct draw_context *draw )
 {
    draw->pt.test_fse = debug_get_option_draw_fse();
    draw->pt.no_fse = debug_get_option_draw_no_fse();
+   draw->pt.no_vcache = debug_get_option_draw_no_vcache();
+   draw->pt.vertex_serial = 1;
 
    draw->pt.front.vsplit = draw_pt_vsplit(draw);
    if (!draw->pt.front.vsplit)
@@ -571,6 +589,7 @@ draw_vbo(struct draw_context *draw,
       }
 
       draw_new_instance(draw);
+      invalidate_vertices(draw);
 
       if (info->primitive_restart) {
          draw_pt_arrays_restart(draw, info);
@@ -28,6 +28,7 @@
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/u_prim.h"
+#include "util/u_queue.h"
 #include "draw/draw_context.h"
 #include "draw/draw_gs.h"
 #include "draw/draw_tess.h"
@@ -41,6 +42,35 @@
 #include "gallivm/lp_bld_debug.h"
 
 
+/** Number of shaded vertices kept in the post-transform vertex cache */
+#define LLVM_VCACHE_SIZE 1024
+/** Number of buckets of the vertex cache lookup, a power of two */
+#define LLVM_VCACHE_HASH_SIZE 2048
+
+
+/**
+ * Post-transform vertex cache.  The vsplit frontend only dedupes the
+ * elements of a single segment, this keeps the last shaded vertices of an
+ * indexed draw around so the segments following it don't shade shared
+ * vertices again.  Entries are replaced in FIFO order and are only valid
+ * while draw->pt.vertex_serial is unchanged.
+ */
+struct llvm_vertex_cache {
+   char *verts;
+   unsigned vertex_size;
+   unsigned next;
+
+   unsigned elts[LLVM_VCACHE_SIZE];
+   unsigned serials[LLVM_VCACHE_SIZE];
+   ushort slots[LLVM_VCACHE_HASH_SIZE];
+
+   /* elements and positions of the vertices missing in the cache */
+   unsigned *miss_elts;
+   unsigned *miss_pos;
+   unsigned miss_size;
+};
+
+
 struct llvm_middle_end {
    struct draw_pt_middle_end base;
    struct draw_context *draw;
@@ -58,6 +88,8 @@ struct llvm_middle_end {
 
    struct draw_llvm *llvm;
    struct draw_llvm_variant *current_variant;
+
+   struct llvm_vertex_cache vcache;
 };
 
 
@@ -554,6 +586,275 @@ emit(struct pt_emit *emit,
 }
 
 
+/** Minimum number of vertices worth handing to a vertex shading thread */
+#define LLVM_VS_JOB_MIN_VERTICES 128
+
+
+/**
+ * A range of the vertices of a draw, fetched and shaded by one call
+ * of the jit function.
+ */
+struct llvm_vs_job {
+   struct llvm_middle_end *fpme;
+   struct vertex_header *verts;
+   unsigned count;
+   unsigned start_or_maxelt;
+   unsigned vid_base;
+   const unsigned *elts;
+   unsigned fpstate;
+   boolean clipped;
+   struct util_queue_fence fence;
+};
+
+
+static boolean
+llvm_vs_job_run(const struct llvm_vs_job *job)
+{
+   struct llvm_middle_end *fpme = job->fpme;
+   struct draw_context *draw = fpme->draw;
+
+   return fpme->current_variant->jit_func(&fpme->llvm->jit_context,
+                                          job->verts,
+                                          draw->pt.user.vbuffer,
+                                          job->count,
+                                          job->start_or_maxelt,
+                                          fpme->vertex_size,
+                                          draw->pt.vertex_buffer,
+                                          draw->instance_id,
+                                          job->vid_base,
+                                          draw->start_instance,
+                                          job->elts, draw->pt.user.drawid);
+}
+
+
+static void
+llvm_vs_job_execute(void *data, int thread_index)
+{
+   struct llvm_vs_job *job = (struct llvm_vs_job *)data;
+
+   /* shade with the same rounding and denorm modes as the draw thread */
+   util_fpstate_set(job->fpstate);
+   job->clipped = llvm_vs_job_run(job);
+}
+
+
+/**
+ * Fetch and shade the vertices of a draw, including clip testing and
+ * viewport transform.  Large draws are cut into ranges shaded in parallel
+ * by the vertex shading threads, each writing its slice of the vertex
+ * buffer, so the result is the same as that of a single call and all the
+ * later stages still see the primitives in order.
+ */
+static boolean
+llvm_vs_run(struct llvm_middle_end *fpme,
+            struct vertex_header *verts,
+            unsigned count,
+            unsigned start_or_maxelt,
+            unsigned vid_base,
+            const unsigned *elts)
+{
+   struct draw_context *draw = fpme->draw;
+   struct llvm_vs_job jobs[DRAW_MAX_VS_THREADS + 1];
+   const unsigned vector_length = lp_native_vector_width / 32;
+   unsigned num_jobs, job_size, fpstate, i;
+   boolean clipped;
+
+   num_jobs = MIN2(draw->vs.num_threads + 1,
+                   count / LLVM_VS_JOB_MIN_VERTICES);
+   if (num_jobs <= 1) {
+      jobs[0].fpme = fpme;
+      jobs[0].verts = verts;
+      jobs[0].count = count;
+      jobs[0].start_or_maxelt = start_or_maxelt;
+      jobs[0].vid_base = vid_base;
+      jobs[0].elts = elts;
+      return llvm_vs_job_run(&jobs[0]);
+   }
+
+   /* keep the ranges vector aligned, the jit code writes whole vectors */
+   job_size = align(DIV_ROUND_UP(count, num_jobs), vector_length);
+   num_jobs = DIV_ROUND_UP(count, job_size);
+   fpstate = util_fpstate_get();
+
+   for (i = 0; i < num_jobs; i++) {
+      struct llvm_vs_job *job = &jobs[i];
+      unsigned first = i * job_size;
+
+      job->fpme = fpme;
+      job->verts = (struct vertex_header *)
+         ((char *)verts + first * fpme->vertex_size);
+      job->count = MIN2(job_size, count - first);
+      job->start_or_maxelt = elts ? start_or_maxelt : start_or_maxelt + first;
+      job->vid_base = vid_base;
+      job->elts = elts ? elts + first : NULL;
+      job->fpstate = fpstate;
+      job->clipped = FALSE;
+
+      /* the first range is shaded by this thread */
+      if (i > 0) {
+         util_queue_fence_init(&job->fence);
+         util_queue_add_job(draw->vs.queue, job, &job->fence,
+                            llvm_vs_job_execute, NULL, 0);
+      }
+   }
+
+   clipped = llvm_vs_job_run(&jobs[0]);
+
+   for (i = 1; i < num_jobs; i++) {
+      util_queue_fence_wait(&jobs[i].fence);
+      util_queue_fence_destroy(&jobs[i].fence);
+      clipped |= jobs[i].clipped;
+   }
+
+   return clipped;
+}
+
+
+static inline unsigned
+llvm_vcache_hash(unsigned elt)
+{
+   return elt & (LLVM_VCACHE_HASH_SIZE - 1);
+}
+
+
+/**
+ * Make room for a run of count vertices of the current size in the
+ * vertex cache, dropping its contents if the vertex layout changed.
+ */
+static boolean
+llvm_vcache_validate(struct llvm_middle_end *fpme, unsigned count)
+{
+   struct llvm_vertex_cache *cache = &fpme->vcache;
+
+   if (cache->vertex_size != fpme->vertex_size) {
+      FREE(cache->verts);
+      cache->verts = MALLOC(fpme->vertex_size * LLVM_VCACHE_SIZE);
+      if (!cache->verts) {
+         cache->vertex_size = 0;
+         return FALSE;
+      }
+      cache->vertex_size = fpme->vertex_size;
+      cache->next = 0;
+      memset(cache->serials, 0, sizeof(cache->serials));
+   }
+
+   if (cache->miss_size < count) {
+      FREE(cache->miss_elts);
+      FREE(cache->miss_pos);
+      cache->miss_elts = MALLOC(count * sizeof(unsigned));
+      cache->miss_pos = MALLOC(count * sizeof(unsigned));
+      if (!cache->miss_elts || !cache->miss_pos) {
+         FREE(cache->miss_elts);
+         FREE(cache->miss_pos);
+         cache->miss_elts = NULL;
+         cache->miss_pos = NULL;
+         cache->miss_size = 0;
+         return FALSE;
+      }
+      cache->miss_size = count;
+   }
+
+   return TRUE;
+}
+
+
+static void
+llvm_vcache_insert(struct llvm_vertex_cache *cache,
+                   unsigned serial,
+                   unsigned elt,
+                   const struct vertex_header *vert)
+{
+   unsigned slot = cache->next;
+
+   memcpy(cache->verts + slot * cache->vertex_size, vert, cache->vertex_size);
+   cache->elts[slot] = elt;
+   cache->serials[slot] = serial;
+   cache->slots[llvm_vcache_hash(elt)] = slot;
+   cache->next = (slot + 1) % LLVM_VCACHE_SIZE;
+}
+
+
+/**
+ * Like llvm_vs_run() for indexed fetches, but taking the vertices already
+ * shaded for earlier segments of the draw from the vertex cache.  Returns
+ * the number of vertices which actually went through the shader.
+ */
+static unsigned
+llvm_vs_run_cached(struct llvm_middle_end *fpme,
+                   struct vertex_header *verts,
+                   unsigned count,
+                   unsigned max_elt,
+                   unsigned elt_bias,
+                   const unsigned *elts,
+                   boolean *clipped)
+{
+   struct llvm_vertex_cache *cache = &fpme->vcache;
+   const unsigned serial = fpme->draw->pt.vertex_serial;
+   const unsigned vertex_size = fpme->vertex_size;
+   struct vertex_header *shaded;
+   unsigned num_miss = 0, i;
+
+   if (!llvm_vcache_validate(fpme, count)) {
+      *clipped = llvm_vs_run(fpme, verts, count, max_elt, elt_bias, elts);
+      return count;
+   }
+
+   *clipped = FALSE;
+
+   for (i = 0; i < count; i++) {
+      unsigned slot = cache->slots[llvm_vcache_hash(elts[i])];
+
+      if (cache->serials[slot] == serial && cache->elts[slot] == elts[i]) {
+         const struct vertex_header *hit = (const struct vertex_header *)
+            (cache->verts + slot * vertex_size);
+
+         memcpy((char *)verts + i * vertex_size, hit, vertex_size);
+         /* same as the jit function returns, see clipmask_booli8() */
+         *clipped |= hit->clipmask != 0 || !hit->edgeflag;
+      }
+      else {
+         cache->miss_elts[num_miss] = elts[i];
+         cache->miss_pos[num_miss] = i;
+         num_miss++;
+      }
+   }
+
+   if (num_miss == 0)
+      return 0;
+
+   if (num_miss == count) {
+      /* nothing to scatter, shade in place */
+      *clipped = llvm_vs_run(fpme, verts, count, max_elt, elt_bias, elts);
+      for (i = 0; i < count; i++) {
+         llvm_vcache_insert(cache, serial, elts[i], (struct vertex_header *)
+                            ((char *)verts + i * vertex_size));
+      }
+      return count;
+   }
+
+   shaded = MALLOC(vertex_size * align(num_miss, lp_native_vector_width / 32));
+   if (!shaded) {
+      *clipped = llvm_vs_run(fpme, verts, count, max_elt, elt_bias, elts);
+      return count;
+   }
+
+   *clipped |= llvm_vs_run(fpme, shaded, num_miss, max_elt, elt_bias,
+                           cache->miss_elts);
+
+   for (i = 0; i < num_miss; i++) {
+      const struct vertex_header *vert = (const struct vertex_header *)
+         ((char *)shaded + i * vertex_size);
+
+      memcpy((char *)verts + cache->miss_pos[i] * vertex_size, vert,
+             vertex_size);
+      llvm_vcache_insert(cache, serial, cache->miss_elts[i], vert);
+   }
+
+   FREE(shaded);
+   return num_miss;
+}
+
+
 static void
 llvm_pipeline_generic(struct draw_pt_middle_end *middle,
                       const struct draw_fetch_info *fetch_info,
@@ -578,7 +879,7 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
    boolean free_prim_info = FALSE;
    unsigned opt = fpme->opt;
    boolean clipped = 0;
-   unsigned start_or_maxelt, vid_base;
+   unsigned start_or_maxelt, vid_base, num_shaded;
    const unsigned *elts;
    ushort *tes_elts_out = NULL;
 
@@ -601,7 +902,6 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
       else
          draw->statistics.ia_primitives +=
             u_decomposed_prims_for_vertices(prim_info->prim, prim_info->count);
-      draw->statistics.vs_invocations += fetch_info->count;
    }
 
    if (fetch_info->linear) {
@@ -614,17 +914,20 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
       vid_base = draw->pt.user.eltBias;
       elts = fetch_info->elts;
    }
-   clipped = fpme->current_variant->jit_func(&fpme->llvm->jit_context,
-                                             llvm_vert_info.verts,
-                                             draw->pt.user.vbuffer,
-                                             fetch_info->count,
-                                             start_or_maxelt,
-                                             fpme->vertex_size,
-                                             draw->pt.vertex_buffer,
-                                             draw->instance_id,
-                                             vid_base,
-                                             draw->start_instance,
-                                             elts, draw->pt.user.drawid);
+   if (elts && !draw->pt.no_vcache) {
+      num_shaded = llvm_vs_run_cached(fpme, llvm_vert_info.verts,
+                                      fetch_info->count, start_or_maxelt,
+                                      vid_base, elts, &clipped);
+   }
+   else {
+      clipped = llvm_vs_run(fpme, llvm_vert_info.verts, fetch_info->count,
+                            start_or_maxelt, vid_base, elts);
+      num_shaded = fetch_info->count;
+   }
+
+   /* vertices found in the vertex cache are not invoked again */
+   if (draw->collect_statistics)
+      draw->statistics.vs_invocations += num_shaded;
 
    /* Finished with fetch and vs:
     */
@@ -893,6 +1196,10 @@ llvm_middle_end_destroy(struct draw_pt_middle_end *middle)
    if (fpme->post_vs)
       draw_pt_post_vs_destroy( fpme->post_vs );
 
+   FREE(fpme->vcache.verts);
+   FREE(fpme->vcache.miss_elts);
+   FREE(fpme->vcache.miss_pos);
+
    FREE(middle);
 }
 
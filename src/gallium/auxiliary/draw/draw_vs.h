@@ -204,7 +204,8 @@ static inline int draw_vs_variant_key_compare( const struct draw_vs_variant_key
 }
 
 
-#define MAX_TGSI_VERTICES 4
+/** Vertices shaded per tgsi_exec_machine_run() call */
+#define MAX_TGSI_VERTICES TGSI_EXEC_WIDTH
    
 
 
@@ -87,4 +87,13 @@
 #define GALLIVM_HAVE_CORO 0
 #endif
 
+/* ORC LLJIT with the interfaces lp_bld_misc.cpp relies on.  LLVM 15 moved
+ * symbol lookups to ExecutorAddr, which that code doesn't handle yet.
+ */
+#if LLVM_VERSION_MAJOR >= 13 && LLVM_VERSION_MAJOR <= 14
+#define GALLIVM_HAVE_ORCJIT 1
+#else
+#define GALLIVM_HAVE_ORCJIT 0
+#endif
+
 #endif /* LP_BLD_H */
@@ -26,6 +26,7 @@
 #include <stdint.h>
 #include "lp_bld_coro.h"
 #include "util/os_memory.h"
+#include "util/u_math.h"
 #include "lp_bld_init.h"
 #include "lp_bld_const.h"
 #include "lp_bld_intr.h"
@@ -142,50 +143,129 @@ LLVMValueRef lp_build_coro_alloc(struct gallivm_state *gallivm, LLVMValueRef id)
                              &id, 1, 0);
 }
 
+/**
+ * Mark a function as a coroutine which hasn't been split yet.  Since LLVM 14
+ * CoroSplit only splits functions the frontend marked, before that
+ * CoroEarly marked them itself.  LLVM 14 looks for the coroutine.presplit
+ * string attribute, LLVM 15 replaced it with the presplitcoroutine enum
+ * attribute.
+ */
+void lp_build_coro_add_presplit(LLVMValueRef coro)
+{
+#if LLVM_VERSION_MAJOR >= 15
+   lp_add_function_attr(coro, -1, LP_FUNC_ATTR_PRESPLITCOROUTINE);
+#elif LLVM_VERSION_MAJOR >= 14
+   LLVMAddTargetDependentFunctionAttr(coro, "coroutine.presplit", "0");
+#else
+   (void)coro;
+#endif
+}
+
+/**
+ * Allocate a coroutine frame, from the pool if there is one and it has
+ * space left.  Frames which don't fit anymore come from the heap, and
+ * the pool grows to fit all of them once its frames are all freed.
+ */
 static char *
-coro_malloc(int size)
+coro_malloc(struct lp_build_coro_frame_pool *pool, int size)
 {
-   return os_malloc_aligned(size, 4096);
+   unsigned aligned = align(size, LP_CORO_FRAME_ALIGN);
+
+   if (!pool)
+      return os_malloc_aligned(size, 4096);
+
+   pool->live++;
+   pool->demand += aligned;
+
+   if (pool->used + aligned <= pool->size) {
+      char *frame = pool->mem + pool->used;
+      pool->used += aligned;
+      return frame;
+   }
+
+   return os_malloc_aligned(aligned, LP_CORO_FRAME_ALIGN);
 }
 
 static void
-coro_free(char *ptr)
+coro_free(struct lp_build_coro_frame_pool *pool, char *ptr)
 {
-   os_free_aligned(ptr);
+   if (!pool) {
+      os_free_aligned(ptr);
+      return;
+   }
+
+   /* llvm.coro.free gives NULL for frames LLVM didn't let us allocate */
+   if (!ptr)
+      return;
+
+   if (ptr < pool->mem || ptr >= pool->mem + pool->size)
+      os_free_aligned(ptr);
+
+   assert(pool->live > 0);
+   if (--pool->live == 0) {
+      if (pool->demand > pool->size) {
+         os_free_aligned(pool->mem);
+         pool->mem = os_malloc_aligned(pool->demand, LP_CORO_FRAME_ALIGN);
+         pool->size = pool->mem ? pool->demand : 0;
+      }
+      pool->used = 0;
+      pool->demand = 0;
+   }
 }
 
-void lp_build_coro_add_malloc_hooks(struct gallivm_state *gallivm)
+void lp_build_coro_frame_pool_release(struct lp_build_coro_frame_pool *pool)
 {
-   assert(gallivm->engine);
+   assert(pool->live == 0);
+   os_free_aligned(pool->mem);
+   memset(pool, 0, sizeof(*pool));
+}
 
+void lp_build_coro_add_malloc_hooks(struct gallivm_state *gallivm)
+{
    assert(gallivm->coro_malloc_hook);
    assert(gallivm->coro_free_hook);
-   LLVMAddGlobalMapping(gallivm->engine, gallivm->coro_malloc_hook, coro_malloc);
-   LLVMAddGlobalMapping(gallivm->engine, gallivm->coro_free_hook, coro_free);
+   gallivm_add_global_mapping(gallivm, gallivm->coro_malloc_hook, coro_malloc);
+   gallivm_add_global_mapping(gallivm, gallivm->coro_free_hook, coro_free);
 }
 
 void lp_build_coro_declare_malloc_hooks(struct gallivm_state *gallivm)
 {
    LLVMTypeRef int32_type = LLVMInt32TypeInContext(gallivm->context);
    LLVMTypeRef mem_ptr_type = LLVMPointerType(LLVMInt8TypeInContext(gallivm->context), 0);
-   LLVMTypeRef malloc_type = LLVMFunctionType(mem_ptr_type, &int32_type, 1, 0);
+   LLVMTypeRef malloc_args[2] = { mem_ptr_type, int32_type };
+   LLVMTypeRef malloc_type = LLVMFunctionType(mem_ptr_type, malloc_args, 2, 0);
    gallivm->coro_malloc_hook = LLVMAddFunction(gallivm->module, "coro_malloc", malloc_type);
-   LLVMTypeRef free_type = LLVMFunctionType(LLVMVoidTypeInContext(gallivm->context), &mem_ptr_type, 1, 0);
+   LLVMTypeRef free_args[2] = { mem_ptr_type, mem_ptr_type };
+   LLVMTypeRef free_type = LLVMFunctionType(LLVMVoidTypeInContext(gallivm->context), free_args, 2, 0);
    gallivm->coro_free_hook = LLVMAddFunction(gallivm->module, "coro_free", free_type);
 }
 
-LLVMValueRef lp_build_coro_begin_alloc_mem(struct gallivm_state *gallivm, LLVMValueRef coro_id)
+static LLVMValueRef
+coro_frame_pool_arg(struct gallivm_state *gallivm, LLVMValueRef frame_pool)
+{
+   LLVMTypeRef mem_ptr_type = LLVMPointerType(LLVMInt8TypeInContext(gallivm->context), 0);
+
+   if (!frame_pool)
+      return LLVMConstPointerNull(mem_ptr_type);
+   return LLVMBuildBitCast(gallivm->builder, frame_pool, mem_ptr_type, "");
+}
+
+LLVMValueRef lp_build_coro_begin_alloc_mem(struct gallivm_state *gallivm, LLVMValueRef coro_id,
+                                           LLVMValueRef frame_pool)
 {
    LLVMValueRef do_alloc = lp_build_coro_alloc(gallivm, coro_id);
    LLVMTypeRef mem_ptr_type = LLVMPointerType(LLVMInt8TypeInContext(gallivm->context), 0);
    LLVMValueRef alloc_mem_store = lp_build_alloca(gallivm, mem_ptr_type, "coro mem");
    struct lp_build_if_state if_state_coro;
    lp_build_if(&if_state_coro, gallivm, do_alloc);
-   LLVMValueRef coro_size = lp_build_coro_size(gallivm);
+   LLVMValueRef malloc_args[2];
    LLVMValueRef alloc_mem;
 
+   malloc_args[0] = coro_frame_pool_arg(gallivm, frame_pool);
+   malloc_args[1] = lp_build_coro_size(gallivm);
+
    assert(gallivm->coro_malloc_hook);
-   alloc_mem = LLVMBuildCall(gallivm->builder, gallivm->coro_malloc_hook, &coro_size, 1, "");
+   alloc_mem = LLVMBuildCall(gallivm->builder, gallivm->coro_malloc_hook, malloc_args, 2, "");
 
    LLVMBuildStore(gallivm->builder, alloc_mem, alloc_mem_store);
    lp_build_endif(&if_state_coro);
@@ -194,12 +274,16 @@ LLVMValueRef lp_build_coro_begin_alloc_mem(struct gallivm_state *gallivm, LLVMVa
    return coro_hdl;
 }
 
-void lp_build_coro_free_mem(struct gallivm_state *gallivm, LLVMValueRef coro_id, LLVMValueRef coro_hdl)
+void lp_build_coro_free_mem(struct gallivm_state *gallivm, LLVMValueRef coro_id, LLVMValueRef coro_hdl,
+                            LLVMValueRef frame_pool)
 {
-   LLVMValueRef alloc_mem = lp_build_coro_free(gallivm, coro_id, coro_hdl);
+   LLVMValueRef free_args[2];
 
-   assert(gallivm->coro_malloc_hook);
-   alloc_mem = LLVMBuildCall(gallivm->builder, gallivm->coro_free_hook, &alloc_mem, 1, "");
+   free_args[0] = coro_frame_pool_arg(gallivm, frame_pool);
+   free_args[1] = lp_build_coro_free(gallivm, coro_id, coro_hdl);
+
+   assert(gallivm->coro_free_hook);
+   LLVMBuildCall(gallivm->builder, gallivm->coro_free_hook, free_args, 2, "");
 }
 
 void lp_build_coro_suspend_switch(struct gallivm_state *gallivm, const struct lp_build_coro_suspend_info *sus_info,
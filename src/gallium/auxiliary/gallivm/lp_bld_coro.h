@@ -54,8 +54,33 @@ LLVMValueRef lp_build_coro_suspend(struct gallivm_state *gallivm, bool last);
 
 LLVMValueRef lp_build_coro_alloc(struct gallivm_state *gallivm, LLVMValueRef id);
 
-LLVMValueRef lp_build_coro_begin_alloc_mem(struct gallivm_state *gallivm, LLVMValueRef coro_id);
-void lp_build_coro_free_mem(struct gallivm_state *gallivm, LLVMValueRef coro_id, LLVMValueRef coro_hdl);
+void lp_build_coro_add_presplit(LLVMValueRef coro);
+
+/*
+ * Coroutine frames allocated by the code in between two points in time
+ * where none are live, like the invocations of a compute shader workgroup.
+ * Every thread running such code gets its own pool, frames are handed out
+ * from a single block and the pool only touches the heap while it grows.
+ */
+#define LP_CORO_FRAME_ALIGN 64
+
+struct lp_build_coro_frame_pool {
+   char *mem;
+   unsigned size;     /* bytes at mem */
+   unsigned used;     /* bytes of mem handed out */
+   unsigned live;     /* frames not freed yet */
+   unsigned demand;   /* bytes of frames allocated since the pool was empty */
+};
+
+void lp_build_coro_frame_pool_release(struct lp_build_coro_frame_pool *pool);
+
+/* frame_pool is a pointer to a struct lp_build_coro_frame_pool, or NULL to
+ * allocate the frame from the heap.
+ */
+LLVMValueRef lp_build_coro_begin_alloc_mem(struct gallivm_state *gallivm, LLVMValueRef coro_id,
+                                           LLVMValueRef frame_pool);
+void lp_build_coro_free_mem(struct gallivm_state *gallivm, LLVMValueRef coro_id, LLVMValueRef coro_hdl,
+                            LLVMValueRef frame_pool);
 
 struct lp_build_coro_suspend_info {
    LLVMBasicBlockRef suspend;
@@ -26,6 +26,20 @@
  **************************************************************************/
 
 
+#include "util/format/u_format.h"
+#include "util/u_math.h"
+#include "util/u_pointer.h"
+#include "util/u_string.h"
+
+#include "lp_bld_const.h"
+#include "lp_bld_debug.h"
+#include "lp_bld_flow.h"
+#include "lp_bld_intr.h"
+#include "lp_bld_misc.h"
+#include "lp_bld_pack.h"
+#include "lp_bld_struct.h"
+#include "lp_bld_swizzle.h"
+#include "lp_bld_type.h"
 #include "lp_bld_format.h"
 
 
@@ -42,15 +56,484 @@ lp_build_format_cache_type(struct gallivm_state *gallivm)
    elem_types[LP_BUILD_FORMAT_CACHE_MEMBER_TAGS] =
          LLVMArrayType(LLVMInt64TypeInContext(gallivm->context),
                        LP_BUILD_FORMAT_CACHE_SIZE);
-#if LP_BUILD_FORMAT_CACHE_DEBUG
+   elem_types[LP_BUILD_FORMAT_CACHE_MEMBER_FORMATS] =
+         LLVMArrayType(LLVMInt32TypeInContext(gallivm->context),
+                       LP_BUILD_FORMAT_CACHE_SIZE);
+   elem_types[LP_BUILD_FORMAT_CACHE_MEMBER_VICTIM] =
+         LLVMArrayType(LLVMInt32TypeInContext(gallivm->context),
+                       LP_BUILD_FORMAT_CACHE_SETS);
    elem_types[LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_TOTAL] =
          LLVMInt64TypeInContext(gallivm->context);
    elem_types[LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_MISS] =
          LLVMInt64TypeInContext(gallivm->context);
-#endif
 
    s = LLVMStructTypeInContext(gallivm->context, elem_types,
                                LP_BUILD_FORMAT_CACHE_MEMBER_COUNT, 0);
 
    return s;
 }
+
+
+/**
+ * Whether the texels of a format can be fetched through the block cache,
+ * i.e. it is a 4x4 block compressed format which decodes to rgba8.
+ */
+boolean
+lp_build_format_cache_supported(const struct util_format_description *format_desc)
+{
+   if (format_desc->block.width != 4 || format_desc->block.height != 4)
+      return FALSE;
+
+   switch (format_desc->layout) {
+   case UTIL_FORMAT_LAYOUT_S3TC:
+   case UTIL_FORMAT_LAYOUT_RGTC:
+      return TRUE;
+   case UTIL_FORMAT_LAYOUT_ETC:
+   case UTIL_FORMAT_LAYOUT_BPTC:
+      return format_desc->unpack_rgba_8unorm != NULL &&
+             util_format_fits_8unorm(format_desc);
+   default:
+      return FALSE;
+   }
+}
+
+
+static LLVMValueRef
+lp_build_format_cache_elem_ptr(struct gallivm_state *gallivm,
+                               LLVMValueRef cache,
+                               unsigned member,
+                               LLVMValueRef index)
+{
+   LLVMValueRef indices[3];
+
+   indices[0] = lp_build_const_int32(gallivm, 0);
+   indices[1] = lp_build_const_int32(gallivm, member);
+   indices[2] = index;
+   return LLVMBuildGEP(gallivm->builder, cache, indices, ARRAY_SIZE(indices), "");
+}
+
+
+static void
+lp_build_format_cache_count(struct gallivm_state *gallivm,
+                            LLVMValueRef cache,
+                            unsigned member,
+                            unsigned count)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef member_ptr, cache_access;
+
+   assert(member == LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_TOTAL ||
+          member == LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_MISS);
+
+   member_ptr = lp_build_struct_get_ptr(gallivm, cache, member, "");
+   cache_access = LLVMBuildLoad(builder, member_ptr, "cache_access");
+   cache_access = LLVMBuildAdd(builder, cache_access,
+                               LLVMConstInt(LLVMInt64TypeInContext(gallivm->context),
+                                            count, 0), "");
+   LLVMBuildStore(builder, cache_access, member_ptr);
+}
+
+
+/**
+ * Decode a block into the 4 column vectors of rgba8 texels stored in the
+ * cache.  S3TC has a dedicated whole block decoder, ETC and BPTC are
+ * unpacked by util_format, RGTC is fetched as 16 texels of the block with
+ * the uncached AoS path.
+ */
+static void
+lp_build_format_cache_decode_block(struct gallivm_state *gallivm,
+                                   const struct util_format_description *format_desc,
+                                   LLVMValueRef ptr,
+                                   LLVMValueRef col[4])
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_type texel_type, i32_type;
+   LLVMValueRef i_elems[16], j_elems[16];
+   LLVMValueRef offset, i, j, rgba;
+   unsigned k;
+
+   if (format_desc->layout == UTIL_FORMAT_LAYOUT_S3TC) {
+      lp_build_s3tc_decode_block(gallivm, format_desc, ptr, col);
+      return;
+   }
+
+   if (format_desc->layout == UTIL_FORMAT_LAYOUT_ETC ||
+       format_desc->layout == UTIL_FORMAT_LAYOUT_BPTC) {
+      LLVMTypeRef pi8t = LLVMPointerType(LLVMInt8TypeInContext(gallivm->context), 0);
+      LLVMTypeRef i32t = LLVMInt32TypeInContext(gallivm->context);
+      LLVMTypeRef arg_types[6];
+      LLVMValueRef function, tmp_ptr, args[6], rows[4];
+
+      /*
+       * Function to call looks like:
+       *   unpack(uint8_t *dst, unsigned dst_stride,
+       *          const uint8_t *src, unsigned src_stride,
+       *          unsigned width, unsigned height)
+       */
+      arg_types[0] = pi8t;
+      arg_types[1] = i32t;
+      arg_types[2] = pi8t;
+      arg_types[3] = i32t;
+      arg_types[4] = i32t;
+      arg_types[5] = i32t;
+
+      if (gallivm->cache)
+         gallivm->cache->dont_cache = true;
+      function = lp_build_const_func_pointer(gallivm,
+                                             func_to_pointer((func_pointer) format_desc->unpack_rgba_8unorm),
+                                             LLVMVoidTypeInContext(gallivm->context),
+                                             arg_types, ARRAY_SIZE(arg_types),
+                                             format_desc->short_name);
+
+      tmp_ptr = lp_build_array_alloca(gallivm, LLVMVectorType(i32t, 4),
+                                      lp_build_const_int32(gallivm, 4), "");
+
+      args[0] = LLVMBuildBitCast(builder, tmp_ptr, pi8t, "");
+      args[1] = lp_build_const_int32(gallivm, 16);
+      args[2] = ptr;
+      args[3] = lp_build_const_int32(gallivm, format_desc->block.bits / 8);
+      args[4] = lp_build_const_int32(gallivm, 4);
+      args[5] = lp_build_const_int32(gallivm, 4);
+      LLVMBuildCall(builder, function, args, ARRAY_SIZE(args), "");
+
+      /* unpacked row by row */
+      for (k = 0; k < 4; k++) {
+         LLVMValueRef index = lp_build_const_int32(gallivm, k);
+         rows[k] = LLVMBuildLoad(builder,
+                                 LLVMBuildGEP(builder, tmp_ptr, &index, 1, ""),
+                                 "");
+      }
+      lp_build_transpose_aos(gallivm, lp_type_int_vec(32, 128), rows, col);
+      return;
+   }
+
+   memset(&texel_type, 0, sizeof texel_type);
+   texel_type.width = 8;
+   texel_type.length = 16 * 4;
+   texel_type.norm = TRUE;
+   texel_type.sign = util_format_is_snorm(format_desc->format);
+
+   i32_type = lp_type_int_vec(32, 32 * 16);
+
+   /* column by column, matching the cache layout */
+   for (k = 0; k < 16; k++) {
+      i_elems[k] = lp_build_const_int32(gallivm, k / 4);
+      j_elems[k] = lp_build_const_int32(gallivm, k % 4);
+   }
+   i = LLVMConstVector(i_elems, 16);
+   j = LLVMConstVector(j_elems, 16);
+   offset = lp_build_const_int_vec(gallivm, i32_type, 0);
+
+   rgba = lp_build_fetch_rgba_aos(gallivm, format_desc, texel_type, FALSE,
+                                  ptr, offset, i, j, NULL);
+   rgba = LLVMBuildBitCast(builder, rgba,
+                           lp_build_vec_type(gallivm, i32_type), "");
+   for (k = 0; k < 4; k++) {
+      col[k] = lp_build_extract_range(gallivm, rgba, k * 4, 4);
+   }
+}
+
+
+/**
+ * Generate the function filling a cache slot on a miss.  It evicts the
+ * ways of a set in round robin order and returns the slot it filled.
+ */
+static void
+generate_update_cache_one_block(struct gallivm_state *gallivm,
+                                LLVMValueRef function,
+                                const struct util_format_description *format_desc)
+{
+   LLVMBasicBlockRef block;
+   LLVMBuilderRef old_builder, builder;
+   LLVMValueRef ptr_addr, set_index, cache;
+   LLVMValueRef victim_ptr, way, way_mask, next_way, slot, index, ptr;
+   LLVMValueRef tag_value;
+   LLVMValueRef col[4];
+   LLVMTypeRef type_ptr4x32;
+   unsigned count;
+
+   ptr_addr  = LLVMGetParam(function, 0);
+   set_index = LLVMGetParam(function, 1);
+   cache     = LLVMGetParam(function, 2);
+
+   lp_build_name(ptr_addr,  "ptr_addr"  );
+   lp_build_name(set_index, "set_index" );
+   lp_build_name(cache,     "cache_addr");
+
+   /*
+    * Function body
+    */
+
+   old_builder = gallivm->builder;
+   block = LLVMAppendBasicBlockInContext(gallivm->context, function, "entry");
+   gallivm->builder = builder = LLVMCreateBuilderInContext(gallivm->context);
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   victim_ptr = lp_build_format_cache_elem_ptr(gallivm, cache,
+                                               LP_BUILD_FORMAT_CACHE_MEMBER_VICTIM,
+                                               set_index);
+   way_mask = lp_build_const_int32(gallivm, LP_BUILD_FORMAT_CACHE_WAYS - 1);
+   /* masked since the victims are never initialized */
+   way = LLVMBuildLoad(builder, victim_ptr, "");
+   way = LLVMBuildAnd(builder, way, way_mask, "way");
+   next_way = LLVMBuildAdd(builder, way, lp_build_const_int32(gallivm, 1), "");
+   LLVMBuildStore(builder, LLVMBuildAnd(builder, next_way, way_mask, ""),
+                  victim_ptr);
+
+   slot = LLVMBuildMul(builder, set_index,
+                       lp_build_const_int32(gallivm, LP_BUILD_FORMAT_CACHE_WAYS), "");
+   slot = LLVMBuildAdd(builder, slot, way, "slot");
+
+   lp_build_format_cache_decode_block(gallivm, format_desc, ptr_addr, col);
+
+   tag_value = LLVMBuildPtrToInt(builder, ptr_addr,
+                                 LLVMInt64TypeInContext(gallivm->context), "");
+   ptr = lp_build_format_cache_elem_ptr(gallivm, cache,
+                                        LP_BUILD_FORMAT_CACHE_MEMBER_TAGS, slot);
+   LLVMBuildStore(builder, tag_value, ptr);
+   ptr = lp_build_format_cache_elem_ptr(gallivm, cache,
+                                        LP_BUILD_FORMAT_CACHE_MEMBER_FORMATS, slot);
+   LLVMBuildStore(builder, lp_build_const_int32(gallivm, format_desc->format),
+                  ptr);
+
+   type_ptr4x32 = LLVMPointerType(LLVMVectorType(LLVMInt32TypeInContext(gallivm->context), 4), 0);
+   index = LLVMBuildMul(builder, slot, lp_build_const_int32(gallivm, 16), "");
+   for (count = 0; count < 4; count++) {
+      ptr = lp_build_format_cache_elem_ptr(gallivm, cache,
+                                           LP_BUILD_FORMAT_CACHE_MEMBER_DATA, index);
+      ptr = LLVMBuildBitCast(builder, ptr, type_ptr4x32, "");
+      LLVMBuildStore(builder, col[count], ptr);
+      index = LLVMBuildAdd(builder, index, lp_build_const_int32(gallivm, 4), "");
+   }
+
+   lp_build_format_cache_count(gallivm, cache,
+                               LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_MISS, 1);
+
+   LLVMBuildRet(builder, slot);
+
+   LLVMDisposeBuilder(builder);
+   gallivm->builder = old_builder;
+
+   gallivm_verify_function(gallivm, function);
+}
+
+
+static LLVMValueRef
+update_cached_block(struct gallivm_state *gallivm,
+                    const struct util_format_description *format_desc,
+                    LLVMValueRef ptr_addr,
+                    LLVMValueRef set_index,
+                    LLVMValueRef cache)
+
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMModuleRef module = gallivm->module;
+   char name[256];
+   LLVMTypeRef i8t = LLVMInt8TypeInContext(gallivm->context);
+   LLVMTypeRef i32t = LLVMInt32TypeInContext(gallivm->context);
+   LLVMValueRef function, slot;
+   LLVMValueRef args[3];
+
+   snprintf(name, sizeof name, "%s_update_cache_one_block",
+            format_desc->short_name);
+   function = LLVMGetNamedFunction(module, name);
+
+   if (!function) {
+      LLVMTypeRef arg_types[3];
+      LLVMTypeRef function_type;
+      unsigned arg;
+
+      /*
+       * Generate the function prototype.
+       */
+
+      arg_types[0] = LLVMPointerType(i8t, 0);
+      arg_types[1] = i32t;
+      arg_types[2] = LLVMTypeOf(cache);
+      function_type = LLVMFunctionType(i32t, arg_types, ARRAY_SIZE(arg_types), 0);
+      function = LLVMAddFunction(module, name, function_type);
+
+      for (arg = 0; arg < ARRAY_SIZE(arg_types); ++arg)
+         if (LLVMGetTypeKind(arg_types[arg]) == LLVMPointerTypeKind)
+            lp_add_function_attr(function, arg + 1, LP_FUNC_ATTR_NOALIAS);
+
+      LLVMSetFunctionCallConv(function, LLVMFastCallConv);
+      LLVMSetVisibility(function, LLVMHiddenVisibility);
+      generate_update_cache_one_block(gallivm, function, format_desc);
+   }
+
+   args[0] = ptr_addr;
+   args[1] = set_index;
+   args[2] = cache;
+
+   slot = LLVMBuildCall(builder, function, args, ARRAY_SIZE(args), "");
+   LLVMSetInstructionCallConv(slot, LLVMFastCallConv);
+   return slot;
+}
+
+
+/**
+ * Fetch texels of a block compressed format through the block cache.
+ *
+ * The set of a block is a hash of its address.  Its ways are searched
+ * for the block address, on a miss the whole block is decoded into one
+ * of them.  Only the texel lookup is inline, misses go through a
+ * function per format.
+ *
+ * @param n  number of pixels processed (n=1 or multiples of 4)
+ * @param base_ptr  base pointer of the texture
+ * @param offset  <n x i32> vector with the relative offsets of the blocks
+ * @param i  is a <n x i32> vector with the x subpixel coordinate (0..3)
+ * @param j  is a <n x i32> vector with the y subpixel coordinate (0..3)
+ * @param cache  pointer to a lp_build_format_cache structure
+ * @return  a <4*n x i8> vector with the pixel RGBA values in AoS
+ */
+LLVMValueRef
+lp_build_fetch_cached_texels(struct gallivm_state *gallivm,
+                             const struct util_format_description *format_desc,
+                             unsigned n,
+                             LLVMValueRef base_ptr,
+                             LLVMValueRef offset,
+                             LLVMValueRef i,
+                             LLVMValueRef j,
+                             LLVMValueRef cache)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   unsigned count, way, low_bit, log2sets;
+   LLVMValueRef color, addr, ptr_addrtrunc, tmp;
+   LLVMValueRef ij_index, set_index, set_mask, slot_var, format_const;
+   LLVMTypeRef i8t = LLVMInt8TypeInContext(gallivm->context);
+   LLVMTypeRef i32t = LLVMInt32TypeInContext(gallivm->context);
+   LLVMTypeRef i64t = LLVMInt64TypeInContext(gallivm->context);
+   struct lp_type type;
+   struct lp_build_context bld32;
+
+   STATIC_ASSERT(util_is_power_of_two_nonzero(LP_BUILD_FORMAT_CACHE_SETS));
+   STATIC_ASSERT(util_is_power_of_two_nonzero(LP_BUILD_FORMAT_CACHE_WAYS));
+
+   assert(lp_build_format_cache_supported(format_desc));
+   assert((n == 1) || (n % 4 == 0));
+
+   memset(&type, 0, sizeof type);
+   type.width = 32;
+   type.length = n;
+
+   lp_build_context_init(&bld32, gallivm, type);
+
+   /*
+    * compute the set - the hash function could be better but it needs
+    * to be simple.  First mask off the unused lowest bits, then just do
+    * some xor with address bits - only use lower 32bits.
+    */
+
+   low_bit = util_logbase2(format_desc->block.bits / 8);
+   log2sets = util_logbase2(LP_BUILD_FORMAT_CACHE_SETS);
+   addr = LLVMBuildPtrToInt(builder, base_ptr, i64t, "");
+   ptr_addrtrunc = LLVMBuildPtrToInt(builder, base_ptr, i32t, "");
+   ptr_addrtrunc = lp_build_broadcast_scalar(&bld32, ptr_addrtrunc);
+   ptr_addrtrunc = LLVMBuildAdd(builder, offset, ptr_addrtrunc, "");
+   ptr_addrtrunc = LLVMBuildLShr(builder, ptr_addrtrunc,
+                                 lp_build_const_int_vec(gallivm, type, low_bit), "");
+   set_index = ptr_addrtrunc;
+   ptr_addrtrunc = LLVMBuildLShr(builder, ptr_addrtrunc,
+                                 lp_build_const_int_vec(gallivm, type, 2*log2sets), "");
+   set_index = LLVMBuildXor(builder, ptr_addrtrunc, set_index, "");
+   tmp = LLVMBuildLShr(builder, set_index,
+                       lp_build_const_int_vec(gallivm, type, log2sets), "");
+   set_index = LLVMBuildXor(builder, set_index, tmp, "");
+
+   set_mask = lp_build_const_int_vec(gallivm, type, LP_BUILD_FORMAT_CACHE_SETS - 1);
+   set_index = LLVMBuildAnd(builder, set_index, set_mask, "");
+
+   /* texels are stored column by column */
+   ij_index = LLVMBuildShl(builder, i, lp_build_const_int_vec(gallivm, type, 2), "");
+   ij_index = LLVMBuildAdd(builder, ij_index, j, "");
+
+   slot_var = lp_build_alloca(gallivm, i32t, "slot");
+   format_const = lp_build_const_int32(gallivm, format_desc->format);
+
+   /*
+    * per-element:
+    *    compare the block address and format with the ways of its set
+    *    if none matches decode the block into the set
+    *    extract color from cache
+    *    assemble colors
+    */
+   color = bld32.undef;
+   for (count = 0; count < n; count++) {
+      LLVMValueRef index, hit, slot, colorx, ptr;
+      LLVMValueRef set_indexx, ij_indexx, addrx, offsetx, first_slot;
+      struct lp_build_if_state if_ctx;
+
+      index = lp_build_const_int32(gallivm, count);
+      if (n > 1) {
+         offsetx = LLVMBuildExtractElement(builder, offset, index, "");
+         set_indexx = LLVMBuildExtractElement(builder, set_index, index, "");
+         ij_indexx = LLVMBuildExtractElement(builder, ij_index, index, "");
+      }
+      else {
+         offsetx = offset;
+         set_indexx = set_index;
+         ij_indexx = ij_index;
+      }
+      addrx = LLVMBuildZExt(builder, offsetx, i64t, "");
+      addrx = LLVMBuildAdd(builder, addrx, addr, "");
+
+      first_slot = LLVMBuildMul(builder, set_indexx,
+                                lp_build_const_int32(gallivm, LP_BUILD_FORMAT_CACHE_WAYS), "");
+      hit = LLVMConstInt(LLVMInt1TypeInContext(gallivm->context), 0, 0);
+      slot = first_slot;
+      for (way = 0; way < LP_BUILD_FORMAT_CACHE_WAYS; way++) {
+         LLVMValueRef way_slot, tag, format, match;
+
+         way_slot = LLVMBuildAdd(builder, first_slot,
+                                 lp_build_const_int32(gallivm, way), "");
+         ptr = lp_build_format_cache_elem_ptr(gallivm, cache,
+                                              LP_BUILD_FORMAT_CACHE_MEMBER_TAGS,
+                                              way_slot);
+         tag = LLVMBuildLoad(builder, ptr, "tag_data");
+         ptr = lp_build_format_cache_elem_ptr(gallivm, cache,
+                                              LP_BUILD_FORMAT_CACHE_MEMBER_FORMATS,
+                                              way_slot);
+         format = LLVMBuildLoad(builder, ptr, "tag_format");
+         match = LLVMBuildAnd(builder,
+                              LLVMBuildICmp(builder, LLVMIntEQ, tag, addrx, ""),
+                              LLVMBuildICmp(builder, LLVMIntEQ, format,
+                                            format_const, ""), "");
+         slot = LLVMBuildSelect(builder, match, way_slot, slot, "");
+         hit = LLVMBuildOr(builder, hit, match, "");
+      }
+      LLVMBuildStore(builder, slot, slot_var);
+
+      lp_build_if(&if_ctx, gallivm, LLVMBuildNot(builder, hit, ""));
+      {
+         LLVMValueRef ptr_addrx;
+
+         ptr_addrx = LLVMBuildIntToPtr(builder, addrx,
+                                       LLVMPointerType(i8t, 0), "");
+         slot = update_cached_block(gallivm, format_desc, ptr_addrx,
+                                    set_indexx, cache);
+         LLVMBuildStore(builder, slot, slot_var);
+      }
+      lp_build_endif(&if_ctx);
+
+      slot = LLVMBuildLoad(builder, slot_var, "");
+      slot = LLVMBuildShl(builder, slot, lp_build_const_int32(gallivm, 4), "");
+      slot = LLVMBuildAdd(builder, slot, ij_indexx, "");
+      ptr = lp_build_format_cache_elem_ptr(gallivm, cache,
+                                           LP_BUILD_FORMAT_CACHE_MEMBER_DATA, slot);
+      colorx = LLVMBuildLoad(builder, ptr, "cache_data");
+
+      if (n > 1) {
+         color = LLVMBuildInsertElement(builder, color, colorx, index, "");
+      }
+      else {
+         color = colorx;
+      }
+   }
+
+   lp_build_format_cache_count(gallivm, cache,
+                               LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_TOTAL, n);
+
+   return LLVMBuildBitCast(builder, color, LLVMVectorType(i8t, n * 4), "");
+}
@@ -44,37 +44,51 @@ struct lp_type;
 struct lp_build_context;
 
 
-#define LP_BUILD_FORMAT_CACHE_DEBUG 0
 /*
  * Block cache
  *
- * Optional block cache to be used when unpacking big pixel blocks.
- * Must be a power of 2
+ * Optional cache of decoded 4x4 blocks of compressed formats, kept as
+ * rgba8 texels, to be used when unpacking big pixel blocks.
+ * LP_BUILD_FORMAT_CACHE_SIZE blocks are organized in sets of
+ * LP_BUILD_FORMAT_CACHE_WAYS blocks, both must be powers of 2.
  */
 
-#define LP_BUILD_FORMAT_CACHE_SIZE 128
+#ifndef LP_BUILD_FORMAT_CACHE_SIZE
+#define LP_BUILD_FORMAT_CACHE_SIZE 256
+#endif
+
+#ifndef LP_BUILD_FORMAT_CACHE_WAYS
+#define LP_BUILD_FORMAT_CACHE_WAYS 4
+#endif
+
+#define LP_BUILD_FORMAT_CACHE_SETS \
+   (LP_BUILD_FORMAT_CACHE_SIZE / LP_BUILD_FORMAT_CACHE_WAYS)
 
 /*
  * Note: cache_data needs 16 byte alignment.
+ * The texels of a block are stored column by column, the tags are the
+ * block addresses, with the ways of a set next to each other.  A zero tag
+ * is an empty way.  Each block also records the format it was decoded as,
+ * so that views of the same memory with other formats don't hit.
  */
 struct lp_build_format_cache
 {
    PIPE_ALIGN_VAR(16) uint32_t cache_data[LP_BUILD_FORMAT_CACHE_SIZE][4][4];
    uint64_t cache_tags[LP_BUILD_FORMAT_CACHE_SIZE];
-#if LP_BUILD_FORMAT_CACHE_DEBUG
+   uint32_t cache_formats[LP_BUILD_FORMAT_CACHE_SIZE]; /**< enum pipe_format */
+   uint32_t cache_victim[LP_BUILD_FORMAT_CACHE_SETS]; /**< next way to evict */
    uint64_t cache_access_total;
    uint64_t cache_access_miss;
-#endif
 };
 
 
 enum {
    LP_BUILD_FORMAT_CACHE_MEMBER_DATA = 0,
    LP_BUILD_FORMAT_CACHE_MEMBER_TAGS,
-#if LP_BUILD_FORMAT_CACHE_DEBUG
+   LP_BUILD_FORMAT_CACHE_MEMBER_FORMATS,
+   LP_BUILD_FORMAT_CACHE_MEMBER_VICTIM,
    LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_TOTAL,
    LP_BUILD_FORMAT_CACHE_MEMBER_ACCESS_MISS,
-#endif
    LP_BUILD_FORMAT_CACHE_MEMBER_COUNT
 };
 
@@ -82,6 +96,19 @@ enum {
 LLVMTypeRef
 lp_build_format_cache_type(struct gallivm_state *gallivm);
 
+boolean
+lp_build_format_cache_supported(const struct util_format_description *format_desc);
+
+LLVMValueRef
+lp_build_fetch_cached_texels(struct gallivm_state *gallivm,
+                             const struct util_format_description *format_desc,
+                             unsigned n,
+                             LLVMValueRef base_ptr,
+                             LLVMValueRef offset,
+                             LLVMValueRef i,
+                             LLVMValueRef j,
+                             LLVMValueRef cache);
+
 
 /*
  * AoS
@@ -186,8 +213,13 @@ lp_build_fetch_s3tc_rgba_aos(struct gallivm_state *gallivm,
                              LLVMValueRef base_ptr,
                              LLVMValueRef offset,
                              LLVMValueRef i,
-                             LLVMValueRef j,
-                             LLVMValueRef cache);
+                             LLVMValueRef j);
+
+void
+lp_build_s3tc_decode_block(struct gallivm_state *gallivm,
+                           const struct util_format_description *format_desc,
+                           LLVMValueRef ptr,
+                           LLVMValueRef col[4]);
 
 /*
  * RGTC
@@ -200,8 +232,7 @@ lp_build_fetch_rgtc_rgba_aos(struct gallivm_state *gallivm,
                              LLVMValueRef base_ptr,
                              LLVMValueRef offset,
                              LLVMValueRef i,
-                             LLVMValueRef j,
-                             LLVMValueRef cache);
+                             LLVMValueRef j);
 
 /*
  * special float formats
@@ -725,6 +725,35 @@ lp_build_fetch_rgba_aos(struct gallivm_state *gallivm,
       return tmp;
    }
 
+   /*
+    * block compressed formats, through the block cache
+    */
+
+   if (cache && lp_build_format_cache_supported(format_desc)) {
+      struct lp_type tmp_type;
+      LLVMValueRef tmp;
+
+      memset(&tmp_type, 0, sizeof tmp_type);
+      tmp_type.width = 8;
+      tmp_type.length = num_pixels * 4;
+      tmp_type.norm = TRUE;
+      tmp_type.sign = util_format_is_snorm(format_desc->format);
+
+      tmp = lp_build_fetch_cached_texels(gallivm,
+                                         format_desc,
+                                         num_pixels,
+                                         base_ptr,
+                                         offset,
+                                         i, j,
+                                         cache);
+
+      lp_build_conv(gallivm,
+                    tmp_type, type,
+                    &tmp, 1, &tmp, 1);
+
+      return tmp;
+   }
+
    /*
     * s3tc rgb formats
     */
@@ -743,8 +772,7 @@ lp_build_fetch_rgba_aos(struct gallivm_state *gallivm,
                                          num_pixels,
                                          base_ptr,
                                          offset,
-                                         i, j,
-                                         cache);
+                                         i, j);
 
       lp_build_conv(gallivm,
                     tmp_type, type,
@@ -775,8 +803,7 @@ lp_build_fetch_rgba_aos(struct gallivm_state *gallivm,
                                          num_pixels,
                                          base_ptr,
                                          offset,
-                                         i, j,
-                                         cache);
+                                         i, j);
 
       lp_build_conv(gallivm,
                     tmp_type, type,
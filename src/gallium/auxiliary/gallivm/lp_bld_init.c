@@ -28,6 +28,7 @@
 
 #include "pipe/p_config.h"
 #include "pipe/p_compiler.h"
+#include "util/u_atomic.h"
 #include "util/u_cpu_detect.h"
 #include "util/u_debug.h"
 #include "util/u_memory.h"
@@ -59,6 +60,7 @@ static const struct debug_named_value lp_bld_perf_flags[] = {
    { "no_rho_approx", GALLIVM_PERF_NO_RHO_APPROX, "disable rho_approx optimization" },
    { "no_quad_lod", GALLIVM_PERF_NO_QUAD_LOD, "disable quad_lod optimization" },
    { "no_aos_sampling", GALLIVM_PERF_NO_AOS_SAMPLING, "disable aos sampling optimization" },
+   { "no_uniform_cf", GALLIVM_PERF_NO_UNIFORM_CF, "disable branching on uniform conditions in nir shaders" },
    { "nopt",   GALLIVM_PERF_NO_OPT, "disable optimization passes to speed up shader compilation" },
    { "no_filter_hacks", GALLIVM_PERF_NO_BRILINEAR | GALLIVM_PERF_NO_RHO_APPROX |
      GALLIVM_PERF_NO_QUAD_LOD, "disable filter optimization hacks" },
@@ -86,6 +88,12 @@ static boolean gallivm_initialized = FALSE;
 
 unsigned lp_native_vector_width;
 
+unsigned lp_wide_vector_width;
+
+boolean gallivm_use_orcjit = FALSE;
+
+static struct gallivm_stats gallivm_stats;
+
 
 /*
  * Optimization values are:
@@ -146,7 +154,7 @@ create_pass_manager(struct gallivm_state *gallivm)
    LLVMAddCoroElidePass(gallivm->cgpassmgr);
 #endif
 
-   if ((gallivm_perf & GALLIVM_PERF_NO_OPT) == 0) {
+   if (!gallivm->no_opt && (gallivm_perf & GALLIVM_PERF_NO_OPT) == 0) {
       /*
        * TODO: Evaluate passes some more - keeping in mind
        * both quality of generated code and compile times.
@@ -187,6 +195,52 @@ create_pass_manager(struct gallivm_state *gallivm)
 }
 
 
+/**
+ * A global mapping recorded before compilation, see
+ * gallivm_add_global_mapping().
+ */
+struct gallivm_global_mapping
+{
+   char *name;
+   void *addr;
+};
+
+
+static void
+free_global_mappings(struct gallivm_state *gallivm)
+{
+   util_dynarray_foreach(&gallivm->global_mappings,
+                         struct gallivm_global_mapping, mapping)
+      free(mapping->name);
+   util_dynarray_fini(&gallivm->global_mappings);
+}
+
+
+/**
+ * Apply the mappings recorded before compilation, skipping globals the
+ * optimization passes removed.
+ */
+static void
+apply_global_mappings(struct gallivm_state *gallivm)
+{
+   util_dynarray_foreach(&gallivm->global_mappings,
+                         struct gallivm_global_mapping, mapping) {
+#if GALLIVM_HAVE_ORCJIT
+      if (gallivm->orc) {
+         lp_orc_add_mapping(gallivm->orc, mapping->name, mapping->addr);
+         continue;
+      }
+#endif
+      LLVMValueRef global = LLVMGetNamedFunction(gallivm->module,
+                                                 mapping->name);
+      if (global)
+         LLVMAddGlobalMapping(gallivm->engine, global, mapping->addr);
+   }
+
+   free_global_mappings(gallivm);
+}
+
+
 /**
  * Free gallivm object's LLVM allocations, but not any generated code
  * nor the gallivm object itself.
@@ -194,6 +248,8 @@ create_pass_manager(struct gallivm_state *gallivm)
 void
 gallivm_free_ir(struct gallivm_state *gallivm)
 {
+   free_global_mappings(gallivm);
+
    if (gallivm->passmgr) {
       LLVMDisposePassManager(gallivm->passmgr);
    }
@@ -246,6 +302,12 @@ gallivm_free_code(struct gallivm_state *gallivm)
 {
    assert(!gallivm->module);
    assert(!gallivm->engine);
+#if GALLIVM_HAVE_ORCJIT
+   if (gallivm->orc) {
+      lp_orc_remove_module(gallivm->orc);
+      gallivm->orc = NULL;
+   }
+#endif
    lp_free_generated_code(gallivm->code);
    gallivm->code = NULL;
    lp_free_memory_manager(gallivm->memorymgr);
@@ -253,21 +315,23 @@ gallivm_free_code(struct gallivm_state *gallivm)
 }
 
 
+static enum LLVM_CodeGenOpt_Level
+codegen_opt_level(const struct gallivm_state *gallivm)
+{
+   if (gallivm->no_opt || (gallivm_perf & GALLIVM_PERF_NO_OPT))
+      return None;
+   return Default;
+}
+
+
 static boolean
 init_gallivm_engine(struct gallivm_state *gallivm)
 {
    if (1) {
-      enum LLVM_CodeGenOpt_Level optlevel;
+      enum LLVM_CodeGenOpt_Level optlevel = codegen_opt_level(gallivm);
       char *error = NULL;
       int ret;
 
-      if (gallivm_perf & GALLIVM_PERF_NO_OPT) {
-         optlevel = None;
-      }
-      else {
-         optlevel = Default;
-      }
-
       ret = lp_build_create_jit_compiler_for_module(&gallivm->engine,
                                                     &gallivm->code,
                                                     gallivm->cache,
@@ -310,6 +374,29 @@ fail:
 }
 
 
+#if GALLIVM_HAVE_ORCJIT
+/**
+ * Hand the module over to the ORC JIT, which compiles it right away.
+ */
+static boolean
+init_gallivm_orc(struct gallivm_state *gallivm)
+{
+   char *error = NULL;
+
+   gallivm->orc = lp_orc_add_module(gallivm->module, gallivm->cache,
+                                    (unsigned) codegen_opt_level(gallivm),
+                                    &error);
+   if (!gallivm->orc) {
+      _debug_printf("%s\n", error);
+      free(error);
+      return FALSE;
+   }
+
+   return TRUE;
+}
+#endif
+
+
 /**
  * Allocate gallivm LLVM objects.
  * \return  TRUE for success, FALSE for failure
@@ -422,6 +509,10 @@ lp_build_init(void)
 
    gallivm_perf = debug_get_flags_option("GALLIVM_PERF", lp_bld_perf_flags, 0 );
 
+#if GALLIVM_HAVE_ORCJIT
+   gallivm_use_orcjit = debug_get_bool_option("GALLIVM_ORCJIT", FALSE);
+#endif
+
    lp_set_target_options();
 
    util_cpu_detect();
@@ -453,6 +544,20 @@ lp_build_init(void)
    lp_native_vector_width = debug_get_num_option("LP_NATIVE_VECTOR_WIDTH",
                                                  lp_native_vector_width);
 
+   lp_wide_vector_width = lp_native_vector_width;
+#if LLVM_VERSION_MAJOR >= 4 && (defined(PIPE_ARCH_X86) || defined(PIPE_ARCH_X86_64))
+   /*
+    * The code generator only gets told about AVX-512 when the host CPU
+    * features are queried from LLVM (see lp_build_get_mattrs).
+    */
+   if (util_cpu_caps.has_avx512f && lp_native_vector_width == 256) {
+      lp_wide_vector_width = 512;
+   }
+#endif
+   lp_wide_vector_width = debug_get_num_option("LP_WIDE_VECTOR_WIDTH",
+                                               lp_wide_vector_width);
+   lp_wide_vector_width = MAX2(lp_wide_vector_width, lp_native_vector_width);
+
 #if LLVM_VERSION_MAJOR < 4
    if (lp_native_vector_width <= 128) {
       /* Hide AVX support, as often LLVM AVX intrinsics are only guarded by
@@ -520,6 +625,30 @@ gallivm_create(const char *name, LLVMContextRef context,
 }
 
 
+/**
+ * Create a new gallivm_state object whose code is compiled without
+ * optimization passes and with the fastest code generator settings.
+ * Meant for code which is only used until a better version is ready.
+ */
+struct gallivm_state *
+gallivm_create_unoptimized(const char *name, LLVMContextRef context)
+{
+   struct gallivm_state *gallivm;
+
+   gallivm = CALLOC_STRUCT(gallivm_state);
+   if (gallivm) {
+      gallivm->no_opt = TRUE;
+      if (!init_gallivm_state(gallivm, name, context, NULL)) {
+         FREE(gallivm);
+         gallivm = NULL;
+      }
+   }
+
+   assert(gallivm != NULL);
+   return gallivm;
+}
+
+
 /**
  * Destroy a gallivm_state object.
  */
@@ -594,8 +723,7 @@ gallivm_compile_module(struct gallivm_state *gallivm)
                    "[-mattr=<-mattr option(s)>]");
    }
 
-   if (gallivm_debug & GALLIVM_DEBUG_PERF)
-      time_begin = os_time_get();
+   time_begin = os_time_get_nano();
 
 #if GALLIVM_HAVE_CORO
    LLVMRunPassManager(gallivm->cgpassmgr, gallivm->module);
@@ -620,9 +748,11 @@ gallivm_compile_module(struct gallivm_state *gallivm)
    }
    LLVMFinalizeFunctionPassManager(gallivm->passmgr);
 
+   p_atomic_add(&gallivm_stats.opt_nsecs, os_time_get_nano() - time_begin);
+
    if (gallivm_debug & GALLIVM_DEBUG_PERF) {
-      int64_t time_end = os_time_get();
-      int time_msec = (int)((time_end - time_begin) / 1000);
+      int64_t time_end = os_time_get_nano();
+      int time_msec = (int)((time_end - time_begin) / 1000000);
       assert(gallivm->module_name);
       debug_printf("optimizing module %s took %d msec\n",
                    gallivm->module_name, time_msec);
@@ -646,17 +776,55 @@ gallivm_compile_module(struct gallivm_state *gallivm)
     * lp_build_create_jit_compiler_for_module()
     */
  skip_cached:
-   LLVMSetDataLayout(gallivm->module, "");
-   assert(!gallivm->engine);
-   if (!init_gallivm_engine(gallivm)) {
-      assert(0);
+   time_begin = os_time_get_nano();
+
+#if GALLIVM_HAVE_ORCJIT
+   if (!gallivm_use_orcjit || !init_gallivm_orc(gallivm))
+#endif
+   {
+      unsigned num_functions = 0;
+
+      LLVMSetDataLayout(gallivm->module, "");
+      assert(!gallivm->engine);
+      if (!init_gallivm_engine(gallivm)) {
+         assert(0);
+      }
+      assert(gallivm->engine);
+
+      /* MCJIT compiles the whole module, unless it came from the cache */
+      if (!gallivm->cache || !gallivm->cache->data_size) {
+         for (func = LLVMGetFirstFunction(gallivm->module); func;
+              func = LLVMGetNextFunction(func)) {
+            if (!LLVMIsDeclaration(func))
+               num_functions++;
+         }
+      }
+      gallivm_stats_add_codegen(0, num_functions);
    }
-   assert(gallivm->engine);
+
+   p_atomic_inc(&gallivm_stats.num_modules);
+   gallivm_stats_add_codegen(os_time_get_nano() - time_begin, 0);
 
    ++gallivm->compiled;
 
+   apply_global_mappings(gallivm);
+
    if (gallivm->debug_printf_hook)
-      LLVMAddGlobalMapping(gallivm->engine, gallivm->debug_printf_hook, debug_printf);
+      gallivm_add_global_mapping(gallivm, gallivm->debug_printf_hook,
+                                 debug_printf);
+
+#if GALLIVM_HAVE_ORCJIT
+   /* Link everything now, rather than on the first lookup of a function,
+    * which may happen on another thread once the code is in use.
+    */
+   if (gallivm->orc) {
+      time_begin = os_time_get_nano();
+      if (!lp_orc_materialize(gallivm->orc)) {
+         assert(0);
+      }
+      gallivm_stats_add_codegen(os_time_get_nano() - time_begin, 0);
+   }
+#endif
 
    if (gallivm_debug & GALLIVM_DEBUG_ASM) {
       LLVMValueRef llvm_func = LLVMGetFirstFunction(gallivm->module);
@@ -668,7 +836,7 @@ gallivm_compile_module(struct gallivm_state *gallivm)
           * LLVMGetPointerToGlobal() will abort otherwise.
           */
          if (!LLVMIsDeclaration(llvm_func)) {
-            void *func_code = LLVMGetPointerToGlobal(gallivm->engine, llvm_func);
+            void *func_code = func_to_pointer(gallivm_jit_function(gallivm, llvm_func));
             lp_disassemble(llvm_func, func_code);
          }
          llvm_func = LLVMGetNextFunction(llvm_func);
@@ -681,7 +849,7 @@ gallivm_compile_module(struct gallivm_state *gallivm)
 
       while (llvm_func) {
          if (!LLVMIsDeclaration(llvm_func)) {
-            void *func_code = LLVMGetPointerToGlobal(gallivm->engine, llvm_func);
+            void *func_code = func_to_pointer(gallivm_jit_function(gallivm, llvm_func));
             lp_profile(llvm_func, func_code);
          }
          llvm_func = LLVMGetNextFunction(llvm_func);
@@ -701,21 +869,102 @@ gallivm_jit_function(struct gallivm_state *gallivm,
    int64_t time_begin = 0;
 
    assert(gallivm->compiled);
-   assert(gallivm->engine);
+   assert(gallivm->engine || gallivm->orc);
 
-   if (gallivm_debug & GALLIVM_DEBUG_PERF)
-      time_begin = os_time_get();
+   time_begin = os_time_get_nano();
 
-   code = LLVMGetPointerToGlobal(gallivm->engine, func);
+#if GALLIVM_HAVE_ORCJIT
+   if (gallivm->orc)
+      code = lp_orc_lookup(gallivm->orc, LLVMGetValueName(func));
+   else
+#endif
+      code = LLVMGetPointerToGlobal(gallivm->engine, func);
    assert(code);
    jit_func = pointer_to_func(code);
 
+   /* MCJIT generates the code here, the first time it is asked for any. */
+   gallivm_stats_add_codegen(os_time_get_nano() - time_begin, 0);
+
    if (gallivm_debug & GALLIVM_DEBUG_PERF) {
-      int64_t time_end = os_time_get();
-      int time_msec = (int)(time_end - time_begin) / 1000;
+      int64_t time_end = os_time_get_nano();
+      int time_msec = (int)((time_end - time_begin) / 1000000);
       debug_printf("   jitting func %s took %d msec\n",
                    LLVMGetValueName(func), time_msec);
    }
 
    return jit_func;
 }
+
+
+/**
+ * Resolve references to the given global (usually a function declared in
+ * the module) to addr.  Should be called before gallivm_compile_module(),
+ * which links the code when using the ORC JIT; with MCJIT it is enough to
+ * call it before the first gallivm_jit_function().  Mappings added before
+ * gallivm_compile_module() are recorded by name and applied once the module
+ * is compiled, in case the optimization passes removed or replaced the
+ * global in between.
+ */
+void
+gallivm_add_global_mapping(struct gallivm_state *gallivm,
+                           LLVMValueRef global, void *addr)
+{
+   if (!gallivm->compiled) {
+      struct gallivm_global_mapping mapping;
+
+      mapping.name = strdup(LLVMGetValueName(global));
+      mapping.addr = addr;
+      util_dynarray_append(&gallivm->global_mappings,
+                           struct gallivm_global_mapping, mapping);
+      return;
+   }
+
+#if GALLIVM_HAVE_ORCJIT
+   if (gallivm->orc) {
+      lp_orc_add_mapping(gallivm->orc, LLVMGetValueName(global), addr);
+      return;
+   }
+#endif
+   LLVMAddGlobalMapping(gallivm->engine, global, addr);
+}
+
+
+void
+gallivm_stats_add_code_size(int64_t size)
+{
+   uint64_t code_size = p_atomic_add_return(&gallivm_stats.code_size, size);
+   uint64_t max_code_size = p_atomic_read(&gallivm_stats.max_code_size);
+
+   while (code_size > max_code_size) {
+      uint64_t old = p_atomic_cmpxchg(&gallivm_stats.max_code_size,
+                                      max_code_size, code_size);
+      if (old == max_code_size)
+         break;
+      max_code_size = old;
+   }
+}
+
+
+void
+gallivm_stats_add_codegen(int64_t nsecs, unsigned num_functions)
+{
+   p_atomic_add(&gallivm_stats.codegen_nsecs, nsecs);
+   if (num_functions)
+      p_atomic_add(&gallivm_stats.num_functions, num_functions);
+}
+
+
+/**
+ * Return the JIT statistics, for comparing compile latency and memory
+ * usage of the JIT backends.
+ */
+void
+gallivm_get_stats(struct gallivm_stats *stats)
+{
+   stats->num_modules = p_atomic_read(&gallivm_stats.num_modules);
+   stats->num_functions = p_atomic_read(&gallivm_stats.num_functions);
+   stats->opt_nsecs = p_atomic_read(&gallivm_stats.opt_nsecs);
+   stats->codegen_nsecs = p_atomic_read(&gallivm_stats.codegen_nsecs);
+   stats->code_size = p_atomic_read(&gallivm_stats.code_size);
+   stats->max_code_size = p_atomic_read(&gallivm_stats.max_code_size);
+}
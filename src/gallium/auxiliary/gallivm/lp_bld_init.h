@@ -32,6 +32,7 @@
 
 #include "pipe/p_compiler.h"
 #include "util/u_pointer.h" // for func_pointer
+#include "util/u_dynarray.h"
 #include "lp_bld.h"
 #include <llvm-c/ExecutionEngine.h>
 
@@ -53,13 +54,35 @@ struct gallivm_state
    LLVMMCJITMemoryManagerRef memorymgr;
    struct lp_generated_code *code;
    struct lp_cached_code *cache;
+   struct lp_orc_module *orc;  /**< code when using the ORC JIT */
    unsigned compiled;
    LLVMValueRef coro_malloc_hook;
    LLVMValueRef coro_free_hook;
    LLVMValueRef debug_printf_hook;
+   /** gallivm_add_global_mapping() calls made before compilation */
+   struct util_dynarray global_mappings;
+   boolean no_opt; /**< skip optimizations, see gallivm_create_unoptimized() */
 };
 
 
+/**
+ * JIT statistics, accumulated over all gallivm_state objects.
+ */
+struct gallivm_stats
+{
+   uint64_t num_modules;      /**< modules compiled */
+   uint64_t num_functions;    /**< functions compiled */
+   uint64_t opt_nsecs;        /**< time spent in IR optimization passes */
+   uint64_t codegen_nsecs;    /**< time spent generating and linking code */
+   uint64_t code_size;        /**< bytes of code and data currently allocated */
+   uint64_t max_code_size;    /**< high-water mark of code_size */
+};
+
+
+/** Use the ORC JIT instead of MCJIT (GALLIVM_ORCJIT) */
+extern boolean gallivm_use_orcjit;
+
+
 boolean
 lp_build_init(void);
 
@@ -68,6 +91,9 @@ struct gallivm_state *
 gallivm_create(const char *name, LLVMContextRef context,
                struct lp_cached_code *cache);
 
+struct gallivm_state *
+gallivm_create_unoptimized(const char *name, LLVMContextRef context);
+
 void
 gallivm_destroy(struct gallivm_state *gallivm);
 
@@ -85,6 +111,13 @@ func_pointer
 gallivm_jit_function(struct gallivm_state *gallivm,
                      LLVMValueRef func);
 
+void
+gallivm_add_global_mapping(struct gallivm_state *gallivm,
+                           LLVMValueRef global, void *addr);
+
+void
+gallivm_get_stats(struct gallivm_stats *stats);
+
 #ifdef __cplusplus
 }
 #endif
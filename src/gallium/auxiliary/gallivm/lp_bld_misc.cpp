@@ -41,6 +41,8 @@
 
 
 #include <stddef.h>
+#include <string.h>
+#include <algorithm>
 
 #include <llvm/Config/llvm-config.h>
 
@@ -85,12 +87,20 @@
 #include "c11/threads.h"
 #include "os/os_thread.h"
 #include "pipe/p_config.h"
+#include "util/u_atomic.h"
 #include "util/u_debug.h"
 #include "util/u_cpu_detect.h"
 
 #include "lp_bld_misc.h"
 #include "lp_bld_debug.h"
 
+#if GALLIVM_HAVE_ORCJIT
+#include <llvm/ExecutionEngine/Orc/CompileUtils.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h>
+#endif
+
 namespace {
 
 class LLVMEnsureMultithreaded {
@@ -246,12 +256,15 @@ class ShaderMemoryManager : public DelegatingJITMemoryManager {
       typedef std::vector<void *> Vec;
       Vec FunctionBody, ExceptionTable;
       BaseMemoryManager *TheMM;
+      size_t Size;
 
       GeneratedCode(BaseMemoryManager *MM) {
          TheMM = MM;
+         Size = 0;
       }
 
       ~GeneratedCode() {
+         gallivm_stats_add_code_size(-(int64_t)Size);
       }
    };
 
@@ -283,6 +296,30 @@ class ShaderMemoryManager : public DelegatingJITMemoryManager {
          delete (GeneratedCode *) code;
       }
 
+      virtual uint8_t *allocateCodeSection(uintptr_t Size,
+                                           unsigned Alignment,
+                                           unsigned SectionID,
+                                           llvm::StringRef SectionName) {
+         code->Size += Size;
+         gallivm_stats_add_code_size(Size);
+         return DelegatingJITMemoryManager::allocateCodeSection(Size, Alignment,
+                                                                SectionID,
+                                                                SectionName);
+      }
+
+      virtual uint8_t *allocateDataSection(uintptr_t Size,
+                                           unsigned Alignment,
+                                           unsigned SectionID,
+                                           llvm::StringRef SectionName,
+                                           bool IsReadOnly) {
+         code->Size += Size;
+         gallivm_stats_add_code_size(Size);
+         return DelegatingJITMemoryManager::allocateDataSection(Size, Alignment,
+                                                                SectionID,
+                                                                SectionName,
+                                                                IsReadOnly);
+      }
+
       virtual void deallocateFunctionBody(void *Body) {
          // remember for later deallocation
          code->FunctionBody.push_back(Body);
@@ -321,61 +358,11 @@ public:
 };
 
 /**
- * Same as LLVMCreateJITCompilerForModule, but:
- * - allows using MCJIT and enabling AVX feature where available.
- * - set target options
- *
- * See also:
- * - llvm/lib/ExecutionEngine/ExecutionEngineBindings.cpp
- * - llvm/tools/lli/lli.cpp
- * - http://markmail.org/message/ttkuhvgj4cxxy2on#query:+page:1+mid:aju2dggerju3ivd3+state:results
+ * The -mattr options we pass to the code generator for the host CPU.
  */
-extern "C"
-LLVMBool
-lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
-                                        lp_generated_code **OutCode,
-                                        struct lp_cached_code *cache_out,
-                                        LLVMModuleRef M,
-                                        LLVMMCJITMemoryManagerRef CMM,
-                                        unsigned OptLevel,
-                                        char **OutError)
+static void
+lp_build_get_mattrs(llvm::SmallVector<std::string, 16> &MAttrs)
 {
-   using namespace llvm;
-
-   std::string Error;
-   EngineBuilder builder(std::unique_ptr<Module>(unwrap(M)));
-
-   /**
-    * LLVM 3.1+ haven't more "extern unsigned llvm::StackAlignmentOverride" and
-    * friends for configuring code generation options, like stack alignment.
-    */
-   TargetOptions options;
-#if defined(PIPE_ARCH_X86)
-   options.StackAlignmentOverride = 4;
-#endif
-
-   builder.setEngineKind(EngineKind::JIT)
-          .setErrorStr(&Error)
-          .setTargetOptions(options)
-          .setOptLevel((CodeGenOpt::Level)OptLevel);
-
-#ifdef _WIN32
-    /*
-     * MCJIT works on Windows, but currently only through ELF object format.
-     *
-     * XXX: We could use `LLVM_HOST_TRIPLE "-elf"` but LLVM_HOST_TRIPLE has
-     * different strings for MinGW/MSVC, so better play it safe and be
-     * explicit.
-     */
-#  ifdef _WIN64
-    LLVMSetTarget(M, "x86_64-pc-win32-elf");
-#  else
-    LLVMSetTarget(M, "i686-pc-win32-elf");
-#  endif
-#endif
-
-   llvm::SmallVector<std::string, 16> MAttrs;
-
 #if LLVM_VERSION_MAJOR >= 4 && (defined(PIPE_ARCH_X86) || defined(PIPE_ARCH_X86_64) || defined(PIPE_ARCH_ARM))
    /* llvm-3.3+ implements sys::getHostCPUFeatures for Arm
     * and llvm-3.7+ for x86, which allows us to enable/disable
@@ -385,7 +372,7 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
    llvm::StringMap<bool> features;
    llvm::sys::getHostCPUFeatures(features);
 
-   for (StringMapIterator<bool> f = features.begin();
+   for (llvm::StringMapIterator<bool> f = features.begin();
         f != features.end();
         ++f) {
       MAttrs.push_back(((*f).second ? "+" : "-") + (*f).first().str());
@@ -463,20 +450,16 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
    }
 #endif
 #endif
+}
 
-   builder.setMAttrs(MAttrs);
 
-   if (gallivm_debug & (GALLIVM_DEBUG_IR | GALLIVM_DEBUG_ASM | GALLIVM_DEBUG_DUMP_BC)) {
-      int n = MAttrs.size();
-      if (n > 0) {
-         debug_printf("llc -mattr option(s): ");
-         for (int i = 0; i < n; i++)
-            debug_printf("%s%s", MAttrs[i].c_str(), (i < n - 1) ? "," : "");
-         debug_printf("\n");
-      }
-   }
-
-   StringRef MCPU = llvm::sys::getHostCPUName();
+/**
+ * The -mcpu option we pass to the code generator for the host CPU.
+ */
+static llvm::StringRef
+lp_build_get_mcpu(void)
+{
+   llvm::StringRef MCPU = llvm::sys::getHostCPUName();
    /*
     * The cpu bits are no longer set automatically, so need to set mcpu manually.
     * Note that the MAttrs set above will be sort of ignored (since we should
@@ -490,19 +473,7 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
     * can't handle. Not entirely sure if we really need to do anything yet.
     */
 
-#ifdef PIPE_ARCH_PPC_64
-   /*
-    * Large programs, e.g. gnome-shell and firefox, may tax the addressability
-    * of the Medium code model once dynamically generated JIT-compiled shader
-    * programs are linked in and relocated.  Yet the default code model as of
-    * LLVM 8 is Medium or even Small.
-    * The cost of changing from Medium to Large is negligible:
-    * - an additional 8-byte pointer stored immediately before the shader entrypoint;
-    * - change an add-immediate (addis) instruction to a load (ld).
-    */
-   builder.setCodeModel(CodeModel::Large);
-
-#if UTIL_ARCH_LITTLE_ENDIAN
+#if defined(PIPE_ARCH_PPC_64) && UTIL_ARCH_LITTLE_ENDIAN
    /*
     * Versions of LLVM prior to 4.0 lacked a table entry for "POWER8NVL",
     * resulting in (big-endian) "generic" being returned on
@@ -515,7 +486,118 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
    if (MCPU == "generic")
       MCPU = "pwr8";
 #endif
+   return MCPU;
+}
+
+
+/**
+ * Hash everything about the target machine which the generated code depends
+ * on, i.e. the LLVM version, -mcpu and -mattr, so that machine code cached on
+ * disk is never loaded on a CPU (or by an LLVM) it was not generated for.
+ */
+extern "C" void
+lp_build_hash_target_machine(struct mesa_sha1 *ctx)
+{
+   llvm::SmallVector<std::string, 16> MAttrs;
+   lp_build_get_mattrs(MAttrs);
+
+   /* The feature map from the host is unordered. */
+   std::sort(MAttrs.begin(), MAttrs.end());
+
+   _mesa_sha1_update(ctx, LLVM_VERSION_STRING, strlen(LLVM_VERSION_STRING));
+
+   std::string MCPU = lp_build_get_mcpu().str();
+   _mesa_sha1_update(ctx, MCPU.c_str(), MCPU.size() + 1);
+
+   for (unsigned i = 0; i < MAttrs.size(); i++)
+      _mesa_sha1_update(ctx, MAttrs[i].c_str(), MAttrs[i].size() + 1);
+}
+
+
+/**
+ * Same as LLVMCreateJITCompilerForModule, but:
+ * - allows using MCJIT and enabling AVX feature where available.
+ * - set target options
+ *
+ * See also:
+ * - llvm/lib/ExecutionEngine/ExecutionEngineBindings.cpp
+ * - llvm/tools/lli/lli.cpp
+ * - http://markmail.org/message/ttkuhvgj4cxxy2on#query:+page:1+mid:aju2dggerju3ivd3+state:results
+ */
+extern "C"
+LLVMBool
+lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
+                                        lp_generated_code **OutCode,
+                                        struct lp_cached_code *cache_out,
+                                        LLVMModuleRef M,
+                                        LLVMMCJITMemoryManagerRef CMM,
+                                        unsigned OptLevel,
+                                        char **OutError)
+{
+   using namespace llvm;
+
+   std::string Error;
+   EngineBuilder builder(std::unique_ptr<Module>(unwrap(M)));
+
+   /**
+    * LLVM 3.1+ haven't more "extern unsigned llvm::StackAlignmentOverride" and
+    * friends for configuring code generation options, like stack alignment.
+    */
+   TargetOptions options;
+#if defined(PIPE_ARCH_X86)
+   options.StackAlignmentOverride = 4;
 #endif
+
+   builder.setEngineKind(EngineKind::JIT)
+          .setErrorStr(&Error)
+          .setTargetOptions(options)
+          .setOptLevel((CodeGenOpt::Level)OptLevel);
+
+#ifdef _WIN32
+    /*
+     * MCJIT works on Windows, but currently only through ELF object format.
+     *
+     * XXX: We could use `LLVM_HOST_TRIPLE "-elf"` but LLVM_HOST_TRIPLE has
+     * different strings for MinGW/MSVC, so better play it safe and be
+     * explicit.
+     */
+#  ifdef _WIN64
+    LLVMSetTarget(M, "x86_64-pc-win32-elf");
+#  else
+    LLVMSetTarget(M, "i686-pc-win32-elf");
+#  endif
+#endif
+
+   llvm::SmallVector<std::string, 16> MAttrs;
+   lp_build_get_mattrs(MAttrs);
+
+   builder.setMAttrs(MAttrs);
+
+   if (gallivm_debug & (GALLIVM_DEBUG_IR | GALLIVM_DEBUG_ASM | GALLIVM_DEBUG_DUMP_BC)) {
+      int n = MAttrs.size();
+      if (n > 0) {
+         debug_printf("llc -mattr option(s): ");
+         for (int i = 0; i < n; i++)
+            debug_printf("%s%s", MAttrs[i].c_str(), (i < n - 1) ? "," : "");
+         debug_printf("\n");
+      }
+   }
+
+   StringRef MCPU = lp_build_get_mcpu();
+
+#ifdef PIPE_ARCH_PPC_64
+   /*
+    * Large programs, e.g. gnome-shell and firefox, may tax the addressability
+    * of the Medium code model once dynamically generated JIT-compiled shader
+    * programs are linked in and relocated.  Yet the default code model as of
+    * LLVM 8 is Medium or even Small.
+    * The cost of changing from Medium to Large is negligible:
+    * - an additional 8-byte pointer stored immediately before the shader entrypoint;
+    * - change an add-immediate (addis) instruction to a load (ld).
+    */
+   builder.setCodeModel(CodeModel::Large);
+#endif
+
    builder.setMCPU(MCPU);
    if (gallivm_debug & (GALLIVM_DEBUG_IR | GALLIVM_DEBUG_ASM | GALLIVM_DEBUG_DUMP_BC)) {
       debug_printf("llc -mcpu option: %s\n", MCPU.str().c_str());
@@ -596,3 +678,320 @@ lp_is_function(LLVMValueRef v)
 {
 	return LLVMGetValueKind(v) == LLVMFunctionValueKind;
 }
+
+
+#if GALLIVM_HAVE_ORCJIT
+
+/*
+ * ORC JIT backend.
+ *
+ * There is a single LLJIT for the whole process, so all modules share one
+ * ExecutionSession and object linking layer.  Each module is added to a
+ * JITDylib of its own, which holds the module's code, memory and symbols
+ * (the global mappings included), so that modules can define the same
+ * names and can be freed one by one in gallivm_free_code().  The process
+ * symbols are resolved through the main JITDylib, which every module's
+ * JITDylib links against.
+ *
+ * The module is compiled to an object file when it is added, so that the
+ * object code can be stored in the shader cache, and everything is linked
+ * by lp_orc_materialize() before gallivm_compile_module() returns.  No code
+ * is ever generated when a function is first called from a rendering
+ * thread.
+ */
+
+namespace {
+
+using namespace llvm;
+using namespace llvm::orc;
+
+
+/**
+ * SectionMemoryManager, but keeping track of the allocated size.
+ */
+class LPOrcMemoryManager : public SectionMemoryManager {
+   size_t Size;
+
+public:
+   LPOrcMemoryManager() : Size(0) {}
+
+   ~LPOrcMemoryManager() {
+      gallivm_stats_add_code_size(-(int64_t)Size);
+   }
+
+   uint8_t *allocateCodeSection(uintptr_t Size, unsigned Alignment,
+                                unsigned SectionID,
+                                StringRef SectionName) override {
+      this->Size += Size;
+      gallivm_stats_add_code_size(Size);
+      return SectionMemoryManager::allocateCodeSection(Size, Alignment,
+                                                       SectionID, SectionName);
+   }
+
+   uint8_t *allocateDataSection(uintptr_t Size, unsigned Alignment,
+                                unsigned SectionID, StringRef SectionName,
+                                bool IsReadOnly) override {
+      this->Size += Size;
+      gallivm_stats_add_code_size(Size);
+      return SectionMemoryManager::allocateDataSection(Size, Alignment,
+                                                       SectionID, SectionName,
+                                                       IsReadOnly);
+   }
+};
+
+
+/**
+ * Describe the host the same way lp_build_create_jit_compiler_for_module()
+ * does for MCJIT.
+ */
+static Expected<JITTargetMachineBuilder>
+lp_orc_target_machine_builder(unsigned OptLevel)
+{
+   auto JTMB = JITTargetMachineBuilder::detectHost();
+   if (!JTMB)
+      return JTMB.takeError();
+
+   llvm::SmallVector<std::string, 16> MAttrs;
+   lp_build_get_mattrs(MAttrs);
+   JTMB->setCPU(lp_build_get_mcpu().str());
+   JTMB->addFeatures(std::vector<std::string>(MAttrs.begin(), MAttrs.end()));
+   JTMB->setCodeGenOptLevel((CodeGenOpt::Level)OptLevel);
+#if defined(PIPE_ARCH_X86)
+   JTMB->getOptions().StackAlignmentOverride = 4;
+#endif
+#ifdef PIPE_ARCH_PPC_64
+   /* See lp_build_create_jit_compiler_for_module() */
+   JTMB->setCodeModel(CodeModel::Large);
+#endif
+
+   return JTMB;
+}
+
+
+/** The process wide JIT, or NULL if it couldn't be created */
+static LLJIT *lp_orc_jit = NULL;
+static std::string lp_orc_jit_error;
+static unsigned lp_orc_num_dylibs = 0;
+static ::once_flag lp_orc_jit_once_flag = ONCE_FLAG_INIT;
+
+
+/**
+ * Create the JIT.  It is never destroyed, like LLVM's own global state.
+ */
+static void
+lp_orc_create_jit(void)
+{
+   auto JTMB = lp_orc_target_machine_builder(CodeGenOpt::Default);
+   if (!JTMB) {
+      lp_orc_jit_error = toString(JTMB.takeError());
+      return;
+   }
+
+   auto J = LLJITBuilder()
+      .setJITTargetMachineBuilder(*JTMB)
+      .setObjectLinkingLayerCreator(
+         [](ExecutionSession &ES, const Triple &TT) -> std::unique_ptr<ObjectLayer> {
+            return std::make_unique<RTDyldObjectLinkingLayer>(ES, []() {
+               return std::make_unique<LPOrcMemoryManager>();
+            });
+         })
+      .create();
+   if (!J) {
+      lp_orc_jit_error = toString(J.takeError());
+      return;
+   }
+
+   /* Resolve references to the rest of the process, like MCJIT does. */
+   auto ProcessSymbols = DynamicLibrarySearchGenerator::GetForCurrentProcess(
+      (*J)->getDataLayout().getGlobalPrefix());
+   if (!ProcessSymbols) {
+      lp_orc_jit_error = toString(ProcessSymbols.takeError());
+      return;
+   }
+   (*J)->getMainJITDylib().addGenerator(std::move(*ProcessSymbols));
+
+   lp_orc_jit = J->release();
+}
+
+} /* anonymous namespace */
+
+
+struct lp_orc_module {
+   /** The module's code and symbols */
+   JITDylib *JD;
+   /** Names of the functions the module defines */
+   std::vector<std::string> Functions;
+};
+
+
+/**
+ * Compile the module to an object file and add it to the module's
+ * JITDylib.  The object code is returned in the cache, if there is one.
+ */
+static Error
+lp_orc_add_compiled(struct lp_orc_module *orc, JITTargetMachineBuilder &JTMB,
+                    Module &M, struct lp_cached_code *cache)
+{
+   auto TM = JTMB.createTargetMachine();
+   if (!TM)
+      return TM.takeError();
+
+   auto Obj = SimpleCompiler(**TM)(M);
+   if (!Obj)
+      return Obj.takeError();
+
+   gallivm_stats_add_codegen(0, orc->Functions.size());
+
+   if (cache) {
+      cache->data_size = (*Obj)->getBufferSize();
+      cache->data = malloc(cache->data_size);
+      if (cache->data)
+         memcpy(cache->data, (*Obj)->getBufferStart(), cache->data_size);
+      else
+         cache->data_size = 0;
+   }
+
+   return lp_orc_jit->addObjectFile(*orc->JD, std::move(*Obj));
+}
+
+
+/**
+ * Create a JITDylib for the module and add the module's object code to it.
+ * Nothing in the module is changed, except its data layout and triple when
+ * it gets compiled.
+ *
+ * If the cache holds object code, that is used instead of the module.
+ */
+extern "C" struct lp_orc_module *
+lp_orc_add_module(LLVMModuleRef M,
+                  struct lp_cached_code *cache,
+                  unsigned OptLevel,
+                  char **OutError)
+{
+   Module *Mod = unwrap(M);
+   Error Err = Error::success();
+
+   ::call_once(&lp_orc_jit_once_flag, lp_orc_create_jit);
+   if (!lp_orc_jit) {
+      *OutError = strdup(lp_orc_jit_error.c_str());
+      return NULL;
+   }
+
+   auto JTMB = lp_orc_target_machine_builder(OptLevel);
+   if (!JTMB) {
+      *OutError = strdup(toString(JTMB.takeError()).c_str());
+      return NULL;
+   }
+
+   /* JITDylib names must be unique within the session */
+   auto JD = lp_orc_jit->createJITDylib(
+      "gallivm" + std::to_string(p_atomic_inc_return(&lp_orc_num_dylibs)));
+   if (!JD) {
+      *OutError = strdup(toString(JD.takeError()).c_str());
+      return NULL;
+   }
+   JD->addToLinkOrder(lp_orc_jit->getMainJITDylib());
+
+   struct lp_orc_module *orc = new lp_orc_module;
+   orc->JD = &*JD;
+
+   for (const Function &F : *Mod) {
+      if (!F.isDeclaration() && !F.hasLocalLinkage())
+         orc->Functions.push_back(F.getName().str());
+   }
+
+   if (cache && cache->data_size) {
+      Err = lp_orc_jit->addObjectFile(
+         *orc->JD,
+         MemoryBuffer::getMemBufferCopy(
+            StringRef((const char *)cache->data, cache->data_size),
+            Mod->getModuleIdentifier()));
+   } else {
+      Mod->setDataLayout(lp_orc_jit->getDataLayout());
+      Mod->setTargetTriple(lp_orc_jit->getTargetTriple().str());
+      Err = lp_orc_add_compiled(orc, *JTMB, *Mod, cache);
+   }
+
+   if (Err) {
+      *OutError = strdup(toString(std::move(Err)).c_str());
+      lp_orc_remove_module(orc);
+      return NULL;
+   }
+
+   return orc;
+}
+
+
+extern "C" void
+lp_orc_add_mapping(struct lp_orc_module *orc, const char *name, void *addr)
+{
+   Error Err = orc->JD->define(absoluteSymbols({
+      { lp_orc_jit->mangleAndIntern(name),
+        JITEvaluatedSymbol(pointerToJITTargetAddress(addr),
+                           JITSymbolFlags::Exported) } }));
+   if (Err)
+      _debug_printf("gallivm: %s\n", toString(std::move(Err)).c_str());
+}
+
+
+/**
+ * Link all the functions of the module, so that none of it happens later on
+ * whichever thread first looks up or calls a function.  All global mappings
+ * must have been added before.
+ */
+extern "C" bool
+lp_orc_materialize(struct lp_orc_module *orc)
+{
+   ExecutionSession &ES = lp_orc_jit->getExecutionSession();
+   SymbolLookupSet Symbols;
+
+   for (const std::string &Name : orc->Functions)
+      Symbols.add(lp_orc_jit->mangleAndIntern(Name));
+
+   /* Helper functions, like the block cache updates, have hidden visibility
+    * and aren't exported by the JITDylib.
+    */
+   auto Result = ES.lookup(makeJITDylibSearchOrder(
+                              orc->JD, JITDylibLookupFlags::MatchAllSymbols),
+                           std::move(Symbols));
+   if (!Result) {
+      _debug_printf("gallivm: %s\n", toString(Result.takeError()).c_str());
+      return false;
+   }
+
+   return true;
+}
+
+
+extern "C" void *
+lp_orc_lookup(struct lp_orc_module *orc, const char *name)
+{
+   auto Sym = lp_orc_jit->lookup(*orc->JD, name);
+   if (!Sym) {
+      _debug_printf("gallivm: %s\n", toString(Sym.takeError()).c_str());
+      return NULL;
+   }
+
+   return jitTargetAddressToPointer<void *>(Sym->getAddress());
+}
+
+
+/**
+ * Free the module's JITDylib, and with it all the code of the module.
+ */
+extern "C" void
+lp_orc_remove_module(struct lp_orc_module *orc)
+{
+#if LLVM_VERSION_MAJOR >= 14
+   Error Err = lp_orc_jit->getExecutionSession().removeJITDylib(*orc->JD);
+#else
+   /* The empty JITDylib stays behind */
+   Error Err = orc->JD->clear();
+#endif
+   if (Err)
+      _debug_printf("gallivm: %s\n", toString(std::move(Err)).c_str());
+
+   delete orc;
+}
+
+#endif /* GALLIVM_HAVE_ORCJIT */
@@ -34,6 +34,7 @@
 #include <llvm/Config/llvm-config.h>
 #include <llvm-c/ExecutionEngine.h>
 #include <llvm-c/Target.h>
+#include "util/mesa-sha1.h"
 
 
 #ifdef __cplusplus
@@ -77,6 +78,9 @@ lp_build_create_jit_compiler_for_module(LLVMExecutionEngineRef *OutJIT,
 extern void
 lp_free_generated_code(struct lp_generated_code *code);
 
+extern void
+lp_build_hash_target_machine(struct mesa_sha1 *ctx);
+
 extern LLVMMCJITMemoryManagerRef
 lp_get_default_memory_manager();
 
@@ -91,6 +95,34 @@ lp_is_function(LLVMValueRef v);
 
 void
 lp_free_objcache(void *objcache);
+
+extern void
+gallivm_stats_add_code_size(int64_t size);
+
+extern void
+gallivm_stats_add_codegen(int64_t nsecs, unsigned num_functions);
+
+#if GALLIVM_HAVE_ORCJIT
+struct lp_orc_module;
+
+extern struct lp_orc_module *
+lp_orc_add_module(LLVMModuleRef M,
+                  struct lp_cached_code *cache,
+                  unsigned OptLevel,
+                  char **OutError);
+
+extern void
+lp_orc_add_mapping(struct lp_orc_module *orc, const char *name, void *addr);
+
+extern bool
+lp_orc_materialize(struct lp_orc_module *orc);
+
+extern void *
+lp_orc_lookup(struct lp_orc_module *orc, const char *name);
+
+extern void
+lp_orc_remove_module(struct lp_orc_module *orc);
+#endif
 #ifdef __cplusplus
 }
 #endif
@@ -1825,11 +1825,70 @@ static void visit_block(struct lp_build_nir_context *bld_base, nir_block *block)
    }
 }
 
+/* Whether the condition is the same for all invocations running the if */
+static bool if_is_uniform(const struct lp_build_nir_context *bld_base,
+                          const nir_if *if_stmt)
+{
+   return bld_base->uniform_cf && if_stmt->condition.is_ssa &&
+          !if_stmt->condition.ssa->divergent;
+}
+
+static bool cf_list_has_jump(struct exec_list *list)
+{
+   foreach_list_typed(nir_cf_node, node, node, list)
+   {
+      switch (node->type) {
+      case nir_cf_node_block:
+         if (nir_block_ends_in_jump(nir_cf_node_as_block(node)))
+            return true;
+         break;
+
+      case nir_cf_node_if: {
+         nir_if *if_stmt = nir_cf_node_as_if(node);
+         if (cf_list_has_jump(&if_stmt->then_list) ||
+             cf_list_has_jump(&if_stmt->else_list))
+            return true;
+         break;
+      }
+
+      default:
+         /* jumps in nested loops are to those */
+         break;
+      }
+   }
+   return false;
+}
+
+/*
+ * Whether the breaks and continues of a loop are only under uniform ifs,
+ * so all invocations which enter the loop run the same iterations.
+ */
+static bool cf_list_jumps_uniform(const struct lp_build_nir_context *bld_base,
+                                  struct exec_list *list)
+{
+   foreach_list_typed(nir_cf_node, node, node, list)
+   {
+      if (node->type != nir_cf_node_if)
+         continue;
+
+      nir_if *if_stmt = nir_cf_node_as_if(node);
+      if (if_is_uniform(bld_base, if_stmt)) {
+         if (!cf_list_jumps_uniform(bld_base, &if_stmt->then_list) ||
+             !cf_list_jumps_uniform(bld_base, &if_stmt->else_list))
+            return false;
+      } else if (cf_list_has_jump(&if_stmt->then_list) ||
+                 cf_list_has_jump(&if_stmt->else_list)) {
+         return false;
+      }
+   }
+   return true;
+}
+
 static void visit_if(struct lp_build_nir_context *bld_base, nir_if *if_stmt)
 {
    LLVMValueRef cond = get_src(bld_base, if_stmt->condition);
 
-   bld_base->if_cond(bld_base, cond);
+   bld_base->if_cond(bld_base, cond, if_is_uniform(bld_base, if_stmt));
    visit_cf_list(bld_base, &if_stmt->then_list);
 
    if (!exec_list_is_empty(&if_stmt->else_list)) {
@@ -1841,7 +1900,10 @@ static void visit_if(struct lp_build_nir_context *bld_base, nir_if *if_stmt)
 
 static void visit_loop(struct lp_build_nir_context *bld_base, nir_loop *loop)
 {
-   bld_base->bgnloop(bld_base);
+   bool uniform = bld_base->uniform_cf &&
+                  cf_list_jumps_uniform(bld_base, &loop->body);
+
+   bld_base->bgnloop(bld_base, uniform);
    visit_cf_list(bld_base, &loop->body);
    bld_base->endloop(bld_base);
 }
@@ -1900,13 +1962,27 @@ static LLVMTypeRef get_register_type(struct lp_build_nir_context *bld_base,
    return type;
 }
 
-
 bool lp_build_nir_llvm(
    struct lp_build_nir_context *bld_base,
    struct nir_shader *nir)
 {
    struct nir_function *func;
 
+   func = (struct nir_function *)exec_list_get_head(&nir->functions);
+
+   /*
+    * Find the values which are the same for all invocations while the
+    * shader is still in SSA form.  Only done for compute shaders so far.
+    * Shaders compiled before already had this done, their values keep the
+    * result.
+    */
+   bld_base->uniform_cf = gl_shader_stage_is_compute(nir->info.stage) &&
+                          !(gallivm_perf & GALLIVM_PERF_NO_UNIFORM_CF);
+   if (bld_base->uniform_cf && exec_list_is_empty(&func->impl->registers)) {
+      nir_convert_to_lcssa(nir, true, true);
+      nir_divergence_analysis(nir, 0);
+   }
+
    nir_convert_from_ssa(nir, true);
    nir_lower_locals_to_regs(nir);
    nir_remove_dead_derefs(nir);
@@ -1920,8 +1996,6 @@ bool lp_build_nir_llvm(
    bld_base->vars = _mesa_hash_table_create(NULL, _mesa_hash_pointer,
                                             _mesa_key_pointer_equal);
 
-   func = (struct nir_function *)exec_list_get_head(&nir->functions);
-
    nir_foreach_register(reg, &func->impl->registers) {
       LLVMTypeRef type = get_register_type(bld_base, reg);
       LLVMValueRef reg_alloc = lp_build_alloca_undef(bld_base->base.gallivm,
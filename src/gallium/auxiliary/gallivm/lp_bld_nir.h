@@ -28,6 +28,7 @@
 
 #include "gallivm/lp_bld.h"
 #include "gallivm/lp_bld_limits.h"
+#include "gallivm/lp_bld_flow.h"
 #include "lp_bld_type.h"
 
 #include "gallivm/lp_bld_tgsi.h"
@@ -59,6 +60,11 @@ struct lp_build_nir_context
 
    nir_shader *shader;
 
+   /* Divergence information is available, control flow on conditions which
+    * are the same for all invocations may use branches.
+    */
+   bool uniform_cf;
+
    void (*load_ubo)(struct lp_build_nir_context *bld_base,
                     unsigned nc,
                     unsigned bit_size,
@@ -162,9 +168,13 @@ struct lp_build_nir_context
    void (*discard)(struct lp_build_nir_context *bld_base,
                    LLVMValueRef cond);
 
-   void (*bgnloop)(struct lp_build_nir_context *bld_base);
+   /* uniform is set for loops which all invocations leave together and
+    * for ifs on uniform conditions.
+    */
+   void (*bgnloop)(struct lp_build_nir_context *bld_base, bool uniform);
    void (*endloop)(struct lp_build_nir_context *bld_base);
-   void (*if_cond)(struct lp_build_nir_context *bld_base, LLVMValueRef cond);
+   void (*if_cond)(struct lp_build_nir_context *bld_base, LLVMValueRef cond,
+                   bool uniform);
    void (*else_stmt)(struct lp_build_nir_context *bld_base);
    void (*endif_stmt)(struct lp_build_nir_context *bld_base);
    void (*break_stmt)(struct lp_build_nir_context *bld_base);
@@ -229,6 +239,30 @@ struct lp_build_nir_soa_context
    struct lp_build_mask_context *mask;
    struct lp_exec_mask exec_mask;
 
+   /* Ifs and loops on uniform conditions are branches which leave
+    * exec_mask alone.  One entry per nesting level, uniform is false for
+    * the ones done with exec_mask.
+    */
+   struct {
+      bool uniform;
+      struct lp_build_if_state ifthen;
+      struct lp_exec_mask entry_mask;  /**< exec_mask before the if */
+      struct lp_exec_mask then_mask;   /**< exec_mask after the then list */
+      LLVMBasicBlockRef then_block;    /**< last block of the then list */
+   } if_stack[LP_MAX_TGSI_NESTING];
+   int if_stack_size;
+
+   struct {
+      bool uniform;
+      LLVMBasicBlockRef loop_block;
+      LLVMBasicBlockRef continue_block;
+      LLVMBasicBlockRef exit_block;
+      LLVMValueRef active;             /**< any invocation entered the loop */
+      LLVMValueRef limiter;
+      struct lp_exec_mask entry_mask;  /**< exec_mask during the whole loop */
+   } loop_stack[LP_MAX_TGSI_NESTING];
+   int loop_stack_size;
+
    /* We allocate/use this array of inputs if (indirects & nir_var_shader_in) is
     * set. The inputs[] array above is unused then.
     */
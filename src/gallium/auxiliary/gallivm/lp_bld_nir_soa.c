@@ -1400,48 +1400,246 @@ static void emit_helper_invocation(struct lp_build_nir_context *bld_base,
    *dst = lp_build_cmp(uint_bld, PIPE_FUNC_NOTEQUAL, mask_vec(bld_base), lp_build_const_int_vec(gallivm, uint_bld->type, -1));
 }
 
-static void bgnloop(struct lp_build_nir_context *bld_base)
+/*
+ * Whether any lane of vec is set.
+ */
+static LLVMValueRef
+any_lane(struct lp_build_nir_context *bld_base, LLVMValueRef vec)
+{
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMTypeRef reg_type = LLVMIntTypeInContext(gallivm->context,
+                                               bld_base->base.type.width *
+                                               bld_base->base.type.length);
+
+   return LLVMBuildICmp(gallivm->builder, LLVMIntNE,
+                        LLVMBuildBitCast(gallivm->builder, vec, reg_type, ""),
+                        LLVMConstNull(reg_type), "");
+}
+
+/*
+ * Scalar value of a uniform condition.  Invocations which don't run may
+ * have computed anything, so this is whether any active invocation has
+ * cond set.
+ */
+static LLVMValueRef
+uniform_cond(struct lp_build_nir_context *bld_base, LLVMValueRef cond)
+{
+   LLVMBuilderRef builder = bld_base->base.gallivm->builder;
+   LLVMValueRef active = mask_vec(bld_base);
+
+   cond = LLVMBuildBitCast(builder, cond, bld_base->base.int_vec_type, "");
+   if (active)
+      cond = LLVMBuildAnd(builder, cond, active, "");
+   return any_lane(bld_base, cond);
+}
+
+static void
+merge_mask_value(LLVMBuilderRef builder, LLVMValueRef *val,
+                 LLVMBasicBlockRef block, LLVMValueRef other_val,
+                 LLVMBasicBlockRef other_block)
+{
+   LLVMValueRef vals[2] = { *val, other_val };
+   LLVMBasicBlockRef blocks[2] = { block, other_block };
+
+   if (*val == other_val)
+      return;
+
+   *val = LLVMBuildPhi(builder, LLVMTypeOf(other_val), "");
+   LLVMAddIncoming(*val, vals, blocks, 2);
+}
+
+/*
+ * Join the exec_mask coming from block with the one coming from
+ * other_block at the start of the current block.  They differ when a
+ * masked loop was left or continued on one side.
+ */
+static void
+merge_exec_mask(struct lp_build_nir_soa_context *bld, LLVMBasicBlockRef block,
+                const struct lp_exec_mask *other, LLVMBasicBlockRef other_block)
+{
+   LLVMBuilderRef builder = bld->bld_base.base.gallivm->builder;
+   struct lp_exec_mask *mask = &bld->exec_mask;
+
+   assert(mask->has_mask == other->has_mask);
+   merge_mask_value(builder, &mask->exec_mask, block, other->exec_mask, other_block);
+   merge_mask_value(builder, &mask->ret_mask, block, other->ret_mask, other_block);
+   merge_mask_value(builder, &mask->cond_mask, block, other->cond_mask, other_block);
+   merge_mask_value(builder, &mask->switch_mask, block, other->switch_mask, other_block);
+   merge_mask_value(builder, &mask->cont_mask, block, other->cont_mask, other_block);
+   merge_mask_value(builder, &mask->break_mask, block, other->break_mask, other_block);
+}
+
+static void bgnloop(struct lp_build_nir_context *bld_base, bool uniform)
 {
    struct lp_build_nir_soa_context *bld = (struct lp_build_nir_soa_context *)bld_base;
-   lp_exec_bgnloop(&bld->exec_mask, true);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef int_type = LLVMInt32TypeInContext(gallivm->context);
+
+   if (bld->loop_stack_size >= LP_MAX_TGSI_NESTING) {
+      bld->loop_stack_size++;
+      lp_exec_bgnloop(&bld->exec_mask, true);
+      return;
+   }
+
+   bld->loop_stack[bld->loop_stack_size].uniform = uniform;
+   if (!uniform) {
+      bld->loop_stack_size++;
+      lp_exec_bgnloop(&bld->exec_mask, true);
+      return;
+   }
+
+   /*
+    * All invocations run the same iterations, so exec_mask stays what it
+    * is now and breaks and continues are branches.  Like masked loops
+    * these are limited to LP_MAX_TGSI_LOOP_ITERATIONS, and end when no
+    * invocation is active, as then the conditions are meaningless.
+    */
+   LLVMValueRef active = mask_vec(bld_base);
+   bld->loop_stack[bld->loop_stack_size].active =
+      active ? any_lane(bld_base, active) : LLVMConstInt(LLVMInt1TypeInContext(gallivm->context), 1, 0);
+   bld->loop_stack[bld->loop_stack_size].limiter =
+      lp_build_alloca(gallivm, int_type, "looplimiter");
+   LLVMBuildStore(builder, LLVMConstInt(int_type, LP_MAX_TGSI_LOOP_ITERATIONS, false),
+                  bld->loop_stack[bld->loop_stack_size].limiter);
+   bld->loop_stack[bld->loop_stack_size].entry_mask = bld->exec_mask;
+
+   bld->loop_stack[bld->loop_stack_size].loop_block =
+      lp_build_insert_new_block(gallivm, "bgnloop");
+   LLVMBuildBr(builder, bld->loop_stack[bld->loop_stack_size].loop_block);
+   LLVMPositionBuilderAtEnd(builder, bld->loop_stack[bld->loop_stack_size].loop_block);
+
+   bld->loop_stack[bld->loop_stack_size].exit_block =
+      lp_build_insert_new_block(gallivm, "endloop");
+   bld->loop_stack[bld->loop_stack_size].continue_block =
+      lp_build_insert_new_block(gallivm, "continue");
+   bld->loop_stack_size++;
 }
 
 static void endloop(struct lp_build_nir_context *bld_base)
 {
    struct lp_build_nir_soa_context *bld = (struct lp_build_nir_soa_context *)bld_base;
-   lp_exec_endloop(bld_base->base.gallivm, &bld->exec_mask);
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef int_type = LLVMInt32TypeInContext(gallivm->context);
+   LLVMValueRef limiter, cond;
+
+   assert(bld->loop_stack_size);
+   if (--bld->loop_stack_size >= LP_MAX_TGSI_NESTING ||
+       !bld->loop_stack[bld->loop_stack_size].uniform) {
+      lp_exec_endloop(gallivm, &bld->exec_mask);
+      return;
+   }
+
+   LLVMBuildBr(builder, bld->loop_stack[bld->loop_stack_size].continue_block);
+   LLVMPositionBuilderAtEnd(builder, bld->loop_stack[bld->loop_stack_size].continue_block);
+
+   limiter = LLVMBuildLoad(builder, bld->loop_stack[bld->loop_stack_size].limiter, "");
+   limiter = LLVMBuildSub(builder, limiter, LLVMConstInt(int_type, 1, false), "");
+   LLVMBuildStore(builder, limiter, bld->loop_stack[bld->loop_stack_size].limiter);
+
+   cond = LLVMBuildICmp(builder, LLVMIntSGT, limiter, LLVMConstNull(int_type), "");
+   cond = LLVMBuildAnd(builder, cond, bld->loop_stack[bld->loop_stack_size].active, "");
+   LLVMBuildCondBr(builder, cond, bld->loop_stack[bld->loop_stack_size].loop_block,
+                   bld->loop_stack[bld->loop_stack_size].exit_block);
+
+   LLVMPositionBuilderAtEnd(builder, bld->loop_stack[bld->loop_stack_size].exit_block);
+   bld->exec_mask = bld->loop_stack[bld->loop_stack_size].entry_mask;
 }
 
-static void if_cond(struct lp_build_nir_context *bld_base, LLVMValueRef cond)
+static void if_cond(struct lp_build_nir_context *bld_base, LLVMValueRef cond,
+                    bool uniform)
 {
    LLVMBuilderRef builder = bld_base->base.gallivm->builder;
    struct lp_build_nir_soa_context *bld = (struct lp_build_nir_soa_context *)bld_base;
-   lp_exec_mask_cond_push(&bld->exec_mask, LLVMBuildBitCast(builder, cond, bld_base->base.int_vec_type, ""));
+
+   if (bld->if_stack_size >= LP_MAX_TGSI_NESTING)
+      uniform = false;
+   else
+      bld->if_stack[bld->if_stack_size].uniform = uniform;
+
+   if (uniform) {
+      bld->if_stack[bld->if_stack_size].entry_mask = bld->exec_mask;
+      bld->if_stack[bld->if_stack_size].then_block = NULL;
+      lp_build_if(&bld->if_stack[bld->if_stack_size].ifthen,
+                  bld_base->base.gallivm, uniform_cond(bld_base, cond));
+   } else {
+      lp_exec_mask_cond_push(&bld->exec_mask, LLVMBuildBitCast(builder, cond, bld_base->base.int_vec_type, ""));
+   }
+   bld->if_stack_size++;
 }
 
 static void else_stmt(struct lp_build_nir_context *bld_base)
 {
    struct lp_build_nir_soa_context *bld = (struct lp_build_nir_soa_context *)bld_base;
-   lp_exec_mask_cond_invert(&bld->exec_mask);
+   int i = bld->if_stack_size - 1;
+
+   assert(bld->if_stack_size);
+   if (i < LP_MAX_TGSI_NESTING && bld->if_stack[i].uniform) {
+      bld->if_stack[i].then_mask = bld->exec_mask;
+      bld->if_stack[i].then_block = LLVMGetInsertBlock(bld_base->base.gallivm->builder);
+      bld->exec_mask = bld->if_stack[i].entry_mask;
+      lp_build_else(&bld->if_stack[i].ifthen);
+   } else {
+      lp_exec_mask_cond_invert(&bld->exec_mask);
+   }
 }
 
 static void endif_stmt(struct lp_build_nir_context *bld_base)
 {
    struct lp_build_nir_soa_context *bld = (struct lp_build_nir_soa_context *)bld_base;
-   lp_exec_mask_cond_pop(&bld->exec_mask);
+   int i = --bld->if_stack_size;
+
+   assert(i >= 0);
+   if (i < LP_MAX_TGSI_NESTING && bld->if_stack[i].uniform) {
+      LLVMBasicBlockRef block = LLVMGetInsertBlock(bld_base->base.gallivm->builder);
+
+      lp_build_endif(&bld->if_stack[i].ifthen);
+      if (bld->if_stack[i].then_block)
+         merge_exec_mask(bld, block, &bld->if_stack[i].then_mask,
+                         bld->if_stack[i].then_block);
+      else
+         merge_exec_mask(bld, block, &bld->if_stack[i].entry_mask,
+                         bld->if_stack[i].ifthen.entry_block);
+   } else {
+      lp_exec_mask_cond_pop(&bld->exec_mask);
+   }
+}
+
+/*
+ * Jump out of a uniform loop.  Code following the jump in the same NIR
+ * block can't run, it goes to a block without predecessors.
+ */
+static void uniform_jump(struct lp_build_nir_context *bld_base,
+                         LLVMBasicBlockRef target)
+{
+   struct gallivm_state *gallivm = bld_base->base.gallivm;
+
+   LLVMBuildBr(gallivm->builder, target);
+   LLVMPositionBuilderAtEnd(gallivm->builder,
+                            lp_build_insert_new_block(gallivm, "after_jump"));
 }
 
 static void break_stmt(struct lp_build_nir_context *bld_base)
 {
    struct lp_build_nir_soa_context *bld = (struct lp_build_nir_soa_context *)bld_base;
+   int i = bld->loop_stack_size - 1;
 
-   lp_exec_break(&bld->exec_mask, NULL, false);
+   if (i >= 0 && i < LP_MAX_TGSI_NESTING && bld->loop_stack[i].uniform)
+      uniform_jump(bld_base, bld->loop_stack[i].exit_block);
+   else
+      lp_exec_break(&bld->exec_mask, NULL, false);
 }
 
 static void continue_stmt(struct lp_build_nir_context *bld_base)
 {
    struct lp_build_nir_soa_context *bld = (struct lp_build_nir_soa_context *)bld_base;
-   lp_exec_continue(&bld->exec_mask);
+   int i = bld->loop_stack_size - 1;
+
+   if (i >= 0 && i < LP_MAX_TGSI_NESTING && bld->loop_stack[i].uniform)
+      uniform_jump(bld_base, bld->loop_stack[i].continue_block);
+   else
+      lp_exec_continue(&bld->exec_mask);
 }
 
 static void discard(struct lp_build_nir_context *bld_base, LLVMValueRef cond)
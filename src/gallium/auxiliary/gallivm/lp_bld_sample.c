@@ -2058,6 +2058,42 @@ lp_build_sample_partial_offset(struct lp_build_context *bld,
 }
 
 
+/**
+ * Compute the partial offset of a texel along the x or y axis of a tiled
+ * texture (see LP_BUILD_SAMPLE_TILE_SIZE).
+ *
+ * @param coord   coordinate in texels
+ * @param stride  number of bytes per texel along the axis, counted in
+ *                whole tiles (texel size * tile size for x, row stride for y)
+ * @param tile_stride  number of bytes between successive texels along the
+ *                     axis within a tile (texel size for x, texel size *
+ *                     tile size for y)
+ * @param out_offset   resulting relative offset of the texel in bytes
+ */
+void
+lp_build_sample_tiled_partial_offset(struct lp_build_context *bld,
+                                     LLVMValueRef coord,
+                                     LLVMValueRef stride,
+                                     LLVMValueRef tile_stride,
+                                     LLVMValueRef *out_offset)
+{
+   LLVMBuilderRef builder = bld->gallivm->builder;
+   LLVMValueRef tile_mask;
+   LLVMValueRef tile_coord;
+   LLVMValueRef offset;
+
+   tile_mask = lp_build_const_int_vec(bld->gallivm, bld->type,
+                                      LP_BUILD_SAMPLE_TILE_SIZE - 1);
+   tile_coord = LLVMBuildAnd(builder, coord, tile_mask, "");
+   coord = LLVMBuildXor(builder, coord, tile_coord, "");
+
+   offset = lp_build_mul(bld, coord, stride);
+   offset = lp_build_add(bld, offset, lp_build_mul(bld, tile_coord, tile_stride));
+
+   *out_offset = offset;
+}
+
+
 /**
  * Compute the offset of a pixel block.
  *
@@ -2068,6 +2104,7 @@ lp_build_sample_partial_offset(struct lp_build_context *bld,
 void
 lp_build_sample_offset(struct lp_build_context *bld,
                        const struct util_format_description *format_desc,
+                       boolean tiled,
                        LLVMValueRef x,
                        LLVMValueRef y,
                        LLVMValueRef z,
@@ -2083,21 +2120,45 @@ lp_build_sample_offset(struct lp_build_context *bld,
    x_stride = lp_build_const_vec(bld->gallivm, bld->type,
                                  format_desc->block.bits/8);
 
-   lp_build_sample_partial_offset(bld,
-                                  format_desc->block.width,
-                                  x, x_stride,
-                                  &offset, out_i);
+   if (tiled) {
+      LLVMValueRef tile_row_stride;
 
-   if (y && y_stride) {
-      LLVMValueRef y_offset;
-      lp_build_sample_partial_offset(bld,
-                                     format_desc->block.height,
-                                     y, y_stride,
-                                     &y_offset, out_j);
-      offset = lp_build_add(bld, offset, y_offset);
+      assert(format_desc->block.width == 1);
+      assert(format_desc->block.height == 1);
+
+      tile_row_stride = lp_build_const_vec(bld->gallivm, bld->type,
+                                           format_desc->block.bits/8 *
+                                           LP_BUILD_SAMPLE_TILE_SIZE);
+
+      lp_build_sample_tiled_partial_offset(bld, x, tile_row_stride, x_stride,
+                                           &offset);
+      *out_i = bld->zero;
+
+      if (y && y_stride) {
+         LLVMValueRef y_offset;
+         lp_build_sample_tiled_partial_offset(bld, y, y_stride, tile_row_stride,
+                                              &y_offset);
+         offset = lp_build_add(bld, offset, y_offset);
+      }
+      *out_j = bld->zero;
    }
    else {
-      *out_j = bld->zero;
+      lp_build_sample_partial_offset(bld,
+                                     format_desc->block.width,
+                                     x, x_stride,
+                                     &offset, out_i);
+
+      if (y && y_stride) {
+         LLVMValueRef y_offset;
+         lp_build_sample_partial_offset(bld,
+                                        format_desc->block.height,
+                                        y, y_stride,
+                                        &y_offset, out_j);
+         offset = lp_build_add(bld, offset, y_offset);
+      }
+      else {
+         *out_j = bld->zero;
+      }
    }
 
    if (z && z_stride) {
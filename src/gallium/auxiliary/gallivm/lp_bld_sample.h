@@ -51,6 +51,7 @@ struct pipe_sampler_view;
 struct pipe_sampler_state;
 struct pipe_image_view;
 struct util_format_description;
+struct lp_sample_func_cache;
 struct lp_type;
 struct lp_build_context;
 
@@ -171,9 +172,22 @@ struct lp_static_texture_state
    unsigned pot_height:1;
    unsigned pot_depth:1;
    unsigned level_zero_only:1;
+   unsigned tiled:1;         /**< see LP_BUILD_SAMPLE_TILE_SIZE */
 };
 
 
+/**
+ * Textures with the tiled bit of lp_static_texture_state set are stored in
+ * tiles of LP_BUILD_SAMPLE_TILE_SIZE x LP_BUILD_SAMPLE_TILE_SIZE texels
+ * rather than linearly.  Each tile is contiguous, with its texels in
+ * row-major order, and the tiles of a row of tiles follow each other.
+ * Rows of tiles are row_stride * LP_BUILD_SAMPLE_TILE_SIZE bytes apart, so
+ * row_stride and img_stride keep their meaning.  Only for formats with 1x1
+ * blocks.  lp_sampler_static_texture_state() leaves it to drivers to set.
+ */
+#define LP_BUILD_SAMPLE_TILE_SIZE 4
+
+
 /**
  * Sampler static state.
  *
@@ -336,6 +350,16 @@ struct lp_sampler_dynamic_state
                 struct gallivm_state *gallivm,
                 LLVMValueRef thread_data_ptr,
                 unsigned unit);
+
+   /**
+    * Cache of compiled sampling functions shared between modules.
+    *
+    * It's optional: if NULL, sampling which is not inlined goes through
+    * functions generated in the caller's module.  Otherwise the callbacks
+    * above are also used to generate code in other modules, so they must
+    * only depend on their arguments.
+    */
+   struct lp_sample_func_cache *func_cache;
 };
 
 
@@ -638,9 +662,18 @@ lp_build_sample_partial_offset(struct lp_build_context *bld,
                                LLVMValueRef *out_i);
 
 
+void
+lp_build_sample_tiled_partial_offset(struct lp_build_context *bld,
+                                     LLVMValueRef coord,
+                                     LLVMValueRef stride,
+                                     LLVMValueRef tile_stride,
+                                     LLVMValueRef *out_offset);
+
+
 void
 lp_build_sample_offset(struct lp_build_context *bld,
                        const struct util_format_description *format_desc,
+                       boolean tiled,
                        LLVMValueRef x,
                        LLVMValueRef y,
                        LLVMValueRef z,
@@ -659,6 +692,23 @@ lp_build_sample_soa(const struct lp_static_texture_state *static_texture_state,
                     const struct lp_sampler_params *params);
 
 
+/**
+ * Create the pointer types of the context and thread data arguments of
+ * sampling functions in the given gallivm.  The types pointed to only
+ * need the members the lp_sampler_dynamic_state callbacks access.
+ */
+typedef void
+(*lp_sample_func_types_func)(struct gallivm_state *gallivm,
+                             LLVMTypeRef *context_ptr_type,
+                             LLVMTypeRef *thread_data_ptr_type);
+
+struct lp_sample_func_cache *
+lp_sample_func_cache_create(lp_sample_func_types_func create_types);
+
+void
+lp_sample_func_cache_destroy(struct lp_sample_func_cache *cache);
+
+
 void
 lp_build_coord_repeat_npot_linear(struct lp_build_sample_context *bld,
                                   LLVMValueRef coord_f,
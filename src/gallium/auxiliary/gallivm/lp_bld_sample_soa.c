@@ -43,6 +43,9 @@
 #include "util/format/u_format.h"
 #include "util/u_cpu_detect.h"
 #include "util/format_rgb9e5.h"
+#include "util/hash_table.h"
+#include "util/mesa-sha1.h"
+#include "c11/threads.h"
 #include "lp_bld_debug.h"
 #include "lp_bld_type.h"
 #include "lp_bld_const.h"
@@ -62,6 +65,7 @@
 #include "lp_bld_pack.h"
 #include "lp_bld_intr.h"
 #include "lp_bld_misc.h"
+#include "lp_bld_init.h"
 
 
 /**
@@ -140,6 +144,7 @@ lp_build_sample_texel_soa(struct lp_build_sample_context *bld,
    /* convert x,y,z coords to linear offset from start of texture, in bytes */
    lp_build_sample_offset(&bld->int_coord_bld,
                           bld->format_desc,
+                          bld->static_texture_state->tiled,
                           x, y, z, y_stride, z_stride,
                           &offset, &i, &j);
    if (mipoffsets) {
@@ -2708,6 +2713,7 @@ lp_build_fetch_texel(struct lp_build_sample_context *bld,
 
    lp_build_sample_offset(int_coord_bld,
                           bld->format_desc,
+                          bld->static_texture_state->tiled,
                           x, y, z, row_stride_vec, img_stride_vec,
                           &offset, &i, &j);
 
@@ -3494,7 +3500,7 @@ lp_build_sample_gen_func(struct gallivm_state *gallivm,
    if (dynamic_state->cache_ptr) {
       const struct util_format_description *format_desc;
       format_desc = util_format_description(static_texture_state->format);
-      if (format_desc && format_desc->layout == UTIL_FORMAT_LAYOUT_S3TC) {
+      if (format_desc && lp_build_format_cache_supported(format_desc)) {
          need_cache = TRUE;
       }
    }
@@ -3574,6 +3580,284 @@ lp_build_sample_gen_func(struct gallivm_state *gallivm,
 }
 
 
+/**
+ * Key of a shared sampling function.  The function reads the dynamic
+ * state through the context at fixed units, so these are part of it.
+ */
+struct lp_sample_func_key
+{
+   struct lp_static_texture_state texture_state;
+   struct lp_static_sampler_state sampler_state;
+   struct lp_type type;
+   unsigned sample_key;
+   unsigned texture_index;
+   unsigned sampler_index;
+};
+
+
+struct lp_sample_func
+{
+   struct lp_sample_func_key key;
+   /** "texfunc_" plus the SHA-1 of the key, the same in every process */
+   char name[8 + 40 + 1];
+   struct gallivm_state *gallivm;
+   void *code;
+};
+
+
+struct lp_sample_func_cache
+{
+   lp_sample_func_types_func create_types;
+
+   /** Guards everything below, as variants are compiled concurrently */
+   mtx_t mutex;
+   LLVMContextRef context;
+   struct hash_table *funcs;
+};
+
+
+static uint32_t
+lp_sample_func_key_hash(const void *key)
+{
+   return _mesa_hash_data(key, sizeof(struct lp_sample_func_key));
+}
+
+
+static bool
+lp_sample_func_key_equal(const void *a, const void *b)
+{
+   return memcmp(a, b, sizeof(struct lp_sample_func_key)) == 0;
+}
+
+
+struct lp_sample_func_cache *
+lp_sample_func_cache_create(lp_sample_func_types_func create_types)
+{
+   struct lp_sample_func_cache *cache;
+
+   cache = CALLOC_STRUCT(lp_sample_func_cache);
+   if (!cache)
+      return NULL;
+
+   cache->create_types = create_types;
+   cache->context = LLVMContextCreate();
+   cache->funcs = _mesa_hash_table_create(NULL, lp_sample_func_key_hash,
+                                          lp_sample_func_key_equal);
+   if (!cache->context || !cache->funcs) {
+      if (cache->context)
+         LLVMContextDispose(cache->context);
+      _mesa_hash_table_destroy(cache->funcs, NULL);
+      FREE(cache);
+      return NULL;
+   }
+
+   (void) mtx_init(&cache->mutex, mtx_plain);
+
+   return cache;
+}
+
+
+void
+lp_sample_func_cache_destroy(struct lp_sample_func_cache *cache)
+{
+   if (!cache)
+      return;
+
+   hash_table_foreach(cache->funcs, entry) {
+      struct lp_sample_func *func = entry->data;
+
+      gallivm_destroy(func->gallivm);
+      FREE(func);
+   }
+   _mesa_hash_table_destroy(cache->funcs, NULL);
+
+   LLVMContextDispose(cache->context);
+   mtx_destroy(&cache->mutex);
+   FREE(cache);
+}
+
+
+/**
+ * Recreate a scalar or vector type of another LLVM context.
+ */
+static LLVMTypeRef
+lp_sample_func_arg_type(LLVMContextRef context, LLVMTypeRef type)
+{
+   switch (LLVMGetTypeKind(type)) {
+   case LLVMVectorTypeKind:
+      return LLVMVectorType(lp_sample_func_arg_type(context,
+                                                    LLVMGetElementType(type)),
+                            LLVMGetVectorSize(type));
+   case LLVMIntegerTypeKind:
+      return LLVMIntTypeInContext(context, LLVMGetIntTypeWidth(type));
+   case LLVMFloatTypeKind:
+      return LLVMFloatTypeInContext(context);
+   default:
+      assert(0);
+      return LLVMFloatTypeInContext(context);
+   }
+}
+
+
+/**
+ * Generate and compile a shared sampling function, in its own module.
+ * arg_types are the caller's, only the pointer types differ in the
+ * function's module.
+ */
+static boolean
+lp_sample_func_compile(struct lp_sample_func_cache *cache,
+                       struct lp_sample_func *func,
+                       struct lp_sampler_dynamic_state *dynamic_state,
+                       const LLVMTypeRef *arg_types,
+                       unsigned num_args,
+                       boolean need_cache)
+{
+   const struct lp_sample_func_key *key = &func->key;
+   struct gallivm_state *gallivm;
+   LLVMTypeRef func_arg_types[LP_MAX_TEX_FUNC_ARGS];
+   LLVMTypeRef context_ptr_type, thread_data_ptr_type;
+   LLVMTypeRef val_type[4];
+   LLVMTypeRef ret_type;
+   LLVMValueRef function;
+   unsigned i, num_param = 0;
+
+   gallivm = gallivm_create(func->name, cache->context, NULL);
+   if (!gallivm)
+      return FALSE;
+
+   cache->create_types(gallivm, &context_ptr_type, &thread_data_ptr_type);
+
+   func_arg_types[num_param++] = context_ptr_type;
+   if (need_cache) {
+      func_arg_types[num_param++] = thread_data_ptr_type;
+   }
+   for (i = num_param; i < num_args; i++) {
+      func_arg_types[i] = lp_sample_func_arg_type(cache->context,
+                                                  arg_types[i]);
+   }
+
+   val_type[0] = val_type[1] = val_type[2] = val_type[3] =
+      lp_build_vec_type(gallivm, key->type);
+   ret_type = LLVMStructTypeInContext(gallivm->context, val_type, 4, 0);
+   function = LLVMAddFunction(gallivm->module, func->name,
+                              LLVMFunctionType(ret_type, func_arg_types,
+                                               num_args, 0));
+
+   for (i = 0; i < num_args; ++i) {
+      if (LLVMGetTypeKind(func_arg_types[i]) == LLVMPointerTypeKind) {
+         lp_add_function_attr(function, i + 1, LP_FUNC_ATTR_NOALIAS);
+      }
+   }
+
+   LLVMSetFunctionCallConv(function, LLVMFastCallConv);
+
+   lp_build_sample_gen_func(gallivm,
+                            &key->texture_state,
+                            &key->sampler_state,
+                            dynamic_state,
+                            key->type,
+                            key->texture_index,
+                            key->sampler_index,
+                            function,
+                            num_args,
+                            key->sample_key);
+
+   gallivm_compile_module(gallivm);
+
+   func->code = func_to_pointer(gallivm_jit_function(gallivm, function));
+   func->gallivm = gallivm;
+
+   gallivm_free_ir(gallivm);
+
+   return func->code != NULL;
+}
+
+
+/**
+ * Declare the shared sampling function matching the given state in the
+ * caller's module, compiling it first if no variant needed it before.
+ * \return NULL if the function could not be compiled
+ */
+static LLVMValueRef
+lp_sample_func_get(struct gallivm_state *gallivm,
+                   LLVMModuleRef module,
+                   const struct lp_static_texture_state *static_texture_state,
+                   const struct lp_static_sampler_state *static_sampler_state,
+                   struct lp_sampler_dynamic_state *dynamic_state,
+                   const struct lp_sampler_params *params,
+                   LLVMTypeRef function_type,
+                   const LLVMTypeRef *arg_types,
+                   unsigned num_args,
+                   boolean need_cache)
+{
+   struct lp_sample_func_cache *cache = dynamic_state->func_cache;
+   struct lp_sample_func_key key;
+   struct lp_sample_func *func;
+   struct hash_entry *entry;
+   LLVMValueRef function;
+   unsigned i;
+
+   memset(&key, 0, sizeof key);
+   memcpy(&key.texture_state, static_texture_state, sizeof key.texture_state);
+   memcpy(&key.sampler_state, static_sampler_state, sizeof key.sampler_state);
+   key.type = params->type;
+   key.sample_key = params->sample_key;
+   key.texture_index = params->texture_index;
+   key.sampler_index = params->sampler_index;
+
+   mtx_lock(&cache->mutex);
+
+   entry = _mesa_hash_table_search(cache->funcs, &key);
+   if (entry) {
+      func = entry->data;
+   }
+   else {
+      unsigned char sha1[20];
+
+      func = CALLOC_STRUCT(lp_sample_func);
+      if (!func) {
+         mtx_unlock(&cache->mutex);
+         return NULL;
+      }
+
+      memcpy(&func->key, &key, sizeof key);
+      _mesa_sha1_compute(&key, sizeof key, sha1);
+      memcpy(func->name, "texfunc_", 8);
+      _mesa_sha1_format(func->name + 8, sha1);
+
+      if (!lp_sample_func_compile(cache, func, dynamic_state,
+                                  arg_types, num_args, need_cache)) {
+         if (func->gallivm)
+            gallivm_destroy(func->gallivm);
+         FREE(func);
+         mtx_unlock(&cache->mutex);
+         return NULL;
+      }
+
+      _mesa_hash_table_insert(cache->funcs, &func->key, func);
+   }
+
+   mtx_unlock(&cache->mutex);
+
+   function = LLVMGetNamedFunction(module, func->name);
+   if (!function) {
+      function = LLVMAddFunction(module, func->name, function_type);
+
+      for (i = 0; i < num_args; ++i) {
+         if (LLVMGetTypeKind(arg_types[i]) == LLVMPointerTypeKind) {
+            lp_add_function_attr(function, i + 1, LP_FUNC_ATTR_NOALIAS);
+         }
+      }
+
+      LLVMSetFunctionCallConv(function, LLVMFastCallConv);
+
+      gallivm_add_global_mapping(gallivm, function, func->code);
+   }
+
+   return function;
+}
+
+
 /**
  * Call the matching function for texture sampling.
  * If there's no match, generate a new one.
@@ -3588,11 +3872,16 @@ lp_build_sample_soa_func(struct gallivm_state *gallivm,
    LLVMBuilderRef builder = gallivm->builder;
    LLVMModuleRef module = LLVMGetGlobalParent(LLVMGetBasicBlockParent(
                              LLVMGetInsertBlock(builder)));
-   LLVMValueRef function, inst;
+   LLVMValueRef function = NULL, inst;
    LLVMValueRef args[LP_MAX_TEX_FUNC_ARGS];
+   LLVMTypeRef arg_types[LP_MAX_TEX_FUNC_ARGS];
+   LLVMTypeRef ret_type;
+   LLVMTypeRef function_type;
+   LLVMTypeRef val_type[4];
    LLVMBasicBlockRef bb;
    LLVMValueRef tex_ret;
    unsigned num_args = 0;
+   unsigned num_param = 0;
    char func_name[64];
    unsigned i, num_coords, num_derivs, num_offsets, layer;
    unsigned texture_index = params->texture_index;
@@ -3613,10 +3902,69 @@ lp_build_sample_soa_func(struct gallivm_state *gallivm,
    if (dynamic_state->cache_ptr) {
       const struct util_format_description *format_desc;
       format_desc = util_format_description(static_texture_state->format);
-      if (format_desc && format_desc->layout == UTIL_FORMAT_LAYOUT_S3TC) {
+      if (format_desc && lp_build_format_cache_supported(format_desc)) {
          need_cache = TRUE;
       }
    }
+
+   /*
+    * Generate the function prototype.
+    */
+
+   arg_types[num_param++] = LLVMTypeOf(params->context_ptr);
+   if (need_cache) {
+      arg_types[num_param++] = LLVMTypeOf(params->thread_data_ptr);
+   }
+   for (i = 0; i < num_coords; i++) {
+      arg_types[num_param++] = LLVMTypeOf(coords[0]);
+      assert(LLVMTypeOf(coords[0]) == LLVMTypeOf(coords[i]));
+   }
+   if (layer) {
+      arg_types[num_param++] = LLVMTypeOf(coords[layer]);
+      assert(LLVMTypeOf(coords[0]) == LLVMTypeOf(coords[layer]));
+   }
+   if (sample_key & LP_SAMPLER_SHADOW) {
+      arg_types[num_param++] = LLVMTypeOf(coords[0]);
+   }
+   if (sample_key & LP_SAMPLER_FETCH_MS) {
+      arg_types[num_param++] = LLVMTypeOf(params->ms_index);
+   }
+   if (sample_key & LP_SAMPLER_OFFSETS) {
+      for (i = 0; i < num_offsets; i++) {
+         arg_types[num_param++] = LLVMTypeOf(offsets[0]);
+         assert(LLVMTypeOf(offsets[0]) == LLVMTypeOf(offsets[i]));
+      }
+   }
+   if (lod_control == LP_SAMPLER_LOD_BIAS ||
+       lod_control == LP_SAMPLER_LOD_EXPLICIT) {
+      arg_types[num_param++] = LLVMTypeOf(params->lod);
+   }
+   else if (lod_control == LP_SAMPLER_LOD_DERIVATIVES) {
+      for (i = 0; i < num_derivs; i++) {
+         arg_types[num_param++] = LLVMTypeOf(derivs->ddx[i]);
+         arg_types[num_param++] = LLVMTypeOf(derivs->ddy[i]);
+         assert(LLVMTypeOf(derivs->ddx[0]) == LLVMTypeOf(derivs->ddx[i]));
+         assert(LLVMTypeOf(derivs->ddy[0]) == LLVMTypeOf(derivs->ddy[i]));
+      }
+   }
+
+   val_type[0] = val_type[1] = val_type[2] = val_type[3] =
+      lp_build_vec_type(gallivm, params->type);
+   ret_type = LLVMStructTypeInContext(gallivm->context, val_type, 4, 0);
+   function_type = LLVMFunctionType(ret_type, arg_types, num_param, 0);
+
+   if (dynamic_state->func_cache) {
+      function = lp_sample_func_get(gallivm, module,
+                                    static_texture_state,
+                                    static_sampler_state,
+                                    dynamic_state,
+                                    params,
+                                    function_type,
+                                    arg_types,
+                                    num_param,
+                                    need_cache);
+   }
+
    /*
     * texture function matches are found by name.
     * Thus the name has to include both the texture and sampler unit
@@ -3628,60 +3976,10 @@ lp_build_sample_soa_func(struct gallivm_state *gallivm,
    snprintf(func_name, sizeof(func_name), "texfunc_res_%d_sam_%d_%x",
             texture_index, sampler_index, sample_key);
 
-   function = LLVMGetNamedFunction(module, func_name);
+   if (!function)
+      function = LLVMGetNamedFunction(module, func_name);
 
    if(!function) {
-      LLVMTypeRef arg_types[LP_MAX_TEX_FUNC_ARGS];
-      LLVMTypeRef ret_type;
-      LLVMTypeRef function_type;
-      LLVMTypeRef val_type[4];
-      unsigned num_param = 0;
-
-      /*
-       * Generate the function prototype.
-       */
-
-      arg_types[num_param++] = LLVMTypeOf(params->context_ptr);
-      if (need_cache) {
-         arg_types[num_param++] = LLVMTypeOf(params->thread_data_ptr);
-      }
-      for (i = 0; i < num_coords; i++) {
-         arg_types[num_param++] = LLVMTypeOf(coords[0]);
-         assert(LLVMTypeOf(coords[0]) == LLVMTypeOf(coords[i]));
-      }
-      if (layer) {
-         arg_types[num_param++] = LLVMTypeOf(coords[layer]);
-         assert(LLVMTypeOf(coords[0]) == LLVMTypeOf(coords[layer]));
-      }
-      if (sample_key & LP_SAMPLER_SHADOW) {
-         arg_types[num_param++] = LLVMTypeOf(coords[0]);
-      }
-      if (sample_key & LP_SAMPLER_FETCH_MS) {
-         arg_types[num_param++] = LLVMTypeOf(params->ms_index);
-      }
-      if (sample_key & LP_SAMPLER_OFFSETS) {
-         for (i = 0; i < num_offsets; i++) {
-            arg_types[num_param++] = LLVMTypeOf(offsets[0]);
-            assert(LLVMTypeOf(offsets[0]) == LLVMTypeOf(offsets[i]));
-         }
-      }
-      if (lod_control == LP_SAMPLER_LOD_BIAS ||
-          lod_control == LP_SAMPLER_LOD_EXPLICIT) {
-         arg_types[num_param++] = LLVMTypeOf(params->lod);
-      }
-      else if (lod_control == LP_SAMPLER_LOD_DERIVATIVES) {
-         for (i = 0; i < num_derivs; i++) {
-            arg_types[num_param++] = LLVMTypeOf(derivs->ddx[i]);
-            arg_types[num_param++] = LLVMTypeOf(derivs->ddy[i]);
-            assert(LLVMTypeOf(derivs->ddx[0]) == LLVMTypeOf(derivs->ddx[i]));
-            assert(LLVMTypeOf(derivs->ddy[0]) == LLVMTypeOf(derivs->ddy[i]));
-         }
-      }
-
-      val_type[0] = val_type[1] = val_type[2] = val_type[3] =
-         lp_build_vec_type(gallivm, params->type);
-      ret_type = LLVMStructTypeInContext(gallivm->context, val_type, 4, 0);
-      function_type = LLVMFunctionType(ret_type, arg_types, num_param, 0);
       function = LLVMAddFunction(module, func_name, function_type);
 
       for (i = 0; i < num_param; ++i) {
@@ -4159,6 +4457,7 @@ lp_build_img_op_soa(const struct lp_static_texture_state *static_texture_state,
    }
    lp_build_sample_offset(&int_coord_bld,
                           format_desc,
+                          static_texture_state->tiled,
                           x, y, z, row_stride_vec, img_stride_vec,
                           &offset, &i, &j);
 
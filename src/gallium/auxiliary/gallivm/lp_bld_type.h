@@ -53,6 +53,15 @@ extern "C" {
  */
 extern unsigned lp_native_vector_width;
 
+/**
+ * Widest SIMD width the code generator can use at runtime.
+ *
+ * With AVX-512 this is 512 while lp_native_vector_width stays at 256, as
+ * most code is tuned for the latter.  Code which processes enough elements
+ * at once to benefit from the wider vectors may opt in to this width.
+ */
+extern unsigned lp_wide_vector_width;
+
 /**
  * Maximum supported vector width (not necessarily supported at run-time).
  *
@@ -75,10 +75,10 @@
 #define TILE_BOTTOM_RIGHT 3
 
 union tgsi_double_channel {
-   double d[TGSI_QUAD_SIZE];
-   unsigned u[TGSI_QUAD_SIZE][2];
-   uint64_t u64[TGSI_QUAD_SIZE];
-   int64_t i64[TGSI_QUAD_SIZE];
+   double d[TGSI_EXEC_WIDTH];
+   unsigned u[TGSI_EXEC_WIDTH][2];
+   uint64_t u64[TGSI_EXEC_WIDTH];
+   int64_t i64[TGSI_EXEC_WIDTH];
 };
 
 struct tgsi_double_vector {
@@ -88,334 +88,326 @@ struct tgsi_double_vector {
 
 static void
 micro_abs(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned lanes)
 {
-   dst->f[0] = fabsf(src->f[0]);
-   dst->f[1] = fabsf(src->f[1]);
-   dst->f[2] = fabsf(src->f[2]);
-   dst->f[3] = fabsf(src->f[3]);
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = fabsf(src->f[i]);
 }
 
 static void
 micro_arl(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned lanes)
 {
-   dst->i[0] = (int)floorf(src->f[0]);
-   dst->i[1] = (int)floorf(src->f[1]);
-   dst->i[2] = (int)floorf(src->f[2]);
-   dst->i[3] = (int)floorf(src->f[3]);
+   for (unsigned i = 0; i < lanes; i++)
+      dst->i[i] = (int)floorf(src->f[i]);
 }
 
 static void
 micro_arr(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned lanes)
 {
-   dst->i[0] = (int)floorf(src->f[0] + 0.5f);
-   dst->i[1] = (int)floorf(src->f[1] + 0.5f);
-   dst->i[2] = (int)floorf(src->f[2] + 0.5f);
-   dst->i[3] = (int)floorf(src->f[3] + 0.5f);
+   for (unsigned i = 0; i < lanes; i++)
+      dst->i[i] = (int)floorf(src->f[i] + 0.5f);
 }
 
 static void
 micro_ceil(union tgsi_exec_channel *dst,
-           const union tgsi_exec_channel *src)
+           const union tgsi_exec_channel *src,
+           unsigned lanes)
 {
-   dst->f[0] = ceilf(src->f[0]);
-   dst->f[1] = ceilf(src->f[1]);
-   dst->f[2] = ceilf(src->f[2]);
-   dst->f[3] = ceilf(src->f[3]);
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = ceilf(src->f[i]);
 }
 
 static void
 micro_cmp(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1,
-          const union tgsi_exec_channel *src2)
+          const union tgsi_exec_channel *src2,
+          unsigned lanes)
 {
-   dst->f[0] = src0->f[0] < 0.0f ? src1->f[0] : src2->f[0];
-   dst->f[1] = src0->f[1] < 0.0f ? src1->f[1] : src2->f[1];
-   dst->f[2] = src0->f[2] < 0.0f ? src1->f[2] : src2->f[2];
-   dst->f[3] = src0->f[3] < 0.0f ? src1->f[3] : src2->f[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = src0->f[i] < 0.0f ? src1->f[i] : src2->f[i];
 }
 
 static void
 micro_cos(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned lanes)
 {
-   dst->f[0] = cosf(src->f[0]);
-   dst->f[1] = cosf(src->f[1]);
-   dst->f[2] = cosf(src->f[2]);
-   dst->f[3] = cosf(src->f[3]);
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = cosf(src->f[i]);
 }
 
 static void
 micro_d2f(union tgsi_exec_channel *dst,
-          const union tgsi_double_channel *src)
+          const union tgsi_double_channel *src,
+          unsigned lanes)
 {
-   dst->f[0] = (float)src->d[0];
-   dst->f[1] = (float)src->d[1];
-   dst->f[2] = (float)src->d[2];
-   dst->f[3] = (float)src->d[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = (float)src->d[i];
 }
 
 static void
 micro_d2i(union tgsi_exec_channel *dst,
-          const union tgsi_double_channel *src)
+          const union tgsi_double_channel *src,
+          unsigned lanes)
 {
-   dst->i[0] = (int)src->d[0];
-   dst->i[1] = (int)src->d[1];
-   dst->i[2] = (int)src->d[2];
-   dst->i[3] = (int)src->d[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->i[i] = (int)src->d[i];
 }
 
 static void
 micro_d2u(union tgsi_exec_channel *dst,
-          const union tgsi_double_channel *src)
+          const union tgsi_double_channel *src,
+          unsigned lanes)
 {
-   dst->u[0] = (unsigned)src->d[0];
-   dst->u[1] = (unsigned)src->d[1];
-   dst->u[2] = (unsigned)src->d[2];
-   dst->u[3] = (unsigned)src->d[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u[i] = (unsigned)src->d[i];
 }
 static void
 micro_dabs(union tgsi_double_channel *dst,
-           const union tgsi_double_channel *src)
+           const union tgsi_double_channel *src,
+           unsigned lanes)
 {
-   dst->d[0] = src->d[0] >= 0.0 ? src->d[0] : -src->d[0];
-   dst->d[1] = src->d[1] >= 0.0 ? src->d[1] : -src->d[1];
-   dst->d[2] = src->d[2] >= 0.0 ? src->d[2] : -src->d[2];
-   dst->d[3] = src->d[3] >= 0.0 ? src->d[3] : -src->d[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->d[i] = src->d[i] >= 0.0 ? src->d[i] : -src->d[i];
 }
 
 static void
 micro_dadd(union tgsi_double_channel *dst,
-          const union tgsi_double_channel *src)
+          const union tgsi_double_channel *src,
+          unsigned lanes)
 {
-   dst->d[0] = src[0].d[0] + src[1].d[0];
-   dst->d[1] = src[0].d[1] + src[1].d[1];
-   dst->d[2] = src[0].d[2] + src[1].d[2];
-   dst->d[3] = src[0].d[3] + src[1].d[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->d[i] = src[0].d[i] + src[1].d[i];
 }
 
 static void
 micro_ddiv(union tgsi_double_channel *dst,
-          const union tgsi_double_channel *src)
+          const union tgsi_double_channel *src,
+          unsigned lanes)
 {
-   dst->d[0] = src[0].d[0] / src[1].d[0];
-   dst->d[1] = src[0].d[1] / src[1].d[1];
-   dst->d[2] = src[0].d[2] / src[1].d[2];
-   dst->d[3] = src[0].d[3] / src[1].d[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->d[i] = src[0].d[i] / src[1].d[i];
 }
 
+/*
+ * Derivatives are computed within each quad; q is the first lane of the
+ * quad.
+ */
 static void
 micro_ddx(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned lanes)
 {
-   dst->f[0] =
-   dst->f[1] =
-   dst->f[2] =
-   dst->f[3] = src->f[TILE_BOTTOM_RIGHT] - src->f[TILE_BOTTOM_LEFT];
+   for (unsigned q = 0; q < lanes; q += TGSI_QUAD_SIZE) {
+      const float *s = &src->f[q];
+      dst->f[q + 0] =
+      dst->f[q + 1] =
+      dst->f[q + 2] =
+      dst->f[q + 3] = s[TILE_BOTTOM_RIGHT] - s[TILE_BOTTOM_LEFT];
+   }
 }
 
 static void
 micro_ddx_fine(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned lanes)
 {
-   dst->f[0] =
-   dst->f[1] = src->f[TILE_TOP_RIGHT] - src->f[TILE_TOP_LEFT];
-   dst->f[2] =
-   dst->f[3] = src->f[TILE_BOTTOM_RIGHT] - src->f[TILE_BOTTOM_LEFT];
+   for (unsigned q = 0; q < lanes; q += TGSI_QUAD_SIZE) {
+      const float *s = &src->f[q];
+      dst->f[q + 0] =
+      dst->f[q + 1] = s[TILE_TOP_RIGHT] - s[TILE_TOP_LEFT];
+      dst->f[q + 2] =
+      dst->f[q + 3] = s[TILE_BOTTOM_RIGHT] - s[TILE_BOTTOM_LEFT];
+   }
 }
 
 
 static void
 micro_ddy(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned lanes)
 {
-   dst->f[0] =
-   dst->f[1] =
-   dst->f[2] =
-   dst->f[3] = src->f[TILE_BOTTOM_LEFT] - src->f[TILE_TOP_LEFT];
+   for (unsigned q = 0; q < lanes; q += TGSI_QUAD_SIZE) {
+      const float *s = &src->f[q];
+      dst->f[q + 0] =
+      dst->f[q + 1] =
+      dst->f[q + 2] =
+      dst->f[q + 3] = s[TILE_BOTTOM_LEFT] - s[TILE_TOP_LEFT];
+   }
 }
 
 static void
 micro_ddy_fine(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned lanes)
 {
-   dst->f[0] =
-   dst->f[2] = src->f[TILE_BOTTOM_LEFT] - src->f[TILE_TOP_LEFT];
-   dst->f[1] =
-   dst->f[3] = src->f[TILE_BOTTOM_RIGHT] - src->f[TILE_TOP_RIGHT];
+   for (unsigned q = 0; q < lanes; q += TGSI_QUAD_SIZE) {
+      const float *s = &src->f[q];
+      dst->f[q + 0] =
+      dst->f[q + 2] = s[TILE_BOTTOM_LEFT] - s[TILE_TOP_LEFT];
+      dst->f[q + 1] =
+      dst->f[q + 3] = s[TILE_BOTTOM_RIGHT] - s[TILE_TOP_RIGHT];
+   }
 }
 
 static void
 micro_dmul(union tgsi_double_channel *dst,
-           const union tgsi_double_channel *src)
+           const union tgsi_double_channel *src,
+           unsigned lanes)
 {
-   dst->d[0] = src[0].d[0] * src[1].d[0];
-   dst->d[1] = src[0].d[1] * src[1].d[1];
-   dst->d[2] = src[0].d[2] * src[1].d[2];
-   dst->d[3] = src[0].d[3] * src[1].d[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->d[i] = src[0].d[i] * src[1].d[i];
 }
 
 static void
 micro_dmax(union tgsi_double_channel *dst,
-           const union tgsi_double_channel *src)
+           const union tgsi_double_channel *src,
+           unsigned lanes)
 {
-   dst->d[0] = src[0].d[0] > src[1].d[0] ? src[0].d[0] : src[1].d[0];
-   dst->d[1] = src[0].d[1] > src[1].d[1] ? src[0].d[1] : src[1].d[1];
-   dst->d[2] = src[0].d[2] > src[1].d[2] ? src[0].d[2] : src[1].d[2];
-   dst->d[3] = src[0].d[3] > src[1].d[3] ? src[0].d[3] : src[1].d[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->d[i] = src[0].d[i] > src[1].d[i] ? src[0].d[i] : src[1].d[i];
 }
 
 static void
 micro_dmin(union tgsi_double_channel *dst,
-           const union tgsi_double_channel *src)
+           const union tgsi_double_channel *src,
+           unsigned lanes)
 {
-   dst->d[0] = src[0].d[0] < src[1].d[0] ? src[0].d[0] : src[1].d[0];
-   dst->d[1] = src[0].d[1] < src[1].d[1] ? src[0].d[1] : src[1].d[1];
-   dst->d[2] = src[0].d[2] < src[1].d[2] ? src[0].d[2] : src[1].d[2];
-   dst->d[3] = src[0].d[3] < src[1].d[3] ? src[0].d[3] : src[1].d[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->d[i] = src[0].d[i] < src[1].d[i] ? src[0].d[i] : src[1].d[i];
 }
 
 static void
 micro_dneg(union tgsi_double_channel *dst,
-           const union tgsi_double_channel *src)
+           const union tgsi_double_channel *src,
+           unsigned lanes)
 {
-   dst->d[0] = -src->d[0];
-   dst->d[1] = -src->d[1];
-   dst->d[2] = -src->d[2];
-   dst->d[3] = -src->d[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->d[i] = -src->d[i];
 }
 
 static void
 micro_dslt(union tgsi_double_channel *dst,
-           const union tgsi_double_channel *src)
+           const union tgsi_double_channel *src,
+           unsigned lanes)
 {
-   dst->u[0][0] = src[0].d[0] < src[1].d[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].d[1] < src[1].d[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].d[2] < src[1].d[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].d[3] < src[1].d[3] ? ~0U : 0U;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u[i][0] = src[0].d[i] < src[1].d[i] ? ~0U : 0U;
 }
 
 static void
 micro_dsne(union tgsi_double_channel *dst,
-           const union tgsi_double_channel *src)
+           const union tgsi_double_channel *src,
+           unsigned lanes)
 {
-   dst->u[0][0] = src[0].d[0] != src[1].d[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].d[1] != src[1].d[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].d[2] != src[1].d[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].d[3] != src[1].d[3] ? ~0U : 0U;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u[i][0] = src[0].d[i] != src[1].d[i] ? ~0U : 0U;
 }
 
 static void
 micro_dsge(union tgsi_double_channel *dst,
-           const union tgsi_double_channel *src)
+           const union tgsi_double_channel *src,
+           unsigned lanes)
 {
-   dst->u[0][0] = src[0].d[0] >= src[1].d[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].d[1] >= src[1].d[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].d[2] >= src[1].d[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].d[3] >= src[1].d[3] ? ~0U : 0U;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u[i][0] = src[0].d[i] >= src[1].d[i] ? ~0U : 0U;
 }
 
 static void
 micro_dseq(union tgsi_double_channel *dst,
-           const union tgsi_double_channel *src)
+           const union tgsi_double_channel *src,
+           unsigned lanes)
 {
-   dst->u[0][0] = src[0].d[0] == src[1].d[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].d[1] == src[1].d[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].d[2] == src[1].d[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].d[3] == src[1].d[3] ? ~0U : 0U;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u[i][0] = src[0].d[i] == src[1].d[i] ? ~0U : 0U;
 }
 
 static void
 micro_drcp(union tgsi_double_channel *dst,
-           const union tgsi_double_channel *src)
+           const union tgsi_double_channel *src,
+           unsigned lanes)
 {
-   dst->d[0] = 1.0 / src->d[0];
-   dst->d[1] = 1.0 / src->d[1];
-   dst->d[2] = 1.0 / src->d[2];
-   dst->d[3] = 1.0 / src->d[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->d[i] = 1.0 / src->d[i];
 }
 
 static void
 micro_dsqrt(union tgsi_double_channel *dst,
-            const union tgsi_double_channel *src)
+            const union tgsi_double_channel *src,
+            unsigned lanes)
 {
-   dst->d[0] = sqrt(src->d[0]);
-   dst->d[1] = sqrt(src->d[1]);
-   dst->d[2] = sqrt(src->d[2]);
-   dst->d[3] = sqrt(src->d[3]);
+   for (unsigned i = 0; i < lanes; i++)
+      dst->d[i] = sqrt(src->d[i]);
 }
 
 static void
 micro_drsq(union tgsi_double_channel *dst,
-          const union tgsi_double_channel *src)
+          const union tgsi_double_channel *src,
+          unsigned lanes)
 {
-   dst->d[0] = 1.0 / sqrt(src->d[0]);
-   dst->d[1] = 1.0 / sqrt(src->d[1]);
-   dst->d[2] = 1.0 / sqrt(src->d[2]);
-   dst->d[3] = 1.0 / sqrt(src->d[3]);
+   for (unsigned i = 0; i < lanes; i++)
+      dst->d[i] = 1.0 / sqrt(src->d[i]);
 }
 
 static void
 micro_dmad(union tgsi_double_channel *dst,
-           const union tgsi_double_channel *src)
+           const union tgsi_double_channel *src,
+           unsigned lanes)
 {
-   dst->d[0] = src[0].d[0] * src[1].d[0] + src[2].d[0];
-   dst->d[1] = src[0].d[1] * src[1].d[1] + src[2].d[1];
-   dst->d[2] = src[0].d[2] * src[1].d[2] + src[2].d[2];
-   dst->d[3] = src[0].d[3] * src[1].d[3] + src[2].d[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->d[i] = src[0].d[i] * src[1].d[i] + src[2].d[i];
 }
 
 static void
 micro_dfrac(union tgsi_double_channel *dst,
-            const union tgsi_double_channel *src)
+            const union tgsi_double_channel *src,
+            unsigned lanes)
 {
-   dst->d[0] = src->d[0] - floor(src->d[0]);
-   dst->d[1] = src->d[1] - floor(src->d[1]);
-   dst->d[2] = src->d[2] - floor(src->d[2]);
-   dst->d[3] = src->d[3] - floor(src->d[3]);
+   for (unsigned i = 0; i < lanes; i++)
+      dst->d[i] = src->d[i] - floor(src->d[i]);
 }
 
 static void
 micro_dldexp(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src0,
-             union tgsi_exec_channel *src1)
+             union tgsi_exec_channel *src1,
+             unsigned lanes)
 {
-   dst->d[0] = ldexp(src0->d[0], src1->i[0]);
-   dst->d[1] = ldexp(src0->d[1], src1->i[1]);
-   dst->d[2] = ldexp(src0->d[2], src1->i[2]);
-   dst->d[3] = ldexp(src0->d[3], src1->i[3]);
+   for (unsigned i = 0; i < lanes; i++)
+      dst->d[i] = ldexp(src0->d[i], src1->i[i]);
 }
 
 static void
 micro_dfracexp(union tgsi_double_channel *dst,
                union tgsi_exec_channel *dst_exp,
-               const union tgsi_double_channel *src)
+               const union tgsi_double_channel *src,
+               unsigned lanes)
 {
-   dst->d[0] = frexp(src->d[0], &dst_exp->i[0]);
-   dst->d[1] = frexp(src->d[1], &dst_exp->i[1]);
-   dst->d[2] = frexp(src->d[2], &dst_exp->i[2]);
-   dst->d[3] = frexp(src->d[3], &dst_exp->i[3]);
+   for (unsigned i = 0; i < lanes; i++)
+      dst->d[i] = frexp(src->d[i], &dst_exp->i[i]);
 }
 
 static void
 micro_exp2(union tgsi_exec_channel *dst,
-           const union tgsi_exec_channel *src)
+           const union tgsi_exec_channel *src,
+           unsigned lanes)
 {
 #if FAST_MATH
-   dst->f[0] = util_fast_exp2(src->f[0]);
-   dst->f[1] = util_fast_exp2(src->f[1]);
-   dst->f[2] = util_fast_exp2(src->f[2]);
-   dst->f[3] = util_fast_exp2(src->f[3]);
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = util_fast_exp2(src->f[i]);
 #else
 #if DEBUG
    /* Inf is okay for this instruction, so clamp it to silence assertions. */
    uint i;
    union tgsi_exec_channel clamped;
 
-   for (i = 0; i < 4; i++) {
+   for (i = 0; i < lanes; i++) {
       if (src->f[i] > 127.99999f) {
          clamped.f[i] = 127.99999f;
       } else if (src->f[i] < -126.99999f) {
@@ -427,87 +419,76 @@ micro_exp2(union tgsi_exec_channel *dst,
    src = &clamped;
 #endif /* DEBUG */
 
-   dst->f[0] = powf(2.0f, src->f[0]);
-   dst->f[1] = powf(2.0f, src->f[1]);
-   dst->f[2] = powf(2.0f, src->f[2]);
-   dst->f[3] = powf(2.0f, src->f[3]);
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = powf(2.0f, src->f[i]);
 #endif /* FAST_MATH */
 }
 
 static void
 micro_f2d(union tgsi_double_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned lanes)
 {
-   dst->d[0] = (double)src->f[0];
-   dst->d[1] = (double)src->f[1];
-   dst->d[2] = (double)src->f[2];
-   dst->d[3] = (double)src->f[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->d[i] = (double)src->f[i];
 }
 
 static void
 micro_flr(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned lanes)
 {
-   dst->f[0] = floorf(src->f[0]);
-   dst->f[1] = floorf(src->f[1]);
-   dst->f[2] = floorf(src->f[2]);
-   dst->f[3] = floorf(src->f[3]);
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = floorf(src->f[i]);
 }
 
 static void
 micro_frc(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned lanes)
 {
-   dst->f[0] = src->f[0] - floorf(src->f[0]);
-   dst->f[1] = src->f[1] - floorf(src->f[1]);
-   dst->f[2] = src->f[2] - floorf(src->f[2]);
-   dst->f[3] = src->f[3] - floorf(src->f[3]);
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = src->f[i] - floorf(src->f[i]);
 }
 
 static void
 micro_i2d(union tgsi_double_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned lanes)
 {
-   dst->d[0] = (double)src->i[0];
-   dst->d[1] = (double)src->i[1];
-   dst->d[2] = (double)src->i[2];
-   dst->d[3] = (double)src->i[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->d[i] = (double)src->i[i];
 }
 
 static void
 micro_iabs(union tgsi_exec_channel *dst,
-           const union tgsi_exec_channel *src)
+           const union tgsi_exec_channel *src,
+           unsigned lanes)
 {
-   dst->i[0] = src->i[0] >= 0 ? src->i[0] : -src->i[0];
-   dst->i[1] = src->i[1] >= 0 ? src->i[1] : -src->i[1];
-   dst->i[2] = src->i[2] >= 0 ? src->i[2] : -src->i[2];
-   dst->i[3] = src->i[3] >= 0 ? src->i[3] : -src->i[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->i[i] = src->i[i] >= 0 ? src->i[i] : -src->i[i];
 }
 
 static void
 micro_ineg(union tgsi_exec_channel *dst,
-           const union tgsi_exec_channel *src)
+           const union tgsi_exec_channel *src,
+           unsigned lanes)
 {
-   dst->i[0] = -src->i[0];
-   dst->i[1] = -src->i[1];
-   dst->i[2] = -src->i[2];
-   dst->i[3] = -src->i[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->i[i] = -src->i[i];
 }
 
 static void
 micro_lg2(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned lanes)
 {
 #if FAST_MATH
-   dst->f[0] = util_fast_log2(src->f[0]);
-   dst->f[1] = util_fast_log2(src->f[1]);
-   dst->f[2] = util_fast_log2(src->f[2]);
-   dst->f[3] = util_fast_log2(src->f[3]);
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = util_fast_log2(src->f[i]);
 #else
-   dst->f[0] = logf(src->f[0]) * 1.442695f;
-   dst->f[1] = logf(src->f[1]) * 1.442695f;
-   dst->f[2] = logf(src->f[2]) * 1.442695f;
-   dst->f[3] = logf(src->f[3]) * 1.442695f;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = logf(src->f[i]) * 1.442695f;
 #endif
 }
 
@@ -515,440 +496,390 @@ static void
 micro_lrp(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1,
-          const union tgsi_exec_channel *src2)
+          const union tgsi_exec_channel *src2,
+          unsigned lanes)
 {
-   dst->f[0] = src0->f[0] * (src1->f[0] - src2->f[0]) + src2->f[0];
-   dst->f[1] = src0->f[1] * (src1->f[1] - src2->f[1]) + src2->f[1];
-   dst->f[2] = src0->f[2] * (src1->f[2] - src2->f[2]) + src2->f[2];
-   dst->f[3] = src0->f[3] * (src1->f[3] - src2->f[3]) + src2->f[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = src0->f[i] * (src1->f[i] - src2->f[i]) + src2->f[i];
 }
 
 static void
 micro_mad(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1,
-          const union tgsi_exec_channel *src2)
+          const union tgsi_exec_channel *src2,
+          unsigned lanes)
 {
-   dst->f[0] = src0->f[0] * src1->f[0] + src2->f[0];
-   dst->f[1] = src0->f[1] * src1->f[1] + src2->f[1];
-   dst->f[2] = src0->f[2] * src1->f[2] + src2->f[2];
-   dst->f[3] = src0->f[3] * src1->f[3] + src2->f[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = src0->f[i] * src1->f[i] + src2->f[i];
 }
 
 static void
 micro_mov(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned lanes)
 {
-   dst->u[0] = src->u[0];
-   dst->u[1] = src->u[1];
-   dst->u[2] = src->u[2];
-   dst->u[3] = src->u[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u[i] = src->u[i];
 }
 
 static void
 micro_rcp(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned lanes)
 {
 #if 0 /* for debugging */
-   assert(src->f[0] != 0.0f);
-   assert(src->f[1] != 0.0f);
-   assert(src->f[2] != 0.0f);
-   assert(src->f[3] != 0.0f);
+   for (unsigned i = 0; i < lanes; i++)
+      assert(src->f[i] != 0.0f);
 #endif
-   dst->f[0] = 1.0f / src->f[0];
-   dst->f[1] = 1.0f / src->f[1];
-   dst->f[2] = 1.0f / src->f[2];
-   dst->f[3] = 1.0f / src->f[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = 1.0f / src->f[i];
 }
 
 static void
 micro_rnd(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned lanes)
 {
-   dst->f[0] = _mesa_roundevenf(src->f[0]);
-   dst->f[1] = _mesa_roundevenf(src->f[1]);
-   dst->f[2] = _mesa_roundevenf(src->f[2]);
-   dst->f[3] = _mesa_roundevenf(src->f[3]);
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = _mesa_roundevenf(src->f[i]);
 }
 
 static void
 micro_rsq(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned lanes)
 {
 #if 0 /* for debugging */
-   assert(src->f[0] != 0.0f);
-   assert(src->f[1] != 0.0f);
-   assert(src->f[2] != 0.0f);
-   assert(src->f[3] != 0.0f);
+   for (unsigned i = 0; i < lanes; i++)
+      assert(src->f[i] != 0.0f);
 #endif
-   dst->f[0] = 1.0f / sqrtf(src->f[0]);
-   dst->f[1] = 1.0f / sqrtf(src->f[1]);
-   dst->f[2] = 1.0f / sqrtf(src->f[2]);
-   dst->f[3] = 1.0f / sqrtf(src->f[3]);
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = 1.0f / sqrtf(src->f[i]);
 }
 
 static void
 micro_sqrt(union tgsi_exec_channel *dst,
-           const union tgsi_exec_channel *src)
+           const union tgsi_exec_channel *src,
+           unsigned lanes)
 {
-   dst->f[0] = sqrtf(src->f[0]);
-   dst->f[1] = sqrtf(src->f[1]);
-   dst->f[2] = sqrtf(src->f[2]);
-   dst->f[3] = sqrtf(src->f[3]);
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = sqrtf(src->f[i]);
 }
 
 static void
 micro_seq(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned lanes)
 {
-   dst->f[0] = src0->f[0] == src1->f[0] ? 1.0f : 0.0f;
-   dst->f[1] = src0->f[1] == src1->f[1] ? 1.0f : 0.0f;
-   dst->f[2] = src0->f[2] == src1->f[2] ? 1.0f : 0.0f;
-   dst->f[3] = src0->f[3] == src1->f[3] ? 1.0f : 0.0f;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = src0->f[i] == src1->f[i] ? 1.0f : 0.0f;
 }
 
 static void
 micro_sge(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned lanes)
 {
-   dst->f[0] = src0->f[0] >= src1->f[0] ? 1.0f : 0.0f;
-   dst->f[1] = src0->f[1] >= src1->f[1] ? 1.0f : 0.0f;
-   dst->f[2] = src0->f[2] >= src1->f[2] ? 1.0f : 0.0f;
-   dst->f[3] = src0->f[3] >= src1->f[3] ? 1.0f : 0.0f;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = src0->f[i] >= src1->f[i] ? 1.0f : 0.0f;
 }
 
 static void
 micro_sgn(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned lanes)
 {
-   dst->f[0] = src->f[0] < 0.0f ? -1.0f : src->f[0] > 0.0f ? 1.0f : 0.0f;
-   dst->f[1] = src->f[1] < 0.0f ? -1.0f : src->f[1] > 0.0f ? 1.0f : 0.0f;
-   dst->f[2] = src->f[2] < 0.0f ? -1.0f : src->f[2] > 0.0f ? 1.0f : 0.0f;
-   dst->f[3] = src->f[3] < 0.0f ? -1.0f : src->f[3] > 0.0f ? 1.0f : 0.0f;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = src->f[i] < 0.0f ? -1.0f : src->f[i] > 0.0f ? 1.0f : 0.0f;
 }
 
 static void
 micro_isgn(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned lanes)
 {
-   dst->i[0] = src->i[0] < 0 ? -1 : src->i[0] > 0 ? 1 : 0;
-   dst->i[1] = src->i[1] < 0 ? -1 : src->i[1] > 0 ? 1 : 0;
-   dst->i[2] = src->i[2] < 0 ? -1 : src->i[2] > 0 ? 1 : 0;
-   dst->i[3] = src->i[3] < 0 ? -1 : src->i[3] > 0 ? 1 : 0;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->i[i] = src->i[i] < 0 ? -1 : src->i[i] > 0 ? 1 : 0;
 }
 
 static void
 micro_sgt(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned lanes)
 {
-   dst->f[0] = src0->f[0] > src1->f[0] ? 1.0f : 0.0f;
-   dst->f[1] = src0->f[1] > src1->f[1] ? 1.0f : 0.0f;
-   dst->f[2] = src0->f[2] > src1->f[2] ? 1.0f : 0.0f;
-   dst->f[3] = src0->f[3] > src1->f[3] ? 1.0f : 0.0f;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = src0->f[i] > src1->f[i] ? 1.0f : 0.0f;
 }
 
 static void
 micro_sin(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned lanes)
 {
-   dst->f[0] = sinf(src->f[0]);
-   dst->f[1] = sinf(src->f[1]);
-   dst->f[2] = sinf(src->f[2]);
-   dst->f[3] = sinf(src->f[3]);
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = sinf(src->f[i]);
 }
 
 static void
 micro_sle(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned lanes)
 {
-   dst->f[0] = src0->f[0] <= src1->f[0] ? 1.0f : 0.0f;
-   dst->f[1] = src0->f[1] <= src1->f[1] ? 1.0f : 0.0f;
-   dst->f[2] = src0->f[2] <= src1->f[2] ? 1.0f : 0.0f;
-   dst->f[3] = src0->f[3] <= src1->f[3] ? 1.0f : 0.0f;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = src0->f[i] <= src1->f[i] ? 1.0f : 0.0f;
 }
 
 static void
 micro_slt(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned lanes)
 {
-   dst->f[0] = src0->f[0] < src1->f[0] ? 1.0f : 0.0f;
-   dst->f[1] = src0->f[1] < src1->f[1] ? 1.0f : 0.0f;
-   dst->f[2] = src0->f[2] < src1->f[2] ? 1.0f : 0.0f;
-   dst->f[3] = src0->f[3] < src1->f[3] ? 1.0f : 0.0f;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = src0->f[i] < src1->f[i] ? 1.0f : 0.0f;
 }
 
 static void
 micro_sne(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned lanes)
 {
-   dst->f[0] = src0->f[0] != src1->f[0] ? 1.0f : 0.0f;
-   dst->f[1] = src0->f[1] != src1->f[1] ? 1.0f : 0.0f;
-   dst->f[2] = src0->f[2] != src1->f[2] ? 1.0f : 0.0f;
-   dst->f[3] = src0->f[3] != src1->f[3] ? 1.0f : 0.0f;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = src0->f[i] != src1->f[i] ? 1.0f : 0.0f;
 }
 
 static void
 micro_trunc(union tgsi_exec_channel *dst,
-            const union tgsi_exec_channel *src)
+            const union tgsi_exec_channel *src,
+            unsigned lanes)
 {
-   dst->f[0] = truncf(src->f[0]);
-   dst->f[1] = truncf(src->f[1]);
-   dst->f[2] = truncf(src->f[2]);
-   dst->f[3] = truncf(src->f[3]);
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = truncf(src->f[i]);
 }
 
 static void
 micro_u2d(union tgsi_double_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned lanes)
 {
-   dst->d[0] = (double)src->u[0];
-   dst->d[1] = (double)src->u[1];
-   dst->d[2] = (double)src->u[2];
-   dst->d[3] = (double)src->u[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->d[i] = (double)src->u[i];
 }
 
 static void
 micro_i64abs(union tgsi_double_channel *dst,
-             const union tgsi_double_channel *src)
+             const union tgsi_double_channel *src,
+             unsigned lanes)
 {
-   dst->i64[0] = src->i64[0] >= 0.0 ? src->i64[0] : -src->i64[0];
-   dst->i64[1] = src->i64[1] >= 0.0 ? src->i64[1] : -src->i64[1];
-   dst->i64[2] = src->i64[2] >= 0.0 ? src->i64[2] : -src->i64[2];
-   dst->i64[3] = src->i64[3] >= 0.0 ? src->i64[3] : -src->i64[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->i64[i] = src->i64[i] >= 0.0 ? src->i64[i] : -src->i64[i];
 }
 
 static void
 micro_i64sgn(union tgsi_double_channel *dst,
-             const union tgsi_double_channel *src)
+             const union tgsi_double_channel *src,
+             unsigned lanes)
 {
-   dst->i64[0] = src->i64[0] < 0 ? -1 : src->i64[0] > 0 ? 1 : 0;
-   dst->i64[1] = src->i64[1] < 0 ? -1 : src->i64[1] > 0 ? 1 : 0;
-   dst->i64[2] = src->i64[2] < 0 ? -1 : src->i64[2] > 0 ? 1 : 0;
-   dst->i64[3] = src->i64[3] < 0 ? -1 : src->i64[3] > 0 ? 1 : 0;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->i64[i] = src->i64[i] < 0 ? -1 : src->i64[i] > 0 ? 1 : 0;
 }
 
 static void
 micro_i64neg(union tgsi_double_channel *dst,
-             const union tgsi_double_channel *src)
+             const union tgsi_double_channel *src,
+             unsigned lanes)
 {
-   dst->i64[0] = -src->i64[0];
-   dst->i64[1] = -src->i64[1];
-   dst->i64[2] = -src->i64[2];
-   dst->i64[3] = -src->i64[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->i64[i] = -src->i64[i];
 }
 
 static void
 micro_u64seq(union tgsi_double_channel *dst,
-           const union tgsi_double_channel *src)
+           const union tgsi_double_channel *src,
+           unsigned lanes)
 {
-   dst->u[0][0] = src[0].u64[0] == src[1].u64[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].u64[1] == src[1].u64[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].u64[2] == src[1].u64[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].u64[3] == src[1].u64[3] ? ~0U : 0U;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u[i][0] = src[0].u64[i] == src[1].u64[i] ? ~0U : 0U;
 }
 
 static void
 micro_u64sne(union tgsi_double_channel *dst,
-             const union tgsi_double_channel *src)
+             const union tgsi_double_channel *src,
+             unsigned lanes)
 {
-   dst->u[0][0] = src[0].u64[0] != src[1].u64[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].u64[1] != src[1].u64[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].u64[2] != src[1].u64[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].u64[3] != src[1].u64[3] ? ~0U : 0U;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u[i][0] = src[0].u64[i] != src[1].u64[i] ? ~0U : 0U;
 }
 
 static void
 micro_i64slt(union tgsi_double_channel *dst,
-             const union tgsi_double_channel *src)
+             const union tgsi_double_channel *src,
+             unsigned lanes)
 {
-   dst->u[0][0] = src[0].i64[0] < src[1].i64[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].i64[1] < src[1].i64[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].i64[2] < src[1].i64[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].i64[3] < src[1].i64[3] ? ~0U : 0U;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u[i][0] = src[0].i64[i] < src[1].i64[i] ? ~0U : 0U;
 }
 
 static void
 micro_u64slt(union tgsi_double_channel *dst,
-             const union tgsi_double_channel *src)
+             const union tgsi_double_channel *src,
+             unsigned lanes)
 {
-   dst->u[0][0] = src[0].u64[0] < src[1].u64[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].u64[1] < src[1].u64[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].u64[2] < src[1].u64[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].u64[3] < src[1].u64[3] ? ~0U : 0U;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u[i][0] = src[0].u64[i] < src[1].u64[i] ? ~0U : 0U;
 }
 
 static void
 micro_i64sge(union tgsi_double_channel *dst,
-           const union tgsi_double_channel *src)
+           const union tgsi_double_channel *src,
+           unsigned lanes)
 {
-   dst->u[0][0] = src[0].i64[0] >= src[1].i64[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].i64[1] >= src[1].i64[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].i64[2] >= src[1].i64[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].i64[3] >= src[1].i64[3] ? ~0U : 0U;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u[i][0] = src[0].i64[i] >= src[1].i64[i] ? ~0U : 0U;
 }
 
 static void
 micro_u64sge(union tgsi_double_channel *dst,
-             const union tgsi_double_channel *src)
+             const union tgsi_double_channel *src,
+             unsigned lanes)
 {
-   dst->u[0][0] = src[0].u64[0] >= src[1].u64[0] ? ~0U : 0U;
-   dst->u[1][0] = src[0].u64[1] >= src[1].u64[1] ? ~0U : 0U;
-   dst->u[2][0] = src[0].u64[2] >= src[1].u64[2] ? ~0U : 0U;
-   dst->u[3][0] = src[0].u64[3] >= src[1].u64[3] ? ~0U : 0U;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u[i][0] = src[0].u64[i] >= src[1].u64[i] ? ~0U : 0U;
 }
 
 static void
 micro_u64max(union tgsi_double_channel *dst,
-             const union tgsi_double_channel *src)
+             const union tgsi_double_channel *src,
+             unsigned lanes)
 {
-   dst->u64[0] = src[0].u64[0] > src[1].u64[0] ? src[0].u64[0] : src[1].u64[0];
-   dst->u64[1] = src[0].u64[1] > src[1].u64[1] ? src[0].u64[1] : src[1].u64[1];
-   dst->u64[2] = src[0].u64[2] > src[1].u64[2] ? src[0].u64[2] : src[1].u64[2];
-   dst->u64[3] = src[0].u64[3] > src[1].u64[3] ? src[0].u64[3] : src[1].u64[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u64[i] = src[0].u64[i] > src[1].u64[i] ? src[0].u64[i] : src[1].u64[i];
 }
 
 static void
 micro_i64max(union tgsi_double_channel *dst,
-             const union tgsi_double_channel *src)
+             const union tgsi_double_channel *src,
+             unsigned lanes)
 {
-   dst->i64[0] = src[0].i64[0] > src[1].i64[0] ? src[0].i64[0] : src[1].i64[0];
-   dst->i64[1] = src[0].i64[1] > src[1].i64[1] ? src[0].i64[1] : src[1].i64[1];
-   dst->i64[2] = src[0].i64[2] > src[1].i64[2] ? src[0].i64[2] : src[1].i64[2];
-   dst->i64[3] = src[0].i64[3] > src[1].i64[3] ? src[0].i64[3] : src[1].i64[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->i64[i] = src[0].i64[i] > src[1].i64[i] ? src[0].i64[i] : src[1].i64[i];
 }
 
 static void
 micro_u64min(union tgsi_double_channel *dst,
-             const union tgsi_double_channel *src)
+             const union tgsi_double_channel *src,
+             unsigned lanes)
 {
-   dst->u64[0] = src[0].u64[0] < src[1].u64[0] ? src[0].u64[0] : src[1].u64[0];
-   dst->u64[1] = src[0].u64[1] < src[1].u64[1] ? src[0].u64[1] : src[1].u64[1];
-   dst->u64[2] = src[0].u64[2] < src[1].u64[2] ? src[0].u64[2] : src[1].u64[2];
-   dst->u64[3] = src[0].u64[3] < src[1].u64[3] ? src[0].u64[3] : src[1].u64[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u64[i] = src[0].u64[i] < src[1].u64[i] ? src[0].u64[i] : src[1].u64[i];
 }
 
 static void
 micro_i64min(union tgsi_double_channel *dst,
-             const union tgsi_double_channel *src)
+             const union tgsi_double_channel *src,
+             unsigned lanes)
 {
-   dst->i64[0] = src[0].i64[0] < src[1].i64[0] ? src[0].i64[0] : src[1].i64[0];
-   dst->i64[1] = src[0].i64[1] < src[1].i64[1] ? src[0].i64[1] : src[1].i64[1];
-   dst->i64[2] = src[0].i64[2] < src[1].i64[2] ? src[0].i64[2] : src[1].i64[2];
-   dst->i64[3] = src[0].i64[3] < src[1].i64[3] ? src[0].i64[3] : src[1].i64[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->i64[i] = src[0].i64[i] < src[1].i64[i] ? src[0].i64[i] : src[1].i64[i];
 }
 
 static void
 micro_u64add(union tgsi_double_channel *dst,
-             const union tgsi_double_channel *src)
+             const union tgsi_double_channel *src,
+             unsigned lanes)
 {
-   dst->u64[0] = src[0].u64[0] + src[1].u64[0];
-   dst->u64[1] = src[0].u64[1] + src[1].u64[1];
-   dst->u64[2] = src[0].u64[2] + src[1].u64[2];
-   dst->u64[3] = src[0].u64[3] + src[1].u64[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u64[i] = src[0].u64[i] + src[1].u64[i];
 }
 
 static void
 micro_u64mul(union tgsi_double_channel *dst,
-             const union tgsi_double_channel *src)
+             const union tgsi_double_channel *src,
+             unsigned lanes)
 {
-   dst->u64[0] = src[0].u64[0] * src[1].u64[0];
-   dst->u64[1] = src[0].u64[1] * src[1].u64[1];
-   dst->u64[2] = src[0].u64[2] * src[1].u64[2];
-   dst->u64[3] = src[0].u64[3] * src[1].u64[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u64[i] = src[0].u64[i] * src[1].u64[i];
 }
 
 static void
 micro_u64div(union tgsi_double_channel *dst,
-             const union tgsi_double_channel *src)
+             const union tgsi_double_channel *src,
+             unsigned lanes)
 {
-   dst->u64[0] = src[1].u64[0] ? src[0].u64[0] / src[1].u64[0] : ~0ull;
-   dst->u64[1] = src[1].u64[1] ? src[0].u64[1] / src[1].u64[1] : ~0ull;
-   dst->u64[2] = src[1].u64[2] ? src[0].u64[2] / src[1].u64[2] : ~0ull;
-   dst->u64[3] = src[1].u64[3] ? src[0].u64[3] / src[1].u64[3] : ~0ull;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u64[i] = src[1].u64[i] ? src[0].u64[i] / src[1].u64[i] : ~0ull;
 }
 
 static void
 micro_i64div(union tgsi_double_channel *dst,
-             const union tgsi_double_channel *src)
+             const union tgsi_double_channel *src,
+             unsigned lanes)
 {
-   dst->i64[0] = src[1].i64[0] ? src[0].i64[0] / src[1].i64[0] : 0;
-   dst->i64[1] = src[1].i64[1] ? src[0].i64[1] / src[1].i64[1] : 0;
-   dst->i64[2] = src[1].i64[2] ? src[0].i64[2] / src[1].i64[2] : 0;
-   dst->i64[3] = src[1].i64[3] ? src[0].i64[3] / src[1].i64[3] : 0;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->i64[i] = src[1].i64[i] ? src[0].i64[i] / src[1].i64[i] : 0;
 }
 
 static void
 micro_u64mod(union tgsi_double_channel *dst,
-             const union tgsi_double_channel *src)
+             const union tgsi_double_channel *src,
+             unsigned lanes)
 {
-   dst->u64[0] = src[1].u64[0] ? src[0].u64[0] % src[1].u64[0] : ~0ull;
-   dst->u64[1] = src[1].u64[1] ? src[0].u64[1] % src[1].u64[1] : ~0ull;
-   dst->u64[2] = src[1].u64[2] ? src[0].u64[2] % src[1].u64[2] : ~0ull;
-   dst->u64[3] = src[1].u64[3] ? src[0].u64[3] % src[1].u64[3] : ~0ull;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u64[i] = src[1].u64[i] ? src[0].u64[i] % src[1].u64[i] : ~0ull;
 }
 
 static void
 micro_i64mod(union tgsi_double_channel *dst,
-             const union tgsi_double_channel *src)
+             const union tgsi_double_channel *src,
+             unsigned lanes)
 {
-   dst->i64[0] = src[1].i64[0] ? src[0].i64[0] % src[1].i64[0] : ~0ll;
-   dst->i64[1] = src[1].i64[1] ? src[0].i64[1] % src[1].i64[1] : ~0ll;
-   dst->i64[2] = src[1].i64[2] ? src[0].i64[2] % src[1].i64[2] : ~0ll;
-   dst->i64[3] = src[1].i64[3] ? src[0].i64[3] % src[1].i64[3] : ~0ll;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->i64[i] = src[1].i64[i] ? src[0].i64[i] % src[1].i64[i] : ~0ll;
 }
 
 static void
 micro_u64shl(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src0,
-             union tgsi_exec_channel *src1)
+             union tgsi_exec_channel *src1,
+             unsigned lanes)
 {
    unsigned masked_count;
-   masked_count = src1->u[0] & 0x3f;
-   dst->u64[0] = src0->u64[0] << masked_count;
-   masked_count = src1->u[1] & 0x3f;
-   dst->u64[1] = src0->u64[1] << masked_count;
-   masked_count = src1->u[2] & 0x3f;
-   dst->u64[2] = src0->u64[2] << masked_count;
-   masked_count = src1->u[3] & 0x3f;
-   dst->u64[3] = src0->u64[3] << masked_count;
+   for (unsigned i = 0; i < lanes; i++) {
+      masked_count = src1->u[i] & 0x3f;
+      dst->u64[i] = src0->u64[i] << masked_count;
+   }
 }
 
 static void
 micro_i64shr(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src0,
-             union tgsi_exec_channel *src1)
+             union tgsi_exec_channel *src1,
+             unsigned lanes)
 {
    unsigned masked_count;
-   masked_count = src1->u[0] & 0x3f;
-   dst->i64[0] = src0->i64[0] >> masked_count;
-   masked_count = src1->u[1] & 0x3f;
-   dst->i64[1] = src0->i64[1] >> masked_count;
-   masked_count = src1->u[2] & 0x3f;
-   dst->i64[2] = src0->i64[2] >> masked_count;
-   masked_count = src1->u[3] & 0x3f;
-   dst->i64[3] = src0->i64[3] >> masked_count;
+   for (unsigned i = 0; i < lanes; i++) {
+      masked_count = src1->u[i] & 0x3f;
+      dst->i64[i] = src0->i64[i] >> masked_count;
+   }
 }
 
 static void
 micro_u64shr(union tgsi_double_channel *dst,
              const union tgsi_double_channel *src0,
-             union tgsi_exec_channel *src1)
+             union tgsi_exec_channel *src1,
+             unsigned lanes)
 {
    unsigned masked_count;
-   masked_count = src1->u[0] & 0x3f;
-   dst->u64[0] = src0->u64[0] >> masked_count;
-   masked_count = src1->u[1] & 0x3f;
-   dst->u64[1] = src0->u64[1] >> masked_count;
-   masked_count = src1->u[2] & 0x3f;
-   dst->u64[2] = src0->u64[2] >> masked_count;
-   masked_count = src1->u[3] & 0x3f;
-   dst->u64[3] = src0->u64[3] >> masked_count;
+   for (unsigned i = 0; i < lanes; i++) {
+      masked_count = src1->u[i] & 0x3f;
+      dst->u64[i] = src0->u64[i] >> masked_count;
+   }
 }
 
 enum tgsi_exec_datatype {
@@ -991,20 +922,27 @@ static const struct {
       MACH->ExecMask = MACH->CondMask & MACH->LoopMask & MACH->ContMask & MACH->Switch.mask & MACH->FuncMask
 
 
-static const union tgsi_exec_channel ZeroVec =
-   { { 0.0, 0.0, 0.0, 0.0 } };
+/** Initializer for a channel with every lane set to V */
+#define SPLAT_QUAD(V)   V, V, V, V
+#define SPLAT_1(V)      SPLAT_QUAD(V)
+#define SPLAT_2(V)      SPLAT_1(V), SPLAT_QUAD(V)
+#define SPLAT_3(V)      SPLAT_2(V), SPLAT_QUAD(V)
+#define SPLAT_4(V)      SPLAT_3(V), SPLAT_QUAD(V)
+#define SPLAT_5(V)      SPLAT_4(V), SPLAT_QUAD(V)
+#define SPLAT_6(V)      SPLAT_5(V), SPLAT_QUAD(V)
+#define SPLAT_7(V)      SPLAT_6(V), SPLAT_QUAD(V)
+#define SPLAT_8(V)      SPLAT_7(V), SPLAT_QUAD(V)
+#define SPLAT_N(N, V)   SPLAT_##N(V)
+#define SPLAT(N, V)     SPLAT_N(N, V)
+#define SPLAT_CHANNEL(V) { { SPLAT(TGSI_EXEC_NUM_QUADS, V) } }
 
-static const union tgsi_exec_channel OneVec = {
-   {1.0f, 1.0f, 1.0f, 1.0f}
-};
+static const union tgsi_exec_channel ZeroVec = SPLAT_CHANNEL(0.0f);
 
-static const union tgsi_exec_channel P128Vec = {
-   {128.0f, 128.0f, 128.0f, 128.0f}
-};
+static const union tgsi_exec_channel OneVec = SPLAT_CHANNEL(1.0f);
 
-static const union tgsi_exec_channel M128Vec = {
-   {-128.0f, -128.0f, -128.0f, -128.0f}
-};
+static const union tgsi_exec_channel P128Vec = SPLAT_CHANNEL(128.0f);
+
+static const union tgsi_exec_channel M128Vec = SPLAT_CHANNEL(-128.0f);
 
 
 /**
@@ -1014,12 +952,11 @@ static const union tgsi_exec_channel M128Vec = {
  * them.
  */
 static inline void
-check_inf_or_nan(const union tgsi_exec_channel *chan)
+check_inf_or_nan(const union tgsi_exec_channel *chan,
+                 unsigned lanes)
 {
-   assert(!util_is_inf_or_nan((chan)->f[0]));
-   assert(!util_is_inf_or_nan((chan)->f[1]));
-   assert(!util_is_inf_or_nan((chan)->f[2]));
-   assert(!util_is_inf_or_nan((chan)->f[3]));
+   for (unsigned i = 0; i < lanes; i++)
+      assert(!util_is_inf_or_nan((chan)->f[i]));
 }
 
 
@@ -1066,6 +1003,10 @@ tgsi_exec_set_constant_buffers(struct tgsi_exec_machine *mach,
    }
 }
 
+
+static void
+build_ops(struct tgsi_exec_machine *mach);
+
 /**
  * Initialize machine state by expanding tokens to full instructions,
  * allocating temporary storage, setting up constants, etc.
@@ -1108,6 +1049,9 @@ tgsi_exec_machine_bind_shader(
       mach->Instructions = NULL;
       mach->NumInstructions = 0;
 
+      FREE(mach->Ops);
+      mach->Ops = NULL;
+
       return;
    }
 
@@ -1264,6 +1208,8 @@ tgsi_exec_machine_bind_shader(
    FREE(mach->Instructions);
    mach->Instructions = instructions;
    mach->NumInstructions = numInstructions;
+
+   build_ops(mach);
 }
 
 
@@ -1279,6 +1225,14 @@ tgsi_exec_machine_create(enum pipe_shader_type shader_type)
    memset(mach, 0, sizeof(*mach));
 
    mach->ShaderType = shader_type;
+   /* Geometry shaders run up to MAX_TGSI_PRIMITIVES primitives, one per
+    * lane, and compute shaders one invocation in the first lane, so a single
+    * quad is enough there.
+    */
+   if (shader_type == PIPE_SHADER_GEOMETRY || shader_type == PIPE_SHADER_COMPUTE)
+      mach->NumLanes = TGSI_QUAD_SIZE;
+   else
+      mach->NumLanes = TGSI_EXEC_WIDTH;
    mach->Addrs = &mach->Temps[TGSI_EXEC_TEMP_ADDR];
    mach->MaxGeometryShaderOutputs = TGSI_MAX_TOTAL_VERTICES;
 
@@ -1319,6 +1273,7 @@ tgsi_exec_machine_destroy(struct tgsi_exec_machine *mach)
 {
    if (mach) {
       FREE(mach->Instructions);
+      FREE(mach->Ops);
       FREE(mach->Declarations);
       FREE(mach->Imms);
 
@@ -1333,31 +1288,24 @@ tgsi_exec_machine_destroy(struct tgsi_exec_machine *mach)
 static void
 micro_add(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned lanes)
 {
-   dst->f[0] = src0->f[0] + src1->f[0];
-   dst->f[1] = src0->f[1] + src1->f[1];
-   dst->f[2] = src0->f[2] + src1->f[2];
-   dst->f[3] = src0->f[3] + src1->f[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = src0->f[i] + src1->f[i];
 }
 
 static void
 micro_div(
    union tgsi_exec_channel *dst,
    const union tgsi_exec_channel *src0,
-   const union tgsi_exec_channel *src1 )
+   const union tgsi_exec_channel *src1,
+   unsigned lanes )
 {
-   if (src1->f[0] != 0) {
-      dst->f[0] = src0->f[0] / src1->f[0];
-   }
-   if (src1->f[1] != 0) {
-      dst->f[1] = src0->f[1] / src1->f[1];
-   }
-   if (src1->f[2] != 0) {
-      dst->f[2] = src0->f[2] / src1->f[2];
-   }
-   if (src1->f[3] != 0) {
-      dst->f[3] = src0->f[3] / src1->f[3];
+   for (unsigned i = 0; i < lanes; i++) {
+      if (src1->f[i] != 0) {
+         dst->f[i] = src0->f[i] / src1->f[i];
+      }
    }
 }
 
@@ -1367,97 +1315,87 @@ micro_lt(
    const union tgsi_exec_channel *src0,
    const union tgsi_exec_channel *src1,
    const union tgsi_exec_channel *src2,
-   const union tgsi_exec_channel *src3 )
+   const union tgsi_exec_channel *src3,
+   unsigned lanes )
 {
-   dst->f[0] = src0->f[0] < src1->f[0] ? src2->f[0] : src3->f[0];
-   dst->f[1] = src0->f[1] < src1->f[1] ? src2->f[1] : src3->f[1];
-   dst->f[2] = src0->f[2] < src1->f[2] ? src2->f[2] : src3->f[2];
-   dst->f[3] = src0->f[3] < src1->f[3] ? src2->f[3] : src3->f[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = src0->f[i] < src1->f[i] ? src2->f[i] : src3->f[i];
 }
 
 static void
 micro_max(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned lanes)
 {
-   dst->f[0] = src0->f[0] > src1->f[0] ? src0->f[0] : src1->f[0];
-   dst->f[1] = src0->f[1] > src1->f[1] ? src0->f[1] : src1->f[1];
-   dst->f[2] = src0->f[2] > src1->f[2] ? src0->f[2] : src1->f[2];
-   dst->f[3] = src0->f[3] > src1->f[3] ? src0->f[3] : src1->f[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = src0->f[i] > src1->f[i] ? src0->f[i] : src1->f[i];
 }
 
 static void
 micro_min(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned lanes)
 {
-   dst->f[0] = src0->f[0] < src1->f[0] ? src0->f[0] : src1->f[0];
-   dst->f[1] = src0->f[1] < src1->f[1] ? src0->f[1] : src1->f[1];
-   dst->f[2] = src0->f[2] < src1->f[2] ? src0->f[2] : src1->f[2];
-   dst->f[3] = src0->f[3] < src1->f[3] ? src0->f[3] : src1->f[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = src0->f[i] < src1->f[i] ? src0->f[i] : src1->f[i];
 }
 
 static void
 micro_mul(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned lanes)
 {
-   dst->f[0] = src0->f[0] * src1->f[0];
-   dst->f[1] = src0->f[1] * src1->f[1];
-   dst->f[2] = src0->f[2] * src1->f[2];
-   dst->f[3] = src0->f[3] * src1->f[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = src0->f[i] * src1->f[i];
 }
 
 static void
 micro_neg(
    union tgsi_exec_channel *dst,
-   const union tgsi_exec_channel *src )
+   const union tgsi_exec_channel *src,
+   unsigned lanes )
 {
-   dst->f[0] = -src->f[0];
-   dst->f[1] = -src->f[1];
-   dst->f[2] = -src->f[2];
-   dst->f[3] = -src->f[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = -src->f[i];
 }
 
 static void
 micro_pow(
    union tgsi_exec_channel *dst,
    const union tgsi_exec_channel *src0,
-   const union tgsi_exec_channel *src1 )
+   const union tgsi_exec_channel *src1,
+   unsigned lanes )
 {
 #if FAST_MATH
-   dst->f[0] = util_fast_pow( src0->f[0], src1->f[0] );
-   dst->f[1] = util_fast_pow( src0->f[1], src1->f[1] );
-   dst->f[2] = util_fast_pow( src0->f[2], src1->f[2] );
-   dst->f[3] = util_fast_pow( src0->f[3], src1->f[3] );
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = util_fast_pow( src0->f[i], src1->f[i] );
 #else
-   dst->f[0] = powf( src0->f[0], src1->f[0] );
-   dst->f[1] = powf( src0->f[1], src1->f[1] );
-   dst->f[2] = powf( src0->f[2], src1->f[2] );
-   dst->f[3] = powf( src0->f[3], src1->f[3] );
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = powf( src0->f[i], src1->f[i] );
 #endif
 }
 
 static void
 micro_ldexp(union tgsi_exec_channel *dst,
             const union tgsi_exec_channel *src0,
-            const union tgsi_exec_channel *src1)
+            const union tgsi_exec_channel *src1,
+            unsigned lanes)
 {
-   dst->f[0] = ldexpf(src0->f[0], src1->i[0]);
-   dst->f[1] = ldexpf(src0->f[1], src1->i[1]);
-   dst->f[2] = ldexpf(src0->f[2], src1->i[2]);
-   dst->f[3] = ldexpf(src0->f[3], src1->i[3]);
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = ldexpf(src0->f[i], src1->i[i]);
 }
 
 static void
 micro_sub(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned lanes)
 {
-   dst->f[0] = src0->f[0] - src1->f[0];
-   dst->f[1] = src0->f[1] - src1->f[1];
-   dst->f[2] = src0->f[2] - src1->f[2];
-   dst->f[3] = src0->f[3] - src1->f[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = src0->f[i] - src1->f[i];
 }
 
 static void
@@ -1474,7 +1412,7 @@ fetch_src_file_channel(const struct tgsi_exec_machine *mach,
 
    switch (file) {
    case TGSI_FILE_CONSTANT:
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < mach->NumLanes; i++) {
          assert(index2D->i[i] >= 0 && index2D->i[i] < PIPE_MAX_CONSTANT_BUFFERS);
          assert(mach->Consts[index2D->i[i]]);
 
@@ -1503,7 +1441,7 @@ fetch_src_file_channel(const struct tgsi_exec_machine *mach,
       break;
 
    case TGSI_FILE_INPUT:
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < mach->NumLanes; i++) {
          /*
          if (PIPE_SHADER_GEOMETRY == mach->ShaderType) {
             debug_printf("Fetching Input[%d] (2d=%d, 1d=%d)\n",
@@ -1518,13 +1456,13 @@ fetch_src_file_channel(const struct tgsi_exec_machine *mach,
       break;
 
    case TGSI_FILE_SYSTEM_VALUE:
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < mach->NumLanes; i++) {
          chan->u[i] = mach->SystemValue[index->i[i]].xyzw[swizzle].u[i];
       }
       break;
 
    case TGSI_FILE_TEMPORARY:
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < mach->NumLanes; i++) {
          assert(index->i[i] < TGSI_EXEC_NUM_TEMPS);
          assert(index2D->i[i] == 0);
 
@@ -1533,7 +1471,7 @@ fetch_src_file_channel(const struct tgsi_exec_machine *mach,
       break;
 
    case TGSI_FILE_IMMEDIATE:
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < mach->NumLanes; i++) {
          assert(index->i[i] >= 0 && index->i[i] < (int)mach->ImmLimit);
          assert(index2D->i[i] == 0);
 
@@ -1542,7 +1480,7 @@ fetch_src_file_channel(const struct tgsi_exec_machine *mach,
       break;
 
    case TGSI_FILE_ADDRESS:
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < mach->NumLanes; i++) {
          assert(index->i[i] >= 0);
          assert(index2D->i[i] == 0);
 
@@ -1552,7 +1490,7 @@ fetch_src_file_channel(const struct tgsi_exec_machine *mach,
 
    case TGSI_FILE_OUTPUT:
       /* vertex/fragment output vars can be read too */
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < mach->NumLanes; i++) {
          assert(index->i[i] >= 0);
          assert(index2D->i[i] == 0);
 
@@ -1562,7 +1500,7 @@ fetch_src_file_channel(const struct tgsi_exec_machine *mach,
 
    default:
       assert(0);
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < mach->NumLanes; i++) {
          chan->u[i] = 0;
       }
    }
@@ -1583,10 +1521,8 @@ get_index_registers(const struct tgsi_exec_machine *mach,
     *       file = Register.File
     *       [1] = Register.Index
     */
-   index->i[0] =
-   index->i[1] =
-   index->i[2] =
-   index->i[3] = reg->Register.Index;
+   for (unsigned i = 0; i < mach->NumLanes; i++)
+      index->i[i] = reg->Register.Index;
 
    /* There is an extra source register that indirectly subscripts
     * a register file. The direct index now becomes an offset
@@ -1605,10 +1541,8 @@ get_index_registers(const struct tgsi_exec_machine *mach,
       uint i;
 
       /* which address register (always zero now) */
-      index2.i[0] =
-      index2.i[1] =
-      index2.i[2] =
-      index2.i[3] = reg->Indirect.Index;
+      for (i = 0; i < mach->NumLanes; i++)
+         index2.i[i] = reg->Indirect.Index;
       /* get current value of address register[swizzle] */
       swizzle = reg->Indirect.Swizzle;
       fetch_src_file_channel(mach,
@@ -1619,15 +1553,13 @@ get_index_registers(const struct tgsi_exec_machine *mach,
                              &indir_index);
 
       /* add value of address register to the offset */
-      index->i[0] += indir_index.i[0];
-      index->i[1] += indir_index.i[1];
-      index->i[2] += indir_index.i[2];
-      index->i[3] += indir_index.i[3];
+      for (i = 0; i < mach->NumLanes; i++)
+         index->i[i] += indir_index.i[i];
 
       /* for disabled execution channels, zero-out the index to
        * avoid using a potential garbage value.
        */
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < mach->NumLanes; i++) {
          if ((execmask & (1 << i)) == 0)
             index->i[i] = 0;
       }
@@ -1642,10 +1574,8 @@ get_index_registers(const struct tgsi_exec_machine *mach,
     *       [3] = Dimension.Index
     */
    if (reg->Register.Dimension) {
-      index2D->i[0] =
-      index2D->i[1] =
-      index2D->i[2] =
-      index2D->i[3] = reg->Dimension.Index;
+      for (unsigned i = 0; i < mach->NumLanes; i++)
+         index2D->i[i] = reg->Dimension.Index;
 
       /* Again, the second subscript index can be addressed indirectly
        * identically to the first one.
@@ -1664,10 +1594,8 @@ get_index_registers(const struct tgsi_exec_machine *mach,
          const uint execmask = mach->ExecMask;
          uint i;
 
-         index2.i[0] =
-         index2.i[1] =
-         index2.i[2] =
-         index2.i[3] = reg->DimIndirect.Index;
+         for (i = 0; i < mach->NumLanes; i++)
+            index2.i[i] = reg->DimIndirect.Index;
 
          swizzle = reg->DimIndirect.Swizzle;
          fetch_src_file_channel(mach,
@@ -1677,15 +1605,13 @@ get_index_registers(const struct tgsi_exec_machine *mach,
                                 &ZeroVec,
                                 &indir_index);
 
-         index2D->i[0] += indir_index.i[0];
-         index2D->i[1] += indir_index.i[1];
-         index2D->i[2] += indir_index.i[2];
-         index2D->i[3] += indir_index.i[3];
+         for (i = 0; i < mach->NumLanes; i++)
+            index2D->i[i] += indir_index.i[i];
 
          /* for disabled execution channels, zero-out the index to
           * avoid using a potential garbage value.
           */
-         for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+         for (i = 0; i < mach->NumLanes; i++) {
             if ((execmask & (1 << i)) == 0) {
                index2D->i[i] = 0;
             }
@@ -1697,10 +1623,8 @@ get_index_registers(const struct tgsi_exec_machine *mach,
        * by a dimension register and continue the saga.
        */
    } else {
-      index2D->i[0] =
-      index2D->i[1] =
-      index2D->i[2] =
-      index2D->i[3] = 0;
+      for (unsigned i = 0; i < mach->NumLanes; i++)
+         index2D->i[i] = 0;
    }
 }
 
@@ -1738,17 +1662,17 @@ fetch_source(const struct tgsi_exec_machine *mach,
 
    if (reg->Register.Absolute) {
       if (src_datatype == TGSI_EXEC_DATA_FLOAT) {
-         micro_abs(chan, chan);
+         micro_abs(chan, chan, mach->NumLanes);
       } else {
-         micro_iabs(chan, chan);
+         micro_iabs(chan, chan, mach->NumLanes);
       }
    }
 
    if (reg->Register.Negate) {
       if (src_datatype == TGSI_EXEC_DATA_FLOAT) {
-         micro_neg(chan, chan);
+         micro_neg(chan, chan, mach->NumLanes);
       } else {
-         micro_ineg(chan, chan);
+         micro_ineg(chan, chan, mach->NumLanes);
       }
    }
 }
@@ -1768,7 +1692,7 @@ store_dest_dstret(struct tgsi_exec_machine *mach,
 
    /* for debugging */
    if (0 && dst_datatype == TGSI_EXEC_DATA_FLOAT) {
-      check_inf_or_nan(chan);
+      check_inf_or_nan(chan, mach->NumLanes);
    }
 
    /* There is an extra source register that indirectly subscripts
@@ -1787,10 +1711,8 @@ store_dest_dstret(struct tgsi_exec_machine *mach,
       uint swizzle;
 
       /* which address register (always zero for now) */
-      index.i[0] =
-      index.i[1] =
-      index.i[2] =
-      index.i[3] = reg->Indirect.Index;
+      for (unsigned i = 0; i < mach->NumLanes; i++)
+         index.i[i] = reg->Indirect.Index;
 
       /* get current value of address register[swizzle] */
       swizzle = reg->Indirect.Swizzle;
@@ -1816,10 +1738,8 @@ store_dest_dstret(struct tgsi_exec_machine *mach,
     *       [3] = Dimension.Index
     */
    if (reg->Register.Dimension) {
-      index2D.i[0] =
-      index2D.i[1] =
-      index2D.i[2] =
-      index2D.i[3] = reg->Dimension.Index;
+      for (unsigned i = 0; i < mach->NumLanes; i++)
+         index2D.i[i] = reg->Dimension.Index;
 
       /* Again, the second subscript index can be addressed indirectly
        * identically to the first one.
@@ -1839,10 +1759,8 @@ store_dest_dstret(struct tgsi_exec_machine *mach,
          unsigned swizzle;
          uint i;
 
-         index2.i[0] =
-         index2.i[1] =
-         index2.i[2] =
-         index2.i[3] = reg->DimIndirect.Index;
+         for (i = 0; i < mach->NumLanes; i++)
+            index2.i[i] = reg->DimIndirect.Index;
 
          swizzle = reg->DimIndirect.Swizzle;
          fetch_src_file_channel(mach,
@@ -1852,15 +1770,13 @@ store_dest_dstret(struct tgsi_exec_machine *mach,
                                 &ZeroVec,
                                 &indir_index);
 
-         index2D.i[0] += indir_index.i[0];
-         index2D.i[1] += indir_index.i[1];
-         index2D.i[2] += indir_index.i[2];
-         index2D.i[3] += indir_index.i[3];
+         for (i = 0; i < mach->NumLanes; i++)
+            index2D.i[i] += indir_index.i[i];
 
          /* for disabled execution channels, zero-out the index to
           * avoid using a potential garbage value.
           */
-         for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+         for (i = 0; i < mach->NumLanes; i++) {
             if ((execmask & (1 << i)) == 0) {
                index2D.i[i] = 0;
             }
@@ -1872,10 +1788,8 @@ store_dest_dstret(struct tgsi_exec_machine *mach,
        * by a dimension register and continue the saga.
        */
    } else {
-      index2D.i[0] =
-      index2D.i[1] =
-      index2D.i[2] =
-      index2D.i[3] = 0;
+      for (unsigned i = 0; i < mach->NumLanes; i++)
+         index2D.i[i] = 0;
    }
 
    switch (reg->Register.File) {
@@ -1893,7 +1807,7 @@ store_dest_dstret(struct tgsi_exec_machine *mach,
                    reg->Register.Index);
       if (PIPE_SHADER_GEOMETRY == mach->ShaderType) {
          debug_printf("STORING OUT[%d] mask(%d), = (", offset + index, execmask);
-         for (i = 0; i < TGSI_QUAD_SIZE; i++)
+         for (i = 0; i < mach->NumLanes; i++)
             if (execmask & (1 << i))
                debug_printf("%f, ", chan->f[i]);
          debug_printf(")\n");
@@ -1936,7 +1850,7 @@ store_dest_double(struct tgsi_exec_machine *mach,
       return;
 
    /* doubles path */
-   for (i = 0; i < TGSI_QUAD_SIZE; i++)
+   for (i = 0; i < mach->NumLanes; i++)
       if (execmask & (1 << i))
          dst->i[i] = chan->i[i];
 }
@@ -1958,12 +1872,12 @@ store_dest(struct tgsi_exec_machine *mach,
       return;
 
    if (!inst->Instruction.Saturate) {
-      for (i = 0; i < TGSI_QUAD_SIZE; i++)
+      for (i = 0; i < mach->NumLanes; i++)
          if (execmask & (1 << i))
             dst->i[i] = chan->i[i];
    }
    else {
-      for (i = 0; i < TGSI_QUAD_SIZE; i++)
+      for (i = 0; i < mach->NumLanes; i++)
          if (execmask & (1 << i)) {
             if (chan->f[i] < 0.0f)
                dst->f[i] = 0.0f;
@@ -2014,7 +1928,7 @@ exec_kill_if(struct tgsi_exec_machine *mach,
       uniquemask |= 1 << swizzle;
 
       FETCH(&r[0], 0, chan_index);
-      for (i = 0; i < 4; i++)
+      for (i = 0; i < mach->NumLanes; i++)
          if (r[0].f[i] < 0.0f)
             kilmask |= 1 << i;
    }
@@ -2102,10 +2016,11 @@ conditional_emit_primitive(struct tgsi_exec_machine *mach)
 
 
 /*
- * Fetch four texture samples using STR texture coordinates.
+ * Fetch texture samples using STR texture coordinates.
+ * The sampler works on one quad at a time.
  */
 static void
-fetch_texel( struct tgsi_sampler *sampler,
+fetch_texel( const struct tgsi_exec_machine *mach,
              const unsigned sview_idx,
              const unsigned sampler_idx,
              const union tgsi_exec_channel *s,
@@ -2113,7 +2028,7 @@ fetch_texel( struct tgsi_sampler *sampler,
              const union tgsi_exec_channel *p,
              const union tgsi_exec_channel *c0,
              const union tgsi_exec_channel *c1,
-             float derivs[3][2][TGSI_QUAD_SIZE],
+             float derivs[3][2][TGSI_EXEC_WIDTH],
              const int8_t offset[3],
              enum tgsi_sampler_control control,
              union tgsi_exec_channel *r,
@@ -2121,18 +2036,30 @@ fetch_texel( struct tgsi_sampler *sampler,
              union tgsi_exec_channel *b,
              union tgsi_exec_channel *a )
 {
-   uint j;
+   struct tgsi_sampler *sampler = mach->Sampler;
+   uint q, j, k;
    float rgba[TGSI_NUM_CHANNELS][TGSI_QUAD_SIZE];
+   float quad_derivs[3][2][TGSI_QUAD_SIZE];
+
+   for (q = 0; q < mach->NumLanes; q += TGSI_QUAD_SIZE) {
+      if (derivs) {
+         for (j = 0; j < 3; j++)
+            for (k = 0; k < 2; k++)
+               memcpy(quad_derivs[j][k], &derivs[j][k][q],
+                      sizeof(quad_derivs[j][k]));
+      }
 
-   /* FIXME: handle explicit derivs, offsets */
-   sampler->get_samples(sampler, sview_idx, sampler_idx,
-                        s->f, t->f, p->f, c0->f, c1->f, derivs, offset, control, rgba);
+      /* FIXME: handle explicit derivs, offsets */
+      sampler->get_samples(sampler, sview_idx, sampler_idx,
+                           &s->f[q], &t->f[q], &p->f[q], &c0->f[q], &c1->f[q],
+                           derivs ? quad_derivs : NULL, offset, control, rgba);
 
-   for (j = 0; j < 4; j++) {
-      r->f[j] = rgba[0][j];
-      g->f[j] = rgba[1][j];
-      b->f[j] = rgba[2][j];
-      a->f[j] = rgba[3][j];
+      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         r->f[q + j] = rgba[0][j];
+         g->f[q + j] = rgba[1][j];
+         b->f[q + j] = rgba[2][j];
+         a->f[q + j] = rgba[3][j];
+      }
    }
 }
 
@@ -2155,7 +2082,8 @@ fetch_texel_offsets(struct tgsi_exec_machine *mach,
    if (inst->Texture.NumOffsets == 1) {
       union tgsi_exec_channel index;
       union tgsi_exec_channel offset[3];
-      index.i[0] = index.i[1] = index.i[2] = index.i[3] = inst->TexOffsets[0].Index;
+      for (unsigned i = 0; i < mach->NumLanes; i++)
+         index.i[i] = inst->TexOffsets[0].Index;
       fetch_src_file_channel(mach, inst->TexOffsets[0].File,
                              inst->TexOffsets[0].SwizzleX, &index, &ZeroVec, &offset[0]);
       fetch_src_file_channel(mach, inst->TexOffsets[0].File,
@@ -2181,19 +2109,13 @@ fetch_assign_deriv_channel(struct tgsi_exec_machine *mach,
                            const struct tgsi_full_instruction *inst,
                            unsigned regdsrcx,
                            unsigned chan,
-                           float derivs[2][TGSI_QUAD_SIZE])
+                           float derivs[2][TGSI_EXEC_WIDTH])
 {
    union tgsi_exec_channel d;
    FETCH(&d, regdsrcx, chan);
-   derivs[0][0] = d.f[0];
-   derivs[0][1] = d.f[1];
-   derivs[0][2] = d.f[2];
-   derivs[0][3] = d.f[3];
+   memcpy(derivs[0], d.f, sizeof(derivs[0]));
    FETCH(&d, regdsrcx + 1, chan);
-   derivs[1][0] = d.f[0];
-   derivs[1][1] = d.f[1];
-   derivs[1][2] = d.f[2];
-   derivs[1][3] = d.f[3];
+   memcpy(derivs[1], d.f, sizeof(derivs[1]));
 }
 
 static uint
@@ -2207,10 +2129,8 @@ fetch_sampler_unit(struct tgsi_exec_machine *mach,
       const struct tgsi_full_src_register *reg = &inst->Src[sampler];
       union tgsi_exec_channel indir_index, index2;
       const uint execmask = mach->ExecMask;
-      index2.i[0] =
-      index2.i[1] =
-      index2.i[2] =
-      index2.i[3] = reg->Indirect.Index;
+      for (i = 0; i < mach->NumLanes; i++)
+         index2.i[i] = reg->Indirect.Index;
 
       fetch_src_file_channel(mach,
                              reg->Indirect.File,
@@ -2218,7 +2138,7 @@ fetch_sampler_unit(struct tgsi_exec_machine *mach,
                              &index2,
                              &ZeroVec,
                              &indir_index);
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < mach->NumLanes; i++) {
          if (execmask & (1 << i)) {
             unit = inst->Src[sampler].Register.Index + indir_index.i[i];
             break;
@@ -2307,7 +2227,7 @@ exec_tex(struct tgsi_exec_machine *mach,
       FETCH(&r[i], 0, TGSI_CHAN_X + i);
 
       if (proj)
-         micro_div(&r[i], &r[i], proj);
+         micro_div(&r[i], &r[i], proj, mach->NumLanes);
 
       args[i] = &r[i];
    }
@@ -2317,12 +2237,12 @@ exec_tex(struct tgsi_exec_machine *mach,
       FETCH(&r[shadow_ref], shadow_ref / 4, TGSI_CHAN_X + (shadow_ref % 4));
 
       if (proj)
-         micro_div(&r[shadow_ref], &r[shadow_ref], proj);
+         micro_div(&r[shadow_ref], &r[shadow_ref], proj, mach->NumLanes);
 
       args[shadow_ref] = &r[shadow_ref];
    }
 
-   fetch_texel(mach->Sampler, unit, unit,
+   fetch_texel(mach, unit, unit,
          args[0], args[1], args[2], args[3], args[4],
          NULL, offsets, control,
          &r[0], &r[1], &r[2], &r[3]);     /* R, G, B, A */
@@ -2374,14 +2294,16 @@ exec_lodq(struct tgsi_exec_machine *mach,
    for (i = dim; i < ARRAY_SIZE(coords); i++) {
       args[i] = &ZeroVec;
    }
-   mach->Sampler->query_lod(mach->Sampler, resource_unit, sampler_unit,
-                            args[0]->f,
-                            args[1]->f,
-                            args[2]->f,
-                            args[3]->f,
-                            TGSI_SAMPLER_LOD_NONE,
-                            r[0].f,
-                            r[1].f);
+   for (i = 0; i < mach->NumLanes; i += TGSI_QUAD_SIZE) {
+      mach->Sampler->query_lod(mach->Sampler, resource_unit, sampler_unit,
+                               &args[0]->f[i],
+                               &args[1]->f[i],
+                               &args[2]->f[i],
+                               &args[3]->f[i],
+                               TGSI_SAMPLER_LOD_NONE,
+                               &r[0].f[i],
+                               &r[1].f[i]);
+   }
 
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_X) {
       store_dest(mach, &r[0], &inst->Dst[0], inst, TGSI_CHAN_X,
@@ -2427,7 +2349,7 @@ exec_txd(struct tgsi_exec_machine *mach,
          const struct tgsi_full_instruction *inst)
 {
    union tgsi_exec_channel r[4];
-   float derivs[3][2][TGSI_QUAD_SIZE];
+   float derivs[3][2][TGSI_EXEC_WIDTH];
    uint chan;
    uint unit;
    int8_t offsets[3];
@@ -2442,7 +2364,7 @@ exec_txd(struct tgsi_exec_machine *mach,
 
       fetch_assign_deriv_channel(mach, inst, 1, TGSI_CHAN_X, derivs[0]);
 
-      fetch_texel(mach->Sampler, unit, unit,
+      fetch_texel(mach, unit, unit,
                   &r[0], &ZeroVec, &ZeroVec, &ZeroVec, &ZeroVec,   /* S, T, P, C, LOD */
                   derivs, offsets, TGSI_SAMPLER_DERIVS_EXPLICIT,
                   &r[0], &r[1], &r[2], &r[3]);           /* R, G, B, A */
@@ -2458,7 +2380,7 @@ exec_txd(struct tgsi_exec_machine *mach,
 
       fetch_assign_deriv_channel(mach, inst, 1, TGSI_CHAN_X, derivs[0]);
 
-      fetch_texel(mach->Sampler, unit, unit,
+      fetch_texel(mach, unit, unit,
                   &r[0], &r[1], &r[2], &ZeroVec, &ZeroVec,   /* S, T, P, C, LOD */
                   derivs, offsets, TGSI_SAMPLER_DERIVS_EXPLICIT,
                   &r[0], &r[1], &r[2], &r[3]);           /* R, G, B, A */
@@ -2472,7 +2394,7 @@ exec_txd(struct tgsi_exec_machine *mach,
       fetch_assign_deriv_channel(mach, inst, 1, TGSI_CHAN_X, derivs[0]);
       fetch_assign_deriv_channel(mach, inst, 1, TGSI_CHAN_Y, derivs[1]);
 
-      fetch_texel(mach->Sampler, unit, unit,
+      fetch_texel(mach, unit, unit,
                   &r[0], &r[1], &ZeroVec, &ZeroVec, &ZeroVec,   /* S, T, P, C, LOD */
                   derivs, offsets, TGSI_SAMPLER_DERIVS_EXPLICIT,
                   &r[0], &r[1], &r[2], &r[3]);           /* R, G, B, A */
@@ -2492,7 +2414,7 @@ exec_txd(struct tgsi_exec_machine *mach,
       fetch_assign_deriv_channel(mach, inst, 1, TGSI_CHAN_X, derivs[0]);
       fetch_assign_deriv_channel(mach, inst, 1, TGSI_CHAN_Y, derivs[1]);
 
-      fetch_texel(mach->Sampler, unit, unit,
+      fetch_texel(mach, unit, unit,
                   &r[0], &r[1], &r[2], &r[3], &ZeroVec,   /* inputs */
                   derivs, offsets, TGSI_SAMPLER_DERIVS_EXPLICIT,
                   &r[0], &r[1], &r[2], &r[3]);     /* outputs */
@@ -2512,7 +2434,7 @@ exec_txd(struct tgsi_exec_machine *mach,
       fetch_assign_deriv_channel(mach, inst, 1, TGSI_CHAN_Y, derivs[1]);
       fetch_assign_deriv_channel(mach, inst, 1, TGSI_CHAN_Z, derivs[2]);
 
-      fetch_texel(mach->Sampler, unit, unit,
+      fetch_texel(mach, unit, unit,
                   &r[0], &r[1], &r[2], &r[3], &ZeroVec,   /* inputs */
                   derivs, offsets, TGSI_SAMPLER_DERIVS_EXPLICIT,
                   &r[0], &r[1], &r[2], &r[3]);     /* outputs */
@@ -2538,7 +2460,7 @@ exec_txf(struct tgsi_exec_machine *mach,
    uint chan;
    uint unit;
    float rgba[TGSI_NUM_CHANNELS][TGSI_QUAD_SIZE];
-   int j;
+   int q, j;
    int8_t offsets[3];
    unsigned target;
 
@@ -2581,14 +2503,17 @@ exec_txf(struct tgsi_exec_machine *mach,
       break;
    }      
 
-   mach->Sampler->get_texel(mach->Sampler, unit, r[0].i, r[1].i, r[2].i, r[3].i,
-                            offsets, rgba);
+   for (q = 0; q < mach->NumLanes; q += TGSI_QUAD_SIZE) {
+      mach->Sampler->get_texel(mach->Sampler, unit,
+                               &r[0].i[q], &r[1].i[q], &r[2].i[q], &r[3].i[q],
+                               offsets, rgba);
 
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-      r[0].f[j] = rgba[0][j];
-      r[1].f[j] = rgba[1][j];
-      r[2].f[j] = rgba[2][j];
-      r[3].f[j] = rgba[3][j];
+      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         r[0].f[q + j] = rgba[0][j];
+         r[1].f[q + j] = rgba[1][j];
+         r[2].f[q + j] = rgba[2][j];
+         r[3].f[q + j] = rgba[3][j];
+      }
    }
 
    if (inst->Instruction.Opcode == TGSI_OPCODE_SAMPLE_I ||
@@ -2632,7 +2557,7 @@ exec_txq(struct tgsi_exec_machine *mach,
    /* XXX: This interface can't return per-pixel values */
    mach->Sampler->get_dims(mach->Sampler, unit, src.i[0], result);
 
-   for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+   for (i = 0; i < mach->NumLanes; i++) {
       for (j = 0; j < 4; j++) {
          r[j].i[i] = result[j];
       }
@@ -2691,13 +2616,13 @@ exec_sample(struct tgsi_exec_machine *mach,
    case TGSI_TEXTURE_1D:
       if (compare) {
          FETCH(&r[2], 3, TGSI_CHAN_X);
-         fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+         fetch_texel(mach, resource_unit, sampler_unit,
                      &r[0], &ZeroVec, &r[2], &ZeroVec, lod, /* S, T, P, C, LOD */
                      NULL, offsets, control,
                      &r[0], &r[1], &r[2], &r[3]);     /* R, G, B, A */
       }
       else {
-         fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+         fetch_texel(mach, resource_unit, sampler_unit,
                      &r[0], &ZeroVec, &ZeroVec, &ZeroVec, lod, /* S, T, P, C, LOD */
                      NULL, offsets, control,
                      &r[0], &r[1], &r[2], &r[3]);     /* R, G, B, A */
@@ -2710,13 +2635,13 @@ exec_sample(struct tgsi_exec_machine *mach,
       FETCH(&r[1], 0, TGSI_CHAN_Y);
       if (compare) {
          FETCH(&r[2], 3, TGSI_CHAN_X);
-         fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+         fetch_texel(mach, resource_unit, sampler_unit,
                      &r[0], &r[1], &r[2], &ZeroVec, lod,    /* S, T, P, C, LOD */
                      NULL, offsets, control,
                      &r[0], &r[1], &r[2], &r[3]);  /* outputs */
       }
       else {
-         fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+         fetch_texel(mach, resource_unit, sampler_unit,
                      &r[0], &r[1], &ZeroVec, &ZeroVec, lod,    /* S, T, P, C, LOD */
                      NULL, offsets, control,
                      &r[0], &r[1], &r[2], &r[3]);  /* outputs */
@@ -2730,13 +2655,13 @@ exec_sample(struct tgsi_exec_machine *mach,
       FETCH(&r[2], 0, TGSI_CHAN_Z);
       if(compare) {
          FETCH(&r[3], 3, TGSI_CHAN_X);
-         fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+         fetch_texel(mach, resource_unit, sampler_unit,
                      &r[0], &r[1], &r[2], &r[3], lod,
                      NULL, offsets, control,
                      &r[0], &r[1], &r[2], &r[3]);
       }
       else {
-         fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+         fetch_texel(mach, resource_unit, sampler_unit,
                      &r[0], &r[1], &r[2], &ZeroVec, lod,
                      NULL, offsets, control,
                      &r[0], &r[1], &r[2], &r[3]);
@@ -2749,13 +2674,13 @@ exec_sample(struct tgsi_exec_machine *mach,
       FETCH(&r[3], 0, TGSI_CHAN_W);
       if(compare) {
          FETCH(&r[4], 3, TGSI_CHAN_X);
-         fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+         fetch_texel(mach, resource_unit, sampler_unit,
                      &r[0], &r[1], &r[2], &r[3], &r[4],
                      NULL, offsets, control,
                      &r[0], &r[1], &r[2], &r[3]);
       }
       else {
-         fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+         fetch_texel(mach, resource_unit, sampler_unit,
                      &r[0], &r[1], &r[2], &r[3], lod,
                      NULL, offsets, control,
                      &r[0], &r[1], &r[2], &r[3]);
@@ -2787,7 +2712,7 @@ exec_sample_d(struct tgsi_exec_machine *mach,
    const uint resource_unit = inst->Src[1].Register.Index;
    const uint sampler_unit = inst->Src[2].Register.Index;
    union tgsi_exec_channel r[4];
-   float derivs[3][2][TGSI_QUAD_SIZE];
+   float derivs[3][2][TGSI_EXEC_WIDTH];
    uint chan;
    unsigned char swizzles[4];
    int8_t offsets[3];
@@ -2805,7 +2730,7 @@ exec_sample_d(struct tgsi_exec_machine *mach,
 
       fetch_assign_deriv_channel(mach, inst, 3, TGSI_CHAN_X, derivs[0]);
 
-      fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+      fetch_texel(mach, resource_unit, sampler_unit,
                   &r[0], &r[1], &ZeroVec, &ZeroVec, &ZeroVec,   /* S, T, P, C, LOD */
                   derivs, offsets, TGSI_SAMPLER_DERIVS_EXPLICIT,
                   &r[0], &r[1], &r[2], &r[3]);           /* R, G, B, A */
@@ -2821,7 +2746,7 @@ exec_sample_d(struct tgsi_exec_machine *mach,
       fetch_assign_deriv_channel(mach, inst, 3, TGSI_CHAN_X, derivs[0]);
       fetch_assign_deriv_channel(mach, inst, 3, TGSI_CHAN_Y, derivs[1]);
 
-      fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+      fetch_texel(mach, resource_unit, sampler_unit,
                   &r[0], &r[1], &r[2], &ZeroVec, &ZeroVec,   /* inputs */
                   derivs, offsets, TGSI_SAMPLER_DERIVS_EXPLICIT,
                   &r[0], &r[1], &r[2], &r[3]);     /* outputs */
@@ -2839,7 +2764,7 @@ exec_sample_d(struct tgsi_exec_machine *mach,
       fetch_assign_deriv_channel(mach, inst, 3, TGSI_CHAN_Y, derivs[1]);
       fetch_assign_deriv_channel(mach, inst, 3, TGSI_CHAN_Z, derivs[2]);
 
-      fetch_texel(mach->Sampler, resource_unit, sampler_unit,
+      fetch_texel(mach, resource_unit, sampler_unit,
                   &r[0], &r[1], &r[2], &r[3], &ZeroVec,
                   derivs, offsets, TGSI_SAMPLER_DERIVS_EXPLICIT,
                   &r[0], &r[1], &r[2], &r[3]);
@@ -2865,7 +2790,7 @@ exec_sample_d(struct tgsi_exec_machine *mach,
 
 /**
  * Evaluate a constant-valued coefficient at the position of the
- * current quad.
+ * current quads.
  */
 static void
 eval_constant_coef(
@@ -2875,7 +2800,7 @@ eval_constant_coef(
 {
    unsigned i;
 
-   for( i = 0; i < TGSI_QUAD_SIZE; i++ ) {
+   for( i = 0; i < mach->NumLanes; i++ ) {
       mach->Inputs[attrib].xyzw[chan].f[i] = mach->InterpCoefs[attrib].a0[chan];
    }
 }
@@ -2893,7 +2818,7 @@ interp_constant_offset(
 
 /**
  * Evaluate a linear-valued coefficient at the position of the
- * current quad.
+ * current quads.
  */
 static void
 interp_linear_offset(
@@ -2907,10 +2832,8 @@ interp_linear_offset(
    const float dadx = mach->InterpCoefs[attrib].dadx[chan];
    const float dady = mach->InterpCoefs[attrib].dady[chan];
    const float delta = ofs_x * dadx + ofs_y * dady;
-   out_chan->f[0] += delta;
-   out_chan->f[1] += delta;
-   out_chan->f[2] += delta;
-   out_chan->f[3] += delta;
+   for (unsigned i = 0; i < mach->NumLanes; i++)
+      out_chan->f[i] += delta;
 }
 
 static void
@@ -2918,21 +2841,26 @@ eval_linear_coef(struct tgsi_exec_machine *mach,
                  unsigned attrib,
                  unsigned chan)
 {
-   const float x = mach->QuadPos.xyzw[0].f[0];
-   const float y = mach->QuadPos.xyzw[1].f[0];
    const float dadx = mach->InterpCoefs[attrib].dadx[chan];
    const float dady = mach->InterpCoefs[attrib].dady[chan];
-   const float a0 = mach->InterpCoefs[attrib].a0[chan] + dadx * x + dady * y;
+   float *out = mach->Inputs[attrib].xyzw[chan].f;
+   unsigned q;
+
+   for (q = 0; q < mach->NumLanes; q += TGSI_QUAD_SIZE) {
+      const float x = mach->QuadPos.xyzw[0].f[q];
+      const float y = mach->QuadPos.xyzw[1].f[q];
+      const float a0 = mach->InterpCoefs[attrib].a0[chan] + dadx * x + dady * y;
 
-   mach->Inputs[attrib].xyzw[chan].f[0] = a0;
-   mach->Inputs[attrib].xyzw[chan].f[1] = a0 + dadx;
-   mach->Inputs[attrib].xyzw[chan].f[2] = a0 + dady;
-   mach->Inputs[attrib].xyzw[chan].f[3] = a0 + dadx + dady;
+      out[q + 0] = a0;
+      out[q + 1] = a0 + dadx;
+      out[q + 2] = a0 + dady;
+      out[q + 3] = a0 + dadx + dady;
+   }
 }
 
 /**
  * Evaluate a perspective-valued coefficient at the position of the
- * current quad.
+ * current quads.
  */
 
 static void
@@ -2948,10 +2876,8 @@ interp_perspective_offset(
    const float dady = mach->InterpCoefs[attrib].dady[chan];
    const float *w = mach->QuadPos.xyzw[3].f;
    const float delta = ofs_x * dadx + ofs_y * dady;
-   out_chan->f[0] += delta / w[0];
-   out_chan->f[1] += delta / w[1];
-   out_chan->f[2] += delta / w[2];
-   out_chan->f[3] += delta / w[3];
+   for (unsigned i = 0; i < mach->NumLanes; i++)
+      out_chan->f[i] += delta / w[i];
 }
 
 static void
@@ -2960,17 +2886,22 @@ eval_perspective_coef(
    unsigned attrib,
    unsigned chan )
 {
-   const float x = mach->QuadPos.xyzw[0].f[0];
-   const float y = mach->QuadPos.xyzw[1].f[0];
    const float dadx = mach->InterpCoefs[attrib].dadx[chan];
    const float dady = mach->InterpCoefs[attrib].dady[chan];
-   const float a0 = mach->InterpCoefs[attrib].a0[chan] + dadx * x + dady * y;
-   const float *w = mach->QuadPos.xyzw[3].f;
-   /* divide by W here */
-   mach->Inputs[attrib].xyzw[chan].f[0] = a0 / w[0];
-   mach->Inputs[attrib].xyzw[chan].f[1] = (a0 + dadx) / w[1];
-   mach->Inputs[attrib].xyzw[chan].f[2] = (a0 + dady) / w[2];
-   mach->Inputs[attrib].xyzw[chan].f[3] = (a0 + dadx + dady) / w[3];
+   float *out = mach->Inputs[attrib].xyzw[chan].f;
+   unsigned q;
+
+   for (q = 0; q < mach->NumLanes; q += TGSI_QUAD_SIZE) {
+      const float x = mach->QuadPos.xyzw[0].f[q];
+      const float y = mach->QuadPos.xyzw[1].f[q];
+      const float a0 = mach->InterpCoefs[attrib].a0[chan] + dadx * x + dady * y;
+      const float *w = &mach->QuadPos.xyzw[3].f[q];
+      /* divide by W here */
+      out[q + 0] = a0 / w[0];
+      out[q + 1] = (a0 + dadx) / w[1];
+      out[q + 2] = (a0 + dady) / w[2];
+      out[q + 3] = (a0 + dadx + dady) / w[3];
+   }
 }
 
 
@@ -3009,7 +2940,7 @@ exec_declaration(struct tgsi_exec_machine *mach,
             assert(decl->Semantic.Index == 0);
             assert(first == last);
 
-            for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+            for (i = 0; i < mach->NumLanes; i++) {
                mach->Inputs[first].xyzw[0].f[i] = mach->Face;
             }
          } else {
@@ -3059,7 +2990,7 @@ exec_declaration(struct tgsi_exec_machine *mach,
             uint i, j;
             for (i = first; i <= last; ++i) {
                debug_printf("IN[%2u] = ", i);
-               for (j = 0; j < TGSI_NUM_CHANNELS; j++) {
+               for (j = 0; j < mach->NumLanes; j++) {
                   if (j > 0) {
                      debug_printf("         ");
                   }
@@ -3077,7 +3008,8 @@ exec_declaration(struct tgsi_exec_machine *mach,
 }
 
 typedef void (* micro_unary_op)(union tgsi_exec_channel *dst,
-                                const union tgsi_exec_channel *src);
+                                const union tgsi_exec_channel *src,
+                                unsigned lanes);
 
 static void
 exec_scalar_unary(struct tgsi_exec_machine *mach,
@@ -3091,7 +3023,7 @@ exec_scalar_unary(struct tgsi_exec_machine *mach,
    union tgsi_exec_channel dst;
 
    fetch_source(mach, &src, &inst->Src[0], TGSI_CHAN_X, src_datatype);
-   op(&dst, &src);
+   op(&dst, &src, mach->NumLanes);
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
       if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
          store_dest(mach, &dst, &inst->Dst[0], inst, chan, dst_datatype);
@@ -3114,7 +3046,7 @@ exec_vector_unary(struct tgsi_exec_machine *mach,
          union tgsi_exec_channel src;
 
          fetch_source(mach, &src, &inst->Src[0], chan, src_datatype);
-         op(&dst.xyzw[chan], &src);
+         op(&dst.xyzw[chan], &src, mach->NumLanes);
       }
    }
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
@@ -3126,7 +3058,8 @@ exec_vector_unary(struct tgsi_exec_machine *mach,
 
 typedef void (* micro_binary_op)(union tgsi_exec_channel *dst,
                                  const union tgsi_exec_channel *src0,
-                                 const union tgsi_exec_channel *src1);
+                                 const union tgsi_exec_channel *src1,
+                                 unsigned lanes);
 
 static void
 exec_scalar_binary(struct tgsi_exec_machine *mach,
@@ -3141,7 +3074,7 @@ exec_scalar_binary(struct tgsi_exec_machine *mach,
 
    fetch_source(mach, &src[0], &inst->Src[0], TGSI_CHAN_X, src_datatype);
    fetch_source(mach, &src[1], &inst->Src[1], TGSI_CHAN_X, src_datatype);
-   op(&dst, &src[0], &src[1]);
+   op(&dst, &src[0], &src[1], mach->NumLanes);
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
       if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
          store_dest(mach, &dst, &inst->Dst[0], inst, chan, dst_datatype);
@@ -3165,7 +3098,7 @@ exec_vector_binary(struct tgsi_exec_machine *mach,
 
          fetch_source(mach, &src[0], &inst->Src[0], chan, src_datatype);
          fetch_source(mach, &src[1], &inst->Src[1], chan, src_datatype);
-         op(&dst.xyzw[chan], &src[0], &src[1]);
+         op(&dst.xyzw[chan], &src[0], &src[1], mach->NumLanes);
       }
    }
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
@@ -3178,7 +3111,8 @@ exec_vector_binary(struct tgsi_exec_machine *mach,
 typedef void (* micro_trinary_op)(union tgsi_exec_channel *dst,
                                   const union tgsi_exec_channel *src0,
                                   const union tgsi_exec_channel *src1,
-                                  const union tgsi_exec_channel *src2);
+                                  const union tgsi_exec_channel *src2,
+                                  unsigned lanes);
 
 static void
 exec_vector_trinary(struct tgsi_exec_machine *mach,
@@ -3197,7 +3131,7 @@ exec_vector_trinary(struct tgsi_exec_machine *mach,
          fetch_source(mach, &src[0], &inst->Src[0], chan, src_datatype);
          fetch_source(mach, &src[1], &inst->Src[1], chan, src_datatype);
          fetch_source(mach, &src[2], &inst->Src[2], chan, src_datatype);
-         op(&dst.xyzw[chan], &src[0], &src[1], &src[2]);
+         op(&dst.xyzw[chan], &src[0], &src[1], &src[2], mach->NumLanes);
       }
    }
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
@@ -3211,7 +3145,8 @@ typedef void (* micro_quaternary_op)(union tgsi_exec_channel *dst,
                                      const union tgsi_exec_channel *src0,
                                      const union tgsi_exec_channel *src1,
                                      const union tgsi_exec_channel *src2,
-                                     const union tgsi_exec_channel *src3);
+                                     const union tgsi_exec_channel *src3,
+                                     unsigned lanes);
 
 static void
 exec_vector_quaternary(struct tgsi_exec_machine *mach,
@@ -3231,7 +3166,7 @@ exec_vector_quaternary(struct tgsi_exec_machine *mach,
          fetch_source(mach, &src[1], &inst->Src[1], chan, src_datatype);
          fetch_source(mach, &src[2], &inst->Src[2], chan, src_datatype);
          fetch_source(mach, &src[3], &inst->Src[3], chan, src_datatype);
-         op(&dst.xyzw[chan], &src[0], &src[1], &src[2], &src[3]);
+         op(&dst.xyzw[chan], &src[0], &src[1], &src[2], &src[3], mach->NumLanes);
       }
    }
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
@@ -3250,12 +3185,12 @@ exec_dp3(struct tgsi_exec_machine *mach,
 
    fetch_source(mach, &arg[0], &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
    fetch_source(mach, &arg[1], &inst->Src[1], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
-   micro_mul(&arg[2], &arg[0], &arg[1]);
+   micro_mul(&arg[2], &arg[0], &arg[1], mach->NumLanes);
 
    for (chan = TGSI_CHAN_Y; chan <= TGSI_CHAN_Z; chan++) {
       fetch_source(mach, &arg[0], &inst->Src[0], chan, TGSI_EXEC_DATA_FLOAT);
       fetch_source(mach, &arg[1], &inst->Src[1], chan, TGSI_EXEC_DATA_FLOAT);
-      micro_mad(&arg[2], &arg[0], &arg[1], &arg[2]);
+      micro_mad(&arg[2], &arg[0], &arg[1], &arg[2], mach->NumLanes);
    }
 
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
@@ -3274,12 +3209,12 @@ exec_dp4(struct tgsi_exec_machine *mach,
 
    fetch_source(mach, &arg[0], &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
    fetch_source(mach, &arg[1], &inst->Src[1], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
-   micro_mul(&arg[2], &arg[0], &arg[1]);
+   micro_mul(&arg[2], &arg[0], &arg[1], mach->NumLanes);
 
    for (chan = TGSI_CHAN_Y; chan <= TGSI_CHAN_W; chan++) {
       fetch_source(mach, &arg[0], &inst->Src[0], chan, TGSI_EXEC_DATA_FLOAT);
       fetch_source(mach, &arg[1], &inst->Src[1], chan, TGSI_EXEC_DATA_FLOAT);
-      micro_mad(&arg[2], &arg[0], &arg[1], &arg[2]);
+      micro_mad(&arg[2], &arg[0], &arg[1], &arg[2], mach->NumLanes);
    }
 
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
@@ -3298,11 +3233,11 @@ exec_dp2(struct tgsi_exec_machine *mach,
 
    fetch_source(mach, &arg[0], &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
    fetch_source(mach, &arg[1], &inst->Src[1], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
-   micro_mul(&arg[2], &arg[0], &arg[1]);
+   micro_mul(&arg[2], &arg[0], &arg[1], mach->NumLanes);
 
    fetch_source(mach, &arg[0], &inst->Src[0], TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
    fetch_source(mach, &arg[1], &inst->Src[1], TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
-   micro_mad(&arg[2], &arg[0], &arg[1], &arg[2]);
+   micro_mad(&arg[2], &arg[0], &arg[1], &arg[2], mach->NumLanes);
 
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
       if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
@@ -3320,7 +3255,7 @@ exec_pk2h(struct tgsi_exec_machine *mach,
 
    fetch_source(mach, &arg[0], &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
    fetch_source(mach, &arg[1], &inst->Src[0], TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
-   for (chan = 0; chan < TGSI_QUAD_SIZE; chan++) {
+   for (chan = 0; chan < mach->NumLanes; chan++) {
       dst.u[chan] = util_float_to_half(arg[0].f[chan]) |
          (util_float_to_half(arg[1].f[chan]) << 16);
    }
@@ -3339,7 +3274,7 @@ exec_up2h(struct tgsi_exec_machine *mach,
    union tgsi_exec_channel arg, dst[2];
 
    fetch_source(mach, &arg, &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_UINT);
-   for (chan = 0; chan < TGSI_QUAD_SIZE; chan++) {
+   for (chan = 0; chan < mach->NumLanes; chan++) {
       dst[0].f[chan] = util_half_to_float(arg.u[chan] & 0xffff);
       dst[1].f[chan] = util_half_to_float(arg.u[chan] >> 16);
    }
@@ -3354,12 +3289,11 @@ static void
 micro_ucmp(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1,
-           const union tgsi_exec_channel *src2)
+           const union tgsi_exec_channel *src2,
+           unsigned lanes)
 {
-   dst->f[0] = src0->u[0] ? src1->f[0] : src2->f[0];
-   dst->f[1] = src0->u[1] ? src1->f[1] : src2->f[1];
-   dst->f[2] = src0->u[2] ? src1->f[2] : src2->f[2];
-   dst->f[3] = src0->u[3] ? src1->f[3] : src2->f[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = src0->u[i] ? src1->f[i] : src2->f[i];
 }
 
 static void
@@ -3379,7 +3313,7 @@ exec_ucmp(struct tgsi_exec_machine *mach,
                       TGSI_EXEC_DATA_FLOAT);
          fetch_source(mach, &src[2], &inst->Src[2], chan,
                       TGSI_EXEC_DATA_FLOAT);
-         micro_ucmp(&dst.xyzw[chan], &src[0], &src[1], &src[2]);
+         micro_ucmp(&dst.xyzw[chan], &src[0], &src[1], &src[2], mach->NumLanes);
       }
    }
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
@@ -3400,7 +3334,7 @@ exec_dst(struct tgsi_exec_machine *mach,
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_Y) {
       fetch_source(mach, &r[0], &inst->Src[0], TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
       fetch_source(mach, &r[1], &inst->Src[1], TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
-      micro_mul(&d[TGSI_CHAN_Y], &r[0], &r[1]);
+      micro_mul(&d[TGSI_CHAN_Y], &r[0], &r[1], mach->NumLanes);
    }
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_Z) {
       fetch_source(mach, &d[TGSI_CHAN_Z], &inst->Src[0], TGSI_CHAN_Z, TGSI_EXEC_DATA_FLOAT);
@@ -3430,15 +3364,15 @@ exec_log(struct tgsi_exec_machine *mach,
    union tgsi_exec_channel r[3];
 
    fetch_source(mach, &r[0], &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
-   micro_abs(&r[2], &r[0]);  /* r2 = abs(r0) */
-   micro_lg2(&r[1], &r[2]);  /* r1 = lg2(r2) */
-   micro_flr(&r[0], &r[1]);  /* r0 = floor(r1) */
+   micro_abs(&r[2], &r[0], mach->NumLanes);  /* r2 = abs(r0) */
+   micro_lg2(&r[1], &r[2], mach->NumLanes);  /* r1 = lg2(r2) */
+   micro_flr(&r[0], &r[1], mach->NumLanes);  /* r0 = floor(r1) */
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_X) {
       store_dest(mach, &r[0], &inst->Dst[0], inst, TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
    }
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_Y) {
-      micro_exp2(&r[0], &r[0]);       /* r0 = 2 ^ r0 */
-      micro_div(&r[0], &r[2], &r[0]); /* r0 = r2 / r0 */
+      micro_exp2(&r[0], &r[0], mach->NumLanes);       /* r0 = 2 ^ r0 */
+      micro_div(&r[0], &r[2], &r[0], mach->NumLanes); /* r0 = r2 / r0 */
       store_dest(mach, &r[0], &inst->Dst[0], inst, TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
    }
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_Z) {
@@ -3456,17 +3390,17 @@ exec_exp(struct tgsi_exec_machine *mach,
    union tgsi_exec_channel r[3];
 
    fetch_source(mach, &r[0], &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
-   micro_flr(&r[1], &r[0]);  /* r1 = floor(r0) */
+   micro_flr(&r[1], &r[0], mach->NumLanes);  /* r1 = floor(r0) */
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_X) {
-      micro_exp2(&r[2], &r[1]);       /* r2 = 2 ^ r1 */
+      micro_exp2(&r[2], &r[1], mach->NumLanes);       /* r2 = 2 ^ r1 */
       store_dest(mach, &r[2], &inst->Dst[0], inst, TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
    }
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_Y) {
-      micro_sub(&r[2], &r[0], &r[1]); /* r2 = r0 - r1 */
+      micro_sub(&r[2], &r[0], &r[1], mach->NumLanes); /* r2 = r0 - r1 */
       store_dest(mach, &r[2], &inst->Dst[0], inst, TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
    }
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_Z) {
-      micro_exp2(&r[2], &r[0]);       /* r2 = 2 ^ r0 */
+      micro_exp2(&r[2], &r[0], mach->NumLanes);       /* r2 = 2 ^ r0 */
       store_dest(mach, &r[2], &inst->Dst[0], inst, TGSI_CHAN_Z, TGSI_EXEC_DATA_FLOAT);
    }
    if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_W) {
@@ -3485,17 +3419,17 @@ exec_lit(struct tgsi_exec_machine *mach,
       fetch_source(mach, &r[0], &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_FLOAT);
       if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_Z) {
          fetch_source(mach, &r[1], &inst->Src[0], TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
-         micro_max(&r[1], &r[1], &ZeroVec);
+         micro_max(&r[1], &r[1], &ZeroVec, mach->NumLanes);
 
          fetch_source(mach, &r[2], &inst->Src[0], TGSI_CHAN_W, TGSI_EXEC_DATA_FLOAT);
-         micro_min(&r[2], &r[2], &P128Vec);
-         micro_max(&r[2], &r[2], &M128Vec);
-         micro_pow(&r[1], &r[1], &r[2]);
-         micro_lt(&d[TGSI_CHAN_Z], &ZeroVec, &r[0], &r[1], &ZeroVec);
+         micro_min(&r[2], &r[2], &P128Vec, mach->NumLanes);
+         micro_max(&r[2], &r[2], &M128Vec, mach->NumLanes);
+         micro_pow(&r[1], &r[1], &r[2], mach->NumLanes);
+         micro_lt(&d[TGSI_CHAN_Z], &ZeroVec, &r[0], &r[1], &ZeroVec, mach->NumLanes);
          store_dest(mach, &d[TGSI_CHAN_Z], &inst->Dst[0], inst, TGSI_CHAN_Z, TGSI_EXEC_DATA_FLOAT);
       }
       if (inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_Y) {
-         micro_max(&d[TGSI_CHAN_Y], &r[0], &ZeroVec);
+         micro_max(&d[TGSI_CHAN_Y], &r[0], &ZeroVec, mach->NumLanes);
          store_dest(mach, &d[TGSI_CHAN_Y], &inst->Dst[0], inst, TGSI_CHAN_Y, TGSI_EXEC_DATA_FLOAT);
       }
    }
@@ -3550,20 +3484,13 @@ exec_case(struct tgsi_exec_machine *mach,
    uint prevMask = mach->SwitchStack[mach->SwitchStackTop - 1].mask;
    union tgsi_exec_channel src;
    uint mask = 0;
+   uint i;
 
    fetch_source(mach, &src, &inst->Src[0], TGSI_CHAN_X, TGSI_EXEC_DATA_UINT);
 
-   if (mach->Switch.selector.u[0] == src.u[0]) {
-      mask |= 0x1;
-   }
-   if (mach->Switch.selector.u[1] == src.u[1]) {
-      mask |= 0x2;
-   }
-   if (mach->Switch.selector.u[2] == src.u[2]) {
-      mask |= 0x4;
-   }
-   if (mach->Switch.selector.u[3] == src.u[3]) {
-      mask |= 0x8;
+   for (i = 0; i < mach->NumLanes; i++) {
+      if (mach->Switch.selector.u[i] == src.u[i])
+         mask |= 1 << i;
    }
 
    mach->Switch.defaultMask |= mask;
@@ -3594,17 +3521,21 @@ exec_endswitch(struct tgsi_exec_machine *mach)
 }
 
 typedef void (* micro_dop)(union tgsi_double_channel *dst,
-                           const union tgsi_double_channel *src);
+                           const union tgsi_double_channel *src,
+                           unsigned lanes);
 
 typedef void (* micro_dop_sop)(union tgsi_double_channel *dst,
                                const union tgsi_double_channel *src0,
-                               union tgsi_exec_channel *src1);
+                               union tgsi_exec_channel *src1,
+                               unsigned lanes);
 
 typedef void (* micro_dop_s)(union tgsi_double_channel *dst,
-                             const union tgsi_exec_channel *src);
+                             const union tgsi_exec_channel *src,
+                             unsigned lanes);
 
 typedef void (* micro_sop_d)(union tgsi_exec_channel *dst,
-                             const union tgsi_double_channel *src);
+                             const union tgsi_double_channel *src,
+                             unsigned lanes);
 
 static void
 fetch_double_channel(struct tgsi_exec_machine *mach,
@@ -3619,15 +3550,15 @@ fetch_double_channel(struct tgsi_exec_machine *mach,
    fetch_source_d(mach, &src[0], reg, chan_0);
    fetch_source_d(mach, &src[1], reg, chan_1);
 
-   for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+   for (i = 0; i < mach->NumLanes; i++) {
       chan->u[i][0] = src[0].u[i];
       chan->u[i][1] = src[1].u[i];
    }
    if (reg->Register.Absolute) {
-      micro_dabs(chan, chan);
+      micro_dabs(chan, chan, mach->NumLanes);
    }
    if (reg->Register.Negate) {
-      micro_dneg(chan, chan);
+      micro_dneg(chan, chan, mach->NumLanes);
    }
 }
 
@@ -3645,14 +3576,14 @@ store_double_channel(struct tgsi_exec_machine *mach,
    const uint execmask = mach->ExecMask;
 
    if (!inst->Instruction.Saturate) {
-      for (i = 0; i < TGSI_QUAD_SIZE; i++)
+      for (i = 0; i < mach->NumLanes; i++)
          if (execmask & (1 << i)) {
             dst[0].u[i] = chan->u[i][0];
             dst[1].u[i] = chan->u[i][1];
          }
    }
    else {
-      for (i = 0; i < TGSI_QUAD_SIZE; i++)
+      for (i = 0; i < mach->NumLanes; i++)
          if (execmask & (1 << i)) {
             if (chan->d[i] < 0.0)
                temp.d[i] = 0.0;
@@ -3681,12 +3612,12 @@ exec_double_unary(struct tgsi_exec_machine *mach,
 
    if ((inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_XY) == TGSI_WRITEMASK_XY) {
       fetch_double_channel(mach, &src, &inst->Src[0], TGSI_CHAN_X, TGSI_CHAN_Y);
-      op(&dst, &src);
+      op(&dst, &src, mach->NumLanes);
       store_double_channel(mach, &dst, &inst->Dst[0], inst, TGSI_CHAN_X, TGSI_CHAN_Y);
    }
    if ((inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_ZW) == TGSI_WRITEMASK_ZW) {
       fetch_double_channel(mach, &src, &inst->Src[0], TGSI_CHAN_Z, TGSI_CHAN_W);
-      op(&dst, &src);
+      op(&dst, &src, mach->NumLanes);
       store_double_channel(mach, &dst, &inst->Dst[0], inst, TGSI_CHAN_Z, TGSI_CHAN_W);
    }
 }
@@ -3714,7 +3645,7 @@ exec_double_binary(struct tgsi_exec_machine *mach,
 
       fetch_double_channel(mach, &src[0], &inst->Src[0], TGSI_CHAN_X, TGSI_CHAN_Y);
       fetch_double_channel(mach, &src[1], &inst->Src[1], TGSI_CHAN_X, TGSI_CHAN_Y);
-      op(&dst, src);
+      op(&dst, src, mach->NumLanes);
       store_double_channel(mach, &dst, &inst->Dst[0], inst, first_dest_chan, second_dest_chan);
    }
 
@@ -3728,7 +3659,7 @@ exec_double_binary(struct tgsi_exec_machine *mach,
 
       fetch_double_channel(mach, &src[0], &inst->Src[0], TGSI_CHAN_Z, TGSI_CHAN_W);
       fetch_double_channel(mach, &src[1], &inst->Src[1], TGSI_CHAN_Z, TGSI_CHAN_W);
-      op(&dst, src);
+      op(&dst, src, mach->NumLanes);
       store_double_channel(mach, &dst, &inst->Dst[0], inst, first_dest_chan, second_dest_chan);
    }
 }
@@ -3745,14 +3676,14 @@ exec_double_trinary(struct tgsi_exec_machine *mach,
       fetch_double_channel(mach, &src[0], &inst->Src[0], TGSI_CHAN_X, TGSI_CHAN_Y);
       fetch_double_channel(mach, &src[1], &inst->Src[1], TGSI_CHAN_X, TGSI_CHAN_Y);
       fetch_double_channel(mach, &src[2], &inst->Src[2], TGSI_CHAN_X, TGSI_CHAN_Y);
-      op(&dst, src);
+      op(&dst, src, mach->NumLanes);
       store_double_channel(mach, &dst, &inst->Dst[0], inst, TGSI_CHAN_X, TGSI_CHAN_Y);
    }
    if ((inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_ZW) == TGSI_WRITEMASK_ZW) {
       fetch_double_channel(mach, &src[0], &inst->Src[0], TGSI_CHAN_Z, TGSI_CHAN_W);
       fetch_double_channel(mach, &src[1], &inst->Src[1], TGSI_CHAN_Z, TGSI_CHAN_W);
       fetch_double_channel(mach, &src[2], &inst->Src[2], TGSI_CHAN_Z, TGSI_CHAN_W);
-      op(&dst, src);
+      op(&dst, src, mach->NumLanes);
       store_double_channel(mach, &dst, &inst->Dst[0], inst, TGSI_CHAN_Z, TGSI_CHAN_W);
    }
 }
@@ -3770,14 +3701,14 @@ exec_dldexp(struct tgsi_exec_machine *mach,
    if (wmask & TGSI_WRITEMASK_XY) {
       fetch_double_channel(mach, &src0, &inst->Src[0], TGSI_CHAN_X, TGSI_CHAN_Y);
       fetch_source(mach, &src1, &inst->Src[1], TGSI_CHAN_X, TGSI_EXEC_DATA_INT);
-      micro_dldexp(&dst, &src0, &src1);
+      micro_dldexp(&dst, &src0, &src1, mach->NumLanes);
       store_double_channel(mach, &dst, &inst->Dst[0], inst, TGSI_CHAN_X, TGSI_CHAN_Y);
    }
 
    if (wmask & TGSI_WRITEMASK_ZW) {
       fetch_double_channel(mach, &src0, &inst->Src[0], TGSI_CHAN_Z, TGSI_CHAN_W);
       fetch_source(mach, &src1, &inst->Src[1], TGSI_CHAN_Z, TGSI_EXEC_DATA_INT);
-      micro_dldexp(&dst, &src0, &src1);
+      micro_dldexp(&dst, &src0, &src1, mach->NumLanes);
       store_double_channel(mach, &dst, &inst->Dst[0], inst, TGSI_CHAN_Z, TGSI_CHAN_W);
    }
 }
@@ -3791,7 +3722,7 @@ exec_dfracexp(struct tgsi_exec_machine *mach,
    union tgsi_exec_channel dst_exp;
 
    fetch_double_channel(mach, &src, &inst->Src[0], TGSI_CHAN_X, TGSI_CHAN_Y);
-   micro_dfracexp(&dst, &dst_exp, &src);
+   micro_dfracexp(&dst, &dst_exp, &src, mach->NumLanes);
    if ((inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_XY) == TGSI_WRITEMASK_XY)
       store_double_channel(mach, &dst, &inst->Dst[0], inst, TGSI_CHAN_X, TGSI_CHAN_Y);
    if ((inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_ZW) == TGSI_WRITEMASK_ZW)
@@ -3816,14 +3747,14 @@ exec_arg0_64_arg1_32(struct tgsi_exec_machine *mach,
    if (wmask & TGSI_WRITEMASK_XY) {
       fetch_double_channel(mach, &src0, &inst->Src[0], TGSI_CHAN_X, TGSI_CHAN_Y);
       fetch_source(mach, &src1, &inst->Src[1], TGSI_CHAN_X, TGSI_EXEC_DATA_INT);
-      op(&dst, &src0, &src1);
+      op(&dst, &src0, &src1, mach->NumLanes);
       store_double_channel(mach, &dst, &inst->Dst[0], inst, TGSI_CHAN_X, TGSI_CHAN_Y);
    }
 
    if (wmask & TGSI_WRITEMASK_ZW) {
       fetch_double_channel(mach, &src0, &inst->Src[0], TGSI_CHAN_Z, TGSI_CHAN_W);
       fetch_source(mach, &src1, &inst->Src[1], TGSI_CHAN_Z, TGSI_EXEC_DATA_INT);
-      op(&dst, &src0, &src1);
+      op(&dst, &src0, &src1, mach->NumLanes);
       store_double_channel(mach, &dst, &inst->Dst[0], inst, TGSI_CHAN_Z, TGSI_CHAN_W);
    }
 }
@@ -3876,6 +3807,16 @@ get_image_coord_sample(unsigned tgsi_tex)
    return sample;
 }
 
+/*
+ * The image and buffer interfaces work on one quad at a time.
+ * Return the part of a lane mask that covers the quad starting at lane q.
+ */
+static inline uint
+quad_exec_mask(uint mask, uint q)
+{
+   return (mask >> q) & 0xf;
+}
+
 static void
 exec_load_img(struct tgsi_exec_machine *mach,
               const struct tgsi_full_instruction *inst)
@@ -3883,9 +3824,10 @@ exec_load_img(struct tgsi_exec_machine *mach,
    union tgsi_exec_channel r[4], sample_r;
    uint unit;
    int sample;
-   int i, j;
+   int i, j, q;
    int dim;
    uint chan;
+   uint execmask;
    float rgba[TGSI_NUM_CHANNELS][TGSI_QUAD_SIZE];
    struct tgsi_image_params params;
    int kilmask = mach->Temps[TEMP_KILMASK_I].xyzw[TEMP_KILMASK_C].u[0];
@@ -3895,7 +3837,7 @@ exec_load_img(struct tgsi_exec_machine *mach,
    sample = get_image_coord_sample(inst->Memory.Texture);
    assert(dim <= 3);
 
-   params.execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
+   execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
    params.unit = unit;
    params.tgsi_tex_instr = inst->Memory.Texture;
    params.format = inst->Memory.Format;
@@ -3907,14 +3849,17 @@ exec_load_img(struct tgsi_exec_machine *mach,
    if (sample)
       IFETCH(&sample_r, 1, TGSI_CHAN_X + sample);
 
-   mach->Image->load(mach->Image, &params,
-                     r[0].i, r[1].i, r[2].i, sample_r.i,
-                     rgba);
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-      r[0].f[j] = rgba[0][j];
-      r[1].f[j] = rgba[1][j];
-      r[2].f[j] = rgba[2][j];
-      r[3].f[j] = rgba[3][j];
+   for (q = 0; q < mach->NumLanes; q += TGSI_QUAD_SIZE) {
+      params.execmask = quad_exec_mask(execmask, q);
+      mach->Image->load(mach->Image, &params,
+                        &r[0].i[q], &r[1].i[q], &r[2].i[q], &sample_r.i[q],
+                        rgba);
+      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         r[0].f[q + j] = rgba[0][j];
+         r[1].f[q + j] = rgba[1][j];
+         r[2].f[q + j] = rgba[2][j];
+         r[3].f[q + j] = rgba[3][j];
+      }
    }
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
       if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
@@ -3929,25 +3874,29 @@ exec_load_buf(struct tgsi_exec_machine *mach,
 {
    union tgsi_exec_channel r[4];
    uint unit;
-   int j;
+   int j, q;
    uint chan;
+   uint execmask;
    float rgba[TGSI_NUM_CHANNELS][TGSI_QUAD_SIZE];
    struct tgsi_buffer_params params;
    int kilmask = mach->Temps[TEMP_KILMASK_I].xyzw[TEMP_KILMASK_C].u[0];
 
    unit = fetch_sampler_unit(mach, inst, 0);
 
-   params.execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
+   execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
    params.unit = unit;
    IFETCH(&r[0], 1, TGSI_CHAN_X);
 
-   mach->Buffer->load(mach->Buffer, &params,
-                      r[0].i, rgba);
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-      r[0].f[j] = rgba[0][j];
-      r[1].f[j] = rgba[1][j];
-      r[2].f[j] = rgba[2][j];
-      r[3].f[j] = rgba[3][j];
+   for (q = 0; q < mach->NumLanes; q += TGSI_QUAD_SIZE) {
+      params.execmask = quad_exec_mask(execmask, q);
+      mach->Buffer->load(mach->Buffer, &params,
+                         &r[0].i[q], rgba);
+      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         r[0].f[q + j] = rgba[0][j];
+         r[1].f[q + j] = rgba[1][j];
+         r[2].f[q + j] = rgba[2][j];
+         r[3].f[q + j] = rgba[3][j];
+      }
    }
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
       if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
@@ -3973,7 +3922,7 @@ exec_load_mem(struct tgsi_exec_machine *mach,
    offset = r[0].u[0];
    ptr += offset;
 
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+   for (j = 0; j < mach->NumLanes; j++) {
       for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
          if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
             memcpy(&r[chan].u[j], ptr + (4 * chan), 4);
@@ -4009,10 +3958,8 @@ fetch_store_img_unit(struct tgsi_exec_machine *mach,
    if (dst->Register.Indirect) {
       union tgsi_exec_channel indir_index, index2;
       const uint execmask = mach->ExecMask;
-      index2.i[0] =
-      index2.i[1] =
-      index2.i[2] =
-      index2.i[3] = dst->Indirect.Index;
+      for (i = 0; i < mach->NumLanes; i++)
+         index2.i[i] = dst->Indirect.Index;
 
       fetch_src_file_channel(mach,
                              dst->Indirect.File,
@@ -4020,7 +3967,7 @@ fetch_store_img_unit(struct tgsi_exec_machine *mach,
                              &index2,
                              &ZeroVec,
                              &indir_index);
-      for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+      for (i = 0; i < mach->NumLanes; i++) {
          if (execmask & (1 << i)) {
             unit = dst->Register.Index + indir_index.i[i];
             break;
@@ -4042,15 +3989,16 @@ exec_store_img(struct tgsi_exec_machine *mach,
    struct tgsi_image_params params;
    int dim;
    int sample;
-   int i, j;
+   int i, j, q;
    uint unit;
+   uint execmask;
    int kilmask = mach->Temps[TEMP_KILMASK_I].xyzw[TEMP_KILMASK_C].u[0];
    unit = fetch_store_img_unit(mach, &inst->Dst[0]);
    dim = get_image_coord_dim(inst->Memory.Texture);
    sample = get_image_coord_sample(inst->Memory.Texture);
    assert(dim <= 3);
 
-   params.execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
+   execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
    params.unit = unit;
    params.tgsi_tex_instr = inst->Memory.Texture;
    params.format = inst->Memory.Format;
@@ -4065,16 +4013,19 @@ exec_store_img(struct tgsi_exec_machine *mach,
    if (sample)
       IFETCH(&sample_r, 0, TGSI_CHAN_X + sample);
 
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-      rgba[0][j] = value[0].f[j];
-      rgba[1][j] = value[1].f[j];
-      rgba[2][j] = value[2].f[j];
-      rgba[3][j] = value[3].f[j];
-   }
+   for (q = 0; q < mach->NumLanes; q += TGSI_QUAD_SIZE) {
+      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         rgba[0][j] = value[0].f[q + j];
+         rgba[1][j] = value[1].f[q + j];
+         rgba[2][j] = value[2].f[q + j];
+         rgba[3][j] = value[3].f[q + j];
+      }
 
-   mach->Image->store(mach->Image, &params,
-                      r[0].i, r[1].i, r[2].i, sample_r.i,
-                      rgba);
+      params.execmask = quad_exec_mask(execmask, q);
+      mach->Image->store(mach->Image, &params,
+                         &r[0].i[q], &r[1].i[q], &r[2].i[q], &sample_r.i[q],
+                         rgba);
+   }
 }
 
 static void
@@ -4085,13 +4036,14 @@ exec_store_buf(struct tgsi_exec_machine *mach,
    union tgsi_exec_channel value[4];
    float rgba[TGSI_NUM_CHANNELS][TGSI_QUAD_SIZE];
    struct tgsi_buffer_params params;
-   int i, j;
+   int i, j, q;
    uint unit;
+   uint execmask;
    int kilmask = mach->Temps[TEMP_KILMASK_I].xyzw[TEMP_KILMASK_C].u[0];
 
    unit = fetch_store_img_unit(mach, &inst->Dst[0]);
 
-   params.execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
+   execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
    params.unit = unit;
    params.writemask = inst->Dst[0].Register.WriteMask;
 
@@ -4100,16 +4052,19 @@ exec_store_buf(struct tgsi_exec_machine *mach,
       FETCH(&value[i], 1, TGSI_CHAN_X + i);
    }
 
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-      rgba[0][j] = value[0].f[j];
-      rgba[1][j] = value[1].f[j];
-      rgba[2][j] = value[2].f[j];
-      rgba[3][j] = value[3].f[j];
-   }
+   for (q = 0; q < mach->NumLanes; q += TGSI_QUAD_SIZE) {
+      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         rgba[0][j] = value[0].f[q + j];
+         rgba[1][j] = value[1].f[q + j];
+         rgba[2][j] = value[2].f[q + j];
+         rgba[3][j] = value[3].f[q + j];
+      }
 
-   mach->Buffer->store(mach->Buffer, &params,
-                      r[0].i,
-                      rgba);
+      params.execmask = quad_exec_mask(execmask, q);
+      mach->Buffer->store(mach->Buffer, &params,
+                          &r[0].i[q],
+                          rgba);
+   }
 }
 
 static void
@@ -4133,7 +4088,7 @@ exec_store_mem(struct tgsi_exec_machine *mach,
       return;
    ptr += r[0].u[0];
 
-   for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+   for (i = 0; i < mach->NumLanes; i++) {
       if (execmask & (1 << i)) {
          for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
             if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
@@ -4167,15 +4122,16 @@ exec_atomop_img(struct tgsi_exec_machine *mach,
    struct tgsi_image_params params;
    int dim;
    int sample;
-   int i, j;
+   int i, j, q;
    uint unit, chan;
+   uint execmask;
    int kilmask = mach->Temps[TEMP_KILMASK_I].xyzw[TEMP_KILMASK_C].u[0];
    unit = fetch_sampler_unit(mach, inst, 0);
    dim = get_image_coord_dim(inst->Memory.Texture);
    sample = get_image_coord_sample(inst->Memory.Texture);
    assert(dim <= 3);
 
-   params.execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
+   execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
    params.unit = unit;
    params.tgsi_tex_instr = inst->Memory.Texture;
    params.format = inst->Memory.Format;
@@ -4192,30 +4148,33 @@ exec_atomop_img(struct tgsi_exec_machine *mach,
    if (sample)
       IFETCH(&sample_r, 1, TGSI_CHAN_X + sample);
 
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-      rgba[0][j] = value[0].f[j];
-      rgba[1][j] = value[1].f[j];
-      rgba[2][j] = value[2].f[j];
-      rgba[3][j] = value[3].f[j];
-   }
-   if (inst->Instruction.Opcode == TGSI_OPCODE_ATOMCAS) {
+   for (q = 0; q < mach->NumLanes; q += TGSI_QUAD_SIZE) {
       for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-         rgba2[0][j] = value2[0].f[j];
-         rgba2[1][j] = value2[1].f[j];
-         rgba2[2][j] = value2[2].f[j];
-         rgba2[3][j] = value2[3].f[j];
+         rgba[0][j] = value[0].f[q + j];
+         rgba[1][j] = value[1].f[q + j];
+         rgba[2][j] = value[2].f[q + j];
+         rgba[3][j] = value[3].f[q + j];
+      }
+      if (inst->Instruction.Opcode == TGSI_OPCODE_ATOMCAS) {
+         for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+            rgba2[0][j] = value2[0].f[q + j];
+            rgba2[1][j] = value2[1].f[q + j];
+            rgba2[2][j] = value2[2].f[q + j];
+            rgba2[3][j] = value2[3].f[q + j];
+         }
       }
-   }
 
-   mach->Image->op(mach->Image, &params, inst->Instruction.Opcode,
-                   r[0].i, r[1].i, r[2].i, sample_r.i,
-                   rgba, rgba2);
+      params.execmask = quad_exec_mask(execmask, q);
+      mach->Image->op(mach->Image, &params, inst->Instruction.Opcode,
+                      &r[0].i[q], &r[1].i[q], &r[2].i[q], &sample_r.i[q],
+                      rgba, rgba2);
 
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-      r[0].f[j] = rgba[0][j];
-      r[1].f[j] = rgba[1][j];
-      r[2].f[j] = rgba[2][j];
-      r[3].f[j] = rgba[3][j];
+      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         r[0].f[q + j] = rgba[0][j];
+         r[1].f[q + j] = rgba[1][j];
+         r[2].f[q + j] = rgba[2][j];
+         r[3].f[q + j] = rgba[3][j];
+      }
    }
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
       if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
@@ -4233,13 +4192,14 @@ exec_atomop_buf(struct tgsi_exec_machine *mach,
    float rgba[TGSI_NUM_CHANNELS][TGSI_QUAD_SIZE];
    float rgba2[TGSI_NUM_CHANNELS][TGSI_QUAD_SIZE];
    struct tgsi_buffer_params params;
-   int i, j;
+   int i, j, q;
    uint unit, chan;
+   uint execmask;
    int kilmask = mach->Temps[TEMP_KILMASK_I].xyzw[TEMP_KILMASK_C].u[0];
 
    unit = fetch_sampler_unit(mach, inst, 0);
 
-   params.execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
+   execmask = mach->ExecMask & mach->NonHelperMask & ~kilmask;
    params.unit = unit;
    params.writemask = inst->Dst[0].Register.WriteMask;
 
@@ -4251,30 +4211,33 @@ exec_atomop_buf(struct tgsi_exec_machine *mach,
          FETCH(&value2[i], 3, TGSI_CHAN_X + i);
    }
 
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-      rgba[0][j] = value[0].f[j];
-      rgba[1][j] = value[1].f[j];
-      rgba[2][j] = value[2].f[j];
-      rgba[3][j] = value[3].f[j];
-   }
-   if (inst->Instruction.Opcode == TGSI_OPCODE_ATOMCAS) {
+   for (q = 0; q < mach->NumLanes; q += TGSI_QUAD_SIZE) {
       for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-         rgba2[0][j] = value2[0].f[j];
-         rgba2[1][j] = value2[1].f[j];
-         rgba2[2][j] = value2[2].f[j];
-         rgba2[3][j] = value2[3].f[j];
+         rgba[0][j] = value[0].f[q + j];
+         rgba[1][j] = value[1].f[q + j];
+         rgba[2][j] = value[2].f[q + j];
+         rgba[3][j] = value[3].f[q + j];
+      }
+      if (inst->Instruction.Opcode == TGSI_OPCODE_ATOMCAS) {
+         for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+            rgba2[0][j] = value2[0].f[q + j];
+            rgba2[1][j] = value2[1].f[q + j];
+            rgba2[2][j] = value2[2].f[q + j];
+            rgba2[3][j] = value2[3].f[q + j];
+         }
       }
-   }
 
-   mach->Buffer->op(mach->Buffer, &params, inst->Instruction.Opcode,
-                   r[0].i,
-                   rgba, rgba2);
+      params.execmask = quad_exec_mask(execmask, q);
+      mach->Buffer->op(mach->Buffer, &params, inst->Instruction.Opcode,
+                       &r[0].i[q],
+                       rgba, rgba2);
 
-   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
-      r[0].f[j] = rgba[0][j];
-      r[1].f[j] = rgba[1][j];
-      r[2].f[j] = rgba[2][j];
-      r[3].f[j] = rgba[3][j];
+      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         r[0].f[q + j] = rgba[0][j];
+         r[1].f[q + j] = rgba[1][j];
+         r[2].f[q + j] = rgba[2][j];
+         r[3].f[q + j] = rgba[3][j];
+      }
    }
    for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
       if (inst->Dst[0].Register.WriteMask & (1 << chan)) {
@@ -4348,7 +4311,7 @@ exec_atomop_mem(struct tgsi_exec_machine *mach,
    default:
       break;
    }
-   for (i = 0; i < TGSI_QUAD_SIZE; i++)
+   for (i = 0; i < mach->NumLanes; i++)
       if (execmask & (1 << i))
          memcpy(ptr, &val, 4);
 
@@ -4391,7 +4354,7 @@ exec_resq_img(struct tgsi_exec_machine *mach,
 
    mach->Image->get_dims(mach->Image, &params, result);
 
-   for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+   for (i = 0; i < mach->NumLanes; i++) {
       for (j = 0; j < 4; j++) {
          r[j].i[i] = result[j];
       }
@@ -4423,7 +4386,7 @@ exec_resq_buf(struct tgsi_exec_machine *mach,
 
    mach->Buffer->get_dims(mach->Buffer, &params, &result);
 
-   for (i = 0; i < TGSI_QUAD_SIZE; i++) {
+   for (i = 0; i < mach->NumLanes; i++) {
       r[0].i[i] = result;
    }
 
@@ -4447,102 +4410,92 @@ exec_resq(struct tgsi_exec_machine *mach,
 
 static void
 micro_f2u64(union tgsi_double_channel *dst,
-            const union tgsi_exec_channel *src)
+            const union tgsi_exec_channel *src,
+            unsigned lanes)
 {
-   dst->u64[0] = (uint64_t)src->f[0];
-   dst->u64[1] = (uint64_t)src->f[1];
-   dst->u64[2] = (uint64_t)src->f[2];
-   dst->u64[3] = (uint64_t)src->f[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u64[i] = (uint64_t)src->f[i];
 }
 
 static void
 micro_f2i64(union tgsi_double_channel *dst,
-            const union tgsi_exec_channel *src)
+            const union tgsi_exec_channel *src,
+            unsigned lanes)
 {
-   dst->i64[0] = (int64_t)src->f[0];
-   dst->i64[1] = (int64_t)src->f[1];
-   dst->i64[2] = (int64_t)src->f[2];
-   dst->i64[3] = (int64_t)src->f[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->i64[i] = (int64_t)src->f[i];
 }
 
 static void
 micro_u2i64(union tgsi_double_channel *dst,
-            const union tgsi_exec_channel *src)
+            const union tgsi_exec_channel *src,
+            unsigned lanes)
 {
-   dst->u64[0] = (uint64_t)src->u[0];
-   dst->u64[1] = (uint64_t)src->u[1];
-   dst->u64[2] = (uint64_t)src->u[2];
-   dst->u64[3] = (uint64_t)src->u[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u64[i] = (uint64_t)src->u[i];
 }
 
 static void
 micro_i2i64(union tgsi_double_channel *dst,
-            const union tgsi_exec_channel *src)
+            const union tgsi_exec_channel *src,
+            unsigned lanes)
 {
-   dst->i64[0] = (int64_t)src->i[0];
-   dst->i64[1] = (int64_t)src->i[1];
-   dst->i64[2] = (int64_t)src->i[2];
-   dst->i64[3] = (int64_t)src->i[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->i64[i] = (int64_t)src->i[i];
 }
 
 static void
 micro_d2u64(union tgsi_double_channel *dst,
-           const union tgsi_double_channel *src)
+           const union tgsi_double_channel *src,
+           unsigned lanes)
 {
-   dst->u64[0] = (uint64_t)src->d[0];
-   dst->u64[1] = (uint64_t)src->d[1];
-   dst->u64[2] = (uint64_t)src->d[2];
-   dst->u64[3] = (uint64_t)src->d[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u64[i] = (uint64_t)src->d[i];
 }
 
 static void
 micro_d2i64(union tgsi_double_channel *dst,
-           const union tgsi_double_channel *src)
+           const union tgsi_double_channel *src,
+           unsigned lanes)
 {
-   dst->i64[0] = (int64_t)src->d[0];
-   dst->i64[1] = (int64_t)src->d[1];
-   dst->i64[2] = (int64_t)src->d[2];
-   dst->i64[3] = (int64_t)src->d[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->i64[i] = (int64_t)src->d[i];
 }
 
 static void
 micro_u642d(union tgsi_double_channel *dst,
-           const union tgsi_double_channel *src)
+           const union tgsi_double_channel *src,
+           unsigned lanes)
 {
-   dst->d[0] = (double)src->u64[0];
-   dst->d[1] = (double)src->u64[1];
-   dst->d[2] = (double)src->u64[2];
-   dst->d[3] = (double)src->u64[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->d[i] = (double)src->u64[i];
 }
 
 static void
 micro_i642d(union tgsi_double_channel *dst,
-           const union tgsi_double_channel *src)
+           const union tgsi_double_channel *src,
+           unsigned lanes)
 {
-   dst->d[0] = (double)src->i64[0];
-   dst->d[1] = (double)src->i64[1];
-   dst->d[2] = (double)src->i64[2];
-   dst->d[3] = (double)src->i64[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->d[i] = (double)src->i64[i];
 }
 
 static void
 micro_u642f(union tgsi_exec_channel *dst,
-            const union tgsi_double_channel *src)
+            const union tgsi_double_channel *src,
+            unsigned lanes)
 {
-   dst->f[0] = (float)src->u64[0];
-   dst->f[1] = (float)src->u64[1];
-   dst->f[2] = (float)src->u64[2];
-   dst->f[3] = (float)src->u64[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = (float)src->u64[i];
 }
 
 static void
 micro_i642f(union tgsi_exec_channel *dst,
-            const union tgsi_double_channel *src)
+            const union tgsi_double_channel *src,
+            unsigned lanes)
 {
-   dst->f[0] = (float)src->i64[0];
-   dst->f[1] = (float)src->i64[1];
-   dst->f[2] = (float)src->i64[2];
-   dst->f[3] = (float)src->i64[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = (float)src->i64[i];
 }
 
 static void
@@ -4556,12 +4509,12 @@ exec_t_2_64(struct tgsi_exec_machine *mach,
 
    if ((inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_XY) == TGSI_WRITEMASK_XY) {
       fetch_source(mach, &src, &inst->Src[0], TGSI_CHAN_X, src_datatype);
-      op(&dst, &src);
+      op(&dst, &src, mach->NumLanes);
       store_double_channel(mach, &dst, &inst->Dst[0], inst, TGSI_CHAN_X, TGSI_CHAN_Y);
    }
    if ((inst->Dst[0].Register.WriteMask & TGSI_WRITEMASK_ZW) == TGSI_WRITEMASK_ZW) {
       fetch_source(mach, &src, &inst->Src[0], TGSI_CHAN_Y, src_datatype);
-      op(&dst, &src);
+      op(&dst, &src, mach->NumLanes);
       store_double_channel(mach, &dst, &inst->Dst[0], inst, TGSI_CHAN_Z, TGSI_CHAN_W);
    }
 }
@@ -4585,7 +4538,7 @@ exec_64_2_t(struct tgsi_exec_machine *mach,
             fetch_double_channel(mach, &src, &inst->Src[0], TGSI_CHAN_X, TGSI_CHAN_Y);
          else
             fetch_double_channel(mach, &src, &inst->Src[0], TGSI_CHAN_Z, TGSI_CHAN_W);
-         op(&dst, &src);
+         op(&dst, &src, mach->NumLanes);
          store_dest(mach, &dst, &inst->Dst[0], inst, bit - 1, dst_datatype);
       }
    }
@@ -4593,401 +4546,360 @@ exec_64_2_t(struct tgsi_exec_machine *mach,
 
 static void
 micro_i2f(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned lanes)
 {
-   dst->f[0] = (float)src->i[0];
-   dst->f[1] = (float)src->i[1];
-   dst->f[2] = (float)src->i[2];
-   dst->f[3] = (float)src->i[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = (float)src->i[i];
 }
 
 static void
 micro_not(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned lanes)
 {
-   dst->u[0] = ~src->u[0];
-   dst->u[1] = ~src->u[1];
-   dst->u[2] = ~src->u[2];
-   dst->u[3] = ~src->u[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u[i] = ~src->u[i];
 }
 
 static void
 micro_shl(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned lanes)
 {
    unsigned masked_count;
-   masked_count = src1->u[0] & 0x1f;
-   dst->u[0] = src0->u[0] << masked_count;
-   masked_count = src1->u[1] & 0x1f;
-   dst->u[1] = src0->u[1] << masked_count;
-   masked_count = src1->u[2] & 0x1f;
-   dst->u[2] = src0->u[2] << masked_count;
-   masked_count = src1->u[3] & 0x1f;
-   dst->u[3] = src0->u[3] << masked_count;
+   for (unsigned i = 0; i < lanes; i++) {
+      masked_count = src1->u[i] & 0x1f;
+      dst->u[i] = src0->u[i] << masked_count;
+   }
 }
 
 static void
 micro_and(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned lanes)
 {
-   dst->u[0] = src0->u[0] & src1->u[0];
-   dst->u[1] = src0->u[1] & src1->u[1];
-   dst->u[2] = src0->u[2] & src1->u[2];
-   dst->u[3] = src0->u[3] & src1->u[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u[i] = src0->u[i] & src1->u[i];
 }
 
 static void
 micro_or(union tgsi_exec_channel *dst,
          const union tgsi_exec_channel *src0,
-         const union tgsi_exec_channel *src1)
+         const union tgsi_exec_channel *src1,
+         unsigned lanes)
 {
-   dst->u[0] = src0->u[0] | src1->u[0];
-   dst->u[1] = src0->u[1] | src1->u[1];
-   dst->u[2] = src0->u[2] | src1->u[2];
-   dst->u[3] = src0->u[3] | src1->u[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u[i] = src0->u[i] | src1->u[i];
 }
 
 static void
 micro_xor(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned lanes)
 {
-   dst->u[0] = src0->u[0] ^ src1->u[0];
-   dst->u[1] = src0->u[1] ^ src1->u[1];
-   dst->u[2] = src0->u[2] ^ src1->u[2];
-   dst->u[3] = src0->u[3] ^ src1->u[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u[i] = src0->u[i] ^ src1->u[i];
 }
 
 static void
 micro_mod(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
-          const union tgsi_exec_channel *src1)
+          const union tgsi_exec_channel *src1,
+          unsigned lanes)
 {
-   dst->i[0] = src1->i[0] ? src0->i[0] % src1->i[0] : ~0;
-   dst->i[1] = src1->i[1] ? src0->i[1] % src1->i[1] : ~0;
-   dst->i[2] = src1->i[2] ? src0->i[2] % src1->i[2] : ~0;
-   dst->i[3] = src1->i[3] ? src0->i[3] % src1->i[3] : ~0;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->i[i] = src1->i[i] ? src0->i[i] % src1->i[i] : ~0;
 }
 
 static void
 micro_f2i(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned lanes)
 {
-   dst->i[0] = (int)src->f[0];
-   dst->i[1] = (int)src->f[1];
-   dst->i[2] = (int)src->f[2];
-   dst->i[3] = (int)src->f[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->i[i] = (int)src->f[i];
 }
 
 static void
 micro_fseq(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned lanes)
 {
-   dst->u[0] = src0->f[0] == src1->f[0] ? ~0 : 0;
-   dst->u[1] = src0->f[1] == src1->f[1] ? ~0 : 0;
-   dst->u[2] = src0->f[2] == src1->f[2] ? ~0 : 0;
-   dst->u[3] = src0->f[3] == src1->f[3] ? ~0 : 0;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u[i] = src0->f[i] == src1->f[i] ? ~0 : 0;
 }
 
 static void
 micro_fsge(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned lanes)
 {
-   dst->u[0] = src0->f[0] >= src1->f[0] ? ~0 : 0;
-   dst->u[1] = src0->f[1] >= src1->f[1] ? ~0 : 0;
-   dst->u[2] = src0->f[2] >= src1->f[2] ? ~0 : 0;
-   dst->u[3] = src0->f[3] >= src1->f[3] ? ~0 : 0;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u[i] = src0->f[i] >= src1->f[i] ? ~0 : 0;
 }
 
 static void
 micro_fslt(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned lanes)
 {
-   dst->u[0] = src0->f[0] < src1->f[0] ? ~0 : 0;
-   dst->u[1] = src0->f[1] < src1->f[1] ? ~0 : 0;
-   dst->u[2] = src0->f[2] < src1->f[2] ? ~0 : 0;
-   dst->u[3] = src0->f[3] < src1->f[3] ? ~0 : 0;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u[i] = src0->f[i] < src1->f[i] ? ~0 : 0;
 }
 
 static void
 micro_fsne(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned lanes)
 {
-   dst->u[0] = src0->f[0] != src1->f[0] ? ~0 : 0;
-   dst->u[1] = src0->f[1] != src1->f[1] ? ~0 : 0;
-   dst->u[2] = src0->f[2] != src1->f[2] ? ~0 : 0;
-   dst->u[3] = src0->f[3] != src1->f[3] ? ~0 : 0;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u[i] = src0->f[i] != src1->f[i] ? ~0 : 0;
 }
 
 static void
 micro_idiv(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned lanes)
 {
-   dst->i[0] = src1->i[0] ? src0->i[0] / src1->i[0] : 0;
-   dst->i[1] = src1->i[1] ? src0->i[1] / src1->i[1] : 0;
-   dst->i[2] = src1->i[2] ? src0->i[2] / src1->i[2] : 0;
-   dst->i[3] = src1->i[3] ? src0->i[3] / src1->i[3] : 0;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->i[i] = src1->i[i] ? src0->i[i] / src1->i[i] : 0;
 }
 
 static void
 micro_imax(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned lanes)
 {
-   dst->i[0] = src0->i[0] > src1->i[0] ? src0->i[0] : src1->i[0];
-   dst->i[1] = src0->i[1] > src1->i[1] ? src0->i[1] : src1->i[1];
-   dst->i[2] = src0->i[2] > src1->i[2] ? src0->i[2] : src1->i[2];
-   dst->i[3] = src0->i[3] > src1->i[3] ? src0->i[3] : src1->i[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->i[i] = src0->i[i] > src1->i[i] ? src0->i[i] : src1->i[i];
 }
 
 static void
 micro_imin(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned lanes)
 {
-   dst->i[0] = src0->i[0] < src1->i[0] ? src0->i[0] : src1->i[0];
-   dst->i[1] = src0->i[1] < src1->i[1] ? src0->i[1] : src1->i[1];
-   dst->i[2] = src0->i[2] < src1->i[2] ? src0->i[2] : src1->i[2];
-   dst->i[3] = src0->i[3] < src1->i[3] ? src0->i[3] : src1->i[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->i[i] = src0->i[i] < src1->i[i] ? src0->i[i] : src1->i[i];
 }
 
 static void
 micro_isge(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned lanes)
 {
-   dst->i[0] = src0->i[0] >= src1->i[0] ? -1 : 0;
-   dst->i[1] = src0->i[1] >= src1->i[1] ? -1 : 0;
-   dst->i[2] = src0->i[2] >= src1->i[2] ? -1 : 0;
-   dst->i[3] = src0->i[3] >= src1->i[3] ? -1 : 0;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->i[i] = src0->i[i] >= src1->i[i] ? -1 : 0;
 }
 
 static void
 micro_ishr(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned lanes)
 {
    unsigned masked_count;
-   masked_count = src1->i[0] & 0x1f;
-   dst->i[0] = src0->i[0] >> masked_count;
-   masked_count = src1->i[1] & 0x1f;
-   dst->i[1] = src0->i[1] >> masked_count;
-   masked_count = src1->i[2] & 0x1f;
-   dst->i[2] = src0->i[2] >> masked_count;
-   masked_count = src1->i[3] & 0x1f;
-   dst->i[3] = src0->i[3] >> masked_count;
+   for (unsigned i = 0; i < lanes; i++) {
+      masked_count = src1->i[i] & 0x1f;
+      dst->i[i] = src0->i[i] >> masked_count;
+   }
 }
 
 static void
 micro_islt(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned lanes)
 {
-   dst->i[0] = src0->i[0] < src1->i[0] ? -1 : 0;
-   dst->i[1] = src0->i[1] < src1->i[1] ? -1 : 0;
-   dst->i[2] = src0->i[2] < src1->i[2] ? -1 : 0;
-   dst->i[3] = src0->i[3] < src1->i[3] ? -1 : 0;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->i[i] = src0->i[i] < src1->i[i] ? -1 : 0;
 }
 
 static void
 micro_f2u(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned lanes)
 {
-   dst->u[0] = (uint)src->f[0];
-   dst->u[1] = (uint)src->f[1];
-   dst->u[2] = (uint)src->f[2];
-   dst->u[3] = (uint)src->f[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u[i] = (uint)src->f[i];
 }
 
 static void
 micro_u2f(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned lanes)
 {
-   dst->f[0] = (float)src->u[0];
-   dst->f[1] = (float)src->u[1];
-   dst->f[2] = (float)src->u[2];
-   dst->f[3] = (float)src->u[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->f[i] = (float)src->u[i];
 }
 
 static void
 micro_uadd(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned lanes)
 {
-   dst->u[0] = src0->u[0] + src1->u[0];
-   dst->u[1] = src0->u[1] + src1->u[1];
-   dst->u[2] = src0->u[2] + src1->u[2];
-   dst->u[3] = src0->u[3] + src1->u[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u[i] = src0->u[i] + src1->u[i];
 }
 
 static void
 micro_udiv(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned lanes)
 {
-   dst->u[0] = src1->u[0] ? src0->u[0] / src1->u[0] : ~0u;
-   dst->u[1] = src1->u[1] ? src0->u[1] / src1->u[1] : ~0u;
-   dst->u[2] = src1->u[2] ? src0->u[2] / src1->u[2] : ~0u;
-   dst->u[3] = src1->u[3] ? src0->u[3] / src1->u[3] : ~0u;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u[i] = src1->u[i] ? src0->u[i] / src1->u[i] : ~0u;
 }
 
 static void
 micro_umad(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1,
-           const union tgsi_exec_channel *src2)
+           const union tgsi_exec_channel *src2,
+           unsigned lanes)
 {
-   dst->u[0] = src0->u[0] * src1->u[0] + src2->u[0];
-   dst->u[1] = src0->u[1] * src1->u[1] + src2->u[1];
-   dst->u[2] = src0->u[2] * src1->u[2] + src2->u[2];
-   dst->u[3] = src0->u[3] * src1->u[3] + src2->u[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u[i] = src0->u[i] * src1->u[i] + src2->u[i];
 }
 
 static void
 micro_umax(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned lanes)
 {
-   dst->u[0] = src0->u[0] > src1->u[0] ? src0->u[0] : src1->u[0];
-   dst->u[1] = src0->u[1] > src1->u[1] ? src0->u[1] : src1->u[1];
-   dst->u[2] = src0->u[2] > src1->u[2] ? src0->u[2] : src1->u[2];
-   dst->u[3] = src0->u[3] > src1->u[3] ? src0->u[3] : src1->u[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u[i] = src0->u[i] > src1->u[i] ? src0->u[i] : src1->u[i];
 }
 
 static void
 micro_umin(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned lanes)
 {
-   dst->u[0] = src0->u[0] < src1->u[0] ? src0->u[0] : src1->u[0];
-   dst->u[1] = src0->u[1] < src1->u[1] ? src0->u[1] : src1->u[1];
-   dst->u[2] = src0->u[2] < src1->u[2] ? src0->u[2] : src1->u[2];
-   dst->u[3] = src0->u[3] < src1->u[3] ? src0->u[3] : src1->u[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u[i] = src0->u[i] < src1->u[i] ? src0->u[i] : src1->u[i];
 }
 
 static void
 micro_umod(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned lanes)
 {
-   dst->u[0] = src1->u[0] ? src0->u[0] % src1->u[0] : ~0u;
-   dst->u[1] = src1->u[1] ? src0->u[1] % src1->u[1] : ~0u;
-   dst->u[2] = src1->u[2] ? src0->u[2] % src1->u[2] : ~0u;
-   dst->u[3] = src1->u[3] ? src0->u[3] % src1->u[3] : ~0u;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u[i] = src1->u[i] ? src0->u[i] % src1->u[i] : ~0u;
 }
 
 static void
 micro_umul(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned lanes)
 {
-   dst->u[0] = src0->u[0] * src1->u[0];
-   dst->u[1] = src0->u[1] * src1->u[1];
-   dst->u[2] = src0->u[2] * src1->u[2];
-   dst->u[3] = src0->u[3] * src1->u[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u[i] = src0->u[i] * src1->u[i];
 }
 
 static void
 micro_imul_hi(union tgsi_exec_channel *dst,
               const union tgsi_exec_channel *src0,
-              const union tgsi_exec_channel *src1)
+              const union tgsi_exec_channel *src1,
+              unsigned lanes)
 {
 #define I64M(x, y) ((((int64_t)x) * ((int64_t)y)) >> 32)
-   dst->i[0] = I64M(src0->i[0], src1->i[0]);
-   dst->i[1] = I64M(src0->i[1], src1->i[1]);
-   dst->i[2] = I64M(src0->i[2], src1->i[2]);
-   dst->i[3] = I64M(src0->i[3], src1->i[3]);
+   for (unsigned i = 0; i < lanes; i++)
+      dst->i[i] = I64M(src0->i[i], src1->i[i]);
 #undef I64M
 }
 
 static void
 micro_umul_hi(union tgsi_exec_channel *dst,
               const union tgsi_exec_channel *src0,
-              const union tgsi_exec_channel *src1)
+              const union tgsi_exec_channel *src1,
+              unsigned lanes)
 {
 #define U64M(x, y) ((((uint64_t)x) * ((uint64_t)y)) >> 32)
-   dst->u[0] = U64M(src0->u[0], src1->u[0]);
-   dst->u[1] = U64M(src0->u[1], src1->u[1]);
-   dst->u[2] = U64M(src0->u[2], src1->u[2]);
-   dst->u[3] = U64M(src0->u[3], src1->u[3]);
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u[i] = U64M(src0->u[i], src1->u[i]);
 #undef U64M
 }
 
 static void
 micro_useq(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned lanes)
 {
-   dst->u[0] = src0->u[0] == src1->u[0] ? ~0 : 0;
-   dst->u[1] = src0->u[1] == src1->u[1] ? ~0 : 0;
-   dst->u[2] = src0->u[2] == src1->u[2] ? ~0 : 0;
-   dst->u[3] = src0->u[3] == src1->u[3] ? ~0 : 0;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u[i] = src0->u[i] == src1->u[i] ? ~0 : 0;
 }
 
 static void
 micro_usge(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned lanes)
 {
-   dst->u[0] = src0->u[0] >= src1->u[0] ? ~0 : 0;
-   dst->u[1] = src0->u[1] >= src1->u[1] ? ~0 : 0;
-   dst->u[2] = src0->u[2] >= src1->u[2] ? ~0 : 0;
-   dst->u[3] = src0->u[3] >= src1->u[3] ? ~0 : 0;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u[i] = src0->u[i] >= src1->u[i] ? ~0 : 0;
 }
 
 static void
 micro_ushr(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned lanes)
 {
    unsigned masked_count;
-   masked_count = src1->u[0] & 0x1f;
-   dst->u[0] = src0->u[0] >> masked_count;
-   masked_count = src1->u[1] & 0x1f;
-   dst->u[1] = src0->u[1] >> masked_count;
-   masked_count = src1->u[2] & 0x1f;
-   dst->u[2] = src0->u[2] >> masked_count;
-   masked_count = src1->u[3] & 0x1f;
-   dst->u[3] = src0->u[3] >> masked_count;
+   for (unsigned i = 0; i < lanes; i++) {
+      masked_count = src1->u[i] & 0x1f;
+      dst->u[i] = src0->u[i] >> masked_count;
+   }
 }
 
 static void
 micro_uslt(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned lanes)
 {
-   dst->u[0] = src0->u[0] < src1->u[0] ? ~0 : 0;
-   dst->u[1] = src0->u[1] < src1->u[1] ? ~0 : 0;
-   dst->u[2] = src0->u[2] < src1->u[2] ? ~0 : 0;
-   dst->u[3] = src0->u[3] < src1->u[3] ? ~0 : 0;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u[i] = src0->u[i] < src1->u[i] ? ~0 : 0;
 }
 
 static void
 micro_usne(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
-           const union tgsi_exec_channel *src1)
+           const union tgsi_exec_channel *src1,
+           unsigned lanes)
 {
-   dst->u[0] = src0->u[0] != src1->u[0] ? ~0 : 0;
-   dst->u[1] = src0->u[1] != src1->u[1] ? ~0 : 0;
-   dst->u[2] = src0->u[2] != src1->u[2] ? ~0 : 0;
-   dst->u[3] = src0->u[3] != src1->u[3] ? ~0 : 0;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u[i] = src0->u[i] != src1->u[i] ? ~0 : 0;
 }
 
 static void
 micro_uarl(union tgsi_exec_channel *dst,
-           const union tgsi_exec_channel *src)
+           const union tgsi_exec_channel *src,
+           unsigned lanes)
 {
-   dst->i[0] = src->u[0];
-   dst->i[1] = src->u[1];
-   dst->i[2] = src->u[2];
-   dst->i[3] = src->u[3];
+   for (unsigned i = 0; i < lanes; i++)
+      dst->i[i] = src->u[i];
 }
 
 /**
@@ -4997,10 +4909,11 @@ static void
 micro_ibfe(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1,
-           const union tgsi_exec_channel *src2)
+           const union tgsi_exec_channel *src2,
+           unsigned lanes)
 {
    int i;
-   for (i = 0; i < 4; i++) {
+   for (i = 0; i < lanes; i++) {
       int width = src2->i[i];
       int offset = src1->i[i] & 0x1f;
       if (width == 32 && offset == 0) {
@@ -5024,10 +4937,11 @@ static void
 micro_ubfe(union tgsi_exec_channel *dst,
            const union tgsi_exec_channel *src0,
            const union tgsi_exec_channel *src1,
-           const union tgsi_exec_channel *src2)
+           const union tgsi_exec_channel *src2,
+           unsigned lanes)
 {
    int i;
-   for (i = 0; i < 4; i++) {
+   for (i = 0; i < lanes; i++) {
       int width = src2->u[i];
       int offset = src1->u[i] & 0x1f;
       if (width == 32 && offset == 0) {
@@ -5052,10 +4966,11 @@ micro_bfi(union tgsi_exec_channel *dst,
           const union tgsi_exec_channel *src0,
           const union tgsi_exec_channel *src1,
           const union tgsi_exec_channel *src2,
-          const union tgsi_exec_channel *src3)
+          const union tgsi_exec_channel *src3,
+          unsigned lanes)
 {
    int i;
-   for (i = 0; i < 4; i++) {
+   for (i = 0; i < lanes; i++) {
       int width = src3->u[i];
       int offset = src2->u[i] & 0x1f;
       if (width == 32) {
@@ -5069,52 +4984,47 @@ micro_bfi(union tgsi_exec_channel *dst,
 
 static void
 micro_brev(union tgsi_exec_channel *dst,
-           const union tgsi_exec_channel *src)
+           const union tgsi_exec_channel *src,
+           unsigned lanes)
 {
-   dst->u[0] = util_bitreverse(src->u[0]);
-   dst->u[1] = util_bitreverse(src->u[1]);
-   dst->u[2] = util_bitreverse(src->u[2]);
-   dst->u[3] = util_bitreverse(src->u[3]);
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u[i] = util_bitreverse(src->u[i]);
 }
 
 static void
 micro_popc(union tgsi_exec_channel *dst,
-           const union tgsi_exec_channel *src)
+           const union tgsi_exec_channel *src,
+           unsigned lanes)
 {
-   dst->u[0] = util_bitcount(src->u[0]);
-   dst->u[1] = util_bitcount(src->u[1]);
-   dst->u[2] = util_bitcount(src->u[2]);
-   dst->u[3] = util_bitcount(src->u[3]);
+   for (unsigned i = 0; i < lanes; i++)
+      dst->u[i] = util_bitcount(src->u[i]);
 }
 
 static void
 micro_lsb(union tgsi_exec_channel *dst,
-          const union tgsi_exec_channel *src)
+          const union tgsi_exec_channel *src,
+          unsigned lanes)
 {
-   dst->i[0] = ffs(src->u[0]) - 1;
-   dst->i[1] = ffs(src->u[1]) - 1;
-   dst->i[2] = ffs(src->u[2]) - 1;
-   dst->i[3] = ffs(src->u[3]) - 1;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->i[i] = ffs(src->u[i]) - 1;
 }
 
 static void
 micro_imsb(union tgsi_exec_channel *dst,
-           const union tgsi_exec_channel *src)
+           const union tgsi_exec_channel *src,
+           unsigned lanes)
 {
-   dst->i[0] = util_last_bit_signed(src->i[0]) - 1;
-   dst->i[1] = util_last_bit_signed(src->i[1]) - 1;
-   dst->i[2] = util_last_bit_signed(src->i[2]) - 1;
-   dst->i[3] = util_last_bit_signed(src->i[3]) - 1;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->i[i] = util_last_bit_signed(src->i[i]) - 1;
 }
 
 static void
 micro_umsb(union tgsi_exec_channel *dst,
-           const union tgsi_exec_channel *src)
+           const union tgsi_exec_channel *src,
+           unsigned lanes)
 {
-   dst->i[0] = util_last_bit(src->u[0]) - 1;
-   dst->i[1] = util_last_bit(src->u[1]) - 1;
-   dst->i[2] = util_last_bit(src->u[2]) - 1;
-   dst->i[3] = util_last_bit(src->u[3]) - 1;
+   for (unsigned i = 0; i < lanes; i++)
+      dst->i[i] = util_last_bit(src->u[i]) - 1;
 }
 
 
@@ -5590,17 +5500,10 @@ exec_instruction(
       mach->CondStack[mach->CondStackTop++] = mach->CondMask;
       FETCH( &r[0], 0, TGSI_CHAN_X );
       /* update CondMask */
-      if( ! r[0].f[0] ) {
-         mach->CondMask &= ~0x1;
-      }
-      if( ! r[0].f[1] ) {
-         mach->CondMask &= ~0x2;
-      }
-      if( ! r[0].f[2] ) {
-         mach->CondMask &= ~0x4;
-      }
-      if( ! r[0].f[3] ) {
-         mach->CondMask &= ~0x8;
+      for (unsigned i = 0; i < mach->NumLanes; i++) {
+         if( ! r[0].f[i] ) {
+            mach->CondMask &= ~(1 << i);
+         }
       }
       UPDATE_EXEC_MASK(mach);
       /* Todo: If CondMask==0, jump to ELSE */
@@ -5612,17 +5515,10 @@ exec_instruction(
       mach->CondStack[mach->CondStackTop++] = mach->CondMask;
       IFETCH( &r[0], 0, TGSI_CHAN_X );
       /* update CondMask */
-      if( ! r[0].u[0] ) {
-         mach->CondMask &= ~0x1;
-      }
-      if( ! r[0].u[1] ) {
-         mach->CondMask &= ~0x2;
-      }
-      if( ! r[0].u[2] ) {
-         mach->CondMask &= ~0x4;
-      }
-      if( ! r[0].u[3] ) {
-         mach->CondMask &= ~0x8;
+      for (unsigned i = 0; i < mach->NumLanes; i++) {
+         if( ! r[0].u[i] ) {
+            mach->CondMask &= ~(1 << i);
+         }
       }
       UPDATE_EXEC_MASK(mach);
       /* Todo: If CondMask==0, jump to ELSE */
@@ -6289,10 +6185,490 @@ exec_instruction(
    return FALSE;
 }
 
+/*
+ * Pre-decoded instructions.
+ *
+ * fetch_source() and store_dest() resolve the register file, index,
+ * swizzle and modifiers of every operand each time an instruction is
+ * executed.  For the common ALU instructions whose operands are all
+ * directly addressed, tgsi_exec_machine_bind_shader() resolves this once
+ * into a tgsi_exec_op holding pointers to the register storage, and
+ * exec_ops() runs those without going through exec_instruction().
+ * Everything else (control flow, texturing, indirect addressing, ...)
+ * keeps using exec_instruction().
+ */
+
+enum tgsi_exec_op_kind {
+   TGSI_EXEC_OP_GENERIC = 0,  /**< use exec_instruction() */
+   TGSI_EXEC_OP_UNARY,
+   TGSI_EXEC_OP_BINARY,
+   TGSI_EXEC_OP_TRINARY,
+   TGSI_EXEC_OP_DP2,
+   TGSI_EXEC_OP_DP3,
+   TGSI_EXEC_OP_DP4,
+   TGSI_EXEC_OP_COUNT
+};
+
+struct tgsi_exec_op_src
+{
+   /** Storage of each swizzled channel, NULL for scalar sources */
+   const union tgsi_exec_channel *chan[TGSI_NUM_CHANNELS];
+
+   /** Immediate value of each swizzled channel, or NULL */
+   const uint *imm[TGSI_NUM_CHANNELS];
+
+   /** Constant buffer and dword of each swizzled channel */
+   uint const_buf;
+   int const_pos[TGSI_NUM_CHANNELS];
+
+   boolean absolute;
+   boolean negate;
+};
+
+struct tgsi_exec_op
+{
+   enum tgsi_exec_op_kind kind;
+   union {
+      micro_unary_op unary;
+      micro_binary_op binary;
+      micro_trinary_op trinary;
+   } fn;
+   boolean saturate;
+   struct tgsi_exec_op_src src[3];
+   /** Destination storage of each channel, NULL if not written */
+   union tgsi_exec_channel *dst[TGSI_NUM_CHANNELS];
+};
+
+
+static boolean
+build_op_src(const struct tgsi_exec_machine *mach,
+             const struct tgsi_full_src_register *reg,
+             struct tgsi_exec_op_src *src)
+{
+   const int index = reg->Register.Index;
+   uint chan;
+
+   if (reg->Register.Indirect ||
+       (reg->Register.Dimension && reg->Dimension.Indirect))
+      return FALSE;
+
+   if (reg->Register.Dimension && reg->Register.File != TGSI_FILE_CONSTANT)
+      return FALSE;
+
+   memset(src, 0, sizeof *src);
+   src->absolute = reg->Register.Absolute;
+   src->negate = reg->Register.Negate;
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      const uint swizzle = tgsi_util_get_full_src_register_swizzle(reg, chan);
+
+      switch (reg->Register.File) {
+      case TGSI_FILE_CONSTANT:
+         src->const_buf = reg->Register.Dimension ? reg->Dimension.Index : 0;
+         src->const_pos[chan] = index * 4 + swizzle;
+         if (src->const_buf >= PIPE_MAX_CONSTANT_BUFFERS)
+            return FALSE;
+         break;
+      case TGSI_FILE_IMMEDIATE:
+         if (index >= (int)mach->ImmLimit)
+            return FALSE;
+         src->imm[chan] = (const uint *)&mach->Imms[index][swizzle];
+         break;
+      case TGSI_FILE_INPUT:
+         if (!mach->Inputs || index >= PIPE_MAX_SHADER_INPUTS)
+            return FALSE;
+         src->chan[chan] = &mach->Inputs[index].xyzw[swizzle];
+         break;
+      case TGSI_FILE_OUTPUT:
+         if (!mach->Outputs || mach->ShaderType == PIPE_SHADER_GEOMETRY ||
+             index >= PIPE_MAX_SHADER_OUTPUTS)
+            return FALSE;
+         src->chan[chan] = &mach->Outputs[index].xyzw[swizzle];
+         break;
+      case TGSI_FILE_TEMPORARY:
+         if (index >= TGSI_EXEC_NUM_TEMPS)
+            return FALSE;
+         src->chan[chan] = &mach->Temps[index].xyzw[swizzle];
+         break;
+      case TGSI_FILE_SYSTEM_VALUE:
+         if (index >= TGSI_MAX_MISC_INPUTS)
+            return FALSE;
+         src->chan[chan] = &mach->SystemValue[index].xyzw[swizzle];
+         break;
+      default:
+         return FALSE;
+      }
+   }
+
+   return TRUE;
+}
+
+static boolean
+build_op_dst(struct tgsi_exec_machine *mach,
+             const struct tgsi_full_dst_register *reg,
+             struct tgsi_exec_op *op)
+{
+   const int index = reg->Register.Index;
+   struct tgsi_exec_vector *vec;
+   uint chan;
+
+   if (reg->Register.Indirect || reg->Register.Dimension)
+      return FALSE;
+
+   switch (reg->Register.File) {
+   case TGSI_FILE_OUTPUT:
+      /* geometry shaders offset outputs by the emitted vertex count */
+      if (!mach->Outputs || mach->ShaderType == PIPE_SHADER_GEOMETRY ||
+          index >= PIPE_MAX_SHADER_OUTPUTS)
+         return FALSE;
+      vec = &mach->Outputs[index];
+      break;
+   case TGSI_FILE_TEMPORARY:
+      if (index >= TGSI_EXEC_NUM_TEMPS)
+         return FALSE;
+      vec = &mach->Temps[index];
+      break;
+   case TGSI_FILE_ADDRESS:
+      vec = &mach->Addrs[index];
+      break;
+   default:
+      return FALSE;
+   }
+
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      op->dst[chan] = (reg->Register.WriteMask & (1 << chan)) ?
+         &vec->xyzw[chan] : NULL;
+   }
+
+   return TRUE;
+}
+
+static void
+build_op(struct tgsi_exec_machine *mach,
+         const struct tgsi_full_instruction *inst,
+         struct tgsi_exec_op *op)
+{
+   enum tgsi_exec_op_kind kind;
+   uint i;
+
+   memset(op, 0, sizeof *op);
+
+   /* These must match what exec_instruction() does for the opcode;
+    * all of them take float sources.
+    */
+   switch (inst->Instruction.Opcode) {
+   case TGSI_OPCODE_ARL:
+      kind = TGSI_EXEC_OP_UNARY;
+      op->fn.unary = micro_arl;
+      break;
+   case TGSI_OPCODE_MOV:
+      kind = TGSI_EXEC_OP_UNARY;
+      op->fn.unary = micro_mov;
+      break;
+   case TGSI_OPCODE_FRC:
+      kind = TGSI_EXEC_OP_UNARY;
+      op->fn.unary = micro_frc;
+      break;
+   case TGSI_OPCODE_FLR:
+      kind = TGSI_EXEC_OP_UNARY;
+      op->fn.unary = micro_flr;
+      break;
+   case TGSI_OPCODE_MUL:
+      kind = TGSI_EXEC_OP_BINARY;
+      op->fn.binary = micro_mul;
+      break;
+   case TGSI_OPCODE_ADD:
+      kind = TGSI_EXEC_OP_BINARY;
+      op->fn.binary = micro_add;
+      break;
+   case TGSI_OPCODE_MIN:
+      kind = TGSI_EXEC_OP_BINARY;
+      op->fn.binary = micro_min;
+      break;
+   case TGSI_OPCODE_MAX:
+      kind = TGSI_EXEC_OP_BINARY;
+      op->fn.binary = micro_max;
+      break;
+   case TGSI_OPCODE_SLT:
+      kind = TGSI_EXEC_OP_BINARY;
+      op->fn.binary = micro_slt;
+      break;
+   case TGSI_OPCODE_SGE:
+      kind = TGSI_EXEC_OP_BINARY;
+      op->fn.binary = micro_sge;
+      break;
+   case TGSI_OPCODE_MAD:
+      kind = TGSI_EXEC_OP_TRINARY;
+      op->fn.trinary = micro_mad;
+      break;
+   case TGSI_OPCODE_LRP:
+      kind = TGSI_EXEC_OP_TRINARY;
+      op->fn.trinary = micro_lrp;
+      break;
+   case TGSI_OPCODE_DP2:
+      kind = TGSI_EXEC_OP_DP2;
+      break;
+   case TGSI_OPCODE_DP3:
+      kind = TGSI_EXEC_OP_DP3;
+      break;
+   case TGSI_OPCODE_DP4:
+      kind = TGSI_EXEC_OP_DP4;
+      break;
+   default:
+      return;
+   }
+
+   assert(inst->Instruction.NumSrcRegs <= ARRAY_SIZE(op->src));
+   for (i = 0; i < inst->Instruction.NumSrcRegs; i++) {
+      if (!build_op_src(mach, &inst->Src[i], &op->src[i]))
+         return;
+   }
+   if (inst->Instruction.NumDstRegs != 1 ||
+       !build_op_dst(mach, &inst->Dst[0], op))
+      return;
+
+   op->saturate = inst->Instruction.Saturate;
+   op->kind = kind;
+}
+
+static void
+build_ops(struct tgsi_exec_machine *mach)
+{
+   uint i;
+
+   FREE(mach->Ops);
+   /* The extra, generic op stops exec_ops() at the end of the program. */
+   mach->Ops = CALLOC(mach->NumInstructions + 1, sizeof(struct tgsi_exec_op));
+   if (!mach->Ops)
+      return;
+
+   for (i = 0; i < mach->NumInstructions; i++)
+      build_op(mach, &mach->Instructions[i], &mach->Ops[i]);
+}
+
+
+/**
+ * Like fetch_source() with a float datatype, for a pre-decoded operand.
+ * \param tmp  storage for the value if it is not used in place
+ */
+static inline const union tgsi_exec_channel *
+fetch_op_src(const struct tgsi_exec_machine *mach,
+             const struct tgsi_exec_op_src *src,
+             uint chan,
+             union tgsi_exec_channel *tmp)
+{
+   const union tgsi_exec_channel *val = src->chan[chan];
+   uint i;
+
+   if (!val) {
+      uint scalar;
+
+      if (src->imm[chan]) {
+         scalar = *src->imm[chan];
+      } else {
+         const uint *buf = (const uint *)mach->Consts[src->const_buf];
+         const int pos = src->const_pos[chan];
+
+         assert(buf);
+         /* const buffer bounds check */
+         if (pos >= (int) mach->ConstsSize[src->const_buf])
+            scalar = 0;
+         else
+            scalar = buf[pos];
+      }
+      for (i = 0; i < mach->NumLanes; i++)
+         tmp->u[i] = scalar;
+      val = tmp;
+   }
+
+   if (src->absolute) {
+      micro_abs(tmp, val, mach->NumLanes);
+      val = tmp;
+   }
+
+   if (src->negate) {
+      micro_neg(tmp, val, mach->NumLanes);
+      val = tmp;
+   }
+
+   return val;
+}
+
+/**
+ * Like store_dest(), for a pre-decoded operand.
+ */
+static inline void
+store_op_dst(const struct tgsi_exec_machine *mach,
+             const struct tgsi_exec_op *op,
+             uint chan,
+             const union tgsi_exec_channel *val)
+{
+   union tgsi_exec_channel *dst = op->dst[chan];
+   const uint execmask = mach->ExecMask;
+   uint i;
+
+   if (!op->saturate) {
+      if (execmask == TGSI_EXEC_FULL_MASK) {
+         *dst = *val;
+         return;
+      }
+      for (i = 0; i < mach->NumLanes; i++)
+         if (execmask & (1 << i))
+            dst->i[i] = val->i[i];
+   }
+   else {
+      for (i = 0; i < mach->NumLanes; i++)
+         if (execmask & (1 << i)) {
+            if (val->f[i] < 0.0f)
+               dst->f[i] = 0.0f;
+            else if (val->f[i] > 1.0f)
+               dst->f[i] = 1.0f;
+            else
+               dst->i[i] = val->i[i];
+         }
+   }
+}
+
+static inline void
+exec_op_dp(const struct tgsi_exec_machine *mach,
+           const struct tgsi_exec_op *op,
+           uint num_chans,
+           union tgsi_exec_channel *result)
+{
+   union tgsi_exec_channel tmp[2];
+   const union tgsi_exec_channel *arg[2];
+   uint chan;
+
+   arg[0] = fetch_op_src(mach, &op->src[0], TGSI_CHAN_X, &tmp[0]);
+   arg[1] = fetch_op_src(mach, &op->src[1], TGSI_CHAN_X, &tmp[1]);
+   micro_mul(result, arg[0], arg[1], mach->NumLanes);
+
+   for (chan = TGSI_CHAN_Y; chan < num_chans; chan++) {
+      arg[0] = fetch_op_src(mach, &op->src[0], chan, &tmp[0]);
+      arg[1] = fetch_op_src(mach, &op->src[1], chan, &tmp[1]);
+      micro_mad(result, arg[0], arg[1], result, mach->NumLanes);
+   }
+}
+
+/**
+ * Execute pre-decoded ops from mach->pc on, up to the next instruction
+ * that needs exec_instruction().
+ *
+ * Results are computed for all channels before any is stored, like
+ * exec_vector_unary() and friends do, so that a destination may alias
+ * a source.
+ */
+static void
+exec_ops(struct tgsi_exec_machine *mach)
+{
+   const struct tgsi_exec_op *op = &mach->Ops[mach->pc];
+   struct tgsi_exec_vector result;
+   union tgsi_exec_channel tmp[3];
+   const union tgsi_exec_channel *arg[3];
+   uint chan;
+
+#if defined(__GNUC__)
+   /* Threaded dispatch: jump straight from one handler to the next. */
+   static const void *const handlers[TGSI_EXEC_OP_COUNT] = {
+      [TGSI_EXEC_OP_GENERIC] = &&op_generic,
+      [TGSI_EXEC_OP_UNARY] = &&op_unary,
+      [TGSI_EXEC_OP_BINARY] = &&op_binary,
+      [TGSI_EXEC_OP_TRINARY] = &&op_trinary,
+      [TGSI_EXEC_OP_DP2] = &&op_dp2,
+      [TGSI_EXEC_OP_DP3] = &&op_dp3,
+      [TGSI_EXEC_OP_DP4] = &&op_dp4,
+   };
+#define DISPATCH() goto *handlers[op->kind]
+#else
+#define DISPATCH() goto dispatch
+#endif
+
+#define NEXT_OP() do { op++; DISPATCH(); } while (0)
+
+#define STORE_RESULT(vec) \
+   do { \
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) { \
+         if (op->dst[chan]) \
+            store_op_dst(mach, op, chan, (vec)); \
+      } \
+   } while (0)
+
+#if defined(__GNUC__)
+   DISPATCH();
+#else
+dispatch:
+   switch (op->kind) {
+   case TGSI_EXEC_OP_UNARY:   goto op_unary;
+   case TGSI_EXEC_OP_BINARY:  goto op_binary;
+   case TGSI_EXEC_OP_TRINARY: goto op_trinary;
+   case TGSI_EXEC_OP_DP2:     goto op_dp2;
+   case TGSI_EXEC_OP_DP3:     goto op_dp3;
+   case TGSI_EXEC_OP_DP4:     goto op_dp4;
+   default:                   goto op_generic;
+   }
+#endif
+
+op_unary:
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (op->dst[chan]) {
+         arg[0] = fetch_op_src(mach, &op->src[0], chan, &tmp[0]);
+         op->fn.unary(&result.xyzw[chan], arg[0], mach->NumLanes);
+      }
+   }
+   STORE_RESULT(&result.xyzw[chan]);
+   NEXT_OP();
+
+op_binary:
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (op->dst[chan]) {
+         arg[0] = fetch_op_src(mach, &op->src[0], chan, &tmp[0]);
+         arg[1] = fetch_op_src(mach, &op->src[1], chan, &tmp[1]);
+         op->fn.binary(&result.xyzw[chan], arg[0], arg[1], mach->NumLanes);
+      }
+   }
+   STORE_RESULT(&result.xyzw[chan]);
+   NEXT_OP();
+
+op_trinary:
+   for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+      if (op->dst[chan]) {
+         arg[0] = fetch_op_src(mach, &op->src[0], chan, &tmp[0]);
+         arg[1] = fetch_op_src(mach, &op->src[1], chan, &tmp[1]);
+         arg[2] = fetch_op_src(mach, &op->src[2], chan, &tmp[2]);
+         op->fn.trinary(&result.xyzw[chan], arg[0], arg[1], arg[2],
+                         mach->NumLanes);
+      }
+   }
+   STORE_RESULT(&result.xyzw[chan]);
+   NEXT_OP();
+
+op_dp2:
+   exec_op_dp(mach, op, 2, &result.xyzw[0]);
+   STORE_RESULT(&result.xyzw[0]);
+   NEXT_OP();
+
+op_dp3:
+   exec_op_dp(mach, op, 3, &result.xyzw[0]);
+   STORE_RESULT(&result.xyzw[0]);
+   NEXT_OP();
+
+op_dp4:
+   exec_op_dp(mach, op, 4, &result.xyzw[0]);
+   STORE_RESULT(&result.xyzw[0]);
+   NEXT_OP();
+
+op_generic:
+   mach->pc = op - mach->Ops;
+
+#undef STORE_RESULT
+#undef NEXT_OP
+#undef DISPATCH
+}
+
 static void
 tgsi_exec_machine_setup_masks(struct tgsi_exec_machine *mach)
 {
-   uint default_mask = 0xf;
+   uint default_mask = TGSI_EXEC_FULL_MASK >> (TGSI_EXEC_WIDTH - mach->NumLanes);
 
    mach->Temps[TEMP_KILMASK_I].xyzw[TEMP_KILMASK_C].u[0] = 0;
    mach->Temps[TEMP_OUTPUT_I].xyzw[TEMP_OUTPUT_C].u[0] = 0;
@@ -6368,6 +6744,12 @@ tgsi_exec_machine_run( struct tgsi_exec_machine *mach, int start_pc )
          tgsi_dump_instruction(&mach->Instructions[mach->pc], inst++);
 #endif
 
+#if !DEBUG_EXECUTION
+         if (mach->Ops) {
+            exec_ops(mach);
+         }
+#endif
+
          assert(mach->pc < (int) mach->NumInstructions);
          barrier_hit = exec_instruction(mach, mach->Instructions + mach->pc, &mach->pc);
 
@@ -6382,7 +6764,7 @@ tgsi_exec_machine_run( struct tgsi_exec_machine *mach, int start_pc )
 
                memcpy(&temps[i], &mach->Temps[i], sizeof(temps[i]));
                debug_printf("TEMP[%2u] = ", i);
-               for (j = 0; j < 4; j++) {
+               for (j = 0; j < mach->NumLanes; j++) {
                   if (j > 0) {
                      debug_printf("           ");
                   }
@@ -6401,7 +6783,7 @@ tgsi_exec_machine_run( struct tgsi_exec_machine *mach, int start_pc )
 
                   memcpy(&outputs[i], &mach->Outputs[i], sizeof(outputs[i]));
                   debug_printf("OUT[%2u] =  ", i);
-                  for (j = 0; j < 4; j++) {
+                  for (j = 0; j < mach->NumLanes; j++) {
                      if (j > 0) {
                         debug_printf("           ");
                      }
@@ -45,6 +45,24 @@ extern "C" {
 #define TGSI_NUM_CHANNELS 4  /* R,G,B,A */
 #define TGSI_QUAD_SIZE    4  /* 4 pixel/quad */
 
+/**
+ * Number of quads executed by each tgsi_exec_machine_run() call.
+ *
+ * Every decoded instruction is applied to TGSI_EXEC_WIDTH lanes at once so
+ * that the cost of interpreting it is shared by several quads.  Lane
+ * 4 * q + i holds pixel i of quad q.  Execution masks are 32 bits wide, so
+ * TGSI_EXEC_WIDTH may not exceed 32.
+ */
+#ifndef TGSI_EXEC_NUM_QUADS
+#define TGSI_EXEC_NUM_QUADS 4
+#endif
+
+#define TGSI_EXEC_WIDTH   (TGSI_QUAD_SIZE * TGSI_EXEC_NUM_QUADS)
+
+/** Execution mask with every lane enabled */
+#define TGSI_EXEC_FULL_MASK \
+   (TGSI_EXEC_WIDTH == 32 ? ~0u : (1u << TGSI_EXEC_WIDTH) - 1)
+
 #define TGSI_FOR_EACH_CHANNEL( CHAN )\
    for (CHAN = 0; CHAN < TGSI_NUM_CHANNELS; CHAN++)
 
@@ -73,13 +91,13 @@ extern "C" {
   */
 union tgsi_exec_channel
 {
-   float    f[TGSI_QUAD_SIZE];
-   int      i[TGSI_QUAD_SIZE];
-   unsigned u[TGSI_QUAD_SIZE];
+   float    f[TGSI_EXEC_WIDTH];
+   int      i[TGSI_EXEC_WIDTH];
+   unsigned u[TGSI_EXEC_WIDTH];
 };
 
 /**
-  * A vector[RGBA] of channels[4 pixels]
+  * A vector[RGBA] of channels[TGSI_EXEC_WIDTH pixels]
   */
 struct tgsi_exec_vector
 {
@@ -322,6 +340,7 @@ enum tgsi_break_type {
 typedef float float4[4];
 
 struct tgsi_exec_machine;
+struct tgsi_exec_op;
 
 typedef void (* apply_sample_offset_func)(
    const struct tgsi_exec_machine *mach,
@@ -383,6 +402,9 @@ struct tgsi_exec_machine
    void                          *LocalMem;
    unsigned                      LocalMemSize;
 
+   /** Lanes executed by each run, TGSI_QUAD_SIZE or TGSI_EXEC_WIDTH */
+   uint NumLanes;
+
    /* See GLSL 4.50 specification for definition of helper invocations */
    uint NonHelperMask;  /**< non-helpers */
    /* Conditional execution masks */
@@ -432,6 +454,9 @@ struct tgsi_exec_machine
    struct tgsi_full_instruction *Instructions;
    uint NumInstructions;
 
+   /** Instructions pre-decoded for direct execution, see exec_ops() */
+   struct tgsi_exec_op *Ops;
+
    struct tgsi_full_declaration *Declarations;
    uint NumDeclarations;
 
@@ -467,10 +467,17 @@ tc_get_query_result_resource(struct pipe_context *_pipe,
                              struct pipe_resource *resource, unsigned offset)
 {
    struct threaded_context *tc = threaded_context(_pipe);
+   struct threaded_resource *tres = threaded_resource(resource);
    struct tc_query_result_resource *p =
       tc_add_struct_typed_call(tc, TC_CALL_get_query_result_resource,
                                tc_query_result_resource);
 
+   /* The driver writes the result into the buffer, so a later mapping of
+    * that range mustn't be made unsynchronized.
+    */
+   util_range_add(&tres->b, &tres->valid_buffer_range, offset,
+                  offset + (result_type <= PIPE_QUERY_TYPE_U32 ? 4 : 8));
+
    p->query = query;
    p->wait = wait;
    p->result_type = result_type;
@@ -38,8 +38,10 @@
 #include "util/u_memory.h"
 #include "util/simple_list.h"
 #include "util/u_upload_mgr.h"
+#include "util/u_threaded_context.h"
 #include "lp_clear.h"
 #include "lp_context.h"
+#include "lp_fence.h"
 #include "lp_flush.h"
 #include "lp_perf.h"
 #include "lp_state.h"
@@ -55,9 +57,10 @@
 static void llvmpipe_destroy( struct pipe_context *pipe )
 {
    struct llvmpipe_context *llvmpipe = llvmpipe_context( pipe );
+   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
    uint i;
 
-   lp_print_counters();
+   lp_print_counters(llvmpipe_screen(pipe->screen)->rast);
 
    if (llvmpipe->csctx) {
       lp_csctx_destroy(llvmpipe->csctx);
@@ -107,6 +110,10 @@ static void llvmpipe_destroy( struct pipe_context *pipe )
    llvmpipe->context = NULL;
 
    align_free( llvmpipe );
+
+   mtx_lock(&screen->ctx_mutex);
+   screen->num_contexts--;
+   mtx_unlock(&screen->ctx_mutex);
 }
 
 static void
@@ -118,6 +125,22 @@ do_flush( struct pipe_context *pipe,
 }
 
 
+/**
+ * Scenes from all contexts are rasterized in submission order, but this
+ * context may touch memory on the CPU before its own scenes run, so do a
+ * CPU wait.
+ */
+static void
+llvmpipe_fence_server_sync(struct pipe_context *pipe,
+                           struct pipe_fence_handle *fence)
+{
+   struct lp_fence *f = (struct lp_fence *) fence;
+
+   if (f && !lp_fence_signalled(f))
+      lp_fence_wait(f);
+}
+
+
 static void
 llvmpipe_render_condition(struct pipe_context *pipe,
                           struct pipe_query *query,
@@ -173,14 +196,25 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
 
    make_empty_list(&llvmpipe->cs_variants_list);
 
+   /* shade once per pixel until sample shading is requested */
+   llvmpipe->min_samples = 1;
+
    llvmpipe->pipe.screen = screen;
    llvmpipe->pipe.priv = priv;
 
+   /* Before this context can touch any buffer, see
+    * llvmpipe_replace_buffer_storage().
+    */
+   mtx_lock(&llvmpipe_screen(screen)->ctx_mutex);
+   llvmpipe_screen(screen)->num_contexts++;
+   mtx_unlock(&llvmpipe_screen(screen)->ctx_mutex);
+
    /* Init the pipe context methods */
    llvmpipe->pipe.destroy = llvmpipe_destroy;
    llvmpipe->pipe.set_framebuffer_state = llvmpipe_set_framebuffer_state;
    llvmpipe->pipe.clear = llvmpipe_clear;
    llvmpipe->pipe.flush = do_flush;
+   llvmpipe->pipe.fence_server_sync = llvmpipe_fence_server_sync;
    llvmpipe->pipe.texture_barrier = llvmpipe_texture_barrier;
 
    llvmpipe->pipe.render_condition = llvmpipe_render_condition;
@@ -258,6 +292,9 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
    draw_wide_point_threshold(llvmpipe->draw, 10000.0);
    draw_wide_line_threshold(llvmpipe->draw, 10000.0);
 
+   draw_set_vs_queue(llvmpipe->draw, &llvmpipe_screen(screen)->vs_queue,
+                     llvmpipe_screen(screen)->num_vs_threads);
+
    lp_reset_counters();
 
    /* If llvmpipe_set_scissor_states() is never called, we still need to
@@ -266,7 +303,19 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
     */
    llvmpipe->dirty |= LP_NEW_SCISSOR;
 
-   return &llvmpipe->pipe;
+   if (!(flags & PIPE_CONTEXT_PREFER_THREADED) ||
+       (flags & PIPE_CONTEXT_COMPUTE_ONLY))
+      return &llvmpipe->pipe;
+
+   /* Queue the context calls to a driver thread, so the application thread
+    * can go on while state is validated, vertices are shaded and triangles
+    * are binned.  Flushes are synchronous, as fences are created by the
+    * flush itself.
+    */
+   return threaded_context_create(&llvmpipe->pipe,
+                                  &llvmpipe_screen(screen)->pool_transfers,
+                                  llvmpipe_replace_buffer_storage,
+                                  NULL, NULL);
 
  fail:
    llvmpipe_destroy(&llvmpipe->pipe);
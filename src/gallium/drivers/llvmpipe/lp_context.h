@@ -108,6 +108,10 @@ struct llvmpipe_context {
 
    unsigned active_primgen_queries;
 
+   /** Shader variants compiled by LLVM, for the driver queries */
+   uint64_t nr_llvm_compiles;
+   uint64_t llvm_compile_time;  /**< total, in microseconds */
+
    bool queries_disabled;
 
    unsigned dirty; /**< Mask of LP_NEW_x flags */
@@ -155,6 +159,10 @@ struct llvmpipe_context {
    struct lp_fs_variant_list_item fs_variants_list;
    unsigned nr_fs_variants;
    unsigned nr_fs_instrs;
+   unsigned nr_fs_variants_pending;
+
+   /** The fragment shader variant bound to the setup module */
+   struct lp_fragment_shader_variant *fs_variant;
 
    struct lp_setup_variant_list_item setup_variants_list;
    unsigned nr_setup_variants;
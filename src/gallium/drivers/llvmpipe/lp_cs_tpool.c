@@ -28,10 +28,45 @@
  * based on threadpool.c but modified heavily to be compute shader tuned.
  */
 
+#include "util/u_atomic.h"
+#include "util/u_math.h"
 #include "util/u_thread.h"
 #include "util/u_memory.h"
+#include "gallivm/lp_bld_format.h"
 #include "lp_cs_tpool.h"
 
+/* How many chunks to cut a task into per thread.  More chunks even out
+ * iterations of different cost, fewer keep the threads from contending
+ * on iter_start.
+ */
+#define LP_CS_TPOOL_CLAIMS_PER_THREAD 8
+
+static void
+lp_cs_tpool_task_unref(struct lp_cs_tpool_task *task)
+{
+   if (p_atomic_dec_zero(&task->refcount))
+      util_queue_fence_signal(&task->finish);
+}
+
+/**
+ * Forget the cached texture blocks, textures may have changed since the
+ * previous task.
+ */
+static void
+lp_cs_local_mem_begin_task(struct lp_cs_local_mem *lmem)
+{
+   if (lmem->cache)
+      memset(lmem->cache->cache_tags, 0, sizeof(lmem->cache->cache_tags));
+}
+
+static void
+lp_cs_local_mem_release(struct lp_cs_local_mem *lmem)
+{
+   FREE(lmem->local_mem_ptr);
+   align_free(lmem->cache);
+   lp_build_coro_frame_pool_release(&lmem->coro_frames);
+}
+
 static int
 lp_cs_tpool_worker(void *data)
 {
@@ -52,20 +87,39 @@ lp_cs_tpool_worker(void *data)
 
       task = list_first_entry(&pool->workqueue, struct lp_cs_tpool_task,
                               list);
-      unsigned this_iter = task->iter_start++;
+      p_atomic_inc(&task->refcount);
+      mtx_unlock(&pool->m);
 
-      if (task->iter_start == task->iter_total)
-         list_del(&task->list);
+      lp_cs_local_mem_begin_task(&lmem);
 
-      mtx_unlock(&pool->m);
-      task->work(task->data, this_iter, &lmem);
+      while (1) {
+         unsigned start = p_atomic_add_return(&task->iter_start,
+                                              task->iter_per_claim) -
+                          task->iter_per_claim;
+         unsigned end;
+
+         if (start >= task->iter_total)
+            break;
+
+         end = MIN2(start + task->iter_per_claim, task->iter_total);
+         for (unsigned i = start; i < end; i++)
+            task->work(task->data, i, &lmem);
+
+         if (p_atomic_add_return(&task->iter_finished, end - start) ==
+             task->iter_total)
+            lp_cs_tpool_task_unref(task);
+      }
+
+      /* All iterations are claimed, keep other threads from picking up
+       * the task before letting go of it.
+       */
       mtx_lock(&pool->m);
-      task->iter_finished++;
-      if (task->iter_finished == task->iter_total)
-         cnd_broadcast(&task->finish);
+      if (!list_is_empty(&task->list))
+         list_delinit(&task->list);
+      lp_cs_tpool_task_unref(task);
    }
    mtx_unlock(&pool->m);
-   FREE(lmem.local_mem_ptr);
+   lp_cs_local_mem_release(&lmem);
    return 0;
 }
 
@@ -81,10 +135,23 @@ lp_cs_tpool_create(unsigned num_threads)
    cnd_init(&pool->new_work);
 
    list_inithead(&pool->workqueue);
-   assert (num_threads <= LP_MAX_THREADS);
-   pool->num_threads = num_threads;
-   for (unsigned i = 0; i < num_threads; i++)
+
+   if (num_threads) {
+      pool->threads = CALLOC(num_threads, sizeof(pool->threads[0]));
+      if (!pool->threads) {
+         cnd_destroy(&pool->new_work);
+         mtx_destroy(&pool->m);
+         FREE(pool);
+         return NULL;
+      }
+   }
+
+   for (unsigned i = 0; i < num_threads; i++) {
       pool->threads[i] = u_thread_create(lp_cs_tpool_worker, pool);
+      if (!pool->threads[i])
+         break;
+      pool->num_threads++;
+   }
    return pool;
 }
 
@@ -105,6 +172,7 @@ lp_cs_tpool_destroy(struct lp_cs_tpool *pool)
 
    cnd_destroy(&pool->new_work);
    mtx_destroy(&pool->m);
+   FREE(pool->threads);
    FREE(pool);
 }
 
@@ -113,14 +181,16 @@ lp_cs_tpool_queue_task(struct lp_cs_tpool *pool,
                        lp_cs_tpool_task_func work, void *data, int num_iters)
 {
    struct lp_cs_tpool_task *task;
+   unsigned num_claims;
 
-   if (pool->num_threads == 0) {
+   if (pool->num_threads == 0 || num_iters == 0) {
       struct lp_cs_local_mem lmem;
 
       memset(&lmem, 0, sizeof(lmem));
       for (unsigned t = 0; t < num_iters; t++) {
          work(data, t, &lmem);
       }
+      lp_cs_local_mem_release(&lmem);
       return NULL;
    }
    task = CALLOC_STRUCT(lp_cs_tpool_task);
@@ -131,13 +201,25 @@ lp_cs_tpool_queue_task(struct lp_cs_tpool *pool,
    task->work = work;
    task->data = data;
    task->iter_total = num_iters;
-   cnd_init(&task->finish);
+   task->iter_per_claim =
+      MAX2(1, num_iters / (pool->num_threads * LP_CS_TPOOL_CLAIMS_PER_THREAD));
+   task->refcount = 1;
+   util_queue_fence_init(&task->finish);
+   util_queue_fence_reset(&task->finish);
+
+   num_claims = DIV_ROUND_UP(num_iters, task->iter_per_claim);
 
    mtx_lock(&pool->m);
 
    list_addtail(&task->list, &pool->workqueue);
 
-   cnd_broadcast(&pool->new_work);
+   /* don't wake up more threads than there are chunks to claim */
+   if (num_claims >= pool->num_threads) {
+      cnd_broadcast(&pool->new_work);
+   } else {
+      for (unsigned i = 0; i < num_claims; i++)
+         cnd_signal(&pool->new_work);
+   }
    mtx_unlock(&pool->m);
    return task;
 }
@@ -151,12 +233,8 @@ lp_cs_tpool_wait_for_task(struct lp_cs_tpool *pool,
    if (!pool || !task)
       return;
 
-   mtx_lock(&pool->m);
-   while (task->iter_finished < task->iter_total)
-      cnd_wait(&task->finish, &pool->m);
-   mtx_unlock(&pool->m);
-
-   cnd_destroy(&task->finish);
+   util_queue_fence_wait(&task->finish);
+   util_queue_fence_destroy(&task->finish);
    FREE(task);
    *task_handle = NULL;
 }
@@ -30,6 +30,10 @@
  * structs with just unique indexes in them.
  * It also supports a local memory support struct to be passed from
  * outside the thread exec function.
+ *
+ * The pool mutex is only taken to find a task.  Threads claim chunks
+ * of its iterations with atomics and the task is completed through a
+ * fence once all iterations are done and all threads have let go of it.
  */
 #ifndef LP_CS_QUEUE
 #define LP_CS_QUEUE
@@ -37,23 +41,32 @@
 #include "pipe/p_compiler.h"
 
 #include "util/u_thread.h"
+#include "util/u_queue.h"
 #include "util/list.h"
 
+#include "gallivm/lp_bld_coro.h"
+
 #include "lp_limits.h"
 
 struct lp_cs_tpool {
    mtx_t m;
    cnd_t new_work;
 
-   thrd_t threads[LP_MAX_THREADS];
+   thrd_t *threads;
    unsigned num_threads;
    struct list_head workqueue;
    bool shutdown;
 };
 
+struct lp_build_format_cache;
+
 struct lp_cs_local_mem {
    unsigned local_size;
    void *local_mem_ptr;
+   /* texture block cache, its tags are cleared for each task */
+   struct lp_build_format_cache *cache;
+   /* coroutine frames of the invocations of a workgroup */
+   struct lp_build_coro_frame_pool coro_frames;
 };
 
 typedef void (*lp_cs_tpool_task_func)(void *data, int iter_idx, struct lp_cs_local_mem *lmem);
@@ -62,10 +75,15 @@ struct lp_cs_tpool_task {
    lp_cs_tpool_task_func work;
    void *data;
    struct list_head list;
-   cnd_t finish;
+   struct util_queue_fence finish;
    unsigned iter_total;
-   unsigned iter_start;
-   unsigned iter_finished;
+   unsigned iter_per_claim; /* iterations claimed at once by a thread */
+   unsigned iter_start;     /* next unclaimed iteration, atomic */
+   unsigned iter_finished;  /* atomic */
+   /* One reference for the unfinished iterations plus one per thread
+    * working on the task, the last one to let go signals finish.
+    */
+   unsigned refcount;
 };
 
 struct lp_cs_tpool *lp_cs_tpool_create(unsigned num_threads);
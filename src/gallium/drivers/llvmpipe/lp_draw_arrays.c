@@ -37,6 +37,8 @@
 #include "util/u_prim.h"
 
 #include "lp_context.h"
+#include "lp_flush.h"
+#include "lp_setup.h"
 #include "lp_state.h"
 #include "lp_query.h"
 
@@ -69,6 +71,31 @@ llvmpipe_draw_vbo(struct pipe_context *pipe, const struct pipe_draw_info *info)
    if (lp->dirty)
       llvmpipe_update_derived( lp );
 
+   if (lp->nr_fs_variants_pending)
+      llvmpipe_update_pending_fs_variants(lp);
+
+   /*
+    * Vertex processing runs on this thread, so it must not race with
+    * scenes which are still being rasterized.
+    */
+   llvmpipe_wait_shader_resources(lp, PIPE_SHADER_VERTEX);
+   llvmpipe_wait_shader_resources(lp, PIPE_SHADER_GEOMETRY);
+   llvmpipe_wait_shader_resources(lp, PIPE_SHADER_TESS_CTRL);
+   llvmpipe_wait_shader_resources(lp, PIPE_SHADER_TESS_EVAL);
+   for (i = 0; i < lp->num_so_targets; i++) {
+      if (lp->so_targets[i])
+         lp_setup_wait_for_resource(lp->setup,
+                                    lp->so_targets[i]->target.buffer, FALSE);
+   }
+   for (i = 0; i < lp->num_vertex_buffers; i++) {
+      if (!lp->vertex_buffer[i].is_user_buffer &&
+          lp->vertex_buffer[i].buffer.resource)
+         lp_setup_wait_for_resource(lp->setup,
+                                    lp->vertex_buffer[i].buffer.resource, TRUE);
+   }
+   if (info->index_size && !info->has_user_indices)
+      lp_setup_wait_for_resource(lp->setup, info->index.resource, TRUE);
+
    /*
     * Map vertex buffers
     */
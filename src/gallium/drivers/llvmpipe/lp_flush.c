@@ -131,3 +131,45 @@ llvmpipe_flush_resource(struct pipe_context *pipe,
 
    return TRUE;
 }
+
+
+/**
+ * Wait for queued scenes which still use resources bound to a shader
+ * stage that executes on the context thread (vertex processing and
+ * compute), since those access memory immediately rather than from
+ * the rasterizer threads.
+ */
+void
+llvmpipe_wait_shader_resources(struct llvmpipe_context *llvmpipe,
+                               enum pipe_shader_type shader)
+{
+   struct lp_setup_context *setup = llvmpipe->setup;
+   unsigned i;
+
+   if (!lp_setup_has_queued_scenes(setup))
+      return;
+
+   for (i = 0; i < ARRAY_SIZE(llvmpipe->constants[shader]); i++) {
+      struct pipe_resource *buffer = llvmpipe->constants[shader][i].buffer;
+      if (buffer)
+         lp_setup_wait_for_resource(setup, buffer, TRUE);
+   }
+
+   for (i = 0; i < llvmpipe->num_sampler_views[shader]; i++) {
+      struct pipe_sampler_view *view = llvmpipe->sampler_views[shader][i];
+      if (view && view->texture)
+         lp_setup_wait_for_resource(setup, view->texture, TRUE);
+   }
+
+   for (i = 0; i < ARRAY_SIZE(llvmpipe->ssbos[shader]); i++) {
+      struct pipe_resource *buffer = llvmpipe->ssbos[shader][i].buffer;
+      if (buffer)
+         lp_setup_wait_for_resource(setup, buffer, FALSE);
+   }
+
+   for (i = 0; i < llvmpipe->num_images[shader]; i++) {
+      struct pipe_resource *resource = llvmpipe->images[shader][i].resource;
+      if (resource)
+         lp_setup_wait_for_resource(setup, resource, FALSE);
+   }
+}
@@ -29,10 +29,12 @@
 #define LP_FLUSH_H
 
 #include "pipe/p_compiler.h"
+#include "pipe/p_defines.h"
 
 struct pipe_context;
 struct pipe_fence_handle;
 struct pipe_resource;
+struct llvmpipe_context;
 
 void
 llvmpipe_flush(struct pipe_context *pipe,
@@ -52,4 +54,8 @@ llvmpipe_flush_resource(struct pipe_context *pipe,
                         boolean do_not_block,
                         const char *reason);
 
+void
+llvmpipe_wait_shader_resources(struct llvmpipe_context *llvmpipe,
+                               enum pipe_shader_type shader);
+
 #endif
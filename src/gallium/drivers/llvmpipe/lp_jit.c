@@ -38,8 +38,10 @@
 #include "gallivm/lp_bld_init.h"
 #include "gallivm/lp_bld_debug.h"
 #include "gallivm/lp_bld_format.h"
+#include "gallivm/lp_bld_sample.h"
 #include "lp_context.h"
 #include "lp_jit.h"
+#include "lp_screen.h"
 
 static LLVMTypeRef
 create_jit_texture_type(struct gallivm_state *gallivm)
@@ -313,17 +315,90 @@ lp_jit_create_types(struct lp_fragment_shader_variant *lp)
 }
 
 
+/**
+ * Create the types the sampling functions shared between fragment and
+ * compute shader variants see their arguments as.  The context only holds
+ * the leading members of lp_jit_context, up to the samplers, which
+ * lp_jit_cs_context shares; the thread data only the texel cache.
+ */
+static void
+lp_jit_create_sample_func_types(struct gallivm_state *gallivm,
+                                LLVMTypeRef *context_ptr_type,
+                                LLVMTypeRef *thread_data_ptr_type)
+{
+   LLVMContextRef lc = gallivm->context;
+   LLVMTypeRef texture_type, sampler_type;
+
+   texture_type = create_jit_texture_type(gallivm);
+   sampler_type = create_jit_sampler_type(gallivm);
+
+   {
+      LLVMTypeRef elem_types[LP_JIT_CTX_SAMPLERS + 1];
+      LLVMTypeRef context_type;
+
+      elem_types[LP_JIT_CTX_CONSTANTS] =
+         LLVMArrayType(LLVMPointerType(LLVMFloatTypeInContext(lc), 0), LP_MAX_TGSI_CONST_BUFFERS);
+      elem_types[LP_JIT_CTX_NUM_CONSTANTS] =
+            LLVMArrayType(LLVMInt32TypeInContext(lc), LP_MAX_TGSI_CONST_BUFFERS);
+      elem_types[LP_JIT_CTX_TEXTURES] = LLVMArrayType(texture_type,
+                                                      PIPE_MAX_SHADER_SAMPLER_VIEWS);
+      elem_types[LP_JIT_CTX_SAMPLERS] = LLVMArrayType(sampler_type,
+                                                      PIPE_MAX_SAMPLERS);
+      context_type = LLVMStructTypeInContext(lc, elem_types,
+                                             ARRAY_SIZE(elem_types), 0);
+
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_context, textures,
+                             gallivm->target, context_type,
+                             LP_JIT_CTX_TEXTURES);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_context, samplers,
+                             gallivm->target, context_type,
+                             LP_JIT_CTX_SAMPLERS);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_context, textures,
+                             gallivm->target, context_type,
+                             LP_JIT_CS_CTX_TEXTURES);
+      LP_CHECK_MEMBER_OFFSET(struct lp_jit_cs_context, samplers,
+                             gallivm->target, context_type,
+                             LP_JIT_CS_CTX_SAMPLERS);
+
+      *context_ptr_type = LLVMPointerType(context_type, 0);
+   }
+
+   {
+      LLVMTypeRef elem_types[LP_JIT_THREAD_DATA_CACHE + 1];
+      LLVMTypeRef thread_data_type;
+
+      STATIC_ASSERT(offsetof(struct lp_jit_thread_data, cache) ==
+                    offsetof(struct lp_jit_cs_thread_data, cache));
+
+      elem_types[LP_JIT_THREAD_DATA_CACHE] =
+            LLVMPointerType(lp_build_format_cache_type(gallivm), 0);
+      thread_data_type = LLVMStructTypeInContext(lc, elem_types,
+                                                 ARRAY_SIZE(elem_types), 0);
+
+      *thread_data_ptr_type = LLVMPointerType(thread_data_type, 0);
+   }
+}
+
+
 void
 lp_jit_screen_cleanup(struct llvmpipe_screen *screen)
 {
-   /* nothing */
+   lp_sample_func_cache_destroy(screen->sample_funcs);
+   screen->sample_funcs = NULL;
 }
 
 
 boolean
 lp_jit_screen_init(struct llvmpipe_screen *screen)
 {
-   return lp_build_init();
+   if (!lp_build_init())
+      return FALSE;
+
+   if (debug_get_bool_option("LP_SHARED_TEX_FUNCS", TRUE))
+      screen->sample_funcs =
+         lp_sample_func_cache_create(lp_jit_create_sample_func_types);
+
+   return TRUE;
 }
 
 
@@ -354,6 +429,8 @@ lp_jit_create_cs_types(struct lp_compute_shader_variant *lp)
             LLVMPointerType(lp_build_format_cache_type(gallivm), 0);
 
       elem_types[LP_JIT_CS_THREAD_DATA_SHARED] = LLVMPointerType(LLVMInt32TypeInContext(lc), 0);
+      elem_types[LP_JIT_CS_THREAD_DATA_CORO_FRAMES] =
+            LLVMPointerType(LLVMInt8TypeInContext(lc), 0);
       thread_data_type = LLVMStructTypeInContext(lc, elem_types,
                                                  ARRAY_SIZE(elem_types), 0);
 
@@ -44,6 +44,7 @@
 
 
 struct lp_build_format_cache;
+struct lp_build_coro_frame_pool;
 struct lp_fragment_shader_variant;
 struct lp_compute_shader_variant;
 struct llvmpipe_screen;
@@ -286,7 +287,8 @@ enum {
  * @param dady          shader input dady
  * @param color         color buffer
  * @param depth         depth buffer
- * @param mask          mask of visible pixels in block (16-bits per sample)
+ * @param mask          coverage of the block, 16 bits per sample and four
+ *                      samples per word (see LP_RAST_MASK_WORDS)
  * @param thread_data   task thread data
  * @param stride        color buffer row stride in bytes
  * @param depth_stride  depth buffer row stride in bytes
@@ -301,7 +303,7 @@ typedef void
                     const void *dady,
                     uint8_t **color,
                     uint8_t *depth,
-                    uint64_t mask,
+                    const uint64_t *mask,
                     struct lp_jit_thread_data *thread_data,
                     unsigned *stride,
                     unsigned depth_stride,
@@ -313,11 +315,13 @@ struct lp_jit_cs_thread_data
 {
    struct lp_build_format_cache *cache;
    void *shared;
+   struct lp_build_coro_frame_pool *coro_frames;
 };
 
 enum {
    LP_JIT_CS_THREAD_DATA_CACHE = 0,
    LP_JIT_CS_THREAD_DATA_SHARED = 1,
+   LP_JIT_CS_THREAD_DATA_CORO_FRAMES = 2,
    LP_JIT_CS_THREAD_DATA_COUNT
 };
 
@@ -328,6 +332,9 @@ enum {
 #define lp_jit_cs_thread_data_shared(_gallivm, _ptr) \
    lp_build_struct_get(_gallivm, _ptr, LP_JIT_CS_THREAD_DATA_SHARED, "shared")
 
+#define lp_jit_cs_thread_data_coro_frames(_gallivm, _ptr) \
+   lp_build_struct_get(_gallivm, _ptr, LP_JIT_CS_THREAD_DATA_CORO_FRAMES, "coro_frames")
+
 struct lp_jit_cs_context
 {
    const float *constants[LP_MAX_TGSI_CONST_BUFFERS];
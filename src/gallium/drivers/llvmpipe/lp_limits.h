@@ -64,9 +64,7 @@
 #define LP_MAX_HEIGHT (1 << (LP_MAX_TEXTURE_LEVELS - 1))
 #define LP_MAX_WIDTH  (1 << (LP_MAX_TEXTURE_LEVELS - 1))
 
-#define LP_MAX_SAMPLES 4
-
-#define LP_MAX_THREADS 16
+#define LP_MAX_SAMPLES 16
 
 
 /**
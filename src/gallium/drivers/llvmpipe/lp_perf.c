@@ -28,6 +28,7 @@
 #include "util/u_debug.h"
 #include "lp_debug.h"
 #include "lp_perf.h"
+#include "lp_rast.h"
 
 
 
@@ -41,13 +42,21 @@ lp_reset_counters(void)
 }
 
 
+/**
+ * Print lp_count, and the rasterizer's counters of 16x16 and 4x4 blocks,
+ * which are kept per rasterizer thread in all builds.
+ */
 void
-lp_print_counters(void)
+lp_print_counters(struct lp_rasterizer *rast)
 {
    if (LP_DEBUG & DEBUG_COUNTERS) {
+      struct lp_rast_counters rc;
+      uint64_t num_scenes, raster_ns;
       unsigned total_64, total_16, total_4;
       float p1, p2, p3, p4, p5, p6;
 
+      lp_rast_get_counters(rast, -1, &rc, &num_scenes, &raster_ns);
+
       debug_printf("llvmpipe: nr_triangles:                 %9u\n", lp_count.nr_tris);
       debug_printf("llvmpipe: nr_culled_triangles:          %9u\n", lp_count.nr_culled_tris);
 
@@ -70,34 +79,38 @@ lp_print_counters(void)
       debug_printf("llvmpipe:   nr_partially_covered_64x64: %9u (%3.0f%% of %u)\n", lp_count.nr_partially_covered_64, p3, total_64);
       debug_printf("llvmpipe:   nr_empty_64x64:             %9u (%3.0f%% of %u)\n", lp_count.nr_empty_64, p1, total_64);
 
-      total_16 = (lp_count.nr_empty_16 + 
-                  lp_count.nr_fully_covered_16 +
-                  lp_count.nr_partially_covered_16);
+      total_16 = ((unsigned) rc.nr_empty_16 + 
+                  (unsigned) rc.nr_fully_covered_16 +
+                  (unsigned) rc.nr_partially_covered_16);
 
-      p1 = 100.0 * (float) lp_count.nr_empty_16 / (float) total_16;
-      p2 = 100.0 * (float) lp_count.nr_fully_covered_16 / (float) total_16;
-      p3 = 100.0 * (float) lp_count.nr_partially_covered_16 / (float) total_16;
+      p1 = 100.0 * (float) rc.nr_empty_16 / (float) total_16;
+      p2 = 100.0 * (float) rc.nr_fully_covered_16 / (float) total_16;
+      p3 = 100.0 * (float) rc.nr_partially_covered_16 / (float) total_16;
 
       debug_printf("llvmpipe: nr_16x16:                     %9u\n", total_16);
-      debug_printf("llvmpipe:   nr_fully_covered_16x16:     %9u (%3.0f%% of %u)\n", lp_count.nr_fully_covered_16, p2, total_16);
-      debug_printf("llvmpipe:   nr_partially_covered_16x16: %9u (%3.0f%% of %u)\n", lp_count.nr_partially_covered_16, p3, total_16);
-      debug_printf("llvmpipe:   nr_empty_16x16:             %9u (%3.0f%% of %u)\n", lp_count.nr_empty_16, p1, total_16);
+      debug_printf("llvmpipe:   nr_fully_covered_16x16:     %9u (%3.0f%% of %u)\n", (unsigned) rc.nr_fully_covered_16, p2, total_16);
+      debug_printf("llvmpipe:   nr_partially_covered_16x16: %9u (%3.0f%% of %u)\n", (unsigned) rc.nr_partially_covered_16, p3, total_16);
+      debug_printf("llvmpipe:   nr_empty_16x16:             %9u (%3.0f%% of %u)\n", (unsigned) rc.nr_empty_16, p1, total_16);
 
-      total_4 = (lp_count.nr_empty_4 +
-                 lp_count.nr_fully_covered_4 +
-                 lp_count.nr_partially_covered_4);
+      total_4 = ((unsigned) rc.nr_empty_4 +
+                 (unsigned) rc.nr_fully_covered_4 +
+                 (unsigned) rc.nr_partially_covered_4);
 
-      p1 = 100.0 * (float) lp_count.nr_empty_4 / (float) total_4;
-      p2 = 100.0 * (float) lp_count.nr_fully_covered_4 / (float) total_4;
-      p3 = 100.0 * (float) lp_count.nr_partially_covered_4 / (float) total_4;
+      p1 = 100.0 * (float) rc.nr_empty_4 / (float) total_4;
+      p2 = 100.0 * (float) rc.nr_fully_covered_4 / (float) total_4;
+      p3 = 100.0 * (float) rc.nr_partially_covered_4 / (float) total_4;
       p4 = 100.0 * (float) lp_count.nr_non_empty_4 / (float) total_4;
 
       debug_printf("llvmpipe: nr_tri_4x4:                   %9u\n", total_4);
-      debug_printf("llvmpipe:   nr_fully_covered_4x4:       %9u (%3.0f%% of %u)\n", lp_count.nr_fully_covered_4, p2, total_4);
-      debug_printf("llvmpipe:   nr_partially_covered_4x4:   %9u (%3.0f%% of %u)\n", lp_count.nr_partially_covered_4, p3, total_4);
-      debug_printf("llvmpipe:   nr_empty_4x4:               %9u (%3.0f%% of %u)\n", lp_count.nr_empty_4, p1, total_4);
+      debug_printf("llvmpipe:   nr_fully_covered_4x4:       %9u (%3.0f%% of %u)\n", (unsigned) rc.nr_fully_covered_4, p2, total_4);
+      debug_printf("llvmpipe:   nr_partially_covered_4x4:   %9u (%3.0f%% of %u)\n", (unsigned) rc.nr_partially_covered_4, p3, total_4);
+      debug_printf("llvmpipe:   nr_empty_4x4:               %9u (%3.0f%% of %u)\n", (unsigned) rc.nr_empty_4, p1, total_4);
       debug_printf("llvmpipe:   nr_non_empty_4x4:           %9u (%3.0f%% of %u)\n", lp_count.nr_non_empty_4, p4, total_4);
 
+      debug_printf("llvmpipe: nr_hiz_rejected_64x64:        %9u\n", (unsigned) rc.nr_hiz_rejected_64);
+      debug_printf("llvmpipe: nr_hiz_rejected_16x16:        %9u\n", (unsigned) rc.nr_hiz_rejected_16);
+      debug_printf("llvmpipe: nr_hiz_rejected_4x4:          %9u\n", (unsigned) rc.nr_hiz_rejected_4);
+
       debug_printf("llvmpipe: nr_color_tile_clear:          %9u\n", lp_count.nr_color_tile_clear);
       debug_printf("llvmpipe: nr_color_tile_load:           %9u\n", lp_count.nr_color_tile_load);
       debug_printf("llvmpipe: nr_color_tile_store:          %9u\n", lp_count.nr_color_tile_store);
@@ -49,12 +49,6 @@ struct lp_counters
    unsigned nr_pure_shade_64;
    unsigned nr_shade_64;
    unsigned nr_shade_opaque_64;
-   unsigned nr_empty_16;
-   unsigned nr_fully_covered_16;
-   unsigned nr_partially_covered_16;
-   unsigned nr_empty_4;
-   unsigned nr_fully_covered_4;
-   unsigned nr_partially_covered_4;
    unsigned nr_non_empty_4;
    unsigned nr_llvm_compiles;
    int64_t llvm_compile_time;  /**< total, in microseconds */
@@ -68,6 +62,45 @@ struct lp_counters
 extern struct lp_counters lp_count;
 
 
+/**
+ * Counters of a rasterizer thread.  Unlike lp_count these are collected
+ * in all builds and exposed as driver queries, see lp_query.c.  Each
+ * thread only touches its own copy, so counting is a plain increment.
+ */
+struct lp_rast_counters
+{
+   uint64_t nr_empty_16;
+   uint64_t nr_partially_covered_16;
+   uint64_t nr_fully_covered_16;
+   uint64_t nr_empty_4;
+   uint64_t nr_partially_covered_4;
+   uint64_t nr_fully_covered_4;
+   uint64_t nr_hiz_rejected_64;
+   uint64_t nr_hiz_rejected_16;
+   uint64_t nr_hiz_rejected_4;
+   uint64_t nr_tex_cache_access;  /**< texels fetched through the block cache */
+   uint64_t nr_tex_cache_miss;    /**< blocks decoded into the block cache */
+   uint64_t busy_ns;  /**< time spent executing jobs */
+   uint64_t idle_ns;  /**< time spent without work while a scene ran */
+};
+
+
+/**
+ * Counters of a setup context, collected in all builds like
+ * lp_rast_counters.
+ */
+struct lp_setup_counters
+{
+   uint64_t nr_empty_64;
+   uint64_t nr_partially_covered_64;
+   uint64_t nr_fully_covered_64;
+   uint64_t nr_shade_64;
+   uint64_t nr_shade_opaque_64;
+   uint64_t nr_scenes;
+   uint64_t binning_ns;  /**< wall time from first command to flush */
+};
+
+
 /** Increment the named counter (only for debug builds) */
 #ifdef DEBUG
 #define LP_COUNT(counter) lp_count.counter++
@@ -80,12 +113,39 @@ extern struct lp_counters lp_count;
 #endif
 
 
+/**
+ * Increment the named counter for binning into scene.  Forks of a scene
+ * bin on other threads, so they count on their own, see lp_scene_join().
+ */
+#ifdef DEBUG
+#define LP_SCENE_COUNT(scene, counter) \
+   do { \
+      if ((scene)->parent) \
+         (scene)->count.counter++; \
+      else \
+         lp_count.counter++; \
+   } while (0)
+#define LP_SCENE_COUNT_ADD(scene, counter, incr) \
+   do { \
+      if ((scene)->parent) \
+         (scene)->count.counter += (incr); \
+      else \
+         lp_count.counter += (incr); \
+   } while (0)
+#else
+#define LP_SCENE_COUNT(scene, counter) do {} while (0)
+#define LP_SCENE_COUNT_ADD(scene, counter, incr) (void)(incr)
+#endif
+
+
 extern void
 lp_reset_counters(void);
 
 
+struct lp_rasterizer;
+
 extern void
-lp_print_counters(void);
+lp_print_counters(struct lp_rasterizer *rast);
 
 
 #endif /* LP_PERF_H */
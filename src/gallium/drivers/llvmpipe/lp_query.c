@@ -32,6 +32,7 @@
 
 #include "draw/draw_context.h"
 #include "pipe/p_defines.h"
+#include "util/u_atomic.h"
 #include "util/u_memory.h"
 #include "util/os_time.h"
 #include "lp_context.h"
@@ -41,6 +42,287 @@
 #include "lp_screen.h"
 #include "lp_state.h"
 #include "lp_rast.h"
+#include "lp_setup.h"
+#include "lp_perf.h"
+
+
+/**
+ * Driver specific queries, their query type is PIPE_QUERY_DRIVER_SPECIFIC
+ * plus their index here.  They are followed by a busy and an idle time
+ * query for each rasterizer thread.
+ *
+ * The counters are sampled when the query begins and ends, rather than
+ * binned like occlusion queries, so the rasterizer counts only include
+ * the scenes which finished in between.
+ */
+enum lp_driver_query
+{
+   LP_QUERY_EMPTY_TILES,
+   LP_QUERY_PARTIAL_TILES,
+   LP_QUERY_FULL_TILES,
+   LP_QUERY_EMPTY_BLOCKS_16,
+   LP_QUERY_PARTIAL_BLOCKS_16,
+   LP_QUERY_FULL_BLOCKS_16,
+   LP_QUERY_EMPTY_BLOCKS_4,
+   LP_QUERY_PARTIAL_BLOCKS_4,
+   LP_QUERY_FULL_BLOCKS_4,
+   LP_QUERY_HIZ_REJECTED_TILES,
+   LP_QUERY_HIZ_REJECTED_BLOCKS_16,
+   LP_QUERY_HIZ_REJECTED_BLOCKS_4,
+   LP_QUERY_SHADE_TILES,
+   LP_QUERY_SHADE_OPAQUE_TILES,
+   LP_QUERY_SHADE_OPAQUE_RATE,
+   LP_QUERY_TEX_CACHE_ACCESSES,
+   LP_QUERY_TEX_CACHE_MISSES,
+   LP_QUERY_TEX_CACHE_HIT_RATE,
+   LP_QUERY_LLVM_COMPILES,
+   LP_QUERY_LLVM_COMPILE_TIME,
+   LP_QUERY_SCENES,
+   LP_QUERY_SCENE_BINNING_TIME,
+   LP_QUERY_SCENE_RASTER_TIME,
+   LP_QUERY_THREAD_TIMES
+};
+
+#define COUNT(name) \
+   { name, PIPE_DRIVER_QUERY_TYPE_UINT64, PIPE_DRIVER_QUERY_RESULT_TYPE_CUMULATIVE }
+
+/**
+ * Averages and percentages are computed over the query's interval, from
+ * samples of a numerator and a denominator.  Times are sampled in
+ * nanoseconds.
+ */
+static const struct {
+   const char *name;
+   enum pipe_driver_query_type type;
+   enum pipe_driver_query_result_type result_type;
+} lp_driver_queries[LP_QUERY_THREAD_TIMES] = {
+   [LP_QUERY_EMPTY_TILES] = COUNT("empty-tiles"),
+   [LP_QUERY_PARTIAL_TILES] = COUNT("partial-tiles"),
+   [LP_QUERY_FULL_TILES] = COUNT("full-tiles"),
+   [LP_QUERY_EMPTY_BLOCKS_16] = COUNT("empty-blocks-16"),
+   [LP_QUERY_PARTIAL_BLOCKS_16] = COUNT("partial-blocks-16"),
+   [LP_QUERY_FULL_BLOCKS_16] = COUNT("full-blocks-16"),
+   [LP_QUERY_EMPTY_BLOCKS_4] = COUNT("empty-blocks-4"),
+   [LP_QUERY_PARTIAL_BLOCKS_4] = COUNT("partial-blocks-4"),
+   [LP_QUERY_FULL_BLOCKS_4] = COUNT("full-blocks-4"),
+   [LP_QUERY_HIZ_REJECTED_TILES] = COUNT("hiz-rejected-tiles"),
+   [LP_QUERY_HIZ_REJECTED_BLOCKS_16] = COUNT("hiz-rejected-blocks-16"),
+   [LP_QUERY_HIZ_REJECTED_BLOCKS_4] = COUNT("hiz-rejected-blocks-4"),
+   [LP_QUERY_SHADE_TILES] = COUNT("shade-tiles"),
+   [LP_QUERY_SHADE_OPAQUE_TILES] = COUNT("shade-opaque-tiles"),
+   [LP_QUERY_SHADE_OPAQUE_RATE] = { "shade-opaque-rate",
+      PIPE_DRIVER_QUERY_TYPE_PERCENTAGE, PIPE_DRIVER_QUERY_RESULT_TYPE_AVERAGE },
+   [LP_QUERY_TEX_CACHE_ACCESSES] = COUNT("tex-cache-accesses"),
+   [LP_QUERY_TEX_CACHE_MISSES] = COUNT("tex-cache-misses"),
+   [LP_QUERY_TEX_CACHE_HIT_RATE] = { "tex-cache-hit-rate",
+      PIPE_DRIVER_QUERY_TYPE_PERCENTAGE, PIPE_DRIVER_QUERY_RESULT_TYPE_AVERAGE },
+   [LP_QUERY_LLVM_COMPILES] = COUNT("llvm-compiles"),
+   [LP_QUERY_LLVM_COMPILE_TIME] = { "llvm-compile-time",
+      PIPE_DRIVER_QUERY_TYPE_MICROSECONDS, PIPE_DRIVER_QUERY_RESULT_TYPE_CUMULATIVE },
+   [LP_QUERY_SCENES] = COUNT("scenes"),
+   [LP_QUERY_SCENE_BINNING_TIME] = { "scene-binning-time",
+      PIPE_DRIVER_QUERY_TYPE_MICROSECONDS, PIPE_DRIVER_QUERY_RESULT_TYPE_AVERAGE },
+   [LP_QUERY_SCENE_RASTER_TIME] = { "scene-raster-time",
+      PIPE_DRIVER_QUERY_TYPE_MICROSECONDS, PIPE_DRIVER_QUERY_RESULT_TYPE_AVERAGE },
+};
+
+#undef COUNT
+
+
+static unsigned
+llvmpipe_num_driver_queries(struct llvmpipe_screen *screen)
+{
+   return LP_QUERY_THREAD_TIMES + 2 * lp_rast_get_num_threads(screen->rast);
+}
+
+
+static int
+llvmpipe_get_driver_query_info(struct pipe_screen *pscreen,
+                               unsigned index,
+                               struct pipe_driver_query_info *info)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(pscreen);
+   unsigned num_queries = llvmpipe_num_driver_queries(screen);
+
+   if (!info)
+      return num_queries;
+
+   if (index >= num_queries)
+      return 0;
+
+   if (index < LP_QUERY_THREAD_TIMES) {
+      info->name = lp_driver_queries[index].name;
+      info->type = lp_driver_queries[index].type;
+      info->result_type = lp_driver_queries[index].result_type;
+   }
+   else {
+      info->name = screen->thread_query_names[index - LP_QUERY_THREAD_TIMES];
+      info->type = PIPE_DRIVER_QUERY_TYPE_MICROSECONDS;
+      info->result_type = PIPE_DRIVER_QUERY_RESULT_TYPE_CUMULATIVE;
+   }
+   info->query_type = PIPE_QUERY_DRIVER_SPECIFIC + index;
+   info->max_value.u64 =
+      info->type == PIPE_DRIVER_QUERY_TYPE_PERCENTAGE ? 100 : 0;
+   info->group_id = 0;
+   info->flags = 0;
+   return 1;
+}
+
+
+static int
+llvmpipe_get_driver_query_group_info(struct pipe_screen *pscreen,
+                                     unsigned index,
+                                     struct pipe_driver_query_group_info *info)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(pscreen);
+
+   if (!info)
+      return 1;
+
+   if (index > 0)
+      return 0;
+
+   info->name = "llvmpipe";
+   info->max_active_queries = llvmpipe_num_driver_queries(screen);
+   info->num_queries = llvmpipe_num_driver_queries(screen);
+   return 1;
+}
+
+
+/**
+ * Sample the counters behind a driver specific query.
+ * \param value  receives the numerator and denominator
+ */
+static void
+llvmpipe_sample_driver_query(struct llvmpipe_context *llvmpipe,
+                             unsigned index, uint64_t value[2])
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(llvmpipe->pipe.screen);
+   const struct lp_setup_counters *setup =
+      lp_setup_get_counters(llvmpipe->setup);
+   struct lp_rast_counters rast;
+   uint64_t num_scenes, raster_ns;
+   int thread = -1;
+
+   if (index >= LP_QUERY_THREAD_TIMES)
+      thread = (index - LP_QUERY_THREAD_TIMES) / 2;
+
+   lp_rast_get_counters(screen->rast, thread, &rast, &num_scenes, &raster_ns);
+
+   value[1] = 0;
+
+   switch (index) {
+   case LP_QUERY_EMPTY_TILES:
+      value[0] = setup->nr_empty_64;
+      break;
+   case LP_QUERY_PARTIAL_TILES:
+      value[0] = setup->nr_partially_covered_64;
+      break;
+   case LP_QUERY_FULL_TILES:
+      value[0] = setup->nr_fully_covered_64;
+      break;
+   case LP_QUERY_EMPTY_BLOCKS_16:
+      value[0] = rast.nr_empty_16;
+      break;
+   case LP_QUERY_PARTIAL_BLOCKS_16:
+      value[0] = rast.nr_partially_covered_16;
+      break;
+   case LP_QUERY_FULL_BLOCKS_16:
+      value[0] = rast.nr_fully_covered_16;
+      break;
+   case LP_QUERY_EMPTY_BLOCKS_4:
+      value[0] = rast.nr_empty_4;
+      break;
+   case LP_QUERY_PARTIAL_BLOCKS_4:
+      value[0] = rast.nr_partially_covered_4;
+      break;
+   case LP_QUERY_FULL_BLOCKS_4:
+      value[0] = rast.nr_fully_covered_4;
+      break;
+   case LP_QUERY_HIZ_REJECTED_TILES:
+      value[0] = rast.nr_hiz_rejected_64;
+      break;
+   case LP_QUERY_HIZ_REJECTED_BLOCKS_16:
+      value[0] = rast.nr_hiz_rejected_16;
+      break;
+   case LP_QUERY_HIZ_REJECTED_BLOCKS_4:
+      value[0] = rast.nr_hiz_rejected_4;
+      break;
+   case LP_QUERY_SHADE_TILES:
+      value[0] = setup->nr_shade_64;
+      break;
+   case LP_QUERY_SHADE_OPAQUE_TILES:
+      value[0] = setup->nr_shade_opaque_64;
+      break;
+   case LP_QUERY_SHADE_OPAQUE_RATE:
+      value[0] = setup->nr_shade_opaque_64;
+      value[1] = setup->nr_shade_opaque_64 + setup->nr_shade_64;
+      break;
+   case LP_QUERY_TEX_CACHE_ACCESSES:
+      value[0] = rast.nr_tex_cache_access;
+      break;
+   case LP_QUERY_TEX_CACHE_MISSES:
+      value[0] = rast.nr_tex_cache_miss;
+      break;
+   case LP_QUERY_TEX_CACHE_HIT_RATE:
+      value[0] = rast.nr_tex_cache_access - rast.nr_tex_cache_miss;
+      value[1] = rast.nr_tex_cache_access;
+      break;
+   case LP_QUERY_LLVM_COMPILES:
+      value[0] = p_atomic_read(&llvmpipe->nr_llvm_compiles);
+      break;
+   case LP_QUERY_LLVM_COMPILE_TIME:
+      value[0] = p_atomic_read(&llvmpipe->llvm_compile_time) * 1000;
+      break;
+   case LP_QUERY_SCENES:
+      value[0] = num_scenes;
+      break;
+   case LP_QUERY_SCENE_BINNING_TIME:
+      value[0] = setup->binning_ns;
+      value[1] = setup->nr_scenes;
+      break;
+   case LP_QUERY_SCENE_RASTER_TIME:
+      value[0] = raster_ns;
+      value[1] = num_scenes;
+      break;
+   default:
+      if ((index - LP_QUERY_THREAD_TIMES) % 2 == 0)
+         value[0] = rast.busy_ns;
+      else
+         value[0] = rast.idle_ns;
+      break;
+   }
+}
+
+
+/**
+ * Compute the result of a driver specific query from its samples.
+ */
+static uint64_t
+llvmpipe_driver_query_result(const struct llvmpipe_query *pq)
+{
+   unsigned index = pq->type - PIPE_QUERY_DRIVER_SPECIFIC;
+   uint64_t value = pq->counter_end[0] - pq->counter_start[0];
+   uint64_t count = pq->counter_end[1] - pq->counter_start[1];
+   enum pipe_driver_query_type type = PIPE_DRIVER_QUERY_TYPE_MICROSECONDS;
+   enum pipe_driver_query_result_type result_type =
+      PIPE_DRIVER_QUERY_RESULT_TYPE_CUMULATIVE;
+
+   if (index < LP_QUERY_THREAD_TIMES) {
+      type = lp_driver_queries[index].type;
+      result_type = lp_driver_queries[index].result_type;
+   }
+
+   if (type == PIPE_DRIVER_QUERY_TYPE_PERCENTAGE)
+      value = count ? value * 100 / count : 0;
+   else if (result_type == PIPE_DRIVER_QUERY_RESULT_TYPE_AVERAGE)
+      value = count ? value / count : 0;
+
+   if (type == PIPE_DRIVER_QUERY_TYPE_MICROSECONDS)
+      value /= 1000;
+
+   return value;
+}
 
 
 static struct llvmpipe_query *llvmpipe_query( struct pipe_query *p )
@@ -53,13 +335,20 @@ llvmpipe_create_query(struct pipe_context *pipe,
                       unsigned type,
                       unsigned index)
 {
+   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
+   unsigned num_slots = MAX2(1, screen->num_threads);
    struct llvmpipe_query *pq;
 
-   assert(type < PIPE_QUERY_TYPES);
+   assert(type < PIPE_QUERY_TYPES ||
+          type - PIPE_QUERY_DRIVER_SPECIFIC < llvmpipe_num_driver_queries(screen));
 
-   pq = CALLOC_STRUCT( llvmpipe_query );
+   /* The per-thread start/end slots are allocated along with the query */
+   pq = CALLOC(1, sizeof(*pq) + 2 * num_slots * sizeof(uint64_t));
 
    if (pq) {
+      pq->start = (uint64_t *)(pq + 1);
+      pq->end = pq->start + num_slots;
+      pq->num_slots = num_slots;
       pq->type = type;
       pq->index = index;
    }
@@ -96,9 +385,8 @@ llvmpipe_get_query_result(struct pipe_context *pipe,
                           bool wait,
                           union pipe_query_result *vresult)
 {
-   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
-   unsigned num_threads = MAX2(1, screen->num_threads);
    struct llvmpipe_query *pq = llvmpipe_query(q);
+   unsigned num_threads = pq->num_slots;
    uint64_t *result = (uint64_t *)vresult;
    int i;
 
@@ -115,6 +403,11 @@ llvmpipe_get_query_result(struct pipe_context *pipe,
       }
    }
 
+   if (pq->type >= PIPE_QUERY_DRIVER_SPECIFIC) {
+      *result = llvmpipe_driver_query_result(pq);
+      return true;
+   }
+
    /* Sum the results from each of the threads:
     */
    *result = 0;
@@ -199,9 +492,8 @@ llvmpipe_get_query_result_resource(struct pipe_context *pipe,
                                    struct pipe_resource *resource,
                                    unsigned offset)
 {
-   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
-   unsigned num_threads = MAX2(1, screen->num_threads);
    struct llvmpipe_query *pq = llvmpipe_query(q);
+   unsigned num_threads = pq->num_slots;
    struct llvmpipe_resource *lpr = llvmpipe_resource(resource);
    bool unflushed = false;
    bool unsignalled = false;
@@ -309,7 +601,10 @@ llvmpipe_get_query_result_resource(struct pipe_context *pipe,
          }
          break;
       default:
-         fprintf(stderr, "Unknown query type %d\n", pq->type);
+         if (pq->type >= PIPE_QUERY_DRIVER_SPECIFIC)
+            value = llvmpipe_driver_query_result(pq);
+         else
+            fprintf(stderr, "Unknown query type %d\n", pq->type);
          break;
       }
    }
@@ -351,17 +646,27 @@ llvmpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
    struct llvmpipe_context *llvmpipe = llvmpipe_context( pipe );
    struct llvmpipe_query *pq = llvmpipe_query(q);
 
+   if (pq->type >= PIPE_QUERY_DRIVER_SPECIFIC) {
+      llvmpipe_sample_driver_query(llvmpipe,
+                                   pq->type - PIPE_QUERY_DRIVER_SPECIFIC,
+                                   pq->counter_start);
+      return true;
+   }
+
    /* Check if the query is already in the scene.  If so, we need to
     * flush the scene now.  Real apps shouldn't re-use a query in a
     * frame of rendering.
     */
-   if (pq->fence && !lp_fence_issued(pq->fence)) {
-      llvmpipe_finish(pipe, __FUNCTION__);
+   if (pq->fence) {
+      if (!lp_fence_issued(pq->fence))
+         llvmpipe_finish(pipe, __FUNCTION__);
+      else
+         lp_fence_wait(pq->fence);
    }
 
 
-   memset(pq->start, 0, sizeof(pq->start));
-   memset(pq->end, 0, sizeof(pq->end));
+   memset(pq->start, 0, pq->num_slots * sizeof(pq->start[0]));
+   memset(pq->end, 0, pq->num_slots * sizeof(pq->end[0]));
    lp_setup_begin_query(llvmpipe->setup, pq);
 
    switch (pq->type) {
@@ -414,6 +719,13 @@ llvmpipe_end_query(struct pipe_context *pipe, struct pipe_query *q)
    struct llvmpipe_context *llvmpipe = llvmpipe_context( pipe );
    struct llvmpipe_query *pq = llvmpipe_query(q);
 
+   if (pq->type >= PIPE_QUERY_DRIVER_SPECIFIC) {
+      llvmpipe_sample_driver_query(llvmpipe,
+                                   pq->type - PIPE_QUERY_DRIVER_SPECIFIC,
+                                   pq->counter_end);
+      return true;
+   }
+
    lp_setup_end_query(llvmpipe->setup, pq);
 
    switch (pq->type) {
@@ -528,4 +840,28 @@ void llvmpipe_init_query_funcs(struct llvmpipe_context *llvmpipe )
    llvmpipe->pipe.set_active_query_state = llvmpipe_set_active_query_state;
 }
 
+void llvmpipe_init_screen_query_funcs(struct llvmpipe_screen *screen)
+{
+   unsigned num_threads = lp_rast_get_num_threads(screen->rast);
+   unsigned i;
+
+   screen->thread_query_names =
+      CALLOC(2 * num_threads, sizeof(screen->thread_query_names[0]));
+   if (!screen->thread_query_names)
+      return;
+
+   for (i = 0; i < num_threads; i++) {
+      snprintf(screen->thread_query_names[2 * i],
+               sizeof(screen->thread_query_names[0]),
+               "thread%u-busy-time", i);
+      snprintf(screen->thread_query_names[2 * i + 1],
+               sizeof(screen->thread_query_names[0]),
+               "thread%u-idle-time", i);
+   }
+
+   screen->base.get_driver_query_info = llvmpipe_get_driver_query_info;
+   screen->base.get_driver_query_group_info =
+      llvmpipe_get_driver_query_group_info;
+}
+
 
@@ -35,15 +35,19 @@
 
 #include <limits.h>
 #include "os/os_thread.h"
+#include "util/u_threaded_context.h"
 #include "lp_limits.h"
 
 
 struct llvmpipe_context;
+struct llvmpipe_screen;
 
 
 struct llvmpipe_query {
-   uint64_t start[LP_MAX_THREADS];  /* start count value for each thread */
-   uint64_t end[LP_MAX_THREADS];    /* end count value for each thread */
+   struct threaded_query base;      /* must be first, zero initialized */
+   uint64_t *start;                 /* start count value for each thread */
+   uint64_t *end;                   /* end count value for each thread */
+   unsigned num_slots;              /* size of start/end, one per thread */
    struct lp_fence *fence;          /* fence from last scene this was binned in */
    unsigned type;                   /* PIPE_QUERY_* */
    unsigned index;
@@ -51,11 +55,16 @@ struct llvmpipe_query {
    unsigned num_primitives_written[PIPE_MAX_VERTEX_STREAMS];
 
    struct pipe_query_data_pipeline_statistics stats;
+
+   uint64_t counter_start[2];       /* driver specific query samples */
+   uint64_t counter_end[2];
 };
 
 
 extern void llvmpipe_init_query_funcs(struct llvmpipe_context * );
 
+extern void llvmpipe_init_screen_query_funcs(struct llvmpipe_screen * );
+
 extern boolean llvmpipe_check_render_cond(struct llvmpipe_context *);
 
 #endif /* LP_QUERY_H */
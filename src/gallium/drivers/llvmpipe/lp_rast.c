@@ -26,6 +26,8 @@
  **************************************************************************/
 
 #include <limits.h>
+#include <stdio.h>
+#include "util/u_atomic.h"
 #include "util/u_memory.h"
 #include "util/u_math.h"
 #include "util/u_rect.h"
@@ -61,6 +63,37 @@ const float lp_sample_pos_4x[4][2] = { { 0.375, 0.125 },
                                        { 0.125, 0.625 },
                                        { 0.625, 0.875 } };
 
+const float lp_sample_pos_8x[8][2] = { { 0.5625, 0.3125 },
+                                       { 0.4375, 0.6875 },
+                                       { 0.8125, 0.5625 },
+                                       { 0.3125, 0.1875 },
+                                       { 0.1875, 0.8125 },
+                                       { 0.0625, 0.4375 },
+                                       { 0.6875, 0.9375 },
+                                       { 0.9375, 0.0625 } };
+
+const float lp_sample_pos_16x[16][2] = { { 0.5625, 0.5625 },
+                                         { 0.4375, 0.3125 },
+                                         { 0.3125, 0.6250 },
+                                         { 0.7500, 0.4375 },
+                                         { 0.1875, 0.3750 },
+                                         { 0.6250, 0.8125 },
+                                         { 0.8125, 0.6875 },
+                                         { 0.6875, 0.1875 },
+                                         { 0.3750, 0.8750 },
+                                         { 0.5000, 0.0625 },
+                                         { 0.2500, 0.1250 },
+                                         { 0.1250, 0.7500 },
+                                         { 0.0000, 0.5000 },
+                                         { 0.9375, 0.2500 },
+                                         { 0.8750, 0.9375 },
+                                         { 0.0625, 0.0000 } };
+
+static void
+lp_rast_schedule_scene(struct lp_rasterizer *rast,
+                       struct lp_scene *scene);
+
+
 /**
  * Begin rasterizing a scene.
  * Called once per scene by one thread.
@@ -73,29 +106,66 @@ lp_rast_begin( struct lp_rasterizer *rast,
 
    LP_DBG(DEBUG_RAST, "%s\n", __FUNCTION__);
 
+   rast->scene_start_ns = os_time_get_nano();
+
    lp_scene_begin_rasterization( scene );
-   lp_scene_bin_iter_begin( scene );
+   lp_rast_schedule_scene( rast, scene );
 }
 
 
+/**
+ * End rasterizing a scene.
+ * Called once per scene by one thread, after all threads are done with
+ * the scene's bins.  Signalling the fence hands the scene back to the
+ * setup code, so the scene must not be touched afterwards.
+ */
 static void
 lp_rast_end( struct lp_rasterizer *rast )
 {
-   lp_scene_end_rasterization( rast->curr_scene );
+   struct lp_scene *scene = rast->curr_scene;
+   struct lp_fence *fence = scene->fence;
+
+   lp_scene_end_rasterization( scene );
+
+   {
+      uint64_t scene_ns = os_time_get_nano() - rast->scene_start_ns;
+      unsigned i;
+
+      mtx_lock(&rast->counters_mutex);
+
+      /* all threads count as idle while they don't work on the scene */
+      for (i = 0; i < MAX2(1, rast->num_threads); i++) {
+         struct lp_rasterizer_task *task = &rast->tasks[i];
+
+         task->counters.idle_ns +=
+            scene_ns - MIN2(task->stats.scene_busy_ns, scene_ns);
+         task->stats.scene_busy_ns = 0;
+         rast->counters[i] = task->counters;
+      }
+      rast->num_scenes++;
+      rast->raster_ns += scene_ns;
+
+      mtx_unlock(&rast->counters_mutex);
+   }
 
    rast->curr_scene = NULL;
+
+   if (fence) {
+      lp_fence_signal(fence);
+   }
 }
 
 
 /**
  * Beginning rasterization of a tile.
- * \param x  window X position of the tile, in pixels
- * \param y  window Y position of the tile, in pixels
+ * \param x  window X position of the tile, in tiles
+ * \param y  window Y position of the tile, in tiles
+ * \param block_mask  16x16 blocks of the tile the job covers
  */
 static void
 lp_rast_tile_begin(struct lp_rasterizer_task *task,
                    const struct cmd_bin *bin,
-                   int x, int y)
+                   int x, int y, unsigned block_mask)
 {
    unsigned i;
    struct lp_scene *scene = task->scene;
@@ -110,6 +180,21 @@ lp_rast_tile_begin(struct lp_rasterizer_task *task,
    task->height = TILE_SIZE + y * TILE_SIZE > task->scene->fb.height ?
                     task->scene->fb.height - y * TILE_SIZE : TILE_SIZE;
 
+   /* Jobs cover either the whole tile or one of its quadrants */
+   task->block_mask = block_mask;
+   if (block_mask == LP_RAST_JOB_FULL_TILE) {
+      task->job_x = 0;
+      task->job_y = 0;
+      task->job_width = task->width;
+      task->job_height = task->height;
+   }
+   else {
+      task->job_x = (ffs(block_mask) - 1) % 4 * 16;
+      task->job_y = (ffs(block_mask) - 1) / 4 * 16;
+      task->job_width = MIN2(TILE_SIZE / 2, task->width - task->job_x);
+      task->job_height = MIN2(TILE_SIZE / 2, task->height - task->job_y);
+   }
+
    task->thread_data.vis_counter = 0;
    task->thread_data.ps_invocations = 0;
 
@@ -125,11 +210,14 @@ lp_rast_tile_begin(struct lp_rasterizer_task *task,
                          scene->zsbuf.stride * task->y +
                          scene->zsbuf.format_bytes * task->x;
    }
+
+   lp_rast_hiz_begin_tile(task);
 }
 
 
 /**
- * Clear the rasterizer's current color tile.
+ * Clear the part of the rasterizer's current color tile covered by the
+ * current job.
  * This is a bin command called during bin processing.
  * Clear commands always clear all bound layers.
  */
@@ -162,11 +250,11 @@ lp_rast_clear_color(struct lp_rasterizer_task *task,
                     format,
                     scene->cbufs[cbuf].stride,
                     scene->cbufs[cbuf].layer_stride,
-                    task->x,
-                    task->y,
+                    task->x + task->job_x,
+                    task->y + task->job_y,
                     0,
-                    task->width,
-                    task->height,
+                    task->job_width,
+                    task->job_height,
                     scene->fb_max_layer + 1,
                     &uc);
    }
@@ -177,7 +265,8 @@ lp_rast_clear_color(struct lp_rasterizer_task *task,
 
 
 /**
- * Clear the rasterizer's current z/stencil tile.
+ * Clear the part of the rasterizer's current z/stencil tile covered by
+ * the current job.
  * This is a bin command called during bin processing.
  * Clear commands always clear all bound layers.
  */
@@ -190,8 +279,8 @@ lp_rast_clear_zstencil(struct lp_rasterizer_task *task,
    uint64_t clear_mask64 = arg.clear_zstencil.mask;
    uint32_t clear_value = (uint32_t) clear_value64;
    uint32_t clear_mask = (uint32_t) clear_mask64;
-   const unsigned height = task->height;
-   const unsigned width = task->width;
+   const unsigned height = task->job_height;
+   const unsigned width = task->job_width;
    const unsigned dst_stride = scene->zsbuf.stride;
    uint8_t *dst;
    unsigned i, j;
@@ -208,7 +297,9 @@ lp_rast_clear_zstencil(struct lp_rasterizer_task *task,
       unsigned layer;
 
       for (unsigned s = 0; s < scene->zsbuf.nr_samples; s++) {
-         uint8_t *dst_layer = task->depth_tile + (s * scene->zsbuf.sample_stride);
+         uint8_t *dst_layer = task->depth_tile + (s * scene->zsbuf.sample_stride) +
+                              task->job_y * dst_stride +
+                              task->job_x * scene->zsbuf.format_bytes;
          block_size = util_format_get_blocksize(scene->fb.zsbuf->format);
 
          clear_value &= clear_mask;
@@ -292,14 +383,18 @@ lp_rast_clear_zstencil(struct lp_rasterizer_task *task,
             dst_layer += scene->zsbuf.layer_stride;
          }
       }
+
+      lp_rast_hiz_clear(task, arg.clear_zstencil.value,
+                        arg.clear_zstencil.mask);
    }
 }
 
 
 
 /**
- * Run the shader on all blocks in a tile.  This is used when a tile is
- * completely contained inside a triangle.
+ * Run the shader on all blocks in a tile, or in the part of it covered
+ * by the current job.  This is used when a tile is completely contained
+ * inside a triangle.
  * This is a bin command called during bin processing.
  */
 static void
@@ -309,9 +404,10 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
    const struct lp_scene *scene = task->scene;
    const struct lp_rast_shader_inputs *inputs = arg.shade_tile;
    const struct lp_rast_state *state;
-   struct lp_fragment_shader_variant *variant;
+   const lp_jit_frag_func *jit_funcs;
    const unsigned tile_x = task->x, tile_y = task->y;
    unsigned x, y;
+   uint64_t mask[LP_RAST_MASK_WORDS];
 
    if (inputs->disable) {
       /* This command was partially binned and has been disabled */
@@ -325,11 +421,16 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
    if (!state) {
       return;
    }
-   variant = state->variant;
+   jit_funcs = p_atomic_read(&state->variant->jit_funcs);
+
+   if (lp_rast_hiz_reject(task, inputs, tile_x, tile_y, TILE_SIZE))
+      return;
+
+   lp_rast_replicate_mask(mask, scene->fb_max_samples, 0xffff);
 
-   /* render the whole 64x64 tile in 4x4 chunks */
-   for (y = 0; y < task->height; y += 4){
-      for (x = 0; x < task->width; x += 4) {
+   /* render the job's part of the 64x64 tile in 4x4 chunks */
+   for (y = task->job_y; y < task->job_y + task->job_height; y += 4){
+      for (x = task->job_x; x < task->job_x + task->job_width; x += 4) {
          uint8_t *color[PIPE_MAX_COLOR_BUFS];
          unsigned stride[PIPE_MAX_COLOR_BUFS];
          unsigned sample_stride[PIPE_MAX_COLOR_BUFS];
@@ -338,6 +439,9 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
          unsigned depth_sample_stride = 0;
          unsigned i;
 
+         if (lp_rast_hiz_reject(task, inputs, tile_x + x, tile_y + y, 4))
+            continue;
+
          /* color buffer */
          for (i = 0; i < scene->fb.nr_cbufs; i++){
             if (scene->fb.cbufs[i]) {
@@ -361,29 +465,27 @@ lp_rast_shade_tile(struct lp_rasterizer_task *task,
             depth_sample_stride = scene->zsbuf.sample_stride;
          }
 
-         uint64_t mask = 0;
-         for (unsigned i = 0; i < scene->fb_max_samples; i++)
-            mask |= (uint64_t)(0xffff) << (16 * i);
-
          /* Propagate non-interpolated raster state. */
          task->thread_data.raster_state.viewport_index = inputs->viewport_index;
 
+         lp_rast_hiz_written(task, tile_x + x, tile_y + y);
+
          /* run shader on 4x4 block */
          BEGIN_JIT_CALL(state, task);
-         variant->jit_function[RAST_WHOLE]( &state->jit_context,
-                                            tile_x + x, tile_y + y,
-                                            inputs->frontfacing,
-                                            GET_A0(inputs),
-                                            GET_DADX(inputs),
-                                            GET_DADY(inputs),
-                                            color,
-                                            depth,
-                                            mask,
-                                            &task->thread_data,
-                                            stride,
-                                            depth_stride,
-                                            sample_stride,
-                                            depth_sample_stride);
+         jit_funcs[RAST_WHOLE]( &state->jit_context,
+                                tile_x + x, tile_y + y,
+                                inputs->frontfacing,
+                                GET_A0(inputs),
+                                GET_DADX(inputs),
+                                GET_DADY(inputs),
+                                color,
+                                depth,
+                                mask,
+                                &task->thread_data,
+                                stride,
+                                depth_stride,
+                                sample_stride,
+                                depth_sample_stride);
          END_JIT_CALL();
       }
    }
@@ -420,10 +522,10 @@ void
 lp_rast_shade_quads_mask_sample(struct lp_rasterizer_task *task,
                                 const struct lp_rast_shader_inputs *inputs,
                                 unsigned x, unsigned y,
-                                uint64_t mask)
+                                const uint64_t *mask)
 {
    const struct lp_rast_state *state = task->state;
-   struct lp_fragment_shader_variant *variant = state->variant;
+   const lp_jit_frag_func *jit_funcs = p_atomic_read(&state->variant->jit_funcs);
    const struct lp_scene *scene = task->scene;
    uint8_t *color[PIPE_MAX_COLOR_BUFS];
    unsigned stride[PIPE_MAX_COLOR_BUFS];
@@ -471,27 +573,32 @@ lp_rast_shade_quads_mask_sample(struct lp_rasterizer_task *task,
    /*
     * The rasterizer may produce fragments outside our
     * allocated 4x4 blocks hence need to filter them out here.
+    * Blocks outside the current job belong to another job.
     */
-   if ((x % TILE_SIZE) < task->width && (y % TILE_SIZE) < task->height) {
+   if ((x % TILE_SIZE) < task->width && (y % TILE_SIZE) < task->height &&
+       lp_rast_block_in_job(task, x, y) &&
+       !lp_rast_hiz_reject(task, inputs, x, y, 4)) {
       /* Propagate non-interpolated raster state. */
       task->thread_data.raster_state.viewport_index = inputs->viewport_index;
 
+      lp_rast_hiz_written(task, x, y);
+
       /* run shader on 4x4 block */
       BEGIN_JIT_CALL(state, task);
-      variant->jit_function[RAST_EDGE_TEST](&state->jit_context,
-                                            x, y,
-                                            inputs->frontfacing,
-                                            GET_A0(inputs),
-                                            GET_DADX(inputs),
-                                            GET_DADY(inputs),
-                                            color,
-                                            depth,
-                                            mask,
-                                            &task->thread_data,
-                                            stride,
-                                            depth_stride,
-                                            sample_stride,
-                                            depth_sample_stride);
+      jit_funcs[RAST_EDGE_TEST](&state->jit_context,
+                                x, y,
+                                inputs->frontfacing,
+                                GET_A0(inputs),
+                                GET_DADX(inputs),
+                                GET_DADY(inputs),
+                                color,
+                                depth,
+                                mask,
+                                &task->thread_data,
+                                stride,
+                                depth_stride,
+                                sample_stride,
+                                depth_sample_stride);
       END_JIT_CALL();
    }
 }
@@ -502,9 +609,8 @@ lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
                          unsigned x, unsigned y,
                          unsigned mask)
 {
-   uint64_t new_mask = 0;
-   for (unsigned i = 0; i < task->scene->fb_max_samples; i++)
-      new_mask |= ((uint64_t)mask) << (16 * i);
+   uint64_t new_mask[LP_RAST_MASK_WORDS];
+   lp_rast_replicate_mask(new_mask, task->scene->fb_max_samples, mask);
    lp_rast_shade_quads_mask_sample(task, inputs, x, y, new_mask);
 }
 
@@ -574,6 +680,7 @@ lp_rast_set_state(struct lp_rasterizer_task *task,
                   const union lp_rast_cmd_arg arg)
 {
    task->state = arg.state;
+   lp_rast_hiz_set_state(task);
 }
 
 
@@ -663,16 +770,18 @@ do_rasterize_bin(struct lp_rasterizer_task *task,
 
 
 /**
- * Rasterize commands for a single bin.
+ * Rasterize commands for a single bin, or the part of it covered by a job.
  * \param x, y  position of the bin's tile in the framebuffer
+ * \param block_mask  16x16 blocks of the tile to rasterize
  * Must be called between lp_rast_begin() and lp_rast_end().
  * Called per thread.
  */
 static void
 rasterize_bin(struct lp_rasterizer_task *task,
-              const struct cmd_bin *bin, int x, int y )
+              const struct cmd_bin *bin, int x, int y,
+              unsigned block_mask)
 {
-   lp_rast_tile_begin( task, bin, x, y );
+   lp_rast_tile_begin( task, bin, x, y, block_mask );
 
    do_rasterize_bin(task, bin, x, y);
 
@@ -681,7 +790,7 @@ rasterize_bin(struct lp_rasterizer_task *task,
 #ifdef DEBUG
    /* Debug/Perf flags:
     */
-   if (bin->head->count == 1) {
+   if (bin->head->count == 1 && block_mask == LP_RAST_JOB_FULL_TILE) {
       if (bin->head->cmd[0] == LP_RAST_OP_SHADE_TILE_OPAQUE)
          LP_COUNT(nr_pure_shade_opaque_64);
       else if (bin->head->cmd[0] == LP_RAST_OP_SHADE_TILE)
@@ -705,6 +814,222 @@ is_empty_bin( const struct cmd_bin *bin )
 }
 
 
+/**
+ * Estimate the cost of rasterizing a bin.  The number of commands is
+ * crude, but cheap to get and good enough to balance the threads.
+ */
+static unsigned
+estimate_bin_cost(const struct cmd_bin *bin)
+{
+   const struct cmd_block *block;
+   unsigned cost = 0;
+
+   for (block = bin->head; block; block = block->next)
+      cost += block->count;
+
+   return cost;
+}
+
+
+static void
+add_job(struct lp_rasterizer *rast, unsigned x, unsigned y,
+        unsigned block_mask, unsigned cost)
+{
+   struct lp_rast_job *job = &rast->jobs[rast->num_jobs++];
+
+   assert(rast->num_jobs <= rast->max_jobs);
+
+   job->x = x;
+   job->y = y;
+   job->block_mask = block_mask;
+   job->cost = cost;
+}
+
+
+static inline uint64_t
+pack_deque_range(unsigned head, unsigned tail)
+{
+   return ((uint64_t)tail << 32) | head;
+}
+
+
+/**
+ * Build the job list of a scene and hand out the jobs to the threads.
+ *
+ * Every thread starts out with a contiguous run of jobs in scanline
+ * order, which keeps its tiles close together, of about the same
+ * estimated cost.  Threads which run out of work steal jobs from the
+ * others, see get_next_job().
+ *
+ * Called once per scene by thread 0 before waking up the other threads.
+ */
+static void
+lp_rast_schedule_scene(struct lp_rasterizer *rast,
+                       struct lp_scene *scene)
+{
+   unsigned num_threads = MAX2(1, rast->num_threads);
+   unsigned max_jobs = lp_scene_get_num_bins(scene);
+   uint64_t total_cost = 0, cost = 0;
+   unsigned x, y, i, t, first;
+
+   rast->num_jobs = 0;
+   rast->curr_num_threads = 1;
+   rast->deques[0].range = pack_deque_range(0, 0);
+
+   if (rast->no_rast)
+      return;
+
+   if (rast->split_bins)
+      max_jobs *= 4;
+
+   if (max_jobs > rast->max_jobs) {
+      struct lp_rast_job *jobs = REALLOC(rast->jobs,
+                                         rast->max_jobs * sizeof(jobs[0]),
+                                         max_jobs * sizeof(jobs[0]));
+      if (!jobs) {
+         debug_printf("llvmpipe: out of memory for rasterizer jobs\n");
+         return;
+      }
+      rast->jobs = jobs;
+      rast->max_jobs = max_jobs;
+   }
+
+   for (y = 0; y < scene->tiles_y; y++) {
+      for (x = 0; x < scene->tiles_x; x++) {
+         total_cost += estimate_bin_cost(lp_scene_get_bin(scene, x, y));
+      }
+   }
+
+   for (y = 0; y < scene->tiles_y; y++) {
+      for (x = 0; x < scene->tiles_x; x++) {
+         const struct cmd_bin *bin = lp_scene_get_bin(scene, x, y);
+         unsigned bin_cost = estimate_bin_cost(bin);
+
+         if (is_empty_bin(bin))
+            continue;
+
+         /* A bin costing more than half of a thread's share of the scene
+          * would likely keep one thread busy while the others idle, so
+          * split it into quadrants.  Every quadrant runs through all the
+          * commands of the bin, but only shades its own pixels.
+          */
+         if (rast->split_bins && num_threads > 1 &&
+             2 * num_threads * (uint64_t)bin_cost > total_cost) {
+            unsigned q;
+
+            for (q = 0; q < 4; q++) {
+               unsigned qx = (q & 1) * (TILE_SIZE / 2);
+               unsigned qy = (q >> 1) * (TILE_SIZE / 2);
+
+               if (x * TILE_SIZE + qx < scene->fb.width &&
+                   y * TILE_SIZE + qy < scene->fb.height) {
+                  add_job(rast, x, y, 0x33 << (qx / 16 + qy / 4),
+                          DIV_ROUND_UP(bin_cost, 4));
+               }
+            }
+            rast->num_split_bins++;
+         }
+         else {
+            add_job(rast, x, y, LP_RAST_JOB_FULL_TILE, bin_cost);
+         }
+      }
+   }
+
+   /* No point in waking up more threads than there are jobs */
+   rast->curr_num_threads = CLAMP(rast->num_jobs, 1, num_threads);
+
+   total_cost = 0;
+   for (i = 0; i < rast->num_jobs; i++)
+      total_cost += rast->jobs[i].cost;
+
+   first = 0;
+   t = 0;
+   for (i = 0; i < rast->num_jobs && t + 1 < rast->curr_num_threads; i++) {
+      cost += rast->jobs[i].cost;
+      if (cost * rast->curr_num_threads >= total_cost * (t + 1)) {
+         rast->deques[t++].range = pack_deque_range(first, i + 1);
+         first = i + 1;
+      }
+   }
+   rast->deques[t++].range = pack_deque_range(first, rast->num_jobs);
+   for (; t < rast->curr_num_threads; t++)
+      rast->deques[t].range = pack_deque_range(rast->num_jobs, rast->num_jobs);
+}
+
+
+/**
+ * Take a job from the head of a deque, or from its tail when stealing.
+ * \return FALSE if the deque is empty
+ */
+static boolean
+deque_pop(struct lp_rast_deque *deque, boolean steal, unsigned *job)
+{
+   uint64_t range = p_atomic_read(&deque->range);
+
+   while (1) {
+      unsigned head = (unsigned)range;
+      unsigned tail = (unsigned)(range >> 32);
+      uint64_t old;
+
+      if (head >= tail)
+         return FALSE;
+
+      if (steal)
+         *job = --tail;
+      else
+         *job = head++;
+
+      old = p_atomic_cmpxchg(&deque->range, range,
+                             pack_deque_range(head, tail));
+      if (old == range)
+         return TRUE;
+
+      /* somebody else took a job from this deque, try again */
+      range = old;
+   }
+}
+
+
+/**
+ * Get the next job for a thread: from its own deque while there is
+ * anything left in it, else steal from the thread with the most jobs left.
+ * \return FALSE once all of the scene's jobs have been taken
+ */
+static boolean
+get_next_job(struct lp_rasterizer_task *task, unsigned *job)
+{
+   struct lp_rasterizer *rast = task->rast;
+
+   if (deque_pop(&rast->deques[task->thread_index], FALSE, job))
+      return TRUE;
+
+   while (1) {
+      struct lp_rast_deque *victim = NULL;
+      unsigned max_left = 0;
+      unsigned i;
+
+      for (i = 0; i < rast->curr_num_threads; i++) {
+         uint64_t range = p_atomic_read(&rast->deques[i].range);
+         unsigned head = (unsigned)range;
+         unsigned tail = (unsigned)(range >> 32);
+
+         if (i != task->thread_index && tail > head + max_left) {
+            victim = &rast->deques[i];
+            max_left = tail - head;
+         }
+      }
+
+      if (!victim)
+         return FALSE;
+
+      if (deque_pop(victim, TRUE, job)) {
+         task->stats.stolen++;
+         return TRUE;
+      }
+   }
+}
+
+
 /**
  * Rasterize/execute all bins within a scene.
  * Called per thread.
@@ -715,49 +1040,43 @@ rasterize_scene(struct lp_rasterizer_task *task,
 {
    task->scene = scene;
 
+   lp_rast_hiz_begin_scene(task);
+
    /* Clear the cache tags. This should not always be necessary but
       simpler for now. */
 #if LP_USE_TEXTURE_CACHE
    memset(task->thread_data.cache->cache_tags, 0,
           sizeof(task->thread_data.cache->cache_tags));
-#if LP_BUILD_FORMAT_CACHE_DEBUG
+#endif
    task->thread_data.cache->cache_access_total = 0;
    task->thread_data.cache->cache_access_miss = 0;
-#endif
-#endif
 
-   if (!task->rast->no_rast) {
-      /* loop over scene bins, rasterize each */
-      {
-         struct cmd_bin *bin;
-         int i, j;
+   /* rasterize jobs until there are none left */
+   {
+      struct lp_rasterizer *rast = task->rast;
+      unsigned i;
 
-         assert(scene);
-         while ((bin = lp_scene_bin_iter_next(scene, &i, &j))) {
-            if (!is_empty_bin( bin ))
-               rasterize_bin(task, bin, i, j);
-         }
-      }
-   }
+      assert(scene);
+      while (get_next_job(task, &i)) {
+         const struct lp_rast_job *job = &rast->jobs[i];
+         uint64_t start = os_time_get_nano();
+         uint64_t busy_ns;
 
+         rasterize_bin(task, lp_scene_get_bin(scene, job->x, job->y),
+                       job->x, job->y, job->block_mask);
 
-#if LP_BUILD_FORMAT_CACHE_DEBUG
-   {
-      uint64_t total, miss;
-      total = task->thread_data.cache->cache_access_total;
-      miss = task->thread_data.cache->cache_access_miss;
-      if (total) {
-         debug_printf("thread %d cache access %llu miss %llu hit rate %f\n",
-                 task->thread_index, (long long unsigned)total,
-                 (long long unsigned)miss,
-                 (float)(total - miss)/(float)total);
+         busy_ns = os_time_get_nano() - start;
+         task->counters.busy_ns += busy_ns;
+         task->stats.scene_busy_ns += busy_ns;
+         task->stats.jobs++;
       }
    }
-#endif
 
-   if (scene->fence) {
-      lp_fence_signal(scene->fence);
-   }
+
+   task->counters.nr_tex_cache_access +=
+      task->thread_data.cache->cache_access_total;
+   task->counters.nr_tex_cache_miss +=
+      task->thread_data.cache->cache_access_miss;
 
    task->scene = NULL;
 }
@@ -788,39 +1107,75 @@ lp_rast_queue_scene( struct lp_rasterizer *rast,
       lp_rast_end( rast );
 
       util_fpstate_set(fpstate);
-
-      rast->curr_scene = NULL;
    }
    else {
       /* threaded rendering! */
-      unsigned i;
-
       lp_scene_enqueue( rast->full_scenes, scene );
 
-      /* signal the threads that there's work to do */
-      for (i = 0; i < rast->num_threads; i++) {
-         pipe_semaphore_signal(&rast->tasks[i].work_ready);
-      }
+      /* signal thread[0] that there's work to do, it wakes up the
+       * other threads it needs for the scene.
+       */
+      pipe_semaphore_signal(&rast->tasks[0].work_ready);
    }
 
    LP_DBG(DEBUG_SETUP, "%s done \n", __FUNCTION__);
 }
 
 
+/**
+ * Number of rasterizer tasks, which is at least one even when there are
+ * no rasterizer threads.
+ */
+unsigned
+lp_rast_get_num_threads( const struct lp_rasterizer *rast )
+{
+   return MAX2(1, rast->num_threads);
+}
+
+
+/**
+ * Get the rasterizer counters as of the end of the last finished scene.
+ * May be called from any thread.
+ * \param thread  the task to get the counters of, or -1 for their sum
+ */
 void
-lp_rast_finish( struct lp_rasterizer *rast )
+lp_rast_get_counters( struct lp_rasterizer *rast,
+                      int thread,
+                      struct lp_rast_counters *counters,
+                      uint64_t *num_scenes,
+                      uint64_t *raster_ns )
 {
-   if (rast->num_threads == 0) {
-      /* nothing to do */
+   unsigned i;
+
+   mtx_lock(&rast->counters_mutex);
+
+   if (thread >= 0) {
+      *counters = rast->counters[thread];
    }
    else {
-      int i;
-
-      /* wait for work to complete */
-      for (i = 0; i < rast->num_threads; i++) {
-         pipe_semaphore_wait(&rast->tasks[i].work_done);
+      memset(counters, 0, sizeof *counters);
+      for (i = 0; i < MAX2(1, rast->num_threads); i++) {
+         const struct lp_rast_counters *c = &rast->counters[i];
+
+         counters->nr_empty_16 += c->nr_empty_16;
+         counters->nr_partially_covered_16 += c->nr_partially_covered_16;
+         counters->nr_fully_covered_16 += c->nr_fully_covered_16;
+         counters->nr_empty_4 += c->nr_empty_4;
+         counters->nr_partially_covered_4 += c->nr_partially_covered_4;
+         counters->nr_fully_covered_4 += c->nr_fully_covered_4;
+         counters->nr_hiz_rejected_64 += c->nr_hiz_rejected_64;
+         counters->nr_hiz_rejected_16 += c->nr_hiz_rejected_16;
+         counters->nr_hiz_rejected_4 += c->nr_hiz_rejected_4;
+         counters->nr_tex_cache_access += c->nr_tex_cache_access;
+         counters->nr_tex_cache_miss += c->nr_tex_cache_miss;
+         counters->busy_ns += c->busy_ns;
+         counters->idle_ns += c->idle_ns;
       }
    }
+   *num_scenes = rast->num_scenes;
+   *raster_ns = rast->raster_ns;
+
+   mtx_unlock(&rast->counters_mutex);
 }
 
 
@@ -830,6 +1185,12 @@ lp_rast_finish( struct lp_rasterizer *rast )
  *   1. wait for work
  *   2. do work
  *   3. signal that we're done
+ *
+ * Thread 0 drives each scene: it dequeues it, hands out its jobs, wakes
+ * up as many of the other threads as there are jobs for, waits for them
+ * to finish and finally signals the scene's fence.  Completion is only reported
+ * through the scene fences, so the setup code can keep binning new
+ * scenes while older ones are rasterized.
  */
 static int
 thread_function(void *init_data)
@@ -859,18 +1220,21 @@ thread_function(void *init_data)
          break;
 
       if (task->thread_index == 0) {
+         unsigned i;
+
          /* thread[0]:
           *  - get next scene to rasterize
           *  - map the framebuffer surfaces
+          *  - distribute the scene's jobs
+          *  - wake up the helper threads
           */
          lp_rast_begin( rast, 
                         lp_scene_dequeue( rast->full_scenes, TRUE ) );
-      }
 
-      /* Wait for all threads to get here so that threads[1+] don't
-       * get a null rast->curr_scene pointer.
-       */
-      util_barrier_wait( &rast->barrier );
+         for (i = 1; i < rast->curr_num_threads; i++) {
+            pipe_semaphore_signal(&rast->tasks[i].work_ready);
+         }
+      }
 
       /* do work */
       if (debug)
@@ -878,21 +1242,28 @@ thread_function(void *init_data)
 
       rasterize_scene(task,
                       rast->curr_scene);
-      
-      /* wait for all threads to finish with this scene */
-      util_barrier_wait( &rast->barrier );
 
-      /* XXX: shouldn't be necessary:
-       */
       if (task->thread_index == 0) {
+         unsigned i;
+
+         /* wait for the helper threads to finish with this scene */
+         for (i = 1; i < rast->curr_num_threads; i++) {
+            pipe_semaphore_wait(&rast->tasks[i].work_done);
+         }
+
+         /* thread[0]:
+          *  - unmap the framebuffer surfaces
+          *  - signal the scene's fence
+          */
          lp_rast_end( rast );
       }
+      else {
+         /* signal done with work */
+         pipe_semaphore_signal(&task->work_done);
+      }
 
-      /* signal done with work */
       if (debug)
          debug_printf("thread %d done working\n", task->thread_index);
-
-      pipe_semaphore_signal(&task->work_done);
    }
 
 #ifdef _WIN32
@@ -947,6 +1318,27 @@ lp_rast_create( unsigned num_threads )
       goto no_full_scenes;
    }
 
+   rast->tasks = CALLOC(MAX2(1, num_threads), sizeof(rast->tasks[0]));
+   if (!rast->tasks) {
+      goto no_tasks;
+   }
+
+   rast->threads = CALLOC(MAX2(1, num_threads), sizeof(rast->threads[0]));
+   if (!rast->threads) {
+      goto no_threads;
+   }
+
+   rast->deques = align_malloc(MAX2(1, num_threads) * sizeof(rast->deques[0]),
+                               sizeof(rast->deques[0]));
+   if (!rast->deques) {
+      goto no_deques;
+   }
+
+   rast->counters = CALLOC(MAX2(1, num_threads), sizeof(rast->counters[0]));
+   if (!rast->counters) {
+      goto no_counters;
+   }
+
    for (i = 0; i < MAX2(1, num_threads); i++) {
       struct lp_rasterizer_task *task = &rast->tasks[i];
       task->rast = rast;
@@ -961,25 +1353,33 @@ lp_rast_create( unsigned num_threads )
    rast->num_threads = num_threads;
 
    rast->no_rast = debug_get_bool_option("LP_NO_RAST", FALSE);
+   rast->split_bins = debug_get_bool_option("LP_SPLIT_BINS", FALSE);
+   rast->hiz = debug_get_bool_option("LP_HIZ", FALSE);
+   rast->dump_stats = debug_get_bool_option("LP_RAST_STATS", FALSE);
 
-   create_rast_threads(rast);
+   (void) mtx_init(&rast->counters_mutex, mtx_plain);
 
-   /* for synchronizing rasterization threads */
-   if (rast->num_threads > 0) {
-      util_barrier_init( &rast->barrier, rast->num_threads );
-   }
+   create_rast_threads(rast);
 
    memset(lp_dummy_tile, 0, sizeof lp_dummy_tile);
 
    return rast;
 
 no_thread_data_cache:
-   for (i = 0; i < MAX2(1, rast->num_threads); i++) {
+   for (i = 0; i < MAX2(1, num_threads); i++) {
       if (rast->tasks[i].thread_data.cache) {
          align_free(rast->tasks[i].thread_data.cache);
       }
    }
 
+   FREE(rast->counters);
+no_counters:
+   align_free(rast->deques);
+no_deques:
+   FREE(rast->threads);
+no_threads:
+   FREE(rast->tasks);
+no_tasks:
    lp_scene_queue_destroy(rast->full_scenes);
 no_full_scenes:
    FREE(rast);
@@ -988,6 +1388,36 @@ no_rast:
 }
 
 
+/**
+ * Print the scheduler statistics collected with LP_RAST_STATS.
+ */
+static void
+lp_rast_dump_stats(const struct lp_rasterizer *rast)
+{
+   unsigned i;
+
+   debug_printf("llvmpipe: %u scenes, %u bins split\n",
+                (unsigned)rast->num_scenes, rast->num_split_bins);
+   debug_printf("thread      jobs    stolen     busy ms     idle ms  busy %%"
+                "  tex cache hit %%\n");
+
+   for (i = 0; i < MAX2(1, rast->num_threads); i++) {
+      const struct lp_rast_thread_stats *stats = &rast->tasks[i].stats;
+      const struct lp_rast_counters *counters = &rast->tasks[i].counters;
+      uint64_t total_ns = counters->busy_ns + counters->idle_ns;
+      uint64_t tex_hits = counters->nr_tex_cache_access -
+                          counters->nr_tex_cache_miss;
+
+      debug_printf("%6u %9u %9u %11.2f %11.2f %7.1f %16.1f\n",
+                   i, stats->jobs, stats->stolen,
+                   counters->busy_ns / 1e6, counters->idle_ns / 1e6,
+                   total_ns ? 100.0 * counters->busy_ns / total_ns : 0.0,
+                   counters->nr_tex_cache_access ?
+                   100.0 * tex_hits / counters->nr_tex_cache_access : 0.0);
+   }
+}
+
+
 /* Shutdown:
  */
 void lp_rast_destroy( struct lp_rasterizer *rast )
@@ -1023,14 +1453,17 @@ void lp_rast_destroy( struct lp_rasterizer *rast )
       align_free(rast->tasks[i].thread_data.cache);
    }
 
-   /* for synchronizing rasterization threads */
-   if (rast->num_threads > 0) {
-      util_barrier_destroy( &rast->barrier );
-   }
+   if (rast->dump_stats)
+      lp_rast_dump_stats(rast);
 
    lp_scene_queue_destroy(rast->full_scenes);
 
+   mtx_destroy(&rast->counters_mutex);
+   FREE(rast->counters);
+
+   FREE(rast->jobs);
+   align_free(rast->deques);
+   FREE(rast->threads);
+   FREE(rast->tasks);
    FREE(rast);
 }
-
-
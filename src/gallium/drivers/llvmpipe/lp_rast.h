@@ -40,11 +40,13 @@
 #include "pipe/p_compiler.h"
 #include "util/u_pack_color.h"
 #include "lp_jit.h"
+#include "lp_limits.h"
 
 
 struct lp_rasterizer;
 struct lp_scene;
 struct lp_fence;
+struct lp_rast_counters;
 struct cmd_bin;
 
 #define FIXED_TYPE_WIDTH 64
@@ -73,6 +75,33 @@ struct cmd_bin;
 struct lp_rasterizer_task;
 
 extern const float lp_sample_pos_4x[4][2];
+extern const float lp_sample_pos_8x[8][2];
+extern const float lp_sample_pos_16x[16][2];
+
+/**
+ * Coverage of a 4x4 stamp as passed to the fragment shader: 16 bits per
+ * sample, four samples per 64-bit word.
+ */
+#define LP_RAST_MASK_WORDS (LP_MAX_SAMPLES / 4)
+
+/**
+ * Standard sample positions for the given sample count, or NULL if the
+ * samples are at the pixel center.
+ */
+static inline const float (*
+lp_sample_pos(unsigned nr_samples))[2]
+{
+   switch (nr_samples) {
+   case 4:
+      return lp_sample_pos_4x;
+   case 8:
+      return lp_sample_pos_8x;
+   case 16:
+      return lp_sample_pos_16x;
+   default:
+      return NULL;
+   }
+}
 
 /**
  * Rasterization state.
@@ -167,8 +196,15 @@ void
 lp_rast_queue_scene( struct lp_rasterizer *rast,
                      struct lp_scene *scene );
 
+unsigned
+lp_rast_get_num_threads( const struct lp_rasterizer *rast );
+
 void
-lp_rast_finish( struct lp_rasterizer *rast );
+lp_rast_get_counters( struct lp_rasterizer *rast,
+                      int thread,
+                      struct lp_rast_counters *counters,
+                      uint64_t *num_scenes,
+                      uint64_t *raster_ns );
 
 
 union lp_rast_cmd_arg {
@@ -0,0 +1,457 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The Mesa Authors.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Hierarchical depth rejection.
+ *
+ * Each rasterizer task keeps the range of depth values in every 4x4 and
+ * 16x16 block of its current job, and of the job as a whole.  Before
+ * shading a part of a triangle, the range of the triangle's depth over
+ * that part is compared against them, and parts which can't pass the
+ * depth test are skipped.  With lots of overdraw this saves running the
+ * fragment shader on occluded blocks, and even the coverage computations
+ * of occluded tiles and 16x16 blocks.
+ *
+ * The bounds are exact after a depth clear.  Blocks the fragment shader
+ * ran on are flagged, and their bounds recomputed from the depth buffer
+ * the next time they are needed, as the fragment shader may have written
+ * anything there.
+ *
+ * The bounds only live as long as a job, so there is nothing to keep
+ * coherent across scenes, threads or depth buffer writes from outside
+ * the rasterizer.
+ */
+
+#include <float.h>
+#include <math.h>
+
+#include "util/bitscan.h"
+#include "util/u_math.h"
+
+#include "lp_perf.h"
+#include "lp_rast_priv.h"
+#include "lp_state_fs.h"
+
+
+/** 4x4 blocks of a 16x16 block within its dirty_4 word */
+#define BLOCK_16_MASK 0x000f000f000f000fULL
+
+
+static const struct lp_rast_depth_bounds empty_bounds = { FLT_MAX, -FLT_MAX };
+
+
+/**
+ * Check whether the depth buffer of the scene can be tracked, and how to
+ * read it.
+ */
+void
+lp_rast_hiz_begin_scene(struct lp_rasterizer_task *task)
+{
+   const struct lp_scene *scene = task->scene;
+   struct lp_rast_hiz *hiz = &task->hiz;
+   const struct util_format_description *desc;
+   const struct util_format_channel_description *chan;
+
+   hiz->enabled = FALSE;
+   hiz->cull = FALSE;
+   hiz->write = FALSE;
+
+   /* Bounds are kept for a single layer and sample */
+   if (!task->rast->hiz || !scene->fb.zsbuf || !scene->zsbuf.map ||
+       scene->fb_max_layer > 0 || scene->zsbuf.nr_samples > 1)
+      return;
+
+   desc = util_format_description(scene->fb.zsbuf->format);
+   if (!util_format_has_depth(desc))
+      return;
+
+   chan = &desc->channel[desc->swizzle[0]];
+   if (chan->type == UTIL_FORMAT_TYPE_FLOAT && chan->size == 32) {
+      hiz->is_float = TRUE;
+      hiz->shift = chan->shift;
+      hiz->mask = ~0u;
+      hiz->margin = 0.0f;
+   }
+   else if (chan->type == UTIL_FORMAT_TYPE_UNSIGNED && chan->normalized &&
+            chan->size <= 32) {
+      hiz->is_float = FALSE;
+      hiz->shift = chan->shift;
+      hiz->mask = chan->size == 32 ? ~0u : (1u << chan->size) - 1;
+      /* covers rounding in the float to unorm conversion */
+      hiz->margin = 4.0f / hiz->mask;
+   }
+   else {
+      return;
+   }
+
+   if (hiz->shift + chan->size > 8 * scene->zsbuf.format_bytes ||
+       scene->zsbuf.format_bytes > 8)
+      return;
+
+   hiz->enabled = TRUE;
+}
+
+
+/**
+ * Forget all bounds at the start of a job.
+ */
+void
+lp_rast_hiz_begin_tile(struct lp_rasterizer_task *task)
+{
+   struct lp_rast_hiz *hiz = &task->hiz;
+   unsigned i;
+
+   /* the state gets set again by the bin */
+   hiz->cull = FALSE;
+   hiz->write = FALSE;
+
+   if (!hiz->enabled)
+      return;
+
+   for (i = 0; i < ARRAY_SIZE(hiz->dirty_4); i++)
+      hiz->dirty_4[i] = ~(uint64_t)0;
+   hiz->dirty_16 = ~0u;
+   hiz->dirty_job = TRUE;
+}
+
+
+void
+lp_rast_hiz_set_state(struct lp_rasterizer_task *task)
+{
+   struct lp_rast_hiz *hiz = &task->hiz;
+   const struct lp_fragment_shader_variant *variant;
+
+   if (!hiz->enabled || !task->state)
+      return;
+
+   variant = task->state->variant;
+
+   hiz->cull = variant->hiz_cull &&
+               variant->key.zsbuf_format == task->scene->fb.zsbuf->format;
+   hiz->write = variant->key.depth.enabled && variant->key.depth.writemask;
+   hiz->func = variant->key.depth.func;
+}
+
+
+static inline float
+unorm_to_float(const struct lp_rast_hiz *hiz, uint32_t value)
+{
+   return (float)((double)value / hiz->mask);
+}
+
+
+/**
+ * The depth buffer of the job was cleared.
+ */
+void
+lp_rast_hiz_clear(struct lp_rasterizer_task *task,
+                  uint64_t clear_value, uint64_t clear_mask)
+{
+   struct lp_rast_hiz *hiz = &task->hiz;
+   const uint64_t depth_mask = (uint64_t)hiz->mask << hiz->shift;
+   struct lp_rast_depth_bounds bounds;
+   unsigned bx, by, i;
+
+   if (!hiz->enabled || !(clear_mask & depth_mask))
+      return;
+
+   if ((clear_mask & depth_mask) != depth_mask) {
+      /* only some of the depth bits were cleared */
+      lp_rast_hiz_begin_tile(task);
+      lp_rast_hiz_set_state(task);
+      return;
+   }
+
+   if (hiz->is_float) {
+      union fi fi;
+
+      fi.ui = (uint32_t)(clear_value >> hiz->shift);
+      bounds.zmin = bounds.zmax = fi.f;
+   }
+   else {
+      uint32_t value = (uint32_t)(clear_value >> hiz->shift) & hiz->mask;
+
+      bounds.zmin = bounds.zmax = unorm_to_float(hiz, value);
+   }
+
+   for (i = 0; i < ARRAY_SIZE(hiz->bounds_16); i++) {
+      if (!(task->block_mask & (1 << i)))
+         continue;
+
+      bx = (i % (TILE_SIZE / 16)) * 4;
+      by = (i / (TILE_SIZE / 16)) * 4;
+
+      for (unsigned y = 0; y < 4; y++)
+         for (unsigned x = 0; x < 4; x++)
+            hiz->bounds_4[by + y][bx + x] = bounds;
+
+      hiz->bounds_16[i] = bounds;
+      hiz->dirty_4[i / (TILE_SIZE / 16)] &= ~(BLOCK_16_MASK << bx);
+      hiz->dirty_16 &= ~(1 << i);
+   }
+
+   hiz->bounds_job = bounds;
+   hiz->dirty_job = FALSE;
+}
+
+
+/**
+ * Compute the bounds of a 4x4 block from the depth buffer.
+ * \param bx, by  position of the block in the tile, in 4x4 blocks
+ */
+static void
+scan_block_4(const struct lp_rasterizer_task *task,
+             unsigned bx, unsigned by,
+             struct lp_rast_depth_bounds *bounds)
+{
+   const struct lp_rast_hiz *hiz = &task->hiz;
+   const unsigned format_bytes = task->scene->zsbuf.format_bytes;
+   const unsigned stride = task->scene->zsbuf.stride;
+   const unsigned px = bx * 4, py = by * 4;
+   const uint8_t *row;
+   unsigned width, height, x, y;
+
+   if (px >= task->width || py >= task->height) {
+      *bounds = empty_bounds;
+      return;
+   }
+
+   width = MIN2(4, task->width - px);
+   height = MIN2(4, task->height - py);
+   row = task->depth_tile + py * stride + px * format_bytes;
+
+   if (hiz->is_float) {
+      float zmin = FLT_MAX, zmax = -FLT_MAX;
+
+      for (y = 0; y < height; y++) {
+         for (x = 0; x < width; x++) {
+            const uint8_t *p = row + x * format_bytes + hiz->shift / 8;
+            float z;
+
+            memcpy(&z, p, sizeof z);
+            /* NaN never passes the depth test, so can be left out */
+            if (z < zmin)
+               zmin = z;
+            if (z > zmax)
+               zmax = z;
+         }
+         row += stride;
+      }
+
+      bounds->zmin = zmin;
+      bounds->zmax = zmax;
+   }
+   else {
+      uint32_t vmin = ~0u, vmax = 0;
+
+      for (y = 0; y < height; y++) {
+         for (x = 0; x < width; x++) {
+            const uint8_t *p = row + x * format_bytes;
+            uint64_t word = 0;
+            uint32_t v;
+
+            memcpy(&word, p, format_bytes);
+            v = (uint32_t)(word >> hiz->shift) & hiz->mask;
+            vmin = MIN2(vmin, v);
+            vmax = MAX2(vmax, v);
+         }
+         row += stride;
+      }
+
+      bounds->zmin = unorm_to_float(hiz, vmin);
+      bounds->zmax = unorm_to_float(hiz, vmax);
+   }
+}
+
+
+static inline void
+merge_bounds(struct lp_rast_depth_bounds *dst,
+             const struct lp_rast_depth_bounds *src)
+{
+   dst->zmin = MIN2(dst->zmin, src->zmin);
+   dst->zmax = MAX2(dst->zmax, src->zmax);
+}
+
+
+static const struct lp_rast_depth_bounds *
+get_bounds_4(struct lp_rasterizer_task *task, unsigned bx, unsigned by)
+{
+   struct lp_rast_hiz *hiz = &task->hiz;
+   const uint64_t bit = (uint64_t)1 << ((by % 4) * 16 + bx);
+
+   if (hiz->dirty_4[by / 4] & bit) {
+      scan_block_4(task, bx, by, &hiz->bounds_4[by][bx]);
+      hiz->dirty_4[by / 4] &= ~bit;
+   }
+
+   return &hiz->bounds_4[by][bx];
+}
+
+
+static const struct lp_rast_depth_bounds *
+get_bounds_16(struct lp_rasterizer_task *task, unsigned block)
+{
+   struct lp_rast_hiz *hiz = &task->hiz;
+
+   if (hiz->dirty_16 & (1 << block)) {
+      const unsigned bx = (block % (TILE_SIZE / 16)) * 4;
+      const unsigned by = (block / (TILE_SIZE / 16)) * 4;
+      uint64_t dirty = hiz->dirty_4[by / 4] & (BLOCK_16_MASK << bx);
+      struct lp_rast_depth_bounds bounds = empty_bounds;
+      unsigned x, y;
+
+      while (dirty) {
+         unsigned i = u_bit_scan64(&dirty);
+
+         scan_block_4(task, i % 16, by + i / 16,
+                      &hiz->bounds_4[by + i / 16][i % 16]);
+      }
+      hiz->dirty_4[by / 4] &= ~(BLOCK_16_MASK << bx);
+
+      for (y = 0; y < 4; y++)
+         for (x = 0; x < 4; x++)
+            merge_bounds(&bounds, &hiz->bounds_4[by + y][bx + x]);
+
+      hiz->bounds_16[block] = bounds;
+      hiz->dirty_16 &= ~(1 << block);
+   }
+
+   return &hiz->bounds_16[block];
+}
+
+
+static const struct lp_rast_depth_bounds *
+get_bounds_job(struct lp_rasterizer_task *task)
+{
+   struct lp_rast_hiz *hiz = &task->hiz;
+
+   if (hiz->dirty_job) {
+      struct lp_rast_depth_bounds bounds = empty_bounds;
+      unsigned mask = task->block_mask;
+
+      while (mask) {
+         unsigned block = u_bit_scan(&mask);
+
+         merge_bounds(&bounds, get_bounds_16(task, block));
+      }
+
+      hiz->bounds_job = bounds;
+      hiz->dirty_job = FALSE;
+   }
+
+   return &hiz->bounds_job;
+}
+
+
+/**
+ * Can the depth test reject all fragments of a triangle in a block?
+ * Called through lp_rast_hiz_reject().
+ * \param x, y  location of the block in window coords
+ * \param size  4, 16, or TILE_SIZE for the whole job
+ */
+boolean
+lp_rast_hiz_reject_block(struct lp_rasterizer_task *task,
+                         const struct lp_rast_shader_inputs *inputs,
+                         unsigned x, unsigned y, unsigned size)
+{
+   const struct lp_rast_hiz *hiz = &task->hiz;
+   const struct lp_rast_depth_bounds *bounds;
+   float a0, dzdx, dzdy, zx0, zx1, zy0, zy1, eps, zmin, zmax;
+   float x0 = x, y0 = y;
+   boolean reject;
+
+   switch (size) {
+   case 4:
+      bounds = get_bounds_4(task, (x % TILE_SIZE) / 4, (y % TILE_SIZE) / 4);
+      break;
+   case 16:
+      bounds = get_bounds_16(task, ((y % TILE_SIZE) / 16) * (TILE_SIZE / 16) +
+                                   (x % TILE_SIZE) / 16);
+      break;
+   default:
+      assert(size == TILE_SIZE);
+      x0 += task->job_x;
+      y0 += task->job_y;
+      bounds = get_bounds_job(task);
+      break;
+   }
+
+   /*
+    * Range of the triangle's depth plane over the block.  Fragments are
+    * sampled within [x0, x0 + size] x [y0, y0 + size], the plane's extremes
+    * are at the corners.
+    */
+   a0 = GET_A0(inputs)[0][2];
+   dzdx = GET_DADX(inputs)[0][2];
+   dzdy = GET_DADY(inputs)[0][2];
+
+   zx0 = dzdx * x0;
+   zx1 = dzdx * (x0 + (size == TILE_SIZE ? task->job_width : size));
+   zy0 = dzdy * y0;
+   zy1 = dzdy * (y0 + (size == TILE_SIZE ? task->job_height : size));
+
+   zmin = a0 + MIN2(zx0, zx1) + MIN2(zy0, zy1);
+   zmax = a0 + MAX2(zx0, zx1) + MAX2(zy0, zy1);
+
+   /*
+    * The fragment shader evaluates the plane in a different order, allow
+    * for a few ulps of the largest term of it, and for the conversion to
+    * the depth buffer format.
+    */
+   eps = (fabsf(a0) + MAX2(fabsf(zx0), fabsf(zx1)) +
+          MAX2(fabsf(zy0), fabsf(zy1))) * (1.0f / (1 << 18)) +
+         hiz->margin;
+
+   /* The interpolated depth may get clamped to [0, 1] before the test */
+   zmin = MIN2(zmin, CLAMP(zmin, 0.0f, 1.0f)) - eps;
+   zmax = MAX2(zmax, CLAMP(zmax, 0.0f, 1.0f)) + eps;
+
+   switch (hiz->func) {
+   case PIPE_FUNC_LESS:
+   case PIPE_FUNC_LEQUAL:
+      reject = zmin > bounds->zmax;
+      break;
+   case PIPE_FUNC_GREATER:
+   case PIPE_FUNC_GEQUAL:
+      reject = zmax < bounds->zmin;
+      break;
+   default:
+      reject = FALSE;
+      break;
+   }
+
+   if (reject) {
+      if (size == 4) {
+         task->counters.nr_hiz_rejected_4++;
+      } else if (size == 16) {
+         task->counters.nr_hiz_rejected_16++;
+      } else {
+         task->counters.nr_hiz_rejected_64++;
+      }
+   }
+
+   return reject;
+}
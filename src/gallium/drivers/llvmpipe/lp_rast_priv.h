@@ -29,6 +29,7 @@
 #define LP_RAST_PRIV_H
 
 #include "util/format/u_format.h"
+#include "util/u_atomic.h"
 #include "util/u_thread.h"
 #include "gallivm/lp_bld_debug.h"
 #include "lp_memory.h"
@@ -37,6 +38,7 @@
 #include "lp_state.h"
 #include "lp_texture.h"
 #include "lp_limits.h"
+#include "lp_perf.h"
 
 
 #define TILE_VECTOR_HEIGHT 4
@@ -76,6 +78,95 @@ extern const struct lp_rasterizer_task *jit_task;
 struct lp_rasterizer;
 struct cmd_bin;
 
+
+/** Block mask of a job which covers all 16x16 blocks of its tile */
+#define LP_RAST_JOB_FULL_TILE 0xffff
+
+/**
+ * A unit of rasterization work.  Usually this is a whole bin, but
+ * expensive bins may be split into one job per 32x32 quadrant so that
+ * several threads can work on them.
+ */
+struct lp_rast_job
+{
+   unsigned x, y;       /**< Pos of the bin, in tiles */
+   unsigned block_mask; /**< 16x16 blocks of the tile to rasterize */
+   unsigned cost;       /**< Estimated cost, in bin commands */
+};
+
+
+/**
+ * A thread's share of the current scene's jobs.
+ * This is the range [head, tail) of lp_rasterizer::jobs, with head in
+ * the low and tail in the high 32 bits.  The owning thread takes jobs
+ * from the head, idle threads steal them from the tail; both sides
+ * claim a job with a single compare-and-swap of the whole word.
+ * Each deque gets a cache line of its own.
+ */
+struct lp_rast_deque
+{
+   uint64_t range;
+   uint8_t pad[64 - sizeof(uint64_t)];
+};
+
+
+/**
+ * Per-thread scheduler statistics, see LP_RAST_STATS.
+ * The busy and idle times are kept in lp_rast_counters.
+ */
+struct lp_rast_thread_stats
+{
+   uint64_t scene_busy_ns; /**< busy time within the current scene */
+   unsigned jobs;
+   unsigned stolen;        /**< jobs taken from other threads' deques */
+};
+
+
+/**
+ * Conservative bounds of the depth buffer values in a block, as floats.
+ */
+struct lp_rast_depth_bounds
+{
+   float zmin;
+   float zmax;
+};
+
+
+/**
+ * Hierarchical depth (Hi-Z) state of a task, see lp_rast_hiz.c.
+ *
+ * Keeps depth bounds for every 4x4 and 16x16 block of the current job
+ * and for the job as a whole, so that the parts of a triangle which
+ * can't pass the depth test are skipped without running the fragment
+ * shader.  Bounds are exact after a clear, and recomputed from the depth
+ * buffer on demand for blocks the fragment shader wrote to.
+ */
+struct lp_rast_hiz
+{
+   boolean enabled;     /**< the scene's depth buffer is tracked */
+   boolean cull;        /**< the current state allows rejecting blocks */
+   boolean write;       /**< the current state may write depth */
+   unsigned func;       /**< PIPE_FUNC_x of the current state */
+
+   /* Depth buffer layout */
+   boolean is_float;
+   unsigned shift;
+   uint32_t mask;       /**< of unorm depth values, after shifting */
+   float margin;        /**< precision of unorm depth values */
+
+   /** 4x4 blocks with stale bounds, a word per row of 16x16 blocks */
+   uint64_t dirty_4[TILE_SIZE / 16];
+   /** 16x16 blocks with stale bounds */
+   unsigned dirty_16;
+   /** job bounds are stale */
+   boolean dirty_job;
+
+   struct lp_rast_depth_bounds bounds_4[TILE_SIZE / 4][TILE_SIZE / 4];
+   struct lp_rast_depth_bounds bounds_16[(TILE_SIZE / 16) * (TILE_SIZE / 16)];
+   struct lp_rast_depth_bounds bounds_job;
+};
+
+
 /**
  * Per-thread rasterization state
  */
@@ -88,6 +179,11 @@ struct lp_rasterizer_task
    unsigned x, y;          /**< Pos of this tile in framebuffer, in pixels */
    unsigned width, height; /**< width, height of current tile, in pixels */
 
+   /** 16x16 blocks of the current tile covered by the current job */
+   unsigned block_mask;
+   unsigned job_x, job_y;          /**< Pos of the job within the tile, in pixels */
+   unsigned job_width, job_height; /**< Size of the job, clipped to the tile */
+
    uint8_t *color_tiles[PIPE_MAX_COLOR_BUFS];
    uint8_t *depth_tile;
 
@@ -100,6 +196,12 @@ struct lp_rasterizer_task
    /** Non-interpolated passthru state and occlude counter for visible pixels */
    struct lp_jit_thread_data thread_data;
 
+   struct lp_rast_hiz hiz;
+
+   struct lp_rast_thread_stats stats;
+
+   struct lp_rast_counters counters;
+
    pipe_semaphore work_ready;
    pipe_semaphore work_done;
 };
@@ -122,20 +224,48 @@ struct lp_rasterizer
    struct lp_scene *curr_scene;
 
    /** A task object for each rasterization thread */
-   struct lp_rasterizer_task tasks[LP_MAX_THREADS];
+   struct lp_rasterizer_task *tasks;
 
    unsigned num_threads;
-   thrd_t threads[LP_MAX_THREADS];
+   thrd_t *threads;
+
+   /** Number of threads working on the current scene, including thread 0 */
+   unsigned curr_num_threads;
+
+   /** The current scene's jobs, grouped by the thread owning them */
+   struct lp_rast_job *jobs;
+   unsigned num_jobs;
+   unsigned max_jobs;
 
-   /** For synchronizing the rasterization threads */
-   util_barrier barrier;
+   /** One job deque per thread */
+   struct lp_rast_deque *deques;
+
+   /** Split expensive bins into quadrant jobs (LP_SPLIT_BINS) */
+   boolean split_bins;
+
+   /** Reject blocks by their depth bounds (LP_HIZ) */
+   boolean hiz;
+
+   /** Dump scheduler statistics at exit (LP_RAST_STATS) */
+   boolean dump_stats;
+   uint64_t scene_start_ns;
+   unsigned num_split_bins;
+
+   /**
+    * Copy of the threads' counters as of the end of the last scene,
+    * for lp_rast_get_counters().  Protected by counters_mutex.
+    */
+   mtx_t counters_mutex;
+   struct lp_rast_counters *counters;
+   uint64_t num_scenes;
+   uint64_t raster_ns;  /**< wall time spent rasterizing scenes */
 };
 
 void
 lp_rast_shade_quads_mask_sample(struct lp_rasterizer_task *task,
                                 const struct lp_rast_shader_inputs *inputs,
                                 unsigned x, unsigned y,
-                                uint64_t mask);
+                                const uint64_t *mask);
 void
 lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
                          const struct lp_rast_shader_inputs *inputs,
@@ -143,6 +273,75 @@ lp_rast_shade_quads_mask(struct lp_rasterizer_task *task,
                          unsigned mask);
 
 
+void
+lp_rast_hiz_begin_scene(struct lp_rasterizer_task *task);
+
+void
+lp_rast_hiz_begin_tile(struct lp_rasterizer_task *task);
+
+void
+lp_rast_hiz_set_state(struct lp_rasterizer_task *task);
+
+void
+lp_rast_hiz_clear(struct lp_rasterizer_task *task,
+                  uint64_t clear_value, uint64_t clear_mask);
+
+boolean
+lp_rast_hiz_reject_block(struct lp_rasterizer_task *task,
+                         const struct lp_rast_shader_inputs *inputs,
+                         unsigned x, unsigned y, unsigned size);
+
+
+/**
+ * Can the depth test reject all fragments of a triangle in a block?
+ * \param x, y  location of the block in window coords
+ * \param size  4, 16, or TILE_SIZE for the whole job
+ */
+static inline boolean
+lp_rast_hiz_reject(struct lp_rasterizer_task *task,
+                   const struct lp_rast_shader_inputs *inputs,
+                   unsigned x, unsigned y, unsigned size)
+{
+   return task->hiz.cull &&
+          lp_rast_hiz_reject_block(task, inputs, x, y, size);
+}
+
+
+/**
+ * Note that the fragment shader ran on a 4x4 block, and may have changed
+ * its depth values.
+ * \param x, y  location of the block in window coords
+ */
+static inline void
+lp_rast_hiz_written(struct lp_rasterizer_task *task,
+                    unsigned x, unsigned y)
+{
+   if (task->hiz.write) {
+      unsigned bx = (x % TILE_SIZE) / 4;
+      unsigned by = (y % TILE_SIZE) / 4;
+
+      task->hiz.dirty_4[by / 4] |= (uint64_t)1 << ((by % 4) * 16 + bx);
+      task->hiz.dirty_16 |= 1 << ((by / 4) * (TILE_SIZE / 16) + bx / 4);
+      task->hiz.dirty_job = TRUE;
+   }
+}
+
+
+/**
+ * Is the 4x4 block at x, y part of the task's current job?
+ * \param x, y location of 4x4 block in window coords
+ */
+static inline boolean
+lp_rast_block_in_job(const struct lp_rasterizer_task *task,
+                     unsigned x, unsigned y)
+{
+   unsigned block = ((y % TILE_SIZE) / 16) * (TILE_SIZE / 16) +
+                    (x % TILE_SIZE) / 16;
+
+   return (task->block_mask >> block) & 1;
+}
+
+
 /**
  * Get the pointer to a 4x4 color block (within a 64x64 tile).
  * \param x, y location of 4x4 block in window coords
@@ -219,6 +418,24 @@ lp_rast_get_depth_block_pointer(struct lp_rasterizer_task *task,
 
 
 
+/**
+ * Build the per-sample coverage of a 4x4 block whose samples are all
+ * covered like the pixels in pixel_mask.
+ */
+static inline void
+lp_rast_replicate_mask(uint64_t mask[LP_RAST_MASK_WORDS],
+                       unsigned nr_samples, unsigned pixel_mask)
+{
+   uint64_t word = 0;
+   unsigned i;
+
+   for (i = 0; i < MIN2(nr_samples, 4); i++)
+      word |= (uint64_t)pixel_mask << (16 * i);
+   for (i = 0; i < LP_RAST_MASK_WORDS; i++)
+      mask[i] = i * 4 < nr_samples ? word : 0;
+}
+
+
 /**
  * Shade all pixels in a 4x4 block.  The fragment code omits the
  * triangle in/out tests.
@@ -231,7 +448,7 @@ lp_rast_shade_quads_all( struct lp_rasterizer_task *task,
 {
    const struct lp_scene *scene = task->scene;
    const struct lp_rast_state *state = task->state;
-   struct lp_fragment_shader_variant *variant = state->variant;
+   const lp_jit_frag_func *jit_funcs = p_atomic_read(&state->variant->jit_funcs);
    uint8_t *color[PIPE_MAX_COLOR_BUFS];
    unsigned stride[PIPE_MAX_COLOR_BUFS];
    unsigned sample_stride[PIPE_MAX_COLOR_BUFS];
@@ -261,34 +478,38 @@ lp_rast_shade_quads_all( struct lp_rasterizer_task *task,
       depth_stride = scene->zsbuf.stride;
    }
 
-   uint64_t mask = 0;
-   for (unsigned i = 0; i < scene->fb_max_samples; i++)
-      mask |= (uint64_t)0xffff << (16 * i);
+   uint64_t mask[LP_RAST_MASK_WORDS];
+   lp_rast_replicate_mask(mask, scene->fb_max_samples, 0xffff);
 
    /*
     * The rasterizer may produce fragments outside our
     * allocated 4x4 blocks hence need to filter them out here.
+    * Blocks outside the current job belong to another job.
     */
-   if ((x % TILE_SIZE) < task->width && (y % TILE_SIZE) < task->height) {
+   if ((x % TILE_SIZE) < task->width && (y % TILE_SIZE) < task->height &&
+       lp_rast_block_in_job(task, x, y) &&
+       !lp_rast_hiz_reject(task, inputs, x, y, 4)) {
       /* Propagate non-interpolated raster state. */
       task->thread_data.raster_state.viewport_index = inputs->viewport_index;
 
+      lp_rast_hiz_written(task, x, y);
+
       /* run shader on 4x4 block */
       BEGIN_JIT_CALL(state, task);
-      variant->jit_function[RAST_WHOLE]( &state->jit_context,
-                                         x, y,
-                                         inputs->frontfacing,
-                                         GET_A0(inputs),
-                                         GET_DADX(inputs),
-                                         GET_DADY(inputs),
-                                         color,
-                                         depth,
-                                         mask,
-                                         &task->thread_data,
-                                         stride,
-                                         depth_stride,
-                                         sample_stride,
-                                         depth_sample_stride);
+      jit_funcs[RAST_WHOLE]( &state->jit_context,
+                             x, y,
+                             inputs->frontfacing,
+                             GET_A0(inputs),
+                             GET_DADX(inputs),
+                             GET_DADY(inputs),
+                             color,
+                             depth,
+                             mask,
+                             &task->thread_data,
+                             stride,
+                             depth_stride,
+                             sample_stride,
+                             depth_sample_stride);
       END_JIT_CALL();
    }
 }
@@ -50,7 +50,10 @@ TAG(do_block_4)(struct lp_rasterizer_task *task,
 #ifndef MULTISAMPLE
    unsigned mask = 0xffff;
 #else
-   uint64_t mask = UINT64_MAX;
+   const unsigned nr_samples = task->scene->fb_max_samples;
+   uint64_t mask[LP_RAST_MASK_WORDS];
+   uint64_t any = 0;
+   lp_rast_replicate_mask(mask, nr_samples, 0xffff);
 #endif
 
    for (j = 0; j < NR_PLANES; j++) {
@@ -65,7 +68,7 @@ TAG(do_block_4)(struct lp_rasterizer_task *task,
                                  plane[j].dcdy);
 #endif
 #else
-      for (unsigned s = 0; s < 4; s++) {
+      for (unsigned s = 0; s < nr_samples; s++) {
          int64_t new_c = (c[j]) + ((IMUL64(task->scene->fixed_sample_pos[s][1], plane[j].dcdy) + IMUL64(task->scene->fixed_sample_pos[s][0], -plane[j].dcdx)) >> FIXED_ORDER);
          uint32_t build_mask;
 #ifdef RASTER_64
@@ -77,15 +80,24 @@ TAG(do_block_4)(struct lp_rasterizer_task *task,
                                         -plane[j].dcdx,
                                         plane[j].dcdy);
 #endif
-         mask &= ~((uint64_t)build_mask << (s * 16));
+         mask[s / 4] &= ~((uint64_t)build_mask << ((s % 4) * 16));
       }
 #endif
    }
 
    /* Now pass to the shader:
     */
-   if (mask)
+#ifndef MULTISAMPLE
+   if (mask) {
+      uint64_t mask64 = mask;
+      lp_rast_shade_quads_mask_sample(task, &tri->inputs, x, y, &mask64);
+   }
+#else
+   for (j = 0; j < LP_RAST_MASK_WORDS; j++)
+      any |= mask[j];
+   if (any)
       lp_rast_shade_quads_mask_sample(task, &tri->inputs, x, y, mask);
+#endif
 }
 
 /**
@@ -149,7 +161,7 @@ TAG(do_block_16)(struct lp_rasterizer_task *task,
 
    assert((partial_mask & inmask) == 0);
 
-   LP_COUNT_ADD(nr_empty_4, util_bitcount(0xffff & ~(partial_mask | inmask)));
+   task->counters.nr_empty_4 += util_bitcount(0xffff & ~(partial_mask | inmask));
 
    /* Iterate over partials:
     */
@@ -163,7 +175,7 @@ TAG(do_block_16)(struct lp_rasterizer_task *task,
 
       partial_mask &= ~(1 << i);
 
-      LP_COUNT(nr_partially_covered_4);
+      task->counters.nr_partially_covered_4++;
 
       for (j = 0; j < NR_PLANES; j++)
          cx[j] = (c[j] 
@@ -184,7 +196,7 @@ TAG(do_block_16)(struct lp_rasterizer_task *task,
 
       inmask &= ~(1 << i);
 
-      LP_COUNT(nr_fully_covered_4);
+      task->counters.nr_fully_covered_4++;
       block_full_4(task, tri, px, py);
    }
 }
@@ -212,6 +224,9 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
       return;
    }
 
+   if (lp_rast_hiz_reject(task, &tri->inputs, x, y, TILE_SIZE))
+      return;
+
    outmask = 0;                 /* outside one or more trivial reject planes */
    partmask = 0;                /* outside one or more trivial accept planes */
 
@@ -289,6 +304,11 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
       j++;
    }
 
+   /* Sub-blocks outside the current job are left to other jobs:
+    */
+   outmask |= ~task->block_mask & 0xffff;
+   partmask |= ~task->block_mask & 0xffff;
+
    if (outmask == 0xffff)
       return;
 
@@ -303,7 +323,9 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
 
    assert((partial_mask & inmask) == 0);
 
-   LP_COUNT_ADD(nr_empty_16, util_bitcount(0xffff & ~(partial_mask | inmask)));
+   /* Only count the sub-blocks of this job as empty */
+   task->counters.nr_empty_16 +=
+      util_bitcount(task->block_mask & ~(partial_mask | inmask));
 
    /* Iterate over partials:
     */
@@ -315,14 +337,17 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
       int py = y + iy;
       int64_t cx[NR_PLANES];
 
+      partial_mask &= ~(1 << i);
+
+      if (lp_rast_hiz_reject(task, &tri->inputs, px, py, 16))
+         continue;
+
       for (j = 0; j < NR_PLANES; j++)
          cx[j] = (c[j]
                   - IMUL64(plane[j].dcdx, ix)
                   + IMUL64(plane[j].dcdy, iy));
 
-      partial_mask &= ~(1 << i);
-
-      LP_COUNT(nr_partially_covered_16);
+      task->counters.nr_partially_covered_16++;
       TAG(do_block_16)(task, tri, plane, px, py, cx);
    }
 
@@ -337,7 +362,10 @@ TAG(lp_rast_triangle)(struct lp_rasterizer_task *task,
 
       inmask &= ~(1 << i);
 
-      LP_COUNT(nr_fully_covered_16);
+      if (lp_rast_hiz_reject(task, &tri->inputs, px, py, 16))
+         continue;
+
+      task->counters.nr_fully_covered_16++;
       block_full_16(task, tri, px, py);
    }
 }
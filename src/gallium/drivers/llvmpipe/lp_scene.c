@@ -62,8 +62,6 @@ lp_scene_create( struct pipe_context *pipe )
    scene->data.head =
       CALLOC_STRUCT(data_block);
 
-   (void) mtx_init(&scene->mutex, mtx_plain);
-
 #ifdef DEBUG
    /* Do some scene limit sanity checks here */
    {
@@ -90,7 +88,6 @@ void
 lp_scene_destroy(struct lp_scene *scene)
 {
    lp_fence_reference(&scene->fence, NULL);
-   mtx_destroy(&scene->mutex);
    assert(scene->data.head->next == NULL);
    FREE(scene->data.head);
    FREE(scene);
@@ -211,12 +208,13 @@ lp_scene_begin_rasterization(struct lp_scene *scene)
 
 
 /**
- * Free all the temporary data in a scene.
+ * Unmap the framebuffer surfaces mapped in lp_scene_begin_rasterization().
+ * Called by the rasterizer once all threads are done with the scene.
  */
 void
 lp_scene_end_rasterization(struct lp_scene *scene )
 {
-   int i, j;
+   int i;
 
    /* Unmap color buffers */
    for (i = 0; i < scene->fb.nr_cbufs; i++) {
@@ -239,6 +237,48 @@ lp_scene_end_rasterization(struct lp_scene *scene )
                               zsbuf->u.tex.first_layer);
       scene->zsbuf.map = NULL;
    }
+}
+
+
+/**
+ * Decrement the ref counts of all resources in a reference list.
+ */
+static int
+release_resource_refs(struct resource_ref *list, int j)
+{
+   struct resource_ref *ref;
+   int i;
+
+   for (ref = list; ref; ref = ref->next) {
+      for (i = 0; i < ref->count; i++) {
+         if (LP_DEBUG & DEBUG_SETUP)
+            debug_printf("resource %d: %p %dx%d sz %d\n",
+                         j,
+                         (void *) ref->resource[i],
+                         ref->resource[i]->width0,
+                         ref->resource[i]->height0,
+                         llvmpipe_resource_size(ref->resource[i]));
+         j++;
+         pipe_resource_reference(&ref->resource[i], NULL);
+      }
+   }
+
+   return j;
+}
+
+
+/**
+ * Free all the temporary data in a scene.
+ * Called by the setup code, either when the scene's fence has been
+ * signalled or when binning failed.
+ */
+void
+lp_scene_reset(struct lp_scene *scene )
+{
+   int i, j;
+
+   /* The rasterizer must be done with the scene. */
+   assert(!scene->zsbuf.map);
 
    /* Reset all command lists:
     */
@@ -258,28 +298,12 @@ lp_scene_end_rasterization(struct lp_scene *scene )
 
    /* Decrement texture ref counts
     */
-   {
-      struct resource_ref *ref;
-      int i, j = 0;
-
-      for (ref = scene->resources; ref; ref = ref->next) {
-         for (i = 0; i < ref->count; i++) {
-            if (LP_DEBUG & DEBUG_SETUP)
-               debug_printf("resource %d: %p %dx%d sz %d\n",
-                            j,
-                            (void *) ref->resource[i],
-                            ref->resource[i]->width0,
-                            ref->resource[i]->height0,
-                            llvmpipe_resource_size(ref->resource[i]));
-            j++;
-            pipe_resource_reference(&ref->resource[i], NULL);
-         }
-      }
+   j = release_resource_refs(scene->resources, 0);
+   j = release_resource_refs(scene->writeable_resources, j);
 
-      if (LP_DEBUG & DEBUG_SETUP)
-         debug_printf("scene %d resources, sz %d\n",
-                      j, scene->resource_reference_size);
-   }
+   if (LP_DEBUG & DEBUG_SETUP)
+      debug_printf("scene %d resources, sz %d\n",
+                   j, scene->resource_reference_size);
 
    /* Free all scene data blocks:
     */
@@ -299,18 +323,137 @@ lp_scene_end_rasterization(struct lp_scene *scene )
    lp_fence_reference(&scene->fence, NULL);
 
    scene->resources = NULL;
+   scene->writeable_resources = NULL;
    scene->scene_size = 0;
    scene->resource_reference_size = 0;
 
    scene->alloc_failed = FALSE;
+   memset(scene->fork_data, 0, sizeof(scene->fork_data));
 
    util_unreference_framebuffer_state( &scene->fb );
 }
 
 
+/**
+ * Make fork an empty scene for binning part of a draw into scene.
+ *
+ * The fork has its own bins and data blocks, so it can be binned into on
+ * another thread while nothing else happens to scene, and allocates at
+ * most max_size bytes.  lp_scene_join() then hands everything over to
+ * scene.  Forks with different index may bin at the same time, a fork
+ * with the same index later on continues in the data block left by the
+ * previous one.
+ */
+boolean
+lp_scene_fork(struct lp_scene *fork, const struct lp_scene *scene,
+              unsigned index, unsigned max_size)
+{
+   unsigned i, j;
+
+   assert(index < LP_MAX_SCENE_FORKS);
+
+   fork->pipe = scene->pipe;
+   fork->had_queries = scene->had_queries;
+   fork->fb_max_layer = scene->fb_max_layer;
+   fork->fb_max_samples = scene->fb_max_samples;
+   memcpy(fork->fixed_sample_pos, scene->fixed_sample_pos,
+          sizeof(fork->fixed_sample_pos));
+   /* not referenced, the fork never outlives the draw */
+   fork->fb = scene->fb;
+   fork->tiles_x = scene->tiles_x;
+   fork->tiles_y = scene->tiles_y;
+   fork->parent = scene;
+   fork->fork_index = index;
+#ifdef DEBUG
+   memset(&fork->count, 0, sizeof fork->count);
+#endif
+
+   for (i = 0; i < fork->tiles_x; i++) {
+      for (j = 0; j < fork->tiles_y; j++) {
+         struct cmd_bin *bin = lp_scene_get_bin(fork, i, j);
+         bin->head = NULL;
+         bin->tail = NULL;
+         bin->last_state = NULL;
+      }
+   }
+
+   /* The fork's list has no embedded first block, its new blocks get
+    * moved to the parent's list and it only borrows the one it starts in.
+    */
+   max_size = MIN2(max_size, LP_SCENE_MAX_SIZE);
+   fork->scene_size = LP_SCENE_MAX_SIZE - max_size;
+   fork->alloc_failed = FALSE;
+   fork->data.head = scene->fork_data[index];
+
+   if (!fork->data.head)
+      return lp_scene_new_data_block(fork) != NULL;
+
+   return TRUE;
+}
+
+
+/**
+ * Move the data blocks of a fork to scene, and if keep_bins append the
+ * fork's commands to the ones of the same bins of scene and add its
+ * counters to lp_count.
+ *
+ * Forks of a draw must be joined in primitive order.
+ */
+void
+lp_scene_join(struct lp_scene *scene, struct lp_scene *fork,
+              boolean keep_bins)
+{
+   struct data_block *borrowed = scene->fork_data[fork->fork_index];
+   struct data_block *block, *last = NULL;
+   unsigned i, j;
+
+   assert(fork->parent == scene);
+
+   if (keep_bins) {
+      for (i = 0; i < fork->tiles_x; i++) {
+         for (j = 0; j < fork->tiles_y; j++) {
+            struct cmd_bin *forked = lp_scene_get_bin(fork, i, j);
+            struct cmd_bin *bin;
+
+            if (!forked->head)
+               continue;
+
+            bin = lp_scene_get_bin(scene, i, j);
+            if (bin->tail)
+               bin->tail->next = forked->head;
+            else
+               bin->head = forked->head;
+            bin->tail = forked->tail;
+            bin->last_state = forked->last_state;
+         }
+      }
 
+#ifdef DEBUG
+      lp_count.nr_tris += fork->count.nr_tris;
+      lp_count.nr_culled_tris += fork->count.nr_culled_tris;
+      lp_count.nr_empty_64 += fork->count.nr_empty_64;
+      lp_count.nr_fully_covered_64 += fork->count.nr_fully_covered_64;
+      lp_count.nr_partially_covered_64 += fork->count.nr_partially_covered_64;
+      lp_count.nr_shade_64 += fork->count.nr_shade_64;
+      lp_count.nr_shade_opaque_64 += fork->count.nr_shade_opaque_64;
+#endif
+   }
 
+   /* Keep the head of scene's list as its current block, the rest gets
+    * freed with the scene.
+    */
+   for (block = fork->data.head; block != borrowed; block = block->next) {
+      scene->scene_size += sizeof *block;
+      last = block;
+   }
+   if (last) {
+      last->next = scene->data.head->next;
+      scene->data.head->next = fork->data.head;
+   }
 
+   scene->fork_data[fork->fork_index] = fork->data.head;
+   fork->data.head = NULL;
+}
 
 struct cmd_block *
 lp_scene_new_cmd_block( struct lp_scene *scene,
@@ -381,14 +524,17 @@ lp_scene_data_size( const struct lp_scene *scene )
 boolean
 lp_scene_add_resource_reference(struct lp_scene *scene,
                                 struct pipe_resource *resource,
-                                boolean initializing_scene)
+                                boolean initializing_scene,
+                                boolean writeable)
 {
-   struct resource_ref *ref, **last = &scene->resources;
+   struct resource_ref *ref, **last;
    int i;
 
+   last = writeable ? &scene->writeable_resources : &scene->resources;
+
    /* Look at existing resource blocks:
     */
-   for (ref = scene->resources; ref; ref = ref->next) {
+   for (ref = *last; ref; ref = ref->next) {
       last = &ref->next;
 
       /* Search for this resource:
@@ -434,17 +580,14 @@ lp_scene_add_resource_reference(struct lp_scene *scene,
 }
 
 
-/**
- * Does this scene have a reference to the given resource?
- */
-boolean
-lp_scene_is_resource_referenced(const struct lp_scene *scene,
-                                const struct pipe_resource *resource)
+static boolean
+resource_ref_list_contains(const struct resource_ref *list,
+                           const struct pipe_resource *resource)
 {
    const struct resource_ref *ref;
    int i;
 
-   for (ref = scene->resources; ref; ref = ref->next) {
+   for (ref = list; ref; ref = ref->next) {
       for (i = 0; i < ref->count; i++)
          if (ref->resource[i] == resource)
             return TRUE;
@@ -454,66 +597,36 @@ lp_scene_is_resource_referenced(const struct lp_scene *scene,
 }
 
 
-
-
-/** advance curr_x,y to the next bin */
-static boolean
-next_bin(struct lp_scene *scene)
-{
-   scene->curr_x++;
-   if (scene->curr_x >= scene->tiles_x) {
-      scene->curr_x = 0;
-      scene->curr_y++;
-   }
-   if (scene->curr_y >= scene->tiles_y) {
-      /* no more bins */
-      return FALSE;
-   }
-   return TRUE;
-}
-
-
-void
-lp_scene_bin_iter_begin( struct lp_scene *scene )
-{
-   scene->curr_x = scene->curr_y = -1;
-}
-
-
 /**
- * Return pointer to next bin to be rendered.
- * The lp_scene::curr_x and ::curr_y fields will be advanced.
- * Multiple rendering threads will call this function to get a chunk
- * of work (a bin) to work on.
+ * Does this scene have a reference to the given resource?
+ * Returns a mask of LP_REFERENCED_FOR_READ/WRITE flags.
  */
-struct cmd_bin *
-lp_scene_bin_iter_next( struct lp_scene *scene , int *x, int *y)
+unsigned
+lp_scene_is_resource_referenced(const struct lp_scene *scene,
+                                const struct pipe_resource *resource)
 {
-   struct cmd_bin *bin = NULL;
-
-   mtx_lock(&scene->mutex);
+   int i;
 
-   if (scene->curr_x < 0) {
-      /* first bin */
-      scene->curr_x = 0;
-      scene->curr_y = 0;
-   }
-   else if (!next_bin(scene)) {
-      /* no more bins left */
-      goto end;
+   /* The render targets are written by the scene */
+   for (i = 0; i < scene->fb.nr_cbufs; i++) {
+      if (scene->fb.cbufs[i] && scene->fb.cbufs[i]->texture == resource)
+         return LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
    }
+   if (scene->fb.zsbuf && scene->fb.zsbuf->texture == resource)
+      return LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
+
+   if (resource_ref_list_contains(scene->writeable_resources, resource))
+      return LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
 
-   bin = lp_scene_get_bin(scene, scene->curr_x, scene->curr_y);
-   *x = scene->curr_x;
-   *y = scene->curr_y;
+   if (resource_ref_list_contains(scene->resources, resource))
+      return LP_REFERENCED_FOR_READ;
 
-end:
-   /*printf("return bin %p at %d, %d\n", (void *) bin, *bin_x, *bin_y);*/
-   mtx_unlock(&scene->mutex);
-   return bin;
+   return LP_UNREFERENCED;
 }
 
 
+
+
 void lp_scene_begin_binning(struct lp_scene *scene,
                             struct pipe_framebuffer_state *fb)
 {
@@ -553,11 +666,10 @@ void lp_scene_begin_binning(struct lp_scene *scene,
    }
    scene->fb_max_layer = max_layer;
    scene->fb_max_samples = util_framebuffer_get_num_samples(fb);
-   if (scene->fb_max_samples == 4) {
-      for (unsigned i = 0; i < 4; i++) {
-         scene->fixed_sample_pos[i][0] = util_iround(lp_sample_pos_4x[i][0] * FIXED_ONE);
-         scene->fixed_sample_pos[i][1] = util_iround(lp_sample_pos_4x[i][1] * FIXED_ONE);
-      }
+   const float (*sample_pos)[2] = lp_sample_pos(scene->fb_max_samples);
+   for (unsigned i = 0; i < scene->fb_max_samples; i++) {
+      scene->fixed_sample_pos[i][0] = sample_pos ? util_iround(sample_pos[i][0] * FIXED_ONE) : FIXED_ONE / 2;
+      scene->fixed_sample_pos[i][1] = sample_pos ? util_iround(sample_pos[i][1] * FIXED_ONE) : FIXED_ONE / 2;
    }
 }
 
@@ -38,6 +38,7 @@
 #include "os/os_thread.h"
 #include "lp_rast.h"
 #include "lp_debug.h"
+#include "lp_perf.h"
 
 struct lp_scene_queue;
 struct lp_rast_state;
@@ -67,6 +68,10 @@ struct lp_rast_state;
  */
 #define LP_SCENE_MAX_RESOURCE_SIZE (64*1024*1024)
 
+/* Max number of forks binning a draw into a scene at once:
+ */
+#define LP_MAX_SCENE_FORKS 8
+
 
 /* switch to a non-pointer value for this:
  */
@@ -122,8 +127,9 @@ struct resource_ref;
  * Per-bin data goes into the 'tile' bins.
  * Shared data goes into the 'data' buffer.
  *
- * When there are multiple threads, will want to double-buffer between
- * scenes:
+ * Each setup context owns a small ring of these, so that a new scene
+ * can be binned while older ones are still being rasterized.  A scene
+ * is in flight from lp_rast_queue_scene() until its fence is signalled.
  */
 struct lp_scene {
    struct pipe_context *pipe;
@@ -162,6 +168,9 @@ struct lp_scene {
    /** list of resources referenced by the scene commands */
    struct resource_ref *resources;
 
+   /** list of resources written by the scene commands (ssbos, images) */
+   struct resource_ref *writeable_resources;
+
    /** Total memory used by the scene (in bytes).  This sums all the
     * data blocks and counts all bins, state, resource references and
     * other random allocations within the scene.
@@ -180,11 +189,20 @@ struct lp_scene {
     */
    unsigned tiles_x, tiles_y;
 
-   int curr_x, curr_y;  /**< for iterating over bins */
-   mtx_t mutex;
-
    struct cmd_bin tile[TILES_X][TILES_Y];
    struct data_block_list data;
+
+   /** Blocks the forks of the scene allocate from, see lp_scene_fork() */
+   struct data_block *fork_data[LP_MAX_SCENE_FORKS];
+
+   /** Scene this one bins part of a draw for, and its slot there */
+   const struct lp_scene *parent;
+   unsigned fork_index;
+
+#ifdef DEBUG
+   /** lp_count counters of a fork, see LP_SCENE_COUNT() */
+   struct lp_counters count;
+#endif
 };
 
 
@@ -204,10 +222,11 @@ struct cmd_block *lp_scene_new_cmd_block( struct lp_scene *scene,
 
 boolean lp_scene_add_resource_reference(struct lp_scene *scene,
                                         struct pipe_resource *resource,
-                                        boolean initializing_scene);
+                                        boolean initializing_scene,
+                                        boolean writeable);
 
-boolean lp_scene_is_resource_referenced(const struct lp_scene *scene,
-                                        const struct pipe_resource *resource );
+unsigned lp_scene_is_resource_referenced(const struct lp_scene *scene,
+                                         const struct pipe_resource *resource );
 
 
 /**
@@ -385,12 +404,6 @@ lp_scene_get_num_bins( const struct lp_scene *scene )
 }
 
 
-void
-lp_scene_bin_iter_begin( struct lp_scene *scene );
-
-struct cmd_bin *
-lp_scene_bin_iter_next( struct lp_scene *scene, int *x, int *y );
-
 
 
 /* Begin/end binning of a scene
@@ -412,6 +425,24 @@ void
 lp_scene_end_rasterization(struct lp_scene *scene);
 
 
+/* Release all bins, data and references of a rasterized scene so it
+ * can be reused for binning.
+ */
+void
+lp_scene_reset(struct lp_scene *scene);
+
+
+/* Fork/join a scene for binning a draw on several threads.
+ */
+boolean
+lp_scene_fork(struct lp_scene *fork, const struct lp_scene *scene,
+              unsigned index, unsigned max_size);
+
+void
+lp_scene_join(struct lp_scene *scene, struct lp_scene *fork,
+              boolean keep_bins);
+
+
 
 
 
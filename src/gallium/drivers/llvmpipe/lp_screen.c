@@ -38,6 +38,8 @@
 #include "draw/draw_context.h"
 #include "gallivm/lp_bld_type.h"
 #include "gallivm/lp_bld_nir.h"
+#include "gallivm/lp_bld_debug.h"
+#include "gallivm/lp_bld_misc.h"
 #include "util/disk_cache.h"
 #include "util/os_misc.h"
 #include "util/os_time.h"
@@ -50,6 +52,7 @@
 #include "lp_public.h"
 #include "lp_limits.h"
 #include "lp_rast.h"
+#include "lp_query.h"
 #include "lp_cs_tpool.h"
 
 #include "frontend/sw_winsys.h"
@@ -680,7 +683,8 @@ llvmpipe_is_format_supported( struct pipe_screen *_screen,
           target == PIPE_TEXTURE_CUBE ||
           target == PIPE_TEXTURE_CUBE_ARRAY);
 
-   if (sample_count != 0 && sample_count != 1 && sample_count != 4)
+   if (sample_count != 0 && sample_count != 1 && sample_count != 4 &&
+       sample_count != 8 && sample_count != 16)
       return false;
 
    if (MAX2(1, sample_count) != MAX2(1, storage_sample_count))
@@ -770,6 +774,18 @@ llvmpipe_flush_frontbuffer(struct pipe_screen *_screen,
    struct llvmpipe_screen *screen = llvmpipe_screen(_screen);
    struct sw_winsys *winsys = screen->winsys;
    struct llvmpipe_resource *texture = llvmpipe_resource(resource);
+   struct lp_fence *fence = NULL;
+
+   /* Scenes are rasterized asynchronously and in order, so wait for the
+    * last queued one before presenting.
+    */
+   mtx_lock(&screen->rast_mutex);
+   lp_fence_reference(&fence, screen->last_fence);
+   mtx_unlock(&screen->rast_mutex);
+   if (fence) {
+      lp_fence_wait(fence);
+      lp_fence_reference(&fence, NULL);
+   }
 
    assert(texture->dt);
    if (texture->dt)
@@ -785,14 +801,36 @@ llvmpipe_destroy_screen( struct pipe_screen *_screen )
    if (screen->cs_tpool)
       lp_cs_tpool_destroy(screen->cs_tpool);
 
+   if (screen->num_vs_threads)
+      util_queue_destroy(&screen->vs_queue);
+
    if (screen->rast)
       lp_rast_destroy(screen->rast);
 
+   lp_fence_reference(&screen->last_fence, NULL);
+
+   if (screen->async_fs)
+      util_queue_destroy(&screen->fs_compile_queue);
+
    lp_jit_screen_cleanup(screen);
 
-   if (LP_DEBUG & DEBUG_CACHE_STATS)
+   if (LP_DEBUG & DEBUG_CACHE_STATS) {
+      struct gallivm_stats stats;
+
       printf("disk shader cache:   hits = %u, misses = %u\n", screen->num_disk_shader_cache_hits,
              screen->num_disk_shader_cache_misses);
+      if (screen->async_fs)
+         printf("async fs compiles:   %u, draws using fallback code = %u\n",
+                screen->num_fs_async_compiles, screen->num_fs_fallback_draws);
+
+      gallivm_get_stats(&stats);
+      printf("jit:                 modules = %" PRIu64 ", functions = %" PRIu64 "\n",
+             stats.num_modules, stats.num_functions);
+      printf("jit time:            opt = %.2f ms, codegen = %.2f ms\n",
+             stats.opt_nsecs / 1e6, stats.codegen_nsecs / 1e6);
+      printf("jit code size:       current = %" PRIu64 " bytes, peak = %" PRIu64 " bytes\n",
+             stats.code_size, stats.max_code_size);
+   }
    disk_cache_destroy(screen->disk_shader_cache);
    if(winsys->destroy)
       winsys->destroy(winsys);
@@ -801,6 +839,9 @@ llvmpipe_destroy_screen( struct pipe_screen *_screen )
 
    mtx_destroy(&screen->rast_mutex);
    mtx_destroy(&screen->cs_mutex);
+   mtx_destroy(&screen->ctx_mutex);
+   slab_destroy_parent(&screen->pool_transfers);
+   FREE(screen->thread_query_names);
    FREE(screen);
 }
 
@@ -862,6 +903,24 @@ static void lp_disk_cache_create(struct llvmpipe_screen *screen)
        !disk_cache_get_function_identifier(LLVMLinkInMCJIT, &ctx))
       return;
 
+   /* The cache holds machine code, which must not be shared between CPUs
+    * with different features, nor between optimized and unoptimized builds,
+    * nor between the MCJIT and ORC backends.  The vector widths can be
+    * overridden and decide how shaders are vectorized.
+    */
+   lp_build_hash_target_machine(&ctx);
+   _mesa_sha1_update(&ctx, &lp_native_vector_width, sizeof(lp_native_vector_width));
+   _mesa_sha1_update(&ctx, &lp_wide_vector_width, sizeof(lp_wide_vector_width));
+   unsigned no_opt = !!(gallivm_perf & GALLIVM_PERF_NO_OPT);
+   _mesa_sha1_update(&ctx, &no_opt, sizeof(no_opt));
+   unsigned no_uniform_cf = !!(gallivm_perf & GALLIVM_PERF_NO_UNIFORM_CF);
+   _mesa_sha1_update(&ctx, &no_uniform_cf, sizeof(no_uniform_cf));
+   unsigned orcjit = !!gallivm_use_orcjit;
+   _mesa_sha1_update(&ctx, &orcjit, sizeof(orcjit));
+   /* Shaders using shared sampling functions only reference them. */
+   unsigned shared_tex_funcs = !!screen->sample_funcs;
+   _mesa_sha1_update(&ctx, &shared_tex_funcs, sizeof(shared_tex_funcs));
+
    _mesa_sha1_final(&ctx, sha1);
    disk_cache_format_hex_id(cache_id, sha1, 20 * 2);
 
@@ -968,7 +1027,9 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    screen->num_threads = 0;
 #endif
    screen->num_threads = debug_get_num_option("LP_NUM_THREADS", screen->num_threads);
-   screen->num_threads = MIN2(screen->num_threads, LP_MAX_THREADS);
+   /* the thread issuing a draw shades vertices too */
+   screen->num_vs_threads = debug_get_num_option("LP_NUM_VS_THREADS",
+                                                 MAX2(screen->num_threads, 1) - 1);
 
    screen->rast = lp_rast_create(screen->num_threads);
    if (!screen->rast) {
@@ -978,6 +1039,8 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
    }
    (void) mtx_init(&screen->rast_mutex, mtx_plain);
 
+   llvmpipe_init_screen_query_funcs(screen);
+
    screen->cs_tpool = lp_cs_tpool_create(screen->num_threads);
    if (!screen->cs_tpool) {
       lp_rast_destroy(screen->rast);
@@ -986,6 +1049,27 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
       return NULL;
    }
    (void) mtx_init(&screen->cs_mutex, mtx_plain);
+   (void) mtx_init(&screen->ctx_mutex, mtx_plain);
+
+   screen->num_vs_threads = MIN2(screen->num_vs_threads, DRAW_MAX_VS_THREADS);
+   if (screen->num_vs_threads &&
+       !util_queue_init(&screen->vs_queue, "lpvs", screen->num_vs_threads * 4,
+                        screen->num_vs_threads,
+                        UTIL_QUEUE_INIT_RESIZE_IF_FULL))
+      screen->num_vs_threads = 0;
+
+   slab_create_parent(&screen->pool_transfers,
+                      sizeof(struct llvmpipe_transfer), 16);
+
+   screen->tiled_textures = debug_get_bool_option("LP_TILED_TEXTURES", FALSE);
+
+   screen->async_fs = debug_get_bool_option("LP_ASYNC_FS", FALSE);
+   if (screen->async_fs &&
+       !util_queue_init(&screen->fs_compile_queue, "lpfs", 32,
+                        MAX2(1, util_cpu_caps.nr_cpus / 4),
+                        UTIL_QUEUE_INIT_RESIZE_IF_FULL |
+                        UTIL_QUEUE_INIT_USE_MINIMUM_PRIORITY))
+      screen->async_fs = FALSE;
 
    lp_disk_cache_create(screen);
    return &screen->base;
@@ -37,11 +37,14 @@
 #include "pipe/p_screen.h"
 #include "pipe/p_defines.h"
 #include "os/os_thread.h"
+#include "util/u_queue.h"
+#include "util/slab.h"
 #include "gallivm/lp_bld.h"
 #include "gallivm/lp_bld_misc.h"
 
 struct sw_winsys;
 struct lp_cs_tpool;
+struct lp_fence;
 
 struct llvmpipe_screen
 {
@@ -50,6 +53,7 @@ struct llvmpipe_screen
    struct sw_winsys *winsys;
 
    unsigned num_threads;
+   unsigned num_vs_threads;  /**< draw module vertex shading threads */
 
    /* Increments whenever textures are modified.  Contexts can track this.
     */
@@ -58,14 +62,42 @@ struct llvmpipe_screen
    struct lp_rasterizer *rast;
    mtx_t rast_mutex;
 
+   /** Fence of the last scene queued by any context, under rast_mutex */
+   struct lp_fence *last_fence;
+
    struct lp_cs_tpool *cs_tpool;
    mtx_t cs_mutex;
 
+   /** Number of live contexts, see llvmpipe_replace_buffer_storage() */
+   unsigned num_contexts;
+   mtx_t ctx_mutex;
+
+   /** Vertex shading threads, shared by the draw modules of all contexts */
+   struct util_queue vs_queue;
+
    bool use_tgsi;
 
+   /** Names of the per-thread busy and idle time driver queries */
+   char (*thread_query_names)[32];
+
+   /** Store sampled-only textures in tiles (LP_TILED_TEXTURES) */
+   bool tiled_textures;
+
+   /** Sampling functions shared by all variants (LP_SHARED_TEX_FUNCS) */
+   struct lp_sample_func_cache *sample_funcs;
+
    struct disk_cache *disk_shader_cache;
    unsigned num_disk_shader_cache_hits;
    unsigned num_disk_shader_cache_misses;
+
+   /** Background compilation of fragment shader variants (LP_ASYNC_FS) */
+   bool async_fs;
+   struct util_queue fs_compile_queue;
+   unsigned num_fs_async_compiles;
+   unsigned num_fs_fallback_draws;
+
+   /** Transfers of the u_threaded_context wrapping the contexts */
+   struct slab_parent_pool pool_transfers;
 };
 
 void lp_disk_cache_find_shader(struct llvmpipe_screen *screen,
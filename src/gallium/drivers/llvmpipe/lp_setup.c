@@ -64,26 +64,67 @@ static boolean set_scene_state( struct lp_setup_context *, enum setup_state,
 static boolean try_update_scene_state( struct lp_setup_context *setup );
 
 
+/**
+ * Release a scene whose rasterization has completed, so that it can be
+ * used for binning again.
+ */
+static void
+lp_setup_retire_scene(struct lp_scene *scene)
+{
+   if (scene->fence) {
+      /* Also makes sure the rasterizer has let go of the fence mutex. */
+      lp_fence_wait(scene->fence);
+      lp_scene_reset(scene);
+   }
+}
+
+
 static void
 lp_setup_get_empty_scene(struct lp_setup_context *setup)
 {
+   struct lp_scene *scene = NULL;
+   unsigned i;
+
    assert(setup->scene == NULL);
 
-   setup->scene_idx++;
-   setup->scene_idx %= ARRAY_SIZE(setup->scenes);
+   /* Prefer a scene which is idle or has finished rasterizing.
+    */
+   for (i = 0; i < setup->num_active_scenes; i++) {
+      struct lp_scene *s = setup->scenes[i];
+      if (!s->fence || lp_fence_signalled(s->fence)) {
+         scene = s;
+         break;
+      }
+   }
+
+   /* All scenes are in flight, grow the ring if we can.
+    */
+   if (!scene && setup->num_active_scenes < MAX_SCENES) {
+      scene = lp_scene_create(setup->pipe);
+      if (scene)
+         setup->scenes[setup->num_active_scenes++] = scene;
+   }
 
-   setup->scene = setup->scenes[setup->scene_idx];
+   /* Otherwise wait for the oldest scene to be rasterized.
+    */
+   if (!scene) {
+      scene = setup->scenes[0];
+      for (i = 1; i < setup->num_active_scenes; i++) {
+         struct lp_scene *s = setup->scenes[i];
+         if ((int)(s->fence->id - scene->fence->id) < 0)
+            scene = s;
+      }
 
-   if (setup->scene->fence) {
       if (LP_DEBUG & DEBUG_SETUP)
          debug_printf("%s: wait for scene %d\n",
-                      __FUNCTION__, setup->scene->fence->id);
-
-      lp_fence_wait(setup->scene->fence);
+                      __FUNCTION__, scene->fence->id);
    }
 
-   lp_scene_begin_binning(setup->scene, &setup->fb);
+   lp_setup_retire_scene(scene);
+
+   lp_scene_begin_binning(scene, &setup->fb);
 
+   setup->scene = scene;
 }
 
 
@@ -98,6 +139,16 @@ first_triangle( struct lp_setup_context *setup,
    setup->triangle( setup, v0, v1, v2 );
 }
 
+static unsigned
+first_triangles( struct lp_setup_context *setup,
+                 const float (*const *v)[4],
+                 unsigned nr )
+{
+   assert(setup->state == SETUP_ACTIVE);
+   lp_setup_choose_triangle( setup );
+   return setup->triangles( setup, v, nr );
+}
+
 static void
 first_line( struct lp_setup_context *setup,
 	    const float (*v0)[4],
@@ -144,6 +195,7 @@ void lp_setup_reset( struct lp_setup_context *setup )
    setup->line = first_line;
    setup->point = first_point;
    setup->triangle = first_triangle;
+   setup->triangles = first_triangles;
 }
 
 
@@ -160,6 +212,12 @@ lp_setup_rasterize_scene( struct lp_setup_context *setup )
 
    lp_scene_end_binning(scene);
 
+   if (setup->binning_start_ns) {
+      setup->counters.binning_ns += os_time_get_nano() - setup->binning_start_ns;
+      setup->binning_start_ns = 0;
+   }
+   setup->counters.nr_scenes++;
+
    lp_fence_reference(&setup->last_fence, scene->fence);
 
    if (setup->last_fence)
@@ -167,21 +225,15 @@ lp_setup_rasterize_scene( struct lp_setup_context *setup )
 
    mtx_lock(&screen->rast_mutex);
 
-   /* FIXME: We enqueue the scene then wait on the rasterizer to finish.
-    * This means we never actually run any vertex stuff in parallel to
-    * rasterization (not in the same context at least) which is what the
-    * multiple scenes per setup is about - when we get a new empty scene
-    * any old one is already empty again because we waited here for
-    * raster tasks to be finished. Ideally, we shouldn't need to wait here
-    * and rely on fences elsewhere when waiting is necessary.
-    * Certainly, lp_scene_end_rasterization() would need to be deferred too
-    * and there's probably other bits why this doesn't actually work.
+   /* We don't wait for the rasterizer here.  The scene stays referenced
+    * by setup->scenes[] and is recycled in lp_setup_get_empty_scene()
+    * once its fence has been signalled, which lets us bin the next scene
+    * while this one is rasterized.
     */
+   lp_fence_reference(&screen->last_fence, scene->fence);
    lp_rast_queue_scene(screen->rast, scene);
-   lp_rast_finish(screen->rast);
    mtx_unlock(&screen->rast_mutex);
 
-   lp_scene_end_rasterization(setup->scene);
    lp_setup_reset( setup );
 
    LP_DBG(DEBUG_SETUP, "%s done \n", __FUNCTION__);
@@ -199,9 +251,12 @@ begin_binning( struct lp_setup_context *setup )
    assert(scene);
    assert(scene->fence == NULL);
 
-   /* Always create a fence:
+   setup->binning_start_ns = os_time_get_nano();
+
+   /* Always create a fence.  It is signalled by the rasterizer once
+    * all threads are done with the scene:
     */
-   scene->fence = lp_fence_create(MAX2(1, setup->num_threads));
+   scene->fence = lp_fence_create(1);
    if (!scene->fence)
       return FALSE;
 
@@ -342,7 +397,7 @@ set_scene_state( struct lp_setup_context *setup,
 
 fail:
    if (setup->scene) {
-      lp_scene_end_rasterization(setup->scene);
+      lp_scene_reset(setup->scene);
       setup->scene = NULL;
    }
 
@@ -575,6 +630,7 @@ lp_setup_set_triangle_state( struct lp_setup_context *setup,
    setup->ccw_is_frontface = ccw_is_frontface;
    setup->cullmode = cull_mode;
    setup->triangle = first_triangle;
+   setup->triangles = first_triangles;
    setup->multisample = multisample;
    setup->pixel_offset = half_pixel_center ? 0.5f : 0.0f;
    setup->bottom_edge_rule = bottom_edge_rule;
@@ -829,6 +885,7 @@ lp_setup_set_rasterizer_discard(struct lp_setup_context *setup,
       setup->line = first_line;
       setup->point = first_point;
       setup->triangle = first_triangle;
+      setup->triangles = first_triangles;
    }
 }
 
@@ -1070,6 +1127,7 @@ unsigned
 lp_setup_is_resource_referenced( const struct lp_setup_context *setup,
                                 const struct pipe_resource *texture )
 {
+   unsigned referenced = LP_UNREFERENCED;
    unsigned i;
 
    /* check the render targets */
@@ -1081,11 +1139,17 @@ lp_setup_is_resource_referenced( const struct lp_setup_context *setup,
       return LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
    }
 
-   /* check textures referenced by the scene */
-   for (i = 0; i < ARRAY_SIZE(setup->scenes); i++) {
-      if (lp_scene_is_resource_referenced(setup->scenes[i], texture)) {
-         return LP_REFERENCED_FOR_READ;
-      }
+   /* check resources referenced by the scenes still being built or
+    * rasterized.  Scenes whose fence has been signalled are done with
+    * their resources, even if they haven't been recycled yet.
+    */
+   for (i = 0; i < setup->num_active_scenes; i++) {
+      const struct lp_scene *scene = setup->scenes[i];
+      if (scene->fence && lp_fence_signalled(scene->fence))
+         continue;
+      referenced |= lp_scene_is_resource_referenced(scene, texture);
+      if (referenced & LP_REFERENCED_FOR_WRITE)
+         return referenced;
    }
 
    for (i = 0; i < ARRAY_SIZE(setup->ssbos); i++) {
@@ -1098,7 +1162,58 @@ lp_setup_is_resource_referenced( const struct lp_setup_context *setup,
          return LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
    }
 
-   return LP_UNREFERENCED;
+   return referenced;
+}
+
+
+/**
+ * Are there scenes which have been queued for rasterization but whose
+ * fence hasn't been signalled yet?
+ */
+boolean
+lp_setup_has_queued_scenes(const struct lp_setup_context *setup)
+{
+   unsigned i;
+
+   for (i = 0; i < setup->num_active_scenes; i++) {
+      const struct lp_scene *scene = setup->scenes[i];
+      if (scene != setup->scene &&
+          scene->fence && !lp_fence_signalled(scene->fence))
+         return TRUE;
+   }
+
+   return FALSE;
+}
+
+
+/**
+ * Wait for queued scenes which conflict with an access to the given
+ * resource from the context thread.  Unlike llvmpipe_flush_resource()
+ * this never flushes the scene currently being binned.
+ */
+void
+lp_setup_wait_for_resource(struct lp_setup_context *setup,
+                           const struct pipe_resource *resource,
+                           boolean read_only)
+{
+   unsigned i;
+
+   for (i = 0; i < setup->num_active_scenes; i++) {
+      struct lp_scene *scene = setup->scenes[i];
+      unsigned referenced;
+
+      if (scene == setup->scene ||
+          !scene->fence || lp_fence_signalled(scene->fence))
+         continue;
+
+      referenced = lp_scene_is_resource_referenced(scene, resource);
+      if ((referenced & LP_REFERENCED_FOR_WRITE) ||
+          ((referenced & LP_REFERENCED_FOR_READ) && !read_only)) {
+         LP_DBG(DEBUG_SETUP, "%s: wait for scene %d\n",
+                __FUNCTION__, scene->fence->id);
+         lp_fence_wait(scene->fence);
+      }
+   }
 }
 
 
@@ -1260,8 +1375,33 @@ try_update_scene_state( struct lp_setup_context *setup )
             setup->fs.current.jit_context.num_ssbos[i] = 0;
          }
          setup->dirty |= LP_SETUP_NEW_FS;
+
+         /* The scene may write the buffer, so make sure CPU access waits
+          * for the scene to be rasterized.
+          */
+         if (!lp_scene_add_resource_reference(scene, buffer,
+                                              new_scene, TRUE)) {
+            assert(!new_scene);
+            return FALSE;
+         }
       }
    }
+
+   if (setup->dirty & LP_SETUP_NEW_IMAGES) {
+      for (i = 0; i < ARRAY_SIZE(setup->images); ++i) {
+         struct pipe_resource *res = setup->images[i].current.resource;
+
+         if (!res)
+            continue;
+
+         if (!lp_scene_add_resource_reference(scene, res,
+                                              new_scene, TRUE)) {
+            assert(!new_scene);
+            return FALSE;
+         }
+      }
+      setup->dirty |= LP_SETUP_NEW_FS;
+   }
    if (setup->dirty & LP_SETUP_NEW_FS) {
       if (!setup->fs.stored ||
           memcmp(setup->fs.stored,
@@ -1292,7 +1432,7 @@ try_update_scene_state( struct lp_setup_context *setup )
             if (setup->fs.current_tex[i]) {
                if (!lp_scene_add_resource_reference(scene,
                                                     setup->fs.current_tex[i],
-                                                    new_scene)) {
+                                                    new_scene, FALSE)) {
                   assert(!new_scene);
                   return FALSE;
                }
@@ -1417,12 +1557,11 @@ lp_setup_destroy( struct lp_setup_context *setup )
       pipe_resource_reference(&setup->ssbos[i].current.buffer, NULL);
    }
 
-   /* free the scenes in the 'empty' queue */
-   for (i = 0; i < ARRAY_SIZE(setup->scenes); i++) {
+   /* wait for the scenes still in flight and free them all */
+   for (i = 0; i < setup->num_active_scenes; i++) {
       struct lp_scene *scene = setup->scenes[i];
 
-      if (scene->fence)
-         lp_fence_wait(scene->fence);
+      lp_setup_retire_scene(scene);
 
       lp_scene_destroy(scene);
    }
@@ -1444,7 +1583,6 @@ lp_setup_create( struct pipe_context *pipe,
 {
    struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
    struct lp_setup_context *setup;
-   unsigned i;
 
    setup = CALLOC_STRUCT(lp_setup_context);
    if (!setup) {
@@ -1467,15 +1605,15 @@ lp_setup_create( struct pipe_context *pipe,
    draw_set_rasterize_stage(draw, setup->vbuf);
    draw_set_render(draw, &setup->base);
 
-   /* create some empty scenes */
-   for (i = 0; i < MAX_SCENES; i++) {
-      setup->scenes[i] = lp_scene_create( pipe );
-      if (!setup->scenes[i]) {
-         goto no_scenes;
-      }
+   /* create the first empty scene, more are created on demand */
+   setup->scenes[0] = lp_scene_create( pipe );
+   if (!setup->scenes[0]) {
+      goto no_scenes;
    }
+   setup->num_active_scenes = 1;
 
    setup->triangle = first_triangle;
+   setup->triangles = first_triangles;
    setup->line     = first_line;
    setup->point    = first_point;
    
@@ -1488,12 +1626,6 @@ lp_setup_create( struct pipe_context *pipe,
    return setup;
 
 no_scenes:
-   for (i = 0; i < MAX_SCENES; i++) {
-      if (setup->scenes[i]) {
-         lp_scene_destroy(setup->scenes[i]);
-      }
-   }
-
    setup->vbuf->destroy(setup->vbuf);
 no_vbuf:
    FREE(setup);
@@ -1621,6 +1753,16 @@ fail:
 }
 
 
+/**
+ * Counters of the binning done by this setup context.
+ */
+const struct lp_setup_counters *
+lp_setup_get_counters(const struct lp_setup_context *setup)
+{
+   return &setup->counters;
+}
+
+
 boolean
 lp_setup_flush_and_restart(struct lp_setup_context *setup)
 {
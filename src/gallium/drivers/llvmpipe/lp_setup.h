@@ -46,6 +46,7 @@ struct llvmpipe_query;
 struct pipe_fence_handle;
 struct lp_setup_variant;
 struct lp_setup_context;
+struct lp_setup_counters;
 
 void lp_setup_reset( struct lp_setup_context *setup );
 
@@ -150,6 +151,14 @@ unsigned
 lp_setup_is_resource_referenced( const struct lp_setup_context *setup,
                                 const struct pipe_resource *texture );
 
+boolean
+lp_setup_has_queued_scenes(const struct lp_setup_context *setup);
+
+void
+lp_setup_wait_for_resource(struct lp_setup_context *setup,
+                           const struct pipe_resource *resource,
+                           boolean read_only);
+
 void
 lp_setup_set_sample_mask(struct lp_setup_context *setup,
                          uint32_t sample_mask);
@@ -174,6 +183,9 @@ void
 lp_setup_end_query(struct lp_setup_context *setup,
                    struct llvmpipe_query *pq);
 
+const struct lp_setup_counters *
+lp_setup_get_counters(const struct lp_setup_context *setup);
+
 static inline unsigned
 lp_clamp_viewport_idx(int idx)
 {
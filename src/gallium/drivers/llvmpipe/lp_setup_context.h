@@ -38,6 +38,7 @@
 #include "lp_setup.h"
 #include "lp_rast.h"
 #include "lp_scene.h"
+#include "lp_perf.h"
 #include "lp_bld_interp.h"	/* for struct lp_shader_input */
 
 #include "draw/draw_vbuf.h"
@@ -53,11 +54,14 @@
 #define LP_SETUP_NEW_IMAGES      0x40
 
 struct lp_setup_variant;
+struct lp_setup_bin_job;
 
 
-/** Max number of scenes */
-/* XXX: make multiple scenes per context work, see lp_setup_rasterize_scene */
-#define MAX_SCENES 1
+/**
+ * Max number of scenes per context.  Scenes are created on demand, so
+ * a context only grows its ring when binning gets ahead of rasterization.
+ */
+#define MAX_SCENES 4
 
 
 
@@ -88,7 +92,7 @@ struct lp_setup_context
     */
    struct draw_stage *vbuf;
    unsigned num_threads;
-   unsigned scene_idx;
+   unsigned num_active_scenes;
    struct lp_scene *scenes[MAX_SCENES];  /**< all the scenes */
    struct lp_scene *scene;               /**< current scene being built */
 
@@ -166,6 +170,9 @@ struct lp_setup_context
 
    unsigned dirty;   /**< bitmask of LP_SETUP_NEW_x bits */
 
+   struct lp_setup_counters counters;
+   uint64_t binning_start_ns;  /**< when the current scene got active */
+
    void (*point)( struct lp_setup_context *,
                   const float (*v0)[4]);
 
@@ -177,6 +184,16 @@ struct lp_setup_context
                      const float (*v0)[4],
                      const float (*v1)[4],
                      const float (*v2)[4]);
+
+   /* nr <= LP_SETUP_TRI_BATCH triangles, three vertices each, returns
+    * how many got binned
+    */
+   unsigned (*triangles)( struct lp_setup_context *,
+                          const float (*const *v)[4],
+                          unsigned nr );
+
+   /** binning large draws on several threads, see lp_setup_vbuf.c */
+   struct lp_setup_bin_job *bin_jobs[LP_MAX_SCENE_FORKS];
 };
 
 static inline void
@@ -200,6 +217,14 @@ void lp_setup_choose_point( struct lp_setup_context *setup );
 
 void lp_setup_init_vbuf(struct lp_setup_context *setup);
 
+boolean
+lp_setup_can_fork_triangles(const struct lp_setup_context *setup);
+
+void
+lp_setup_fork_triangles(struct lp_setup_context *fork,
+                        const struct lp_setup_context *setup,
+                        struct lp_scene *scene);
+
 boolean lp_setup_update_state( struct lp_setup_context *setup,
                             boolean update_scene);
 
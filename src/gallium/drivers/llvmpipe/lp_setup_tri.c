@@ -35,6 +35,7 @@
 #include "util/u_sse.h"
 #include "lp_perf.h"
 #include "lp_setup_context.h"
+#include "lp_setup_tri_batch.h"
 #include "lp_rast.h"
 #include "lp_state_fs.h"
 #include "lp_state_setup.h"
@@ -73,6 +74,286 @@ struct fixed_position {
 };
 
 
+/**
+ * Bounding rectangle (in pixels) of a triangle.
+ */
+static inline void
+calc_fixed_bbox(const struct fixed_position *position,
+                boolean bottom_edge_rule,
+                struct u_rect *bbox)
+{
+   /* Yes this is necessary to accurately calculate bounding boxes
+    * with the two fill-conventions we support.  GL (normally) ends
+    * up needing a bottom-left fill convention, which requires
+    * slightly different rounding.
+    */
+   int adj = bottom_edge_rule ? 1 : 0;
+
+   /* Inclusive x0, exclusive x1 */
+   bbox->x0 =  MIN3(position->x[0], position->x[1], position->x[2]) >> FIXED_ORDER;
+   bbox->x1 = (MAX3(position->x[0], position->x[1], position->x[2]) - 1) >> FIXED_ORDER;
+
+   /* Inclusive / exclusive depending upon adj (bottom-left or top-right) */
+   bbox->y0 = (MIN3(position->y[0], position->y[1], position->y[2]) + adj) >> FIXED_ORDER;
+   bbox->y1 = (MAX3(position->y[0], position->y[1], position->y[2]) - 1 + adj) >> FIXED_ORDER;
+}
+
+
+/**
+ * Edge equations of a counter-clockwise triangle.
+ * \param small  whether the framebuffer and bounding box are small enough
+ *               for 32 bit c values, only used on POWER8
+ */
+static inline void
+calc_fixed_planes(const struct fixed_position *position,
+                  boolean bottom_edge_rule,
+                  boolean small,
+                  struct lp_rast_plane *plane)
+{
+#if defined(PIPE_ARCH_SSE)
+   if (1) {
+      __m128i vertx, verty;
+      __m128i shufx, shufy;
+      __m128i dcdx, dcdy;
+      __m128i cdx02, cdx13, cdy02, cdy13, c02, c13;
+      __m128i c01, c23, unused;
+      __m128i dcdx_neg_mask;
+      __m128i dcdy_neg_mask;
+      __m128i dcdx_zero_mask;
+      __m128i top_left_flag, c_dec;
+      __m128i eo, p0, p1, p2;
+      __m128i zero = _mm_setzero_si128();
+
+      vertx = _mm_load_si128((__m128i *)position->x); /* vertex x coords */
+      verty = _mm_load_si128((__m128i *)position->y); /* vertex y coords */
+
+      shufx = _mm_shuffle_epi32(vertx, _MM_SHUFFLE(3,0,2,1));
+      shufy = _mm_shuffle_epi32(verty, _MM_SHUFFLE(3,0,2,1));
+
+      dcdx = _mm_sub_epi32(verty, shufy);
+      dcdy = _mm_sub_epi32(vertx, shufx);
+
+      dcdx_neg_mask = _mm_srai_epi32(dcdx, 31);
+      dcdx_zero_mask = _mm_cmpeq_epi32(dcdx, zero);
+      dcdy_neg_mask = _mm_srai_epi32(dcdy, 31);
+
+      top_left_flag = _mm_set1_epi32(bottom_edge_rule ? 0 : ~0);
+
+      c_dec = _mm_or_si128(dcdx_neg_mask,
+                           _mm_and_si128(dcdx_zero_mask,
+                                         _mm_xor_si128(dcdy_neg_mask,
+                                                       top_left_flag)));
+
+      /*
+       * 64 bit arithmetic.
+       * Note we need _signed_ mul (_mm_mul_epi32) which we emulate.
+       */
+      cdx02 = mm_mullohi_epi32(dcdx, vertx, &cdx13);
+      cdy02 = mm_mullohi_epi32(dcdy, verty, &cdy13);
+      c02 = _mm_sub_epi64(cdx02, cdy02);
+      c13 = _mm_sub_epi64(cdx13, cdy13);
+      c02 = _mm_sub_epi64(c02, _mm_shuffle_epi32(c_dec,
+                                                 _MM_SHUFFLE(2,2,0,0)));
+      c13 = _mm_sub_epi64(c13, _mm_shuffle_epi32(c_dec,
+                                                 _MM_SHUFFLE(3,3,1,1)));
+
+      /*
+       * Useful for very small fbs/tris (or fewer subpixel bits) only:
+       * c = _mm_sub_epi32(mm_mullo_epi32(dcdx, vertx),
+       *                   mm_mullo_epi32(dcdy, verty));
+       *
+       * c = _mm_sub_epi32(c, c_dec);
+       */
+
+      /* Scale up to match c:
+       */
+      dcdx = _mm_slli_epi32(dcdx, FIXED_ORDER);
+      dcdy = _mm_slli_epi32(dcdy, FIXED_ORDER);
+
+      /*
+       * Calculate trivial reject values:
+       * Note eo cannot overflow even if dcdx/dcdy would already have
+       * 31 bits (which they shouldn't have). This is because eo
+       * is never negative (albeit if we rely on that need to be careful...)
+       */
+      eo = _mm_sub_epi32(_mm_andnot_si128(dcdy_neg_mask, dcdy),
+                         _mm_and_si128(dcdx_neg_mask, dcdx));
+
+      /* ei = _mm_sub_epi32(_mm_sub_epi32(dcdy, dcdx), eo); */
+
+      /*
+       * Pointless transpose which gets undone immediately in
+       * rasterization.
+       * It is actually difficult to do away with it - would essentially
+       * need GET_PLANES_DX, GET_PLANES_DY etc., but the calculations
+       * for this then would need to depend on the number of planes.
+       * The transpose is quite special here due to c being 64bit...
+       * The store has to be unaligned (unless we'd make the plane size
+       * a multiple of 128), and of course storing eo separately...
+       */
+      c01 = _mm_unpacklo_epi64(c02, c13);
+      c23 = _mm_unpackhi_epi64(c02, c13);
+      transpose2_64_2_32(&c01, &c23, &dcdx, &dcdy,
+                         &p0, &p1, &p2, &unused);
+      _mm_storeu_si128((__m128i *)&plane[0], p0);
+      plane[0].eo = (uint32_t)_mm_cvtsi128_si32(eo);
+      _mm_storeu_si128((__m128i *)&plane[1], p1);
+      eo = _mm_shuffle_epi32(eo, _MM_SHUFFLE(3,2,0,1));
+      plane[1].eo = (uint32_t)_mm_cvtsi128_si32(eo);
+      _mm_storeu_si128((__m128i *)&plane[2], p2);
+      eo = _mm_shuffle_epi32(eo, _MM_SHUFFLE(0,0,0,2));
+      plane[2].eo = (uint32_t)_mm_cvtsi128_si32(eo);
+   } else
+#elif defined(_ARCH_PWR8) && UTIL_ARCH_LITTLE_ENDIAN
+   /*
+    * XXX this code is effectively disabled for all practical purposes,
+    * as the allowed fb size is tiny if FIXED_ORDER is 8.
+    */
+   if (small) {
+      unsigned int bottom_edge;
+      __m128i vertx, verty;
+      __m128i shufx, shufy;
+      __m128i dcdx, dcdy, c;
+      __m128i unused;
+      __m128i dcdx_neg_mask;
+      __m128i dcdy_neg_mask;
+      __m128i dcdx_zero_mask;
+      __m128i top_left_flag;
+      __m128i c_inc_mask, c_inc;
+      __m128i eo, p0, p1, p2;
+      __m128i_union vshuf_mask;
+      __m128i zero = vec_splats((unsigned char) 0);
+      PIPE_ALIGN_VAR(16) int32_t temp_vec[4];
+
+#if UTIL_ARCH_LITTLE_ENDIAN
+      vshuf_mask.i[0] = 0x07060504;
+      vshuf_mask.i[1] = 0x0B0A0908;
+      vshuf_mask.i[2] = 0x03020100;
+      vshuf_mask.i[3] = 0x0F0E0D0C;
+#else
+      vshuf_mask.i[0] = 0x00010203;
+      vshuf_mask.i[1] = 0x0C0D0E0F;
+      vshuf_mask.i[2] = 0x04050607;
+      vshuf_mask.i[3] = 0x08090A0B;
+#endif
+
+      /* vertex x coords */
+      vertx = vec_load_si128((const uint32_t *) position->x);
+      /* vertex y coords */
+      verty = vec_load_si128((const uint32_t *) position->y);
+
+      shufx = vec_perm (vertx, vertx, vshuf_mask.m128i);
+      shufy = vec_perm (verty, verty, vshuf_mask.m128i);
+
+      dcdx = vec_sub_epi32(verty, shufy);
+      dcdy = vec_sub_epi32(vertx, shufx);
+
+      dcdx_neg_mask = vec_srai_epi32(dcdx, 31);
+      dcdx_zero_mask = vec_cmpeq_epi32(dcdx, zero);
+      dcdy_neg_mask = vec_srai_epi32(dcdy, 31);
+
+      bottom_edge = bottom_edge_rule ? 0 : ~0;
+      top_left_flag = (__m128i) vec_splats(bottom_edge);
+
+      c_inc_mask = vec_or(dcdx_neg_mask,
+                                vec_and(dcdx_zero_mask,
+                                              vec_xor(dcdy_neg_mask,
+                                                            top_left_flag)));
+
+      c_inc = vec_srli_epi32(c_inc_mask, 31);
+
+      c = vec_sub_epi32(vec_mullo_epi32(dcdx, vertx),
+                        vec_mullo_epi32(dcdy, verty));
+
+      c = vec_add_epi32(c, c_inc);
+
+      /* Scale up to match c:
+       */
+      dcdx = vec_slli_epi32(dcdx, FIXED_ORDER);
+      dcdy = vec_slli_epi32(dcdy, FIXED_ORDER);
+
+      /* Calculate trivial reject values:
+       */
+      eo = vec_sub_epi32(vec_andnot_si128(dcdy_neg_mask, dcdy),
+                         vec_and(dcdx_neg_mask, dcdx));
+
+      /* ei = _mm_sub_epi32(_mm_sub_epi32(dcdy, dcdx), eo); */
+
+      /* Pointless transpose which gets undone immediately in
+       * rasterization:
+       */
+      transpose4_epi32(&c, &dcdx, &dcdy, &eo,
+                       &p0, &p1, &p2, &unused);
+
+#define STORE_PLANE(plane, vec) do {                  \
+         vec_store_si128((uint32_t *)&temp_vec, vec); \
+         plane.c    = (int64_t)temp_vec[0];           \
+         plane.dcdx = temp_vec[1];                    \
+         plane.dcdy = temp_vec[2];                    \
+         plane.eo   = temp_vec[3];                    \
+      } while(0)
+
+      STORE_PLANE(plane[0], p0);
+      STORE_PLANE(plane[1], p1);
+      STORE_PLANE(plane[2], p2);
+#undef STORE_PLANE
+   } else
+#endif
+   {
+      int i;
+      plane[0].dcdy = position->dx01;
+      plane[1].dcdy = position->x[1] - position->x[2];
+      plane[2].dcdy = position->dx20;
+      plane[0].dcdx = position->dy01;
+      plane[1].dcdx = position->y[1] - position->y[2];
+      plane[2].dcdx = position->dy20;
+  
+      for (i = 0; i < 3; i++) {
+         /* half-edge constants, will be iterated over the whole render
+          * target.
+          */
+         plane[i].c = IMUL64(plane[i].dcdx, position->x[i]) -
+                      IMUL64(plane[i].dcdy, position->y[i]);
+
+         /* correct for top-left vs. bottom-left fill convention.
+          */
+         if (plane[i].dcdx < 0) {
+            /* both fill conventions want this - adjust for left edges */
+            plane[i].c++;
+         }
+         else if (plane[i].dcdx == 0) {
+            if (!bottom_edge_rule) {
+               /* correct for top-left fill convention:
+                */
+               if (plane[i].dcdy > 0) plane[i].c++;
+            }
+            else {
+               /* correct for bottom-left fill convention:
+                */
+               if (plane[i].dcdy < 0) plane[i].c++;
+            }
+         }
+
+         /* Scale up to match c:
+          */
+         assert((plane[i].dcdx << FIXED_ORDER) >> FIXED_ORDER == plane[i].dcdx);
+         assert((plane[i].dcdy << FIXED_ORDER) >> FIXED_ORDER == plane[i].dcdy);
+         plane[i].dcdx <<= FIXED_ORDER;
+         plane[i].dcdy <<= FIXED_ORDER;
+
+         /* find trivial reject offsets for each edge for a single-pixel
+          * sized block.  These will be scaled up at each recursive level to
+          * match the active blocksize.  Scaling in this way works best if
+          * the blocks are square.
+          */
+         plane[i].eo = 0;
+         if (plane[i].dcdx < 0) plane[i].eo -= plane[i].dcdx;
+         if (plane[i].dcdy > 0) plane[i].eo += plane[i].dcdy;
+      }
+   }
+}
+
+
 /**
  * Alloc space for a new triangle plus the input.a0/dadx/dady arrays
  * immediately after it.
@@ -229,7 +510,8 @@ lp_setup_whole_tile(struct lp_setup_context *setup,
 {
    struct lp_scene *scene = setup->scene;
 
-   LP_COUNT(nr_fully_covered_64);
+   LP_SCENE_COUNT(setup->scene, nr_fully_covered_64);
+   setup->counters.nr_fully_covered_64++;
 
    /* if variant is opaque and scissor doesn't effect the tile */
    if (inputs->opaque) {
@@ -244,21 +526,26 @@ lp_setup_whole_tile(struct lp_setup_context *setup,
        * were just active we also can't do the optimization since to get
        * accurate query results we unfortunately need to execute the rendering
        * commands.
+       * - Resetting the bin of a fork of the scene wouldn't drop the commands
+       * already in the parent's bin or in the bins of earlier forks.
        */
-      if (!scene->fb.zsbuf && scene->fb_max_layer == 0 && !scene->had_queries) {
+      if (!scene->fb.zsbuf && scene->fb_max_layer == 0 && !scene->had_queries &&
+          !scene->parent) {
          /*
           * All previous rendering will be overwritten so reset the bin.
           */
          lp_scene_bin_reset( scene, tx, ty );
       }
 
-      LP_COUNT(nr_shade_opaque_64);
+      LP_SCENE_COUNT(setup->scene, nr_shade_opaque_64);
+      setup->counters.nr_shade_opaque_64++;
       return lp_scene_bin_cmd_with_state( scene, tx, ty,
                                           setup->fs.stored,
                                           LP_RAST_OP_SHADE_TILE_OPAQUE,
                                           lp_rast_arg_inputs(inputs) );
    } else {
-      LP_COUNT(nr_shade_64);
+      LP_SCENE_COUNT(setup->scene, nr_shade_64);
+      setup->counters.nr_shade_64++;
       return lp_scene_bin_cmd_with_state( scene, tx, ty,
                                           setup->fs.stored,
                                           LP_RAST_OP_SHADE_TILE,
@@ -271,10 +558,16 @@ lp_setup_whole_tile(struct lp_setup_context *setup,
  * Do basic setup for triangle rasterization and determine which
  * framebuffer tiles are touched.  Put the triangle in the scene's
  * bins for the tiles which we overlap.
+ *
+ * Either position is given, or the triangle is lane of a batch which
+ * already has its bounding box and edge equations computed and which
+ * already culled it if needed.
  */
 static boolean
 do_triangle_ccw(struct lp_setup_context *setup,
                 struct fixed_position* position,
+                const struct lp_setup_tri_batch *batch,
+                unsigned lane,
                 const float (*v0)[4],
                 const float (*v1)[4],
                 const float (*v2)[4],
@@ -294,7 +587,7 @@ do_triangle_ccw(struct lp_setup_context *setup,
    const float (*pv)[4];
 
    /* Area should always be positive here */
-   assert(position->area > 0);
+   assert(batch || position->area > 0);
 
    if (0)
       lp_setup_print_triangle(setup, v0, v1, v2);
@@ -312,344 +605,109 @@ do_triangle_ccw(struct lp_setup_context *setup,
    if (setup->layer_slot > 0) {
       layer = *(unsigned*)pv[setup->layer_slot];
       layer = MIN2(layer, scene->fb_max_layer);
-   }
-
-   /* Bounding rectangle (in pixels) */
-   {
-      /* Yes this is necessary to accurately calculate bounding boxes
-       * with the two fill-conventions we support.  GL (normally) ends
-       * up needing a bottom-left fill convention, which requires
-       * slightly different rounding.
-       */
-      int adj = (setup->bottom_edge_rule != 0) ? 1 : 0;
-
-      /* Inclusive x0, exclusive x1 */
-      bbox.x0 =  MIN3(position->x[0], position->x[1], position->x[2]) >> FIXED_ORDER;
-      bbox.x1 = (MAX3(position->x[0], position->x[1], position->x[2]) - 1) >> FIXED_ORDER;
-
-      /* Inclusive / exclusive depending upon adj (bottom-left or top-right) */
-      bbox.y0 = (MIN3(position->y[0], position->y[1], position->y[2]) + adj) >> FIXED_ORDER;
-      bbox.y1 = (MAX3(position->y[0], position->y[1], position->y[2]) - 1 + adj) >> FIXED_ORDER;
-   }
-
-   if (bbox.x1 < bbox.x0 ||
-       bbox.y1 < bbox.y0) {
-      if (0) debug_printf("empty bounding box\n");
-      LP_COUNT(nr_culled_tris);
-      return TRUE;
-   }
-
-   if (!u_rect_test_intersection(&setup->draw_regions[viewport_index], &bbox)) {
-      if (0) debug_printf("offscreen\n");
-      LP_COUNT(nr_culled_tris);
-      return TRUE;
-   }
-
-   bboxpos = bbox;
-
-   /* Can safely discard negative regions, but need to keep hold of
-    * information about when the triangle extends past screen
-    * boundaries.  See trimmed_box in lp_setup_bin_triangle().
-    */
-   bboxpos.x0 = MAX2(bboxpos.x0, 0);
-   bboxpos.y0 = MAX2(bboxpos.y0, 0);
-
-   nr_planes = 3;
-   /*
-    * Determine how many scissor planes we need, that is drop scissor
-    * edges if the bounding box of the tri is fully inside that edge.
-    */
-   if (setup->scissor_test) {
-      /* why not just use draw_regions */
-      scissor = &setup->scissors[viewport_index];
-      scissor_planes_needed(s_planes, &bboxpos, scissor);
-      nr_planes += s_planes[0] + s_planes[1] + s_planes[2] + s_planes[3];
-   }
-
-   tri = lp_setup_alloc_triangle(scene,
-                                 key->num_inputs,
-                                 nr_planes,
-                                 &tri_bytes);
-   if (!tri)
-      return FALSE;
-
-#ifdef DEBUG
-   tri->v[0][0] = v0[0][0];
-   tri->v[1][0] = v1[0][0];
-   tri->v[2][0] = v2[0][0];
-   tri->v[0][1] = v0[0][1];
-   tri->v[1][1] = v1[0][1];
-   tri->v[2][1] = v2[0][1];
-#endif
-
-   LP_COUNT(nr_tris);
-
-   /* Setup parameter interpolants:
-    */
-   setup->setup.variant->jit_function(v0, v1, v2,
-                                      frontfacing,
-                                      GET_A0(&tri->inputs),
-                                      GET_DADX(&tri->inputs),
-                                      GET_DADY(&tri->inputs));
-
-   tri->inputs.frontfacing = frontfacing;
-   tri->inputs.disable = FALSE;
-   tri->inputs.opaque = setup->fs.current.variant->opaque;
-   tri->inputs.layer = layer;
-   tri->inputs.viewport_index = viewport_index;
-
-   if (0)
-      lp_dump_setup_coef(&setup->setup.variant->key,
-                         (const float (*)[4])GET_A0(&tri->inputs),
-                         (const float (*)[4])GET_DADX(&tri->inputs),
-                         (const float (*)[4])GET_DADY(&tri->inputs));
-
-   plane = GET_PLANES(tri);
-
-#if defined(PIPE_ARCH_SSE)
-   if (1) {
-      __m128i vertx, verty;
-      __m128i shufx, shufy;
-      __m128i dcdx, dcdy;
-      __m128i cdx02, cdx13, cdy02, cdy13, c02, c13;
-      __m128i c01, c23, unused;
-      __m128i dcdx_neg_mask;
-      __m128i dcdy_neg_mask;
-      __m128i dcdx_zero_mask;
-      __m128i top_left_flag, c_dec;
-      __m128i eo, p0, p1, p2;
-      __m128i zero = _mm_setzero_si128();
-
-      vertx = _mm_load_si128((__m128i *)position->x); /* vertex x coords */
-      verty = _mm_load_si128((__m128i *)position->y); /* vertex y coords */
-
-      shufx = _mm_shuffle_epi32(vertx, _MM_SHUFFLE(3,0,2,1));
-      shufy = _mm_shuffle_epi32(verty, _MM_SHUFFLE(3,0,2,1));
-
-      dcdx = _mm_sub_epi32(verty, shufy);
-      dcdy = _mm_sub_epi32(vertx, shufx);
-
-      dcdx_neg_mask = _mm_srai_epi32(dcdx, 31);
-      dcdx_zero_mask = _mm_cmpeq_epi32(dcdx, zero);
-      dcdy_neg_mask = _mm_srai_epi32(dcdy, 31);
-
-      top_left_flag = _mm_set1_epi32((setup->bottom_edge_rule == 0) ? ~0 : 0);
-
-      c_dec = _mm_or_si128(dcdx_neg_mask,
-                           _mm_and_si128(dcdx_zero_mask,
-                                         _mm_xor_si128(dcdy_neg_mask,
-                                                       top_left_flag)));
-
-      /*
-       * 64 bit arithmetic.
-       * Note we need _signed_ mul (_mm_mul_epi32) which we emulate.
-       */
-      cdx02 = mm_mullohi_epi32(dcdx, vertx, &cdx13);
-      cdy02 = mm_mullohi_epi32(dcdy, verty, &cdy13);
-      c02 = _mm_sub_epi64(cdx02, cdy02);
-      c13 = _mm_sub_epi64(cdx13, cdy13);
-      c02 = _mm_sub_epi64(c02, _mm_shuffle_epi32(c_dec,
-                                                 _MM_SHUFFLE(2,2,0,0)));
-      c13 = _mm_sub_epi64(c13, _mm_shuffle_epi32(c_dec,
-                                                 _MM_SHUFFLE(3,3,1,1)));
-
-      /*
-       * Useful for very small fbs/tris (or fewer subpixel bits) only:
-       * c = _mm_sub_epi32(mm_mullo_epi32(dcdx, vertx),
-       *                   mm_mullo_epi32(dcdy, verty));
-       *
-       * c = _mm_sub_epi32(c, c_dec);
-       */
-
-      /* Scale up to match c:
-       */
-      dcdx = _mm_slli_epi32(dcdx, FIXED_ORDER);
-      dcdy = _mm_slli_epi32(dcdy, FIXED_ORDER);
-
-      /*
-       * Calculate trivial reject values:
-       * Note eo cannot overflow even if dcdx/dcdy would already have
-       * 31 bits (which they shouldn't have). This is because eo
-       * is never negative (albeit if we rely on that need to be careful...)
-       */
-      eo = _mm_sub_epi32(_mm_andnot_si128(dcdy_neg_mask, dcdy),
-                         _mm_and_si128(dcdx_neg_mask, dcdx));
-
-      /* ei = _mm_sub_epi32(_mm_sub_epi32(dcdy, dcdx), eo); */
-
-      /*
-       * Pointless transpose which gets undone immediately in
-       * rasterization.
-       * It is actually difficult to do away with it - would essentially
-       * need GET_PLANES_DX, GET_PLANES_DY etc., but the calculations
-       * for this then would need to depend on the number of planes.
-       * The transpose is quite special here due to c being 64bit...
-       * The store has to be unaligned (unless we'd make the plane size
-       * a multiple of 128), and of course storing eo separately...
-       */
-      c01 = _mm_unpacklo_epi64(c02, c13);
-      c23 = _mm_unpackhi_epi64(c02, c13);
-      transpose2_64_2_32(&c01, &c23, &dcdx, &dcdy,
-                         &p0, &p1, &p2, &unused);
-      _mm_storeu_si128((__m128i *)&plane[0], p0);
-      plane[0].eo = (uint32_t)_mm_cvtsi128_si32(eo);
-      _mm_storeu_si128((__m128i *)&plane[1], p1);
-      eo = _mm_shuffle_epi32(eo, _MM_SHUFFLE(3,2,0,1));
-      plane[1].eo = (uint32_t)_mm_cvtsi128_si32(eo);
-      _mm_storeu_si128((__m128i *)&plane[2], p2);
-      eo = _mm_shuffle_epi32(eo, _MM_SHUFFLE(0,0,0,2));
-      plane[2].eo = (uint32_t)_mm_cvtsi128_si32(eo);
-   } else
-#elif defined(_ARCH_PWR8) && UTIL_ARCH_LITTLE_ENDIAN
-   /*
-    * XXX this code is effectively disabled for all practical purposes,
-    * as the allowed fb size is tiny if FIXED_ORDER is 8.
-    */
-   if (setup->fb.width <= MAX_FIXED_LENGTH32 &&
-       setup->fb.height <= MAX_FIXED_LENGTH32 &&
-       (bbox.x1 - bbox.x0) <= MAX_FIXED_LENGTH32 &&
-       (bbox.y1 - bbox.y0) <= MAX_FIXED_LENGTH32) {
-      unsigned int bottom_edge;
-      __m128i vertx, verty;
-      __m128i shufx, shufy;
-      __m128i dcdx, dcdy, c;
-      __m128i unused;
-      __m128i dcdx_neg_mask;
-      __m128i dcdy_neg_mask;
-      __m128i dcdx_zero_mask;
-      __m128i top_left_flag;
-      __m128i c_inc_mask, c_inc;
-      __m128i eo, p0, p1, p2;
-      __m128i_union vshuf_mask;
-      __m128i zero = vec_splats((unsigned char) 0);
-      PIPE_ALIGN_VAR(16) int32_t temp_vec[4];
-
-#if UTIL_ARCH_LITTLE_ENDIAN
-      vshuf_mask.i[0] = 0x07060504;
-      vshuf_mask.i[1] = 0x0B0A0908;
-      vshuf_mask.i[2] = 0x03020100;
-      vshuf_mask.i[3] = 0x0F0E0D0C;
-#else
-      vshuf_mask.i[0] = 0x00010203;
-      vshuf_mask.i[1] = 0x0C0D0E0F;
-      vshuf_mask.i[2] = 0x04050607;
-      vshuf_mask.i[3] = 0x08090A0B;
-#endif
-
-      /* vertex x coords */
-      vertx = vec_load_si128((const uint32_t *) position->x);
-      /* vertex y coords */
-      verty = vec_load_si128((const uint32_t *) position->y);
-
-      shufx = vec_perm (vertx, vertx, vshuf_mask.m128i);
-      shufy = vec_perm (verty, verty, vshuf_mask.m128i);
-
-      dcdx = vec_sub_epi32(verty, shufy);
-      dcdy = vec_sub_epi32(vertx, shufx);
-
-      dcdx_neg_mask = vec_srai_epi32(dcdx, 31);
-      dcdx_zero_mask = vec_cmpeq_epi32(dcdx, zero);
-      dcdy_neg_mask = vec_srai_epi32(dcdy, 31);
+   }
 
-      bottom_edge = (setup->bottom_edge_rule == 0) ? ~0 : 0;
-      top_left_flag = (__m128i) vec_splats(bottom_edge);
+   if (batch) {
+      bbox.x0 = batch->bbox_x0[lane];
+      bbox.y0 = batch->bbox_y0[lane];
+      bbox.x1 = batch->bbox_x1[lane];
+      bbox.y1 = batch->bbox_y1[lane];
+   }
+   else {
+      calc_fixed_bbox(position, setup->bottom_edge_rule, &bbox);
 
-      c_inc_mask = vec_or(dcdx_neg_mask,
-                                vec_and(dcdx_zero_mask,
-                                              vec_xor(dcdy_neg_mask,
-                                                            top_left_flag)));
+      if (bbox.x1 < bbox.x0 ||
+          bbox.y1 < bbox.y0) {
+         if (0) debug_printf("empty bounding box\n");
+         LP_SCENE_COUNT(setup->scene, nr_culled_tris);
+         return TRUE;
+      }
 
-      c_inc = vec_srli_epi32(c_inc_mask, 31);
+      if (!u_rect_test_intersection(&setup->draw_regions[viewport_index], &bbox)) {
+         if (0) debug_printf("offscreen\n");
+         LP_SCENE_COUNT(setup->scene, nr_culled_tris);
+         return TRUE;
+      }
+   }
 
-      c = vec_sub_epi32(vec_mullo_epi32(dcdx, vertx),
-                        vec_mullo_epi32(dcdy, verty));
+   bboxpos = bbox;
 
-      c = vec_add_epi32(c, c_inc);
+   /* Can safely discard negative regions, but need to keep hold of
+    * information about when the triangle extends past screen
+    * boundaries.  See trimmed_box in lp_setup_bin_triangle().
+    */
+   bboxpos.x0 = MAX2(bboxpos.x0, 0);
+   bboxpos.y0 = MAX2(bboxpos.y0, 0);
 
-      /* Scale up to match c:
-       */
-      dcdx = vec_slli_epi32(dcdx, FIXED_ORDER);
-      dcdy = vec_slli_epi32(dcdy, FIXED_ORDER);
+   nr_planes = 3;
+   /*
+    * Determine how many scissor planes we need, that is drop scissor
+    * edges if the bounding box of the tri is fully inside that edge.
+    */
+   if (setup->scissor_test) {
+      /* why not just use draw_regions */
+      scissor = &setup->scissors[viewport_index];
+      scissor_planes_needed(s_planes, &bboxpos, scissor);
+      nr_planes += s_planes[0] + s_planes[1] + s_planes[2] + s_planes[3];
+   }
 
-      /* Calculate trivial reject values:
-       */
-      eo = vec_sub_epi32(vec_andnot_si128(dcdy_neg_mask, dcdy),
-                         vec_and(dcdx_neg_mask, dcdx));
+   tri = lp_setup_alloc_triangle(scene,
+                                 key->num_inputs,
+                                 nr_planes,
+                                 &tri_bytes);
+   if (!tri)
+      return FALSE;
 
-      /* ei = _mm_sub_epi32(_mm_sub_epi32(dcdy, dcdx), eo); */
+#ifdef DEBUG
+   tri->v[0][0] = v0[0][0];
+   tri->v[1][0] = v1[0][0];
+   tri->v[2][0] = v2[0][0];
+   tri->v[0][1] = v0[0][1];
+   tri->v[1][1] = v1[0][1];
+   tri->v[2][1] = v2[0][1];
+#endif
 
-      /* Pointless transpose which gets undone immediately in
-       * rasterization:
-       */
-      transpose4_epi32(&c, &dcdx, &dcdy, &eo,
-                       &p0, &p1, &p2, &unused);
+   LP_SCENE_COUNT(setup->scene, nr_tris);
 
-#define STORE_PLANE(plane, vec) do {                  \
-         vec_store_si128((uint32_t *)&temp_vec, vec); \
-         plane.c    = (int64_t)temp_vec[0];           \
-         plane.dcdx = temp_vec[1];                    \
-         plane.dcdy = temp_vec[2];                    \
-         plane.eo   = temp_vec[3];                    \
-      } while(0)
+   /* Setup parameter interpolants:
+    */
+   setup->setup.variant->jit_function(v0, v1, v2,
+                                      frontfacing,
+                                      GET_A0(&tri->inputs),
+                                      GET_DADX(&tri->inputs),
+                                      GET_DADY(&tri->inputs));
 
-      STORE_PLANE(plane[0], p0);
-      STORE_PLANE(plane[1], p1);
-      STORE_PLANE(plane[2], p2);
-#undef STORE_PLANE
-   } else
-#endif
-   {
-      int i;
-      plane[0].dcdy = position->dx01;
-      plane[1].dcdy = position->x[1] - position->x[2];
-      plane[2].dcdy = position->dx20;
-      plane[0].dcdx = position->dy01;
-      plane[1].dcdx = position->y[1] - position->y[2];
-      plane[2].dcdx = position->dy20;
-  
-      for (i = 0; i < 3; i++) {
-         /* half-edge constants, will be iterated over the whole render
-          * target.
-          */
-         plane[i].c = IMUL64(plane[i].dcdx, position->x[i]) -
-                      IMUL64(plane[i].dcdy, position->y[i]);
+   tri->inputs.frontfacing = frontfacing;
+   tri->inputs.disable = FALSE;
+   tri->inputs.opaque = setup->fs.current.variant->opaque;
+   tri->inputs.layer = layer;
+   tri->inputs.viewport_index = viewport_index;
 
-         /* correct for top-left vs. bottom-left fill convention.
-          */
-         if (plane[i].dcdx < 0) {
-            /* both fill conventions want this - adjust for left edges */
-            plane[i].c++;
-         }
-         else if (plane[i].dcdx == 0) {
-            if (setup->bottom_edge_rule == 0){
-               /* correct for top-left fill convention:
-                */
-               if (plane[i].dcdy > 0) plane[i].c++;
-            }
-            else {
-               /* correct for bottom-left fill convention:
-                */
-               if (plane[i].dcdy < 0) plane[i].c++;
-            }
-         }
+   if (0)
+      lp_dump_setup_coef(&setup->setup.variant->key,
+                         (const float (*)[4])GET_A0(&tri->inputs),
+                         (const float (*)[4])GET_DADX(&tri->inputs),
+                         (const float (*)[4])GET_DADY(&tri->inputs));
 
-         /* Scale up to match c:
-          */
-         assert((plane[i].dcdx << FIXED_ORDER) >> FIXED_ORDER == plane[i].dcdx);
-         assert((plane[i].dcdy << FIXED_ORDER) >> FIXED_ORDER == plane[i].dcdy);
-         plane[i].dcdx <<= FIXED_ORDER;
-         plane[i].dcdy <<= FIXED_ORDER;
+   plane = GET_PLANES(tri);
 
-         /* find trivial reject offsets for each edge for a single-pixel
-          * sized block.  These will be scaled up at each recursive level to
-          * match the active blocksize.  Scaling in this way works best if
-          * the blocks are square.
-          */
-         plane[i].eo = 0;
-         if (plane[i].dcdx < 0) plane[i].eo -= plane[i].dcdx;
-         if (plane[i].dcdy > 0) plane[i].eo += plane[i].dcdy;
+   if (batch) {
+      int i;
+      for (i = 0; i < 3; i++) {
+         plane[i].c = batch->c[i][lane];
+         plane[i].dcdx = batch->dcdx[i][lane];
+         plane[i].dcdy = batch->dcdy[i][lane];
+         plane[i].eo = batch->eo[i][lane];
       }
    }
+   else {
+      boolean small = setup->fb.width <= MAX_FIXED_LENGTH32 &&
+                      setup->fb.height <= MAX_FIXED_LENGTH32 &&
+                      (bbox.x1 - bbox.x0) <= MAX_FIXED_LENGTH32 &&
+                      (bbox.y1 - bbox.y0) <= MAX_FIXED_LENGTH32;
+
+      calc_fixed_planes(position, setup->bottom_edge_rule, small, plane);
+   }
 
    if (0) {
       debug_printf("p0: %"PRIx64"/%08x/%08x/%08x\n",
@@ -814,6 +872,9 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
       assert(iy0 == bbox->y1 / TILE_SIZE &&
 	     ix0 == bbox->x1 / TILE_SIZE);
 
+      /* a triangle within a single tile never covers it completely */
+      setup->counters.nr_partially_covered_64++;
+
       if (nr_planes == 3) {
          if (sz < 4)
          {
@@ -944,7 +1005,8 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
                /* do nothing */
                if (in)
                   break;  /* exiting triangle, all done with this row */
-               LP_COUNT(nr_empty_64);
+               LP_SCENE_COUNT(setup->scene, nr_empty_64);
+               setup->counters.nr_empty_64++;
             }
             else if (partial) {
                /* Not trivially accepted by at least one plane -
@@ -962,11 +1024,12 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
                                                  lp_rast_arg_triangle(tri, partial) ))
                   goto fail;
 
-               LP_COUNT(nr_partially_covered_64);
+               LP_SCENE_COUNT(setup->scene, nr_partially_covered_64);
+               setup->counters.nr_partially_covered_64++;
             }
             else {
                /* triangle covers the whole tile- shade whole tile */
-               LP_COUNT(nr_fully_covered_64);
+               LP_SCENE_COUNT(setup->scene, nr_fully_covered_64);
                in = TRUE;
                if (!lp_setup_whole_tile(setup, &tri->inputs, x, y))
                   goto fail;
@@ -1005,12 +1068,34 @@ static void retry_triangle_ccw( struct lp_setup_context *setup,
                                 const float (*v2)[4],
                                 boolean front)
 {
-   if (!do_triangle_ccw( setup, position, v0, v1, v2, front ))
+   if (!do_triangle_ccw( setup, position, NULL, 0, v0, v1, v2, front ))
    {
       if (!lp_setup_flush_and_restart(setup))
          return;
 
-      if (!do_triangle_ccw( setup, position, v0, v1, v2, front ))
+      if (!do_triangle_ccw( setup, position, NULL, 0, v0, v1, v2, front ))
+         return;
+   }
+}
+
+
+/**
+ * Like retry_triangle_ccw(), for a triangle of a batch.
+ */
+static void retry_triangle_batched( struct lp_setup_context *setup,
+                                    const struct lp_setup_tri_batch *batch,
+                                    unsigned lane,
+                                    const float (*v0)[4],
+                                    const float (*v1)[4],
+                                    const float (*v2)[4],
+                                    boolean front)
+{
+   if (!do_triangle_ccw( setup, NULL, batch, lane, v0, v1, v2, front ))
+   {
+      if (!lp_setup_flush_and_restart(setup))
+         return;
+
+      if (!do_triangle_ccw( setup, NULL, batch, lane, v0, v1, v2, front ))
          return;
    }
 }
@@ -1022,13 +1107,12 @@ static void retry_triangle_ccw( struct lp_setup_context *setup,
  * to what is done in the jit setup prog.
  */
 static inline void
-calc_fixed_position(struct lp_setup_context *setup,
+snap_fixed_position(float pixel_offset,
                     struct fixed_position* position,
                     const float (*v0)[4],
                     const float (*v1)[4],
                     const float (*v2)[4])
 {
-   float pixel_offset = setup->multisample ? 0.0 : setup->pixel_offset;
    /*
     * The rounding may not be quite the same with PIPE_ARCH_SSE
     * (util_iround right now only does nearest/even on x87,
@@ -1088,6 +1172,19 @@ calc_fixed_position(struct lp_setup_context *setup,
 }
 
 
+static inline void
+calc_fixed_position(struct lp_setup_context *setup,
+                    struct fixed_position* position,
+                    const float (*v0)[4],
+                    const float (*v1)[4],
+                    const float (*v2)[4])
+{
+   float pixel_offset = setup->multisample ? 0.0 : setup->pixel_offset;
+
+   snap_fixed_position(pixel_offset, position, v0, v1, v2);
+}
+
+
 /**
  * Rotate a triangle, flipping its clockwise direction,
  * Swaps values for xy[0] and xy[1]
@@ -1166,6 +1263,8 @@ static void triangle_cw(struct lp_setup_context *setup,
          retry_triangle_ccw(setup, &position, v1, v0, v2, !setup->ccw_is_frontface);
       }
    }
+   else
+      LP_SCENE_COUNT(setup->scene, nr_culled_tris);
 }
 
 
@@ -1185,6 +1284,8 @@ static void triangle_ccw(struct lp_setup_context *setup,
 
    if (position.area > 0)
       retry_triangle_ccw(setup, &position, v0, v1, v2, setup->ccw_is_frontface);
+   else
+      LP_SCENE_COUNT(setup->scene, nr_culled_tris);
 }
 
 /**
@@ -1224,6 +1325,8 @@ static void triangle_both(struct lp_setup_context *setup,
          retry_triangle_ccw( setup, &position, v1, v0, v2, !setup->ccw_is_frontface );
       }
    }
+   else
+      LP_SCENE_COUNT(setup->scene, nr_culled_tris);
 }
 
 
@@ -1235,25 +1338,246 @@ static void triangle_noop(struct lp_setup_context *setup,
 }
 
 
+/**
+ * Cull and set up one lane of a batch with the per-triangle code of
+ * triangle_both() and do_triangle_ccw() instead of lp_setup_tri_batch().
+ * Used by lp_test_setup to check the batched setup.
+ * Returns FALSE if the triangle is culled.
+ */
+boolean
+lp_setup_tri_scalar(const struct lp_setup_tri_batch *batch,
+                    unsigned lane,
+                    boolean *cw,
+                    struct u_rect *bbox,
+                    struct lp_rast_plane *plane)
+{
+   PIPE_ALIGN_VAR(16) struct fixed_position position;
+   float v[3][4];
+   unsigned j;
+
+   for (j = 0; j < 3; j++) {
+      v[j][0] = batch->x[j][lane];
+      v[j][1] = batch->y[j][lane];
+      v[j][2] = 0.0f;
+      v[j][3] = 1.0f;
+   }
+
+   snap_fixed_position(batch->pixel_offset, &position, &v[0], &v[1], &v[2]);
+
+   if (position.area > 0 && batch->keep_ccw) {
+      *cw = FALSE;
+   }
+   else if (position.area < 0 && batch->keep_cw) {
+      if (batch->flatshade_first)
+         rotate_fixed_position_12(&position);
+      else
+         rotate_fixed_position_01(&position);
+      *cw = TRUE;
+   }
+   else
+      return FALSE;
+
+   calc_fixed_bbox(&position, batch->bottom_edge_rule, bbox);
+
+   if (bbox->x1 < bbox->x0 ||
+       bbox->y1 < bbox->y0 ||
+       !u_rect_test_intersection(&batch->region, bbox))
+      return FALSE;
+
+   /* the batch has no framebuffer size, so no 32 bit POWER8 planes */
+   calc_fixed_planes(&position, batch->bottom_edge_rule, FALSE, plane);
+   return TRUE;
+}
+
+
+/**
+ * Bin up to LP_SETUP_TRI_BATCH triangles, see triangles_batched().
+ * Without retry stop at the first triangle which doesn't fit into the
+ * scene anymore, and return how many triangles were done.
+ */
+static unsigned bin_triangles(struct lp_setup_context *setup,
+                              const float (*const *v)[4],
+                              unsigned nr,
+                              boolean retry)
+{
+   struct lp_setup_tri_batch batch;
+   unsigned mask, culled, i, j;
+
+   batch.pixel_offset = setup->multisample ? 0.0f : setup->pixel_offset;
+   batch.bottom_edge_rule = setup->bottom_edge_rule != 0;
+   batch.flatshade_first = setup->flatshade_first;
+   batch.keep_ccw = setup->triangle != triangle_cw;
+   batch.keep_cw = setup->triangle != triangle_ccw;
+   batch.region = setup->draw_regions[0];
+   batch.count = nr;
+   for (i = 0; i < nr; i++) {
+      for (j = 0; j < 3; j++) {
+         batch.x[j][i] = v[3*i+j][0][0];
+         batch.y[j][i] = v[3*i+j][0][1];
+      }
+   }
+
+   lp_setup_tri_batch(&batch);
+
+   /* facing, zero area and offscreen triangles, counted like the scalar
+    * path does
+    */
+   culled = ~batch.draw_mask & ((1 << nr) - 1);
+
+   mask = batch.draw_mask;
+   while (mask) {
+      const float (*v0)[4], (*v1)[4], (*v2)[4];
+      boolean front;
+
+      i = u_bit_scan(&mask);
+      v0 = v[3*i];
+      v1 = v[3*i+1];
+      v2 = v[3*i+2];
+      front = setup->ccw_is_frontface;
+
+      /* same vertex order as triangle_cw() */
+      if (batch.cw_mask & (1 << i)) {
+         if (setup->flatshade_first) {
+            v1 = v[3*i+2];
+            v2 = v[3*i+1];
+         }
+         else {
+            v0 = v[3*i+1];
+            v1 = v[3*i];
+         }
+         front = !front;
+      }
+
+      if (retry)
+         retry_triangle_batched(setup, &batch, i, v0, v1, v2, front);
+      else if (!do_triangle_ccw(setup, NULL, &batch, i, v0, v1, v2, front)) {
+         /* the triangles from i on are binned again later */
+         LP_SCENE_COUNT_ADD(setup->scene, nr_culled_tris,
+                            util_bitcount(culled & ((1 << i) - 1)));
+         return i;
+      }
+   }
+
+   LP_SCENE_COUNT_ADD(setup->scene, nr_culled_tris, util_bitcount(culled));
+   return nr;
+}
+
+
+/**
+ * Draw up to LP_SETUP_TRI_BATCH triangles, culled like setup->triangle
+ * does.  The culling, bounding boxes and edge equations only depend on the
+ * positions and are computed for all of them together, the remaining setup
+ * and binning is still done one triangle at a time.
+ */
+static unsigned triangles_batched(struct lp_setup_context *setup,
+                                  const float (*const *v)[4],
+                                  unsigned nr)
+{
+   struct llvmpipe_context *lp_context = (struct llvmpipe_context *)setup->pipe;
+   unsigned i;
+
+   assert(nr <= LP_SETUP_TRI_BATCH);
+
+   /* the batch only knows one draw region */
+   if (setup->viewport_index_slot > 0) {
+      for (i = 0; i < nr; i++)
+         setup->triangle(setup, v[3*i], v[3*i+1], v[3*i+2]);
+      return nr;
+   }
+
+   if (lp_context->active_statistics_queries) {
+      lp_context->pipeline_statistics.c_primitives += nr;
+   }
+
+   bin_triangles(setup, v, nr, TRUE);
+   return nr;
+}
+
+
+/**
+ * triangles_batched() for a fork of the setup context, which can't
+ * flush its scene.  The primitives are counted by the parent.
+ */
+static unsigned triangles_forked(struct lp_setup_context *setup,
+                                 const float (*const *v)[4],
+                                 unsigned nr)
+{
+   assert(nr <= LP_SETUP_TRI_BATCH);
+   assert(setup->scene->parent);
+
+   return bin_triangles(setup, v, nr, FALSE);
+}
+
+
+static unsigned triangles_noop(struct lp_setup_context *setup,
+                               const float (*const *v)[4],
+                               unsigned nr)
+{
+   return nr;
+}
+
+
+/**
+ * Whether the triangles of the current state can be binned by a fork of
+ * the setup context, see lp_setup_fork_triangles().
+ */
+boolean
+lp_setup_can_fork_triangles(const struct lp_setup_context *setup)
+{
+   /* the same conditions as for triangles_batched() */
+   return !setup->rasterizer_discard &&
+          setup->cullmode != PIPE_FACE_FRONT_AND_BACK &&
+          setup->viewport_index_slot <= 0;
+}
+
+
+/**
+ * Make fork a copy of setup which bins triangles into scene, a fork of
+ * setup's scene.  Only fork->triangles may be called on it, and its
+ * counters are left for the caller to add to the ones of setup.
+ */
+void
+lp_setup_fork_triangles(struct lp_setup_context *fork,
+                        const struct lp_setup_context *setup,
+                        struct lp_scene *scene)
+{
+   assert(lp_setup_can_fork_triangles(setup));
+   assert(scene->parent == setup->scene);
+
+   memcpy(fork, setup, sizeof *fork);
+   fork->scene = scene;
+   memset(&fork->counters, 0, sizeof fork->counters);
+
+   lp_setup_choose_triangle(fork);
+   assert(fork->triangles == triangles_batched);
+   fork->triangles = triangles_forked;
+}
+
+
 void 
 lp_setup_choose_triangle(struct lp_setup_context *setup)
 {
    if (setup->rasterizer_discard) {
       setup->triangle = triangle_noop;
+      setup->triangles = triangles_noop;
       return;
    }
    switch (setup->cullmode) {
    case PIPE_FACE_NONE:
       setup->triangle = triangle_both;
+      setup->triangles = triangles_batched;
       break;
    case PIPE_FACE_BACK:
       setup->triangle = setup->ccw_is_frontface ? triangle_ccw : triangle_cw;
+      setup->triangles = triangles_batched;
       break;
    case PIPE_FACE_FRONT:
       setup->triangle = setup->ccw_is_frontface ? triangle_cw : triangle_ccw;
+      setup->triangles = triangles_batched;
       break;
    default:
       setup->triangle = triangle_noop;
+      setup->triangles = triangles_noop;
       break;
    }
 }
@@ -0,0 +1,342 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The Mesa Authors.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * Batched triangle setup, see lp_setup_tri_batch.h.
+ *
+ * There is a plain C version, which compilers are free to vectorize, and
+ * an AVX2 one doing eight triangles per instruction which is picked at
+ * runtime when the cpu supports it.
+ */
+
+
+#include "util/u_cpu_detect.h"
+#include "util/u_math.h"
+#include "lp_rast.h"
+#include "lp_setup_tri_batch.h"
+
+#if defined(PIPE_ARCH_SSE)
+#include <emmintrin.h>
+#endif
+
+#if defined(PIPE_ARCH_X86_64) && defined(PIPE_CC_GCC)
+#define HAVE_TRI_BATCH_AVX2 1
+#include <immintrin.h>
+#endif
+
+
+/**
+ * Same rounding as calc_fixed_position().
+ */
+static inline int32_t
+subpixel_snap(float a)
+{
+#if defined(PIPE_ARCH_SSE)
+   return _mm_cvtss_si32(_mm_set_ss(a * FIXED_ONE));
+#else
+   return util_iround(FIXED_ONE * a);
+#endif
+}
+
+
+void
+lp_setup_tri_batch_c(struct lp_setup_tri_batch *batch)
+{
+   const int adj = batch->bottom_edge_rule ? 1 : 0;
+   unsigned draw_mask = 0, cw_mask = 0;
+   unsigned i, j;
+
+   for (i = 0; i < batch->count; i++) {
+      int32_t x[3], y[3], tmp;
+      int64_t area;
+      int bx0, by0, bx1, by1;
+      boolean cw;
+
+      for (j = 0; j < 3; j++) {
+         x[j] = subpixel_snap(batch->x[j][i] - batch->pixel_offset);
+         y[j] = subpixel_snap(batch->y[j][i] - batch->pixel_offset);
+      }
+
+      area = IMUL64(x[0] - x[1], y[2] - y[0]) -
+             IMUL64(x[2] - x[0], y[0] - y[1]);
+
+      if (area > 0 && batch->keep_ccw)
+         cw = FALSE;
+      else if (area < 0 && batch->keep_cw)
+         cw = TRUE;
+      else
+         continue;
+
+      if (cw) {
+         const unsigned a = batch->flatshade_first ? 1 : 0;
+         tmp = x[a]; x[a] = x[a + 1]; x[a + 1] = tmp;
+         tmp = y[a]; y[a] = y[a + 1]; y[a + 1] = tmp;
+      }
+
+      bx0 =  MIN3(x[0], x[1], x[2]) >> FIXED_ORDER;
+      bx1 = (MAX3(x[0], x[1], x[2]) - 1) >> FIXED_ORDER;
+      by0 = (MIN3(y[0], y[1], y[2]) + adj) >> FIXED_ORDER;
+      by1 = (MAX3(y[0], y[1], y[2]) - 1 + adj) >> FIXED_ORDER;
+
+      if (bx1 < bx0 || by1 < by0 ||
+          batch->region.x1 < bx0 || bx1 < batch->region.x0 ||
+          batch->region.y1 < by0 || by1 < batch->region.y0)
+         continue;
+
+      batch->bbox_x0[i] = bx0;
+      batch->bbox_y0[i] = by0;
+      batch->bbox_x1[i] = bx1;
+      batch->bbox_y1[i] = by1;
+
+      for (j = 0; j < 3; j++) {
+         const unsigned k = (j + 1) % 3;
+         int32_t dcdx = y[j] - y[k];
+         int32_t dcdy = x[j] - x[k];
+         int64_t c = IMUL64(dcdx, x[j]) - IMUL64(dcdy, y[j]);
+
+         /* fill convention, as in do_triangle_ccw() */
+         if (dcdx < 0 ||
+             (dcdx == 0 && (batch->bottom_edge_rule ? dcdy < 0 : dcdy >= 0)))
+            c++;
+
+         dcdx <<= FIXED_ORDER;
+         dcdy <<= FIXED_ORDER;
+
+         batch->c[j][i] = c;
+         batch->dcdx[j][i] = dcdx;
+         batch->dcdy[j][i] = dcdy;
+         batch->eo[j][i] = (dcdy > 0 ? dcdy : 0) - (dcdx < 0 ? dcdx : 0);
+      }
+
+      draw_mask |= 1 << i;
+      if (cw)
+         cw_mask |= 1 << i;
+   }
+
+   batch->draw_mask = draw_mask;
+   batch->cw_mask = cw_mask;
+}
+
+
+#if defined(HAVE_TRI_BATCH_AVX2)
+
+#define AVX2 __attribute__((target("avx2")))
+
+
+/**
+ * a * b - c * d with 64 bit results, for the even lanes in the returned
+ * vector and the odd ones in *odd.
+ */
+static inline __m256i AVX2
+mul_sub_epi64(__m256i a, __m256i b, __m256i c, __m256i d, __m256i *odd)
+{
+   *odd = _mm256_sub_epi64(_mm256_mul_epi32(_mm256_srli_epi64(a, 32),
+                                            _mm256_srli_epi64(b, 32)),
+                           _mm256_mul_epi32(_mm256_srli_epi64(c, 32),
+                                            _mm256_srli_epi64(d, 32)));
+   return _mm256_sub_epi64(_mm256_mul_epi32(a, b), _mm256_mul_epi32(c, d));
+}
+
+
+static inline void AVX2
+store_epi64(int64_t *dst, __m256i even, __m256i odd)
+{
+   __m256i lo = _mm256_unpacklo_epi64(even, odd); /* 0 1 | 4 5 */
+   __m256i hi = _mm256_unpackhi_epi64(even, odd); /* 2 3 | 6 7 */
+
+   _mm256_storeu_si256((__m256i *)dst, _mm256_permute2x128_si256(lo, hi, 0x20));
+   _mm256_storeu_si256((__m256i *)(dst + 4),
+                       _mm256_permute2x128_si256(lo, hi, 0x31));
+}
+
+
+/** Swap a and b in the lanes set in mask */
+static inline void AVX2
+swap_epi32(__m256i *a, __m256i *b, __m256i mask)
+{
+   __m256i tmp = *a;
+   *a = _mm256_blendv_epi8(*a, *b, mask);
+   *b = _mm256_blendv_epi8(*b, tmp, mask);
+}
+
+
+static void AVX2
+lp_setup_tri_batch_avx2(struct lp_setup_tri_batch *batch)
+{
+   const __m256 offset = _mm256_set1_ps(batch->pixel_offset);
+   const __m256 fixed_one = _mm256_set1_ps((float)FIXED_ONE);
+   const __m256i zero = _mm256_setzero_si256();
+   const __m256i one = _mm256_set1_epi32(1);
+   const __m256i adj = _mm256_set1_epi32(batch->bottom_edge_rule ? 1 : 0);
+   const __m256i top_left_flag =
+      _mm256_set1_epi32(batch->bottom_edge_rule ? 0 : ~0);
+   __m256i x[3], y[3];
+   __m256i dx01, dy01, dx20, dy20, area_even, area_odd;
+   __m256i ccw, cw, culled, draw;
+   __m256i xmin, xmax, ymin, ymax, bx0, by0, bx1, by1;
+   unsigned j;
+
+   for (j = 0; j < 3; j++) {
+      x[j] = _mm256_cvtps_epi32(
+         _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(batch->x[j]), offset),
+                       fixed_one));
+      y[j] = _mm256_cvtps_epi32(
+         _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(batch->y[j]), offset),
+                       fixed_one));
+   }
+
+   dx01 = _mm256_sub_epi32(x[0], x[1]);
+   dy01 = _mm256_sub_epi32(y[0], y[1]);
+   dx20 = _mm256_sub_epi32(x[2], x[0]);
+   dy20 = _mm256_sub_epi32(y[2], y[0]);
+   area_even = mul_sub_epi64(dx01, dy20, dx20, dy01, &area_odd);
+
+   /* the 64 bit compare results of the odd lanes go to the odd dwords */
+   ccw = _mm256_blend_epi32(_mm256_cmpgt_epi64(area_even, zero),
+                            _mm256_cmpgt_epi64(area_odd, zero), 0xaa);
+   cw = _mm256_blend_epi32(_mm256_cmpgt_epi64(zero, area_even),
+                           _mm256_cmpgt_epi64(zero, area_odd), 0xaa);
+   if (!batch->keep_ccw)
+      ccw = zero;
+   if (!batch->keep_cw)
+      cw = zero;
+
+   if (batch->flatshade_first) {
+      swap_epi32(&x[1], &x[2], cw);
+      swap_epi32(&y[1], &y[2], cw);
+   }
+   else {
+      swap_epi32(&x[0], &x[1], cw);
+      swap_epi32(&y[0], &y[1], cw);
+   }
+
+   xmin = _mm256_min_epi32(_mm256_min_epi32(x[0], x[1]), x[2]);
+   xmax = _mm256_max_epi32(_mm256_max_epi32(x[0], x[1]), x[2]);
+   ymin = _mm256_min_epi32(_mm256_min_epi32(y[0], y[1]), y[2]);
+   ymax = _mm256_max_epi32(_mm256_max_epi32(y[0], y[1]), y[2]);
+
+   bx0 = _mm256_srai_epi32(xmin, FIXED_ORDER);
+   bx1 = _mm256_srai_epi32(_mm256_sub_epi32(xmax, one), FIXED_ORDER);
+   by0 = _mm256_srai_epi32(_mm256_add_epi32(ymin, adj), FIXED_ORDER);
+   by1 = _mm256_srai_epi32(_mm256_add_epi32(_mm256_sub_epi32(ymax, one), adj),
+                           FIXED_ORDER);
+
+   culled = _mm256_or_si256(_mm256_cmpgt_epi32(bx0, bx1),
+                            _mm256_cmpgt_epi32(by0, by1));
+   culled = _mm256_or_si256(culled,
+      _mm256_cmpgt_epi32(bx0, _mm256_set1_epi32(batch->region.x1)));
+   culled = _mm256_or_si256(culled,
+      _mm256_cmpgt_epi32(_mm256_set1_epi32(batch->region.x0), bx1));
+   culled = _mm256_or_si256(culled,
+      _mm256_cmpgt_epi32(by0, _mm256_set1_epi32(batch->region.y1)));
+   culled = _mm256_or_si256(culled,
+      _mm256_cmpgt_epi32(_mm256_set1_epi32(batch->region.y0), by1));
+
+   draw = _mm256_andnot_si256(culled, _mm256_or_si256(ccw, cw));
+   batch->draw_mask = _mm256_movemask_ps(_mm256_castsi256_ps(draw));
+   batch->cw_mask = _mm256_movemask_ps(_mm256_castsi256_ps(cw)) &
+                    batch->draw_mask;
+
+   _mm256_storeu_si256((__m256i *)batch->bbox_x0, bx0);
+   _mm256_storeu_si256((__m256i *)batch->bbox_y0, by0);
+   _mm256_storeu_si256((__m256i *)batch->bbox_x1, bx1);
+   _mm256_storeu_si256((__m256i *)batch->bbox_y1, by1);
+
+   /* Same as the SSE code in do_triangle_ccw(), with triangles instead of
+    * edges in the lanes.
+    */
+   for (j = 0; j < 3; j++) {
+      const unsigned k = (j + 1) % 3;
+      __m256i dcdx = _mm256_sub_epi32(y[j], y[k]);
+      __m256i dcdy = _mm256_sub_epi32(x[j], x[k]);
+      __m256i dcdx_neg_mask = _mm256_srai_epi32(dcdx, 31);
+      __m256i dcdx_zero_mask = _mm256_cmpeq_epi32(dcdx, zero);
+      __m256i dcdy_neg_mask = _mm256_srai_epi32(dcdy, 31);
+      __m256i c_dec, c_even, c_odd, eo;
+
+      c_dec = _mm256_or_si256(dcdx_neg_mask,
+                              _mm256_and_si256(dcdx_zero_mask,
+                                               _mm256_xor_si256(dcdy_neg_mask,
+                                                                top_left_flag)));
+
+      c_even = mul_sub_epi64(dcdx, x[j], dcdy, y[j], &c_odd);
+      c_even = _mm256_sub_epi64(c_even, _mm256_shuffle_epi32(c_dec,
+                                                 _MM_SHUFFLE(2,2,0,0)));
+      c_odd = _mm256_sub_epi64(c_odd, _mm256_shuffle_epi32(c_dec,
+                                                _MM_SHUFFLE(3,3,1,1)));
+      store_epi64(batch->c[j], c_even, c_odd);
+
+      dcdx = _mm256_slli_epi32(dcdx, FIXED_ORDER);
+      dcdy = _mm256_slli_epi32(dcdy, FIXED_ORDER);
+
+      eo = _mm256_sub_epi32(_mm256_andnot_si256(dcdy_neg_mask, dcdy),
+                            _mm256_and_si256(dcdx_neg_mask, dcdx));
+
+      _mm256_storeu_si256((__m256i *)batch->dcdx[j], dcdx);
+      _mm256_storeu_si256((__m256i *)batch->dcdy[j], dcdy);
+      _mm256_storeu_si256((__m256i *)batch->eo[j], eo);
+   }
+}
+
+#endif /* HAVE_TRI_BATCH_AVX2 */
+
+
+/**
+ * Set up batch->count triangles.  The results of culled triangles are
+ * undefined.
+ */
+void
+lp_setup_tri_batch(struct lp_setup_tri_batch *batch)
+{
+   assert(batch->count <= LP_SETUP_TRI_BATCH);
+
+   if (batch->region.x1 < batch->region.x0 ||
+       batch->region.y1 < batch->region.y0) {
+      batch->draw_mask = 0;
+      batch->cw_mask = 0;
+      return;
+   }
+
+#if defined(HAVE_TRI_BATCH_AVX2)
+   if (util_cpu_caps.has_avx2) {
+      unsigned i, j;
+
+      /* don't feed garbage to the unused lanes */
+      for (i = batch->count; i < LP_SETUP_TRI_BATCH; i++) {
+         for (j = 0; j < 3; j++) {
+            batch->x[j][i] = 0.0f;
+            batch->y[j][i] = 0.0f;
+         }
+      }
+
+      lp_setup_tri_batch_avx2(batch);
+      batch->draw_mask &= (1 << batch->count) - 1;
+      batch->cw_mask &= batch->draw_mask;
+      return;
+   }
+#endif
+
+   lp_setup_tri_batch_c(batch);
+}
@@ -0,0 +1,95 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The Mesa Authors.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * Batched triangle setup.
+ *
+ * Computes the fixed point positions, facing, bounding boxes and edge
+ * equations of several triangles at once, one triangle per SIMD lane, with
+ * the same results as the per triangle code in lp_setup_tri.c.
+ */
+
+
+#ifndef LP_SETUP_TRI_BATCH_H
+#define LP_SETUP_TRI_BATCH_H
+
+#include "pipe/p_compiler.h"
+#include "util/u_rect.h"
+
+
+/** Number of triangles set up together */
+#define LP_SETUP_TRI_BATCH 8
+
+
+struct lp_rast_plane;
+
+struct lp_setup_tri_batch {
+   /* State, filled in by the caller. */
+   float pixel_offset;
+   boolean bottom_edge_rule;
+   boolean flatshade_first;
+   boolean keep_ccw;           /**< draw triangles with positive area */
+   boolean keep_cw;            /**< draw triangles with negative area */
+   struct u_rect region;       /**< cull triangles outside of this */
+
+   /* Window space vertex positions, filled in by the caller. */
+   unsigned count;
+   float x[3][LP_SETUP_TRI_BATCH];
+   float y[3][LP_SETUP_TRI_BATCH];
+
+   /* Results.  Clockwise triangles get two vertices swapped like
+    * rotate_fixed_position_12() (flatshade_first) or
+    * rotate_fixed_position_01() do, the edge equations are those of the
+    * swapped triangle.
+    */
+   unsigned draw_mask;         /**< triangles which are not culled */
+   unsigned cw_mask;           /**< drawn triangles which were swapped */
+   int32_t bbox_x0[LP_SETUP_TRI_BATCH];
+   int32_t bbox_y0[LP_SETUP_TRI_BATCH];
+   int32_t bbox_x1[LP_SETUP_TRI_BATCH];
+   int32_t bbox_y1[LP_SETUP_TRI_BATCH];
+   int64_t c[3][LP_SETUP_TRI_BATCH];
+   int32_t dcdx[3][LP_SETUP_TRI_BATCH];
+   int32_t dcdy[3][LP_SETUP_TRI_BATCH];
+   uint32_t eo[3][LP_SETUP_TRI_BATCH];
+};
+
+
+void
+lp_setup_tri_batch(struct lp_setup_tri_batch *batch);
+
+void
+lp_setup_tri_batch_c(struct lp_setup_tri_batch *batch);
+
+/* In lp_setup_tri.c */
+boolean
+lp_setup_tri_scalar(const struct lp_setup_tri_batch *batch,
+                    unsigned lane,
+                    boolean *cw,
+                    struct u_rect *bbox,
+                    struct lp_rast_plane *plane);
+
+
+#endif /* LP_SETUP_TRI_BATCH_H */
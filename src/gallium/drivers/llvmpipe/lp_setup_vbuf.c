@@ -37,7 +37,10 @@
 
 
 #include "lp_setup_context.h"
+#include "lp_setup_tri_batch.h"
 #include "lp_context.h"
+#include "lp_screen.h"
+#include "lp_cs_tpool.h"
 #include "draw/draw_vbuf.h"
 #include "draw/draw_vertex.h"
 #include "util/u_memory.h"
@@ -46,6 +49,9 @@
 #define LP_MAX_VBUF_INDEXES 1024
 #define LP_MAX_VBUF_SIZE    4096
 
+/* Least number of triangles binned by a thread of a parallel draw */
+#define LP_BIN_JOB_MIN_TRIS 64
+
   
 
 /** cast wrapper */
@@ -129,6 +135,244 @@ static inline const_float4_ptr get_vert( const void *vertex_buffer,
    return (const_float4_ptr)((char *)vertex_buffer + index * stride);
 }
 
+/**
+ * Triangles collected to be set up together by setup->triangles.
+ */
+struct tri_queue {
+   const_float4_ptr v[3 * LP_SETUP_TRI_BATCH];
+   unsigned nr;
+   unsigned done;     /**< triangles binned so far */
+   boolean failed;    /**< setup->triangles didn't bin all of them */
+};
+
+static inline void flush_tris( struct lp_setup_context *setup,
+                               struct tri_queue *tris )
+{
+   if (tris->nr && !tris->failed) {
+      unsigned done = setup->triangles( setup, tris->v, tris->nr );
+      tris->done += done;
+      tris->failed = done < tris->nr;
+   }
+   tris->nr = 0;
+}
+
+static inline void queue_tri( struct lp_setup_context *setup,
+                              struct tri_queue *tris,
+                              const_float4_ptr v0,
+                              const_float4_ptr v1,
+                              const_float4_ptr v2 )
+{
+   tris->v[3 * tris->nr + 0] = v0;
+   tris->v[3 * tris->nr + 1] = v1;
+   tris->v[3 * tris->nr + 2] = v2;
+   if (++tris->nr == LP_SETUP_TRI_BATCH)
+      flush_tris( setup, tris );
+}
+
+
+/**
+ * The triangles of a PIPE_PRIM_TRIANGLES or PIPE_PRIM_TRIANGLE_STRIP
+ * draw call.
+ */
+struct tri_draw {
+   const void *vertex_buffer;
+   unsigned stride;
+   const ushort *indices;   /**< NULL for draw_arrays */
+   enum pipe_prim_type prim;
+   boolean flatshade_first;
+};
+
+static inline const_float4_ptr tri_vert( const struct tri_draw *draw,
+                                         unsigned i )
+{
+   return get_vert(draw->vertex_buffer,
+                   draw->indices ? draw->indices[i] : i,
+                   draw->stride);
+}
+
+static inline unsigned num_tris( enum pipe_prim_type prim, unsigned nr )
+{
+   if (prim == PIPE_PRIM_TRIANGLES)
+      return nr / 3;
+   return nr > 2 ? nr - 2 : 0;
+}
+
+/**
+ * Draw triangles first to last - 1 of a draw call, returns how many of
+ * them were binned.
+ */
+static unsigned
+emit_tris(struct lp_setup_context *setup,
+          const struct tri_draw *draw,
+          unsigned first, unsigned last)
+{
+   struct tri_queue tris = { .nr = 0 };
+   unsigned t, i;
+
+   if (draw->prim == PIPE_PRIM_TRIANGLES) {
+      for (t = first; t < last && !tris.failed; t++) {
+         i = 3 * t + 2;
+         queue_tri( setup, &tris,
+                    tri_vert(draw, i-2),
+                    tri_vert(draw, i-1),
+                    tri_vert(draw, i-0) );
+      }
+   }
+   else if (draw->flatshade_first) {
+      for (t = first; t < last && !tris.failed; t++) {
+         i = t + 2;
+         /* emit first triangle vertex as first triangle vertex */
+         queue_tri( setup, &tris,
+                    tri_vert(draw, i-2),
+                    tri_vert(draw, i+(i&1)-1),
+                    tri_vert(draw, i-(i&1)) );
+      }
+   }
+   else {
+      for (t = first; t < last && !tris.failed; t++) {
+         i = t + 2;
+         /* emit last triangle vertex as last triangle vertex */
+         queue_tri( setup, &tris,
+                    tri_vert(draw, i+(i&1)-2),
+                    tri_vert(draw, i-(i&1)-1),
+                    tri_vert(draw, i-0) );
+      }
+   }
+   flush_tris( setup, &tris );
+
+   return tris.done;
+}
+
+
+/**
+ * A range of the triangles of a draw call, binned by a thread into a
+ * fork of the scene.
+ */
+struct lp_setup_bin_job {
+   struct lp_setup_context setup;   /**< fork of the setup context */
+   struct lp_scene *scene;          /**< fork of the scene */
+   const struct tri_draw *draw;
+   unsigned first, last;
+   unsigned max_size;               /**< bytes the fork may allocate */
+   unsigned done;                   /**< triangles binned */
+};
+
+static void
+bin_job(void *data, int iter_idx, struct lp_cs_local_mem *lmem)
+{
+   const struct lp_setup_context *setup = data;
+   struct lp_setup_bin_job *job = setup->bin_jobs[iter_idx];
+
+   job->done = 0;
+   if (!lp_scene_fork(job->scene, setup->scene, iter_idx, job->max_size))
+      return;
+
+   lp_setup_fork_triangles(&job->setup, setup, job->scene);
+   job->done = emit_tris(&job->setup, job->draw, job->first, job->last);
+}
+
+/**
+ * Bin the triangles of a large draw call on the threads of the compute
+ * thread pool.  Each thread bins a range of the triangles into a fork of
+ * the scene, the forks are joined in order afterwards.  Returns how many
+ * of the triangles were binned, forks stop once they run out of space
+ * and the caller continues with the remaining triangles.
+ */
+static unsigned
+bin_tris_parallel(struct lp_setup_context *setup,
+                  const struct tri_draw *draw,
+                  unsigned nr_tris)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(setup->pipe->screen);
+   struct llvmpipe_context *lp = llvmpipe_context(setup->pipe);
+   struct lp_cs_tpool_task *task;
+   unsigned num_jobs, space, done = 0, i;
+
+   if (!screen->cs_tpool || screen->cs_tpool->num_threads < 2 ||
+       !lp_setup_can_fork_triangles(setup))
+      return 0;
+
+   num_jobs = MIN3(nr_tris / LP_BIN_JOB_MIN_TRIS,
+                   screen->cs_tpool->num_threads, LP_MAX_SCENE_FORKS);
+   if (num_jobs < 2)
+      return 0;
+
+   /* leave full scenes to the flush in the regular path */
+   space = LP_SCENE_MAX_SIZE - MIN2(setup->scene->scene_size,
+                                    LP_SCENE_MAX_SIZE);
+   if (space < num_jobs * DATA_BLOCK_SIZE)
+      return 0;
+
+   for (i = 0; i < num_jobs; i++) {
+      struct lp_setup_bin_job *job = setup->bin_jobs[i];
+
+      if (!job) {
+         job = CALLOC_STRUCT(lp_setup_bin_job);
+         if (!job)
+            return 0;
+         job->scene = CALLOC_STRUCT(lp_scene);
+         if (!job->scene) {
+            FREE(job);
+            return 0;
+         }
+         setup->bin_jobs[i] = job;
+      }
+
+      job->draw = draw;
+      job->first = nr_tris * i / num_jobs;
+      job->last = nr_tris * (i + 1) / num_jobs;
+      job->max_size = space / num_jobs;
+   }
+
+   task = lp_cs_tpool_queue_task(screen->cs_tpool, bin_job, setup, num_jobs);
+   if (!task)
+      return 0;
+   lp_cs_tpool_wait_for_task(screen->cs_tpool, &task);
+
+   for (i = 0; i < num_jobs; i++) {
+      struct lp_setup_bin_job *job = setup->bin_jobs[i];
+      /* triangles after one which didn't fit must not come before it */
+      boolean keep = done == job->first;
+
+      lp_scene_join(setup->scene, job->scene, keep);
+      if (keep) {
+         done += job->done;
+         setup->counters.nr_empty_64 += job->setup.counters.nr_empty_64;
+         setup->counters.nr_partially_covered_64 +=
+            job->setup.counters.nr_partially_covered_64;
+         setup->counters.nr_fully_covered_64 +=
+            job->setup.counters.nr_fully_covered_64;
+         setup->counters.nr_shade_64 += job->setup.counters.nr_shade_64;
+         setup->counters.nr_shade_opaque_64 +=
+            job->setup.counters.nr_shade_opaque_64;
+      }
+   }
+
+   if (lp->active_statistics_queries) {
+      lp->pipeline_statistics.c_primitives += done;
+   }
+
+   return done;
+}
+
+/**
+ * Draw the triangles of a draw call, on several threads if there are
+ * enough of them.
+ */
+static void
+draw_tris(struct lp_setup_context *setup, const struct tri_draw *draw,
+          unsigned nr)
+{
+   unsigned nr_tris = num_tris(draw->prim, nr);
+   unsigned done = 0;
+
+   if (nr_tris >= 2 * LP_BIN_JOB_MIN_TRIS)
+      done = bin_tris_parallel(setup, draw, nr_tris);
+
+   if (done < nr_tris)
+      emit_tris(setup, draw, done, nr_tris);
+}
+
 /**
  * draw elements / indexed primitives
  */
@@ -184,35 +428,17 @@ lp_setup_draw_elements(struct vbuf_render *vbr, const ushort *indices, uint nr)
       break;
 
    case PIPE_PRIM_TRIANGLES:
-      for (i = 2; i < nr; i += 3) {
-         setup->triangle( setup,
-                          get_vert(vertex_buffer, indices[i-2], stride),
-                          get_vert(vertex_buffer, indices[i-1], stride),
-                          get_vert(vertex_buffer, indices[i-0], stride) );
-      }
-      break;
-
-   case PIPE_PRIM_TRIANGLE_STRIP:
-      if (flatshade_first) {
-         for (i = 2; i < nr; i += 1) {
-            /* emit first triangle vertex as first triangle vertex */
-            setup->triangle( setup,
-                             get_vert(vertex_buffer, indices[i-2], stride),
-                             get_vert(vertex_buffer, indices[i+(i&1)-1], stride),
-                             get_vert(vertex_buffer, indices[i-(i&1)], stride) );
-
-         }
-      }
-      else {
-         for (i = 2; i < nr; i += 1) {
-            /* emit last triangle vertex as last triangle vertex */
-            setup->triangle( setup,
-                             get_vert(vertex_buffer, indices[i+(i&1)-2], stride),
-                             get_vert(vertex_buffer, indices[i-(i&1)-1], stride),
-                             get_vert(vertex_buffer, indices[i-0], stride) );
-         }
-      }
+   case PIPE_PRIM_TRIANGLE_STRIP: {
+      const struct tri_draw draw = {
+         .vertex_buffer = vertex_buffer,
+         .stride = stride,
+         .indices = indices,
+         .prim = setup->prim,
+         .flatshade_first = flatshade_first,
+      };
+      draw_tris( setup, &draw, nr );
       break;
+   }
 
    case PIPE_PRIM_TRIANGLE_FAN:
       if (flatshade_first) {
@@ -382,34 +608,17 @@ lp_setup_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
       break;
 
    case PIPE_PRIM_TRIANGLES:
-      for (i = 2; i < nr; i += 3) {
-         setup->triangle( setup,
-                          get_vert(vertex_buffer, i-2, stride),
-                          get_vert(vertex_buffer, i-1, stride),
-                          get_vert(vertex_buffer, i-0, stride) );
-      }
-      break;
-
-   case PIPE_PRIM_TRIANGLE_STRIP:
-      if (flatshade_first) {
-         for (i = 2; i < nr; i++) {
-            /* emit first triangle vertex as first triangle vertex */
-            setup->triangle( setup,
-                             get_vert(vertex_buffer, i-2, stride),
-                             get_vert(vertex_buffer, i+(i&1)-1, stride),
-                             get_vert(vertex_buffer, i-(i&1), stride) );
-         }
-      }
-      else {
-         for (i = 2; i < nr; i++) {
-            /* emit last triangle vertex as last triangle vertex */
-            setup->triangle( setup,
-                             get_vert(vertex_buffer, i+(i&1)-2, stride),
-                             get_vert(vertex_buffer, i-(i&1)-1, stride),
-                             get_vert(vertex_buffer, i-0, stride) );
-         }
-      }
+   case PIPE_PRIM_TRIANGLE_STRIP: {
+      const struct tri_draw draw = {
+         .vertex_buffer = vertex_buffer,
+         .stride = stride,
+         .indices = NULL,
+         .prim = setup->prim,
+         .flatshade_first = flatshade_first,
+      };
+      draw_tris( setup, &draw, nr );
       break;
+   }
 
    case PIPE_PRIM_TRIANGLE_FAN:
       if (flatshade_first) {
@@ -527,10 +736,18 @@ static void
 lp_setup_vbuf_destroy(struct vbuf_render *vbr)
 {
    struct lp_setup_context *setup = lp_setup_context(vbr);
+   unsigned i;
+
    if (setup->vertex_buffer) {
       align_free(setup->vertex_buffer);
       setup->vertex_buffer = NULL;
    }
+   for (i = 0; i < ARRAY_SIZE(setup->bin_jobs); i++) {
+      if (setup->bin_jobs[i]) {
+         FREE(setup->bin_jobs[i]->scene);
+         FREE(setup->bin_jobs[i]);
+      }
+   }
    lp_setup_destroy(setup);
 }
 
@@ -22,6 +22,7 @@
  * SOFTWARE.
  *
  **************************************************************************/
+#include "util/u_atomic.h"
 #include "util/u_memory.h"
 #include "util/simple_list.h"
 #include "util/os_time.h"
@@ -33,12 +34,14 @@
 #include "gallivm/lp_bld_debug.h"
 #include "gallivm/lp_bld_intr.h"
 #include "gallivm/lp_bld_flow.h"
+#include "gallivm/lp_bld_format.h"
 #include "gallivm/lp_bld_gather.h"
 #include "gallivm/lp_bld_coro.h"
 #include "gallivm/lp_bld_nir.h"
 #include "lp_state_cs.h"
 #include "lp_context.h"
 #include "lp_debug.h"
+#include "lp_flush.h"
 #include "lp_state.h"
 #include "lp_perf.h"
 #include "lp_screen.h"
@@ -82,12 +85,17 @@ generate_compute(struct llvmpipe_context *lp,
    struct lp_build_image_soa *image;
    LLVMValueRef function, coro;
    struct lp_type cs_type;
+   const boolean use_coro = shader->uses_barrier;
    unsigned i;
 
    /*
     * This function has two parts
     * a) setup the coroutine execution environment loop.
     * b) build the compute shader llvm for use inside the coroutine.
+    *
+    * Without barriers the invocations never need to wait for each other,
+    * the shader code then is a plain function which the loop calls for
+    * each invocation in turn.
     */
    assert(lp_native_vector_width / 32 >= 4);
 
@@ -129,6 +137,8 @@ generate_compute(struct llvmpipe_context *lp,
 
    coro = LLVMAddFunction(gallivm->module, func_name_coro, coro_func_type);
    LLVMSetFunctionCallConv(coro, LLVMCCallConv);
+   if (use_coro)
+      lp_build_coro_add_presplit(coro);
 
    variant->function = function;
 
@@ -139,7 +149,8 @@ generate_compute(struct llvmpipe_context *lp,
       }
    }
 
-   lp_build_coro_declare_malloc_hooks(gallivm);
+   if (use_coro)
+      lp_build_coro_declare_malloc_hooks(gallivm);
 
    if (variant->gallivm->cache->data_size)
       return;
@@ -174,7 +185,7 @@ generate_compute(struct llvmpipe_context *lp,
    builder = gallivm->builder;
    assert(builder);
    LLVMPositionBuilderAtEnd(builder, block);
-   sampler = lp_llvm_sampler_soa_create(key->samplers);
+   sampler = lp_llvm_sampler_soa_create(key->samplers, variant->sample_funcs);
    image = lp_llvm_image_soa_create(lp_cs_variant_key_images(key));
 
    struct lp_build_loop_state loop_state[4];
@@ -185,11 +196,14 @@ generate_compute(struct llvmpipe_context *lp,
    num_x_loop = LLVMBuildUDiv(gallivm->builder, num_x_loop, vec_length, "");
    LLVMValueRef partials = LLVMBuildURem(gallivm->builder, x_size_arg, vec_length, "");
 
-   LLVMValueRef coro_num_hdls = LLVMBuildMul(gallivm->builder, num_x_loop, y_size_arg, "");
-   coro_num_hdls = LLVMBuildMul(gallivm->builder, coro_num_hdls, z_size_arg, "");
-
    LLVMTypeRef hdl_ptr_type = LLVMPointerType(LLVMInt8TypeInContext(gallivm->context), 0);
-   LLVMValueRef coro_hdls = LLVMBuildArrayAlloca(gallivm->builder, hdl_ptr_type, coro_num_hdls, "coro_hdls");
+   LLVMValueRef coro_hdls = NULL;
+   if (use_coro) {
+      LLVMValueRef coro_num_hdls = LLVMBuildMul(gallivm->builder, num_x_loop, y_size_arg, "");
+      coro_num_hdls = LLVMBuildMul(gallivm->builder, coro_num_hdls, z_size_arg, "");
+
+      coro_hdls = LLVMBuildArrayAlloca(gallivm->builder, hdl_ptr_type, coro_num_hdls, "coro_hdls");
+   }
 
    unsigned end_coroutine = INT_MAX;
 
@@ -199,8 +213,9 @@ generate_compute(struct llvmpipe_context *lp,
     * passes it checks if the coroutine has completed and resumes it if not.
     */
    /* take x_width - round up to type.length width */
-   lp_build_loop_begin(&loop_state[3], gallivm,
-                       lp_build_const_int32(gallivm, 0)); /* coroutine reentry loop */
+   if (use_coro)
+      lp_build_loop_begin(&loop_state[3], gallivm,
+                          lp_build_const_int32(gallivm, 0)); /* coroutine reentry loop */
    lp_build_loop_begin(&loop_state[2], gallivm,
                        lp_build_const_int32(gallivm, 0)); /* z loop */
    lp_build_loop_begin(&loop_state[1], gallivm,
@@ -227,40 +242,45 @@ generate_compute(struct llvmpipe_context *lp,
       args[15] = y_size_arg;
       args[16] = z_size_arg;
 
-      /* idx = (z * (size_x * size_y) + y * size_x + x */
-      LLVMValueRef coro_hdl_idx = LLVMBuildMul(gallivm->builder, loop_state[2].counter,
-                                               LLVMBuildMul(gallivm->builder, num_x_loop, y_size_arg, ""), "");
-      coro_hdl_idx = LLVMBuildAdd(gallivm->builder, coro_hdl_idx,
-                                  LLVMBuildMul(gallivm->builder, loop_state[1].counter,
-                                               num_x_loop, ""), "");
-      coro_hdl_idx = LLVMBuildAdd(gallivm->builder, coro_hdl_idx,
-                                  loop_state[0].counter, "");
-
-      LLVMValueRef coro_entry = LLVMBuildGEP(gallivm->builder, coro_hdls, &coro_hdl_idx, 1, "");
-
-      LLVMValueRef coro_hdl = LLVMBuildLoad(gallivm->builder, coro_entry, "coro_hdl");
-
-      struct lp_build_if_state ifstate;
-      LLVMValueRef cmp = LLVMBuildICmp(gallivm->builder, LLVMIntEQ, loop_state[3].counter,
-                                       lp_build_const_int32(gallivm, 0), "");
-      /* first time here - call the coroutine function entry point */
-      lp_build_if(&ifstate, gallivm, cmp);
-      LLVMValueRef coro_ret = LLVMBuildCall(gallivm->builder, coro, args, 17, "");
-      LLVMBuildStore(gallivm->builder, coro_ret, coro_entry);
-      lp_build_else(&ifstate);
-      /* subsequent calls for this invocation - check if done. */
-      LLVMValueRef coro_done = lp_build_coro_done(gallivm, coro_hdl);
-      struct lp_build_if_state ifstate2;
-      lp_build_if(&ifstate2, gallivm, coro_done);
-      /* if done destroy and force loop exit */
-      lp_build_coro_destroy(gallivm, coro_hdl);
-      lp_build_loop_force_set_counter(&loop_state[3], lp_build_const_int32(gallivm, end_coroutine - 1));
-      lp_build_else(&ifstate2);
-      /* otherwise resume the coroutine */
-      lp_build_coro_resume(gallivm, coro_hdl);
-      lp_build_endif(&ifstate2);
-      lp_build_endif(&ifstate);
-      lp_build_loop_force_reload_counter(&loop_state[3]);
+      if (!use_coro) {
+         /* just run the invocation */
+         LLVMBuildCall(gallivm->builder, coro, args, 17, "");
+      } else {
+         /* idx = (z * (size_x * size_y) + y * size_x + x */
+         LLVMValueRef coro_hdl_idx = LLVMBuildMul(gallivm->builder, loop_state[2].counter,
+                                                  LLVMBuildMul(gallivm->builder, num_x_loop, y_size_arg, ""), "");
+         coro_hdl_idx = LLVMBuildAdd(gallivm->builder, coro_hdl_idx,
+                                     LLVMBuildMul(gallivm->builder, loop_state[1].counter,
+                                                  num_x_loop, ""), "");
+         coro_hdl_idx = LLVMBuildAdd(gallivm->builder, coro_hdl_idx,
+                                     loop_state[0].counter, "");
+
+         LLVMValueRef coro_entry = LLVMBuildGEP(gallivm->builder, coro_hdls, &coro_hdl_idx, 1, "");
+
+         LLVMValueRef coro_hdl = LLVMBuildLoad(gallivm->builder, coro_entry, "coro_hdl");
+
+         struct lp_build_if_state ifstate;
+         LLVMValueRef cmp = LLVMBuildICmp(gallivm->builder, LLVMIntEQ, loop_state[3].counter,
+                                          lp_build_const_int32(gallivm, 0), "");
+         /* first time here - call the coroutine function entry point */
+         lp_build_if(&ifstate, gallivm, cmp);
+         LLVMValueRef coro_ret = LLVMBuildCall(gallivm->builder, coro, args, 17, "");
+         LLVMBuildStore(gallivm->builder, coro_ret, coro_entry);
+         lp_build_else(&ifstate);
+         /* subsequent calls for this invocation - check if done. */
+         LLVMValueRef coro_done = lp_build_coro_done(gallivm, coro_hdl);
+         struct lp_build_if_state ifstate2;
+         lp_build_if(&ifstate2, gallivm, coro_done);
+         /* if done destroy and force loop exit */
+         lp_build_coro_destroy(gallivm, coro_hdl);
+         lp_build_loop_force_set_counter(&loop_state[3], lp_build_const_int32(gallivm, end_coroutine - 1));
+         lp_build_else(&ifstate2);
+         /* otherwise resume the coroutine */
+         lp_build_coro_resume(gallivm, coro_hdl);
+         lp_build_endif(&ifstate2);
+         lp_build_endif(&ifstate);
+         lp_build_loop_force_reload_counter(&loop_state[3]);
+      }
    }
    lp_build_loop_end_cond(&loop_state[0],
                           num_x_loop,
@@ -271,9 +291,10 @@ generate_compute(struct llvmpipe_context *lp,
    lp_build_loop_end_cond(&loop_state[2],
                           z_size_arg,
                           NULL,  LLVMIntUGE);
-   lp_build_loop_end_cond(&loop_state[3],
-                          lp_build_const_int32(gallivm, end_coroutine),
-                          NULL, LLVMIntEQ);
+   if (use_coro)
+      lp_build_loop_end_cond(&loop_state[3],
+                             lp_build_const_int32(gallivm, end_coroutine),
+                             NULL, LLVMIntEQ);
    LLVMBuildRetVoid(builder);
 
    /* This is stage (b) - generate the compute shader code inside the coroutine. */
@@ -315,8 +336,12 @@ generate_compute(struct llvmpipe_context *lp,
       shared_ptr = lp_jit_cs_thread_data_shared(gallivm, thread_data_ptr);
 
       /* these are coroutine entrypoint necessities */
-      LLVMValueRef coro_id = lp_build_coro_id(gallivm);
-      LLVMValueRef coro_hdl = lp_build_coro_begin_alloc_mem(gallivm, coro_id);
+      LLVMValueRef coro_id = NULL, coro_hdl = NULL, coro_frames = NULL;
+      if (use_coro) {
+         coro_frames = lp_jit_cs_thread_data_coro_frames(gallivm, thread_data_ptr);
+         coro_id = lp_build_coro_id(gallivm);
+         coro_hdl = lp_build_coro_begin_alloc_mem(gallivm, coro_id, coro_frames);
+      }
 
       LLVMValueRef has_partials = LLVMBuildICmp(gallivm->builder, LLVMIntNE, partials, lp_build_const_int32(gallivm, 0), "");
       LLVMValueRef tid_vals[3];
@@ -372,11 +397,10 @@ generate_compute(struct llvmpipe_context *lp,
 
       struct lp_build_coro_suspend_info coro_info;
 
-      LLVMBasicBlockRef sus_block = LLVMAppendBasicBlockInContext(gallivm->context, coro, "suspend");
-      LLVMBasicBlockRef clean_block = LLVMAppendBasicBlockInContext(gallivm->context, coro, "cleanup");
-
-      coro_info.suspend = sus_block;
-      coro_info.cleanup = clean_block;
+      if (use_coro) {
+         coro_info.suspend = LLVMAppendBasicBlockInContext(gallivm->context, coro, "suspend");
+         coro_info.cleanup = LLVMAppendBasicBlockInContext(gallivm->context, coro, "cleanup");
+      }
 
       struct lp_build_tgsi_params params;
       memset(&params, 0, sizeof(params));
@@ -393,7 +417,7 @@ generate_compute(struct llvmpipe_context *lp,
       params.ssbo_sizes_ptr = num_ssbo_ptr;
       params.image = image;
       params.shared_ptr = shared_ptr;
-      params.coro = &coro_info;
+      params.coro = use_coro ? &coro_info : NULL;
       params.kernel_args = kernel_args_ptr;
 
       if (shader->base.type == PIPE_SHADER_IR_TGSI)
@@ -404,16 +428,20 @@ generate_compute(struct llvmpipe_context *lp,
 
       mask_val = lp_build_mask_end(&mask);
 
-      lp_build_coro_suspend_switch(gallivm, &coro_info, NULL, true);
-      LLVMPositionBuilderAtEnd(builder, clean_block);
+      if (use_coro) {
+         lp_build_coro_suspend_switch(gallivm, &coro_info, NULL, true);
+         LLVMPositionBuilderAtEnd(builder, coro_info.cleanup);
 
-      lp_build_coro_free_mem(gallivm, coro_id, coro_hdl);
+         lp_build_coro_free_mem(gallivm, coro_id, coro_hdl, coro_frames);
 
-      LLVMBuildBr(builder, sus_block);
-      LLVMPositionBuilderAtEnd(builder, sus_block);
+         LLVMBuildBr(builder, coro_info.suspend);
+         LLVMPositionBuilderAtEnd(builder, coro_info.suspend);
 
-      lp_build_coro_end(gallivm, coro_hdl);
-      LLVMBuildRet(builder, coro_hdl);
+         lp_build_coro_end(gallivm, coro_hdl);
+         LLVMBuildRet(builder, coro_hdl);
+      } else {
+         LLVMBuildRet(builder, LLVMConstPointerNull(hdl_ptr_type));
+      }
    }
 
    sampler->destroy(sampler);
@@ -423,6 +451,33 @@ generate_compute(struct llvmpipe_context *lp,
    gallivm_verify_function(gallivm, function);
 }
 
+/**
+ * Whether the invocations of a workgroup have to wait for each other, in
+ * which case they run as coroutines.
+ */
+static boolean
+cs_uses_barrier(const struct lp_compute_shader *shader)
+{
+   const struct nir_shader *nir = shader->base.ir.nir;
+
+   if (shader->base.type == PIPE_SHADER_IR_TGSI)
+      return shader->info.base.opcode_count[TGSI_OPCODE_BARRIER] > 0;
+
+   nir_foreach_function(function, nir) {
+      if (!function->impl)
+         continue;
+      nir_foreach_block(block, function->impl) {
+         nir_foreach_instr(instr, block) {
+            if (instr->type == nir_instr_type_intrinsic &&
+                nir_instr_as_intrinsic(instr)->intrinsic ==
+                nir_intrinsic_control_barrier)
+               return TRUE;
+         }
+      }
+   }
+   return FALSE;
+}
+
 static void *
 llvmpipe_create_compute_state(struct pipe_context *pipe,
                                      const struct pipe_compute_state *templ)
@@ -460,6 +515,7 @@ llvmpipe_create_compute_state(struct pipe_context *pipe,
    }
 
    shader->req_local_mem = templ->req_local_mem;
+   shader->uses_barrier = cs_uses_barrier(shader);
    make_empty_list(&shader->variants);
 
    nr_samplers = shader->info.base.file_max[TGSI_FILE_SAMPLER] + 1;
@@ -579,8 +635,8 @@ make_variant_key(struct llvmpipe_context *lp,
           * used views may be included in the shader key.
           */
          if(shader->info.base.file_mask[TGSI_FILE_SAMPLER_VIEW] & (1u << (i & 31))) {
-            lp_sampler_static_texture_state(&cs_sampler[i].texture_state,
-                                            lp->sampler_views[PIPE_SHADER_COMPUTE][i]);
+            llvmpipe_sampler_static_texture_state(&cs_sampler[i].texture_state,
+                                                  lp->sampler_views[PIPE_SHADER_COMPUTE][i]);
          }
       }
    }
@@ -588,8 +644,8 @@ make_variant_key(struct llvmpipe_context *lp,
       key->nr_sampler_views = key->nr_samplers;
       for(i = 0; i < key->nr_sampler_views; ++i) {
          if(shader->info.base.file_mask[TGSI_FILE_SAMPLER] & (1 << i)) {
-            lp_sampler_static_texture_state(&cs_sampler[i].texture_state,
-                                            lp->sampler_views[PIPE_SHADER_COMPUTE][i]);
+            llvmpipe_sampler_static_texture_state(&cs_sampler[i].texture_state,
+                                                  lp->sampler_views[PIPE_SHADER_COMPUTE][i]);
          }
       }
    }
@@ -719,6 +775,7 @@ generate_variant(struct llvmpipe_context *lp,
             shader->no, shader->variants_created);
 
    variant->shader = shader;
+   variant->sample_funcs = screen->sample_funcs;
    memcpy(&variant->key, key, shader->variant_key_size);
 
    if (shader->base.ir.nir) {
@@ -748,9 +805,11 @@ generate_variant(struct llvmpipe_context *lp,
 
    generate_compute(lp, shader, variant);
 
+   if (shader->uses_barrier)
+      lp_build_coro_add_malloc_hooks(variant->gallivm);
+
    gallivm_compile_module(variant->gallivm);
 
-   lp_build_coro_add_malloc_hooks(variant->gallivm);
    variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
 
    variant->jit_function = (lp_jit_cs_func)gallivm_jit_function(variant->gallivm, variant->function);
@@ -851,6 +910,8 @@ llvmpipe_update_cs(struct llvmpipe_context *lp)
       dt = t1 - t0;
       LP_COUNT_ADD(llvm_compile_time, dt);
       LP_COUNT_ADD(nr_llvm_compiles, 2);  /* emit vs. omit in/out test */
+      p_atomic_add(&lp->llvm_compile_time, dt);
+      p_atomic_inc(&lp->nr_llvm_compiles);
 
       /* Put the new variant into the list */
       if (variant) {
@@ -1265,6 +1326,11 @@ cs_exec_fn(void *init_data, int iter_idx, struct lp_cs_local_mem *lmem)
       lmem->local_size = job_info->req_local_mem;
    }
    thread_data.shared = lmem->local_mem_ptr;
+   thread_data.coro_frames = &lmem->coro_frames;
+
+   if (!lmem->cache)
+      lmem->cache = align_calloc(sizeof(struct lp_build_format_cache), 16);
+   thread_data.cache = lmem->cache;
 
    unsigned grid_z = iter_idx / (job_info->grid_size[0] * job_info->grid_size[1]);
    unsigned grid_y = (iter_idx - (grid_z * (job_info->grid_size[0] * job_info->grid_size[1]))) / job_info->grid_size[0];
@@ -1314,6 +1380,8 @@ static void llvmpipe_launch_grid(struct pipe_context *pipe,
 
    memset(&job_info, 0, sizeof(job_info));
 
+   llvmpipe_wait_shader_resources(llvmpipe, PIPE_SHADER_COMPUTE);
+
    llvmpipe_cs_update_derived(llvmpipe, info->input);
 
    fill_grid_size(pipe, info, job_info.grid_size);
@@ -1379,6 +1447,8 @@ llvmpipe_set_global_binding(struct pipe_context *pipe,
       uint32_t offset;
       pipe_resource_reference(&cs->global_buffers[first + i], resources[i]);
       struct llvmpipe_resource *lp_res = llvmpipe_resource(resources[i]);
+      /* The address is the caller's to keep, never move the storage */
+      lp_res->base.is_shared = true;
       offset = *handles[i];
       va = (uintptr_t)((char *)lp_res->data + offset);
       memcpy(handles[i], &va, sizeof(va));
@@ -83,6 +83,9 @@ struct lp_compute_shader_variant
    LLVMValueRef function;
    lp_jit_cs_func jit_function;
 
+   /** Screen-wide sampling functions the code may call, or NULL */
+   struct lp_sample_func_cache *sample_funcs;
+
    /* Total number of LLVM instructions generated */
    unsigned nr_instrs;
 
@@ -105,6 +108,7 @@ struct lp_compute_shader {
    struct lp_tgsi_info info;
 
    uint32_t req_local_mem;
+   boolean uses_barrier;  /**< invocations are run as coroutines */
 
    /* For debugging/profiling purposes */
    unsigned variant_key_size;
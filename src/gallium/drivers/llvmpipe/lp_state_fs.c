@@ -67,6 +67,7 @@
 #include "util/u_string.h"
 #include "util/simple_list.h"
 #include "util/u_dual_blend.h"
+#include "util/u_atomic.h"
 #include "util/os_time.h"
 #include "pipe/p_shader_tokens.h"
 #include "draw/draw_context.h"
@@ -120,14 +121,15 @@ static unsigned fs_no = 0;
  * quad arguments with fs length 8.
  *
  * \param first_quad  which quad(s) of the quad group to test, in [0,3]
- * \param mask_input  bitwise mask for the whole 4x4 stamp
+ * \param mask_input  bitwise masks for the whole 4x4 stamp, 16 bits per
+ *                    sample, four samples per int64
  */
 static LLVMValueRef
 generate_quad_mask(struct gallivm_state *gallivm,
                    struct lp_type fs_type,
                    unsigned first_quad,
                    unsigned sample,
-                   LLVMValueRef mask_input) /* int64 */
+                   LLVMValueRef mask_input) /* int64 * */
 {
    LLVMBuilderRef builder = gallivm->builder;
    struct lp_type mask_type;
@@ -166,7 +168,9 @@ generate_quad_mask(struct gallivm_state *gallivm,
       shift = 0;
    }
 
-   mask_input = LLVMBuildLShr(builder, mask_input, lp_build_const_int64(gallivm, 16 * sample), "");
+   mask_input = lp_build_pointer_get(builder, mask_input,
+                                     lp_build_const_int32(gallivm, sample / 4));
+   mask_input = LLVMBuildLShr(builder, mask_input, lp_build_const_int64(gallivm, 16 * (sample % 4)), "");
    mask_input = LLVMBuildTrunc(builder, mask_input,
                                i32t, "");
    mask_input = LLVMBuildAnd(builder, mask_input, lp_build_const_int32(gallivm, 0xffff), "");
@@ -2720,6 +2724,73 @@ generate_unswizzled_blend(struct gallivm_state *gallivm,
 }
 
 
+/**
+ * Number of fragments the shader processes per vector.
+ *
+ * A 4x4 stamp is normally shaded in two (AVX) or four (SSE) iterations of
+ * native width vectors.  When the CPU has 512-bit vectors the whole stamp
+ * is shaded at once instead, which halves the loop and interpolation
+ * overhead.  1d resources only shade the upper half of the stamp, and
+ * multisampling stays at the native width.
+ */
+static unsigned
+fs_vector_length(const struct lp_fragment_shader_variant_key *key)
+{
+   unsigned length = MIN2(lp_native_vector_width / 32, 16);
+
+   if (lp_wide_vector_width >= 512 && !key->multisample)
+      length = 16;
+
+   if (key->resource_1d)
+      length = MIN2(length, 8);
+
+   return length;
+}
+
+
+/**
+ * Split the 16-wide shader outputs and masks in the upper and lower half
+ * of the stamp for blending, which works on at most 8 fragments at once.
+ */
+static void
+split_fs_outputs(struct gallivm_state *gallivm,
+                 struct lp_type fs_type,
+                 unsigned nr_cbufs,
+                 LLVMValueRef fs_mask[2],
+                 LLVMValueRef fs_out_color[PIPE_MAX_COLOR_BUFS][TGSI_NUM_CHANNELS][4])
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_type half_type = fs_type;
+   unsigned cbuf, chan, i;
+   LLVMValueRef mask;
+
+   assert(fs_type.length == 16);
+   half_type.length = 8;
+
+   mask = fs_mask[0];
+   for (i = 0; i < 2; i++) {
+      fs_mask[i] = lp_build_extract_range(gallivm, mask, i * 8, 8);
+   }
+
+   for (cbuf = 0; cbuf < nr_cbufs; cbuf++) {
+      for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+         LLVMValueRef color = LLVMBuildLoad(builder, fs_out_color[cbuf][chan][0], "");
+         LLVMValueRef halves = lp_build_array_alloca(gallivm,
+                                                     lp_build_vec_type(gallivm, half_type),
+                                                     lp_build_const_int32(gallivm, 2), "");
+         for (i = 0; i < 2; i++) {
+            LLVMValueRef index = lp_build_const_int32(gallivm, i);
+            LLVMValueRef ptr = LLVMBuildGEP(builder, halves, &index, 1, "");
+            LLVMBuildStore(builder,
+                           lp_build_extract_range(gallivm, color, i * 8, 8),
+                           ptr);
+            fs_out_color[cbuf][chan][i] = ptr;
+         }
+      }
+   }
+}
+
+
 /**
  * Generate the runtime callable function for the whole fragment pipeline.
  * Note that the function which we generate operates on a block of 16
@@ -2727,8 +2798,7 @@ generate_unswizzled_blend(struct gallivm_state *gallivm,
  * 2x2 pixels.
  */
 static void
-generate_fragment(struct llvmpipe_context *lp,
-                  struct lp_fragment_shader *shader,
+generate_fragment(struct lp_fragment_shader *shader,
                   struct lp_fragment_shader_variant *variant,
                   unsigned partial_mask)
 {
@@ -2801,7 +2871,7 @@ generate_fragment(struct llvmpipe_context *lp,
    fs_type.sign = TRUE;          /* values are signed */
    fs_type.norm = FALSE;         /* values are not limited to [0,1] or [-1,1] */
    fs_type.width = 32;           /* 32-bit float */
-   fs_type.length = MIN2(lp_native_vector_width / 32, 16); /* n*4 elements per vector */
+   fs_type.length = fs_vector_length(key); /* n*4 elements per vector */
 
    memset(&blend_type, 0, sizeof blend_type);
    blend_type.floating = FALSE; /* values are integers */
@@ -2831,7 +2901,7 @@ generate_fragment(struct llvmpipe_context *lp,
    arg_types[6] = LLVMPointerType(fs_elem_type, 0);    /* dady */
    arg_types[7] = LLVMPointerType(LLVMPointerType(int8_type, 0), 0);  /* color */
    arg_types[8] = LLVMPointerType(int8_type, 0);       /* depth */
-   arg_types[9] = LLVMInt64TypeInContext(gallivm->context);  /* mask_input */
+   arg_types[9] = LLVMPointerType(LLVMInt64TypeInContext(gallivm->context), 0);  /* mask_input */
    arg_types[10] = variant->jit_thread_data_ptr_type;  /* per thread data */
    arg_types[11] = LLVMPointerType(int32_type, 0);     /* stride */
    arg_types[12] = int32_type;                         /* depth_stride */
@@ -2916,7 +2986,7 @@ generate_fragment(struct llvmpipe_context *lp,
    }
 
    /* code generated texture sampling */
-   sampler = lp_llvm_sampler_soa_create(key->samplers);
+   sampler = lp_llvm_sampler_soa_create(key->samplers, variant->sample_funcs);
    image = lp_llvm_image_soa_create(lp_fs_variant_key_images(key));
 
    num_fs = 16 / fs_type.length; /* number of loops per 4x4 stamp */
@@ -2935,13 +3005,14 @@ generate_fragment(struct llvmpipe_context *lp,
       LLVMValueRef glob_sample_pos = LLVMAddGlobal(gallivm->module, LLVMArrayType(flt_type, key->coverage_samples * 2), "");
       LLVMValueRef sample_pos_array;
 
-      if (key->multisample && key->coverage_samples == 4) {
-         LLVMValueRef sample_pos_arr[8];
-         for (unsigned i = 0; i < 4; i++) {
-            sample_pos_arr[i * 2] = LLVMConstReal(flt_type, lp_sample_pos_4x[i][0]);
-            sample_pos_arr[i * 2 + 1] = LLVMConstReal(flt_type, lp_sample_pos_4x[i][1]);
+      const float (*sample_pos)[2] = lp_sample_pos(key->coverage_samples);
+      if (key->multisample && sample_pos) {
+         LLVMValueRef sample_pos_arr[LP_MAX_SAMPLES * 2];
+         for (unsigned i = 0; i < key->coverage_samples; i++) {
+            sample_pos_arr[i * 2] = LLVMConstReal(flt_type, sample_pos[i][0]);
+            sample_pos_arr[i * 2 + 1] = LLVMConstReal(flt_type, sample_pos[i][1]);
          }
-         sample_pos_array = LLVMConstArray(LLVMFloatTypeInContext(gallivm->context), sample_pos_arr, 8);
+         sample_pos_array = LLVMConstArray(LLVMFloatTypeInContext(gallivm->context), sample_pos_arr, key->coverage_samples * 2);
       } else {
          LLVMValueRef sample_pos_arr[2];
          sample_pos_arr[0] = LLVMConstReal(flt_type, 0.5);
@@ -3068,6 +3139,16 @@ generate_fragment(struct llvmpipe_context *lp,
 
    sampler->destroy(sampler);
    image->destroy(image);
+
+   if (fs_type.length == 16) {
+      assert(!key->multisample);
+      split_fs_outputs(gallivm, fs_type,
+                       dual_source_blend ? MAX2(key->nr_cbufs, 2) : key->nr_cbufs,
+                       fs_mask, fs_out_color[0]);
+      fs_type.length = 8;
+      num_fs = 2;
+   }
+
    /* Loop over color outputs / color buffers to do blending.
     */
    for(cbuf = 0; cbuf < key->nr_cbufs; cbuf++) {
@@ -3250,6 +3331,7 @@ lp_debug_fs_variant(struct lp_fragment_shader_variant *variant)
       nir_print_shader(variant->shader->base.ir.nir, stderr);
    dump_fs_variant_key(&variant->key);
    debug_printf("variant->opaque = %u\n", variant->opaque);
+   debug_printf("variant->hiz_cull = %u\n", variant->hiz_cull);
    debug_printf("\n");
 }
 
@@ -3275,9 +3357,232 @@ lp_fs_get_ir_cache_key(struct lp_fragment_shader_variant *variant,
    blob_finish(&blob);
 }
 
+/**
+ * Generate and compile the code of a fragment shader variant.
+ * variant->gallivm must have been created already.
+ */
+static void
+compile_variant(struct lp_fragment_shader *shader,
+                struct lp_fragment_shader_variant *variant)
+{
+   lp_jit_init_types(variant);
+   
+   if (variant->jit_function[RAST_EDGE_TEST] == NULL)
+      generate_fragment(shader, variant, RAST_EDGE_TEST);
+
+   if (variant->jit_function[RAST_WHOLE] == NULL) {
+      if (variant->opaque) {
+         /* Specialized shader, which doesn't need to read the color buffer. */
+         generate_fragment(shader, variant, RAST_WHOLE);
+      }
+   }
+
+   /*
+    * Compile everything
+    */
+
+   gallivm_compile_module(variant->gallivm);
+
+   variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
+
+   if (variant->function[RAST_EDGE_TEST]) {
+      variant->jit_function[RAST_EDGE_TEST] = (lp_jit_frag_func)
+            gallivm_jit_function(variant->gallivm,
+                                 variant->function[RAST_EDGE_TEST]);
+   }
+
+   if (variant->function[RAST_WHOLE]) {
+         variant->jit_function[RAST_WHOLE] = (lp_jit_frag_func)
+               gallivm_jit_function(variant->gallivm,
+                                    variant->function[RAST_WHOLE]);
+   } else if (!variant->jit_function[RAST_WHOLE]) {
+      variant->jit_function[RAST_WHOLE] = variant->jit_function[RAST_EDGE_TEST];
+   }
+}
+
+
+/**
+ * Background compilation of the optimized code of a variant.
+ * The job works on private copies of everything the compilation touches,
+ * so that it can run concurrently with the context's thread.
+ */
+struct lp_fs_compile_job
+{
+   /** Copy of the shader, with a private clone of the NIR */
+   struct lp_fragment_shader shader;
+   /** Variant the optimized code is built in, swapped in once done */
+   struct lp_fragment_shader_variant *variant;
+   struct llvmpipe_screen *screen;
+   LLVMContextRef context;
+   struct lp_cached_code cached;
+   bool needs_caching;
+   unsigned char ir_sha1_cache_key[20];
+   int64_t compile_time;  /**< in microseconds */
+};
+
+
+static void
+fs_compile_job_execute(void *data, int thread_index)
+{
+   struct lp_fs_compile_job *job = data;
+   struct lp_fragment_shader_variant *variant = job->variant;
+   char module_name[64];
+   int64_t t0;
+
+   snprintf(module_name, sizeof(module_name), "fs%u_variant%u_async",
+            job->shader.no, variant->no);
+
+   job->context = LLVMContextCreate();
+   if (!job->context)
+      return;
+
+   variant->gallivm = gallivm_create(module_name, job->context, &job->cached);
+   if (!variant->gallivm)
+      return;
+
+   t0 = os_time_get();
+   compile_variant(&job->shader, variant);
+   job->compile_time = os_time_get() - t0;
+
+   if (job->needs_caching)
+      lp_disk_cache_insert_shader(job->screen, &job->cached,
+                                  job->ir_sha1_cache_key);
+
+   gallivm_free_ir(variant->gallivm);
+}
+
+
+static void
+fs_compile_job_destroy(struct lp_fs_compile_job *job)
+{
+   if (job->variant->gallivm)
+      gallivm_destroy(job->variant->gallivm);
+   if (job->context)
+      LLVMContextDispose(job->context);
+   if (job->shader.base.type == PIPE_SHADER_IR_NIR)
+      ralloc_free(job->shader.base.ir.nir);
+   FREE(job->variant);
+   FREE(job);
+}
+
+
+/**
+ * Queue the compilation of the optimized code of a variant.
+ * \return FALSE if the variant needs to be compiled synchronously
+ */
+static boolean
+queue_variant_compile(struct llvmpipe_context *lp,
+                      struct lp_fragment_shader *shader,
+                      struct lp_fragment_shader_variant *variant,
+                      const unsigned char *ir_sha1_cache_key)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
+   size_t variant_size = sizeof *variant + shader->variant_key_size -
+                         sizeof variant->key;
+   struct lp_fs_compile_job *job;
+
+   job = CALLOC_STRUCT(lp_fs_compile_job);
+   if (!job)
+      return FALSE;
+
+   job->variant = MALLOC(variant_size);
+   if (!job->variant) {
+      FREE(job);
+      return FALSE;
+   }
+
+   job->shader = *shader;
+   if (shader->base.type == PIPE_SHADER_IR_NIR) {
+      /* lp_build_nir_llvm() modifies the NIR it translates */
+      job->shader.base.ir.nir = nir_shader_clone(NULL, shader->base.ir.nir);
+      if (!job->shader.base.ir.nir) {
+         FREE(job->variant);
+         FREE(job);
+         return FALSE;
+      }
+   }
+
+   memcpy(job->variant, variant, variant_size);
+   job->variant->gallivm = NULL;
+   job->variant->nr_instrs = 0;
+   memset(job->variant->function, 0, sizeof(job->variant->function));
+   memset(job->variant->jit_function, 0, sizeof(job->variant->jit_function));
+   job->variant->jit_funcs = NULL;
+
+   job->screen = screen;
+   if (ir_sha1_cache_key) {
+      job->needs_caching = true;
+      memcpy(job->ir_sha1_cache_key, ir_sha1_cache_key,
+             sizeof(job->ir_sha1_cache_key));
+   }
+
+   variant->job = job;
+   variant->pending = TRUE;
+   lp->nr_fs_variants_pending++;
+   p_atomic_inc(&screen->num_fs_async_compiles);
+
+   util_queue_add_job(&screen->fs_compile_queue, job, &variant->ready,
+                      fs_compile_job_execute, NULL, 0);
+   return TRUE;
+}
+
+
+/**
+ * Switch a variant over to the code built by its background compilation.
+ * The background compilation must be done.
+ */
+static void
+finish_variant_compile(struct llvmpipe_context *lp,
+                       struct lp_fragment_shader_variant *variant)
+{
+   struct lp_fs_compile_job *job = variant->job;
+   struct lp_fragment_shader_variant *compiled = job->variant;
+
+   assert(util_queue_fence_is_signalled(&variant->ready));
+
+   LP_COUNT_ADD(llvm_compile_time, job->compile_time);
+   LP_COUNT_ADD(nr_llvm_compiles, 2);  /* emit vs. omit in/out test */
+   p_atomic_add(&lp->llvm_compile_time, job->compile_time);
+   p_atomic_inc(&lp->nr_llvm_compiles);
+
+   if (compiled->jit_function[RAST_EDGE_TEST]) {
+      /* Scenes in flight may still run the unoptimized code, keep it. */
+      variant->fallback_gallivm = variant->gallivm;
+      variant->gallivm = compiled->gallivm;
+      variant->context = job->context;
+
+      lp->nr_fs_instrs += compiled->nr_instrs - variant->nr_instrs;
+      variant->nr_instrs = compiled->nr_instrs;
+
+      /*
+       * Rasterizer threads may be running the variant, let them see both
+       * functions at once, and only once they are written.
+       */
+      variant->opt_jit_function[RAST_EDGE_TEST] =
+         compiled->jit_function[RAST_EDGE_TEST];
+      variant->opt_jit_function[RAST_WHOLE] =
+         compiled->jit_function[RAST_WHOLE];
+      p_atomic_set(&variant->jit_funcs, variant->opt_jit_function);
+
+      compiled->gallivm = NULL;
+      job->context = NULL;
+   }
+   /* else the background compilation failed, stick to the fallback */
+
+   fs_compile_job_destroy(job);
+   variant->job = NULL;
+   variant->pending = FALSE;
+   lp->nr_fs_variants_pending--;
+}
+
+
 /**
  * Generate a new fragment shader variant from the shader code and
  * other state indicated by the key.
+ *
+ * With LP_ASYNC_FS, variants missing from the disk cache are first
+ * compiled without optimizations, which is a lot quicker, and the
+ * optimized code is built in the background.
  */
 static struct lp_fragment_shader_variant *
 generate_variant(struct llvmpipe_context *lp,
@@ -3301,7 +3606,9 @@ generate_variant(struct llvmpipe_context *lp,
             shader->no, shader->variants_created);
 
    variant->shader = shader;
+   variant->sample_funcs = screen->sample_funcs;
    memcpy(&variant->key, key, shader->variant_key_size);
+   util_queue_fence_init(&variant->ready);
 
    if (shader->base.ir.nir) {
       lp_fs_get_ir_cache_key(variant, ir_sha1_cache_key);
@@ -3310,11 +3617,6 @@ generate_variant(struct llvmpipe_context *lp,
       if (!cached.data_size)
          needs_caching = true;
    }
-   variant->gallivm = gallivm_create(module_name, lp->context, &cached);
-   if (!variant->gallivm) {
-      FREE(variant);
-      return NULL;
-   }
 
    variant->list_item_global.base = variant;
    variant->list_item_local.base = variant;
@@ -3344,44 +3646,46 @@ generate_variant(struct llvmpipe_context *lp,
          !shader->info.base.writes_samplemask
       ? TRUE : FALSE;
 
+   variant->hiz_cull =
+         key->depth.enabled &&
+         (key->depth.func == PIPE_FUNC_LESS ||
+          key->depth.func == PIPE_FUNC_LEQUAL ||
+          key->depth.func == PIPE_FUNC_GREATER ||
+          key->depth.func == PIPE_FUNC_GEQUAL) &&
+         !key->stencil[0].enabled &&
+         !key->depth_clamp &&
+         !key->multisample &&
+         !shader->info.base.writes_z &&
+         (!shader->info.base.writes_memory ||
+          shader->info.base.properties[TGSI_PROPERTY_FS_EARLY_DEPTH_STENCIL])
+      ? TRUE : FALSE;
+
    if ((LP_DEBUG & DEBUG_FS) || (gallivm_debug & GALLIVM_DEBUG_IR)) {
       lp_debug_fs_variant(variant);
    }
 
-   lp_jit_init_types(variant);
-   
-   if (variant->jit_function[RAST_EDGE_TEST] == NULL)
-      generate_fragment(lp, shader, variant, RAST_EDGE_TEST);
-
-   if (variant->jit_function[RAST_WHOLE] == NULL) {
-      if (variant->opaque) {
-         /* Specialized shader, which doesn't need to read the color buffer. */
-         generate_fragment(lp, shader, variant, RAST_WHOLE);
-      }
+   if (screen->async_fs && !cached.data_size &&
+       queue_variant_compile(lp, shader, variant,
+                             needs_caching ? ir_sha1_cache_key : NULL)) {
+      variant->gallivm = gallivm_create_unoptimized(module_name, lp->context);
+      needs_caching = false;
    }
-
-   /*
-    * Compile everything
-    */
-
-   gallivm_compile_module(variant->gallivm);
-
-   variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
-
-   if (variant->function[RAST_EDGE_TEST]) {
-      variant->jit_function[RAST_EDGE_TEST] = (lp_jit_frag_func)
-            gallivm_jit_function(variant->gallivm,
-                                 variant->function[RAST_EDGE_TEST]);
+   else {
+      variant->gallivm = gallivm_create(module_name, lp->context, &cached);
    }
-
-   if (variant->function[RAST_WHOLE]) {
-         variant->jit_function[RAST_WHOLE] = (lp_jit_frag_func)
-               gallivm_jit_function(variant->gallivm,
-                                    variant->function[RAST_WHOLE]);
-   } else if (!variant->jit_function[RAST_WHOLE]) {
-      variant->jit_function[RAST_WHOLE] = variant->jit_function[RAST_EDGE_TEST];
+   if (!variant->gallivm) {
+      if (variant->pending) {
+         util_queue_fence_wait(&variant->ready);
+         fs_compile_job_destroy(variant->job);
+         lp->nr_fs_variants_pending--;
+      }
+      FREE(variant);
+      return NULL;
    }
 
+   compile_variant(shader, variant);
+   variant->jit_funcs = variant->jit_function;
+
    if (needs_caching) {
       lp_disk_cache_insert_shader(screen, &cached, ir_sha1_cache_key);
    }
@@ -3392,6 +3696,35 @@ generate_variant(struct llvmpipe_context *lp,
 }
 
 
+/**
+ * Switch the variants whose background compilation is done over to the
+ * optimized code.  Called before each draw while there are any pending.
+ */
+void
+llvmpipe_update_pending_fs_variants(struct llvmpipe_context *lp)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
+   struct lp_fs_variant_list_item *li;
+   unsigned pending = lp->nr_fs_variants_pending;
+
+   /* Recently created variants are at the head of the list */
+   li = first_elem(&lp->fs_variants_list);
+   while (pending && !at_end(&lp->fs_variants_list, li)) {
+      struct lp_fragment_shader_variant *variant = li->base;
+
+      if (variant->pending) {
+         pending--;
+         if (util_queue_fence_is_signalled(&variant->ready))
+            finish_variant_compile(lp, variant);
+      }
+      li = next_elem(li);
+   }
+
+   if (lp->fs_variant && lp->fs_variant->pending)
+      p_atomic_inc(&screen->num_fs_fallback_draws);
+}
+
+
 static void *
 llvmpipe_create_fs_state(struct pipe_context *pipe,
                          const struct pipe_shader_state *templ)
@@ -3529,7 +3862,20 @@ llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
                    lp->nr_fs_variants, variant->nr_instrs, lp->nr_fs_instrs);
    }
 
+   if (variant->pending) {
+      util_queue_fence_wait(&variant->ready);
+      finish_variant_compile(lp, variant);
+   }
+   util_queue_fence_destroy(&variant->ready);
+
    gallivm_destroy(variant->gallivm);
+   if (variant->fallback_gallivm)
+      gallivm_destroy(variant->fallback_gallivm);
+   if (variant->context)
+      LLVMContextDispose(variant->context);
+
+   if (lp->fs_variant == variant)
+      lp->fs_variant = NULL;
 
    /* remove from shader's list */
    remove_from_list(&variant->list_item_local);
@@ -3680,6 +4026,13 @@ llvmpipe_set_shader_images(struct pipe_context *pipe,
    for (i = start_slot, idx = 0; i < start_slot + count; i++, idx++) {
       const struct pipe_image_view *image = images ? &images[idx] : NULL;
 
+      /* Shader images are accessed linearly, tiled textures lack the bind */
+      if (image && image->resource &&
+          llvmpipe_resource_is_tiled(image->resource)) {
+         debug_printf("Illegal shader image of a sampler view only texture\n");
+         image = NULL;
+      }
+
       util_copy_image_view(&llvmpipe->images[shader][i], image);
    }
 
@@ -3720,6 +4073,27 @@ force_dst_alpha_one(unsigned factor, boolean clamped_zero)
 }
 
 
+/**
+ * Whether the shader results depend on the sample being shaded, so that
+ * it has to run once per sample even without sample shading enabled.
+ */
+static boolean
+fs_reads_sample_state(const struct tgsi_shader_info *info)
+{
+   unsigned i;
+
+   if (info->uses_persp_sample || info->uses_linear_sample)
+      return TRUE;
+
+   for (i = 0; i < info->num_system_values; i++) {
+      if (info->system_value_semantic_name[i] == TGSI_SEMANTIC_SAMPLEID ||
+          info->system_value_semantic_name[i] == TGSI_SEMANTIC_SAMPLEPOS)
+         return TRUE;
+   }
+   return FALSE;
+}
+
+
 /**
  * We need to generate several variants of the fragment pipeline to match
  * all the combinations of the contributing state atoms.
@@ -3803,7 +4177,13 @@ make_variant_key(struct llvmpipe_context *lp,
    key->min_samples = 1;
    if (key->multisample) {
       key->coverage_samples = util_framebuffer_get_num_samples(&lp->framebuffer);
-      key->min_samples = lp->min_samples == 1 ? 1 : key->coverage_samples;
+      /*
+       * Unless sample shading is required the shader runs once per pixel
+       * and its results are replicated to all covered samples, only depth,
+       * stencil and blending are done per sample.
+       */
+      if (lp->min_samples > 1 || fs_reads_sample_state(&shader->info.base))
+         key->min_samples = key->coverage_samples;
    }
    key->nr_cbufs = lp->framebuffer.nr_cbufs;
 
@@ -3920,8 +4300,8 @@ make_variant_key(struct llvmpipe_context *lp,
           * used views may be included in the shader key.
           */
          if(shader->info.base.file_mask[TGSI_FILE_SAMPLER_VIEW] & (1u << (i & 31))) {
-            lp_sampler_static_texture_state(&fs_sampler[i].texture_state,
-                                            lp->sampler_views[PIPE_SHADER_FRAGMENT][i]);
+            llvmpipe_sampler_static_texture_state(&fs_sampler[i].texture_state,
+                                                  lp->sampler_views[PIPE_SHADER_FRAGMENT][i]);
          }
       }
    }
@@ -3929,8 +4309,8 @@ make_variant_key(struct llvmpipe_context *lp,
       key->nr_sampler_views = key->nr_samplers;
       for(i = 0; i < key->nr_sampler_views; ++i) {
          if(shader->info.base.file_mask[TGSI_FILE_SAMPLER] & (1 << i)) {
-            lp_sampler_static_texture_state(&fs_sampler[i].texture_state,
-                                            lp->sampler_views[PIPE_SHADER_FRAGMENT][i]);
+            llvmpipe_sampler_static_texture_state(&fs_sampler[i].texture_state,
+                                                  lp->sampler_views[PIPE_SHADER_FRAGMENT][i]);
          }
       }
    }
@@ -4044,6 +4424,8 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
       dt = t1 - t0;
       LP_COUNT_ADD(llvm_compile_time, dt);
       LP_COUNT_ADD(nr_llvm_compiles, 2);  /* emit vs. omit in/out test */
+      p_atomic_add(&lp->llvm_compile_time, dt);
+      p_atomic_inc(&lp->nr_llvm_compiles);
 
       /* Put the new variant into the list */
       if (variant) {
@@ -4057,6 +4439,7 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
 
    /* Bind this variant */
    lp_setup_set_fs_variant(lp->setup, variant);
+   lp->fs_variant = variant;
 }
 
 
@@ -32,6 +32,7 @@
 
 #include "pipe/p_compiler.h"
 #include "pipe/p_state.h"
+#include "util/u_queue.h"
 #include "tgsi/tgsi_scan.h" /* for tgsi_shader_info */
 #include "gallivm/lp_bld_sample.h" /* for struct lp_sampler_static_state */
 #include "gallivm/lp_bld_tgsi.h" /* for lp_tgsi_info */
@@ -40,6 +41,7 @@
 
 struct tgsi_token;
 struct lp_fragment_shader;
+struct lp_fs_compile_job;
 
 
 /** Indexes into jit_function[] array */
@@ -131,6 +133,13 @@ struct lp_fragment_shader_variant
 
    boolean opaque;
 
+   /**
+    * The depth test alone decides whether fragments are kept, on their
+    * interpolated depth, so the rasterizer may skip blocks which would
+    * fail it (see LP_HIZ).
+    */
+   boolean hiz_cull;
+
    struct gallivm_state *gallivm;
 
    LLVMTypeRef jit_context_ptr_type;
@@ -141,6 +150,18 @@ struct lp_fragment_shader_variant
 
    lp_jit_frag_func jit_function[2];
 
+   /**
+    * The pair of functions rasterizer threads call, jit_function or once
+    * the background compilation is done opt_jit_function.  Switched over
+    * while scenes may be running the variant, so it must be read with
+    * p_atomic_read() and the pair it points to used as a whole.
+    */
+   const lp_jit_frag_func *jit_funcs;
+   lp_jit_frag_func opt_jit_function[2];
+
+   /** Screen-wide sampling functions the code may call, or NULL */
+   struct lp_sample_func_cache *sample_funcs;
+
    /* Total number of LLVM instructions generated */
    unsigned nr_instrs;
 
@@ -150,6 +171,19 @@ struct lp_fragment_shader_variant
    /* For debugging/profiling purposes */
    unsigned no;
 
+   /*
+    * Asynchronous compilation, see LP_ASYNC_FS.  While pending,
+    * jit_funcs points at unoptimized code and the optimized code is
+    * being built on the screen's compile queue.
+    */
+   boolean pending;
+   struct util_queue_fence ready;
+   struct lp_fs_compile_job *job;
+   /** Unoptimized code, kept around as scenes may still use it */
+   struct gallivm_state *fallback_gallivm;
+   /** LLVM context of background compiled code, owned by the variant */
+   LLVMContextRef context;
+
    /* key is variable-sized, must be last */
    struct lp_fragment_shader_variant_key key;
 };
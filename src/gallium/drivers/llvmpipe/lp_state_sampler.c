@@ -281,7 +281,13 @@ prepare_shader_sampling(
                last_level = view->u.tex.last_level;
                assert(first_level <= last_level);
                assert(last_level <= res->last_level);
-               addr = lp_tex->tex_data;
+               /* The draw module samples the linear layout only */
+               addr = llvmpipe_get_linear_texture_data(lp_tex);
+               if (!addr) {
+                  debug_printf("llvmpipe: out of memory for the linear copy "
+                               "of texture %u\n", lp_tex->id);
+                  addr = lp_tex->tex_data;
+               }
 
                sample_stride = lp_tex->sample_stride;
 
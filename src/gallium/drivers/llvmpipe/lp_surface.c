@@ -176,6 +176,14 @@ llvmpipe_create_surface(struct pipe_context *pipe,
 {
    struct pipe_surface *ps;
 
+   /* Rendering, including blits and clears, assumes the linear layout,
+    * and tiled textures never change theirs
+    */
+   if (llvmpipe_resource_is_tiled(pt)) {
+      debug_printf("Illegal surface creation of a sampler view only texture\n");
+      return NULL;
+   }
+
    if (!(pt->bind & (PIPE_BIND_DEPTH_STENCIL | PIPE_BIND_RENDER_TARGET))) {
       debug_printf("Illegal surface creation without bind flag\n");
       if (util_format_is_depth_or_stencil(surf_tmpl->format)) {
@@ -237,13 +245,11 @@ llvmpipe_get_sample_position(struct pipe_context *pipe,
                              unsigned sample_index,
                              float *out_value)
 {
-   switch (sample_count) {
-   case 4:
-      out_value[0] = lp_sample_pos_4x[sample_index][0];
-      out_value[1] = lp_sample_pos_4x[sample_index][1];
-      break;
-   default:
-      break;
+   const float (*sample_pos)[2] = lp_sample_pos(sample_count);
+
+   if (sample_pos) {
+      out_value[0] = sample_pos[sample_index][0];
+      out_value[1] = sample_pos[sample_index][1];
    }
 }
 
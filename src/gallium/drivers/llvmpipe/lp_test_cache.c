@@ -0,0 +1,320 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The Mesa Authors.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Shader cache test and cold vs. warm startup benchmark.
+ *
+ * Compiles a shader-like function once from scratch, as on the first run
+ * of an application, and again from the machine code captured by the object
+ * cache, as on later runs with a warm disk cache.  Checks that both produce
+ * the same results and reports the time each took.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "util/os_time.h"
+#include "util/u_memory.h"
+
+#include "gallivm/lp_bld_arit.h"
+#include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_misc.h"
+
+#include "lp_test.h"
+
+
+typedef void (*cache_test_func_t)(float *out, const float *in);
+
+
+static const unsigned test_stages[] = { 1, 2, 4, 8, 16 };
+
+
+/* Each run is a full compile, keep the default test fast. */
+#define MAX_RUNS 4
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "stages\t"
+           "cold_msecs\t"
+           "warm_msecs\t"
+           "code_size\n");
+
+   fflush(fp);
+}
+
+
+/**
+ * Build a function with roughly the instruction mix of a fragment shader
+ * doing some math, made bigger or smaller by the number of stages.
+ */
+static LLVMValueRef
+build_cache_test_func(struct gallivm_state *gallivm, struct lp_type type,
+                      unsigned num_stages)
+{
+   LLVMContextRef context = gallivm->context;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef vf32t = lp_build_vec_type(gallivm, type);
+   LLVMTypeRef args[2] = { LLVMPointerType(vf32t, 0), LLVMPointerType(vf32t, 0) };
+   LLVMValueRef func = LLVMAddFunction(gallivm->module, "cache_test",
+                                       LLVMFunctionType(LLVMVoidTypeInContext(context),
+                                                        args, ARRAY_SIZE(args), 0));
+   LLVMBasicBlockRef block = LLVMAppendBasicBlockInContext(context, func, "entry");
+   struct lp_build_context bld;
+   LLVMValueRef x, y;
+   unsigned i;
+
+   lp_build_context_init(&bld, gallivm, type);
+
+   LLVMSetFunctionCallConv(func, LLVMCCallConv);
+
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   x = LLVMBuildLoad(builder, LLVMGetParam(func, 1), "");
+   y = bld.one;
+
+   for (i = 0; i < num_stages; i++) {
+      LLVMValueRef s, e, l;
+
+      s = lp_build_sin(&bld, lp_build_add(&bld, x, y));
+      e = lp_build_exp2(&bld, lp_build_min(&bld, s, bld.one));
+      l = lp_build_log2(&bld, lp_build_add(&bld, lp_build_abs(&bld, x), bld.one));
+      y = lp_build_mad(&bld, e, l, y);
+      x = lp_build_sqrt(&bld, lp_build_add(&bld, lp_build_mul(&bld, x, x), e));
+   }
+
+   LLVMBuildStore(builder, lp_build_add(&bld, x, y), LLVMGetParam(func, 0));
+
+   LLVMBuildRetVoid(builder);
+
+   gallivm_verify_function(gallivm, func);
+
+   return func;
+}
+
+
+/**
+ * Compile the test function and run it.  If cache->data_size is zero this
+ * is a cold compile, and the generated machine code is returned in cache;
+ * otherwise the code in cache is loaded.  Returns the time in usecs.
+ */
+static int64_t
+compile_and_run(struct lp_type type, unsigned num_stages,
+                struct lp_cached_code *cache,
+                float *out, const float *in)
+{
+   LLVMContextRef context;
+   struct gallivm_state *gallivm;
+   cache_test_func_t test_func_jit;
+   LLVMValueRef func;
+   void *data = NULL;
+   size_t data_size = 0;
+   int64_t start, end;
+
+   start = os_time_get_nano();
+
+   context = LLVMContextCreate();
+   gallivm = gallivm_create("cache_test_module", context, cache);
+
+   func = build_cache_test_func(gallivm, type, num_stages);
+
+   gallivm_compile_module(gallivm);
+
+   test_func_jit = (cache_test_func_t) gallivm_jit_function(gallivm, func);
+
+   end = os_time_get_nano();
+
+   /* The object cache data is freed with the IR, keep a copy. */
+   if (cache->data_size) {
+      data_size = cache->data_size;
+      data = malloc(data_size);
+      if (data)
+         memcpy(data, cache->data, data_size);
+   }
+
+   gallivm_free_ir(gallivm);
+
+   test_func_jit(out, in);
+
+   gallivm_destroy(gallivm);
+   LLVMContextDispose(context);
+
+   cache->data = data;
+   cache->data_size = data ? data_size : 0;
+   cache->jit_obj_cache = NULL;
+
+   return (end - start) / 1000;
+}
+
+
+static boolean
+test_cache(unsigned verbose, FILE *fp, unsigned num_stages,
+           unsigned num_runs)
+{
+   struct lp_type type = lp_type_float_vec(32, lp_native_vector_width);
+   struct lp_cached_code cache;
+   int64_t cold_usecs = 0, warm_usecs = 0;
+   boolean success = TRUE;
+   size_t code_size = 0;
+   float *in, *ref, *out;
+   unsigned i, run;
+
+   in = align_malloc(type.length * 4, type.length * 4);
+   ref = align_malloc(type.length * 4, type.length * 4);
+   out = align_malloc(type.length * 4, type.length * 4);
+
+   for (i = 0; i < type.length; i++)
+      in[i] = (float)i / type.length - 0.5f;
+
+   for (run = 0; run < num_runs; run++) {
+      /* first application start: nothing cached */
+      memset(&cache, 0, sizeof cache);
+      cold_usecs += compile_and_run(type, num_stages, &cache, ref, in);
+
+      if (!cache.data_size) {
+         if (verbose)
+            fprintf(stderr, "no machine code was captured\n");
+         success = FALSE;
+         break;
+      }
+      code_size = cache.data_size;
+
+      /* later application starts: machine code from the cache */
+      warm_usecs += compile_and_run(type, num_stages, &cache, out, in);
+
+      free(cache.data);
+
+      if (memcmp(out, ref, type.length * 4) != 0) {
+         if (verbose) {
+            fprintf(stderr, "cached code results differ:\n");
+            fprintf(stderr, "  ref: ");
+            dump_vec(stderr, type, ref);
+            fprintf(stderr, "\n  out: ");
+            dump_vec(stderr, type, out);
+            fprintf(stderr, "\n");
+         }
+         success = FALSE;
+         break;
+      }
+   }
+
+   if (num_runs) {
+      cold_usecs /= num_runs;
+      warm_usecs /= num_runs;
+   }
+
+   if (verbose || !success)
+      printf("%s: %2u stages: cold %8.3f msecs, warm %8.3f msecs (%.1fx), %6u bytes of code\n",
+             success ? "PASS" : "FAIL", num_stages,
+             cold_usecs / 1000.0, warm_usecs / 1000.0,
+             warm_usecs ? (double)cold_usecs / warm_usecs : 0.0,
+             (unsigned)code_size);
+
+   if (fp) {
+      fprintf(fp, "%s\t%u\t%f\t%f\t%u\n",
+              success ? "pass" : "fail", num_stages,
+              cold_usecs / 1000.0, warm_usecs / 1000.0,
+              (unsigned)code_size);
+      fflush(fp);
+   }
+
+   align_free(in);
+   align_free(ref);
+   align_free(out);
+
+   return success;
+}
+
+
+/**
+ * The disk cache key includes a hash of the target machine, which must be
+ * stable or the cache would never hit.
+ */
+static boolean
+test_target_hash(unsigned verbose)
+{
+   unsigned char sha1[2][20];
+   unsigned i;
+
+   for (i = 0; i < 2; i++) {
+      struct mesa_sha1 ctx;
+
+      _mesa_sha1_init(&ctx);
+      lp_build_hash_target_machine(&ctx);
+      _mesa_sha1_final(&ctx, sha1[i]);
+   }
+
+   if (memcmp(sha1[0], sha1[1], sizeof sha1[0]) != 0) {
+      if (verbose)
+         fprintf(stderr, "target machine hash is not stable\n");
+      return FALSE;
+   }
+
+   return TRUE;
+}
+
+
+boolean
+test_all(unsigned verbose, FILE *fp)
+{
+   boolean success = test_target_hash(verbose);
+   unsigned i;
+
+   for (i = 0; i < ARRAY_SIZE(test_stages); i++) {
+      if (!test_cache(verbose, fp, test_stages[i], MAX_RUNS))
+         success = FALSE;
+   }
+
+   return success;
+}
+
+
+boolean
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   boolean success = test_target_hash(verbose);
+   unsigned i;
+
+   for (i = 0; i < ARRAY_SIZE(test_stages); i++) {
+      if (!test_cache(verbose, fp, test_stages[i], MIN2(n, MAX_RUNS)))
+         success = FALSE;
+   }
+
+   return success;
+}
+
+
+boolean
+test_single(unsigned verbose, FILE *fp)
+{
+   return test_cache(verbose, fp, 16, 1);
+}
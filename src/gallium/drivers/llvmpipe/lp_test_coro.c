@@ -0,0 +1,343 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The Mesa Authors.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Coroutine workgroup test and benchmark.
+ *
+ * Runs workgroups of invocations which exchange values through shared
+ * memory around a barrier, the way compute shaders with barriers run, and
+ * compares coroutine frames from a lp_build_coro_frame_pool against frames
+ * from the heap.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "util/os_time.h"
+#include "util/u_math.h"
+#include "gallivm/lp_bld.h"
+#include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_const.h"
+#include "gallivm/lp_bld_coro.h"
+#include "gallivm/lp_bld_flow.h"
+
+#include "lp_test.h"
+
+
+#define NUM_WORKGROUPS 2000
+#define MAX_INVOCATIONS 1024
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "invocations\t"
+           "heap_ns\t"
+           "pool_ns\n");
+
+   fflush(fp);
+}
+
+
+typedef void (*test_workgroup_t)(int32_t num_invocations, int32_t *shared,
+                                 int32_t *out, void *frame_pool);
+
+
+/**
+ * Build the invocation coroutine, which does
+ *
+ *    shared[inv] = inv;
+ *    barrier();
+ *    out[inv] = shared[(inv + 1) % n];
+ */
+static LLVMValueRef
+add_invocation(struct gallivm_state *gallivm)
+{
+   LLVMContextRef context = gallivm->context;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef int32_type = LLVMInt32TypeInContext(context);
+   LLVMTypeRef int32_ptr_type = LLVMPointerType(int32_type, 0);
+   LLVMTypeRef hdl_ptr_type = LLVMPointerType(LLVMInt8TypeInContext(context), 0);
+   LLVMTypeRef args[5] = { int32_type, int32_type, int32_ptr_type,
+                           int32_ptr_type, hdl_ptr_type };
+   LLVMValueRef func = LLVMAddFunction(gallivm->module, "invocation",
+                                       LLVMFunctionType(hdl_ptr_type, args, 5, 0));
+   LLVMValueRef inv = LLVMGetParam(func, 0);
+   LLVMValueRef n = LLVMGetParam(func, 1);
+   LLVMValueRef shared = LLVMGetParam(func, 2);
+   LLVMValueRef out = LLVMGetParam(func, 3);
+   LLVMValueRef frame_pool = LLVMGetParam(func, 4);
+   struct lp_build_coro_suspend_info coro_info;
+   LLVMBasicBlockRef resume;
+   LLVMValueRef coro_id, coro_hdl, next, val;
+
+   LLVMSetFunctionCallConv(func, LLVMCCallConv);
+   lp_build_coro_add_presplit(func);
+   LLVMPositionBuilderAtEnd(builder,
+                            LLVMAppendBasicBlockInContext(context, func, "entry"));
+
+   coro_id = lp_build_coro_id(gallivm);
+   coro_hdl = lp_build_coro_begin_alloc_mem(gallivm, coro_id, frame_pool);
+
+   coro_info.suspend = LLVMAppendBasicBlockInContext(context, func, "suspend");
+   coro_info.cleanup = LLVMAppendBasicBlockInContext(context, func, "cleanup");
+   resume = LLVMAppendBasicBlockInContext(context, func, "resume");
+
+   LLVMBuildStore(builder, inv, LLVMBuildGEP(builder, shared, &inv, 1, ""));
+   lp_build_coro_suspend_switch(gallivm, &coro_info, resume, false);
+
+   LLVMPositionBuilderAtEnd(builder, resume);
+   next = LLVMBuildAdd(builder, inv, lp_build_const_int32(gallivm, 1), "");
+   next = LLVMBuildURem(builder, next, n, "");
+   val = LLVMBuildLoad(builder, LLVMBuildGEP(builder, shared, &next, 1, ""), "");
+   LLVMBuildStore(builder, val, LLVMBuildGEP(builder, out, &inv, 1, ""));
+   lp_build_coro_suspend_switch(gallivm, &coro_info, NULL, true);
+
+   LLVMPositionBuilderAtEnd(builder, coro_info.cleanup);
+   lp_build_coro_free_mem(gallivm, coro_id, coro_hdl, frame_pool);
+   LLVMBuildBr(builder, coro_info.suspend);
+
+   LLVMPositionBuilderAtEnd(builder, coro_info.suspend);
+   lp_build_coro_end(gallivm, coro_hdl);
+   LLVMBuildRet(builder, coro_hdl);
+
+   gallivm_verify_function(gallivm, func);
+
+   return func;
+}
+
+
+/**
+ * Build the workgroup function, which starts all invocations, resumes
+ * them past the barrier and destroys them, like cs_variant does.
+ */
+static LLVMValueRef
+add_workgroup(struct gallivm_state *gallivm, LLVMValueRef invocation)
+{
+   LLVMContextRef context = gallivm->context;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef int32_type = LLVMInt32TypeInContext(context);
+   LLVMTypeRef int32_ptr_type = LLVMPointerType(int32_type, 0);
+   LLVMTypeRef hdl_ptr_type = LLVMPointerType(LLVMInt8TypeInContext(context), 0);
+   LLVMTypeRef args[4] = { int32_type, int32_ptr_type, int32_ptr_type,
+                           hdl_ptr_type };
+   LLVMValueRef func = LLVMAddFunction(gallivm->module, "workgroup",
+                                       LLVMFunctionType(LLVMVoidTypeInContext(context),
+                                                        args, 4, 0));
+   LLVMValueRef n = LLVMGetParam(func, 0);
+   struct lp_build_loop_state loop_state;
+   LLVMValueRef coro_hdls, coro_entry, coro_hdl;
+   LLVMValueRef call_args[5];
+
+   LLVMSetFunctionCallConv(func, LLVMCCallConv);
+   LLVMPositionBuilderAtEnd(builder,
+                            LLVMAppendBasicBlockInContext(context, func, "entry"));
+
+   coro_hdls = LLVMBuildArrayAlloca(builder, hdl_ptr_type, n, "coro_hdls");
+
+   /* run all invocations up to the barrier */
+   lp_build_loop_begin(&loop_state, gallivm, lp_build_const_int32(gallivm, 0));
+   call_args[0] = loop_state.counter;
+   call_args[1] = n;
+   call_args[2] = LLVMGetParam(func, 1);
+   call_args[3] = LLVMGetParam(func, 2);
+   call_args[4] = LLVMGetParam(func, 3);
+   coro_hdl = LLVMBuildCall(builder, invocation, call_args, 5, "");
+   coro_entry = LLVMBuildGEP(builder, coro_hdls, &loop_state.counter, 1, "");
+   LLVMBuildStore(builder, coro_hdl, coro_entry);
+   lp_build_loop_end_cond(&loop_state, n, NULL, LLVMIntUGE);
+
+   /* and past it */
+   lp_build_loop_begin(&loop_state, gallivm, lp_build_const_int32(gallivm, 0));
+   coro_entry = LLVMBuildGEP(builder, coro_hdls, &loop_state.counter, 1, "");
+   lp_build_coro_resume(gallivm, LLVMBuildLoad(builder, coro_entry, ""));
+   lp_build_loop_end_cond(&loop_state, n, NULL, LLVMIntUGE);
+
+   lp_build_loop_begin(&loop_state, gallivm, lp_build_const_int32(gallivm, 0));
+   coro_entry = LLVMBuildGEP(builder, coro_hdls, &loop_state.counter, 1, "");
+   lp_build_coro_destroy(gallivm, LLVMBuildLoad(builder, coro_entry, ""));
+   lp_build_loop_end_cond(&loop_state, n, NULL, LLVMIntUGE);
+
+   LLVMBuildRetVoid(builder);
+
+   gallivm_verify_function(gallivm, func);
+
+   return func;
+}
+
+
+static boolean
+check_workgroup(unsigned verbose, const char *name,
+                int32_t num_invocations, const int32_t *out)
+{
+   int32_t i;
+
+   for (i = 0; i < num_invocations; i++) {
+      if (out[i] != (i + 1) % num_invocations) {
+         if (verbose)
+            printf("%s: invocation %d of %d read %d, expected %d\n",
+                   name, i, num_invocations, out[i],
+                   (i + 1) % num_invocations);
+         return FALSE;
+      }
+   }
+
+   return TRUE;
+}
+
+
+static int64_t
+time_workgroups(test_workgroup_t workgroup, int32_t num_invocations,
+                int32_t *shared, int32_t *out,
+                struct lp_build_coro_frame_pool *frame_pool)
+{
+   int64_t start = os_time_get_nano();
+   unsigned i;
+
+   for (i = 0; i < NUM_WORKGROUPS; i++)
+      workgroup(num_invocations, shared, out, frame_pool);
+
+   return os_time_get_nano() - start;
+}
+
+
+static boolean
+test_invocations(unsigned verbose, FILE *fp, test_workgroup_t workgroup,
+                 int32_t num_invocations)
+{
+   struct lp_build_coro_frame_pool frame_pool;
+   int32_t shared[MAX_INVOCATIONS], out[MAX_INVOCATIONS];
+   int64_t heap_nsecs, pool_nsecs;
+   boolean success = TRUE;
+
+   memset(&frame_pool, 0, sizeof(frame_pool));
+
+   /* correctness, the first pooled run grows the pool through the heap */
+   memset(out, 0xff, sizeof(out));
+   workgroup(num_invocations, shared, out, NULL);
+   success = check_workgroup(verbose, "heap", num_invocations, out);
+
+   memset(out, 0xff, sizeof(out));
+   workgroup(num_invocations, shared, out, &frame_pool);
+   if (!check_workgroup(verbose, "pool growing", num_invocations, out))
+      success = FALSE;
+
+   memset(out, 0xff, sizeof(out));
+   workgroup(num_invocations, shared, out, &frame_pool);
+   if (!check_workgroup(verbose, "pool", num_invocations, out))
+      success = FALSE;
+
+   if (frame_pool.live != 0 || frame_pool.used != 0 || !frame_pool.mem)
+      success = FALSE;
+
+   /* speed */
+   heap_nsecs = time_workgroups(workgroup, num_invocations, shared, out, NULL);
+   pool_nsecs = time_workgroups(workgroup, num_invocations, shared, out,
+                                &frame_pool);
+
+   lp_build_coro_frame_pool_release(&frame_pool);
+
+   if (verbose || !success)
+      printf("%s: %4d invocations: %10.1f ns/workgroup heap, "
+             "%10.1f ns/workgroup pool (%.1fx)\n",
+             success ? "PASS" : "FAIL", num_invocations,
+             (double)heap_nsecs / NUM_WORKGROUPS,
+             (double)pool_nsecs / NUM_WORKGROUPS,
+             pool_nsecs ? (double)heap_nsecs / pool_nsecs : 0.0);
+
+   if (fp) {
+      fprintf(fp, "%s\t%d\t%f\t%f\n",
+              success ? "pass" : "fail", num_invocations,
+              (double)heap_nsecs / NUM_WORKGROUPS,
+              (double)pool_nsecs / NUM_WORKGROUPS);
+      fflush(fp);
+   }
+
+   return success;
+}
+
+
+PIPE_ALIGN_STACK
+static boolean
+test_coro(unsigned verbose, FILE *fp, unsigned max_invocations)
+{
+   LLVMContextRef context;
+   struct gallivm_state *gallivm;
+   LLVMValueRef invocation, test;
+   test_workgroup_t test_workgroup_func;
+   boolean success = TRUE;
+   unsigned n;
+
+   context = LLVMContextCreate();
+   gallivm = gallivm_create("test_module", context, NULL);
+
+   lp_build_coro_declare_malloc_hooks(gallivm);
+   invocation = add_invocation(gallivm);
+   test = add_workgroup(gallivm, invocation);
+
+   lp_build_coro_add_malloc_hooks(gallivm);
+   gallivm_compile_module(gallivm);
+
+   test_workgroup_func = (test_workgroup_t) gallivm_jit_function(gallivm, test);
+
+   gallivm_free_ir(gallivm);
+
+   for (n = 1; n <= max_invocations; n *= 4) {
+      if (!test_invocations(verbose, fp, test_workgroup_func, n))
+         success = FALSE;
+   }
+
+   gallivm_destroy(gallivm);
+   LLVMContextDispose(context);
+
+   return success;
+}
+
+
+boolean
+test_all(unsigned verbose, FILE *fp)
+{
+   return test_coro(verbose, fp, MAX_INVOCATIONS);
+}
+
+
+boolean
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_coro(verbose, fp, MAX2(MIN2(n, MAX_INVOCATIONS), 1));
+}
+
+
+boolean
+test_single(unsigned verbose, FILE *fp)
+{
+   return test_coro(verbose, fp, 64);
+}
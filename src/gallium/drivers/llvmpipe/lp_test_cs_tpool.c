@@ -0,0 +1,219 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The Mesa Authors.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Compute thread pool test and microbenchmark.
+ *
+ * Queues lots of tiny tasks, as launched by dispatches of a few small
+ * workgroups, checks that every iteration runs exactly once and reports
+ * the time per dispatch.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "util/os_time.h"
+#include "util/u_atomic.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_memory.h"
+
+#include "lp_cs_tpool.h"
+#include "lp_test.h"
+
+
+#define MAX_ITERS 1024
+
+
+struct cs_tpool_test_case {
+   unsigned num_threads;
+   unsigned num_iters;
+};
+
+
+struct cs_tpool_test_data {
+   unsigned count[MAX_ITERS];
+   unsigned bad_lmem;
+};
+
+
+static const unsigned test_iters[] = { 1, 2, 8, 64, 1024 };
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "threads\t"
+           "iterations\t"
+           "usecs_per_dispatch\n");
+
+   fflush(fp);
+}
+
+
+static void
+test_work(void *data, int iter_idx, struct lp_cs_local_mem *lmem)
+{
+   struct cs_tpool_test_data *test_data = data;
+
+   /* the local memory of a thread must survive across iterations */
+   if (!lmem->local_mem_ptr) {
+      lmem->local_size = sizeof(unsigned);
+      lmem->local_mem_ptr = CALLOC(1, lmem->local_size);
+   }
+   else if (lmem->local_size != sizeof(unsigned)) {
+      p_atomic_inc(&test_data->bad_lmem);
+   }
+
+   p_atomic_inc(&test_data->count[iter_idx]);
+}
+
+
+static boolean
+test_cs_tpool(unsigned verbose, FILE *fp,
+              const struct cs_tpool_test_case *test,
+              unsigned long num_dispatches)
+{
+   struct lp_cs_tpool *pool;
+   struct cs_tpool_test_data *data;
+   int64_t start, end;
+   double usecs;
+   boolean success = TRUE;
+   unsigned long n;
+   unsigned i;
+
+   pool = lp_cs_tpool_create(test->num_threads);
+   data = CALLOC_STRUCT(cs_tpool_test_data);
+   if (!pool || !data) {
+      lp_cs_tpool_destroy(pool);
+      FREE(data);
+      return FALSE;
+   }
+
+   start = os_time_get_nano();
+
+   for (n = 0; n < num_dispatches; n++) {
+      struct lp_cs_tpool_task *task;
+
+      task = lp_cs_tpool_queue_task(pool, test_work, data, test->num_iters);
+      lp_cs_tpool_wait_for_task(pool, &task);
+   }
+
+   end = os_time_get_nano();
+
+   lp_cs_tpool_destroy(pool);
+
+   for (i = 0; i < test->num_iters; i++) {
+      if (data->count[i] != num_dispatches) {
+         success = FALSE;
+         if (verbose)
+            fprintf(stderr, "iteration %u ran %u times, expected %lu\n",
+                    i, data->count[i], num_dispatches);
+      }
+   }
+   if (data->bad_lmem) {
+      success = FALSE;
+      if (verbose)
+         fprintf(stderr, "local memory was lost %u times\n", data->bad_lmem);
+   }
+
+   usecs = num_dispatches ? (end - start) / 1000.0 / num_dispatches : 0.0;
+
+   if (verbose || !success)
+      printf("%s: %2u threads, %4u iterations: %8.2f usecs per dispatch\n",
+             success ? "PASS" : "FAIL",
+             test->num_threads, test->num_iters, usecs);
+
+   if (fp) {
+      fprintf(fp, "%s\t%u\t%u\t%f\n",
+              success ? "pass" : "fail",
+              test->num_threads, test->num_iters, usecs);
+      fflush(fp);
+   }
+
+   FREE(data);
+
+   return success;
+}
+
+
+static boolean
+test_cs_tpool_all_iters(unsigned verbose, FILE *fp, unsigned num_threads,
+                        unsigned long num_dispatches)
+{
+   boolean success = TRUE;
+   unsigned i;
+
+   for (i = 0; i < ARRAY_SIZE(test_iters); i++) {
+      struct cs_tpool_test_case test;
+
+      test.num_threads = num_threads;
+      test.num_iters = test_iters[i];
+      if (!test_cs_tpool(verbose, fp, &test, num_dispatches))
+         success = FALSE;
+   }
+
+   return success;
+}
+
+
+boolean
+test_all(unsigned verbose, FILE *fp)
+{
+   unsigned num_threads = MAX2(1, util_cpu_caps.nr_cpus);
+   boolean success = TRUE;
+   unsigned threads;
+
+   for (threads = 0; threads <= num_threads; threads = threads ? threads * 2 : 1) {
+      if (!test_cs_tpool_all_iters(verbose, fp, threads, 10000))
+         success = FALSE;
+   }
+
+   return success;
+}
+
+
+boolean
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_cs_tpool_all_iters(verbose, fp,
+                                  MAX2(1, util_cpu_caps.nr_cpus), n);
+}
+
+
+boolean
+test_single(unsigned verbose, FILE *fp)
+{
+   struct cs_tpool_test_case test;
+
+   test.num_threads = MAX2(1, util_cpu_caps.nr_cpus);
+   test.num_iters = 8;
+
+   return test_cs_tpool(verbose, fp, &test, 1000);
+}
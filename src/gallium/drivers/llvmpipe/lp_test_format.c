@@ -176,6 +176,10 @@ test_format_float(unsigned verbose, FILE *fp,
          /* To ensure it's 16-byte aligned */
          memcpy(packed, test->packed, sizeof packed);
 
+         /* The cache only knows the block by its address */
+         if (use_cache)
+            memset(cache_ptr->cache_tags, 0, sizeof cache_ptr->cache_tags);
+
          for (i = 0; i < desc->block.height; ++i) {
             for (j = 0; j < desc->block.width; ++j) {
                boolean match = TRUE;
@@ -277,6 +281,10 @@ test_format_unorm8(unsigned verbose, FILE *fp,
          /* Could skip this and use unaligned lp_build_fetch_rgba_aos */
          memcpy(packed, test->packed, sizeof packed);
 
+         /* The cache only knows the block by its address */
+         if (use_cache)
+            memset(cache_ptr->cache_tags, 0, sizeof cache_ptr->cache_tags);
+
          for (i = 0; i < desc->block.height; ++i) {
             for (j = 0; j < desc->block.width; ++j) {
                boolean match;
@@ -336,6 +344,194 @@ test_format_unorm8(unsigned verbose, FILE *fp,
 
 
 
+/**
+ * Fetch all texels of many random blocks through the block cache, enough
+ * to evict most of them, and compare them with the uncached fetch.
+ */
+PIPE_ALIGN_STACK
+static boolean
+test_format_cache(unsigned verbose, FILE *fp,
+                  const struct util_format_description *desc)
+{
+   const unsigned num_blocks = 4 * LP_BUILD_FORMAT_CACHE_SIZE;
+   const unsigned block_size = desc->block.bits / 8;
+   /* S3TC interpolates with other rounding when decoding whole blocks */
+   const int tolerance = desc->layout == UTIL_FORMAT_LAYOUT_S3TC ? 1 : 0;
+   LLVMContextRef context;
+   struct gallivm_state *gallivm[2];
+   fetch_ptr_t fetch_ptr[2];
+   uint8_t *packed;
+   boolean success = TRUE;
+   unsigned pass, b, i, j, k;
+
+   printf("Testing %s (cache) ...\n", desc->name);
+   fflush(stdout);
+
+   context = LLVMContextCreate();
+   for (k = 0; k < 2; k++) {
+      LLVMValueRef fetch;
+
+      gallivm[k] = gallivm_create("test_module_cache", context, NULL);
+      fetch = add_fetch_rgba_test(gallivm[k], verbose, desc,
+                                  lp_unorm8_vec4_type(), k);
+      gallivm_compile_module(gallivm[k]);
+      fetch_ptr[k] = (fetch_ptr_t) gallivm_jit_function(gallivm[k], fetch);
+      gallivm_free_ir(gallivm[k]);
+   }
+
+   packed = align_malloc(num_blocks * block_size, 16);
+   for (b = 0; b < num_blocks * block_size; b++) {
+      packed[b] = rand();
+   }
+
+   memset(cache_ptr, 0, sizeof *cache_ptr);
+
+   /* first forward, then backward after the blocks got evicted */
+   for (pass = 0; pass < 2 && success; pass++) {
+      for (b = 0; b < num_blocks && success; b++) {
+         const uint8_t *block =
+            packed + (pass ? num_blocks - 1 - b : b) * block_size;
+
+         for (i = 0; i < desc->block.height; ++i) {
+            for (j = 0; j < desc->block.width; ++j) {
+               uint8_t expected[4], unpacked[4];
+               boolean match = TRUE;
+
+               fetch_ptr[0](expected, block, j, i, NULL);
+               fetch_ptr[1](unpacked, block, j, i, cache_ptr);
+
+               for (k = 0; k < 4; ++k) {
+                  if (abs(expected[k] - unpacked[k]) > tolerance)
+                     match = FALSE;
+               }
+
+               if (!match) {
+                  printf("FAILED\n");
+                  printf("  Block %u (%u,%u): %02x %02x %02x %02x obtained\n"
+                         "                  %02x %02x %02x %02x expected\n",
+                         b, j, i,
+                         unpacked[0], unpacked[1], unpacked[2], unpacked[3],
+                         expected[0], expected[1], expected[2], expected[3]);
+                  success = FALSE;
+               }
+            }
+         }
+      }
+
+      /* every block misses once, when its first texel is fetched */
+      if (pass == 0 && success &&
+          (cache_ptr->cache_access_total != num_blocks * 16 ||
+           cache_ptr->cache_access_miss != num_blocks)) {
+         printf("FAILED\n");
+         printf("  %llu accesses %llu misses, expected %u %u\n",
+                (unsigned long long)cache_ptr->cache_access_total,
+                (unsigned long long)cache_ptr->cache_access_miss,
+                num_blocks * 16, num_blocks);
+         success = FALSE;
+      }
+   }
+
+   align_free(packed);
+   for (k = 0; k < 2; k++) {
+      gallivm_destroy(gallivm[k]);
+   }
+   LLVMContextDispose(context);
+
+   if(fp)
+      write_tsv_row(fp, desc, success);
+
+   return success;
+}
+
+
+/**
+ * Fetch the texels of the same blocks through the block cache as two
+ * formats in turn, which must not get each other's decoded texels.
+ */
+PIPE_ALIGN_STACK
+static boolean
+test_format_cache_views(unsigned verbose, FILE *fp,
+                        enum pipe_format format0, enum pipe_format format1)
+{
+   const unsigned num_blocks = 16;
+   const struct util_format_description *desc[2];
+   LLVMContextRef context;
+   struct gallivm_state *gallivm[2][2];
+   fetch_ptr_t fetch_ptr[2][2];
+   uint8_t *packed;
+   boolean success = TRUE;
+   unsigned f, b, i, j, k;
+
+   desc[0] = util_format_description(format0);
+   desc[1] = util_format_description(format1);
+   assert(desc[0]->block.bits == desc[1]->block.bits);
+
+   printf("Testing %s and %s (cache) ...\n", desc[0]->name, desc[1]->name);
+   fflush(stdout);
+
+   context = LLVMContextCreate();
+   for (f = 0; f < 2; f++) {
+      for (k = 0; k < 2; k++) {
+         LLVMValueRef fetch;
+
+         gallivm[f][k] = gallivm_create("test_module_cache_views", context,
+                                        NULL);
+         fetch = add_fetch_rgba_test(gallivm[f][k], verbose, desc[f],
+                                     lp_unorm8_vec4_type(), k);
+         gallivm_compile_module(gallivm[f][k]);
+         fetch_ptr[f][k] =
+            (fetch_ptr_t) gallivm_jit_function(gallivm[f][k], fetch);
+         gallivm_free_ir(gallivm[f][k]);
+      }
+   }
+
+   packed = align_malloc(num_blocks * desc[0]->block.bits / 8, 16);
+   for (b = 0; b < num_blocks * desc[0]->block.bits / 8; b++) {
+      packed[b] = rand();
+   }
+
+   memset(cache_ptr, 0, sizeof *cache_ptr);
+
+   for (b = 0; b < num_blocks && success; b++) {
+      const uint8_t *block = packed + b * desc[0]->block.bits / 8;
+
+      for (i = 0; i < 4; ++i) {
+         for (j = 0; j < 4; ++j) {
+            for (f = 0; f < 2; f++) {
+               uint8_t expected[4], unpacked[4];
+
+               fetch_ptr[f][0](expected, block, j, i, NULL);
+               fetch_ptr[f][1](unpacked, block, j, i, cache_ptr);
+
+               if (memcmp(expected, unpacked, sizeof expected) != 0) {
+                  printf("FAILED\n");
+                  printf("  Block %u (%u,%u) as %s: %02x %02x %02x %02x obtained\n"
+                         "                  %02x %02x %02x %02x expected\n",
+                         b, j, i, desc[f]->short_name,
+                         unpacked[0], unpacked[1], unpacked[2], unpacked[3],
+                         expected[0], expected[1], expected[2], expected[3]);
+                  success = FALSE;
+               }
+            }
+         }
+      }
+   }
+
+   align_free(packed);
+   for (f = 0; f < 2; f++) {
+      for (k = 0; k < 2; k++) {
+         gallivm_destroy(gallivm[f][k]);
+      }
+   }
+   LLVMContextDispose(context);
+
+   if(fp)
+      write_tsv_row(fp, desc[0], success);
+
+   return success;
+}
+
+
 static boolean
 test_one(unsigned verbose, FILE *fp,
          const struct util_format_description *format_desc,
@@ -351,6 +547,11 @@ test_one(unsigned verbose, FILE *fp,
      success = FALSE;
    }
 
+   if (use_cache &&
+       !test_format_cache(verbose, fp, format_desc)) {
+     success = FALSE;
+   }
+
    return success;
 }
 
@@ -362,7 +563,7 @@ test_all(unsigned verbose, FILE *fp)
    boolean success = TRUE;
    unsigned use_cache;
 
-   cache_ptr = align_malloc(sizeof(struct lp_build_format_cache), 16);
+   cache_ptr = align_calloc(sizeof(struct lp_build_format_cache), 16);
 
    for (use_cache = 0; use_cache < 2; use_cache++) {
       for (format = 1; format < PIPE_FORMAT_COUNT; ++format) {
@@ -398,7 +599,7 @@ test_all(unsigned verbose, FILE *fp)
          }
 
          /* only test twice with formats which can use cache */
-         if (format_desc->layout != UTIL_FORMAT_LAYOUT_S3TC && use_cache) {
+         if (!lp_build_format_cache_supported(format_desc) && use_cache) {
             continue;
          }
 
@@ -407,6 +608,16 @@ test_all(unsigned verbose, FILE *fp)
          }
       }
    }
+
+   if (!test_format_cache_views(verbose, fp, PIPE_FORMAT_RGTC1_UNORM,
+                                PIPE_FORMAT_RGTC1_SNORM)) {
+      success = FALSE;
+   }
+   if (!test_format_cache_views(verbose, fp, PIPE_FORMAT_RGTC2_UNORM,
+                                PIPE_FORMAT_RGTC2_SNORM)) {
+      success = FALSE;
+   }
+
    align_free(cache_ptr);
 
    return success;
@@ -0,0 +1,815 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The Mesa Authors.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Texture sampling test and benchmark for linear vs. tiled textures.
+ *
+ * Checks that sampling a tiled texture (LP_BUILD_SAMPLE_TILE_SIZE) returns
+ * exactly what sampling the same texture stored linearly does, through both
+ * the AoS and SoA sampling code.  Then samples a large texture the way a
+ * rotated or minified quad would, and reports the time per fragment and
+ * the number of distinct cache lines the bilinear footprints of each 2x2
+ * quad touch, for both layouts.
+ *
+ * Also checks that sampling functions shared between modules through an
+ * lp_sample_func_cache return what functions of the module itself do.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+
+#include "util/os_time.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "util/format/u_format.h"
+
+#include "gallivm/lp_bld_const.h"
+#include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_sample.h"
+#include "gallivm/lp_bld_type.h"
+
+#include "lp_test.h"
+
+
+#define CACHE_LINE_SIZE 64
+
+
+/**
+ * Texture description passed to the generated code, which is what the
+ * sampler dynamic state below loads from.
+ */
+struct sample_test_texture
+{
+   uint32_t width;
+   uint32_t height;
+   uint32_t depth;
+   uint32_t first_level;
+   uint32_t last_level;
+   uint32_t row_stride[PIPE_MAX_TEXTURE_LEVELS];
+   uint32_t img_stride[PIPE_MAX_TEXTURE_LEVELS];
+   uint32_t mip_offsets[PIPE_MAX_TEXTURE_LEVELS];
+   const void *base;
+   uint32_t num_samples;
+   uint32_t sample_stride;
+   float min_lod;
+   float max_lod;
+   float lod_bias;
+   float border_color[4];
+};
+
+
+typedef void
+(*sample_func_t)(const struct sample_test_texture *texture,
+                 float *rgba, const float *s, const float *t);
+
+
+struct sample_test_pattern
+{
+   const char *name;
+   float angle;   /**< rotation of the texture coords, in degrees */
+   float scale;   /**< texels per fragment */
+};
+
+
+static const struct sample_test_pattern test_patterns[] = {
+   { "magnify",       0.0f, 0.5f },
+   { "copy",          0.0f, 1.0f },
+   { "rotate 30",    30.0f, 1.0f },
+   { "rotate 90",    90.0f, 1.0f },
+   { "minify 2x",     0.0f, 2.0f },
+   { "rotate 30 2x", 30.0f, 2.0f },
+   { "rotate 90 2x", 90.0f, 2.0f },
+};
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "pattern\t"
+           "linear_nsecs\t"
+           "tiled_nsecs\t"
+           "linear_lines\t"
+           "tiled_lines\n");
+
+   fflush(fp);
+}
+
+
+/*
+ * Sampler dynamic state, loading everything from a sample_test_texture.
+ */
+
+static LLVMValueRef
+sample_test_member(struct gallivm_state *gallivm,
+                   LLVMValueRef context_ptr,
+                   unsigned offset,
+                   LLVMTypeRef type,
+                   boolean emit_load)
+{
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMValueRef index = lp_build_const_int32(gallivm, offset);
+   LLVMValueRef ptr;
+
+   ptr = LLVMBuildGEP(builder, context_ptr, &index, 1, "");
+   ptr = LLVMBuildBitCast(builder, ptr, LLVMPointerType(type, 0), "");
+
+   return emit_load ? LLVMBuildLoad(builder, ptr, "") : ptr;
+}
+
+
+#define SAMPLE_TEST_MEMBER(_name, _type, _emit_load) \
+   static LLVMValueRef \
+   sample_test_##_name(const struct lp_sampler_dynamic_state *state, \
+                       struct gallivm_state *gallivm, \
+                       LLVMValueRef context_ptr, \
+                       unsigned unit) \
+   { \
+      return sample_test_member(gallivm, context_ptr, \
+                                offsetof(struct sample_test_texture, _name), \
+                                _type, _emit_load); \
+   }
+
+#define I32 LLVMInt32TypeInContext(gallivm->context)
+#define F32 LLVMFloatTypeInContext(gallivm->context)
+#define LEVEL_ARRAY LLVMArrayType(I32, PIPE_MAX_TEXTURE_LEVELS)
+
+SAMPLE_TEST_MEMBER(width, I32, TRUE)
+SAMPLE_TEST_MEMBER(height, I32, TRUE)
+SAMPLE_TEST_MEMBER(depth, I32, TRUE)
+SAMPLE_TEST_MEMBER(first_level, I32, TRUE)
+SAMPLE_TEST_MEMBER(last_level, I32, TRUE)
+SAMPLE_TEST_MEMBER(row_stride, LEVEL_ARRAY, FALSE)
+SAMPLE_TEST_MEMBER(img_stride, LEVEL_ARRAY, FALSE)
+SAMPLE_TEST_MEMBER(mip_offsets, LEVEL_ARRAY, FALSE)
+SAMPLE_TEST_MEMBER(base, LLVMPointerType(LLVMInt8TypeInContext(gallivm->context), 0), TRUE)
+SAMPLE_TEST_MEMBER(num_samples, I32, TRUE)
+SAMPLE_TEST_MEMBER(sample_stride, I32, TRUE)
+SAMPLE_TEST_MEMBER(min_lod, F32, TRUE)
+SAMPLE_TEST_MEMBER(max_lod, F32, TRUE)
+SAMPLE_TEST_MEMBER(lod_bias, F32, TRUE)
+SAMPLE_TEST_MEMBER(border_color, LLVMArrayType(F32, 4), FALSE)
+
+#undef I32
+#undef F32
+#undef LEVEL_ARRAY
+
+
+static void
+sample_test_dynamic_state(struct lp_sampler_dynamic_state *state)
+{
+   memset(state, 0, sizeof *state);
+
+   state->width = sample_test_width;
+   state->height = sample_test_height;
+   state->depth = sample_test_depth;
+   state->first_level = sample_test_first_level;
+   state->last_level = sample_test_last_level;
+   state->row_stride = sample_test_row_stride;
+   state->img_stride = sample_test_img_stride;
+   state->base_ptr = sample_test_base;
+   state->mip_offsets = sample_test_mip_offsets;
+   state->num_samples = sample_test_num_samples;
+   state->sample_stride = sample_test_sample_stride;
+   state->min_lod = sample_test_min_lod;
+   state->max_lod = sample_test_max_lod;
+   state->lod_bias = sample_test_lod_bias;
+   state->border_color = sample_test_border_color;
+}
+
+
+/**
+ * Types of the arguments of shared sampling functions, which see the
+ * texture as bytes like the code generated below.
+ */
+static void
+sample_test_func_types(struct gallivm_state *gallivm,
+                       LLVMTypeRef *context_ptr_type,
+                       LLVMTypeRef *thread_data_ptr_type)
+{
+   *context_ptr_type =
+      LLVMPointerType(LLVMInt8TypeInContext(gallivm->context), 0);
+   *thread_data_ptr_type = *context_ptr_type;
+}
+
+
+/**
+ * Build a function sampling one SIMD vector of 2D texture coords.
+ */
+static LLVMValueRef
+add_sample_test(struct gallivm_state *gallivm,
+                struct lp_type type,
+                const struct lp_static_texture_state *texture_state,
+                const struct lp_static_sampler_state *sampler_state,
+                struct lp_sample_func_cache *func_cache)
+{
+   LLVMContextRef context = gallivm->context;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef vec_type = lp_build_vec_type(gallivm, type);
+   LLVMTypeRef vec_ptr_type = LLVMPointerType(vec_type, 0);
+   LLVMTypeRef args[4];
+   LLVMValueRef func, rgba_ptr;
+   LLVMValueRef coords[5], texel[4];
+   LLVMValueRef offsets[3] = { NULL, NULL, NULL };
+   LLVMBasicBlockRef block;
+   struct lp_sampler_dynamic_state dynamic_state;
+   struct lp_sampler_params params;
+   unsigned i;
+
+   args[0] = LLVMPointerType(LLVMInt8TypeInContext(context), 0);
+   args[1] = vec_ptr_type;
+   args[2] = vec_ptr_type;
+   args[3] = vec_ptr_type;
+
+   func = LLVMAddFunction(gallivm->module, "sample",
+                          LLVMFunctionType(LLVMVoidTypeInContext(context),
+                                           args, ARRAY_SIZE(args), 0));
+   LLVMSetFunctionCallConv(func, LLVMCCallConv);
+
+   block = LLVMAppendBasicBlockInContext(context, func, "entry");
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   coords[0] = LLVMBuildLoad(builder, LLVMGetParam(func, 2), "s");
+   coords[1] = LLVMBuildLoad(builder, LLVMGetParam(func, 3), "t");
+   for (i = 2; i < ARRAY_SIZE(coords); i++)
+      coords[i] = lp_build_undef(gallivm, type);
+
+   sample_test_dynamic_state(&dynamic_state);
+   dynamic_state.func_cache = func_cache;
+
+   memset(&params, 0, sizeof params);
+   params.type = type;
+   params.sample_key = LP_SAMPLER_LOD_SCALAR << LP_SAMPLER_LOD_PROPERTY_SHIFT;
+   params.context_ptr = LLVMGetParam(func, 0);
+   params.coords = coords;
+   params.offsets = offsets;
+   params.texel = texel;
+
+   lp_build_sample_soa(texture_state, sampler_state, &dynamic_state,
+                       gallivm, &params);
+
+   rgba_ptr = LLVMGetParam(func, 1);
+   for (i = 0; i < 4; i++) {
+      LLVMValueRef index = lp_build_const_int32(gallivm, i);
+      LLVMBuildStore(builder, texel[i],
+                     LLVMBuildGEP(builder, rgba_ptr, &index, 1, ""));
+   }
+
+   LLVMBuildRetVoid(builder);
+
+   gallivm_verify_function(gallivm, func);
+
+   return func;
+}
+
+
+/**
+ * Byte offset of a texel in a tiled texture, see LP_BUILD_SAMPLE_TILE_SIZE.
+ */
+static unsigned
+tiled_offset(unsigned x, unsigned y, unsigned row_stride, unsigned texel_size)
+{
+   const unsigned mask = LP_BUILD_SAMPLE_TILE_SIZE - 1;
+
+   return (y & ~mask) * row_stride +
+          (y & mask) * LP_BUILD_SAMPLE_TILE_SIZE * texel_size +
+          (x & ~mask) * LP_BUILD_SAMPLE_TILE_SIZE * texel_size +
+          (x & mask) * texel_size;
+}
+
+
+static unsigned
+texel_offset(const struct sample_test_texture *texture, boolean tiled,
+             unsigned x, unsigned y, unsigned texel_size)
+{
+   if (tiled)
+      return tiled_offset(x, y, texture->row_stride[0], texel_size);
+   return y * texture->row_stride[0] + x * texel_size;
+}
+
+
+/**
+ * Create a texture with random contents, in both layouts.
+ */
+static boolean
+create_textures(enum pipe_format format, unsigned width, unsigned height,
+                struct sample_test_texture textures[2])
+{
+   const unsigned texel_size = util_format_get_blocksize(format);
+   const unsigned row_stride = align(width, LP_BUILD_SAMPLE_TILE_SIZE) * texel_size;
+   const unsigned size = row_stride * align(height, LP_BUILD_SAMPLE_TILE_SIZE);
+   uint8_t *data[2];
+   unsigned i, x, y;
+
+   data[0] = align_malloc(size, 64);
+   data[1] = align_malloc(size, 64);
+   if (!data[0] || !data[1]) {
+      align_free(data[0]);
+      align_free(data[1]);
+      return FALSE;
+   }
+
+   for (i = 0; i < 2; i++) {
+      memset(&textures[i], 0, sizeof textures[i]);
+      textures[i].width = width;
+      textures[i].height = height;
+      textures[i].depth = 1;
+      textures[i].row_stride[0] = row_stride;
+      textures[i].img_stride[0] = size;
+      textures[i].base = data[i];
+      textures[i].num_samples = 1;
+      textures[i].max_lod = 0.0f;
+   }
+
+   for (y = 0; y < height; y++) {
+      for (x = 0; x < width; x++) {
+         uint8_t texel[16];
+         float rgba[4];
+
+         for (i = 0; i < 4; i++)
+            rgba[i] = (float)rand() / RAND_MAX;
+         util_format_pack_rgba(format, texel, rgba, 1);
+
+         memcpy(data[0] + texel_offset(&textures[0], FALSE, x, y, texel_size),
+                texel, texel_size);
+         memcpy(data[1] + texel_offset(&textures[1], TRUE, x, y, texel_size),
+                texel, texel_size);
+      }
+   }
+
+   return TRUE;
+}
+
+
+static void
+destroy_textures(struct sample_test_texture textures[2])
+{
+   align_free((void *)textures[0].base);
+   align_free((void *)textures[1].base);
+}
+
+
+/**
+ * Compile the sample function for one layout.
+ */
+static sample_func_t
+compile_sample_test(struct gallivm_state **gallivm, LLVMContextRef context,
+                    struct lp_type type, enum pipe_format format,
+                    unsigned width, unsigned height,
+                    unsigned filter, unsigned wrap, boolean tiled,
+                    struct lp_sample_func_cache *func_cache)
+{
+   struct lp_static_texture_state texture_state;
+   struct lp_static_sampler_state sampler_state;
+   LLVMValueRef func;
+   sample_func_t sample;
+
+   memset(&texture_state, 0, sizeof texture_state);
+   texture_state.format = format;
+   texture_state.swizzle_r = PIPE_SWIZZLE_X;
+   texture_state.swizzle_g = PIPE_SWIZZLE_Y;
+   texture_state.swizzle_b = PIPE_SWIZZLE_Z;
+   texture_state.swizzle_a = PIPE_SWIZZLE_W;
+   texture_state.target = PIPE_TEXTURE_2D;
+   texture_state.pot_width = util_is_power_of_two_or_zero(width);
+   texture_state.pot_height = util_is_power_of_two_or_zero(height);
+   texture_state.pot_depth = 1;
+   texture_state.level_zero_only = 1;
+   texture_state.tiled = tiled;
+
+   memset(&sampler_state, 0, sizeof sampler_state);
+   sampler_state.wrap_s = wrap;
+   sampler_state.wrap_t = wrap;
+   sampler_state.wrap_r = wrap;
+   sampler_state.min_img_filter = filter;
+   sampler_state.mag_img_filter = filter;
+   sampler_state.min_mip_filter = PIPE_TEX_MIPFILTER_NONE;
+   sampler_state.normalized_coords = 1;
+   sampler_state.min_max_lod_equal = 1;
+
+   *gallivm = gallivm_create(tiled ? "sample_tiled" : "sample_linear",
+                             context, NULL);
+
+   func = add_sample_test(*gallivm, type, &texture_state, &sampler_state,
+                          func_cache);
+
+   gallivm_compile_module(*gallivm);
+
+   sample = (sample_func_t) gallivm_jit_function(*gallivm, func);
+
+   gallivm_free_ir(*gallivm);
+
+   return sample;
+}
+
+
+static void
+sample_all(sample_func_t sample, const struct sample_test_texture *texture,
+           struct lp_type type, float *rgba,
+           const float *s, const float *t, unsigned num_coords)
+{
+   unsigned i;
+
+   for (i = 0; i < num_coords; i += type.length)
+      sample(texture, rgba + 4 * i, s + i, t + i);
+}
+
+
+/**
+ * Check that sampling the tiled texture gives exactly the same results as
+ * sampling the linear one.
+ */
+PIPE_ALIGN_STACK
+static boolean
+test_layouts_match(unsigned verbose, enum pipe_format format,
+                   unsigned width, unsigned height,
+                   unsigned filter, unsigned wrap)
+{
+   const unsigned num_coords = 1024;
+   struct lp_type type = lp_type_float_vec(32, lp_native_vector_width);
+   struct sample_test_texture textures[2];
+   LLVMContextRef context[2];
+   struct gallivm_state *gallivm[2];
+   sample_func_t sample[2];
+   float *s, *t, *rgba[2];
+   boolean success = TRUE;
+   unsigned i;
+
+   if (!create_textures(format, width, height, textures))
+      return FALSE;
+
+   s = align_malloc(num_coords * sizeof *s, 64);
+   t = align_malloc(num_coords * sizeof *t, 64);
+   rgba[0] = align_malloc(4 * num_coords * sizeof *rgba[0], 64);
+   rgba[1] = align_malloc(4 * num_coords * sizeof *rgba[1], 64);
+
+   /* coords outside [0, 1] exercise the wrap modes */
+   for (i = 0; i < num_coords; i++) {
+      s[i] = 2.0f * rand() / RAND_MAX - 0.5f;
+      t[i] = 2.0f * rand() / RAND_MAX - 0.5f;
+   }
+
+   for (i = 0; i < 2; i++) {
+      context[i] = LLVMContextCreate();
+      sample[i] = compile_sample_test(&gallivm[i], context[i], type, format,
+                                      width, height, filter, wrap, i, NULL);
+      sample_all(sample[i], &textures[i], type, rgba[i], s, t, num_coords);
+   }
+
+   if (memcmp(rgba[0], rgba[1], 4 * num_coords * sizeof *rgba[0]) != 0)
+      success = FALSE;
+
+   if (verbose || !success)
+      printf("%s: %s %ux%u %s %s\n",
+             success ? "PASS" : "FAIL",
+             util_format_short_name(format), width, height,
+             filter == PIPE_TEX_FILTER_LINEAR ? "linear" : "nearest",
+             wrap == PIPE_TEX_WRAP_REPEAT ? "repeat" : "clamp_to_edge");
+
+   for (i = 0; i < 2; i++) {
+      gallivm_destroy(gallivm[i]);
+      LLVMContextDispose(context[i]);
+   }
+
+   align_free(s);
+   align_free(t);
+   align_free(rgba[0]);
+   align_free(rgba[1]);
+   destroy_textures(textures);
+
+   return success;
+}
+
+
+/**
+ * Check that sampling through a shared function gives exactly the same
+ * results as through a function of the module, both from the module which
+ * compiles the shared function and from one finding it in the cache.
+ */
+PIPE_ALIGN_STACK
+static boolean
+test_shared_funcs_match(unsigned verbose, unsigned filter, unsigned wrap)
+{
+   /* Not an rgba8 format, so that the sampling is not inlined */
+   const enum pipe_format format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+   const unsigned width = 64, height = 32;
+   const unsigned num_coords = 1024;
+   struct lp_type type = lp_type_float_vec(32, lp_native_vector_width);
+   struct sample_test_texture textures[2];
+   struct lp_sample_func_cache *func_cache;
+   LLVMContextRef context[3];
+   struct gallivm_state *gallivm[3];
+   sample_func_t sample;
+   float *s, *t, *rgba[3];
+   boolean success = TRUE;
+   unsigned i;
+
+   func_cache = lp_sample_func_cache_create(sample_test_func_types);
+   if (!func_cache)
+      return FALSE;
+
+   if (!create_textures(format, width, height, textures)) {
+      lp_sample_func_cache_destroy(func_cache);
+      return FALSE;
+   }
+
+   s = align_malloc(num_coords * sizeof *s, 64);
+   t = align_malloc(num_coords * sizeof *t, 64);
+   for (i = 0; i < num_coords; i++) {
+      s[i] = 2.0f * rand() / RAND_MAX - 0.5f;
+      t[i] = 2.0f * rand() / RAND_MAX - 0.5f;
+   }
+
+   for (i = 0; i < 3; i++) {
+      rgba[i] = align_malloc(4 * num_coords * sizeof *rgba[i], 64);
+      context[i] = LLVMContextCreate();
+      sample = compile_sample_test(&gallivm[i], context[i], type, format,
+                                   width, height, filter, wrap, FALSE,
+                                   i ? func_cache : NULL);
+      sample_all(sample, &textures[0], type, rgba[i], s, t, num_coords);
+   }
+
+   for (i = 1; i < 3; i++) {
+      if (memcmp(rgba[0], rgba[i], 4 * num_coords * sizeof *rgba[0]) != 0)
+         success = FALSE;
+   }
+
+   if (verbose || !success)
+      printf("%s: shared function %s %s\n",
+             success ? "PASS" : "FAIL",
+             filter == PIPE_TEX_FILTER_LINEAR ? "linear" : "nearest",
+             wrap == PIPE_TEX_WRAP_REPEAT ? "repeat" : "clamp_to_edge");
+
+   /* The shared code must outlive the modules calling it */
+   for (i = 0; i < 3; i++) {
+      gallivm_destroy(gallivm[i]);
+      LLVMContextDispose(context[i]);
+      align_free(rgba[i]);
+   }
+   lp_sample_func_cache_destroy(func_cache);
+
+   align_free(s);
+   align_free(t);
+   destroy_textures(textures);
+
+   return success;
+}
+
+
+/**
+ * Generate the texture coords of a screen of fragments, in 2x2 quads, each
+ * quad filling a SIMD vector of four (or more quads filling a wider one).
+ */
+static void
+generate_coords(const struct sample_test_pattern *pattern,
+                unsigned screen_size, unsigned tex_size,
+                float *s, float *t)
+{
+   const float angle = pattern->angle * (float)M_PI / 180.0f;
+   const float c = cosf(angle) * pattern->scale / tex_size;
+   const float sn = sinf(angle) * pattern->scale / tex_size;
+   unsigned qx, qy, i, n = 0;
+
+   for (qy = 0; qy < screen_size; qy += 2) {
+      for (qx = 0; qx < screen_size; qx += 2) {
+         for (i = 0; i < 4; i++) {
+            float x = qx + (i & 1) + 0.5f;
+            float y = qy + (i >> 1) + 0.5f;
+
+            s[n] = c * x - sn * y;
+            t[n] = sn * x + c * y;
+            n++;
+         }
+      }
+   }
+}
+
+
+static int
+compare_unsigned(const void *a, const void *b)
+{
+   unsigned x = *(const unsigned *)a, y = *(const unsigned *)b;
+
+   return x < y ? -1 : x > y;
+}
+
+
+/**
+ * Average number of distinct cache lines the bilinear footprints of the
+ * fragments of a quad touch, with repeat wrapping.
+ */
+static double
+count_cache_lines(const struct sample_test_texture *texture, boolean tiled,
+                  unsigned texel_size, const float *s, const float *t,
+                  unsigned num_coords)
+{
+   const unsigned size = texture->width;
+   unsigned total = 0;
+   unsigned q, i, j;
+
+   for (q = 0; q < num_coords; q += 4) {
+      unsigned lines[16];
+      unsigned num_lines = 0;
+
+      for (i = 0; i < 4; i++) {
+         int x0 = (int)floorf(s[q + i] * size - 0.5f);
+         int y0 = (int)floorf(t[q + i] * size - 0.5f);
+
+         for (j = 0; j < 4; j++) {
+            unsigned x = (x0 + (j & 1)) & (size - 1);
+            unsigned y = (y0 + (j >> 1)) & (size - 1);
+
+            lines[num_lines++] = texel_offset(texture, tiled, x, y,
+                                              texel_size) / CACHE_LINE_SIZE;
+         }
+      }
+
+      qsort(lines, num_lines, sizeof lines[0], compare_unsigned);
+      for (i = 0; i < num_lines; i++) {
+         if (i == 0 || lines[i] != lines[i - 1])
+            total++;
+      }
+   }
+
+   return (double)total / (num_coords / 4);
+}
+
+
+PIPE_ALIGN_STACK
+static boolean
+benchmark_pattern(unsigned verbose, FILE *fp,
+                  const struct sample_test_pattern *pattern,
+                  unsigned num_runs)
+{
+   const enum pipe_format format = PIPE_FORMAT_R8G8B8A8_UNORM;
+   const unsigned texel_size = 4;
+   const unsigned tex_size = 2048;
+   const unsigned screen_size = 512;
+   const unsigned num_coords = screen_size * screen_size;
+   struct lp_type type = lp_type_float_vec(32, lp_native_vector_width);
+   struct sample_test_texture textures[2];
+   double nsecs[2], lines[2];
+   float *s, *t, *rgba;
+   unsigned i, run;
+
+   if (!create_textures(format, tex_size, tex_size, textures))
+      return FALSE;
+
+   s = align_malloc(num_coords * sizeof *s, 64);
+   t = align_malloc(num_coords * sizeof *t, 64);
+   rgba = align_malloc(4 * num_coords * sizeof *rgba, 64);
+
+   generate_coords(pattern, screen_size, tex_size, s, t);
+
+   for (i = 0; i < 2; i++) {
+      LLVMContextRef context = LLVMContextCreate();
+      struct gallivm_state *gallivm;
+      sample_func_t sample;
+      int64_t start, end;
+
+      sample = compile_sample_test(&gallivm, context, type, format,
+                                   tex_size, tex_size,
+                                   PIPE_TEX_FILTER_LINEAR,
+                                   PIPE_TEX_WRAP_REPEAT, i, NULL);
+
+      /* warm up */
+      sample_all(sample, &textures[i], type, rgba, s, t, num_coords);
+
+      start = os_time_get_nano();
+      for (run = 0; run < num_runs; run++)
+         sample_all(sample, &textures[i], type, rgba, s, t, num_coords);
+      end = os_time_get_nano();
+
+      nsecs[i] = (double)(end - start) / ((double)num_runs * num_coords);
+      lines[i] = count_cache_lines(&textures[i], i, texel_size,
+                                   s, t, num_coords);
+
+      gallivm_destroy(gallivm);
+      LLVMContextDispose(context);
+   }
+
+   if (verbose)
+      printf("%-14s linear %6.2f ns/fragment %5.2f lines/quad, "
+             "tiled %6.2f ns/fragment %5.2f lines/quad\n",
+             pattern->name, nsecs[0], lines[0], nsecs[1], lines[1]);
+
+   if (fp) {
+      fprintf(fp, "pass\t%s\t%f\t%f\t%f\t%f\n", pattern->name,
+              nsecs[0], nsecs[1], lines[0], lines[1]);
+      fflush(fp);
+   }
+
+   align_free(s);
+   align_free(t);
+   align_free(rgba);
+   destroy_textures(textures);
+
+   return TRUE;
+}
+
+
+static boolean
+test_layouts(unsigned verbose)
+{
+   static const enum pipe_format formats[] = {
+      PIPE_FORMAT_R8G8B8A8_UNORM,      /* AoS sampling */
+      PIPE_FORMAT_R32G32B32A32_FLOAT,  /* SoA sampling */
+   };
+   static const unsigned sizes[][2] = { { 64, 32 }, { 37, 22 } };
+   static const unsigned filters[] = {
+      PIPE_TEX_FILTER_NEAREST, PIPE_TEX_FILTER_LINEAR
+   };
+   static const unsigned wraps[] = {
+      PIPE_TEX_WRAP_REPEAT, PIPE_TEX_WRAP_CLAMP_TO_EDGE
+   };
+   boolean success = TRUE;
+   unsigned f, s, i, w;
+
+   for (i = 0; i < ARRAY_SIZE(filters); i++) {
+      for (w = 0; w < ARRAY_SIZE(wraps); w++) {
+         if (!test_shared_funcs_match(verbose, filters[i], wraps[w]))
+            success = FALSE;
+      }
+   }
+
+   for (f = 0; f < ARRAY_SIZE(formats); f++) {
+      for (s = 0; s < ARRAY_SIZE(sizes); s++) {
+         for (i = 0; i < ARRAY_SIZE(filters); i++) {
+            for (w = 0; w < ARRAY_SIZE(wraps); w++) {
+               if (!test_layouts_match(verbose, formats[f],
+                                       sizes[s][0], sizes[s][1],
+                                       filters[i], wraps[w]))
+                  success = FALSE;
+            }
+         }
+      }
+   }
+
+   return success;
+}
+
+
+static boolean
+test_sample(unsigned verbose, FILE *fp, unsigned num_runs)
+{
+   boolean success = test_layouts(verbose);
+   unsigned i;
+
+   for (i = 0; i < ARRAY_SIZE(test_patterns); i++) {
+      if (!benchmark_pattern(verbose, fp, &test_patterns[i], num_runs))
+         success = FALSE;
+   }
+
+   return success;
+}
+
+
+boolean
+test_all(unsigned verbose, FILE *fp)
+{
+   return test_sample(verbose, fp, 10);
+}
+
+
+boolean
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   /* Each run samples a quarter million fragments per layout. */
+   return test_sample(verbose, fp, MAX2(1, MIN2(n, 10)));
+}
+
+
+boolean
+test_single(unsigned verbose, FILE *fp)
+{
+   return test_layouts(verbose);
+}
@@ -0,0 +1,302 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The Mesa Authors.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Batched triangle setup test and tiny triangle benchmark.
+ *
+ * Checks lp_setup_tri_batch() against the one triangle at a time setup of
+ * lp_setup_tri.c, see lp_setup_tri_scalar(), on random mostly pixel sized
+ * triangles, and reports how many triangles per second each of them sets up.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "util/os_time.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_memory.h"
+
+#include "lp_rast.h"
+#include "lp_setup_tri_batch.h"
+#include "lp_test.h"
+
+
+#define FB_SIZE 1024
+
+/* Number of triangles of the benchmark */
+#define NUM_TRIS (1 << 16)
+
+
+static const char *
+cull_name(const struct lp_setup_tri_batch *batch)
+{
+   if (batch->keep_ccw && batch->keep_cw)
+      return "none";
+   return batch->keep_ccw ? "cw" : "ccw";
+}
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "cull\t"
+           "ref_mtris\t"
+           "batch_mtris\n");
+
+   fflush(fp);
+}
+
+
+static float
+random_coord(float min, float max)
+{
+   /* quarter pixels, so some vertices land on pixel centers and edges */
+   return floorf((min + random_float() * (max - min)) * 4.0f) / 4.0f;
+}
+
+
+/**
+ * Fill a batch with mostly pixel sized triangles all over the
+ * framebuffer and a bit beyond, plus some big and degenerate ones.
+ */
+static void
+random_batch(struct lp_setup_tri_batch *batch, unsigned count)
+{
+   unsigned i, j;
+
+   batch->count = count;
+   for (i = 0; i < count; i++) {
+      unsigned kind = rand() % 16;
+      float cx = random_coord(-16.0f, FB_SIZE + 16.0f);
+      float cy = random_coord(-16.0f, FB_SIZE + 16.0f);
+
+      for (j = 0; j < 3; j++) {
+         if (kind == 0) {
+            batch->x[j][i] = random_coord(-256.0f, FB_SIZE + 256.0f);
+            batch->y[j][i] = random_coord(-256.0f, FB_SIZE + 256.0f);
+         }
+         else {
+            batch->x[j][i] = cx + random_float() * 3.0f - 1.5f;
+            batch->y[j][i] = cy + random_float() * 3.0f - 1.5f;
+         }
+      }
+
+      if (kind == 1) {
+         batch->x[2][i] = batch->x[0][i];
+         batch->y[2][i] = batch->y[0][i];
+      }
+   }
+}
+
+
+static boolean
+compare_batch(unsigned verbose, const char *name,
+              const struct lp_setup_tri_batch *batch)
+{
+   unsigned i, j;
+
+   for (i = 0; i < batch->count; i++) {
+      struct lp_rast_plane plane[3];
+      struct u_rect bbox;
+      boolean draw = (batch->draw_mask >> i) & 1;
+      boolean cw = (batch->cw_mask >> i) & 1;
+      boolean ref_cw = FALSE, ref_draw, match;
+
+      ref_draw = lp_setup_tri_scalar(batch, i, &ref_cw, &bbox, plane);
+
+      match = draw == ref_draw && (!draw || cw == ref_cw);
+      if (match && draw) {
+         match = batch->bbox_x0[i] == bbox.x0 &&
+                 batch->bbox_y0[i] == bbox.y0 &&
+                 batch->bbox_x1[i] == bbox.x1 &&
+                 batch->bbox_y1[i] == bbox.y1;
+         for (j = 0; j < 3; j++) {
+            match = match &&
+                    batch->c[j][i] == plane[j].c &&
+                    batch->dcdx[j][i] == plane[j].dcdx &&
+                    batch->dcdy[j][i] == plane[j].dcdy &&
+                    batch->eo[j][i] == plane[j].eo;
+         }
+      }
+
+      if (!match) {
+         if (verbose) {
+            fprintf(stderr, "%s: triangle %u differs (draw %u/%u, cw %u/%u):\n",
+                    name, i, draw, ref_draw, cw, ref_cw);
+            for (j = 0; j < 3; j++)
+               fprintf(stderr, "  v%u: %f %f\n", j,
+                       batch->x[j][i], batch->y[j][i]);
+         }
+         return FALSE;
+      }
+   }
+
+   return TRUE;
+}
+
+
+static boolean
+test_setup(unsigned verbose, FILE *fp, boolean keep_ccw, boolean keep_cw,
+           boolean flatshade_first, boolean bottom_edge_rule,
+           unsigned num_tris)
+{
+   const unsigned num_batches = DIV_ROUND_UP(num_tris, LP_SETUP_TRI_BATCH);
+   struct lp_setup_tri_batch *batches;
+   struct lp_rast_plane plane[3];
+   struct u_rect bbox;
+   boolean cw;
+   int64_t start, ref_nsecs, batch_nsecs;
+   boolean success = TRUE;
+   unsigned drawn = 0, ref_drawn = 0, i, j;
+
+   batches = MALLOC(num_batches * sizeof *batches);
+   if (!batches)
+      return FALSE;
+
+   for (i = 0; i < num_batches; i++) {
+      struct lp_setup_tri_batch *batch = &batches[i];
+
+      batch->pixel_offset = 0.5f;
+      batch->bottom_edge_rule = bottom_edge_rule;
+      batch->flatshade_first = flatshade_first;
+      batch->keep_ccw = keep_ccw;
+      batch->keep_cw = keep_cw;
+      batch->region.x0 = 0;
+      batch->region.y0 = 0;
+      batch->region.x1 = FB_SIZE - 1;
+      batch->region.y1 = FB_SIZE - 1;
+      random_batch(batch, MIN2(num_tris - i * LP_SETUP_TRI_BATCH,
+                               LP_SETUP_TRI_BATCH));
+   }
+
+   /* correctness, of the version picked at runtime and the plain C one */
+   for (i = 0; i < num_batches && success; i++) {
+      lp_setup_tri_batch(&batches[i]);
+      success = compare_batch(verbose, "lp_setup_tri_batch", &batches[i]);
+      drawn += util_bitcount(batches[i].draw_mask);
+
+      if (success) {
+         lp_setup_tri_batch_c(&batches[i]);
+         success = compare_batch(verbose, "lp_setup_tri_batch_c",
+                                 &batches[i]);
+      }
+   }
+
+   /* speed, one triangle at a time vs. batched */
+   start = os_time_get_nano();
+   for (i = 0; i < num_batches; i++) {
+      for (j = 0; j < batches[i].count; j++) {
+         ref_drawn += lp_setup_tri_scalar(&batches[i], j, &cw, &bbox,
+                                          plane);
+      }
+   }
+   ref_nsecs = os_time_get_nano() - start;
+
+   start = os_time_get_nano();
+   for (i = 0; i < num_batches; i++)
+      lp_setup_tri_batch(&batches[i]);
+   batch_nsecs = os_time_get_nano() - start;
+
+   if (ref_drawn != drawn)
+      success = FALSE;
+
+   if (verbose || !success)
+      printf("%s: cull %-4s %s %s: %u of %u drawn, "
+             "%8.2f Mtris/s single, %8.2f Mtris/s batched (%.1fx)\n",
+             success ? "PASS" : "FAIL", cull_name(&batches[0]),
+             flatshade_first ? "first" : "last ",
+             bottom_edge_rule ? "bottom" : "top   ",
+             drawn, num_tris,
+             ref_nsecs ? num_tris * 1000.0 / ref_nsecs : 0.0,
+             batch_nsecs ? num_tris * 1000.0 / batch_nsecs : 0.0,
+             batch_nsecs ? (double)ref_nsecs / batch_nsecs : 0.0);
+
+   if (fp) {
+      fprintf(fp, "%s\t%s\t%f\t%f\n",
+              success ? "pass" : "fail", cull_name(&batches[0]),
+              ref_nsecs ? num_tris * 1000.0 / ref_nsecs : 0.0,
+              batch_nsecs ? num_tris * 1000.0 / batch_nsecs : 0.0);
+      fflush(fp);
+   }
+
+   FREE(batches);
+
+   return success;
+}
+
+
+static boolean
+test_configs(unsigned verbose, FILE *fp, unsigned num_tris)
+{
+   static const boolean keep[3][2] = {
+      { TRUE, TRUE },
+      { TRUE, FALSE },
+      { FALSE, TRUE },
+   };
+   boolean success = TRUE;
+   unsigned i, flatshade_first, bottom_edge_rule;
+
+   if (verbose)
+      printf("AVX2 %s\n", util_cpu_caps.has_avx2 ? "enabled" : "disabled");
+
+   for (i = 0; i < ARRAY_SIZE(keep); i++) {
+      for (flatshade_first = 0; flatshade_first < 2; flatshade_first++) {
+         for (bottom_edge_rule = 0; bottom_edge_rule < 2; bottom_edge_rule++) {
+            if (!test_setup(verbose, fp, keep[i][0], keep[i][1],
+                            flatshade_first, bottom_edge_rule, num_tris))
+               success = FALSE;
+         }
+      }
+   }
+
+   return success;
+}
+
+
+boolean
+test_all(unsigned verbose, FILE *fp)
+{
+   return test_configs(verbose, fp, NUM_TRIS);
+}
+
+
+boolean
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_configs(verbose, fp, MAX2(MIN2(n, NUM_TRIS), 1));
+}
+
+
+boolean
+test_single(unsigned verbose, FILE *fp)
+{
+   return test_setup(verbose, fp, TRUE, TRUE, FALSE, FALSE, NUM_TRIS);
+}
@@ -0,0 +1,479 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The Mesa Authors.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Uniform control flow test and benchmark.
+ *
+ * Compiles nir compute shaders with loops and ifs on uniform and on
+ * divergent conditions, once with branches on uniform conditions and once
+ * with GALLIVM_PERF_NO_UNIFORM_CF, and compares results and speed.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "util/os_time.h"
+#include "util/u_math.h"
+#include "compiler/nir/nir.h"
+#include "compiler/nir/nir_builder.h"
+#include "compiler/nir_types.h"
+#include "gallivm/lp_bld.h"
+#include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_const.h"
+#include "gallivm/lp_bld_debug.h"
+#include "gallivm/lp_bld_flow.h"
+#include "gallivm/lp_bld_gather.h"
+#include "gallivm/lp_bld_nir.h"
+#include "tgsi/tgsi_scan.h"
+
+#include "lp_test.h"
+
+
+#define NUM_RUNS 2000
+
+
+enum cf_shader {
+   CF_UNIFORM_LOOP,   /**< loop with a uniform trip count */
+   CF_UNIFORM_IF,     /**< uniform if in a uniform loop */
+   CF_DIVERGENT_IF,   /**< divergent if in a uniform loop */
+   CF_DIVERGENT_LOOP, /**< uniform ifs in a divergent loop */
+   CF_NUM_SHADERS
+};
+
+static const char *cf_shader_names[CF_NUM_SHADERS] = {
+   "uniform_loop",
+   "uniform_if",
+   "divergent_if",
+   "divergent_loop",
+};
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "shader\t"
+           "iterations\t"
+           "masked_ns\t"
+           "uniform_ns\n");
+
+   fflush(fp);
+}
+
+
+typedef void (*test_shader_t)(const float **consts, const int32_t *const_sizes,
+                              int32_t **ssbos, const int32_t *ssbo_sizes);
+
+
+static const nir_shader_compiler_options test_nir_options = {
+   .lower_fdph = true,
+   .lower_ffma = true,
+};
+
+
+static nir_ssa_def *
+load_ubo_uint(nir_builder *b, unsigned offset)
+{
+   nir_intrinsic_instr *load =
+      nir_intrinsic_instr_create(b->shader, nir_intrinsic_load_ubo);
+
+   load->num_components = 1;
+   load->src[0] = nir_src_for_ssa(nir_imm_int(b, 0));
+   load->src[1] = nir_src_for_ssa(nir_imm_int(b, offset));
+   nir_intrinsic_set_align(load, 4, 0);
+   nir_ssa_dest_init(&load->instr, &load->dest, 1, 32, NULL);
+   nir_builder_instr_insert(b, &load->instr);
+
+   return &load->dest.ssa;
+}
+
+
+static void
+store_ssbo_uint(nir_builder *b, nir_ssa_def *value, nir_ssa_def *offset)
+{
+   nir_intrinsic_instr *store =
+      nir_intrinsic_instr_create(b->shader, nir_intrinsic_store_ssbo);
+
+   store->num_components = 1;
+   store->src[0] = nir_src_for_ssa(value);
+   store->src[1] = nir_src_for_ssa(nir_imm_int(b, 0));
+   store->src[2] = nir_src_for_ssa(offset);
+   nir_intrinsic_set_write_mask(store, 0x1);
+   nir_intrinsic_set_align(store, 4, 0);
+   nir_builder_instr_insert(b, &store->instr);
+}
+
+
+static void
+build_step(nir_builder *b, nir_variable *acc_var, nir_ssa_def *i,
+           nir_ssa_def *cond)
+{
+   nir_ssa_def *acc = nir_load_var(b, acc_var);
+
+   nir_push_if(b, cond);
+   nir_store_var(b, acc_var, nir_iadd(b, nir_imul_imm(b, acc, 3), i), 0x1);
+   nir_push_else(b, NULL);
+   nir_store_var(b, acc_var, nir_ixor(b, acc, i), 0x1);
+   nir_pop_if(b, NULL);
+}
+
+
+/**
+ * Build
+ *
+ *    acc = lane;
+ *    for (i = 0; i < limit; i++)
+ *       step;
+ *    out[lane] = acc;
+ *
+ * where n is the first ubo value and
+ *
+ *    CF_UNIFORM_LOOP:   limit = n, step is acc = acc * 3 + i
+ *    CF_UNIFORM_IF:     limit = n, step is if (i & 1) acc = acc * 3 + i
+ *                                              else acc ^= i
+ *    CF_DIVERGENT_IF:   limit = n, step is if ((i + lane) & 1) ...
+ *    CF_DIVERGENT_LOOP: limit = n + lane, step is if (n & 1) ... and
+ *                       if (n > 100000) break
+ */
+static nir_shader *
+build_shader(enum cf_shader shader)
+{
+   nir_builder b;
+   nir_variable *acc_var, *i_var;
+   nir_ssa_def *lane, *n, *limit, *i, *cond;
+
+   nir_builder_init_simple_shader(&b, NULL, MESA_SHADER_COMPUTE,
+                                  &test_nir_options);
+   acc_var = nir_local_variable_create(b.impl, glsl_uint_type(), "acc");
+   i_var = nir_local_variable_create(b.impl, glsl_uint_type(), "i");
+
+   lane = nir_channel(&b, nir_load_local_invocation_id(&b), 0);
+   n = load_ubo_uint(&b, 0);
+   limit = shader == CF_DIVERGENT_LOOP ? nir_iadd(&b, n, lane) : n;
+
+   nir_store_var(&b, acc_var, lane, 0x1);
+   nir_store_var(&b, i_var, nir_imm_int(&b, 0), 0x1);
+
+   nir_push_loop(&b);
+   i = nir_load_var(&b, i_var);
+   nir_push_if(&b, nir_uge(&b, i, limit));
+   nir_jump(&b, nir_jump_break);
+   nir_pop_if(&b, NULL);
+
+   switch (shader) {
+   case CF_UNIFORM_LOOP:
+      nir_store_var(&b, acc_var,
+                    nir_iadd(&b, nir_imul_imm(&b, nir_load_var(&b, acc_var), 3),
+                             i), 0x1);
+      break;
+   case CF_UNIFORM_IF:
+      cond = nir_i2b(&b, nir_iand(&b, i, nir_imm_int(&b, 1)));
+      build_step(&b, acc_var, i, cond);
+      break;
+   case CF_DIVERGENT_IF:
+      cond = nir_i2b(&b, nir_iand(&b, nir_iadd(&b, i, lane),
+                                  nir_imm_int(&b, 1)));
+      build_step(&b, acc_var, i, cond);
+      break;
+   case CF_DIVERGENT_LOOP:
+   default:
+      cond = nir_i2b(&b, nir_iand(&b, n, nir_imm_int(&b, 1)));
+      build_step(&b, acc_var, i, cond);
+      nir_push_if(&b, nir_ult(&b, nir_imm_int(&b, 100000), n));
+      nir_jump(&b, nir_jump_break);
+      nir_pop_if(&b, NULL);
+      break;
+   }
+
+   nir_store_var(&b, i_var, nir_iadd_imm(&b, i, 1), 0x1);
+   nir_pop_loop(&b, NULL);
+
+   store_ssbo_uint(&b, nir_load_var(&b, acc_var), nir_imul_imm(&b, lane, 4));
+
+   NIR_PASS_V(b.shader, nir_lower_vars_to_ssa);
+   NIR_PASS_V(b.shader, nir_copy_prop);
+   NIR_PASS_V(b.shader, nir_opt_dce);
+   lp_build_opt_nir(b.shader);
+
+   return b.shader;
+}
+
+
+static uint32_t
+reference_value(enum cf_shader shader, uint32_t lane, uint32_t n)
+{
+   uint32_t limit = shader == CF_DIVERGENT_LOOP ? n + lane : n;
+   uint32_t acc = lane;
+   uint32_t i;
+
+   for (i = 0; i < limit; i++) {
+      boolean cond;
+
+      switch (shader) {
+      case CF_UNIFORM_LOOP:
+         cond = TRUE;
+         break;
+      case CF_UNIFORM_IF:
+         cond = i & 1;
+         break;
+      case CF_DIVERGENT_IF:
+         cond = (i + lane) & 1;
+         break;
+      case CF_DIVERGENT_LOOP:
+      default:
+         cond = n & 1;
+         break;
+      }
+
+      acc = cond ? acc * 3 + i : acc ^ i;
+
+      if (shader == CF_DIVERGENT_LOOP && n > 100000)
+         break;
+   }
+
+   return acc;
+}
+
+
+static LLVMValueRef
+add_shader(struct gallivm_state *gallivm, struct lp_type type,
+           nir_shader *nir)
+{
+   LLVMContextRef context = gallivm->context;
+   LLVMBuilderRef builder = gallivm->builder;
+   LLVMTypeRef int32_type = LLVMInt32TypeInContext(context);
+   LLVMTypeRef int32_vec_type = LLVMVectorType(int32_type, type.length);
+   LLVMTypeRef args[4];
+   LLVMValueRef func, lanes[LP_MAX_VECTOR_LENGTH];
+   struct lp_bld_tgsi_system_values system_values;
+   struct lp_build_tgsi_params params;
+   struct lp_build_mask_context mask;
+   struct tgsi_shader_info info;
+   unsigned i;
+
+   args[0] = LLVMPointerType(
+      LLVMArrayType(LLVMPointerType(LLVMFloatTypeInContext(context), 0),
+                    LP_MAX_TGSI_CONST_BUFFERS), 0);
+   args[1] = LLVMPointerType(
+      LLVMArrayType(int32_type, LP_MAX_TGSI_CONST_BUFFERS), 0);
+   args[2] = LLVMPointerType(
+      LLVMArrayType(LLVMPointerType(int32_type, 0),
+                    LP_MAX_TGSI_SHADER_BUFFERS), 0);
+   args[3] = LLVMPointerType(
+      LLVMArrayType(int32_type, LP_MAX_TGSI_SHADER_BUFFERS), 0);
+
+   func = LLVMAddFunction(gallivm->module, "test",
+                          LLVMFunctionType(LLVMVoidTypeInContext(context),
+                                           args, 4, 0));
+   LLVMSetFunctionCallConv(func, LLVMCCallConv);
+   LLVMPositionBuilderAtEnd(builder,
+                            LLVMAppendBasicBlockInContext(context, func, "entry"));
+
+   memset(&system_values, 0, sizeof(system_values));
+   for (i = 0; i < type.length; i++)
+      lanes[i] = lp_build_const_int32(gallivm, i);
+   system_values.thread_id = LLVMGetUndef(LLVMArrayType(int32_vec_type, 3));
+   system_values.thread_id =
+      LLVMBuildInsertValue(builder, system_values.thread_id,
+                           lp_build_gather_values(gallivm, lanes, type.length),
+                           0, "");
+   for (i = 1; i < 3; i++)
+      system_values.thread_id =
+         LLVMBuildInsertValue(builder, system_values.thread_id,
+                              LLVMConstNull(int32_vec_type), i, "");
+
+   memset(&info, 0, sizeof(info));
+
+   lp_build_mask_begin(&mask, gallivm, type,
+                       lp_build_const_int_vec(gallivm, type, ~0));
+
+   memset(&params, 0, sizeof(params));
+   params.type = type;
+   params.mask = &mask;
+   params.consts_ptr = LLVMGetParam(func, 0);
+   params.const_sizes_ptr = LLVMGetParam(func, 1);
+   params.system_values = &system_values;
+   params.info = &info;
+   params.ssbo_ptr = LLVMGetParam(func, 2);
+   params.ssbo_sizes_ptr = LLVMGetParam(func, 3);
+
+   lp_build_nir_soa(gallivm, nir, &params, NULL);
+
+   lp_build_mask_end(&mask);
+   LLVMBuildRetVoid(builder);
+
+   gallivm_verify_function(gallivm, func);
+
+   return func;
+}
+
+
+/**
+ * Compile the shader with branches on uniform conditions or without, run it
+ * and return the time of NUM_RUNS runs, or -1 for wrong results.
+ */
+static int64_t
+run_shader(unsigned verbose, enum cf_shader shader, struct lp_type type,
+           boolean uniform_cf, uint32_t n)
+{
+   const unsigned saved_perf = gallivm_perf;
+   LLVMContextRef context;
+   struct gallivm_state *gallivm;
+   nir_shader *nir;
+   LLVMValueRef func;
+   test_shader_t test_shader_func;
+   uint32_t ubo[4] = { n, 0, 0, 0 };
+   int32_t out[LP_MAX_VECTOR_LENGTH];
+   const float *consts[LP_MAX_TGSI_CONST_BUFFERS] = { (const float *)ubo };
+   int32_t const_sizes[LP_MAX_TGSI_CONST_BUFFERS] = { 1 };
+   int32_t *ssbos[LP_MAX_TGSI_SHADER_BUFFERS] = { out };
+   int32_t ssbo_sizes[LP_MAX_TGSI_SHADER_BUFFERS] = { sizeof(out) };
+   int64_t start, nsecs;
+   unsigned i;
+
+   if (uniform_cf)
+      gallivm_perf &= ~GALLIVM_PERF_NO_UNIFORM_CF;
+   else
+      gallivm_perf |= GALLIVM_PERF_NO_UNIFORM_CF;
+
+   context = LLVMContextCreate();
+   gallivm = gallivm_create("test_module", context, NULL);
+
+   nir = build_shader(shader);
+   func = add_shader(gallivm, type, nir);
+
+   gallivm_compile_module(gallivm);
+
+   test_shader_func = (test_shader_t) gallivm_jit_function(gallivm, func);
+
+   gallivm_free_ir(gallivm);
+   ralloc_free(nir);
+
+   gallivm_perf = saved_perf;
+
+   memset(out, 0xff, sizeof(out));
+   test_shader_func(consts, const_sizes, ssbos, ssbo_sizes);
+
+   nsecs = 0;
+   for (i = 0; i < type.length; i++) {
+      uint32_t expected = reference_value(shader, i, n);
+      if ((uint32_t)out[i] != expected) {
+         if (verbose)
+            printf("%s %s: lane %u got 0x%08x, expected 0x%08x\n",
+                   cf_shader_names[shader], uniform_cf ? "uniform" : "masked",
+                   i, (uint32_t)out[i], expected);
+         nsecs = -1;
+      }
+   }
+
+   if (nsecs == 0) {
+      start = os_time_get_nano();
+      for (i = 0; i < NUM_RUNS; i++)
+         test_shader_func(consts, const_sizes, ssbos, ssbo_sizes);
+      nsecs = os_time_get_nano() - start;
+   }
+
+   gallivm_destroy(gallivm);
+   LLVMContextDispose(context);
+
+   return nsecs;
+}
+
+
+PIPE_ALIGN_STACK
+static boolean
+test_uniform_cf(unsigned verbose, FILE *fp, uint32_t max_iterations)
+{
+   struct lp_type type;
+   boolean success = TRUE;
+   unsigned shader;
+   uint32_t n;
+
+   memset(&type, 0, sizeof(type));
+   type.floating = TRUE;
+   type.sign = TRUE;
+   type.width = 32;
+   type.length = MIN2(lp_native_vector_width / 32, 16);
+
+   glsl_type_singleton_init_or_ref();
+
+   for (shader = 0; shader < CF_NUM_SHADERS; shader++) {
+      for (n = 1; n <= max_iterations; n *= 8) {
+         int64_t masked_nsecs = run_shader(verbose, shader, type, FALSE, n);
+         int64_t uniform_nsecs = run_shader(verbose, shader, type, TRUE, n);
+         boolean pass = masked_nsecs >= 0 && uniform_nsecs >= 0;
+
+         if (!pass)
+            success = FALSE;
+
+         if (verbose || !pass)
+            printf("%s: %-14s %5u iterations: %10.1f ns masked, "
+                   "%10.1f ns uniform (%.2fx)\n",
+                   pass ? "PASS" : "FAIL", cf_shader_names[shader], n,
+                   (double)masked_nsecs / NUM_RUNS,
+                   (double)uniform_nsecs / NUM_RUNS,
+                   pass && uniform_nsecs ?
+                   (double)masked_nsecs / uniform_nsecs : 0.0);
+
+         if (fp) {
+            fprintf(fp, "%s\t%s\t%u\t%f\t%f\n",
+                    pass ? "pass" : "fail", cf_shader_names[shader], n,
+                    (double)masked_nsecs / NUM_RUNS,
+                    (double)uniform_nsecs / NUM_RUNS);
+            fflush(fp);
+         }
+      }
+   }
+
+   glsl_type_singleton_decref();
+
+   return success;
+}
+
+
+boolean
+test_all(unsigned verbose, FILE *fp)
+{
+   return test_uniform_cf(verbose, fp, 4096);
+}
+
+
+boolean
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_uniform_cf(verbose, fp, MAX2(MIN2(n, 4096), 1));
+}
+
+
+boolean
+test_single(unsigned verbose, FILE *fp)
+{
+   return test_uniform_cf(verbose, fp, 64);
+}
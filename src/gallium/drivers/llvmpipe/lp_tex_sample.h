@@ -33,19 +33,22 @@
 
 
 struct lp_sampler_static_state;
+struct lp_sample_func_cache;
 struct lp_image_static_state;
 
 /**
- * Whether texture cache is used for s3tc textures.
+ * Whether the block cache is used for compressed textures, see
+ * lp_build_format_cache.
  */
-#define LP_USE_TEXTURE_CACHE 0
+#define LP_USE_TEXTURE_CACHE 1
 
 /**
  * Pure-LLVM texture sampling code generator.
  *
  */
 struct lp_build_sampler_soa *
-lp_llvm_sampler_soa_create(const struct lp_sampler_static_state *key);
+lp_llvm_sampler_soa_create(const struct lp_sampler_static_state *key,
+                           struct lp_sample_func_cache *func_cache);
 
 struct lp_build_image_soa *
 lp_llvm_image_soa_create(const struct lp_image_static_state *key);
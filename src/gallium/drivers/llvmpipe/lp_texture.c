@@ -35,12 +35,14 @@
 #include "pipe/p_context.h"
 #include "pipe/p_defines.h"
 
+#include "draw/draw_context.h"
 #include "util/u_inlines.h"
 #include "util/u_cpu_detect.h"
 #include "util/format/u_format.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/simple_list.h"
+#include "util/u_surface.h"
 #include "util/u_transfer.h"
 
 #include "lp_context.h"
@@ -69,7 +71,7 @@ llvmpipe_texture_layout(struct llvmpipe_screen *screen,
                         struct llvmpipe_resource *lpr,
                         boolean allocate)
 {
-   struct pipe_resource *pt = &lpr->base;
+   struct pipe_resource *pt = &lpr->base.b;
    unsigned level;
    unsigned width = pt->width0;
    unsigned height = pt->height0;
@@ -108,7 +110,7 @@ llvmpipe_texture_layout(struct llvmpipe_screen *screen,
          align_x = align_y = 1;
       else {
          align_x = LP_RASTER_BLOCK_SIZE;
-         if (llvmpipe_resource_is_1d(&lpr->base))
+         if (llvmpipe_resource_is_1d(&lpr->base.b))
             align_y = 1;
          else
             align_y = LP_RASTER_BLOCK_SIZE;
@@ -134,16 +136,16 @@ llvmpipe_texture_layout(struct llvmpipe_screen *screen,
       lpr->img_stride[level] = lpr->row_stride[level] * nblocksy;
 
       /* Number of 3D image slices, cube faces or texture array layers */
-      if (lpr->base.target == PIPE_TEXTURE_CUBE) {
+      if (lpr->base.b.target == PIPE_TEXTURE_CUBE) {
          assert(layers == 6);
       }
 
-      if (lpr->base.target == PIPE_TEXTURE_3D)
+      if (lpr->base.b.target == PIPE_TEXTURE_3D)
          num_slices = depth;
-      else if (lpr->base.target == PIPE_TEXTURE_1D_ARRAY ||
-               lpr->base.target == PIPE_TEXTURE_2D_ARRAY ||
-               lpr->base.target == PIPE_TEXTURE_CUBE ||
-               lpr->base.target == PIPE_TEXTURE_CUBE_ARRAY)
+      else if (lpr->base.b.target == PIPE_TEXTURE_1D_ARRAY ||
+               lpr->base.b.target == PIPE_TEXTURE_2D_ARRAY ||
+               lpr->base.b.target == PIPE_TEXTURE_CUBE ||
+               lpr->base.b.target == PIPE_TEXTURE_CUBE_ARRAY)
          num_slices = layers;
       else
          num_slices = 1;
@@ -188,6 +190,49 @@ fail:
 }
 
 
+/**
+ * Whether to store the texture in tiles (see LP_RESOURCE_FLAG_TILED), so
+ * that the texels of a sampler footprint share fewer cache lines, even
+ * when minifying or sampling along a diagonal.  Only textures which are
+ * just sampled from are tiled, as rendering and shader images assume the
+ * linear layout.
+ */
+static boolean
+llvmpipe_resource_can_tile(const struct llvmpipe_screen *screen,
+                           const struct pipe_resource *pt)
+{
+   const struct util_format_description *format_desc;
+
+   /* the layout pads each level to whole tiles */
+   STATIC_ASSERT(LP_RASTER_BLOCK_SIZE % LP_TEXTURE_TILE_SIZE == 0);
+
+   if (!screen->tiled_textures)
+      return FALSE;
+
+   if (pt->bind != PIPE_BIND_SAMPLER_VIEW ||
+       pt->usage == PIPE_USAGE_STAGING ||
+       pt->nr_samples > 1 ||
+       (pt->flags & (PIPE_RESOURCE_FLAG_MAP_PERSISTENT |
+                     PIPE_RESOURCE_FLAG_MAP_COHERENT)))
+      return FALSE;
+
+   switch (pt->target) {
+   case PIPE_TEXTURE_2D:
+   case PIPE_TEXTURE_2D_ARRAY:
+   case PIPE_TEXTURE_RECT:
+   case PIPE_TEXTURE_3D:
+   case PIPE_TEXTURE_CUBE:
+   case PIPE_TEXTURE_CUBE_ARRAY:
+      break;
+   default:
+      return FALSE;
+   }
+
+   format_desc = util_format_description(pt->format);
+   return format_desc->block.width == 1 && format_desc->block.height == 1;
+}
+
+
 /**
  * Check the size of the texture specified by 'res'.
  * \return TRUE if OK, FALSE if too large.
@@ -198,7 +243,7 @@ llvmpipe_can_create_resource(struct pipe_screen *screen,
 {
    struct llvmpipe_resource lpr;
    memset(&lpr, 0, sizeof(lpr));
-   lpr.base = *res;
+   lpr.base.b = *res;
    return llvmpipe_texture_layout(llvmpipe_screen(screen), &lpr, false);
 }
 
@@ -213,12 +258,12 @@ llvmpipe_displaytarget_layout(struct llvmpipe_screen *screen,
    /* Round up the surface size to a multiple of the tile size to
     * avoid tile clipping.
     */
-   const unsigned width = MAX2(1, align(lpr->base.width0, TILE_SIZE));
-   const unsigned height = MAX2(1, align(lpr->base.height0, TILE_SIZE));
+   const unsigned width = MAX2(1, align(lpr->base.b.width0, TILE_SIZE));
+   const unsigned height = MAX2(1, align(lpr->base.b.height0, TILE_SIZE));
 
    lpr->dt = winsys->displaytarget_create(winsys,
-                                          lpr->base.bind,
-                                          lpr->base.format,
+                                          lpr->base.b.bind,
+                                          lpr->base.b.format,
                                           width, height,
                                           64,
                                           map_front_private,
@@ -251,14 +296,15 @@ llvmpipe_resource_create_front(struct pipe_screen *_screen,
    if (!lpr)
       return NULL;
 
-   lpr->base = *templat;
-   pipe_reference_init(&lpr->base.reference, 1);
-   lpr->base.screen = &screen->base;
+   lpr->base.b = *templat;
+   lpr->base.b.flags &= ~LP_RESOURCE_FLAG_TILED;
+   pipe_reference_init(&lpr->base.b.reference, 1);
+   lpr->base.b.screen = &screen->base;
 
-   /* assert(lpr->base.bind); */
+   /* assert(lpr->base.b.bind); */
 
-   if (llvmpipe_resource_is_texture(&lpr->base)) {
-      if (lpr->base.bind & (PIPE_BIND_DISPLAY_TARGET |
+   if (llvmpipe_resource_is_texture(&lpr->base.b)) {
+      if (lpr->base.b.bind & (PIPE_BIND_DISPLAY_TARGET |
                             PIPE_BIND_SCANOUT |
                             PIPE_BIND_SHARED)) {
          /* displayable surface */
@@ -267,6 +313,8 @@ llvmpipe_resource_create_front(struct pipe_screen *_screen,
       }
       else {
          /* texture map */
+         if (llvmpipe_resource_can_tile(screen, &lpr->base.b))
+            lpr->base.b.flags |= LP_RESOURCE_FLAG_TILED;
          if (!llvmpipe_texture_layout(screen, lpr, true))
             goto fail;
       }
@@ -294,6 +342,11 @@ llvmpipe_resource_create_front(struct pipe_screen *_screen,
       if (!lpr->data)
          goto fail;
       memset(lpr->data, 0, bytes);
+
+      threaded_resource_init(&lpr->base.b);
+
+      /* Any of several contexts may use the buffer, don't invalidate it */
+      lpr->base.is_shared = p_atomic_read(&screen->num_contexts) > 1;
    }
 
    lpr->id = id_counter++;
@@ -302,7 +355,7 @@ llvmpipe_resource_create_front(struct pipe_screen *_screen,
    insert_at_tail(&resource_list, lpr);
 #endif
 
-   return &lpr->base;
+   return &lpr->base.b;
 
  fail:
    FREE(lpr);
@@ -336,10 +389,22 @@ llvmpipe_resource_destroy(struct pipe_screen *pscreen,
          align_free(lpr->tex_data);
          lpr->tex_data = NULL;
       }
+      if (lpr->linear_tex_data) {
+         align_free(lpr->linear_tex_data);
+         lpr->linear_tex_data = NULL;
+      }
    }
-   else if (!lpr->userBuffer) {
-      assert(lpr->data);
-      align_free(lpr->data);
+   else {
+      threaded_resource_deinit(pt);
+
+      if (!lpr->userBuffer) {
+         assert(lpr->data);
+         align_free(lpr->data);
+      }
+
+      util_dynarray_foreach(&lpr->retired_data, void *, data)
+         align_free(*data);
+      util_dynarray_fini(&lpr->retired_data);
    }
 
 #ifdef DEBUG
@@ -455,17 +520,18 @@ llvmpipe_resource_from_handle(struct pipe_screen *screen,
       goto no_lpr;
    }
 
-   lpr->base = *template;
-   pipe_reference_init(&lpr->base.reference, 1);
-   lpr->base.screen = screen;
+   lpr->base.b = *template;
+   lpr->base.b.flags &= ~LP_RESOURCE_FLAG_TILED;
+   pipe_reference_init(&lpr->base.b.reference, 1);
+   lpr->base.b.screen = screen;
 
    /*
     * Looks like unaligned displaytargets work just fine,
     * at least sampler/render ones.
     */
 #if 0
-   assert(lpr->base.width0 == width);
-   assert(lpr->base.height0 == height);
+   assert(lpr->base.b.width0 == width);
+   assert(lpr->base.b.height0 == height);
 #endif
 
    lpr->dt = winsys->displaytarget_from_handle(winsys,
@@ -482,7 +548,7 @@ llvmpipe_resource_from_handle(struct pipe_screen *screen,
    insert_at_tail(&resource_list, lpr);
 #endif
 
-   return &lpr->base;
+   return &lpr->base.b;
 
 no_dt:
    FREE(lpr);
@@ -509,6 +575,126 @@ llvmpipe_resource_get_handle(struct pipe_screen *screen,
 }
 
 
+/**
+ * Copy a box of texels between a tiled texture and a linear buffer.
+ * Within a tile the texels of a row are contiguous, so this copies runs
+ * of up to LP_TEXTURE_TILE_SIZE texels at a time.
+ */
+static void
+llvmpipe_copy_tiled_box(struct llvmpipe_resource *lpr,
+                        unsigned level,
+                        const struct pipe_box *box,
+                        uint8_t *linear,
+                        unsigned stride,
+                        unsigned layer_stride,
+                        boolean to_tiled)
+{
+   const unsigned tile_mask = LP_TEXTURE_TILE_SIZE - 1;
+   const unsigned texel_size = util_format_get_blocksize(lpr->base.b.format);
+   const unsigned tile_row_size = LP_TEXTURE_TILE_SIZE * texel_size;
+   const unsigned row_stride = lpr->row_stride[level];
+   int x, y, z;
+
+   for (z = 0; z < box->depth; z++) {
+      uint8_t *image = llvmpipe_get_texture_image_address(lpr, box->z + z,
+                                                          level);
+
+      for (y = 0; y < box->height; y++) {
+         unsigned ty = box->y + y;
+         uint8_t *tiled_row = image + (ty & ~tile_mask) * row_stride +
+                              (ty & tile_mask) * tile_row_size;
+         uint8_t *linear_row = linear + z * layer_stride + y * stride;
+
+         for (x = 0; x < box->width; ) {
+            unsigned tx = box->x + x;
+            unsigned n = MIN2(LP_TEXTURE_TILE_SIZE - (tx & tile_mask),
+                              box->width - x);
+            uint8_t *tiled = tiled_row + (tx & ~tile_mask) * tile_row_size +
+                             (tx & tile_mask) * texel_size;
+
+            if (to_tiled)
+               memcpy(tiled, linear_row + x * texel_size, n * texel_size);
+            else
+               memcpy(linear_row + x * texel_size, tiled, n * texel_size);
+
+            x += n;
+         }
+      }
+   }
+}
+
+
+/**
+ * Return the texels of a texture in the linear layout, with the offsets
+ * and strides of the texture.  That is tex_data, except for tiled
+ * textures, which get a separate linear copy the first time.
+ * \return NULL if out of memory
+ */
+void *
+llvmpipe_get_linear_texture_data(struct llvmpipe_resource *lpr)
+{
+   struct pipe_resource *pt = &lpr->base.b;
+   void *linear, *current;
+   unsigned level;
+
+   if (!llvmpipe_resource_is_tiled(pt))
+      return lpr->tex_data;
+
+   if (lpr->linear_tex_data)
+      return lpr->linear_tex_data;
+
+   linear = align_malloc(lpr->sample_stride,
+                         MAX2(64, util_cpu_caps.cacheline));
+   if (!linear)
+      return NULL;
+
+   for (level = 0; level <= pt->last_level; level++) {
+      struct pipe_box box;
+
+      u_box_3d(0, 0, 0,
+               u_minify(pt->width0, level),
+               u_minify(pt->height0, level),
+               util_num_layers(pt, level), &box);
+      llvmpipe_copy_tiled_box(lpr, level, &box,
+                              (uint8_t *) linear + lpr->mip_offsets[level],
+                              lpr->row_stride[level], lpr->img_stride[level],
+                              FALSE);
+   }
+
+   /* Several contexts may sample the texture at the same time */
+   current = p_atomic_cmpxchg(&lpr->linear_tex_data, NULL, linear);
+   if (current) {
+      align_free(linear);
+      return current;
+   }
+
+   return linear;
+}
+
+
+/**
+ * Constants of fragment shaders are copied into the scene, so writing a
+ * bound constant buffer needs them to be copied again.
+ */
+static void
+check_constant_buffer_write(struct llvmpipe_context *llvmpipe,
+                            const struct pipe_resource *resource)
+{
+   unsigned i;
+
+   if (!(resource->bind & PIPE_BIND_CONSTANT_BUFFER))
+      return;
+
+   for (i = 0; i < ARRAY_SIZE(llvmpipe->constants[PIPE_SHADER_FRAGMENT]); ++i) {
+      if (resource == llvmpipe->constants[PIPE_SHADER_FRAGMENT][i].buffer) {
+         /* constants may have changed */
+         llvmpipe->dirty |= LP_NEW_FS_CONSTANTS;
+         break;
+      }
+   }
+}
+
+
 void *
 llvmpipe_transfer_map_ms( struct pipe_context *pipe,
                           struct pipe_resource *resource,
@@ -531,6 +717,11 @@ llvmpipe_transfer_map_ms( struct pipe_context *pipe,
    assert(resource);
    assert(level <= resource->last_level);
 
+   /* Tiled textures are only mapped through a linear copy */
+   if ((usage & PIPE_TRANSFER_MAP_DIRECTLY) &&
+       llvmpipe_resource_is_tiled(resource))
+      return NULL;
+
    /*
     * Transfers, like other pipe operations, must happen in order, so flush the
     * context if necessary.
@@ -552,23 +743,18 @@ llvmpipe_transfer_map_ms( struct pipe_context *pipe,
       }
    }
 
-   /* Check if we're mapping a current constant buffer */
+   /* Check if we're mapping a current constant buffer.  Unsynchronized
+    * maps from u_threaded_context come from the application thread, which
+    * mustn't touch the context, they are checked on unmap instead.
+    */
    if ((usage & PIPE_TRANSFER_WRITE) &&
-       (resource->bind & PIPE_BIND_CONSTANT_BUFFER)) {
-      unsigned i;
-      for (i = 0; i < ARRAY_SIZE(llvmpipe->constants[PIPE_SHADER_FRAGMENT]); ++i) {
-         if (resource == llvmpipe->constants[PIPE_SHADER_FRAGMENT][i].buffer) {
-            /* constants may have changed */
-            llvmpipe->dirty |= LP_NEW_FS_CONSTANTS;
-            break;
-         }
-      }
-   }
+       !(usage & TC_TRANSFER_MAP_THREADED_UNSYNC))
+      check_constant_buffer_write(llvmpipe, resource);
 
    lpt = CALLOC_STRUCT(llvmpipe_transfer);
    if (!lpt)
       return NULL;
-   pt = &lpt->base;
+   pt = &lpt->base.b;
    pipe_resource_reference(&pt->resource, resource);
    pt->box = *box;
    pt->level = level;
@@ -600,7 +786,33 @@ llvmpipe_transfer_map_ms( struct pipe_context *pipe,
       printf("transfer map tex %u  mode %s\n", lpr->id, mode);
    }
 
-   format = lpr->base.format;
+   format = lpr->base.b.format;
+
+   if (llvmpipe_resource_is_tiled(resource)) {
+      /* Hand out a linear copy of the box, which is tiled back on unmap. */
+      unsigned layer_size;
+
+      pt->stride = align(box->width * util_format_get_blocksize(lpr->base.b.format), 16);
+      pt->layer_stride = pt->stride * box->height;
+      layer_size = pt->layer_stride * box->depth;
+
+      lpt->linear = align_malloc(MAX2(layer_size, 1), 64);
+      if (!lpt->linear) {
+         pipe_resource_reference(&pt->resource, NULL);
+         FREE(lpt);
+         return NULL;
+      }
+
+      if (!(usage & (PIPE_TRANSFER_DISCARD_RANGE |
+                     PIPE_TRANSFER_DISCARD_WHOLE_RESOURCE)))
+         llvmpipe_copy_tiled_box(lpr, level, box, lpt->linear,
+                                 pt->stride, pt->layer_stride, FALSE);
+
+      if (usage & PIPE_TRANSFER_WRITE)
+         screen->timestamp++;
+
+      return lpt->linear;
+   }
 
    map = llvmpipe_resource_map(resource,
                                level,
@@ -640,8 +852,36 @@ static void
 llvmpipe_transfer_unmap(struct pipe_context *pipe,
                         struct pipe_transfer *transfer)
 {
+   struct llvmpipe_transfer *lpt = llvmpipe_transfer(transfer);
+
    assert(transfer->resource);
 
+   if ((transfer->usage & PIPE_TRANSFER_WRITE) &&
+       (transfer->usage & TC_TRANSFER_MAP_THREADED_UNSYNC))
+      check_constant_buffer_write(llvmpipe_context(pipe), transfer->resource);
+
+   if (lpt->linear) {
+      struct llvmpipe_resource *lpr = llvmpipe_resource(transfer->resource);
+      const unsigned level = transfer->level;
+      const struct pipe_box *box = &transfer->box;
+
+      if (transfer->usage & PIPE_TRANSFER_WRITE) {
+         llvmpipe_copy_tiled_box(lpr, level, box,
+                                 lpt->linear, transfer->stride,
+                                 transfer->layer_stride, TRUE);
+         if (lpr->linear_tex_data)
+            util_copy_box((ubyte *) lpr->linear_tex_data +
+                          lpr->mip_offsets[level],
+                          lpr->base.b.format,
+                          lpr->row_stride[level], lpr->img_stride[level],
+                          box->x, box->y, box->z,
+                          box->width, box->height, box->depth,
+                          lpt->linear, transfer->stride,
+                          transfer->layer_stride, 0, 0, 0);
+      }
+      align_free(lpt->linear);
+   }
+
    llvmpipe_resource_unmap(transfer->resource,
                            transfer->level,
                            transfer->box.z);
@@ -655,6 +895,92 @@ llvmpipe_transfer_unmap(struct pipe_context *pipe,
    FREE(transfer);
 }
 
+/**
+ * Give dst the storage of src, a buffer u_threaded_context allocated to
+ * invalidate dst.  Called in the driver thread, in order with the other
+ * context calls.
+ *
+ * Other contexts know nothing of this and may be reading the old storage
+ * on their own driver threads, through pointers taken when binding dst,
+ * from their scenes or through transfers.  So the old storage is only
+ * freed while this is the only context of the screen; otherwise it is
+ * kept until dst is destroyed, and dst is marked as shared so that
+ * u_threaded_context stops invalidating it.
+ */
+void
+llvmpipe_replace_buffer_storage(struct pipe_context *pipe,
+                                struct pipe_resource *dst,
+                                struct pipe_resource *src)
+{
+   struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
+   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
+   struct llvmpipe_resource *lpdst = llvmpipe_resource(dst);
+   struct llvmpipe_resource *lpsrc = llvmpipe_resource(src);
+   void *old_data;
+   boolean retire;
+   unsigned sh, i;
+
+   assert(dst->target == PIPE_BUFFER && src->target == PIPE_BUFFER);
+   assert(!lpdst->userBuffer && !lpsrc->userBuffer);
+
+   /* Scenes read sampler views, shader buffers and images through the
+    * pointers they were binned with, so wait for the ones using the old
+    * storage.  Fragment shader constants are copied into the scene and
+    * vertex and index data is read while drawing, but the draw module's
+    * constants, shader buffers and stream output targets are accessed
+    * through the pointers taken at bind time; they are rebound below.
+    */
+   llvmpipe_flush_resource(pipe, dst, 0,
+                           FALSE, /* read_only */
+                           TRUE, /* cpu_access */
+                           FALSE, /* do_not_block */
+                           __FUNCTION__);
+
+   /* Under ctx_mutex, so a context created after this only ever sees the
+    * new storage.  Buffers whose address was handed out by
+    * set_global_binding are marked as shared as well.
+    */
+   mtx_lock(&screen->ctx_mutex);
+   old_data = lpdst->data;
+   lpdst->data = lpsrc->data;
+   retire = screen->num_contexts > 1 || lpdst->base.is_shared;
+   mtx_unlock(&screen->ctx_mutex);
+
+   if (retire) {
+      util_dynarray_append(&lpdst->retired_data, void *, old_data);
+      lpdst->base.is_shared = true;
+   }
+   else {
+      align_free(old_data);
+   }
+
+   /* src stays the latest version of dst for unsynchronized mappings in
+    * the application thread, but the storage belongs to dst now.
+    */
+   lpsrc->userBuffer = TRUE;
+
+   /* Rebind dst where its data pointer is taken at bind time. */
+   for (sh = 0; sh < PIPE_SHADER_TYPES; sh++) {
+      for (i = 0; i < ARRAY_SIZE(llvmpipe->constants[sh]); i++) {
+         if (llvmpipe->constants[sh][i].buffer == dst)
+            pipe->set_constant_buffer(pipe, sh, i, &llvmpipe->constants[sh][i]);
+      }
+      for (i = 0; i < ARRAY_SIZE(llvmpipe->ssbos[sh]); i++) {
+         if (llvmpipe->ssbos[sh][i].buffer == dst)
+            pipe->set_shader_buffers(pipe, sh, i, 1, &llvmpipe->ssbos[sh][i], 0);
+      }
+   }
+   for (i = 0; i < llvmpipe->num_so_targets; i++) {
+      if (llvmpipe->so_targets[i] &&
+          llvmpipe->so_targets[i]->target.buffer == dst)
+         llvmpipe->so_targets[i]->mapping = lpdst->data;
+   }
+
+   llvmpipe->dirty |= LP_NEW_SAMPLER_VIEW | LP_NEW_FS_IMAGES;
+   llvmpipe->cs_dirty |= LP_CSNEW_SAMPLER_VIEW | LP_CSNEW_IMAGES;
+}
+
+
 unsigned int
 llvmpipe_is_resource_referenced( struct pipe_context *pipe,
                                  struct pipe_resource *presource,
@@ -717,20 +1043,24 @@ llvmpipe_user_buffer_create(struct pipe_screen *screen,
    if (!buffer)
       return NULL;
 
-   pipe_reference_init(&buffer->base.reference, 1);
-   buffer->base.screen = screen;
-   buffer->base.format = PIPE_FORMAT_R8_UNORM; /* ?? */
-   buffer->base.bind = bind_flags;
-   buffer->base.usage = PIPE_USAGE_IMMUTABLE;
-   buffer->base.flags = 0;
-   buffer->base.width0 = bytes;
-   buffer->base.height0 = 1;
-   buffer->base.depth0 = 1;
-   buffer->base.array_size = 1;
+   pipe_reference_init(&buffer->base.b.reference, 1);
+   buffer->base.b.screen = screen;
+   buffer->base.b.format = PIPE_FORMAT_R8_UNORM; /* ?? */
+   buffer->base.b.bind = bind_flags;
+   buffer->base.b.usage = PIPE_USAGE_IMMUTABLE;
+   buffer->base.b.flags = 0;
+   buffer->base.b.width0 = bytes;
+   buffer->base.b.height0 = 1;
+   buffer->base.b.depth0 = 1;
+   buffer->base.b.array_size = 1;
    buffer->userBuffer = TRUE;
    buffer->data = ptr;
 
-   return &buffer->base;
+   threaded_resource_init(&buffer->base.b);
+   buffer->base.is_user_ptr = true;
+   util_range_add(&buffer->base.b, &buffer->base.valid_buffer_range, 0, bytes);
+
+   return &buffer->base.b;
 }
 
 
@@ -755,7 +1085,7 @@ llvmpipe_get_texture_image_address(struct llvmpipe_resource *lpr,
 {
    unsigned offset;
 
-   assert(llvmpipe_resource_is_texture(&lpr->base));
+   assert(llvmpipe_resource_is_texture(&lpr->base.b));
 
    offset = lpr->mip_offsets[level];
 
@@ -802,11 +1132,11 @@ llvmpipe_print_resources(void)
 
    debug_printf("LLVMPIPE: current resources:\n");
    foreach(lpr, &resource_list) {
-      unsigned size = llvmpipe_resource_size(&lpr->base);
+      unsigned size = llvmpipe_resource_size(&lpr->base.b);
       debug_printf("resource %u at %p, size %ux%ux%u: %u bytes, refcount %u\n",
                    lpr->id, (void *) lpr,
-                   lpr->base.width0, lpr->base.height0, lpr->base.depth0,
-                   size, lpr->base.reference.count);
+                   lpr->base.b.width0, lpr->base.b.height0, lpr->base.b.depth0,
+                   size, lpr->base.b.reference.count);
       total += size;
       n++;
    }
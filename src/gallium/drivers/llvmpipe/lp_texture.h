@@ -31,6 +31,9 @@
 
 #include "pipe/p_state.h"
 #include "util/u_debug.h"
+#include "util/u_dynarray.h"
+#include "util/u_threaded_context.h"
+#include "gallivm/lp_bld_sample.h"
 #include "lp_limits.h"
 
 
@@ -49,16 +52,31 @@ struct llvmpipe_context;
 struct sw_displaytarget;
 
 
+/**
+ * Set in pipe_resource::flags of textures which are stored in tiles of
+ * LP_TEXTURE_TILE_SIZE x LP_TEXTURE_TILE_SIZE texels, the layout the
+ * samplers use for the tiled bit of lp_static_texture_state.  Only
+ * textures which are just sampled from are created tiled, and the layout
+ * never changes afterwards.  Transfers get a linear copy of the box, and
+ * the draw module, which only samples linearly, reads the linear copy of
+ * llvmpipe_get_linear_texture_data().
+ */
+#define LP_RESOURCE_FLAG_TILED   (PIPE_RESOURCE_FLAG_DRV_PRIV << 0)
+#define LP_TEXTURE_TILE_SIZE     LP_BUILD_SAMPLE_TILE_SIZE
+
+
 /**
  * llvmpipe subclass of pipe_resource.  A texture, drawing surface,
  * vertex buffer, const buffer, etc.
  * Textures are stored differently than other types of objects such as
  * vertex buffers and const buffers.
  * The latter are simple malloc'd blocks of memory.
+ * Subclasses threaded_resource so the context can be wrapped by
+ * u_threaded_context.
  */
 struct llvmpipe_resource
 {
-   struct pipe_resource base;
+   struct threaded_resource base;
 
    /** Row stride in bytes */
    unsigned row_stride[LP_MAX_TEXTURE_LEVELS];
@@ -80,12 +98,27 @@ struct llvmpipe_resource
     */
    void *tex_data;
 
+   /**
+    * Linear copy of tex_data for tiled textures, created when the draw
+    * module first samples them and kept up to date by transfers.
+    */
+   void *linear_tex_data;
+
    /**
     * Data for non-texture resources.
     */
    void *data;
 
-   boolean userBuffer;  /** Is this a user-space buffer? */
+   /** Is data not ours to free?  User-space buffers, and buffers whose
+    * storage was handed over by llvmpipe_replace_buffer_storage().
+    */
+   boolean userBuffer;
+
+   /** Replaced storage of a buffer other contexts may still point into,
+    * freed with the buffer, see llvmpipe_replace_buffer_storage().
+    */
+   struct util_dynarray retired_data;
+
    unsigned timestamp;
 
    unsigned id;  /**< temporary, for debugging */
@@ -100,9 +133,12 @@ struct llvmpipe_resource
 
 struct llvmpipe_transfer
 {
-   struct pipe_transfer base;
+   struct threaded_transfer base;
 
    unsigned long offset;
+
+   /** Linear copy of the box of a tiled texture, written back on unmap */
+   void *linear;
 };
 
 
@@ -131,6 +167,11 @@ llvmpipe_transfer(struct pipe_transfer *pt)
 void llvmpipe_init_screen_resource_funcs(struct pipe_screen *screen);
 void llvmpipe_init_context_resource_funcs(struct pipe_context *pipe);
 
+void
+llvmpipe_replace_buffer_storage(struct pipe_context *pipe,
+                                struct pipe_resource *dst,
+                                struct pipe_resource *src);
+
 
 static inline boolean
 llvmpipe_resource_is_texture(const struct pipe_resource *resource)
@@ -176,6 +217,17 @@ llvmpipe_resource_is_1d(const struct pipe_resource *resource)
 }
 
 
+/**
+ * Is the texture stored in tiles rather than linearly?
+ * See LP_RESOURCE_FLAG_TILED.
+ */
+static inline boolean
+llvmpipe_resource_is_tiled(const struct pipe_resource *resource)
+{
+   return !!(resource->flags & LP_RESOURCE_FLAG_TILED);
+}
+
+
 static inline unsigned
 llvmpipe_layer_stride(struct pipe_resource *resource,
                       unsigned level)
@@ -251,4 +303,21 @@ llvmpipe_transfer_map_ms( struct pipe_context *pipe,
 			  unsigned sample,
 			  const struct pipe_box *box,
 			  struct pipe_transfer **transfer );
+
+void *
+llvmpipe_get_linear_texture_data(struct llvmpipe_resource *lpr);
+
+
+/**
+ * lp_sampler_static_texture_state() with the layout of llvmpipe textures.
+ */
+static inline void
+llvmpipe_sampler_static_texture_state(struct lp_static_texture_state *state,
+                                      const struct pipe_sampler_view *view)
+{
+   lp_sampler_static_texture_state(state, view);
+   if (view && view->texture)
+      state->tiled = llvmpipe_resource_is_tiled(view->texture);
+}
+
 #endif /* LP_TEXTURE_H */
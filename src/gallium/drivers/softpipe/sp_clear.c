@@ -38,6 +38,7 @@
 #include "sp_clear.h"
 #include "sp_context.h"
 #include "sp_query.h"
+#include "sp_rast.h"
 #include "sp_tile_cache.h"
 
 
@@ -67,10 +68,20 @@ softpipe_clear(struct pipe_context *pipe, unsigned buffers,
    softpipe_update_derived(softpipe, PIPE_PRIM_TRIANGLES); /* not needed?? */
 #endif
 
+   /* Get the rasterizer threads' tiles out of the way first.  Full clears
+    * are recorded in their tile caches as well, so that they resolve them
+    * from the same unquantized clear values as the context's caches.
+    */
+   if (softpipe->rast)
+      sp_rast_flush_tile_caches(softpipe->rast);
+
    if (buffers & PIPE_CLEAR_COLOR) {
       for (i = 0; i < softpipe->framebuffer.nr_cbufs; i++) {
-         if (buffers & (PIPE_CLEAR_COLOR0 << i))
+         if (buffers & (PIPE_CLEAR_COLOR0 << i)) {
             sp_tile_cache_clear(softpipe->cbuf_cache[i], color, 0);
+            if (softpipe->rast)
+               sp_rast_clear_cbuf(softpipe->rast, i, color);
+         }
       }
    }
 
@@ -86,6 +97,8 @@ softpipe_clear(struct pipe_context *pipe, unsigned buffers,
 
       cv = util_pack64_z_stencil(zsbuf->format, depth, stencil);
       sp_tile_cache_clear(softpipe->zsbuf_cache, &zero, cv);
+      if (softpipe->rast)
+         sp_rast_clear_zsbuf(softpipe->rast, cv);
    }
 
    softpipe->dirty_render_cache = TRUE;
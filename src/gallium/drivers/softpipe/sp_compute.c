@@ -55,7 +55,7 @@ cs_prepare(const struct sp_compute_shader *cs,
 
    if (machine->SysSemanticToIndex[TGSI_SEMANTIC_THREAD_ID] != -1) {
       unsigned i = machine->SysSemanticToIndex[TGSI_SEMANTIC_THREAD_ID];
-      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+      for (j = 0; j < machine->NumLanes; j++) {
          machine->SystemValue[i].xyzw[0].i[j] = w;
          machine->SystemValue[i].xyzw[1].i[j] = h;
          machine->SystemValue[i].xyzw[2].i[j] = d;
@@ -64,7 +64,7 @@ cs_prepare(const struct sp_compute_shader *cs,
 
    if (machine->SysSemanticToIndex[TGSI_SEMANTIC_GRID_SIZE] != -1) {
       unsigned i = machine->SysSemanticToIndex[TGSI_SEMANTIC_GRID_SIZE];
-      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+      for (j = 0; j < machine->NumLanes; j++) {
          machine->SystemValue[i].xyzw[0].i[j] = g_w;
          machine->SystemValue[i].xyzw[1].i[j] = g_h;
          machine->SystemValue[i].xyzw[2].i[j] = g_d;
@@ -73,7 +73,7 @@ cs_prepare(const struct sp_compute_shader *cs,
 
    if (machine->SysSemanticToIndex[TGSI_SEMANTIC_BLOCK_SIZE] != -1) {
       unsigned i = machine->SysSemanticToIndex[TGSI_SEMANTIC_BLOCK_SIZE];
-      for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+      for (j = 0; j < machine->NumLanes; j++) {
          machine->SystemValue[i].xyzw[0].i[j] = b_w;
          machine->SystemValue[i].xyzw[1].i[j] = b_h;
          machine->SystemValue[i].xyzw[2].i[j] = b_d;
@@ -90,7 +90,7 @@ cs_run(const struct sp_compute_shader *cs,
       if (machine->SysSemanticToIndex[TGSI_SEMANTIC_BLOCK_ID] != -1) {
          unsigned i = machine->SysSemanticToIndex[TGSI_SEMANTIC_BLOCK_ID];
          int j;
-         for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+         for (j = 0; j < machine->NumLanes; j++) {
             machine->SystemValue[i].xyzw[0].i[j] = g_w;
             machine->SystemValue[i].xyzw[1].i[j] = g_h;
             machine->SystemValue[i].xyzw[2].i[j] = g_d;
@@ -44,6 +44,7 @@
 #include "sp_context.h"
 #include "sp_flush.h"
 #include "sp_prim_vbuf.h"
+#include "sp_rast.h"
 #include "sp_state.h"
 #include "sp_surface.h"
 #include "sp_tile_cache.h"
@@ -75,17 +76,9 @@ softpipe_destroy( struct pipe_context *pipe )
    if (softpipe->draw)
       draw_destroy( softpipe->draw );
 
-   if (softpipe->quad.shade)
-      softpipe->quad.shade->destroy( softpipe->quad.shade );
+   sp_rast_destroy(softpipe->rast);
 
-   if (softpipe->quad.depth_test)
-      softpipe->quad.depth_test->destroy( softpipe->quad.depth_test );
-
-   if (softpipe->quad.blend)
-      softpipe->quad.blend->destroy( softpipe->quad.blend );
-
-   if (softpipe->quad.pstipple)
-      softpipe->quad.pstipple->destroy( softpipe->quad.pstipple );
+   sp_destroy_quad_pipeline(&softpipe->quad);
 
    if (softpipe->pipe.stream_uploader)
       u_upload_destroy(softpipe->pipe.stream_uploader);
@@ -266,10 +259,17 @@ softpipe_create_context(struct pipe_screen *screen,
    softpipe->fs_machine = tgsi_exec_machine_create(PIPE_SHADER_FRAGMENT);
 
    /* setup quad rendering stages */
-   softpipe->quad.shade = sp_quad_shade_stage(softpipe);
-   softpipe->quad.depth_test = sp_quad_depth_test_stage(softpipe);
-   softpipe->quad.blend = sp_quad_blend_stage(softpipe);
-   softpipe->quad.pstipple = sp_quad_polygon_stipple_stage(softpipe);
+   for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++)
+      softpipe->quad_target.cbuf_cache[i] = softpipe->cbuf_cache[i];
+   softpipe->quad_target.zsbuf_cache = softpipe->zsbuf_cache;
+   softpipe->quad_target.fs_machine = softpipe->fs_machine;
+   softpipe->quad_target.occlusion_count = &softpipe->occlusion_count;
+   softpipe->quad_target.ps_invocations =
+      &softpipe->pipeline_statistics.ps_invocations;
+
+   if (!sp_init_quad_pipeline(softpipe, &softpipe->quad,
+                              &softpipe->quad_target))
+      goto fail;
 
    softpipe->pipe.stream_uploader = u_upload_create_default(&softpipe->pipe);
    if (!softpipe->pipe.stream_uploader)
@@ -319,6 +319,10 @@ softpipe_create_context(struct pipe_screen *screen,
    if (debug_get_bool_option( "SOFTPIPE_NO_RAST", false ))
       softpipe->no_rast = TRUE;
 
+   /* Falls back to inline fragment processing if this fails */
+   if (sp_screen->num_threads)
+      softpipe->rast = sp_rast_create(softpipe, sp_screen->num_threads);
+
    softpipe->vbuf_backend = sp_create_vbuf_backend(softpipe);
    if (!softpipe->vbuf_backend)
       goto fail;
@@ -48,6 +48,7 @@
 
 
 struct softpipe_vbuf_render;
+struct sp_rast;
 struct draw_context;
 struct draw_stage;
 struct softpipe_tile_cache;
@@ -161,13 +162,11 @@ struct softpipe_context {
    } pstipple;
 
    /** Software quad rendering pipeline */
-   struct {
-      struct quad_stage *shade;
-      struct quad_stage *depth_test;
-      struct quad_stage *blend;
-      struct quad_stage *pstipple;
-      struct quad_stage *first; /**< points to one of the above stages */
-   } quad;
+   struct quad_pipeline quad;
+   struct quad_target quad_target;
+
+   /** Rasterizer threads, NULL when fragments are processed inline */
+   struct sp_rast *rast;
 
    /** TGSI exec things */
    struct {
@@ -35,6 +35,7 @@
 #include "draw/draw_context.h"
 #include "sp_flush.h"
 #include "sp_context.h"
+#include "sp_rast.h"
 #include "sp_state.h"
 #include "sp_tile_cache.h"
 #include "sp_tex_tile_cache.h"
@@ -61,8 +62,14 @@ softpipe_flush( struct pipe_context *pipe,
             sp_flush_tex_tile_cache(softpipe->tex_cache[sh][i]);
          }
       }
+
+      if (softpipe->rast)
+         sp_rast_flush_tex_caches(softpipe->rast);
    }
 
+   if (softpipe->rast)
+      sp_rast_flush_tile_caches(softpipe->rast);
+
    /* If this is a swapbuffers, just flush color buffers.
     *
     * The zbuffer changes are not discarded, but held in the cache
@@ -180,6 +187,11 @@ void softpipe_texture_barrier(struct pipe_context *pipe, unsigned flags)
       }
    }
 
+   if (softpipe->rast) {
+      sp_rast_flush_tex_caches(softpipe->rast);
+      sp_rast_flush_tile_caches(softpipe->rast);
+   }
+
    for (i = 0; i < softpipe->framebuffer.nr_cbufs; i++)
       if (softpipe->cbuf_cache[i])
          sp_flush_tile_cache(softpipe->cbuf_cache[i]);
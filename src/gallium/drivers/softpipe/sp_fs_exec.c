@@ -69,37 +69,85 @@ exec_prepare( const struct sp_fragment_shader_variant *var,
 
 
 /**
- * Compute quad X,Y,Z,W for the four fragments in a quad.
+ * Compute quad X,Y,Z,W for the four fragments in a quad, starting at
+ * lane 'first' of the machine's vectors.
  *
  * This should really be part of the compiled shader.
  */
 static void
 setup_pos_vector(const struct tgsi_interp_coef *coef,
                  float x, float y,
-                 struct tgsi_exec_vector *quadpos)
+                 struct tgsi_exec_vector *quadpos,
+                 uint first)
 {
    uint chan;
    /* do X */
-   quadpos->xyzw[0].f[0] = x;
-   quadpos->xyzw[0].f[1] = x + 1;
-   quadpos->xyzw[0].f[2] = x;
-   quadpos->xyzw[0].f[3] = x + 1;
+   quadpos->xyzw[0].f[first + 0] = x;
+   quadpos->xyzw[0].f[first + 1] = x + 1;
+   quadpos->xyzw[0].f[first + 2] = x;
+   quadpos->xyzw[0].f[first + 3] = x + 1;
 
    /* do Y */
-   quadpos->xyzw[1].f[0] = y;
-   quadpos->xyzw[1].f[1] = y;
-   quadpos->xyzw[1].f[2] = y + 1;
-   quadpos->xyzw[1].f[3] = y + 1;
+   quadpos->xyzw[1].f[first + 0] = y;
+   quadpos->xyzw[1].f[first + 1] = y;
+   quadpos->xyzw[1].f[first + 2] = y + 1;
+   quadpos->xyzw[1].f[first + 3] = y + 1;
 
    /* do Z and W for all fragments in the quad */
    for (chan = 2; chan < 4; chan++) {
       const float dadx = coef->dadx[chan];
       const float dady = coef->dady[chan];
       const float a0 = coef->a0[chan] + dadx * x + dady * y;
-      quadpos->xyzw[chan].f[0] = a0;
-      quadpos->xyzw[chan].f[1] = a0 + dadx;
-      quadpos->xyzw[chan].f[2] = a0 + dady;
-      quadpos->xyzw[chan].f[3] = a0 + dadx + dady;
+      quadpos->xyzw[chan].f[first + 0] = a0;
+      quadpos->xyzw[chan].f[first + 1] = a0 + dadx;
+      quadpos->xyzw[chan].f[first + 2] = a0 + dady;
+      quadpos->xyzw[chan].f[first + 3] = a0 + dadx + dady;
+   }
+}
+
+
+/**
+ * Copy the shader outputs of the quad at lane 'first' into the quad.
+ */
+static void
+store_outputs(const struct sp_fragment_shader_variant *var,
+              const struct tgsi_exec_machine *machine,
+              struct quad_header *quad,
+              uint first,
+              bool early_depth_test)
+{
+   const ubyte *sem_name = var->info.output_semantic_name;
+   const ubyte *sem_index = var->info.output_semantic_index;
+   const uint n = var->info.num_outputs;
+   uint i, j;
+
+   for (i = 0; i < n; i++) {
+      switch (sem_name[i]) {
+      case TGSI_SEMANTIC_COLOR:
+         {
+            uint cbuf = sem_index[i];
+            uint chan;
+
+            for (chan = 0; chan < TGSI_NUM_CHANNELS; chan++) {
+               memcpy(quad->output.color[cbuf][chan],
+                      &machine->Outputs[i].xyzw[chan].f[first],
+                      sizeof(quad->output.color[cbuf][chan]));
+            }
+         }
+         break;
+      case TGSI_SEMANTIC_POSITION:
+         if (!early_depth_test) {
+            for (j = 0; j < TGSI_QUAD_SIZE; j++)
+               quad->output.depth[j] = machine->Outputs[i].xyzw[2].f[first + j];
+         }
+         break;
+      case TGSI_SEMANTIC_STENCIL:
+         if (!early_depth_test) {
+            for (j = 0; j < TGSI_QUAD_SIZE; j++)
+               quad->output.stencil[j] = (unsigned)machine->Outputs[i].xyzw[1].u[first + j];
+         }
+         break;
+      }
    }
 }
 
@@ -110,67 +158,47 @@ setup_pos_vector(const struct tgsi_interp_coef *coef,
 static unsigned 
 exec_run( const struct sp_fragment_shader_variant *var,
 	  struct tgsi_exec_machine *machine,
-	  struct quad_header *quad,
+	  struct quad_header *quads[],
+	  unsigned nr,
 	  bool early_depth_test )
 {
-   /* Compute X, Y, Z, W vals for this quad */
-   setup_pos_vector(quad->posCoef, 
-                    (float)quad->input.x0, (float)quad->input.y0, 
-                    &machine->QuadPos);
-
-   /* convert 0 to 1.0 and 1 to -1.0 */
-   machine->Face = (float) (quad->input.facing * -2 + 1);
-
-   machine->NonHelperMask = quad->inout.mask;
-   quad->inout.mask &= tgsi_exec_machine_run( machine, 0 );
-   if (quad->inout.mask == 0)
-      return FALSE;
-
-   /* store outputs */
-   {
-      const ubyte *sem_name = var->info.output_semantic_name;
-      const ubyte *sem_index = var->info.output_semantic_index;
-      const uint n = var->info.num_outputs;
-      uint i;
-      for (i = 0; i < n; i++) {
-         switch (sem_name[i]) {
-         case TGSI_SEMANTIC_COLOR:
-            {
-               uint cbuf = sem_index[i];
-
-               assert(sizeof(quad->output.color[cbuf]) ==
-                      sizeof(machine->Outputs[i]));
-
-               /* copy float[4][4] result */
-               memcpy(quad->output.color[cbuf],
-                      &machine->Outputs[i],
-                      sizeof(quad->output.color[0]) );
-            }
-            break;
-         case TGSI_SEMANTIC_POSITION:
-            {
-               uint j;
-
-               if (!early_depth_test) {
-                  for (j = 0; j < 4; j++)
-                     quad->output.depth[j] = machine->Outputs[i].xyzw[2].f[j];
-               }
-            }
-            break;
-         case TGSI_SEMANTIC_STENCIL:
-            {
-               uint j;
-               if (!early_depth_test) {
-                  for (j = 0; j < 4; j++)
-                     quad->output.stencil[j] = (unsigned)machine->Outputs[i].xyzw[1].u[j];
-               }
-            }
-            break;
-         }
-      }
+   unsigned mask = 0, live = 0;
+   uint q;
+
+   assert(nr > 0 && nr <= TGSI_EXEC_NUM_QUADS);
+
+   /* Compute X, Y, Z, W vals for these quads.  Unused slots repeat the
+    * last quad so that they don't compute with stale positions.
+    */
+   for (q = 0; q < TGSI_EXEC_NUM_QUADS; q++) {
+      const struct quad_header *quad = quads[MIN2(q, nr - 1)];
+      setup_pos_vector(quad->posCoef,
+                       (float)quad->input.x0, (float)quad->input.y0,
+                       &machine->QuadPos, q * TGSI_QUAD_SIZE);
+      if (q < nr)
+         mask |= quad->inout.mask << (q * TGSI_QUAD_SIZE);
+   }
+
+   /* All quads come from the same primitive.
+    * convert 0 to 1.0 and 1 to -1.0
+    */
+   machine->Face = (float) (quads[0]->input.facing * -2 + 1);
+
+   machine->NonHelperMask = mask;
+   mask &= tgsi_exec_machine_run( machine, 0 );
+
+   for (q = 0; q < nr; q++) {
+      struct quad_header *quad = quads[q];
+
+      quad->inout.mask &= mask >> (q * TGSI_QUAD_SIZE);
+      if (quad->inout.mask == 0)
+         continue;
+
+      store_outputs(var, machine, quad, q * TGSI_QUAD_SIZE, early_depth_test);
+      live |= 1 << q;
    }
 
-   return TRUE;
+   return live;
 }
 
 
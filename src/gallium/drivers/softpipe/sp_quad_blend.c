@@ -932,7 +932,7 @@ blend_fallback(struct quad_stage *qs,
          const uint blend_buf = blend->independent_blend_enable ? cbuf : 0;
          float dest[4][TGSI_QUAD_SIZE];
          struct softpipe_cached_tile *tile
-            = sp_get_cached_tile(softpipe->cbuf_cache[cbuf],
+            = sp_get_cached_tile(qs->target->cbuf_cache[cbuf],
                                  quads[0]->input.x0, 
                                  quads[0]->input.y0, quads[0]->input.layer);
          const boolean clamp = bqs->clamp[cbuf];
@@ -982,6 +982,7 @@ blend_fallback(struct quad_stage *qs,
                   dest[i][j] = tile->data.color[y][x][i];
                }
             }
+            sp_tile_cache_quantize_quad(qs->target->cbuf_cache[cbuf], dest);
 
 
             if (blend->logicop_enable) {
@@ -1035,7 +1036,7 @@ blend_single_add_src_alpha_inv_src_alpha(struct quad_stage *qs,
    uint i, j, q;
 
    struct softpipe_cached_tile *tile
-      = sp_get_cached_tile(qs->softpipe->cbuf_cache[0],
+      = sp_get_cached_tile(qs->target->cbuf_cache[0],
                            quads[0]->input.x0, 
                            quads[0]->input.y0, quads[0]->input.layer);
 
@@ -1054,6 +1055,7 @@ blend_single_add_src_alpha_inv_src_alpha(struct quad_stage *qs,
             dest[i][j] = tile->data.color[y][x][i];
          }
       }
+      sp_tile_cache_quantize_quad(qs->target->cbuf_cache[0], dest);
 
       /* If fixed-point dest color buffer, need to clamp the incoming
        * fragment colors now.
@@ -1109,7 +1111,7 @@ blend_single_add_one_one(struct quad_stage *qs,
    uint i, j, q;
 
    struct softpipe_cached_tile *tile
-      = sp_get_cached_tile(qs->softpipe->cbuf_cache[0],
+      = sp_get_cached_tile(qs->target->cbuf_cache[0],
                            quads[0]->input.x0, 
                            quads[0]->input.y0, quads[0]->input.layer);
 
@@ -1127,6 +1129,7 @@ blend_single_add_one_one(struct quad_stage *qs,
             dest[i][j] = tile->data.color[y][x][i];
          }
       }
+      sp_tile_cache_quantize_quad(qs->target->cbuf_cache[0], dest);
      
       /* If fixed-point dest color buffer, need to clamp the incoming
        * fragment colors now.
@@ -1177,7 +1180,7 @@ single_output_color(struct quad_stage *qs,
    uint i, j, q;
 
    struct softpipe_cached_tile *tile
-      = sp_get_cached_tile(qs->softpipe->cbuf_cache[0],
+      = sp_get_cached_tile(qs->target->cbuf_cache[0],
                            quads[0]->input.x0, 
                            quads[0]->input.y0, quads[0]->input.layer);
 
@@ -1295,7 +1298,8 @@ static void blend_destroy(struct quad_stage *qs)
 }
 
 
-struct quad_stage *sp_quad_blend_stage( struct softpipe_context *softpipe )
+struct quad_stage *sp_quad_blend_stage( struct softpipe_context *softpipe,
+                                        struct quad_target *target )
 {
    struct blend_quad_stage *stage = CALLOC_STRUCT(blend_quad_stage);
 
@@ -1303,6 +1307,7 @@ struct quad_stage *sp_quad_blend_stage( struct softpipe_context *softpipe )
       return NULL;
 
    stage->base.softpipe = softpipe;
+   stage->base.target = target;
    stage->base.begin = blend_begin;
    stage->base.run = choose_blend_quad;
    stage->base.destroy = blend_destroy;
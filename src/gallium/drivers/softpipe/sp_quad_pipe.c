@@ -26,21 +26,59 @@
  **************************************************************************/
 
 
+#include "util/u_memory.h"
 #include "sp_context.h"
 #include "sp_state.h"
 #include "pipe/p_shader_tokens.h"
 
 
+/**
+ * Create the stages of a quad pipeline rendering into the given target.
+ */
+boolean
+sp_init_quad_pipeline(struct softpipe_context *sp,
+                      struct quad_pipeline *quad,
+                      struct quad_target *target)
+{
+   quad->shade = sp_quad_shade_stage(sp, target);
+   quad->depth_test = sp_quad_depth_test_stage(sp, target);
+   quad->blend = sp_quad_blend_stage(sp, target);
+   quad->pstipple = sp_quad_polygon_stipple_stage(sp);
+   quad->first = NULL;
+
+   return quad->shade && quad->depth_test && quad->blend && quad->pstipple;
+}
+
+
+void
+sp_destroy_quad_pipeline(struct quad_pipeline *quad)
+{
+   if (quad->shade)
+      quad->shade->destroy( quad->shade );
+
+   if (quad->depth_test)
+      quad->depth_test->destroy( quad->depth_test );
+
+   if (quad->blend)
+      quad->blend->destroy( quad->blend );
+
+   if (quad->pstipple)
+      quad->pstipple->destroy( quad->pstipple );
+
+   memset(quad, 0, sizeof *quad);
+}
+
+
 static void
-insert_stage_at_head(struct softpipe_context *sp, struct quad_stage *quad)
+insert_stage_at_head(struct quad_pipeline *quad, struct quad_stage *stage)
 {
-   quad->next = sp->quad.first;
-   sp->quad.first = quad;
+   stage->next = quad->first;
+   quad->first = stage;
 }
 
 
 void
-sp_build_quad_pipeline(struct softpipe_context *sp)
+sp_build_quad_pipeline(struct softpipe_context *sp, struct quad_pipeline *quad)
 {
    boolean early_depth_test =
       (sp->depth_stencil->depth.enabled &&
@@ -51,21 +89,20 @@ sp_build_quad_pipeline(struct softpipe_context *sp)
        !sp->fs_variant->info.writes_stencil) ||
       sp->fs_variant->info.properties[TGSI_PROPERTY_FS_EARLY_DEPTH_STENCIL];
 
-   sp->quad.first = sp->quad.blend;
+   quad->first = quad->blend;
 
    sp->early_depth = early_depth_test;
    if (early_depth_test) {
-      insert_stage_at_head( sp, sp->quad.shade );
-      insert_stage_at_head( sp, sp->quad.depth_test );
+      insert_stage_at_head( quad, quad->shade );
+      insert_stage_at_head( quad, quad->depth_test );
    }
    else {
-      insert_stage_at_head( sp, sp->quad.depth_test );
-      insert_stage_at_head( sp, sp->quad.shade );
+      insert_stage_at_head( quad, quad->depth_test );
+      insert_stage_at_head( quad, quad->shade );
    }
 
 #if !DO_PSTIPPLE_IN_DRAW_MODULE && !DO_PSTIPPLE_IN_HELPER_MODULE
    if (sp->rasterizer->poly_stipple_enable)
-      insert_stage_at_head( sp, sp->quad.pstipple );
+      insert_stage_at_head( quad, quad->pstipple );
 #endif
 }
-
@@ -31,11 +31,31 @@
 #ifndef SP_QUAD_PIPE_H
 #define SP_QUAD_PIPE_H
 
+#include "pipe/p_state.h"
+
 
 struct softpipe_context;
+struct softpipe_tile_cache;
+struct tgsi_exec_machine;
 struct quad_header;
 
 
+/**
+ * What a quad pipeline renders into: the framebuffer tile caches, the
+ * fragment shader interpreter and the counters it bumps.  The context's
+ * pipeline uses the context's caches; each rasterizer thread (see
+ * sp_rast.c) has a private set so that several pipelines can run at once.
+ */
+struct quad_target {
+   struct softpipe_tile_cache *cbuf_cache[PIPE_MAX_COLOR_BUFS];
+   struct softpipe_tile_cache *zsbuf_cache;
+   struct tgsi_exec_machine *fs_machine;
+
+   uint64_t *occlusion_count;
+   uint64_t *ps_invocations;
+};
+
+
 /**
  * Fragment processing is performed on 2x2 blocks of pixels called "quads".
  * Quad processing is performed with a pipeline of stages represented by
@@ -43,6 +63,7 @@ struct quad_header;
  */
 struct quad_stage {
    struct softpipe_context *softpipe;
+   struct quad_target *target;
 
    struct quad_stage *next;
 
@@ -55,18 +76,39 @@ struct quad_stage {
 };
 
 
+/**
+ * A full set of quad stages, plus the head of the currently active chain.
+ */
+struct quad_pipeline {
+   struct quad_stage *shade;
+   struct quad_stage *depth_test;
+   struct quad_stage *blend;
+   struct quad_stage *pstipple;
+   struct quad_stage *first; /**< points to one of the above stages */
+};
+
+
 struct quad_stage *sp_quad_polygon_stipple_stage( struct softpipe_context *softpipe );
 struct quad_stage *sp_quad_earlyz_stage( struct softpipe_context *softpipe );
-struct quad_stage *sp_quad_shade_stage( struct softpipe_context *softpipe );
+struct quad_stage *sp_quad_shade_stage( struct softpipe_context *softpipe,
+                                        struct quad_target *target );
 struct quad_stage *sp_quad_alpha_test_stage( struct softpipe_context *softpipe );
 struct quad_stage *sp_quad_stencil_test_stage( struct softpipe_context *softpipe );
-struct quad_stage *sp_quad_depth_test_stage( struct softpipe_context *softpipe );
+struct quad_stage *sp_quad_depth_test_stage( struct softpipe_context *softpipe,
+                                             struct quad_target *target );
 struct quad_stage *sp_quad_occlusion_stage( struct softpipe_context *softpipe );
 struct quad_stage *sp_quad_coverage_stage( struct softpipe_context *softpipe );
-struct quad_stage *sp_quad_blend_stage( struct softpipe_context *softpipe );
+struct quad_stage *sp_quad_blend_stage( struct softpipe_context *softpipe,
+                                        struct quad_target *target );
 struct quad_stage *sp_quad_colormask_stage( struct softpipe_context *softpipe );
 struct quad_stage *sp_quad_output_stage( struct softpipe_context *softpipe );
 
-void sp_build_quad_pipeline(struct softpipe_context *sp);
+boolean sp_init_quad_pipeline(struct softpipe_context *sp,
+                              struct quad_pipeline *quad,
+                              struct quad_target *target);
+void sp_destroy_quad_pipeline(struct quad_pipeline *quad);
+
+void sp_build_quad_pipeline(struct softpipe_context *sp,
+                            struct quad_pipeline *quad);
 
 #endif /* SP_QUAD_PIPE_H */
@@ -0,0 +1,695 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The Mesa Authors.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * Multithreaded fragment processing, see sp_rast.h.
+ *
+ * Every pixel belongs to exactly one thread, each thread processes its
+ * quad runs in the order setup produced them, and runs are never split
+ * (the depth test interpolates Z relative to the first quad of a run), so
+ * shading and depth results match the single-threaded path, provided the
+ * threads use the floating point state the primitives were set up with.
+ * Blending rounds dest colors to the surface format as it reads them (see
+ * sp_tile_cache_quantize_quad()), so when each thread's cache evicts a
+ * tile makes no difference either: the output is bit-exact.
+ */
+
+#include "os/os_thread.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "util/u_string.h"
+#include "util/u_thread.h"
+#include "tgsi/tgsi_exec.h"
+
+#include "sp_context.h"
+#include "sp_limits.h"
+#include "sp_quad.h"
+#include "sp_quad_pipe.h"
+#include "sp_rast.h"
+#include "sp_setup.h"
+#include "sp_state.h"
+#include "sp_tex_sample.h"
+#include "sp_tex_tile_cache.h"
+#include "sp_tile_cache.h"
+
+
+/** Bin sizes; a full bin makes all threads drain their bins early */
+#define SP_RAST_MAX_RUNS   4096
+#define SP_RAST_MAX_QUADS  8192
+#define SP_RAST_MAX_COEFS  (16 * 1024)
+
+
+/**
+ * A binned quad: everything setup put in the quad header.
+ */
+struct sp_rast_quad
+{
+   struct quad_header_input input;
+   unsigned mask;
+};
+
+
+/**
+ * A binned quad_stage::run() call.
+ */
+struct sp_rast_run
+{
+   unsigned coefs;   /**< index of posCoef in sp_rast::coefs */
+   unsigned first;   /**< index of the first quad in sp_rast_thread::quads */
+   unsigned nr;
+};
+
+
+struct sp_rast_thread
+{
+   struct sp_rast *rast;
+   unsigned index;
+
+   pipe_semaphore work_ready;
+   pipe_semaphore work_done;
+
+   /** Private quad pipeline and the state it renders into */
+   struct quad_pipeline quad;
+   struct quad_target target;
+   uint64_t occlusion_count;
+   uint64_t ps_invocations;
+
+   /** Private copy of the fragment sampler state, on private tex caches */
+   struct sp_tgsi_sampler *sampler;
+   struct softpipe_tex_tile_cache *tex_cache[PIPE_MAX_SHADER_SAMPLER_VIEWS];
+
+   struct sp_rast_run *runs;
+   unsigned num_runs;
+   struct sp_rast_quad *quads;
+   unsigned num_quads;
+
+   struct quad_header headers[MAX_QUADS];
+   struct quad_header *header_ptrs[MAX_QUADS];
+};
+
+
+struct sp_rast
+{
+   struct softpipe_context *softpipe;
+
+   unsigned num_threads;
+   struct sp_rast_thread *threads[SP_MAX_THREADS];
+   thrd_t thread_ids[SP_MAX_THREADS];
+   boolean exit_flag;
+
+   /** Have the threads' tile caches been used since they were flushed? */
+   boolean tiles_cached;
+
+   /** Floating point state the binned primitives were set up with */
+   unsigned fpstate;
+
+   /**
+    * Interpolation coefficients of the binned primitives, posCoef followed
+    * by num_inputs fragment shader input coefficients for each.
+    */
+   struct tgsi_interp_coef *coefs;
+   unsigned num_coefs;
+   unsigned cur_coefs;  /**< coefficients of the primitive being binned */
+   unsigned num_inputs;
+};
+
+
+static void
+rast_thread_run(struct sp_rast_thread *thread)
+{
+   const struct tgsi_interp_coef *coefs = thread->rast->coefs;
+   struct quad_stage *first = thread->quad.first;
+   unsigned i, j;
+
+   for (i = 0; i < thread->num_runs; i++) {
+      const struct sp_rast_run *run = &thread->runs[i];
+      const struct sp_rast_quad *in = &thread->quads[run->first];
+
+      for (j = 0; j < run->nr; j++) {
+         struct quad_header *quad = &thread->headers[j];
+
+         quad->input = in[j].input;
+         quad->inout.mask = in[j].mask;
+         quad->posCoef = &coefs[run->coefs];
+         quad->coef = &coefs[run->coefs + 1];
+
+         /* the stages compact this array in place */
+         thread->header_ptrs[j] = quad;
+      }
+
+      first->run(first, thread->header_ptrs, run->nr);
+   }
+}
+
+
+static int
+rast_thread_func(void *init_data)
+{
+   struct sp_rast_thread *thread = (struct sp_rast_thread *) init_data;
+   struct sp_rast *rast = thread->rast;
+   char thread_name[16];
+
+   snprintf(thread_name, sizeof thread_name, "softpipe-%u", thread->index);
+   u_thread_setname(thread_name);
+
+   while (1) {
+      pipe_semaphore_wait(&thread->work_ready);
+
+      if (rast->exit_flag)
+         break;
+
+      util_fpstate_set(rast->fpstate);
+      rast_thread_run(thread);
+
+      pipe_semaphore_signal(&thread->work_done);
+   }
+
+#ifdef _WIN32
+   pipe_semaphore_signal(&thread->work_done);
+#endif
+
+   return 0;
+}
+
+
+/**
+ * Have the threads process their bins and wait for them.  The
+ * coefficients of the primitive being binned are kept.
+ */
+static void
+rast_flush_bins(struct sp_rast *rast)
+{
+   struct softpipe_context *softpipe = rast->softpipe;
+   unsigned i;
+
+   for (i = 0; i < rast->num_threads; i++) {
+      if (rast->threads[i]->num_runs)
+         pipe_semaphore_signal(&rast->threads[i]->work_ready);
+   }
+
+   for (i = 0; i < rast->num_threads; i++) {
+      struct sp_rast_thread *thread = rast->threads[i];
+
+      if (!thread->num_runs)
+         continue;
+
+      pipe_semaphore_wait(&thread->work_done);
+
+      softpipe->occlusion_count += thread->occlusion_count;
+      softpipe->pipeline_statistics.ps_invocations += thread->ps_invocations;
+      thread->occlusion_count = 0;
+      thread->ps_invocations = 0;
+
+      thread->num_runs = 0;
+      thread->num_quads = 0;
+      rast->tiles_cached = TRUE;
+   }
+
+   if (rast->num_coefs) {
+      const unsigned n = 1 + rast->num_inputs;
+
+      memmove(rast->coefs, &rast->coefs[rast->cur_coefs],
+              n * sizeof rast->coefs[0]);
+      rast->cur_coefs = 0;
+      rast->num_coefs = n;
+   }
+}
+
+
+/**
+ * Point the thread's sampler at the context's fragment sampler views,
+ * going through private texture tile caches.
+ */
+static boolean
+rast_update_sampler(struct sp_rast *rast, struct sp_rast_thread *thread)
+{
+   struct softpipe_context *softpipe = rast->softpipe;
+   const struct sp_tgsi_sampler *src =
+      softpipe->tgsi.sampler[PIPE_SHADER_FRAGMENT];
+   struct sp_tgsi_sampler *dst = thread->sampler;
+   unsigned i;
+
+   memcpy(dst->sp_sampler, src->sp_sampler, sizeof dst->sp_sampler);
+
+   for (i = 0; i < softpipe->num_sampler_views[PIPE_SHADER_FRAGMENT]; i++) {
+      struct pipe_sampler_view *view =
+         softpipe->sampler_views[PIPE_SHADER_FRAGMENT][i];
+      struct softpipe_tex_tile_cache *tc;
+
+      dst->sp_sview[i] = src->sp_sview[i];
+      if (!view)
+         continue;
+
+      if (!thread->tex_cache[i]) {
+         thread->tex_cache[i] = sp_create_tex_tile_cache(&softpipe->pipe);
+         if (!thread->tex_cache[i])
+            return FALSE;
+      }
+
+      tc = thread->tex_cache[i];
+      sp_tex_tile_cache_set_sampler_view(tc, view);
+      if (tc->texture) {
+         struct softpipe_resource *spt = softpipe_resource(tc->texture);
+         if (spt->timestamp != tc->timestamp) {
+            sp_tex_tile_cache_validate_texture(tc);
+            tc->timestamp = spt->timestamp;
+         }
+      }
+
+      dst->sp_sview[i].cache = tc;
+   }
+
+   return TRUE;
+}
+
+
+/**
+ * Called by setup before binning primitives.
+ * \return FALSE if the current state must be rendered inline
+ */
+boolean
+sp_rast_begin(struct sp_rast *rast)
+{
+   struct softpipe_context *softpipe = rast->softpipe;
+   const struct sp_fragment_shader_variant *var = softpipe->fs_variant;
+   unsigned i;
+
+   assert(rast->num_coefs == 0);
+
+   /* Stores and atomics must happen in submission order. */
+   if (var->info.writes_memory)
+      goto inline_render;
+
+   for (i = 0; i < rast->num_threads; i++) {
+      if (!rast_update_sampler(rast, rast->threads[i]))
+         goto inline_render;
+   }
+
+   /* Hand the framebuffer over to the threads' tile caches.  Pending
+    * clears were recorded in those as well, see softpipe_clear().
+    */
+   for (i = 0; i < softpipe->framebuffer.nr_cbufs; i++)
+      sp_flush_tile_cache(softpipe->cbuf_cache[i]);
+   sp_flush_tile_cache(softpipe->zsbuf_cache);
+
+   rast->num_inputs = var->info.num_inputs;
+
+   for (i = 0; i < rast->num_threads; i++) {
+      struct sp_rast_thread *thread = rast->threads[i];
+      struct tgsi_exec_machine *machine = thread->target.fs_machine;
+
+      if (machine->Tokens != var->tokens) {
+         var->prepare(var, machine,
+                      (struct tgsi_sampler *) thread->sampler,
+                      (struct tgsi_image *)softpipe->tgsi.image[PIPE_SHADER_FRAGMENT],
+                      (struct tgsi_buffer *)softpipe->tgsi.buffer[PIPE_SHADER_FRAGMENT]);
+      }
+
+      sp_build_quad_pipeline(softpipe, &thread->quad);
+      thread->quad.first->begin(thread->quad.first);
+   }
+
+   return TRUE;
+
+inline_render:
+   sp_rast_flush_tile_caches(rast);
+   return FALSE;
+}
+
+
+/**
+ * Start a new primitive: save its coefficients for the quads binned
+ * after this.
+ */
+void
+sp_rast_set_coefs(struct sp_rast *rast,
+                  const struct tgsi_interp_coef *posCoef,
+                  const struct tgsi_interp_coef *coef)
+{
+   const unsigned n = 1 + rast->num_inputs;
+   const unsigned fpstate = util_fpstate_get();
+
+   /* Inline rendering would shade the primitive right away, under the
+    * floating point state of the draw (denormals are flushed to zero by
+    * draw_vbo()), so have the threads use that one.
+    */
+   if (fpstate != rast->fpstate) {
+      rast_flush_bins(rast);
+      rast->fpstate = fpstate;
+   }
+
+   if (rast->num_coefs + n > SP_RAST_MAX_COEFS)
+      rast_flush_bins(rast);
+
+   rast->cur_coefs = rast->num_coefs;
+   rast->coefs[rast->cur_coefs] = *posCoef;
+   memcpy(&rast->coefs[rast->cur_coefs + 1], coef,
+          rast->num_inputs * sizeof *coef);
+   rast->num_coefs += n;
+}
+
+
+/**
+ * Bin a quad_stage::run() call.  All quads of a run are on the same row,
+ * which is owned by a single thread.
+ */
+void
+sp_rast_bin_quads(struct sp_rast *rast,
+                  struct quad_header *quads[],
+                  unsigned nr)
+{
+   const int y = quads[0]->input.y0;
+   struct sp_rast_thread *thread =
+      rast->threads[(y / TILE_SIZE) % rast->num_threads];
+   struct sp_rast_run *run;
+   unsigned i;
+
+   assert(rast->num_coefs);
+   assert(nr <= MAX_QUADS);
+
+   if (thread->num_runs == SP_RAST_MAX_RUNS ||
+       thread->num_quads + nr > SP_RAST_MAX_QUADS)
+      rast_flush_bins(rast);
+
+   run = &thread->runs[thread->num_runs++];
+   run->coefs = rast->cur_coefs;
+   run->first = thread->num_quads;
+   run->nr = nr;
+
+   for (i = 0; i < nr; i++) {
+      struct sp_rast_quad *out = &thread->quads[thread->num_quads++];
+
+      assert(quads[i]->input.y0 == y);
+      out->input = quads[i]->input;
+      out->mask = quads[i]->inout.mask;
+   }
+}
+
+
+/**
+ * Process everything binned so far.
+ */
+void
+sp_rast_finish(struct sp_rast *rast)
+{
+   rast_flush_bins(rast);
+   rast->num_coefs = 0;
+}
+
+
+/**
+ * Write back the threads' framebuffer tiles.  Called wherever the
+ * context flushes its own tile caches.
+ */
+void
+sp_rast_flush_tile_caches(struct sp_rast *rast)
+{
+   unsigned i, j;
+
+   if (!rast->tiles_cached)
+      return;
+
+   for (i = 0; i < rast->num_threads; i++) {
+      struct sp_rast_thread *thread = rast->threads[i];
+
+      for (j = 0; j < PIPE_MAX_COLOR_BUFS; j++)
+         sp_flush_tile_cache(thread->target.cbuf_cache[j]);
+      sp_flush_tile_cache(thread->target.zsbuf_cache);
+   }
+
+   rast->tiles_cached = FALSE;
+}
+
+
+/**
+ * Record a clear of a whole color buffer in the threads' tile caches,
+ * each for the rows of tiles the thread owns.
+ */
+void
+sp_rast_clear_cbuf(struct sp_rast *rast, unsigned cbuf,
+                   const union pipe_color_union *color)
+{
+   unsigned i;
+
+   for (i = 0; i < rast->num_threads; i++) {
+      sp_tile_cache_clear_rows(rast->threads[i]->target.cbuf_cache[cbuf],
+                               color, 0, i, rast->num_threads);
+   }
+
+   rast->tiles_cached = TRUE;
+}
+
+
+void
+sp_rast_clear_zsbuf(struct sp_rast *rast, uint64_t clear_value)
+{
+   static const union pipe_color_union zero;
+   unsigned i;
+
+   for (i = 0; i < rast->num_threads; i++) {
+      sp_tile_cache_clear_rows(rast->threads[i]->target.zsbuf_cache, &zero,
+                               clear_value, i, rast->num_threads);
+   }
+
+   rast->tiles_cached = TRUE;
+}
+
+
+void
+sp_rast_flush_tex_caches(struct sp_rast *rast)
+{
+   unsigned i, j;
+
+   for (i = 0; i < rast->num_threads; i++) {
+      struct sp_rast_thread *thread = rast->threads[i];
+
+      for (j = 0; j < ARRAY_SIZE(thread->tex_cache); j++) {
+         if (thread->tex_cache[j])
+            sp_flush_tex_tile_cache(thread->tex_cache[j]);
+      }
+   }
+}
+
+
+static void
+rast_set_surface(struct softpipe_tile_cache *tc, struct pipe_surface *ps)
+{
+   if (sp_tile_cache_get_surface(tc) != ps) {
+      sp_flush_tile_cache(tc);
+      sp_tile_cache_set_surface(tc, ps);
+   }
+}
+
+
+void
+sp_rast_set_framebuffer(struct sp_rast *rast,
+                        const struct pipe_framebuffer_state *fb)
+{
+   unsigned i, j;
+
+   for (i = 0; i < rast->num_threads; i++) {
+      struct sp_rast_thread *thread = rast->threads[i];
+
+      for (j = 0; j < PIPE_MAX_COLOR_BUFS; j++) {
+         rast_set_surface(thread->target.cbuf_cache[j],
+                          j < fb->nr_cbufs ? fb->cbufs[j] : NULL);
+      }
+      rast_set_surface(thread->target.zsbuf_cache, fb->zsbuf);
+   }
+}
+
+
+/**
+ * Called before a fragment shader variant is deleted.
+ */
+void
+sp_rast_unbind_fs_variant(struct sp_rast *rast,
+                          const struct sp_fragment_shader_variant *var)
+{
+   unsigned i;
+
+   for (i = 0; i < rast->num_threads; i++) {
+      struct tgsi_exec_machine *machine = rast->threads[i]->target.fs_machine;
+
+      if (machine->Tokens == var->tokens)
+         tgsi_exec_machine_bind_shader(machine, NULL, NULL, NULL, NULL);
+   }
+}
+
+
+static void
+rast_thread_destroy(struct sp_rast_thread *thread)
+{
+   unsigned i;
+
+   sp_destroy_quad_pipeline(&thread->quad);
+
+   for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++)
+      sp_destroy_tile_cache(thread->target.cbuf_cache[i]);
+   sp_destroy_tile_cache(thread->target.zsbuf_cache);
+
+   for (i = 0; i < ARRAY_SIZE(thread->tex_cache); i++) {
+      if (thread->tex_cache[i]) {
+         sp_tex_tile_cache_set_sampler_view(thread->tex_cache[i], NULL);
+         sp_destroy_tex_tile_cache(thread->tex_cache[i]);
+      }
+   }
+
+   if (thread->target.fs_machine)
+      tgsi_exec_machine_destroy(thread->target.fs_machine);
+
+   FREE(thread->sampler);
+   FREE(thread->runs);
+   FREE(thread->quads);
+   FREE(thread);
+}
+
+
+static struct sp_rast_thread *
+rast_thread_create(struct sp_rast *rast, unsigned index)
+{
+   struct softpipe_context *softpipe = rast->softpipe;
+   struct sp_rast_thread *thread = CALLOC_STRUCT(sp_rast_thread);
+   unsigned i;
+
+   if (!thread)
+      return NULL;
+
+   thread->rast = rast;
+   thread->index = index;
+
+   for (i = 0; i < PIPE_MAX_COLOR_BUFS; i++) {
+      thread->target.cbuf_cache[i] = sp_create_tile_cache(&softpipe->pipe);
+      if (!thread->target.cbuf_cache[i])
+         goto fail;
+   }
+   thread->target.zsbuf_cache = sp_create_tile_cache(&softpipe->pipe);
+   thread->target.fs_machine = tgsi_exec_machine_create(PIPE_SHADER_FRAGMENT);
+   thread->target.occlusion_count = &thread->occlusion_count;
+   thread->target.ps_invocations = &thread->ps_invocations;
+   if (!thread->target.zsbuf_cache || !thread->target.fs_machine)
+      goto fail;
+
+   if (!sp_init_quad_pipeline(softpipe, &thread->quad, &thread->target))
+      goto fail;
+
+   thread->sampler = sp_create_tgsi_sampler();
+   thread->runs = MALLOC(SP_RAST_MAX_RUNS * sizeof *thread->runs);
+   thread->quads = MALLOC(SP_RAST_MAX_QUADS * sizeof *thread->quads);
+   if (!thread->sampler || !thread->runs || !thread->quads)
+      goto fail;
+
+   return thread;
+
+fail:
+   rast_thread_destroy(thread);
+   return NULL;
+}
+
+
+/**
+ * Create the rasterizer threads.
+ * \return NULL on failure, fragments are then processed inline
+ */
+struct sp_rast *
+sp_rast_create(struct softpipe_context *softpipe, unsigned num_threads)
+{
+   struct sp_rast *rast = CALLOC_STRUCT(sp_rast);
+   unsigned i;
+
+   if (!rast)
+      return NULL;
+
+   rast->softpipe = softpipe;
+   rast->coefs = MALLOC(SP_RAST_MAX_COEFS * sizeof *rast->coefs);
+   if (!rast->coefs) {
+      FREE(rast);
+      return NULL;
+   }
+
+   STATIC_ASSERT(SP_RAST_MAX_COEFS >= 2 * (1 + PIPE_MAX_SHADER_INPUTS));
+
+   num_threads = MIN2(num_threads, SP_MAX_THREADS);
+   for (i = 0; i < num_threads; i++) {
+      struct sp_rast_thread *thread = rast_thread_create(rast, i);
+      if (!thread)
+         break;
+
+      pipe_semaphore_init(&thread->work_ready, 0);
+      pipe_semaphore_init(&thread->work_done, 0);
+      rast->thread_ids[i] = u_thread_create(rast_thread_func, thread);
+      if (!rast->thread_ids[i]) {
+         pipe_semaphore_destroy(&thread->work_ready);
+         pipe_semaphore_destroy(&thread->work_done);
+         rast_thread_destroy(thread);
+         break;
+      }
+
+      rast->threads[i] = thread;
+      rast->num_threads = i + 1;
+   }
+
+   if (!rast->num_threads) {
+      sp_rast_destroy(rast);
+      return NULL;
+   }
+
+   return rast;
+}
+
+
+void
+sp_rast_destroy(struct sp_rast *rast)
+{
+   unsigned i;
+
+   if (!rast)
+      return;
+
+   /* Wake the threads up with exit_flag set so they leave their loop. */
+   rast->exit_flag = TRUE;
+   for (i = 0; i < rast->num_threads; i++) {
+      pipe_semaphore_signal(&rast->threads[i]->work_ready);
+   }
+
+   for (i = 0; i < rast->num_threads; i++) {
+#ifdef _WIN32
+      pipe_semaphore_wait(&rast->threads[i]->work_done);
+#else
+      thrd_join(rast->thread_ids[i], NULL);
+#endif
+   }
+
+   for (i = 0; i < rast->num_threads; i++) {
+      pipe_semaphore_destroy(&rast->threads[i]->work_ready);
+      pipe_semaphore_destroy(&rast->threads[i]->work_done);
+      rast_thread_destroy(rast->threads[i]);
+   }
+
+   FREE(rast->coefs);
+   FREE(rast);
+}
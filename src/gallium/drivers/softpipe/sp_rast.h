@@ -0,0 +1,96 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The Mesa Authors.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * Multithreaded fragment processing.
+ *
+ * The framebuffer is cut into rows of tiles and each row is owned by one
+ * rasterizer thread, which runs its own quad pipeline on its own tile
+ * caches.  Setup bins the quad runs it produces by row and the threads
+ * process the bins at the end of each vbuf draw.
+ */
+
+#ifndef SP_RAST_H
+#define SP_RAST_H
+
+#include "pipe/p_compiler.h"
+
+
+struct softpipe_context;
+struct sp_fragment_shader_variant;
+struct pipe_framebuffer_state;
+struct quad_header;
+struct tgsi_interp_coef;
+union pipe_color_union;
+struct sp_rast;
+
+
+struct sp_rast *
+sp_rast_create(struct softpipe_context *softpipe, unsigned num_threads);
+
+void
+sp_rast_destroy(struct sp_rast *rast);
+
+boolean
+sp_rast_begin(struct sp_rast *rast);
+
+void
+sp_rast_set_coefs(struct sp_rast *rast,
+                  const struct tgsi_interp_coef *posCoef,
+                  const struct tgsi_interp_coef *coef);
+
+void
+sp_rast_bin_quads(struct sp_rast *rast,
+                  struct quad_header *quads[],
+                  unsigned nr);
+
+void
+sp_rast_finish(struct sp_rast *rast);
+
+void
+sp_rast_flush_tile_caches(struct sp_rast *rast);
+
+void
+sp_rast_clear_cbuf(struct sp_rast *rast, unsigned cbuf,
+                   const union pipe_color_union *color);
+
+void
+sp_rast_clear_zsbuf(struct sp_rast *rast, uint64_t clear_value);
+
+void
+sp_rast_flush_tex_caches(struct sp_rast *rast);
+
+void
+sp_rast_set_framebuffer(struct sp_rast *rast,
+                        const struct pipe_framebuffer_state *fb);
+
+void
+sp_rast_unbind_fs_variant(struct sp_rast *rast,
+                          const struct sp_fragment_shader_variant *var);
+
+
+#endif /* SP_RAST_H */
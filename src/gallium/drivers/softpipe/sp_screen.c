@@ -40,6 +40,7 @@
 #include "frontend/sw_winsys.h"
 #include "tgsi/tgsi_exec.h"
 
+#include "sp_limits.h"
 #include "sp_texture.h"
 #include "sp_screen.h"
 #include "sp_context.h"
@@ -47,6 +48,7 @@
 #include "sp_public.h"
 
 DEBUG_GET_ONCE_BOOL_OPTION(use_llvm, "SOFTPIPE_USE_LLVM", FALSE)
+DEBUG_GET_ONCE_NUM_OPTION(num_threads, "SOFTPIPE_NUM_THREADS", 0)
 
 static const char *
 softpipe_get_vendor(struct pipe_screen *screen)
@@ -620,6 +622,7 @@ softpipe_create_screen(struct sw_winsys *winsys)
    screen->base.flush_frontbuffer = softpipe_flush_frontbuffer;
    screen->base.get_compute_param = softpipe_get_compute_param;
    screen->use_llvm = debug_get_option_use_llvm();
+   screen->num_threads = MIN2(debug_get_option_num_threads(), SP_MAX_THREADS);
 
    softpipe_init_screen_texture_funcs(&screen->base);
    softpipe_init_screen_fence_funcs(&screen->base);
@@ -47,6 +47,9 @@ struct softpipe_screen {
     */
    unsigned timestamp;
    boolean use_llvm;
+
+   /** Number of fragment processing threads, 0 to shade inline */
+   unsigned num_threads;
 };
 
 static inline struct softpipe_screen *
@@ -35,6 +35,7 @@
 #include "sp_context.h"
 #include "sp_quad.h"
 #include "sp_quad_pipe.h"
+#include "sp_rast.h"
 #include "sp_setup.h"
 #include "sp_state.h"
 #include "draw/draw_context.h"
@@ -59,14 +60,6 @@ struct edge {
 };
 
 
-/**
- * Max number of quads (2x2 pixel blocks) to process per batch.
- * This can't be arbitrarily increased since we depend on some 32-bit
- * bitmasks (two bits per quad).
- */
-#define MAX_QUADS 16
-
-
 /**
  * Triangle setup info.
  * Also used for line drawing (taking some liberties).
@@ -113,6 +106,9 @@ struct setup_context {
 
    unsigned cull_face;		/* which faces cull */
    unsigned nr_vertex_attrs;
+
+   boolean binning;       /**< quads go to the rasterizer threads */
+   boolean coefs_binned;  /**< coef/posCoef have been passed to them */
 };
 
 
@@ -153,6 +149,29 @@ quad_clip(struct setup_context *setup, struct quad_header *quad)
 }
 
 
+/**
+ * Pass a run of quads on the same row to the quad pipeline, or bin it
+ * for the rasterizer threads.
+ */
+static inline void
+emit_quads(struct setup_context *setup, struct quad_header *quads[],
+           unsigned nr)
+{
+   struct softpipe_context *sp = setup->softpipe;
+
+   if (setup->binning) {
+      if (!setup->coefs_binned) {
+         sp_rast_set_coefs(sp->rast, &setup->posCoef, setup->coef);
+         setup->coefs_binned = TRUE;
+      }
+      sp_rast_bin_quads(sp->rast, quads, nr);
+   }
+   else {
+      sp->quad.first->run( sp->quad.first, quads, nr );
+   }
+}
+
+
 /**
  * Emit a quad (pass to next stage) with clipping.
  */
@@ -162,13 +181,11 @@ clip_emit_quad(struct setup_context *setup, struct quad_header *quad)
    quad_clip(setup, quad);
 
    if (quad->inout.mask) {
-      struct softpipe_context *sp = setup->softpipe;
-
 #if DEBUG_FRAGS
       setup->numFragsEmitted += util_bitcount(quad->inout.mask);
 #endif
 
-      sp->quad.first->run( sp->quad.first, &quad, 1 );
+      emit_quads( setup, &quad, 1 );
    }
 }
 
@@ -203,7 +220,6 @@ flush_spans(struct setup_context *setup)
    const int xleft1 = setup->span.left[1];
    const int xright0 = setup->span.right[0];
    const int xright1 = setup->span.right[1];
-   struct quad_stage *pipe = setup->softpipe->quad.first;
 
    const int minleft = block_x(MIN2(xleft0, xleft1));
    const int maxright = MAX2(xright0, xright1);
@@ -248,7 +264,7 @@ flush_spans(struct setup_context *setup)
             lx += 2;
          } while (mask0 | mask1);
 
-         pipe->run( pipe, setup->quad_ptrs, q );
+         emit_quads( setup, setup->quad_ptrs, q );
       }
    }
 
@@ -593,6 +609,8 @@ setup_tri_coefficients(struct setup_context *setup)
 
    assert(sinfo->valid);
 
+   setup->coefs_binned = FALSE;
+
    /* z and w are done by linear interpolation:
     */
    v[0] = setup->vmin[0][2];
@@ -981,6 +999,8 @@ setup_line_coefficients(struct setup_context *setup,
       return FALSE;
    setup->oneoverarea = 1.0f / area;
 
+   setup->coefs_binned = FALSE;
+
    /* z and w are done by linear interpolation:
     */
    v[0] = setup->vmin[0][2];
@@ -1274,6 +1294,7 @@ sp_setup_point(struct setup_context *setup,
     * probably should be ruled out on that basis.
     */
    setup->vprovoke = v0;
+   setup->coefs_binned = FALSE;
 
    /* setup Z, W */
    const_coeff(setup, &setup->posCoef, 0, 2);
@@ -1479,6 +1500,9 @@ sp_setup_prepare(struct setup_context *setup)
 
    sp->quad.first->begin( sp->quad.first );
 
+   setup->binning = sp->rast && sp_rast_begin(sp->rast);
+   setup->coefs_binned = FALSE;
+
    if (sp->reduced_api_prim == PIPE_PRIM_TRIANGLES &&
        sp->rasterizer->fill_front == PIPE_POLYGON_MODE_FILL &&
        sp->rasterizer->fill_back == PIPE_POLYGON_MODE_FILL) {
@@ -1492,6 +1516,20 @@ sp_setup_prepare(struct setup_context *setup)
 }
 
 
+/**
+ * Called by vbuf code after a batch of primitives: have the rasterizer
+ * threads render what was binned.
+ */
+void
+sp_setup_flush(struct setup_context *setup)
+{
+   if (setup->binning) {
+      sp_rast_finish(setup->softpipe->rast);
+      setup->coefs_binned = FALSE;
+   }
+}
+
+
 void
 sp_setup_destroy_context(struct setup_context *setup)
 {
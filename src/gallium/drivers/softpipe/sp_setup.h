@@ -30,6 +30,13 @@
 struct setup_context;
 struct softpipe_context;
 
+/**
+ * Max number of quads (2x2 pixel blocks) to process per batch.
+ * This can't be arbitrarily increased since we depend on some 32-bit
+ * bitmasks (two bits per quad).
+ */
+#define MAX_QUADS 16
+
 /**
  * Attribute interpolation mode
  */
@@ -72,6 +79,7 @@ sp_clamp_viewport_idx(int idx)
 
 struct setup_context *sp_setup_create_context( struct softpipe_context *softpipe );
 void sp_setup_prepare( struct setup_context *setup );
+void sp_setup_flush( struct setup_context *setup );
 void sp_setup_destroy_context( struct setup_context *setup );
 
 #endif
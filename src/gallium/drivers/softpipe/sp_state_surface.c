@@ -29,6 +29,7 @@
  */
 
 #include "sp_context.h"
+#include "sp_rast.h"
 #include "sp_state.h"
 #include "sp_tile_cache.h"
 
@@ -92,6 +93,9 @@ softpipe_set_framebuffer_state(struct pipe_context *pipe,
                             sp->framebuffer.zsbuf->format : PIPE_FORMAT_NONE);
    }
 
+   if (sp->rast)
+      sp_rast_set_framebuffer(sp->rast, fb);
+
    sp->framebuffer.width = fb->width;
    sp->framebuffer.height = fb->height;
    sp->framebuffer.samples = fb->samples;
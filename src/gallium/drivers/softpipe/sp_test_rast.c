@@ -0,0 +1,335 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The Mesa Authors.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Threaded rasterizer test.
+ *
+ * Draws overlapping random triangles with depth testing and a few blend
+ * modes, once with fragment processing done inline, the default, and
+ * then on one and on several threads of sp_rast.c, and checks that each
+ * color buffer is bit for bit identical to the inline one.  The
+ * framebuffer has more tiles than a tile cache holds, so tiles get evicted
+ * and reloaded along the way, at different times for each thread count.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pipe/p_context.h"
+#include "pipe/p_defines.h"
+#include "pipe/p_screen.h"
+#include "pipe/p_state.h"
+#include "sw/null/null_sw_winsys.h"
+#include "util/format/u_format.h"
+#include "util/u_draw_quad.h"
+#include "util/u_inlines.h"
+#include "util/u_memory.h"
+#include "util/u_simple_shaders.h"
+
+#include "sp_public.h"
+#include "sp_screen.h"
+
+
+#define FB_WIDTH  512
+#define FB_HEIGHT 512
+
+#define NUM_TRIS  500
+#define NUM_DRAWS 10
+
+
+struct test_blend {
+   const char *name;
+   boolean enable;
+   enum pipe_blendfactor src;
+   enum pipe_blendfactor dst;
+};
+
+
+static const struct test_blend blends[] = {
+   { "none", FALSE, PIPE_BLENDFACTOR_ONE, PIPE_BLENDFACTOR_ZERO },
+   { "src_alpha", TRUE, PIPE_BLENDFACTOR_SRC_ALPHA,
+     PIPE_BLENDFACTOR_INV_SRC_ALPHA },
+   { "one_one", TRUE, PIPE_BLENDFACTOR_ONE, PIPE_BLENDFACTOR_ONE },
+   { "dst_color", TRUE, PIPE_BLENDFACTOR_DST_COLOR,
+     PIPE_BLENDFACTOR_SRC_COLOR },
+};
+
+
+/** Thread counts compared against inline fragment processing */
+static const unsigned thread_counts[] = { 1, 4 };
+
+
+static const enum pipe_format formats[] = {
+   PIPE_FORMAT_B8G8R8A8_UNORM,
+   PIPE_FORMAT_B5G6R5_UNORM,
+   PIPE_FORMAT_R16G16B16A16_FLOAT,
+};
+
+
+/**
+ * Make vertices for NUM_TRIS triangles: a position slightly larger than
+ * the viewport followed by a color with alpha in [0, 1].
+ */
+static float *
+make_vertices(void)
+{
+   float *verts = MALLOC(NUM_TRIS * 3 * 8 * sizeof(float));
+   unsigned i, j;
+
+   srand(1);
+   for (i = 0; i < NUM_TRIS * 3; i++) {
+      float *v = verts + i * 8;
+
+      for (j = 0; j < 8; j++)
+         v[j] = rand() / (float) RAND_MAX;
+
+      v[0] = v[0] * 2.4f - 1.2f;
+      v[1] = v[1] * 2.4f - 1.2f;
+      v[3] = 1.0f;
+   }
+
+   return verts;
+}
+
+
+/**
+ * Render the test scene and return a copy of the color buffer.
+ */
+static ubyte *
+render(struct pipe_screen *screen, unsigned num_threads,
+       enum pipe_format format, const struct test_blend *tb,
+       const float *verts)
+{
+   const enum tgsi_semantic semantic_names[2] = {
+      TGSI_SEMANTIC_POSITION, TGSI_SEMANTIC_GENERIC
+   };
+   const uint semantic_indexes[2] = { 0, 0 };
+   const unsigned verts_size = NUM_TRIS * 3 * 8 * sizeof(float);
+   const union pipe_color_union clear_color = {{ 0.1f, 0.2f, 0.3f, 0.4f }};
+   struct pipe_context *pipe;
+   struct pipe_resource templ, *cbuf, *zsbuf, *vbuf;
+   struct pipe_surface surf_templ, *cbuf_surf, *zsbuf_surf;
+   struct pipe_framebuffer_state fb;
+   struct pipe_blend_state blend;
+   struct pipe_depth_stencil_alpha_state dsa;
+   struct pipe_rasterizer_state rast;
+   struct pipe_viewport_state viewport;
+   struct pipe_vertex_element velems[2];
+   struct pipe_transfer *transfer;
+   void *blend_cso, *dsa_cso, *rast_cso, *velems_cso, *vs, *fs;
+   const ubyte *map;
+   ubyte *pixels;
+   unsigned row_size, y, i;
+
+   /* The rasterizer threads are created along with the context */
+   softpipe_screen(screen)->num_threads = num_threads;
+   pipe = screen->context_create(screen, NULL, 0);
+   if (!pipe)
+      return NULL;
+
+   memset(&templ, 0, sizeof templ);
+   templ.target = PIPE_TEXTURE_2D;
+   templ.format = format;
+   templ.width0 = FB_WIDTH;
+   templ.height0 = FB_HEIGHT;
+   templ.depth0 = 1;
+   templ.array_size = 1;
+   templ.bind = PIPE_BIND_RENDER_TARGET;
+   cbuf = screen->resource_create(screen, &templ);
+
+   templ.format = PIPE_FORMAT_Z24_UNORM_S8_UINT;
+   templ.bind = PIPE_BIND_DEPTH_STENCIL;
+   zsbuf = screen->resource_create(screen, &templ);
+
+   memset(&surf_templ, 0, sizeof surf_templ);
+   surf_templ.format = cbuf->format;
+   cbuf_surf = pipe->create_surface(pipe, cbuf, &surf_templ);
+   surf_templ.format = zsbuf->format;
+   zsbuf_surf = pipe->create_surface(pipe, zsbuf, &surf_templ);
+
+   memset(&fb, 0, sizeof fb);
+   fb.width = FB_WIDTH;
+   fb.height = FB_HEIGHT;
+   fb.nr_cbufs = 1;
+   fb.cbufs[0] = cbuf_surf;
+   fb.zsbuf = zsbuf_surf;
+   pipe->set_framebuffer_state(pipe, &fb);
+
+   memset(&blend, 0, sizeof blend);
+   blend.rt[0].colormask = PIPE_MASK_RGBA;
+   blend.rt[0].blend_enable = tb->enable;
+   blend.rt[0].rgb_func = PIPE_BLEND_ADD;
+   blend.rt[0].rgb_src_factor = tb->src;
+   blend.rt[0].rgb_dst_factor = tb->dst;
+   blend.rt[0].alpha_func = PIPE_BLEND_ADD;
+   blend.rt[0].alpha_src_factor = tb->src;
+   blend.rt[0].alpha_dst_factor = tb->dst;
+   blend_cso = pipe->create_blend_state(pipe, &blend);
+   pipe->bind_blend_state(pipe, blend_cso);
+
+   memset(&dsa, 0, sizeof dsa);
+   dsa.depth.enabled = 1;
+   dsa.depth.writemask = 1;
+   dsa.depth.func = PIPE_FUNC_LESS;
+   dsa_cso = pipe->create_depth_stencil_alpha_state(pipe, &dsa);
+   pipe->bind_depth_stencil_alpha_state(pipe, dsa_cso);
+
+   memset(&rast, 0, sizeof rast);
+   rast.half_pixel_center = 1;
+   rast.bottom_edge_rule = 1;
+   rast.depth_clip_near = 1;
+   rast.depth_clip_far = 1;
+   rast_cso = pipe->create_rasterizer_state(pipe, &rast);
+   pipe->bind_rasterizer_state(pipe, rast_cso);
+
+   memset(&viewport, 0, sizeof viewport);
+   viewport.scale[0] = FB_WIDTH / 2.0f;
+   viewport.scale[1] = FB_HEIGHT / 2.0f;
+   viewport.scale[2] = 0.5f;
+   viewport.translate[0] = FB_WIDTH / 2.0f;
+   viewport.translate[1] = FB_HEIGHT / 2.0f;
+   viewport.translate[2] = 0.5f;
+   viewport.swizzle_x = PIPE_VIEWPORT_SWIZZLE_POSITIVE_X;
+   viewport.swizzle_y = PIPE_VIEWPORT_SWIZZLE_POSITIVE_Y;
+   viewport.swizzle_z = PIPE_VIEWPORT_SWIZZLE_POSITIVE_Z;
+   viewport.swizzle_w = PIPE_VIEWPORT_SWIZZLE_POSITIVE_W;
+   pipe->set_viewport_states(pipe, 0, 1, &viewport);
+
+   memset(velems, 0, sizeof velems);
+   velems[0].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+   velems[1].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+   velems[1].src_offset = 4 * sizeof(float);
+   velems_cso = pipe->create_vertex_elements_state(pipe, 2, velems);
+   pipe->bind_vertex_elements_state(pipe, velems_cso);
+
+   vs = util_make_vertex_passthrough_shader(pipe, 2, semantic_names,
+                                            semantic_indexes, FALSE);
+   pipe->bind_vs_state(pipe, vs);
+   fs = util_make_fragment_passthrough_shader(pipe, TGSI_SEMANTIC_GENERIC,
+                                              TGSI_INTERPOLATE_PERSPECTIVE,
+                                              FALSE);
+   pipe->bind_fs_state(pipe, fs);
+
+   vbuf = pipe_buffer_create(screen, PIPE_BIND_VERTEX_BUFFER,
+                             PIPE_USAGE_DEFAULT, verts_size);
+   pipe_buffer_write(pipe, vbuf, 0, verts_size, verts);
+
+   pipe->clear(pipe, PIPE_CLEAR_COLOR | PIPE_CLEAR_DEPTHSTENCIL, NULL,
+               &clear_color, 1.0, 0);
+
+   /* Several draws, so that the threads see more than one bin */
+   for (i = 0; i < NUM_DRAWS; i++) {
+      const unsigned num_verts = NUM_TRIS / NUM_DRAWS * 3;
+
+      util_draw_vertex_buffer(pipe, NULL, vbuf, 0,
+                              i * num_verts * 8 * sizeof(float),
+                              PIPE_PRIM_TRIANGLES, num_verts, 2);
+   }
+   pipe->flush(pipe, NULL, 0);
+
+   row_size = util_format_get_stride(format, FB_WIDTH);
+   pixels = MALLOC(row_size * FB_HEIGHT);
+   map = pipe_transfer_map(pipe, cbuf, 0, 0, PIPE_TRANSFER_READ,
+                           0, 0, FB_WIDTH, FB_HEIGHT, &transfer);
+   for (y = 0; y < FB_HEIGHT; y++)
+      memcpy(pixels + y * row_size, map + y * transfer->stride, row_size);
+   pipe->transfer_unmap(pipe, transfer);
+
+   pipe->bind_vs_state(pipe, NULL);
+   pipe->delete_vs_state(pipe, vs);
+   pipe->bind_fs_state(pipe, NULL);
+   pipe->delete_fs_state(pipe, fs);
+   pipe->delete_vertex_elements_state(pipe, velems_cso);
+   pipe->delete_rasterizer_state(pipe, rast_cso);
+   pipe->delete_depth_stencil_alpha_state(pipe, dsa_cso);
+   pipe->delete_blend_state(pipe, blend_cso);
+   pipe_surface_reference(&cbuf_surf, NULL);
+   pipe_surface_reference(&zsbuf_surf, NULL);
+   pipe_resource_reference(&vbuf, NULL);
+   pipe_resource_reference(&cbuf, NULL);
+   pipe_resource_reference(&zsbuf, NULL);
+   pipe->destroy(pipe);
+
+   return pixels;
+}
+
+
+int main(void)
+{
+   struct pipe_screen *screen;
+   float *verts;
+   unsigned f, b, t;
+   int ret = 0;
+
+   screen = softpipe_create_screen(null_sw_create());
+   if (!screen) {
+      fprintf(stderr, "failed to create softpipe screen\n");
+      return 1;
+   }
+
+   verts = make_vertices();
+
+   for (f = 0; f < ARRAY_SIZE(formats); f++) {
+      const size_t size =
+         util_format_get_stride(formats[f], FB_WIDTH) * FB_HEIGHT;
+
+      for (b = 0; b < ARRAY_SIZE(blends); b++) {
+         ubyte *inline_pixels;
+
+         inline_pixels = render(screen, 0, formats[f], &blends[b], verts);
+
+         for (t = 0; t < ARRAY_SIZE(thread_counts); t++) {
+            ubyte *threaded_pixels;
+            boolean pass;
+
+            threaded_pixels = render(screen, thread_counts[t], formats[f],
+                                     &blends[b], verts);
+
+            pass = inline_pixels && threaded_pixels &&
+                   memcmp(inline_pixels, threaded_pixels, size) == 0;
+
+            printf("%s: %s blend, %u threads %s\n",
+                   util_format_short_name(formats[f]), blends[b].name,
+                   thread_counts[t], pass ? "PASS" : "FAIL");
+            if (!pass)
+               ret = 1;
+
+            FREE(threaded_pixels);
+         }
+
+         FREE(inline_pixels);
+      }
+   }
+
+   FREE(verts);
+   screen->destroy(screen);
+
+   return ret;
+}
@@ -0,0 +1,376 @@
+/**************************************************************************
+ *
+ * Copyright 2026 The Mesa Authors.
+ * All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ **************************************************************************/
+
+/**
+ * @file
+ * Fragment shader interpreter benchmark.
+ *
+ * Renders random depth tested triangles with a few small, piglit style
+ * fragment shaders and reports the best time of several runs for each,
+ * along with a checksum of the color buffer, so that timings and images
+ * of two builds of tgsi_exec can be compared.
+ *
+ * Usage: sp_test_shaders [triangles [frames [runs]]]
+ *
+ * The defaults, 3000 triangles and 5 frames, are what the pre-decoded
+ * ALU ops in tgsi_exec.c were measured with, using the alu shader.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pipe/p_context.h"
+#include "pipe/p_defines.h"
+#include "pipe/p_screen.h"
+#include "pipe/p_state.h"
+#include "sw/null/null_sw_winsys.h"
+#include "tgsi/tgsi_text.h"
+#include "util/os_time.h"
+#include "util/u_draw_quad.h"
+#include "util/u_inlines.h"
+#include "util/u_memory.h"
+#include "util/u_simple_shaders.h"
+
+#include "sp_public.h"
+
+
+#define FB_WIDTH  512
+#define FB_HEIGHT 512
+
+#define NUM_DRAWS 10
+
+
+struct test_shader {
+   const char *name;
+   const char *text;
+};
+
+
+static const struct test_shader shaders[] = {
+   {
+      "passthrough",
+      "FRAG\n"
+      "DCL IN[0], GENERIC[0], PERSPECTIVE\n"
+      "DCL OUT[0], COLOR\n"
+      "MOV OUT[0], IN[0]\n"
+      "END\n"
+   },
+   {
+      /* Only ALU instructions the pre-decoded ops handle */
+      "alu",
+      "FRAG\n"
+      "DCL IN[0], GENERIC[0], PERSPECTIVE\n"
+      "DCL OUT[0], COLOR\n"
+      "DCL CONST[0][0..1]\n"
+      "DCL TEMP[0..3]\n"
+      "IMM[0] FLT32 { 0.5, 0.25, 2.0, 1.0 }\n"
+      "MOV TEMP[0], IN[0]\n"
+      "MUL TEMP[1], TEMP[0], IMM[0].xyzw\n"
+      "MAD TEMP[2], TEMP[1], IMM[0].zzzz, -TEMP[0]\n"
+      "ADD TEMP[3], TEMP[2], CONST[0][0]\n"
+      "DP3 TEMP[1].x, TEMP[3], TEMP[0]\n"
+      "DP4 TEMP[1].y, TEMP[2], TEMP[3]\n"
+      "LRP TEMP[2], TEMP[1].xxxx, TEMP[0], TEMP[3]\n"
+      "FRC TEMP[3], TEMP[2]\n"
+      "MAX TEMP[0], TEMP[3], |TEMP[1]|\n"
+      "MIN TEMP[0], TEMP[0], IMM[0].wwww\n"
+      "MAD TEMP[1], TEMP[0], TEMP[0], TEMP[2]\n"
+      "MUL TEMP[2], TEMP[1], CONST[0][1]\n"
+      "SLT TEMP[3], TEMP[2], IMM[0].xxxx\n"
+      "LRP TEMP[0], TEMP[3], TEMP[0], TEMP[1]\n"
+      "DP3 TEMP[1].x, TEMP[0], TEMP[2]\n"
+      "ADD TEMP[0].xyz, TEMP[0], TEMP[1].xxxx\n"
+      "FRC TEMP[0], TEMP[0]\n"
+      "MUL TEMP[1], TEMP[0], IMM[0].yyyy\n"
+      "MAD TEMP[0], TEMP[1], IMM[0].zzzz, TEMP[0]\n"
+      "MIN OUT[0], TEMP[0], IMM[0].wwww\n"
+      "END\n"
+   },
+   {
+      /* ALU runs between control flow, without a kill so early Z stays on */
+      "branch",
+      "FRAG\n"
+      "DCL IN[0], GENERIC[0], PERSPECTIVE\n"
+      "DCL OUT[0], COLOR\n"
+      "DCL TEMP[0..2]\n"
+      "IMM[0] FLT32 { 0.5, 0.25, 2.0, 1.0 }\n"
+      "SLT TEMP[0].x, IN[0].xxxx, IMM[0].xxxx\n"
+      "IF TEMP[0].xxxx\n"
+      "  MUL TEMP[1], IN[0], IMM[0].zzzz\n"
+      "  ADD TEMP[1], TEMP[1], -IMM[0].yyyy\n"
+      "ELSE\n"
+      "  MAD TEMP[1], IN[0], IMM[0].xxxx, IMM[0].yyyy\n"
+      "  DP3 TEMP[2].x, TEMP[1], TEMP[1]\n"
+      "  MUL TEMP[1].xyz, TEMP[1], TEMP[2].xxxx\n"
+      "ENDIF\n"
+      "MOV OUT[0], TEMP[1]\n"
+      "END\n"
+   },
+};
+
+
+/**
+ * Make vertices for num_tris triangles: a position slightly larger than
+ * the viewport followed by a color.
+ */
+static float *
+make_vertices(unsigned num_tris)
+{
+   float *verts = MALLOC(num_tris * 3 * 8 * sizeof(float));
+   unsigned i, j;
+
+   srand(1);
+   for (i = 0; i < num_tris * 3; i++) {
+      float *v = verts + i * 8;
+
+      for (j = 0; j < 8; j++)
+         v[j] = rand() / (float) RAND_MAX;
+
+      v[0] = v[0] * 2.4f - 1.2f;
+      v[1] = v[1] * 2.4f - 1.2f;
+      v[3] = 0.5f + v[3];
+   }
+
+   return verts;
+}
+
+
+/**
+ * FNV-1a hash of the color buffer.
+ */
+static uint64_t
+checksum(struct pipe_context *pipe, struct pipe_resource *cbuf)
+{
+   struct pipe_transfer *transfer;
+   const ubyte *map;
+   uint64_t hash = 0xcbf29ce484222325ull;
+   unsigned x, y;
+
+   map = pipe_transfer_map(pipe, cbuf, 0, 0, PIPE_TRANSFER_READ,
+                           0, 0, FB_WIDTH, FB_HEIGHT, &transfer);
+   for (y = 0; y < FB_HEIGHT; y++) {
+      for (x = 0; x < FB_WIDTH * 4; x++) {
+         hash ^= map[y * transfer->stride + x];
+         hash *= 0x100000001b3ull;
+      }
+   }
+   pipe->transfer_unmap(pipe, transfer);
+
+   return hash;
+}
+
+
+int main(int argc, char **argv)
+{
+   static const float consts[8] = {
+      0.1f, 0.3f, -0.2f, 0.4f,
+      1.5f, 0.7f, 0.9f, 1.1f
+   };
+   const enum tgsi_semantic semantic_names[2] = {
+      TGSI_SEMANTIC_POSITION, TGSI_SEMANTIC_GENERIC
+   };
+   const uint semantic_indexes[2] = { 0, 0 };
+   const union pipe_color_union clear_color = {{ 0.1f, 0.2f, 0.3f, 1.0f }};
+   unsigned num_tris = 3000, num_frames = 5, num_runs = 3;
+   unsigned verts_size, s, run, frame, i;
+   struct pipe_screen *screen;
+   struct pipe_context *pipe;
+   struct pipe_resource templ, *cbuf, *zsbuf, *vbuf;
+   struct pipe_surface surf_templ, *cbuf_surf, *zsbuf_surf;
+   struct pipe_framebuffer_state fb;
+   struct pipe_blend_state blend;
+   struct pipe_depth_stencil_alpha_state dsa;
+   struct pipe_rasterizer_state rast;
+   struct pipe_viewport_state viewport;
+   struct pipe_vertex_element velems[2];
+   struct pipe_constant_buffer constbuf;
+   void *blend_cso, *dsa_cso, *rast_cso, *velems_cso, *vs;
+   float *verts;
+
+   if (argc > 1)
+      num_tris = MAX2(atoi(argv[1]), NUM_DRAWS);
+   if (argc > 2)
+      num_frames = MAX2(atoi(argv[2]), 1);
+   if (argc > 3)
+      num_runs = MAX2(atoi(argv[3]), 1);
+   num_tris -= num_tris % NUM_DRAWS;
+   verts_size = num_tris * 3 * 8 * sizeof(float);
+
+   screen = softpipe_create_screen(null_sw_create());
+   if (!screen) {
+      fprintf(stderr, "failed to create softpipe screen\n");
+      return 1;
+   }
+   pipe = screen->context_create(screen, NULL, 0);
+
+   memset(&templ, 0, sizeof templ);
+   templ.target = PIPE_TEXTURE_2D;
+   templ.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+   templ.width0 = FB_WIDTH;
+   templ.height0 = FB_HEIGHT;
+   templ.depth0 = 1;
+   templ.array_size = 1;
+   templ.bind = PIPE_BIND_RENDER_TARGET;
+   cbuf = screen->resource_create(screen, &templ);
+
+   templ.format = PIPE_FORMAT_Z24_UNORM_S8_UINT;
+   templ.bind = PIPE_BIND_DEPTH_STENCIL;
+   zsbuf = screen->resource_create(screen, &templ);
+
+   memset(&surf_templ, 0, sizeof surf_templ);
+   surf_templ.format = cbuf->format;
+   cbuf_surf = pipe->create_surface(pipe, cbuf, &surf_templ);
+   surf_templ.format = zsbuf->format;
+   zsbuf_surf = pipe->create_surface(pipe, zsbuf, &surf_templ);
+
+   memset(&fb, 0, sizeof fb);
+   fb.width = FB_WIDTH;
+   fb.height = FB_HEIGHT;
+   fb.nr_cbufs = 1;
+   fb.cbufs[0] = cbuf_surf;
+   fb.zsbuf = zsbuf_surf;
+   pipe->set_framebuffer_state(pipe, &fb);
+
+   memset(&blend, 0, sizeof blend);
+   blend.rt[0].colormask = PIPE_MASK_RGBA;
+   blend_cso = pipe->create_blend_state(pipe, &blend);
+   pipe->bind_blend_state(pipe, blend_cso);
+
+   memset(&dsa, 0, sizeof dsa);
+   dsa.depth.enabled = 1;
+   dsa.depth.writemask = 1;
+   dsa.depth.func = PIPE_FUNC_LESS;
+   dsa_cso = pipe->create_depth_stencil_alpha_state(pipe, &dsa);
+   pipe->bind_depth_stencil_alpha_state(pipe, dsa_cso);
+
+   memset(&rast, 0, sizeof rast);
+   rast.half_pixel_center = 1;
+   rast.bottom_edge_rule = 1;
+   rast.depth_clip_near = 1;
+   rast.depth_clip_far = 1;
+   rast_cso = pipe->create_rasterizer_state(pipe, &rast);
+   pipe->bind_rasterizer_state(pipe, rast_cso);
+
+   memset(&viewport, 0, sizeof viewport);
+   viewport.scale[0] = FB_WIDTH / 2.0f;
+   viewport.scale[1] = FB_HEIGHT / 2.0f;
+   viewport.scale[2] = 0.5f;
+   viewport.translate[0] = FB_WIDTH / 2.0f;
+   viewport.translate[1] = FB_HEIGHT / 2.0f;
+   viewport.translate[2] = 0.5f;
+   viewport.swizzle_x = PIPE_VIEWPORT_SWIZZLE_POSITIVE_X;
+   viewport.swizzle_y = PIPE_VIEWPORT_SWIZZLE_POSITIVE_Y;
+   viewport.swizzle_z = PIPE_VIEWPORT_SWIZZLE_POSITIVE_Z;
+   viewport.swizzle_w = PIPE_VIEWPORT_SWIZZLE_POSITIVE_W;
+   pipe->set_viewport_states(pipe, 0, 1, &viewport);
+
+   memset(velems, 0, sizeof velems);
+   velems[0].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+   velems[1].src_format = PIPE_FORMAT_R32G32B32A32_FLOAT;
+   velems[1].src_offset = 4 * sizeof(float);
+   velems_cso = pipe->create_vertex_elements_state(pipe, 2, velems);
+   pipe->bind_vertex_elements_state(pipe, velems_cso);
+
+   vs = util_make_vertex_passthrough_shader(pipe, 2, semantic_names,
+                                            semantic_indexes, FALSE);
+   pipe->bind_vs_state(pipe, vs);
+
+   memset(&constbuf, 0, sizeof constbuf);
+   constbuf.user_buffer = consts;
+   constbuf.buffer_size = sizeof consts;
+   pipe->set_constant_buffer(pipe, PIPE_SHADER_FRAGMENT, 0, &constbuf);
+
+   verts = make_vertices(num_tris);
+   vbuf = pipe_buffer_create(screen, PIPE_BIND_VERTEX_BUFFER,
+                             PIPE_USAGE_DEFAULT, verts_size);
+   pipe_buffer_write(pipe, vbuf, 0, verts_size, verts);
+
+   printf("%u triangles, %u frames, best of %u runs\n",
+          num_tris, num_frames, num_runs);
+
+   for (s = 0; s < ARRAY_SIZE(shaders); s++) {
+      struct tgsi_token tokens[1024];
+      struct pipe_shader_state state;
+      int64_t best = INT64_MAX;
+      void *fs;
+
+      if (!tgsi_text_translate(shaders[s].text, tokens,
+                               ARRAY_SIZE(tokens))) {
+         fprintf(stderr, "failed to translate the %s shader\n",
+                 shaders[s].name);
+         return 1;
+      }
+      pipe_shader_state_from_tgsi(&state, tokens);
+      fs = pipe->create_fs_state(pipe, &state);
+      pipe->bind_fs_state(pipe, fs);
+
+      for (run = 0; run < num_runs; run++) {
+         const int64_t start = os_time_get_nano();
+
+         for (frame = 0; frame < num_frames; frame++) {
+            pipe->clear(pipe, PIPE_CLEAR_COLOR | PIPE_CLEAR_DEPTHSTENCIL,
+                        NULL, &clear_color, 1.0, 0);
+
+            for (i = 0; i < NUM_DRAWS; i++) {
+               const unsigned num_verts = num_tris / NUM_DRAWS * 3;
+
+               util_draw_vertex_buffer(pipe, NULL, vbuf, 0,
+                                       i * num_verts * 8 * sizeof(float),
+                                       PIPE_PRIM_TRIANGLES, num_verts, 2);
+            }
+            pipe->flush(pipe, NULL, 0);
+         }
+
+         best = MIN2(best, os_time_get_nano() - start);
+      }
+
+      printf("%-12s %8.3f s  checksum %016llx\n", shaders[s].name,
+             best * 1e-9, (unsigned long long) checksum(pipe, cbuf));
+
+      pipe->bind_fs_state(pipe, NULL);
+      pipe->delete_fs_state(pipe, fs);
+   }
+
+   pipe->bind_vs_state(pipe, NULL);
+   pipe->delete_vs_state(pipe, vs);
+   pipe->delete_vertex_elements_state(pipe, velems_cso);
+   pipe->delete_rasterizer_state(pipe, rast_cso);
+   pipe->delete_depth_stencil_alpha_state(pipe, dsa_cso);
+   pipe->delete_blend_state(pipe, blend_cso);
+   pipe_surface_reference(&cbuf_surf, NULL);
+   pipe_surface_reference(&zsbuf_surf, NULL);
+   pipe_resource_reference(&vbuf, NULL);
+   pipe_resource_reference(&cbuf, NULL);
+   pipe_resource_reference(&zsbuf, NULL);
+   pipe->destroy(pipe);
+   screen->destroy(screen);
+   FREE(verts);
+
+   return 0;
+}
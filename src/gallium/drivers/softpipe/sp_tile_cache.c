@@ -34,6 +34,7 @@
 
 #include "util/u_inlines.h"
 #include "util/format/u_format.h"
+#include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/u_tile.h"
 #include "sp_tile_cache.h"
@@ -214,6 +215,9 @@ sp_tile_cache_set_surface(struct softpipe_tile_cache *tc,
       }
 
       tc->depth_stencil = util_format_is_depth_or_stencil(ps->format);
+      tc->quantize_color = !tc->depth_stencil &&
+                           !util_format_is_pure_integer(ps->format) &&
+                           ps->format != PIPE_FORMAT_R32G32B32A32_FLOAT;
    }
 }
 
@@ -228,6 +232,51 @@ sp_tile_cache_get_surface(struct softpipe_tile_cache *tc)
 }
 
 
+/**
+ * Round a quad's worth of dest colors (SoA, as used by blending) to the
+ * precision of the surface format.
+ *
+ * Cached tiles keep colors as floats and only convert them to the surface
+ * format when a tile is flushed, so without this a blend would see more
+ * or less precise dest colors depending on whether the tile had been
+ * evicted since the last write.  Rounding on every read makes blending
+ * independent of cache behaviour, which lets the threaded rasterizer,
+ * with its per-thread caches, match the single-threaded path exactly.
+ */
+void
+sp_tile_cache_quantize_quad(const struct softpipe_tile_cache *tc,
+                            float colors[4][TGSI_QUAD_SIZE])
+{
+   float rgba[2][2][4];
+   uint64_t packed[2 * 2 * 16 / sizeof(uint64_t)];
+   const enum pipe_format format = tc->surface->format;
+   const unsigned packed_stride = 2 * util_format_get_blocksize(format);
+   uint i, j;
+
+   if (!tc->quantize_color)
+      return;
+
+   assert(util_format_get_blocksize(format) <= 16);
+
+   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+      for (i = 0; i < 4; i++) {
+         rgba[j >> 1][j & 1][i] = colors[i][j];
+      }
+   }
+
+   util_format_write_4f(format, &rgba[0][0][0], sizeof rgba[0],
+                        packed, packed_stride, 0, 0, 2, 2);
+   util_format_read_4f(format, &rgba[0][0][0], sizeof rgba[0],
+                       packed, packed_stride, 0, 0, 2, 2);
+
+   for (j = 0; j < TGSI_QUAD_SIZE; j++) {
+      for (i = 0; i < 4; i++) {
+         colors[i][j] = rgba[j >> 1][j & 1][i];
+      }
+   }
+}
+
+
 /**
  * Set pixels in a tile to the given clear color/value, float.
  */
@@ -333,6 +382,44 @@ clear_tile(struct softpipe_cached_tile *tile,
 }
 
 
+/**
+ * Write a color tile to the surface.
+ *
+ * Some conversions, e.g. to half floats, depend on whether denormals are
+ * flushed to zero.  Always convert like the draw module renders, so the
+ * result doesn't depend on when or on which thread the tile is flushed.
+ */
+static void
+put_tile_rgba(struct softpipe_tile_cache *tc, int layer,
+              uint x, uint y, const float *colors)
+{
+   const unsigned fpstate = util_fpstate_get();
+
+   util_fpstate_set_denorms_to_zero(fpstate);
+   pipe_put_tile_rgba(tc->transfer[layer], tc->transfer_map[layer],
+                      x, y, TILE_SIZE, TILE_SIZE,
+                      tc->surface->format, colors);
+   util_fpstate_set(fpstate);
+}
+
+
+/**
+ * Read a color tile from the surface, see put_tile_rgba().
+ */
+static void
+get_tile_rgba(struct softpipe_tile_cache *tc, int layer,
+              uint x, uint y, float *colors)
+{
+   const unsigned fpstate = util_fpstate_get();
+
+   util_fpstate_set_denorms_to_zero(fpstate);
+   pipe_get_tile_rgba(tc->transfer[layer], tc->transfer_map[layer],
+                      x, y, TILE_SIZE, TILE_SIZE,
+                      tc->surface->format, colors);
+   util_fpstate_set(fpstate);
+}
+
+
 /**
  * Actually clear the tiles which were flagged as being in a clear state.
  */
@@ -367,10 +454,7 @@ sp_tile_cache_flush_clear(struct softpipe_tile_cache *tc, int layer)
                                  tc->tile->data.any, 0/*STRIDE*/);
             }
             else {
-               pipe_put_tile_rgba(pt, tc->transfer_map[layer],
-                                  x, y, TILE_SIZE, TILE_SIZE,
-                                  tc->surface->format,
-                                  tc->tile->data.color);
+               put_tile_rgba(tc, layer, x, y, &tc->tile->data.color[0][0][0]);
             }
             numCleared++;
          }
@@ -396,12 +480,10 @@ sp_flush_tile(struct softpipe_tile_cache* tc, unsigned pos)
                            tc->entries[pos]->data.depth32, 0/*STRIDE*/);
       }
       else {
-         pipe_put_tile_rgba(tc->transfer[layer], tc->transfer_map[layer],
-                            tc->tile_addrs[pos].bits.x * TILE_SIZE,
-                            tc->tile_addrs[pos].bits.y * TILE_SIZE,
-                            TILE_SIZE, TILE_SIZE,
-                            tc->surface->format,
-                            tc->entries[pos]->data.color);
+         put_tile_rgba(tc, layer,
+                       tc->tile_addrs[pos].bits.x * TILE_SIZE,
+                       tc->tile_addrs[pos].bits.y * TILE_SIZE,
+                       &tc->entries[pos]->data.color[0][0][0]);
       }
       tc->tile_addrs[pos].bits.invalid = 1;  /* mark as empty */
    }
@@ -510,12 +592,10 @@ sp_find_cached_tile(struct softpipe_tile_cache *tc,
                               tile->data.depth32, 0/*STRIDE*/);
          }
          else {
-            pipe_put_tile_rgba(tc->transfer[layer], tc->transfer_map[layer],
-                               tc->tile_addrs[pos].bits.x * TILE_SIZE,
-                               tc->tile_addrs[pos].bits.y * TILE_SIZE,
-                               TILE_SIZE, TILE_SIZE,
-                               tc->surface->format,
-                               tile->data.color);
+            put_tile_rgba(tc, layer,
+                          tc->tile_addrs[pos].bits.x * TILE_SIZE,
+                          tc->tile_addrs[pos].bits.y * TILE_SIZE,
+                          &tile->data.color[0][0][0]);
          }
       }
 
@@ -545,12 +625,10 @@ sp_find_cached_tile(struct softpipe_tile_cache *tc,
                               tile->data.depth32, 0/*STRIDE*/);
          }
          else {
-            pipe_get_tile_rgba(tc->transfer[layer], tc->transfer_map[layer],
-                               tc->tile_addrs[pos].bits.x * TILE_SIZE,
-                               tc->tile_addrs[pos].bits.y * TILE_SIZE,
-                               TILE_SIZE, TILE_SIZE,
-                               tc->surface->format,
-                               tile->data.color);
+            get_tile_rgba(tc, layer,
+                          tc->tile_addrs[pos].bits.x * TILE_SIZE,
+                          tc->tile_addrs[pos].bits.y * TILE_SIZE,
+                          &tile->data.color[0][0][0]);
          }
       }
    }
@@ -588,3 +666,35 @@ sp_tile_cache_clear(struct softpipe_tile_cache *tc,
    }
    tc->last_tile_addr.bits.invalid = 1;
 }
+
+
+/**
+ * Like sp_tile_cache_clear(), but only for the rows of tiles whose index
+ * modulo row_step is first_row.  The other tiles are left as they are in
+ * the surface.
+ */
+void
+sp_tile_cache_clear_rows(struct softpipe_tile_cache *tc,
+                         const union pipe_color_union *color,
+                         uint64_t clearValue,
+                         uint first_row, uint row_step)
+{
+   uint layer, x, y;
+
+   sp_tile_cache_clear(tc, color, clearValue);
+
+   for (layer = 0; layer < tc->num_maps; layer++) {
+      const uint w = tc->transfer[layer]->box.width;
+      const uint h = tc->transfer[layer]->box.height;
+
+      for (y = 0; y < h; y += TILE_SIZE) {
+         if ((y / TILE_SIZE) % row_step == first_row)
+            continue;
+
+         for (x = 0; x < w; x += TILE_SIZE) {
+            clear_clear_flag(tc->clear_flags, tile_address(x, y, layer),
+                             tc->clear_flags_size);
+         }
+      }
+   }
+}
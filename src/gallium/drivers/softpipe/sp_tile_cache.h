@@ -30,6 +30,7 @@
 
 
 #include "pipe/p_compiler.h"
+#include "tgsi/tgsi_exec.h"
 #include "sp_texture.h"
 
 
@@ -94,6 +95,7 @@ struct softpipe_tile_cache
    union pipe_color_union clear_color; /**< for color bufs */
    uint64_t clear_val;        /**< for z+stencil */
    boolean depth_stencil; /**< Is the surface a depth/stencil format? */
+   boolean quantize_color; /**< Do float colors lose precision in memory? */
 
    struct softpipe_cached_tile *tile;  /**< scratch tile for clears */
 
@@ -118,11 +120,21 @@ sp_tile_cache_get_surface(struct softpipe_tile_cache *tc);
 extern void
 sp_flush_tile_cache(struct softpipe_tile_cache *tc);
 
+extern void
+sp_tile_cache_quantize_quad(const struct softpipe_tile_cache *tc,
+                            float colors[4][TGSI_QUAD_SIZE]);
+
 extern void
 sp_tile_cache_clear(struct softpipe_tile_cache *tc,
                     const union pipe_color_union *color,
                     uint64_t clearValue);
 
+extern void
+sp_tile_cache_clear_rows(struct softpipe_tile_cache *tc,
+                         const union pipe_color_union *color,
+                         uint64_t clearValue,
+                         uint first_row, uint row_step);
+
 extern struct softpipe_cached_tile *
 sp_find_cached_tile(struct softpipe_tile_cache *tc, 
                     union tile_address addr );
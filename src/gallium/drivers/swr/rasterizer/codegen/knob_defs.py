@@ -71,6 +71,17 @@ KNOBS = [
         'category'  : 'perf',
     }],
 
+    ['SPLIT_NUMA_NODES', {
+        'type'      : 'uint32_t',
+        'default'   : '0',
+        'desc'      : ['Split each NUMA-node into N simulated NUMA-nodes of consecutive cores.',
+                       '  0 == Use the NUMA topology reported by the OS',
+                       '  N == Split each NUMA-node into N nodes',
+                       'Lets multi-node scheduling and memory placement be exercised and',
+                       'benchmarked on a single-socket system, e.g. under numactl.'],
+        'category'  : 'perf_adv',
+    }],
+
     ['MAX_CORES_PER_NUMA_NODE', {
         'type'      : 'uint32_t',
         'default'   : '0',
@@ -123,6 +123,7 @@ HANDLE SwrCreateContext(SWR_CREATECONTEXT_INFO* pCreateInfo)
         pContext->threadInfo.MAX_NUMA_NODES          = KNOB_MAX_NUMA_NODES;
         pContext->threadInfo.MAX_CORES_PER_NUMA_NODE = KNOB_MAX_CORES_PER_NUMA_NODE;
         pContext->threadInfo.MAX_THREADS_PER_CORE    = KNOB_MAX_THREADS_PER_CORE;
+        pContext->threadInfo.SPLIT_NUMA_NODES        = KNOB_SPLIT_NUMA_NODES;
         pContext->threadInfo.SINGLE_THREADED         = KNOB_SINGLE_THREADED;
     }
 
@@ -211,6 +211,7 @@ struct SWR_THREADING_INFO
     uint32_t MAX_NUMA_NODES;
     uint32_t MAX_CORES_PER_NUMA_NODE;
     uint32_t MAX_THREADS_PER_CORE;
+    uint32_t SPLIT_NUMA_NODES;
     bool     SINGLE_THREADED;
 };
 
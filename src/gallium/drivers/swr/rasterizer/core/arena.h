@@ -43,9 +43,14 @@ struct ArenaBlock
 {
     size_t      blockSize = 0;
     ArenaBlock* pNext     = nullptr;
+    uint32_t    numaNode  = 0; // node of the thread that first touched the block
 };
 static_assert(sizeof(ArenaBlock) <= ARENA_BLOCK_ALIGN, "Increase BLOCK_ALIGN size");
 
+// NUMA node of the calling thread. Worker threads set this once they are bound
+// to their HW thread, everything else stays on node 0.
+extern THREAD uint32_t gt_arenaNumaNode;
+
 class DefaultAllocator
 {
 public:
@@ -55,6 +60,16 @@ public:
 
         ArenaBlock* p = new (AlignedMalloc(size, align)) ArenaBlock();
         p->blockSize  = size;
+        p->numaNode   = gt_arenaNumaNode;
+
+        // Touch every page now, so the whole block is placed on the node of the
+        // allocating thread rather than on whichever thread first writes each page.
+        const size_t pageSize = 4 * sizeof(KILOBYTE);
+        for (size_t offset = pageSize; offset < size; offset += pageSize)
+        {
+            *(volatile uint8_t*)PtrAdd(p, offset) = 0;
+        }
+
         return p;
     }
 
@@ -77,13 +92,14 @@ struct CachingAllocatorT : DefaultAllocator
         SWR_ASSUME_ASSERT(size >= sizeof(ArenaBlock));
         SWR_ASSUME_ASSERT(size <= uint32_t(-1));
 
-        uint32_t bucket = GetBucketId(size);
+        uint32_t bucket   = GetBucketId(size);
+        uint32_t numaNode = gt_arenaNumaNode;
 
         {
-            // search cached blocks
+            // search cached blocks, only reuse blocks that live on our node
             std::lock_guard<std::mutex> l(m_mutex);
             ArenaBlock*                 pPrevBlock = &m_cachedBlocks[bucket];
-            ArenaBlock*                 pBlock     = SearchBlocks(pPrevBlock, size, align);
+            ArenaBlock* pBlock = SearchBlocks(pPrevBlock, size, align, numaNode);
 
             if (pBlock)
             {
@@ -96,7 +112,7 @@ struct CachingAllocatorT : DefaultAllocator
             else
             {
                 pPrevBlock = &m_oldCachedBlocks[bucket];
-                pBlock     = SearchBlocks(pPrevBlock, size, align);
+                pBlock     = SearchBlocks(pPrevBlock, size, align, numaNode);
 
                 if (pBlock)
                 {
@@ -302,7 +318,8 @@ private:
         }
     }
 
-    static ArenaBlock* SearchBlocks(ArenaBlock*& pPrevBlock, size_t blockSize, size_t align)
+    static ArenaBlock*
+    SearchBlocks(ArenaBlock*& pPrevBlock, size_t blockSize, size_t align, uint32_t numaNode)
     {
         ArenaBlock* pBlock          = pPrevBlock->pNext;
         ArenaBlock* pPotentialBlock = nullptr;
@@ -312,7 +329,7 @@ private:
         {
             if (pBlock->blockSize >= blockSize)
             {
-                if (pBlock == AlignUp(pBlock, align))
+                if (pBlock->numaNode == numaNode && pBlock == AlignUp(pBlock, align))
                 {
                     if (pBlock->blockSize == blockSize)
                     {
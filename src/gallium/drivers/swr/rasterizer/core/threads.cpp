@@ -52,6 +52,9 @@
 #include "tileset.h"
 
 
+// NUMA node of the calling thread, see arena.h
+THREAD uint32_t gt_arenaNumaNode = 0;
+
 // ThreadId
 struct Core
 {
@@ -308,6 +311,33 @@ void CalculateProcessorTopology(CPUNumaNodes& out_nodes, uint32_t& out_numThread
     }
 }
 
+//////////////////////////////////////////////////////////////////////////
+/// @brief Splits each NUMA node into numSplits simulated nodes made of
+///        consecutive cores, as if the system had more sockets.
+/// @param nodes - topology from CalculateProcessorTopology
+/// @param numSplits - number of nodes to make of each node
+void SplitNumaNodes(CPUNumaNodes& nodes, uint32_t numSplits)
+{
+    CPUNumaNodes splitNodes;
+
+    for (auto const& node : nodes)
+    {
+        uint32_t numCores = (uint32_t)node.cores.size();
+        uint32_t numParts = std::min(numSplits, numCores);
+
+        for (uint32_t part = 0; part < numParts; ++part)
+        {
+            NumaNode splitNode;
+            splitNode.numaId = (uint32_t)splitNodes.size();
+            splitNode.cores.assign(node.cores.begin() + part * numCores / numParts,
+                                   node.cores.begin() + (part + 1) * numCores / numParts);
+            splitNodes.push_back(splitNode);
+        }
+    }
+
+    nodes.swap(splitNodes);
+}
+
 void bindThread(SWR_CONTEXT* pContext,
                 uint32_t     threadId,
                 uint32_t     procGroupId   = 0,
@@ -590,7 +620,7 @@ bool WorkOnFifoBE(SWR_CONTEXT* pContext,
             // Only work on tiles for this numa node
             uint32_t x, y;
             pDC->pTileMgr->getTileIndices(tileID, x, y);
-            if (((x ^ y) & numaMask) != numaNode)
+            if (MacroTileMgr::getTileNumaNode(x, y, numaMask) != numaNode)
             {
                 _mm_pause();
                 continue;
@@ -857,6 +887,8 @@ void BindApiThread(SWR_CONTEXT* pContext, uint32_t apiThreadId)
 
     bindThread(
         pContext, threadData.threadId, threadData.procGroupId, threadData.forceBindProcGroup);
+
+    gt_arenaNumaNode = threadData.numaId;
 }
 
 template <bool IsFEThread, bool IsBEThread>
@@ -869,6 +901,9 @@ DWORD workerThreadMain(LPVOID pData)
 
     bindThread(pContext, threadId, pThreadData->procGroupId, pThreadData->forceBindProcGroup);
 
+    // Arena blocks this thread allocates are first touched, and recycled, on its node
+    gt_arenaNumaNode = pThreadData->numaId;
+
     {
         char threadName[64];
         sprintf_s(threadName,
@@ -1021,6 +1056,15 @@ void CreateThreadPool(SWR_CONTEXT* pContext, THREAD_POOL* pPool)
     CalculateProcessorTopology(nodes, numThreadsPerProcGroup);
     assert(numThreadsPerProcGroup > 0);
 
+#if !defined(_WIN32)
+    // Simulated nodes have no memory of their own, so only do this where
+    // NUMA placement relies on first touch rather than explicit node ids.
+    if (pContext->threadInfo.SPLIT_NUMA_NODES > 1)
+    {
+        SplitNumaNodes(nodes, pContext->threadInfo.SPLIT_NUMA_NODES);
+    }
+#endif
+
     // Assumption, for asymmetric topologies, multi-threaded cores will appear
     // in the list before single-threaded cores.  This appears to be true for
     // Windows when the total HW threads is limited to 64.
@@ -110,7 +110,8 @@ HOTTILE* HotTileMgr::GetHotTile(SWR_CONTEXT*                pContext,
         if (create)
         {
             uint32_t size     = numSamples * mHotTileSize[attachment];
-            uint32_t numaNode = ((x ^ y) & pContext->threadPool.numaMask);
+            uint32_t numaNode =
+                MacroTileMgr::getTileNumaNode(x, y, pContext->threadPool.numaMask);
             hotTile.pBuffer =
                 (uint8_t*)AllocHotTileMem(size, 64, numaNode + pContext->threadInfo.BASE_NUMA_NODE);
             hotTile.state                  = HOTTILE_INVALID;
@@ -134,7 +135,8 @@ HOTTILE* HotTileMgr::GetHotTile(SWR_CONTEXT*                pContext,
             FreeHotTileMem(hotTile.pBuffer);
 
             uint32_t size     = numSamples * mHotTileSize[attachment];
-            uint32_t numaNode = ((x ^ y) & pContext->threadPool.numaMask);
+            uint32_t numaNode =
+                MacroTileMgr::getTileNumaNode(x, y, pContext->threadPool.numaMask);
             hotTile.pBuffer =
                 (uint8_t*)AllocHotTileMem(size, 64, numaNode + pContext->threadInfo.BASE_NUMA_NODE);
             hotTile.state      = HOTTILE_INVALID;
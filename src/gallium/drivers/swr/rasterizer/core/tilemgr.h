@@ -130,6 +130,15 @@ public:
         return pdep_u32(x, 0x55555555) | pdep_u32(y, 0xAAAAAAAA);
     }
 
+    // NUMA node that works on, and owns the memory of, macrotile (x, y).
+    // Nodes own whole rows of macrotiles, so that each node covers complete
+    // rows of a linear render target and first touches them when it stores
+    // its hot tiles. Only works for 2**n numa nodes, like numaMask.
+    static INLINE uint32_t getTileNumaNode(uint32_t x, uint32_t y, uint32_t numaMask)
+    {
+        return y & numaMask;
+    }
+
 private:
     CachingArena&                mArena;
     std::vector<MacroTileQueue*> mTiles;
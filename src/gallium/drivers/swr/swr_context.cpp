@@ -519,6 +519,7 @@ swr_create_context(struct pipe_screen *p_screen, void *priv, unsigned flags)
    threadingInfo.MAX_NUMA_NODES            = KNOB_MAX_NUMA_NODES;
    threadingInfo.MAX_CORES_PER_NUMA_NODE   = KNOB_MAX_CORES_PER_NUMA_NODE;
    threadingInfo.MAX_THREADS_PER_CORE      = KNOB_MAX_THREADS_PER_CORE;
+   threadingInfo.SPLIT_NUMA_NODES          = KNOB_SPLIT_NUMA_NODES;
    threadingInfo.SINGLE_THREADED           = KNOB_SINGLE_THREADED;
 
    // Use non-standard settings for KNL
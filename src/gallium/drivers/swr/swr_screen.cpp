@@ -47,6 +47,11 @@
 #include <stdio.h>
 #include <map>
 
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 /*
  * Max texture sizes
  * XXX Check max texture size values against core and sampler.
@@ -716,6 +721,26 @@ swr_displaytarget_layout(struct swr_screen *screen, struct swr_resource *res)
    return true;
 }
 
+/*
+ * Render targets are only written by the backend worker threads, and every
+ * NUMA node works on whole rows of macrotiles.  Give the freshly allocated
+ * memory back to the kernel, in case the allocator handed us pages that were
+ * already populated, so that each page gets placed on the node of the first
+ * worker that stores a macrotile to it.
+ */
+static void
+swr_release_rt_pages(void *ptr, size_t size)
+{
+#if defined(__linux__)
+   const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+   uintptr_t start = ((uintptr_t)ptr + page_size - 1) & ~(page_size - 1);
+   uintptr_t end = ((uintptr_t)ptr + size) & ~(page_size - 1);
+
+   if (end > start)
+      madvise((void *)start, end - start, MADV_DONTNEED);
+#endif
+}
+
 static bool
 swr_texture_layout(struct swr_screen *screen,
                    struct swr_resource *res,
@@ -885,6 +910,9 @@ swr_texture_layout(struct swr_screen *screen,
       if (!res->swr.xpBaseAddress)
          return false;
 
+      if (pt->bind & (PIPE_BIND_RENDER_TARGET | PIPE_BIND_DEPTH_STENCIL))
+         swr_release_rt_pages((void *)res->swr.xpBaseAddress, total_size);
+
       if (res->has_depth && res->has_stencil) {
          res->secondary = res->swr;
          res->secondary.format = R8_UINT;
@@ -903,6 +931,10 @@ swr_texture_layout(struct swr_screen *screen,
             AlignedFree((void *)res->swr.xpBaseAddress);
             return false;
          }
+
+         if (pt->bind & PIPE_BIND_DEPTH_STENCIL)
+            swr_release_rt_pages((void *)res->secondary.xpBaseAddress,
+                                 total_size);
       }
    }
 
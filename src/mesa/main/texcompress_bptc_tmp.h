@@ -730,7 +730,7 @@ decompress_rgba_unorm_block(int src_width, int src_height,
    for(y = 0; y < src_height; y += 1) {
       uint8_t *result = dst_row;
       for(x = 0; x < src_width; x += 1) {
-         int texel;
+         int texel, index_bit_offset;
          texel = x + y * 4;
 
          anchors_before_texel = count_anchors_before_texel(mode->n_subsets,
@@ -745,7 +745,8 @@ decompress_rgba_unorm_block(int src_width, int src_height,
                                  anchors_before_texel);
 
          /* Calculate the offset to the primary index for this texel */
-         bit_offset += mode->n_index_bits * texel - anchors_before_texel;
+         index_bit_offset = (bit_offset + mode->n_index_bits * texel -
+                             anchors_before_texel);
 
          subset_num = (subsets >> (texel * 2)) & 3;
 
@@ -754,7 +755,7 @@ decompress_rgba_unorm_block(int src_width, int src_height,
          index_bits = mode->n_index_bits;
          if (anchor)
             index_bits--;
-         indices[0] = extract_bits(block, bit_offset, index_bits);
+         indices[0] = extract_bits(block, index_bit_offset, index_bits);
 
          if (mode->n_secondary_index_bits) {
             index_bits = mode->n_secondary_index_bits;
@@ -1106,7 +1107,7 @@ decompress_rgb_float_block(unsigned src_width, unsigned src_height,
    for(y = 0; y < src_height; y += 1) {
       float *result = dst_row;
       for(x = 0; x < src_width; x += 1) {
-         int texel;
+         int texel, index_bit_offset;
 
          texel = x + y * 4;
 
@@ -1114,14 +1115,15 @@ decompress_rgb_float_block(unsigned src_width, unsigned src_height,
             count_anchors_before_texel(n_subsets, partition_num, texel);
 
          /* Calculate the offset to the primary index for this texel */
-         bit_offset += mode->n_index_bits * texel - anchors_before_texel;
+         index_bit_offset = (bit_offset + mode->n_index_bits * texel -
+                             anchors_before_texel);
 
          subset_num = (subsets >> (texel * 2)) & 3;
 
          index_bits = mode->n_index_bits;
          if (is_anchor(n_subsets, partition_num, texel))
             index_bits--;
-         index = extract_bits(block, bit_offset, index_bits);
+         index = extract_bits(block, index_bit_offset, index_bits);
 
          for (component = 0; component < 3; component++) {
             value = interpolate(endpoints[subset_num * 2][component],